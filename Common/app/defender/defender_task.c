@@ -71,6 +71,7 @@
 
 /* Device Defender Client Library. */
 #include "defender.h"
+#include "defender_config.h"
 
 /* Metrics collector. */
 #include "metrics_collector.h"
@@ -81,7 +82,12 @@
 #define UDP_PORTS_MAX                      10
 #define CONNECTIONS_MAX                    10
 #define TASKS_MAX                          10
-#define REPORT_BUFFER_SIZE                 1024
+
+#if DEFENDER_LWIP_TUNING_METRICS
+    #define REPORT_BUFFER_SIZE             ( 1024 + LWIP_TUNING_METRICS_MAX_LEN )
+#else
+    #define REPORT_BUFFER_SIZE             1024
+#endif
 
 #define REPORT_MAJOR_VERSION               1
 #define REPORT_MINOR_VERSION               0
@@ -690,6 +696,14 @@ void vDefenderAgentTask( void * pvParameters )
             configASSERT_CONTINUE( xError == CborNoError );
         }
 
+        #if DEFENDER_LWIP_TUNING_METRICS
+            if( xError == CborNoError )
+            {
+                xError = xGetLwipTuningMetrics( &xMapEncoder );
+                configASSERT_CONTINUE( xError == CborNoError );
+            }
+        #endif /* DEFENDER_LWIP_TUNING_METRICS */
+
         if( xError == CborNoError )
         {
             xError = cbor_encoder_close_container( &xEncoder, &xMapEncoder );
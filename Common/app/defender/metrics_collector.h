@@ -30,6 +30,21 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "cbor.h"
+#include "defender_config.h"
+
+/* Custom metrics key of the report, long or short to match the other keys */
+#if DEFENDER_USE_LONG_KEYS
+    #define METRICS_CUSTOM_METRICS_KEY       "custom_metrics"
+#else
+    #define METRICS_CUSTOM_METRICS_KEY       "cmet"
+#endif
+
+/* Encoded size of one lwIP tuning metric: a name of up to 23 characters, then
+ * [ { "number_list": [ ... ] } ] holding up to four 32 bit values */
+#define LWIP_TUNING_METRIC_MAX_LEN           ( 24 + 1 + 1 + 12 + 1 + ( 4 * 5 ) )
+
+/* Most bytes xGetLwipTuningMetrics adds to a report: the key with its header, the map header and five metrics */
+#define LWIP_TUNING_METRICS_MAX_LEN          ( sizeof( METRICS_CUSTOM_METRICS_KEY ) + 1 + ( 5 * LWIP_TUNING_METRIC_MAX_LEN ) )
 
 /**
  * @brief Get network stats.
@@ -57,4 +72,10 @@ CborError xGetListeningUdpPorts( CborEncoder * pxMetricsEncoder );
  */
 CborError xGetEstablishedConnections( CborEncoder * pxMetricsEncoder );
 
+/**
+ * @brief Add the lwIP tuning figures as a custom metrics (METRICS_CUSTOM_METRICS_KEY) map
+ * of at most LWIP_TUNING_METRICS_MAX_LEN bytes.
+ */
+CborError xGetLwipTuningMetrics( CborEncoder * pxEncoder );
+
 #endif /* __METRICS_COLLECTOR_H__ */
@@ -40,6 +40,8 @@
 #include "lwip/udp.h"           /* struct udp_pcb */
 #include "lwip/priv/tcp_priv.h" /* tcp_listen_pcbs_t */
 
+#include "lwip_tuning.h"
+
 #include "cbor.h"
 
 /* Lwip configuration includes. */
@@ -691,3 +693,160 @@ CborError xGetEstablishedConnections( CborEncoder * pxMetricsEncoder )
 }
 
 /*-----------------------------------------------------------*/
+
+static CborError prvAddNumberListMetric( CborEncoder * pxEncoder,
+                                         const char * pcName,
+                                         const uint32_t * pulValues,
+                                         size_t xNumValues )
+{
+    CborEncoder xMetricEncoder;
+    CborEncoder xValueEncoder;
+    CborEncoder xListEncoder;
+    CborError xError;
+
+    /* "name": [ { "number_list": [ ... ] } ] */
+    xError = cbor_encode_text_stringz( pxEncoder, pcName );
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_create_array( pxEncoder, &xMetricEncoder, 1 );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_create_map( &xMetricEncoder, &xValueEncoder, 1 );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encode_text_stringz( &xValueEncoder, "number_list" );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_create_array( &xValueEncoder, &xListEncoder, xNumValues );
+    }
+
+    for( size_t xIdx = 0; ( xError == CborNoError ) && ( xIdx < xNumValues ); xIdx++ )
+    {
+        xError = cbor_encode_uint( &xListEncoder, pulValues[ xIdx ] );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_close_container( &xValueEncoder, &xListEncoder );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_close_container( &xMetricEncoder, &xValueEncoder );
+    }
+
+    if( xError == CborNoError )
+    {
+        xError = cbor_encoder_close_container( pxEncoder, &xMetricEncoder );
+    }
+
+    return xError;
+}
+
+static CborError prvAddResourceMetric( CborEncoder * pxEncoder,
+                                       const char * pcName,
+                                       const LwipTuningResource_t * pxResource )
+{
+    uint32_t pulValues[ 3 ] =
+    {
+        pxResource->ulSize,
+        pxResource->ulHighWater,
+        pxResource->ulFailures
+    };
+
+    return prvAddNumberListMetric( pxEncoder, pcName, pulValues, 3 );
+}
+
+CborError xGetLwipTuningMetrics( CborEncoder * pxEncoder )
+{
+    CborError xError = CborNoError;
+    LwipTuningSnapshot_t * pxSnapshot = NULL;
+
+    if( pxEncoder == NULL )
+    {
+        LogError( "Invalid parameter: pxEncoder: %p", pxEncoder );
+        xError = CborErrorImproperValue;
+    }
+    else
+    {
+        pxSnapshot = pvPortMalloc( sizeof( LwipTuningSnapshot_t ) );
+
+        if( pxSnapshot == NULL )
+        {
+            xError = CborErrorOutOfMemory;
+        }
+    }
+
+    if( xError == CborNoError )
+    {
+        CborEncoder xCmetEncoder;
+
+        vLwipTuningGetSnapshot( pxSnapshot );
+
+        xError = cbor_encode_text_stringz( pxEncoder, METRICS_CUSTOM_METRICS_KEY );
+        configASSERT_CONTINUE( xError == CborNoError );
+
+        if( xError == CborNoError )
+        {
+            xError = cbor_encoder_create_map( pxEncoder, &xCmetEncoder, 5 );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            xError = prvAddResourceMetric( &xCmetEncoder, "lwip_pbuf_pool", &( pxSnapshot->xPools[ MEMP_PBUF_POOL ] ) );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            xError = prvAddResourceMetric( &xCmetEncoder, "lwip_tcp_seg", &( pxSnapshot->xPools[ MEMP_TCP_SEG ] ) );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            xError = prvAddResourceMetric( &xCmetEncoder, "lwip_heap", &( pxSnapshot->xHeap ) );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            xError = prvAddResourceMetric( &xCmetEncoder, "lwip_mbox", &( pxSnapshot->xMbox ) );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            uint32_t pulTcp[ 4 ] =
+            {
+                pxSnapshot->ulTcpOutSegs,
+                pxSnapshot->ulTcpRetransSegs,
+                pxSnapshot->ulOoseqHighWater,
+                pxSnapshot->ulTcpDrops
+            };
+
+            xError = prvAddNumberListMetric( &xCmetEncoder, "lwip_tcp", pulTcp, 4 );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+
+        if( xError == CborNoError )
+        {
+            xError = cbor_encoder_close_container( pxEncoder, &xCmetEncoder );
+            configASSERT_CONTINUE( xError == CborNoError );
+        }
+    }
+
+    vPortFree( pxSnapshot );
+
+    return xError;
+}
+
+/*-----------------------------------------------------------*/
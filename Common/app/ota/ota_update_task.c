@@ -53,7 +53,7 @@
 /* Kernel includes. */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
+#include "atomic.h"
 #include "sys_evt.h"
 
 #include "ota_config.h"
@@ -81,6 +81,12 @@
 
 #include "kvstore.h"
 
+#if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+    #include "ota_http_interface.h"
+    #include "core_http_client.h"
+    #include "mbedtls_transport.h"
+#endif
+
 #ifdef TFM_PSA_API
     #include "tfm_fwu_defs.h"
     #include "psa/update.h"
@@ -118,6 +124,48 @@
  */
 #define otaexampleMQTT_TIMEOUT_MS                 ( 10 * 1000U )
 
+/**
+ * @brief Maximum size of the pre-signed URL and authentication scheme of an HTTP file download.
+ */
+#define otaexampleMAX_URL_SIZE                    ( 2048 )
+#define otaexampleMAX_AUTH_SCHEME_SIZE            ( 64 )
+
+/**
+ * @brief Maximum length of the host name of the HTTP download server.
+ */
+#define otaexampleHTTP_MAX_HOST_LEN               ( 128 )
+
+/**
+ * @brief TLS port and socket timeouts of the HTTP download connection.
+ */
+#define otaexampleHTTP_PORT                       ( 443 )
+#define otaexampleHTTP_SOCKET_TIMEOUT_MS          ( 5 * 1000U )
+
+/**
+ * @brief Number of bytes fetched with each ranged GET.
+ *
+ * The OTA agent issues a new data request once every block of the previous request has been
+ * received, so one range covers exactly that many blocks.
+ */
+#define otaexampleHTTP_RANGE_SIZE                 ( otaconfigMAX_NUM_BLOCKS_REQUEST * otaconfigFILE_BLOCK_SIZE )
+
+/**
+ * @brief Size of the HTTP request and response header buffers.
+ */
+#define otaexampleHTTP_REQ_BUFFER_SIZE            ( otaexampleMAX_URL_SIZE + 256 )
+#define otaexampleHTTP_RESP_HEADER_SIZE           ( 1024 )
+
+/**
+ * @brief Number of times a failed ranged GET is retried on a new connection.
+ */
+#define otaexampleHTTP_MAX_RECONNECTS             ( 2 )
+
+/**
+ * @brief Suffix of the topic the OTA agent publishes stream data requests to.
+ */
+#define otaexampleSTREAM_REQUEST_SUFFIX           "/get/cbor"
+#define otaexampleSTREAM_REQUEST_SUFFIX_LEN       ( sizeof( otaexampleSTREAM_REQUEST_SUFFIX ) - 1UL )
+
 /**
  * @brief The common prefix for all OTA topics.
  *
@@ -209,19 +257,57 @@ static const char * pOtaAgentStateStrings[ OtaAgentStateAll + 1 ] =
     "All"
 };
 
+#if ( otaconfigMAX_NUM_OTA_DATA_BUFFERS < ( otaconfigMAX_NUM_BLOCKS_REQUEST + 1 ) )
+    #error "otaconfigMAX_NUM_OTA_DATA_BUFFERS must hold a whole request window plus a control message."
+#endif
+
+#if ( otaconfigMAX_NUM_OTA_DATA_BUFFERS > 32 )
+    #error "The OTA event buffer pool tracks free buffers in a 32 bit mask."
+#endif
+
 /**
  * @brief A statically allocated array of event buffers used by the OTA agent.
  * Maximum number of buffers are determined by how many chunks are requested
  * by OTA agent at a time along with an extra buffer to handle control message.
  * The size of each buffer is determined by the maximum size of firmware image
  * chunk, and other metadata send along with the chunk.
+ *
+ * Free buffers are tracked in a bit mask updated with atomic operations, so the
+ * MQTT agent task never waits on the OTA agent task to fetch or free a buffer.
+ * A steadily increasing ulGetFailures means otaconfigMAX_NUM_BLOCKS_REQUEST exceeds
+ * what the agent task can drain and the window should be reduced.
  */
 typedef struct OtaEventBufferPool
 {
     OtaEventData_t eventBuffer[ otaconfigMAX_NUM_OTA_DATA_BUFFERS ];
-    SemaphoreHandle_t lock;
+    volatile uint32_t ulFreeMask; /* Bit n is set while eventBuffer[ n ] is free. */
+    uint32_t ulGetFailures;       /* Number of fetches that found every buffer in use. */
 } OtaEventBufferPool_t;
 
+/**
+ * @brief Timing of the MQTT data request windows.
+ *
+ * Each stream request opens a window of up to otaconfigMAX_NUM_BLOCKS_REQUEST blocks. The delay from
+ * the request to the first block is one round trip, and the spacing of the following blocks is the
+ * time the link takes to deliver one block. A window of ( round trip / block spacing ) + 1 blocks keeps
+ * the link busy for the whole round trip, so that is the value reported for otaconfigMAX_NUM_BLOCKS_REQUEST.
+ */
+typedef struct OtaWindowStats
+{
+    TickType_t xRequestTime;    /* Time the current window was requested. */
+    TickType_t xFirstBlockTime; /* Arrival time of the first block of the current window. */
+    TickType_t xLastBlockTime;  /* Arrival time of the latest block of the current window. */
+    uint32_t ulBlocks;          /* Blocks received in the current window. */
+    uint32_t ulBytes;           /* Bytes received in the current window. */
+    uint32_t ulWindows;         /* Number of completed windows which received at least one block. */
+    uint32_t ulRttMsTotal;      /* Sum of the round trip times of the completed windows. */
+    uint32_t ulRttMsMax;        /* Longest round trip time of a completed window. */
+    uint32_t ulSpacingMsTotal;  /* Sum of the block to block times of the completed windows. */
+    uint32_t ulSpacings;        /* Number of block to block times in ulSpacingMsTotal. */
+    uint32_t ulWindowMsTotal;   /* Sum of the request to last block times of the completed windows. */
+    uint32_t ulBytesTotal;      /* Bytes received in the completed windows. */
+} OtaWindowStats_t;
+
 /**
  * @brief The structure wraps the static buffers allocated by an OTA application
  * and used by OTA Agent. Static buffer should be in scope as long as the OTA Agent
@@ -259,9 +345,39 @@ typedef struct OtaAppStaticBuffer
      */
     uint8_t bitmap[ OTA_MAX_BLOCK_BITMAP_SIZE ];
 
+    #if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+
+        /**
+         * @brief Buffers used to store the pre-signed URL and authentication scheme of an HTTP download.
+         * Buffers are passed to the OTA agent during initialization.
+         */
+        uint8_t updateUrl[ otaexampleMAX_URL_SIZE ];
+        uint8_t authScheme[ otaexampleMAX_AUTH_SCHEME_SIZE ];
+    #endif
+
     OtaEventBufferPool_t eventBufferPool;
 } OtaAppStaticBuffer_t;
 
+#if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+
+/**
+ * @brief State of the HTTP download connection.
+ * The connection is separate from the MQTT connection and only exists while a file is downloaded over HTTP.
+ */
+    typedef struct OtaHttpContext
+    {
+        NetworkContext_t * pxNetworkContext;
+        TransportInterface_t xTransport;
+        BaseType_t xConnected;
+        char pcHost[ otaexampleHTTP_MAX_HOST_LEN + 1 ];
+        size_t uxHostLen;
+        const char * pcPath;
+        size_t uxPathLen;
+        uint8_t * pucReqBuffer;
+        uint8_t * pucRespBuffer;
+    } OtaHttpContext_t;
+#endif /* if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP ) */
+
 /**
  * @brief Defines the structure to use as the command callback context in this
  * demo.
@@ -332,6 +448,39 @@ static OtaMqttStatus_t prvMQTTUnsubscribe( const char * pTopicFilter,
                                            uint16_t topicFilterLength,
                                            uint8_t ucQoS );
 
+#if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+
+/**
+ * @brief Function used by OTA agent to start an HTTP file download.
+ *
+ * Splits the pre-signed URL into host and path and opens a TLS connection to the host.
+ *
+ * @param[in] pUrl Pre-signed URL of the file, taken from the job document.
+ * @return OtaHttpSuccess if successful. Appropriate error code otherwise.
+ */
+    static OtaHttpStatus_t prvHttpInit( char * pUrl );
+
+/**
+ * @brief Function used by OTA agent to request a file block over HTTP.
+ *
+ * A single ranged GET fetches otaconfigMAX_NUM_BLOCKS_REQUEST blocks starting at rangeStart,
+ * which are then queued to the OTA agent as consecutive file blocks.
+ *
+ * @param[in] rangeStart Offset of the first byte requested by the agent.
+ * @param[in] rangeEnd Offset of the last byte requested by the agent.
+ * @return OtaHttpSuccess if successful. Appropriate error code otherwise.
+ */
+    static OtaHttpStatus_t prvHttpRequest( uint32_t rangeStart,
+                                           uint32_t rangeEnd );
+
+/**
+ * @brief Function used by OTA agent to close the HTTP download connection.
+ *
+ * @return OtaHttpSuccess.
+ */
+    static OtaHttpStatus_t prvHttpDeinit( void );
+#endif /* if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP ) */
+
 /**
  * @brief Initialize the OTA event buffer pool.
  *
@@ -346,7 +495,8 @@ static BaseType_t prvOTAEventBufferPoolInit( OtaEventBufferPool_t * pxBufferPool
  * Demo uses a simple statically allocated array of fixed size event buffers. The
  * number of event buffers is configured by the param otaconfigMAX_NUM_OTA_DATA_BUFFERS
  * within ota_config.h. This function is used to fetch a free buffer from the pool for processing
- * by the OTA agent task. It uses a mutex for thread safe access to the pool.
+ * by the OTA agent task. It claims the lowest free buffer with a compare and swap and never blocks.
+ * A failed fetch is counted in the pool statistics.
  *
  * @param[in] pxEventBufferPool Pointer to the Event Buffer pool.
  * @return A pointer to an unused buffer from the pool. NULL if there are no buffers available.
@@ -359,8 +509,7 @@ static OtaEventData_t * prvOTAEventBufferGet( OtaEventBufferPool_t * pxBufferPoo
  * OTA demo uses a statically allocated array of fixed size event buffers . The
  * number of event buffers is configured by the param otaconfigMAX_NUM_OTA_DATA_BUFFERS
  * within ota_config.h. The function is used by the OTA application callback to free a buffer,
- * after OTA agent has completed processing with the event. The access to the pool is made thread safe
- * using a mutex.
+ * after OTA agent has completed processing with the event. The buffer is returned with an atomic OR.
  *
  * @param[in] pxEventBufferPool Pointer to the Event Buffer pool.
  * @param[in] pxBuffer Pointer to the buffer to be freed.
@@ -407,6 +556,25 @@ void vOTAUpdateTask( void * pvParam );
 static void prvProcessIncomingData( void * pxSubscriptionContext,
                                     MQTTPublishInfo_t * pPublishInfo );
 
+/**
+ * @brief Close the current data request window and open a new one.
+ *
+ * Called when the OTA agent publishes a stream data request.
+ */
+static void prvWindowStart( void );
+
+/**
+ * @brief Account for a data block received in the current request window.
+ *
+ * @param[in] uxLength Length of the received block.
+ */
+static void prvWindowBlockReceived( size_t uxLength );
+
+/**
+ * @brief Log the request window timing and the window size it suggests.
+ */
+static void prvWindowLogStats( void );
+
 /**
  * @brief Callback invoked for job control messages from MQTT broker.
  *
@@ -449,12 +617,25 @@ static inline BaseType_t xIsOtaAgentActive( void );
  */
 static OtaAppStaticBuffer_t xAppStaticBuffer = { 0 };
 
+/**
+ * @brief Request window timing of the MQTT downloads since the OTA agent started.
+ */
+static OtaWindowStats_t xWindowStats = { 0 };
+
 /**
  * @brief Pointer which holds the thing name received from key value store.
  */
 
 static char * pcThingName = NULL;
 
+#if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+
+/**
+ * @brief HTTP download connection used by the OTA agent task.
+ */
+    static OtaHttpContext_t xHttpCtx = { 0 };
+#endif
+
 /**
  * @brief Variable which holds the length of the thing name.
  */
@@ -470,12 +651,15 @@ static BaseType_t prvOTAEventBufferPoolInit( OtaEventBufferPool_t * pxBufferPool
 
     memset( pxBufferPool->eventBuffer, 0x00, sizeof( pxBufferPool->eventBuffer ) );
 
-    pxBufferPool->lock = xSemaphoreCreateMutex();
+    #if ( otaconfigMAX_NUM_OTA_DATA_BUFFERS == 32 )
+        pxBufferPool->ulFreeMask = UINT32_MAX;
+    #else
+        pxBufferPool->ulFreeMask = ( 1UL << otaconfigMAX_NUM_OTA_DATA_BUFFERS ) - 1UL;
+    #endif
 
-    if( pxBufferPool->lock != NULL )
-    {
-        poolInit = pdTRUE;
-    }
+    pxBufferPool->ulGetFailures = 0UL;
+
+    poolInit = pdTRUE;
 
     return poolInit;
 }
@@ -485,45 +669,52 @@ static BaseType_t prvOTAEventBufferPoolInit( OtaEventBufferPool_t * pxBufferPool
 static void prvOTAEventBufferFree( OtaEventBufferPool_t * pxBufferPool,
                                    OtaEventData_t * const pxBuffer )
 {
+    uint32_t ulIndex;
+
     configASSERT( pxBufferPool != NULL );
+    configASSERT( pxBuffer >= &( pxBufferPool->eventBuffer[ 0 ] ) );
 
-    if( xSemaphoreTake( pxBufferPool->lock, portMAX_DELAY ) == pdTRUE )
-    {
-        pxBuffer->bufferUsed = false;
-        ( void ) xSemaphoreGive( pxBufferPool->lock );
-    }
-    else
-    {
-        LogError( ( "Failed to get buffer semaphore." ) );
-    }
+    ulIndex = ( uint32_t ) ( pxBuffer - &( pxBufferPool->eventBuffer[ 0 ] ) );
+
+    configASSERT( ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS );
+    configASSERT( ( pxBufferPool->ulFreeMask & ( 1UL << ulIndex ) ) == 0 );
+
+    pxBuffer->bufferUsed = false;
+    ( void ) Atomic_OR_u32( &( pxBufferPool->ulFreeMask ), ( 1UL << ulIndex ) );
 }
 
 /*-----------------------------------------------------------*/
 
 static OtaEventData_t * prvOTAEventBufferGet( OtaEventBufferPool_t * pxBufferPool )
 {
+    uint32_t ulFreeMask = 0;
     uint32_t ulIndex = 0;
     OtaEventData_t * pFreeBuffer = NULL;
 
     configASSERT( pxBufferPool != NULL );
 
-    if( xSemaphoreTake( pxBufferPool->lock, portMAX_DELAY ) == pdTRUE )
+    do
     {
-        for( ulIndex = 0; ulIndex < otaconfigMAX_NUM_OTA_DATA_BUFFERS; ulIndex++ )
+        ulFreeMask = pxBufferPool->ulFreeMask;
+
+        if( ulFreeMask != 0UL )
         {
-            if( pxBufferPool->eventBuffer[ ulIndex ].bufferUsed == false )
+            ulIndex = ( uint32_t ) __builtin_ctz( ulFreeMask );
+
+            /* Retry if the other task claimed or freed a buffer since the mask was read */
+            if( Atomic_CompareAndSwap_u32( &( pxBufferPool->ulFreeMask ),
+                                           ulFreeMask & ~( 1UL << ulIndex ),
+                                           ulFreeMask ) == ATOMIC_COMPARE_AND_SWAP_SUCCESS )
             {
-                pxBufferPool->eventBuffer[ ulIndex ].bufferUsed = true;
-                pFreeBuffer = &pxBufferPool->eventBuffer[ ulIndex ];
-                break;
+                pFreeBuffer = &( pxBufferPool->eventBuffer[ ulIndex ] );
+                pFreeBuffer->bufferUsed = true;
             }
         }
+    } while( ( pFreeBuffer == NULL ) && ( ulFreeMask != 0UL ) );
 
-        ( void ) xSemaphoreGive( pxBufferPool->lock );
-    }
-    else
+    if( pFreeBuffer == NULL )
     {
-        LogError( ( "Failed to get buffer semaphore." ) );
+        ( void ) Atomic_Increment_u32( &( pxBufferPool->ulGetFailures ) );
     }
 
     return pFreeBuffer;
@@ -841,6 +1032,85 @@ static void otaAppCallback( OtaJobEvent_t event,
 
 /*-----------------------------------------------------------*/
 
+static void prvWindowStart( void )
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    {
+        if( xWindowStats.ulBlocks > 0 )
+        {
+            uint32_t ulRttMs = ( xWindowStats.xFirstBlockTime - xWindowStats.xRequestTime ) * portTICK_PERIOD_MS;
+
+            xWindowStats.ulWindows++;
+            xWindowStats.ulRttMsTotal += ulRttMs;
+            xWindowStats.ulRttMsMax = ( ulRttMs > xWindowStats.ulRttMsMax ) ? ulRttMs : xWindowStats.ulRttMsMax;
+            xWindowStats.ulSpacingMsTotal += ( xWindowStats.xLastBlockTime - xWindowStats.xFirstBlockTime ) * portTICK_PERIOD_MS;
+            xWindowStats.ulSpacings += xWindowStats.ulBlocks - 1;
+            xWindowStats.ulWindowMsTotal += ( xWindowStats.xLastBlockTime - xWindowStats.xRequestTime ) * portTICK_PERIOD_MS;
+            xWindowStats.ulBytesTotal += xWindowStats.ulBytes;
+        }
+
+        xWindowStats.xRequestTime = xNow;
+        xWindowStats.ulBlocks = 0;
+        xWindowStats.ulBytes = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvWindowBlockReceived( size_t uxLength )
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    {
+        if( xWindowStats.ulBlocks == 0 )
+        {
+            xWindowStats.xFirstBlockTime = xNow;
+        }
+
+        xWindowStats.xLastBlockTime = xNow;
+        xWindowStats.ulBlocks++;
+        xWindowStats.ulBytes += uxLength;
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvWindowLogStats( void )
+{
+    OtaWindowStats_t xStats;
+
+    taskENTER_CRITICAL();
+    {
+        xStats = xWindowStats;
+    }
+    taskEXIT_CRITICAL();
+
+    if( xStats.ulWindows > 0 )
+    {
+        uint32_t ulRttMs = xStats.ulRttMsTotal / xStats.ulWindows;
+        uint32_t ulSpacingMs = ( xStats.ulSpacings > 0 ) ? ( xStats.ulSpacingMsTotal / xStats.ulSpacings ) : 0;
+        uint32_t ulWindowMs = ( xStats.ulWindowMsTotal > 0 ) ? xStats.ulWindowMsTotal : 1;
+        uint32_t ulSuggested = ( ulRttMs / ( ( ulSpacingMs > 0 ) ? ulSpacingMs : 1 ) ) + 1;
+
+        LogInfo( ( "Request window: %u blocks, windows: %u, RTT avg: %u ms, max: %u ms, block spacing: %u ms, "
+                   "throughput: %u B/s, suggested otaconfigMAX_NUM_BLOCKS_REQUEST: %u",
+                   otaconfigMAX_NUM_BLOCKS_REQUEST,
+                   xStats.ulWindows,
+                   ulRttMs,
+                   xStats.ulRttMsMax,
+                   ulSpacingMs,
+                   ( uint32_t ) ( ( ( uint64_t ) xStats.ulBytesTotal * 1000ULL ) / ulWindowMs ),
+                   ulSuggested ) );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static void prvProcessIncomingData( void * pxContext,
                                     MQTTPublishInfo_t * pPublishInfo )
 {
@@ -864,6 +1134,8 @@ static void prvProcessIncomingData( void * pxContext,
         {
             LogDebug( ( "Received OTA image block, size %d.\n\n", pPublishInfo->payloadLength ) );
 
+            prvWindowBlockReceived( pPublishInfo->payloadLength );
+
             pData = prvOTAEventBufferGet( &xAppStaticBuffer.eventBufferPool );
 
             if( pData != NULL )
@@ -873,8 +1145,12 @@ static void prvProcessIncomingData( void * pxContext,
                 eventMsg.eventId = OtaAgentEventReceivedFileBlock;
                 eventMsg.pEventData = pData;
 
-                /* Send job document received event. */
-                OTA_SignalEvent( &eventMsg );
+                /* Send file block received event. The agent requests the block again if it is lost here. */
+                if( OTA_SignalEvent( &eventMsg ) == false )
+                {
+                    prvOTAEventBufferFree( &xAppStaticBuffer.eventBufferPool, pData );
+                    LogError( ( "Error: Failed to queue OTA data block.\r\n" ) );
+                }
             }
             else
             {
@@ -1108,6 +1384,13 @@ static OtaMqttStatus_t prvMQTTPublish( const char * const pacTopic,
     publishInfo.pPayload = pMsg;
     publishInfo.payloadLength = msgSize;
 
+    if( ( topicLen >= otaexampleSTREAM_REQUEST_SUFFIX_LEN ) &&
+        ( memcmp( &( pacTopic[ topicLen - otaexampleSTREAM_REQUEST_SUFFIX_LEN ] ),
+                  otaexampleSTREAM_REQUEST_SUFFIX,
+                  otaexampleSTREAM_REQUEST_SUFFIX_LEN ) == 0 ) )
+    {
+        prvWindowStart();
+    }
 
     xTaskNotifyStateClear( NULL );
 
@@ -1215,6 +1498,300 @@ static OtaMqttStatus_t prvMQTTUnsubscribe( const char * pTopicFilter,
 
 /*-----------------------------------------------------------*/
 
+#if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+
+    static uint32_t prvHttpGetTimeMs( void )
+    {
+        return ( uint32_t ) ( xTaskGetTickCount() * portTICK_PERIOD_MS );
+    }
+
+    static void prvHttpDisconnect( OtaHttpContext_t * pxCtx )
+    {
+        if( pxCtx->pxNetworkContext != NULL )
+        {
+            if( pxCtx->xConnected == pdTRUE )
+            {
+                mbedtls_transport_disconnect( pxCtx->pxNetworkContext );
+            }
+
+            mbedtls_transport_free( pxCtx->pxNetworkContext );
+            pxCtx->pxNetworkContext = NULL;
+        }
+
+        pxCtx->xConnected = pdFALSE;
+    }
+
+    static BaseType_t prvHttpConnect( OtaHttpContext_t * pxCtx )
+    {
+        BaseType_t xResult = pdFALSE;
+        TlsTransportStatus_t xTlsStatus = TLS_TRANSPORT_UNKNOWN_ERROR;
+        PkiObject_t pxRootCaChain[ 1 ] = { xPkiObjectFromLabel( TLS_ROOT_CA_CERT_LABEL ) };
+
+        prvHttpDisconnect( pxCtx );
+
+        pxCtx->pxNetworkContext = mbedtls_transport_allocate();
+
+        if( pxCtx->pxNetworkContext == NULL )
+        {
+            LogError( "Failed to allocate a network context for the HTTP download." );
+        }
+        else
+        {
+            /* The download server only authenticates the request through the pre-signed URL */
+            xTlsStatus = mbedtls_transport_configure( pxCtx->pxNetworkContext,
+                                                      NULL,
+                                                      NULL,
+                                                      NULL,
+                                                      pxRootCaChain,
+                                                      1 );
+
+            if( xTlsStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                xTlsStatus = mbedtls_transport_connect( pxCtx->pxNetworkContext,
+                                                        pxCtx->pcHost,
+                                                        otaexampleHTTP_PORT,
+                                                        otaexampleHTTP_SOCKET_TIMEOUT_MS,
+                                                        otaexampleHTTP_SOCKET_TIMEOUT_MS );
+            }
+
+            if( xTlsStatus == TLS_TRANSPORT_SUCCESS )
+            {
+                pxCtx->xConnected = pdTRUE;
+                pxCtx->xTransport.pNetworkContext = pxCtx->pxNetworkContext;
+                pxCtx->xTransport.send = mbedtls_transport_send;
+                pxCtx->xTransport.recv = mbedtls_transport_recv;
+                xResult = pdTRUE;
+            }
+            else
+            {
+                LogError( "Failed to connect to HTTP server %s, error = %d.", pxCtx->pcHost, xTlsStatus );
+                prvHttpDisconnect( pxCtx );
+            }
+        }
+
+        return xResult;
+    }
+
+    static HTTPStatus_t prvHttpGetRange( OtaHttpContext_t * pxCtx,
+                                         uint32_t ulRangeStart,
+                                         uint32_t ulRangeEnd,
+                                         HTTPResponse_t * pxResponse )
+    {
+        HTTPStatus_t xHttpStatus = HTTPSuccess;
+        HTTPRequestHeaders_t xRequestHeaders = { 0 };
+        HTTPRequestInfo_t xRequestInfo = { 0 };
+
+        xRequestInfo.pMethod = HTTP_METHOD_GET;
+        xRequestInfo.methodLen = sizeof( HTTP_METHOD_GET ) - 1;
+        xRequestInfo.pPath = pxCtx->pcPath;
+        xRequestInfo.pathLen = pxCtx->uxPathLen;
+        xRequestInfo.pHost = pxCtx->pcHost;
+        xRequestInfo.hostLen = pxCtx->uxHostLen;
+        xRequestInfo.reqFlags = HTTP_REQUEST_KEEP_ALIVE_FLAG;
+
+        xRequestHeaders.pBuffer = pxCtx->pucReqBuffer;
+        xRequestHeaders.bufferLen = otaexampleHTTP_REQ_BUFFER_SIZE;
+
+        ( void ) memset( pxResponse, 0, sizeof( HTTPResponse_t ) );
+        pxResponse->pBuffer = pxCtx->pucRespBuffer;
+        pxResponse->bufferLen = otaexampleHTTP_RANGE_SIZE + otaexampleHTTP_RESP_HEADER_SIZE;
+        pxResponse->getTime = prvHttpGetTimeMs;
+
+        xHttpStatus = HTTPClient_InitializeRequestHeaders( &xRequestHeaders, &xRequestInfo );
+
+        if( xHttpStatus == HTTPSuccess )
+        {
+            xHttpStatus = HTTPClient_AddRangeHeader( &xRequestHeaders,
+                                                     ( int32_t ) ulRangeStart,
+                                                     ( int32_t ) ulRangeEnd );
+        }
+
+        if( xHttpStatus == HTTPSuccess )
+        {
+            xHttpStatus = HTTPClient_Send( &( pxCtx->xTransport ),
+                                           &xRequestHeaders,
+                                           NULL,
+                                           0,
+                                           pxResponse,
+                                           0 );
+        }
+
+        return xHttpStatus;
+    }
+
+    static OtaHttpStatus_t prvHttpInit( char * pUrl )
+    {
+        OtaHttpStatus_t xOtaHttpStatus = OtaHttpInitFailed;
+        const char * pcHost = NULL;
+        const char * pcPath = NULL;
+
+        configASSERT( pUrl != NULL );
+
+        pcHost = strstr( pUrl, "://" );
+
+        if( pcHost != NULL )
+        {
+            pcHost += 3;
+            pcPath = strchr( pcHost, '/' );
+        }
+
+        if( ( pcHost == NULL ) ||
+            ( pcPath == NULL ) ||
+            ( ( size_t ) ( pcPath - pcHost ) > otaexampleHTTP_MAX_HOST_LEN ) )
+        {
+            LogError( "Failed to parse the OTA download URL." );
+        }
+        else
+        {
+            prvHttpDisconnect( &xHttpCtx );
+
+            xHttpCtx.uxHostLen = ( size_t ) ( pcPath - pcHost );
+            ( void ) memcpy( xHttpCtx.pcHost, pcHost, xHttpCtx.uxHostLen );
+            xHttpCtx.pcHost[ xHttpCtx.uxHostLen ] = '\0';
+
+            /* The URL buffer is owned by the OTA agent and outlives the download */
+            xHttpCtx.pcPath = pcPath;
+            xHttpCtx.uxPathLen = strlen( pcPath );
+
+            if( xHttpCtx.pucReqBuffer == NULL )
+            {
+                xHttpCtx.pucReqBuffer = pvPortMalloc( otaexampleHTTP_REQ_BUFFER_SIZE );
+            }
+
+            if( xHttpCtx.pucRespBuffer == NULL )
+            {
+                xHttpCtx.pucRespBuffer = pvPortMalloc( otaexampleHTTP_RANGE_SIZE + otaexampleHTTP_RESP_HEADER_SIZE );
+            }
+
+            if( ( xHttpCtx.pucReqBuffer == NULL ) ||
+                ( xHttpCtx.pucRespBuffer == NULL ) )
+            {
+                LogError( "Failed to allocate HTTP download buffers." );
+                ( void ) prvHttpDeinit();
+            }
+            else if( prvHttpConnect( &xHttpCtx ) == pdTRUE )
+            {
+                LogInfo( "Downloading OTA file from %s in %lu byte ranges.",
+                         xHttpCtx.pcHost, ( unsigned long ) otaexampleHTTP_RANGE_SIZE );
+                xOtaHttpStatus = OtaHttpSuccess;
+            }
+            else
+            {
+                ( void ) prvHttpDeinit();
+            }
+        }
+
+        return xOtaHttpStatus;
+    }
+
+    static OtaHttpStatus_t prvHttpRequest( uint32_t rangeStart,
+                                           uint32_t rangeEnd )
+    {
+        OtaHttpStatus_t xOtaHttpStatus = OtaHttpRequestFailed;
+        HTTPStatus_t xHttpStatus = HTTPNetworkError;
+        HTTPResponse_t xResponse = { 0 };
+        uint32_t ulRangeEnd = rangeStart + otaexampleHTTP_RANGE_SIZE - 1;
+
+        /* Never ask for less than the agent requested */
+        ulRangeEnd = ( rangeEnd > ulRangeEnd ) ? rangeEnd : ulRangeEnd;
+
+        if( ( xHttpCtx.pucReqBuffer == NULL ) ||
+            ( xHttpCtx.pucRespBuffer == NULL ) )
+        {
+            LogError( "HTTP download has not been initialized." );
+        }
+        else
+        {
+            /* Reconnect and retry the same range if the connection dropped mid download */
+            for( uint32_t ulAttempt = 0; ulAttempt <= otaexampleHTTP_MAX_RECONNECTS; ulAttempt++ )
+            {
+                if( ( xHttpCtx.xConnected == pdTRUE ) ||
+                    ( prvHttpConnect( &xHttpCtx ) == pdTRUE ) )
+                {
+                    xHttpStatus = prvHttpGetRange( &xHttpCtx, rangeStart, ulRangeEnd, &xResponse );
+
+                    if( ( xHttpStatus == HTTPSuccess ) &&
+                        ( xResponse.statusCode == 206 ) )
+                    {
+                        xOtaHttpStatus = OtaHttpSuccess;
+                        break;
+                    }
+
+                    LogWarn( "Ranged GET of bytes %lu-%lu failed, status = %s, HTTP code = %u.",
+                             rangeStart, ulRangeEnd, HTTPClient_strerror( xHttpStatus ), xResponse.statusCode );
+
+                    prvHttpDisconnect( &xHttpCtx );
+                }
+            }
+        }
+
+        if( xOtaHttpStatus == OtaHttpSuccess )
+        {
+            const uint8_t * pucBody = xResponse.pBody;
+            size_t uxRemaining = xResponse.bodyLen;
+            OtaEventMsg_t eventMsg = { 0 };
+
+            /* The server clamps a range that runs past the end of the file, so only the final block may be short.
+             * The agent assigns consecutive block numbers to the blocks queued for one request. */
+            for( uint32_t ulBlock = 0;
+                 ( ulBlock < otaconfigMAX_NUM_BLOCKS_REQUEST ) && ( uxRemaining > 0 );
+                 ulBlock++ )
+            {
+                size_t uxBlockLen = ( uxRemaining > otaconfigFILE_BLOCK_SIZE ) ? otaconfigFILE_BLOCK_SIZE : uxRemaining;
+                OtaEventData_t * pData = prvOTAEventBufferGet( &xAppStaticBuffer.eventBufferPool );
+
+                if( pData == NULL )
+                {
+                    /* Blocks that are not queued are fetched again by the next request */
+                    LogWarn( "No OTA data buffers available. Queued %lu of the blocks in this range.", ulBlock );
+                    break;
+                }
+
+                ( void ) memcpy( pData->data, pucBody, uxBlockLen );
+                pData->dataLength = uxBlockLen;
+                eventMsg.eventId = OtaAgentEventReceivedFileBlock;
+                eventMsg.pEventData = pData;
+
+                if( OTA_SignalEvent( &eventMsg ) == false )
+                {
+                    prvOTAEventBufferFree( &xAppStaticBuffer.eventBufferPool, pData );
+                    LogWarn( "Failed to queue OTA data block. Queued %lu of the blocks in this range.", ulBlock );
+                    break;
+                }
+
+                pucBody += uxBlockLen;
+                uxRemaining -= uxBlockLen;
+            }
+        }
+
+        return xOtaHttpStatus;
+    }
+
+    static OtaHttpStatus_t prvHttpDeinit( void )
+    {
+        prvHttpDisconnect( &xHttpCtx );
+
+        if( xHttpCtx.pucReqBuffer != NULL )
+        {
+            vPortFree( xHttpCtx.pucReqBuffer );
+            xHttpCtx.pucReqBuffer = NULL;
+        }
+
+        if( xHttpCtx.pucRespBuffer != NULL )
+        {
+            vPortFree( xHttpCtx.pucRespBuffer );
+            xHttpCtx.pucRespBuffer = NULL;
+        }
+
+        xHttpCtx.pcPath = NULL;
+        xHttpCtx.uxPathLen = 0;
+
+        return OtaHttpSuccess;
+    }
+#endif /* if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP ) */
+
+/*-----------------------------------------------------------*/
+
 static void prvSetOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
 {
     configASSERT( pOtaInterfaces != NULL );
@@ -1235,6 +1812,13 @@ static void prvSetOtaInterfaces( OtaInterfaces_t * pOtaInterfaces )
     pOtaInterfaces->mqtt.publish = prvMQTTPublish;
     pOtaInterfaces->mqtt.unsubscribe = prvMQTTUnsubscribe;
 
+    #if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+        /* Initialize the OTA library HTTP Interface.*/
+        pOtaInterfaces->http.init = prvHttpInit;
+        pOtaInterfaces->http.request = prvHttpRequest;
+        pOtaInterfaces->http.deinit = prvHttpDeinit;
+    #endif
+
     /* Initialize the OTA library PAL Interface.*/
     pOtaInterfaces->pal.getPlatformImageState = otaPal_GetPlatformImageState;
     pOtaInterfaces->pal.setPlatformImageState = otaPal_SetPlatformImageState;
@@ -1258,6 +1842,13 @@ static void prvSetOTAAppBuffer( OtaAppBuffer_t * pOtaAppBuffer )
     pOtaAppBuffer->decodeMemorySize = ( 1U << otaconfigLOG2_FILE_BLOCK_SIZE );
     pOtaAppBuffer->pFileBitmap = xAppStaticBuffer.bitmap;
     pOtaAppBuffer->fileBitmapSize = OTA_MAX_BLOCK_BITMAP_SIZE;
+
+    #if ( configENABLED_DATA_PROTOCOLS & OTA_DATA_OVER_HTTP )
+        pOtaAppBuffer->pUrl = xAppStaticBuffer.updateUrl;
+        pOtaAppBuffer->urlSize = otaexampleMAX_URL_SIZE;
+        pOtaAppBuffer->pAuthScheme = xAppStaticBuffer.authScheme;
+        pOtaAppBuffer->authSchemeSize = otaexampleMAX_AUTH_SCHEME_SIZE;
+    #endif
 }
 
 static inline BaseType_t xIsOtaAgentActive( void )
@@ -1467,12 +2058,15 @@ void vOTAUpdateTask( void * pvParam )
             if( ( xIsOtaAgentActive() == pdTRUE ) &&
                 ( OTA_GetStatistics( &otaStatistics ) == OtaErrNone ) )
             {
-                LogInfo( ( "State: %s   Received: %u   Queued: %u   Processed: %u   Dropped: %u",
+                LogInfo( ( "State: %s   Received: %u   Queued: %u   Processed: %u   Dropped: %u   No buffer: %u",
                            pOtaAgentStateStrings[ OTA_GetState() ],
                            otaStatistics.otaPacketsReceived,
                            otaStatistics.otaPacketsQueued,
                            otaStatistics.otaPacketsProcessed,
-                           otaStatistics.otaPacketsDropped ) );
+                           otaStatistics.otaPacketsDropped,
+                           xAppStaticBuffer.eventBufferPool.ulGetFailures ) );
+
+                prvWindowLogStats();
             }
 
             vTaskDelay( pdMS_TO_TICKS( otaexampleTASK_DELAY_MS ) );
@@ -59,7 +59,8 @@ const CLI_Command_Definition_t xCommandDef_conf =
         "    conf get\r\n"
         "        Outputs the value of all runtime config options supported by the system.\r\n\n"
         "    conf get <key>\r\n"
-        "        Outputs the current value of a given runtime config item.\r\n\n"
+        "        Outputs the current value of a given runtime config item.\r\n"
+        "        Binary items are printed in hex.\r\n\n"
         "    conf set <key> <value>\r\n"
         "        Set the value of a given runtime config item. This change is staged\r\n"
         "        in volatile memory until a commit operation occurs.\r\n\n"
@@ -124,8 +125,35 @@ static void vSubCommand_GetConfig( ConsoleIO_t * pxCIO,
                break;
            }
 
-        case KV_TYPE_STRING:
         case KV_TYPE_BLOB:
+           {
+               /* Blobs hold binary records, so print them in hex rather than as a string */
+               size_t xBlobLen = 0;
+               uint8_t * pucBlob = KVStore_getBlobHeap( xKey, &xBlobLen );
+
+               lResponseLen = snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN, "%s=", pcKey );
+
+               for( size_t i = 0;
+                    ( pucBlob != NULL ) && ( i < xBlobLen ) && ( ( lResponseLen + 2 + 3 ) <= CLI_OUTPUT_SCRATCH_BUF_LEN );
+                    i++ )
+               {
+                   lResponseLen += snprintf( &( pcCliScratchBuffer[ lResponseLen ] ), 3, "%02x", pucBlob[ i ] );
+               }
+
+               if( ( lResponseLen + 3 ) <= CLI_OUTPUT_SCRATCH_BUF_LEN )
+               {
+                   lResponseLen += snprintf( &( pcCliScratchBuffer[ lResponseLen ] ), 3, "\r\n" );
+               }
+
+               if( pucBlob != NULL )
+               {
+                   vPortFree( pucBlob );
+               }
+
+               break;
+           }
+
+        case KV_TYPE_STRING:
            {
                char * pcWorkPtr = pcCliScratchBuffer;
                pcWorkPtr = stpncpy( pcWorkPtr, pcKey, CLI_OUTPUT_SCRATCH_BUF_LEN );
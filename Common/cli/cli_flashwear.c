@@ -0,0 +1,147 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ */
+
+#ifndef TFM_PSA_API
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include "fs/lfs_port.h"
+
+/* Number of buckets in the erase count histogram */
+#define FLASHWEAR_HIST_BUCKETS    8
+
+static void prvFlashWearCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_flashwear =
+{
+    "flashwear",
+    "flashwear [-v]\r\n"
+    "    Display the erase count distribution of the internal flash filesystem.\r\n"
+    "    -v  Also list the erase count of every block.\r\n\n",
+    prvFlashWearCommand
+};
+
+static void prvFlashWearCommand( ConsoleIO_t * const pxCIO,
+                                 uint32_t ulArgc,
+                                 char * ppcArgv[] )
+{
+    BaseType_t xVerbose = pdFALSE;
+    size_t uxBlockCount = 0;
+    const uint32_t * pulCounts = pulGetInternalFlashEraseCounts( &uxBlockCount );
+
+    for( uint32_t i = 1; i < ulArgc; i++ )
+    {
+        if( strcmp( "-v", ppcArgv[ i ] ) == 0 )
+        {
+            xVerbose = pdTRUE;
+        }
+        else
+        {
+            pxCIO->print( "Error: Unrecognized argument: " );
+            pxCIO->print( ppcArgv[ i ] );
+            pxCIO->print( "\r\n" );
+        }
+    }
+
+    if( ( pulCounts == NULL ) ||
+        ( uxBlockCount == 0 ) )
+    {
+        pxCIO->print( "Error: The internal flash filesystem has not been initialized.\r\n" );
+    }
+    else
+    {
+        uint32_t ulMin = UINT32_MAX;
+        uint32_t ulMax = 0;
+        uint32_t ulTotal = 0;
+        uint32_t ulHistogram[ FLASHWEAR_HIST_BUCKETS ] = { 0 };
+
+        for( size_t uxIdx = 0; uxIdx < uxBlockCount; uxIdx++ )
+        {
+            ulMin = ( pulCounts[ uxIdx ] < ulMin ) ? pulCounts[ uxIdx ] : ulMin;
+            ulMax = ( pulCounts[ uxIdx ] > ulMax ) ? pulCounts[ uxIdx ] : ulMax;
+            ulTotal += pulCounts[ uxIdx ];
+        }
+
+        /* Spread the buckets evenly between the minimum and maximum erase counts */
+        uint32_t ulBucketWidth = ( ( ulMax - ulMin ) / FLASHWEAR_HIST_BUCKETS ) + 1;
+
+        for( size_t uxIdx = 0; uxIdx < uxBlockCount; uxIdx++ )
+        {
+            ulHistogram[ ( pulCounts[ uxIdx ] - ulMin ) / ulBucketWidth ]++;
+        }
+
+        vCliPrintScratchBuffer( pxCIO,
+                                snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "Blocks: %lu, Total erases: %lu, Min: %lu, Max: %lu, Mean: %lu\r\n",
+                                          ( unsigned long ) uxBlockCount, ulTotal, ulMin, ulMax,
+                                          ( unsigned long ) ( ulTotal / uxBlockCount ) ) );
+
+        pxCIO->print( "+-------------------------+--------+\r\n" );
+        pxCIO->print( "| Erase count             | Blocks |\r\n" );
+        pxCIO->print( "|-------------------------|--------|\r\n" );
+
+        for( uint32_t ulBucket = 0; ulBucket < FLASHWEAR_HIST_BUCKETS; ulBucket++ )
+        {
+            uint32_t ulLow = ulMin + ( ulBucket * ulBucketWidth );
+
+            if( ulLow > ulMax )
+            {
+                break;
+            }
+
+            vCliPrintScratchBuffer( pxCIO,
+                                    snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                              "| %10lu - %10lu | %6lu |\r\n",
+                                              ulLow, ulLow + ulBucketWidth - 1, ulHistogram[ ulBucket ] ) );
+        }
+
+        pxCIO->print( "+-------------------------+--------+\r\n" );
+
+        if( xVerbose == pdTRUE )
+        {
+            for( size_t uxIdx = 0; uxIdx < uxBlockCount; uxIdx++ )
+            {
+                vCliPrintScratchBuffer( pxCIO,
+                                        snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                                  "Block %4lu: %lu\r\n",
+                                                  ( unsigned long ) uxIdx, pulCounts[ uxIdx ] ) );
+            }
+        }
+    }
+}
+
+#endif /* ifndef TFM_PSA_API */
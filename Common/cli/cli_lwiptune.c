@@ -0,0 +1,197 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ *
+ */
+
+/* Standard includes. */
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* FreeRTOS includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cli.h"
+#include "cli_prv.h"
+
+#include "lwip_tuning.h"
+
+/* Retransmission rate, in tenths of a percent, above which the link rather than buffering is the likely bottleneck */
+#define LWIPTUNE_RETRANS_WARN_PERMILLE    20
+
+static void prvLwipTuneCommand( ConsoleIO_t * const pxCIO,
+                                uint32_t ulArgc,
+                                char * ppcArgv[] );
+
+const CLI_Command_Definition_t xCommandDef_lwiptune =
+{
+    "lwiptune",
+    "lwiptune report\r\n"
+    "    Report the high-water marks and allocation failures of the lwIP pools, heap, sys_arch\r\n"
+    "    object pools, tcpip mailbox and TCP send queues since boot or the last reset, with a\r\n"
+    "    suggested size for each lwipopts.h option and the RAM it would save or cost.\r\n"
+    "lwiptune sample on|off\r\n"
+    "    Start or stop sampling the TCP send and out of order queues every 100 ms.\r\n"
+    "    Sampling is off after boot, which leaves the TCP_SND_QUEUELEN peak at zero.\r\n"
+    "lwiptune reset\r\n"
+    "    Start a new measurement window.\r\n\n",
+    prvLwipTuneCommand
+};
+
+/* Print one resource and return the change in RAM, in bytes, of applying the suggestion */
+static int32_t prvPrintResource( ConsoleIO_t * const pxCIO,
+                                 const LwipTuningResource_t * pxResource )
+{
+    uint32_t ulSuggested = ulLwipTuningRecommend( pxResource );
+    int32_t lDelta = ( ( int32_t ) ulSuggested - ( int32_t ) pxResource->ulSize ) * ( int32_t ) pxResource->ulElemSize;
+
+    vCliPrintScratchBuffer( pxCIO,
+                            snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                      "%-26s %7lu %7lu %7lu %6lu %7lu %9ld\r\n",
+                                      pxResource->pcOption,
+                                      ( unsigned long ) pxResource->ulSize,
+                                      ( unsigned long ) pxResource->ulUsed,
+                                      ( unsigned long ) pxResource->ulHighWater,
+                                      ( unsigned long ) pxResource->ulFailures,
+                                      ( unsigned long ) ulSuggested,
+                                      ( long ) lDelta ) );
+
+    return lDelta;
+}
+
+static void prvPrintReport( ConsoleIO_t * const pxCIO )
+{
+    /* Too large for the CLI task stack */
+    LwipTuningSnapshot_t * pxSnapshot = pvPortMalloc( sizeof( LwipTuningSnapshot_t ) );
+
+    if( pxSnapshot == NULL )
+    {
+        pxCIO->print( "Error: Failed to allocate the snapshot buffer.\r\n" );
+    }
+    else
+    {
+        const LwipTuningResource_t * pxPbufPool = &( pxSnapshot->xPools[ MEMP_PBUF_POOL ] );
+        int32_t lTotalDelta = 0;
+        uint32_t ulRetransPermille = 0;
+
+        vLwipTuningGetSnapshot( pxSnapshot );
+
+        pxCIO->print( "Option                        Size    Used    Peak   Fail Suggest   RAM (B)\r\n" );
+
+        for( uint32_t ulPool = 0; ulPool < MEMP_MAX; ulPool++ )
+        {
+            if( pxSnapshot->xPools[ ulPool ].ulSize > 0 )
+            {
+                lTotalDelta += prvPrintResource( pxCIO, &( pxSnapshot->xPools[ ulPool ] ) );
+            }
+        }
+
+        lTotalDelta += prvPrintResource( pxCIO, &( pxSnapshot->xHeap ) );
+
+        for( uint32_t ulPool = 0; ulPool < SYS_ARCH_POOL_MAX; ulPool++ )
+        {
+            if( pxSnapshot->xSysPools[ ulPool ].ulSize > 0 )
+            {
+                lTotalDelta += prvPrintResource( pxCIO, &( pxSnapshot->xSysPools[ ulPool ] ) );
+            }
+        }
+
+        lTotalDelta += prvPrintResource( pxCIO, &( pxSnapshot->xMbox ) );
+        ( void ) prvPrintResource( pxCIO, &( pxSnapshot->xSndQueue ) );
+
+        if( pxSnapshot->ulTcpOutSegs > 0 )
+        {
+            ulRetransPermille = ( uint32_t ) ( ( ( uint64_t ) pxSnapshot->ulTcpRetransSegs * 1000ULL ) / pxSnapshot->ulTcpOutSegs );
+        }
+
+        vCliPrintScratchBuffer( pxCIO,
+                                snprintf( pcCliScratchBuffer, CLI_OUTPUT_SCRATCH_BUF_LEN,
+                                          "\r\nTCP segments out: %lu, retransmitted: %lu (%lu.%lu%%), in: %lu, dropped: %lu\r\n"
+                                          "Out of order: peak %lu segments held, seen in %lu of %lu samples\r\n"
+                                          "Total RAM change if all suggestions are applied: %ld bytes\r\n",
+                                          ( unsigned long ) pxSnapshot->ulTcpOutSegs,
+                                          ( unsigned long ) pxSnapshot->ulTcpRetransSegs,
+                                          ( unsigned long ) ( ulRetransPermille / 10 ),
+                                          ( unsigned long ) ( ulRetransPermille % 10 ),
+                                          ( unsigned long ) pxSnapshot->ulTcpInSegs,
+                                          ( unsigned long ) pxSnapshot->ulTcpDrops,
+                                          ( unsigned long ) pxSnapshot->ulOoseqHighWater,
+                                          ( unsigned long ) pxSnapshot->ulOoseqSamples,
+                                          ( unsigned long ) pxSnapshot->ulSamples,
+                                          ( long ) lTotalDelta ) );
+
+        if( ulRetransPermille >= LWIPTUNE_RETRANS_WARN_PERMILLE )
+        {
+            pxCIO->print( "Note: The retransmission rate is high. Check the link before trading TCP_SND_BUF for RAM.\r\n" );
+        }
+
+        if( ( pxPbufPool->ulFailures > 0 ) && ( pxSnapshot->ulOoseqSamples > 0 ) )
+        {
+            pxCIO->print( "Note: PBUF_POOL ran out while out of order segments were queued. Consider TCP_OOSEQ_MAX_PBUFS.\r\n" );
+        }
+
+        if( pxSnapshot->xSndQueue.ulFailures > 0 )
+        {
+            pxCIO->print( "Note: TCP writes failed for lack of memory. Check TCP_SND_QUEUELEN and MEMP_NUM_TCP_SEG.\r\n" );
+        }
+
+        if( pxSnapshot->xSampling == pdFALSE )
+        {
+            pxCIO->print( "Note: TCP queue sampling is off, so the TCP_SND_QUEUELEN and out of order figures are incomplete. Run \"lwiptune sample on\".\r\n" );
+        }
+
+        pxCIO->print( "Suggestions only cover the load seen in this window. Exercise every feature of the product before applying them.\r\n" );
+
+        vPortFree( pxSnapshot );
+    }
+}
+
+static void prvLwipTuneCommand( ConsoleIO_t * const pxCIO,
+                                uint32_t ulArgc,
+                                char * ppcArgv[] )
+{
+    if( ( ulArgc >= 2 ) &&
+        ( strcmp( ppcArgv[ 1 ], "report" ) == 0 ) )
+    {
+        prvPrintReport( pxCIO );
+    }
+    else if( ( ulArgc >= 2 ) &&
+             ( strcmp( ppcArgv[ 1 ], "reset" ) == 0 ) )
+    {
+        vLwipTuningReset();
+        pxCIO->print( "OK\r\n" );
+    }
+    else if( ( ulArgc >= 3 ) &&
+             ( strcmp( ppcArgv[ 1 ], "sample" ) == 0 ) &&
+             ( ( strcmp( ppcArgv[ 2 ], "on" ) == 0 ) || ( strcmp( ppcArgv[ 2 ], "off" ) == 0 ) ) )
+    {
+        vLwipTuningSetSampling( ( strcmp( ppcArgv[ 2 ], "on" ) == 0 ) ? pdTRUE : pdFALSE );
+        pxCIO->print( "OK\r\n" );
+    }
+    else
+    {
+        pxCIO->print( xCommandDef_lwiptune.pcHelpString );
+    }
+}
@@ -30,6 +30,10 @@
 
 #include "tls_transport_config.h"
 
+#ifndef TFM_PSA_API
+    #include "fs/lfs_port.h"
+#endif
+
 #include <string.h>
 
 typedef struct xCOMMAND_INPUT_LIST
@@ -258,6 +262,22 @@ const char * FreeRTOS_CLIGetParameter( const char * pcCommandString,
 
 /*-----------------------------------------------------------*/
 
+void vCliPrintScratchBuffer( ConsoleIO_t * const pxConsoleIO,
+                             int lLen )
+{
+    if( lLen >= CLI_OUTPUT_SCRATCH_BUF_LEN )
+    {
+        lLen = CLI_OUTPUT_SCRATCH_BUF_LEN - 1;
+    }
+
+    if( lLen > 0 )
+    {
+        pxConsoleIO->write( pcCliScratchBuffer, ( uint32_t ) lLen );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
 static void prvHelpCommand( ConsoleIO_t * const pxConsoleIO,
                             uint32_t ulArgc,
                             char * ppcArgv[] )
@@ -347,6 +367,12 @@ void Task_CLI( void * pvParameters )
     FreeRTOS_CLIRegisterCommand( &xCommandDef_uptime );
     FreeRTOS_CLIRegisterCommand( &xCommandDef_rngtest );
     FreeRTOS_CLIRegisterCommand( &xCommandDef_assert );
+    FreeRTOS_CLIRegisterCommand( &xCommandDef_lwiptune );
+    #ifndef TFM_PSA_API
+        #if LFS_PORT_DEFAULT_FS_INTERNAL_FLASH == 1
+            FreeRTOS_CLIRegisterCommand( &xCommandDef_flashwear );
+        #endif
+    #endif
 
     char * pcCommandBuffer = NULL;
 
@@ -121,6 +121,15 @@ void FreeRTOS_CLIProcessCommand( ConsoleIO_t * const pxConsoleIO,
  */
 char * FreeRTOS_CLIGetOutputBuffer( void );
 
+/*
+ * @brief Write the first lLen characters of pcCliScratchBuffer to the console.
+ * @param[in] pxConsoleIO Pointer to the ConsoleIO object to write to.
+ * @param[in] lLen Length returned by the snprintf call that filled the buffer. Truncated output is
+ * written up to the end of the buffer, and nothing is written for a negative length.
+ */
+void vCliPrintScratchBuffer( ConsoleIO_t * const pxConsoleIO,
+                             int lLen );
+
 UART_HandleTypeDef * vInitUartEarly( void );
 
 extern const CLI_Command_Definition_t xCommandDef_conf;
@@ -133,5 +142,10 @@ extern const CLI_Command_Definition_t xCommandDef_reset;
 extern const CLI_Command_Definition_t xCommandDef_uptime;
 extern const CLI_Command_Definition_t xCommandDef_rngtest;
 extern const CLI_Command_Definition_t xCommandDef_assert;
+extern const CLI_Command_Definition_t xCommandDef_lwiptune;
+
+#ifndef TFM_PSA_API
+    extern const CLI_Command_Definition_t xCommandDef_flashwear;
+#endif
 
 #endif /* _CLI_PRIV */
@@ -66,6 +66,16 @@
  *
  * Set to 1 to enable use of long key names in the defender report.
  */
-#define DEFENDER_USE_LONG_KEYS    0
+#define DEFENDER_USE_LONG_KEYS          0
+
+/**
+ * Set to 1 to add the lwIP tuning figures to each report as custom metrics of
+ * type number-list: lwip_pbuf_pool, lwip_tcp_seg, lwip_heap and lwip_mbox as
+ * [ size, peak, failures ], and lwip_tcp as
+ * [ segments out, retransmitted, out of order peak, dropped ].
+ * The custom metrics must be defined in AWS IoT Device Defender first, or the
+ * reports are rejected.
+ */
+#define DEFENDER_LWIP_TUNING_METRICS    0
 
 #endif /* ifndef DEFENDER_CONFIG_H_ */
@@ -39,6 +39,8 @@ typedef enum KvStoreEnum
     CS_WIFI_SSID,
     CS_WIFI_CREDENTIAL,
     CS_TIME_HWM_S_1970,
+    CS_WIFI_FAST_CONNECT,
+    CS_DNS_CACHE,
     CS_NUM_KEYS
 } KVStoreKey_t;
 
@@ -106,7 +108,9 @@ typedef enum KvStoreEnum
         "mqtt_port",       \
         "wifi_ssid",       \
         "wifi_credential", \
-        "time_hwm"         \
+        "time_hwm",        \
+        "wifi_fast_conn",  \
+        "dns_cache"        \
     }
 
 #define KV_STORE_DEFAULTS                                                          \
@@ -117,6 +121,8 @@ typedef enum KvStoreEnum
         KV_DFLT( KV_TYPE_STRING, WIFI_SSID_DFLT ),     /* CS_WIFI_SSID */          \
         KV_DFLT( KV_TYPE_STRING, WIFI_PASSWORD_DFLT ), /* CS_WIFI_CREDENTIAL */    \
         KV_DFLT( KV_TYPE_UINT32, 0 ),                  /* CS_TIME_HWM_S_1970 */    \
+        KV_DFLT( KV_TYPE_BLOB, "" ),                   /* CS_WIFI_FAST_CONNECT */  \
+        KV_DFLT( KV_TYPE_BLOB, "" ),                   /* CS_DNS_CACHE */          \
     }
 
 #endif /* _KVSTORE_CONFIG_H */
@@ -130,7 +130,7 @@
 
 #define TCP_SND_QUEUELEN    ( 4 * TCP_SND_BUF / TCP_MSS )
 
-/* TCP receive window. */
+/* Pool pbufs for received frames, including the MX_RX_RING_LEN (4) the mxchip dataplane keeps armed. */
 #define PBUF_POOL_SIZE      40
 
 
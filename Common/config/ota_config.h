@@ -112,8 +112,12 @@
  *
  * The wait timer is reset whenever a data block is received from the OTA service so we will only send
  * the request message after being idle for this amount of time.
+ *
+ * The next window of blocks is only requested once every block of the current window has been received,
+ * so this is also how long a single dropped block stalls the download. Requests issued after a timeout
+ * only ask for blocks missing from the bitmap, so a short timeout does not cause duplicate transfers.
  */
-#define otaconfigFILE_REQUEST_WAIT_MS           10000U
+#define otaconfigFILE_REQUEST_WAIT_MS           3000U
 
 /**
  * @brief The maximum allowed length of the thing name used by the OTA agent.
@@ -136,8 +140,16 @@
  *  how many data blocks response is expected for each data requests.
  *  Please note that this must be set larger than zero.
  *
+ *  This is the request window of the MQTT data path: the agent waits for every block of a request
+ *  before sending the next one, so throughput is bounded by
+ *  ( otaconfigMAX_NUM_BLOCKS_REQUEST * otaconfigFILE_BLOCK_SIZE ) / round trip time.
+ *  8 blocks of 2 KB reach about 65 KB/s over a 200 ms round trip on a 400 KB/s link.
+ *  The OTA update task periodically logs the measured round trip time and block spacing along
+ *  with the window size they call for. tools/ota_stream_sim.py sweep simulates the download
+ *  against a streams service with a given round trip time, link rate and loss rate.
+ *
  */
-#define otaconfigMAX_NUM_BLOCKS_REQUEST         2U
+#define otaconfigMAX_NUM_BLOCKS_REQUEST         8U
 
 /**
  * @brief The maximum number of requests allowed to send without a response before we abort.
@@ -153,6 +165,10 @@
  *
  * This configurations parameter sets the maximum number of static data buffers used by
  * the OTA agent for job and file data blocks received.
+ *
+ * A whole request window may arrive before the agent task writes the first block to flash,
+ * so one buffer is reserved per requested block plus one for control messages. Blocks that
+ * arrive while every buffer is in use are dropped and requested again.
  */
 #define otaconfigMAX_NUM_OTA_DATA_BUFFERS       ( otaconfigMAX_NUM_BLOCKS_REQUEST + 1 )
 
@@ -207,6 +223,9 @@
  * Enable data over MQTT - ( OTA_DATA_OVER_MQTT )
  * Enable data over HTTP - ( OTA_DATA_OVER_HTTP)
  * Enable data over both MQTT & HTTP ( OTA_DATA_OVER_MQTT | OTA_DATA_OVER_HTTP )
+ *
+ * The HTTP data path is opt-in. Add OTA_DATA_OVER_HTTP here to download images that offer a
+ * pre-signed URL with ranged GETs, and set configOTA_PRIMARY_DATA_PROTOCOL to prefer it.
  */
 #define configENABLED_DATA_PROTOCOLS      ( OTA_DATA_OVER_MQTT )
 
@@ -218,6 +237,9 @@
  * and following update here to switch to HTTP as primary.
  *
  * Note - use OTA_DATA_OVER_HTTP for HTTP as primary data protocol.
+ *
+ * HTTP downloads fetch otaconfigMAX_NUM_BLOCKS_REQUEST blocks per ranged GET over a separate
+ * TLS connection to the pre-signed URL, which avoids the per block overhead of the MQTT stream.
  */
 
 #define configOTA_PRIMARY_DATA_PROTOCOL    OTA_DATA_OVER_MQTT
@@ -0,0 +1,96 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file dns_cache.h
+ * @brief Cache of resolved IPv4 addresses for the TLS transport.
+ *
+ * Addresses are served from the cache while fresh. Once stale, they are still
+ * served while a background lookup refreshes them. Addresses are kept in the
+ * KV store so the first connection after a reset does not wait for DNS either.
+ * lwIP resolves a single address per lookup, so the addresses of a host
+ * accumulate over lookups, up to DNS_CACHE_MAX_ADDRS.
+ */
+
+#ifndef _DNS_CACHE_H
+#define _DNS_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+
+/* Number of hosts cached */
+#ifndef DNS_CACHE_MAX_HOSTS
+    #define DNS_CACHE_MAX_HOSTS    2
+#endif
+
+/* Number of addresses kept per host */
+#ifndef DNS_CACHE_MAX_ADDRS
+    #define DNS_CACHE_MAX_ADDRS    4
+#endif
+
+/* Consecutive connection failures after which an address is dropped from the cache */
+#ifndef DNS_CACHE_MAX_FAILURES
+    #define DNS_CACHE_MAX_FAILURES    3
+#endif
+
+/* Time after a lookup during which cached addresses are used without revalidation */
+#ifndef DNS_CACHE_FRESH_S
+    #define DNS_CACHE_FRESH_S    ( 5UL * 60UL )
+#endif
+
+/* Time after a lookup during which cached addresses are used while being revalidated */
+#ifndef DNS_CACHE_STALE_S
+    #define DNS_CACHE_STALE_S    ( 24UL * 60UL * 60UL )
+#endif
+
+typedef struct
+{
+    uint32_t ulAddrs[ DNS_CACHE_MAX_ADDRS ]; /* IPv4 addresses, network byte order */
+    size_t uxCount;
+    BaseType_t xFromCache;                   /* pdTRUE when no lookup was done */
+} DnsCacheResult_t;
+
+/**
+ * @brief Resolve pcHostName, using the cache unless xBypassCache is pdTRUE.
+ *
+ * When a lookup fails, addresses cached for the host are returned regardless of their age.
+ * When xBypassCache is pdTRUE and the lookup succeeds, only the addresses it found are returned.
+ * The cache is written to the KV store later, from the timer service task.
+ *
+ * @return pdTRUE when at least one address was returned in pxResult.
+ */
+BaseType_t xDnsCacheResolve( const char * pcHostName,
+                             DnsCacheResult_t * pxResult,
+                             BaseType_t xBypassCache );
+
+/**
+ * @brief Report the outcome of a connection to ulAddr so that the
+ * addresses that work are tried first next time, and addresses that
+ * fail DNS_CACHE_MAX_FAILURES times in a row are dropped.
+ */
+void vDnsCacheReportConnect( const char * pcHostName,
+                             uint32_t ulAddr,
+                             BaseType_t xSuccess );
+
+#endif /* _DNS_CACHE_H */
@@ -115,5 +115,6 @@ const char * kvKeyToString( KVStoreKey_t xKey );
 KVStoreKey_t kvStringToKey( const char * pcKey );
 
 BaseType_t KVStore_xCommitChanges( void );
+BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey );
 
 #endif /* _KVSTORE_H */
@@ -308,4 +308,33 @@
         return xSuccess;
     }
 
+/*
+ * @brief Write a single key to the nvm store if it has changed, leaving changes staged
+ * on other keys (for example by "conf set") for a later KVStore_xCommitChanges.
+ * @param[in] xKey The key to commit.
+ * @return pdTRUE if the key was written or had no change pending.
+ */
+    BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey )
+    {
+        BaseType_t xSuccess = pdTRUE;
+
+        configASSERT( xKey < CS_NUM_KEYS );
+
+        #if KV_STORE_NVIMPL_ENABLE
+            if( kvStoreCache[ xKey ].xChangePending == pdTRUE )
+            {
+                xSuccess = xprvWriteValueToImpl( xKey,
+                                                 kvStoreCache[ xKey ].type,
+                                                 kvStoreCache[ xKey ].length,
+                                                 pvGetDataReadPtr( xKey ) );
+
+                if( xSuccess == pdTRUE )
+                {
+                    kvStoreCache[ xKey ].xChangePending = pdFALSE;
+                }
+            }
+        #endif /* if KV_STORE_NVIMPL_ENABLE */
+        return xSuccess;
+    }
+
 #endif /* KV_STORE_CACHE_ENABLE */
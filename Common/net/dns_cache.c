@@ -0,0 +1,594 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file dns_cache.c
+ * @brief Cache of resolved IPv4 addresses with stale-while-revalidate and KV persistence.
+ */
+
+#include "logging_levels.h"
+
+#define LOG_LEVEL    LOG_INFO
+
+#include "logging.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "kvstore.h"
+#include "dns_cache.h"
+
+/* lwip includes */
+#include "lwip/tcpip.h"
+#include "lwip/dns.h"
+#include "lwip/netdb.h"
+#include "lwip/sockets.h"
+
+#define DNS_CACHE_MAGIC         0x444E5331UL /* "DNS1", changes with the record layout */
+
+#define DNS_CACHE_FRESH_TICKS    ( ( TickType_t ) DNS_CACHE_FRESH_S * configTICK_RATE_HZ )
+#define DNS_CACHE_STALE_TICKS    ( ( TickType_t ) DNS_CACHE_STALE_S * configTICK_RATE_HZ )
+
+#define FNV_OFFSET_BASIS         2166136261UL
+#define FNV_PRIME                16777619UL
+
+/*
+ * Hosts are identified by a hash of their name. A collision can only result in a
+ * connection to the wrong server, which then fails TLS server name verification.
+ */
+typedef struct
+{
+    uint32_t ulHostHash;
+    uint32_t ulCount;
+    uint32_t ulAddrs[ DNS_CACHE_MAX_ADDRS ];
+} DnsCacheHost_t;
+
+/* Record persisted in the CS_DNS_CACHE key */
+typedef struct
+{
+    uint32_t ulMagic;
+    DnsCacheHost_t xHosts[ DNS_CACHE_MAX_HOSTS ];
+} DnsCacheRecord_t;
+
+typedef struct
+{
+    DnsCacheHost_t xHost;
+    uint8_t ucFailures[ DNS_CACHE_MAX_ADDRS ]; /* Consecutive connection failures of each address, not persisted */
+    TickType_t xLookupTime;
+    BaseType_t xLookupTimeValid; /* pdFALSE until looked up since boot */
+} DnsCacheEntry_t;
+
+/* Accessed from the connecting tasks and the tcpip thread, within critical sections */
+static DnsCacheEntry_t xCacheEntries[ DNS_CACHE_MAX_HOSTS ];
+static BaseType_t xCacheLoaded = pdFALSE;
+static BaseType_t xCacheDirty = pdFALSE;
+static BaseType_t xSavePending = pdFALSE;
+
+/* Background revalidation, one host at a time */
+static BaseType_t xRevalidatePending = pdFALSE;
+static char pcRevalidateHost[ DNS_MAX_NAME_LENGTH + 1 ];
+
+/*-----------------------------------------------------------*/
+
+static uint32_t ulHashHostName( const char * pcHostName )
+{
+    uint32_t ulHash = FNV_OFFSET_BASIS;
+
+    for( const char * pcChar = pcHostName; *pcChar != '\0'; pcChar++ )
+    {
+        ulHash ^= ( uint8_t ) *pcChar;
+        ulHash *= FNV_PRIME;
+    }
+
+    return ulHash;
+}
+
+static DnsCacheEntry_t * pxFindEntry( uint32_t ulHostHash )
+{
+    DnsCacheEntry_t * pxEntry = NULL;
+
+    for( uint32_t i = 0; i < DNS_CACHE_MAX_HOSTS; i++ )
+    {
+        if( ( xCacheEntries[ i ].xHost.ulCount > 0 ) &&
+            ( xCacheEntries[ i ].xHost.ulHostHash == ulHostHash ) )
+        {
+            pxEntry = &( xCacheEntries[ i ] );
+            break;
+        }
+    }
+
+    return pxEntry;
+}
+
+/* Find the entry of a host or reuse the least recently looked up one */
+static DnsCacheEntry_t * pxGetEntry( uint32_t ulHostHash )
+{
+    DnsCacheEntry_t * pxEntry = pxFindEntry( ulHostHash );
+
+    if( pxEntry == NULL )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+        TickType_t xMaxAge = 0;
+
+        pxEntry = &( xCacheEntries[ 0 ] );
+
+        for( uint32_t i = 0; i < DNS_CACHE_MAX_HOSTS; i++ )
+        {
+            DnsCacheEntry_t * pxCandidate = &( xCacheEntries[ i ] );
+
+            if( ( pxCandidate->xHost.ulCount == 0 ) ||
+                ( pxCandidate->xLookupTimeValid == pdFALSE ) )
+            {
+                pxEntry = pxCandidate;
+                break;
+            }
+            else if( ( xNow - pxCandidate->xLookupTime ) > xMaxAge )
+            {
+                xMaxAge = xNow - pxCandidate->xLookupTime;
+                pxEntry = pxCandidate;
+            }
+            else
+            {
+                /* Younger than the current choice */
+            }
+        }
+
+        ( void ) memset( pxEntry, 0, sizeof( DnsCacheEntry_t ) );
+        pxEntry->xHost.ulHostHash = ulHostHash;
+    }
+
+    return pxEntry;
+}
+
+/* Move ulAddr to the front of the list, adding it if needed, and clear its failures */
+static void vPromoteAddress( DnsCacheEntry_t * pxEntry,
+                             uint32_t ulAddr )
+{
+    DnsCacheHost_t * pxHost = &( pxEntry->xHost );
+    uint32_t ulIndex = 0;
+
+    while( ( ulIndex < pxHost->ulCount ) &&
+           ( pxHost->ulAddrs[ ulIndex ] != ulAddr ) )
+    {
+        ulIndex++;
+    }
+
+    if( ulIndex == pxHost->ulCount )
+    {
+        /* New address, drop the last one if full */
+        if( pxHost->ulCount < DNS_CACHE_MAX_ADDRS )
+        {
+            pxHost->ulCount++;
+        }
+
+        ulIndex = pxHost->ulCount - 1;
+        xCacheDirty = pdTRUE;
+    }
+
+    ( void ) memmove( &( pxHost->ulAddrs[ 1 ] ), &( pxHost->ulAddrs[ 0 ] ), ulIndex * sizeof( uint32_t ) );
+    ( void ) memmove( &( pxEntry->ucFailures[ 1 ] ), &( pxEntry->ucFailures[ 0 ] ), ulIndex );
+    pxHost->ulAddrs[ 0 ] = ulAddr;
+    pxEntry->ucFailures[ 0 ] = 0;
+}
+
+/* Move ulAddr to the back of the list, or drop it after DNS_CACHE_MAX_FAILURES consecutive failures */
+static void vDemoteAddress( DnsCacheEntry_t * pxEntry,
+                            uint32_t ulAddr )
+{
+    DnsCacheHost_t * pxHost = &( pxEntry->xHost );
+
+    for( uint32_t i = 0; i < pxHost->ulCount; i++ )
+    {
+        if( pxHost->ulAddrs[ i ] == ulAddr )
+        {
+            uint8_t ucFailures = pxEntry->ucFailures[ i ] + 1;
+
+            ( void ) memmove( &( pxHost->ulAddrs[ i ] ), &( pxHost->ulAddrs[ i + 1 ] ),
+                              ( pxHost->ulCount - i - 1 ) * sizeof( uint32_t ) );
+            ( void ) memmove( &( pxEntry->ucFailures[ i ] ), &( pxEntry->ucFailures[ i + 1 ] ),
+                              pxHost->ulCount - i - 1 );
+
+            if( ucFailures >= DNS_CACHE_MAX_FAILURES )
+            {
+                /* A host left without addresses is looked up again on the next connection */
+                pxHost->ulCount--;
+                xCacheDirty = pdTRUE;
+            }
+            else
+            {
+                pxHost->ulAddrs[ pxHost->ulCount - 1 ] = ulAddr;
+                pxEntry->ucFailures[ pxHost->ulCount - 1 ] = ucFailures;
+            }
+
+            break;
+        }
+    }
+}
+
+/* Must be called within a critical section */
+static void vStoreAddress( uint32_t ulHostHash,
+                           uint32_t ulAddr )
+{
+    DnsCacheEntry_t * pxEntry = pxGetEntry( ulHostHash );
+
+    vPromoteAddress( pxEntry, ulAddr );
+    pxEntry->xLookupTime = xTaskGetTickCount();
+    pxEntry->xLookupTimeValid = pdTRUE;
+}
+
+static void vCopyResult( uint32_t ulHostHash,
+                         DnsCacheResult_t * pxResult )
+{
+    taskENTER_CRITICAL();
+    {
+        DnsCacheEntry_t * pxEntry = pxFindEntry( ulHostHash );
+
+        if( pxEntry != NULL )
+        {
+            ( void ) memcpy( pxResult->ulAddrs, pxEntry->xHost.ulAddrs, sizeof( pxResult->ulAddrs ) );
+            pxResult->uxCount = pxEntry->xHost.ulCount;
+        }
+    }
+    taskEXIT_CRITICAL();
+}
+
+/*-----------------------------------------------------------*/
+
+static void vLoadCache( void )
+{
+    if( xCacheLoaded == pdFALSE )
+    {
+        DnsCacheRecord_t xRecord = { 0 };
+        size_t xLength = KVStore_getBlob( CS_DNS_CACHE, &xRecord, sizeof( DnsCacheRecord_t ) );
+
+        taskENTER_CRITICAL();
+
+        if( xCacheLoaded == pdFALSE )
+        {
+            if( ( xLength == sizeof( DnsCacheRecord_t ) ) &&
+                ( xRecord.ulMagic == DNS_CACHE_MAGIC ) )
+            {
+                for( uint32_t i = 0; i < DNS_CACHE_MAX_HOSTS; i++ )
+                {
+                    if( xRecord.xHosts[ i ].ulCount <= DNS_CACHE_MAX_ADDRS )
+                    {
+                        xCacheEntries[ i ].xHost = xRecord.xHosts[ i ];
+                    }
+
+                    /* Age unknown, served stale until revalidated */
+                    xCacheEntries[ i ].xLookupTimeValid = pdFALSE;
+                }
+            }
+
+            xCacheLoaded = pdTRUE;
+        }
+
+        taskEXIT_CRITICAL();
+    }
+}
+
+/* Runs in the timer service task, so that connecting tasks do not wait for the flash write */
+static void vSaveCache( void * pvParameter1,
+                        uint32_t ulParameter2 )
+{
+    DnsCacheRecord_t xRecord;
+    BaseType_t xSave = pdFALSE;
+
+    ( void ) pvParameter1;
+    ( void ) ulParameter2;
+
+    taskENTER_CRITICAL();
+
+    xSavePending = pdFALSE;
+
+    if( xCacheDirty == pdTRUE )
+    {
+        xRecord.ulMagic = DNS_CACHE_MAGIC;
+
+        for( uint32_t i = 0; i < DNS_CACHE_MAX_HOSTS; i++ )
+        {
+            xRecord.xHosts[ i ] = xCacheEntries[ i ].xHost;
+        }
+
+        xCacheDirty = pdFALSE;
+        xSave = pdTRUE;
+    }
+
+    taskEXIT_CRITICAL();
+
+    /* Only written when the set of addresses changed, not on every reordering */
+    if( xSave == pdTRUE )
+    {
+        if( ( KVStore_setBlob( CS_DNS_CACHE, sizeof( DnsCacheRecord_t ), &xRecord ) == pdFALSE ) ||
+            ( KVStore_xCommitKey( CS_DNS_CACHE ) == pdFALSE ) )
+        {
+            LogWarn( "Failed to save DNS cache." );
+        }
+    }
+}
+
+static void vScheduleSave( void )
+{
+    BaseType_t xSchedule = pdFALSE;
+
+    taskENTER_CRITICAL();
+
+    if( ( xCacheDirty == pdTRUE ) && ( xSavePending == pdFALSE ) )
+    {
+        xSavePending = pdTRUE;
+        xSchedule = pdTRUE;
+    }
+
+    taskEXIT_CRITICAL();
+
+    /* On failure the cache stays dirty and the next resolve tries again */
+    if( ( xSchedule == pdTRUE ) &&
+        ( xTimerPendFunctionCall( vSaveCache, NULL, 0, 0 ) == pdFAIL ) )
+    {
+        xSavePending = pdFALSE;
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Runs in the tcpip thread */
+static void vDnsFoundCallback( const char * pcName,
+                               const ip_addr_t * pxAddr,
+                               void * pvArg )
+{
+    ( void ) pvArg;
+
+    if( ( pxAddr != NULL ) && IP_IS_V4( pxAddr ) )
+    {
+        uint32_t ulHostHash = ulHashHostName( pcName );
+
+        taskENTER_CRITICAL();
+        vStoreAddress( ulHostHash, ip4_addr_get_u32( ip_2_ip4( pxAddr ) ) );
+        taskEXIT_CRITICAL();
+    }
+
+    xRevalidatePending = pdFALSE;
+}
+
+/* Runs in the tcpip thread */
+static void vRevalidateCallback( void * pvArg )
+{
+    ip_addr_t xAddr;
+    err_t xError;
+
+    ( void ) pvArg;
+
+    xError = dns_gethostbyname( pcRevalidateHost, &xAddr, vDnsFoundCallback, NULL );
+
+    if( xError == ERR_OK )
+    {
+        /* Answered from the lwip DNS table, which honors the record TTL */
+        vDnsFoundCallback( pcRevalidateHost, &xAddr, NULL );
+    }
+    else if( xError != ERR_INPROGRESS )
+    {
+        vDnsFoundCallback( pcRevalidateHost, NULL, NULL );
+    }
+    else
+    {
+        /* vDnsFoundCallback is called when the lookup completes */
+    }
+}
+
+static void vStartRevalidate( const char * pcHostName )
+{
+    BaseType_t xStart = pdFALSE;
+
+    taskENTER_CRITICAL();
+
+    if( xRevalidatePending == pdFALSE )
+    {
+        ( void ) strncpy( pcRevalidateHost, pcHostName, DNS_MAX_NAME_LENGTH );
+        pcRevalidateHost[ DNS_MAX_NAME_LENGTH ] = '\0';
+        xRevalidatePending = pdTRUE;
+        xStart = pdTRUE;
+    }
+
+    taskEXIT_CRITICAL();
+
+    if( ( xStart == pdTRUE ) &&
+        ( tcpip_callback( vRevalidateCallback, NULL ) != ERR_OK ) )
+    {
+        xRevalidatePending = pdFALSE;
+    }
+}
+
+/* Look up pcHostName, store the addresses found and copy them to pxResult if it is not NULL */
+static BaseType_t xLookupHost( const char * pcHostName,
+                               uint32_t ulHostHash,
+                               DnsCacheResult_t * pxResult )
+{
+    BaseType_t xSuccess = pdFALSE;
+    struct addrinfo * pxAddrInfo = NULL;
+
+    const struct addrinfo xAddrInfoHint =
+    {
+        .ai_family   = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+        .ai_protocol = IPPROTO_TCP,
+    };
+
+    if( ( lwip_getaddrinfo( pcHostName, NULL, &xAddrInfoHint, &pxAddrInfo ) == 0 ) &&
+        ( pxAddrInfo != NULL ) )
+    {
+        /* Stored last to first so that the first address ends up in front */
+        uint32_t ulAddrs[ DNS_CACHE_MAX_ADDRS ];
+        uint32_t ulCount = 0;
+
+        for( struct addrinfo * pxIter = pxAddrInfo;
+             ( pxIter != NULL ) && ( ulCount < DNS_CACHE_MAX_ADDRS );
+             pxIter = pxIter->ai_next )
+        {
+            if( pxIter->ai_family == AF_INET )
+            {
+                ulAddrs[ ulCount ] = ( ( struct sockaddr_in * ) pxIter->ai_addr )->sin_addr.s_addr;
+                ulCount++;
+            }
+        }
+
+        if( pxResult != NULL )
+        {
+            ( void ) memcpy( pxResult->ulAddrs, ulAddrs, ulCount * sizeof( uint32_t ) );
+            pxResult->uxCount = ulCount;
+        }
+
+        taskENTER_CRITICAL();
+
+        while( ulCount > 0 )
+        {
+            ulCount--;
+            vStoreAddress( ulHostHash, ulAddrs[ ulCount ] );
+            xSuccess = pdTRUE;
+        }
+
+        taskEXIT_CRITICAL();
+    }
+
+    if( pxAddrInfo != NULL )
+    {
+        lwip_freeaddrinfo( pxAddrInfo );
+    }
+
+    return xSuccess;
+}
+
+/*-----------------------------------------------------------*/
+
+BaseType_t xDnsCacheResolve( const char * pcHostName,
+                             DnsCacheResult_t * pxResult,
+                             BaseType_t xBypassCache )
+{
+    uint32_t ulHostHash;
+    BaseType_t xLookup = xBypassCache;
+    BaseType_t xRevalidate = pdFALSE;
+
+    configASSERT( pcHostName != NULL );
+    configASSERT( pxResult != NULL );
+
+    ( void ) memset( pxResult, 0, sizeof( DnsCacheResult_t ) );
+
+    vLoadCache();
+
+    ulHostHash = ulHashHostName( pcHostName );
+
+    taskENTER_CRITICAL();
+    {
+        DnsCacheEntry_t * pxEntry = pxFindEntry( ulHostHash );
+
+        if( pxEntry == NULL )
+        {
+            xLookup = pdTRUE;
+        }
+        else if( pxEntry->xLookupTimeValid == pdFALSE )
+        {
+            xRevalidate = pdTRUE;
+        }
+        else
+        {
+            TickType_t xAge = xTaskGetTickCount() - pxEntry->xLookupTime;
+
+            if( xAge >= DNS_CACHE_STALE_TICKS )
+            {
+                xLookup = pdTRUE;
+            }
+            else if( xAge >= DNS_CACHE_FRESH_TICKS )
+            {
+                xRevalidate = pdTRUE;
+            }
+            else
+            {
+                /* Fresh */
+            }
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    if( xLookup == pdTRUE )
+    {
+        /* A forced lookup returns only what it found, without the addresses already cached */
+        if( xLookupHost( pcHostName, ulHostHash, ( xBypassCache == pdTRUE ) ? pxResult : NULL ) == pdFALSE )
+        {
+            LogWarn( "Failed to resolve hostname: %s, using cached addresses if any.", pcHostName );
+            pxResult->xFromCache = pdTRUE;
+        }
+    }
+    else
+    {
+        pxResult->xFromCache = pdTRUE;
+
+        if( xRevalidate == pdTRUE )
+        {
+            vStartRevalidate( pcHostName );
+        }
+    }
+
+    if( pxResult->uxCount == 0 )
+    {
+        vCopyResult( ulHostHash, pxResult );
+    }
+
+    vScheduleSave();
+
+    return( pxResult->uxCount > 0 ) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+void vDnsCacheReportConnect( const char * pcHostName,
+                             uint32_t ulAddr,
+                             BaseType_t xSuccess )
+{
+    uint32_t ulHostHash;
+
+    configASSERT( pcHostName != NULL );
+
+    ulHostHash = ulHashHostName( pcHostName );
+
+    taskENTER_CRITICAL();
+    {
+        DnsCacheEntry_t * pxEntry = pxFindEntry( ulHostHash );
+
+        if( pxEntry == NULL )
+        {
+            /* Evicted in the meantime */
+        }
+        else if( xSuccess == pdTRUE )
+        {
+            vPromoteAddress( pxEntry, ulAddr );
+        }
+        else
+        {
+            vDemoteAddress( pxEntry, ulAddr );
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    vScheduleSave();
+}
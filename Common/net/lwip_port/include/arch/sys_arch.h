@@ -57,6 +57,33 @@ typedef struct sys_mbox sys_mbox_t;
 #define sys_sem_valid( x )           ( ( ( * x ) == NULL ) ? pdFALSE : pdTRUE )
 #define sys_sem_set_invalid( x )     ( ( * x ) = NULL )
 
+/* Highest number of messages seen queued in the tcpip thread mailbox, posts it refused, and their reset */
+uint32_t sys_arch_tcpip_mbox_depth_max( void );
+uint32_t sys_arch_tcpip_mbox_full( void );
+void sys_arch_tcpip_mbox_stats_reset( void );
+
+/* Static object pools, used when SYS_ARCH_STATIC_POOLS is 1 */
+typedef enum
+{
+    SYS_ARCH_POOL_MBOX,
+    SYS_ARCH_POOL_SEM,
+    SYS_ARCH_POOL_MUTEX,
+    SYS_ARCH_POOL_MAX
+} sys_arch_pool_t;
+
+typedef struct
+{
+    uint32_t ulSize;      /* Number of slots */
+    uint32_t ulSlotSize;  /* Bytes of RAM per slot */
+    uint32_t ulUsed;
+    uint32_t ulHighWater;
+    uint32_t ulOverflows; /* Objects allocated from the heap because the pool was empty */
+} sys_arch_pool_stats_t;
+
+void sys_arch_pool_stats( sys_arch_pool_t xPool,
+                          sys_arch_pool_stats_t * pxStats );
+void sys_arch_pool_stats_reset( void );
+
 
 #define sys_assert( pcMessage )                                 \
     do {                                                        \
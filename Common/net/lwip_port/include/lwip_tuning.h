@@ -0,0 +1,86 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef _LWIP_TUNING_H_
+#define _LWIP_TUNING_H_
+
+#include <stdint.h>
+
+#include "lwip/opt.h"
+#include "lwip/memp.h"
+#include "lwip/sys.h"
+
+/* Period of the sampler that tracks TCP queues, which lwIP has no statistics for.
+ * The sampler only runs while switched on with vLwipTuningSetSampling. */
+#define LWIP_TUNING_SAMPLE_MS          100
+
+/* Headroom kept above an observed high-water mark: a quarter, and at least this many elements */
+#define LWIP_TUNING_MIN_HEADROOM       2
+
+/* A resource that is sized by a lwipopts.h option */
+typedef struct
+{
+    const char * pcOption; /* lwipopts.h option that sets ulSize */
+    uint32_t ulSize;       /* Configured number of elements, or bytes for the heap */
+    uint32_t ulElemSize;   /* Bytes of RAM per element */
+    uint32_t ulUsed;
+    uint32_t ulHighWater;
+    uint32_t ulFailures;   /* Allocations or posts refused because the resource was exhausted */
+} LwipTuningResource_t;
+
+typedef struct
+{
+    LwipTuningResource_t xPools[ MEMP_MAX ];
+    LwipTuningResource_t xHeap;
+    LwipTuningResource_t xMbox;     /* Deepest tcpip thread mailbox against TCPIP_MBOX_SIZE */
+    LwipTuningResource_t xSndQueue; /* Longest per connection send queue against TCP_SND_QUEUELEN */
+    LwipTuningResource_t xSysPools[ SYS_ARCH_POOL_MAX ]; /* sys_arch static object pools, empty if disabled */
+    uint32_t ulTcpOutSegs;
+    uint32_t ulTcpRetransSegs;
+    uint32_t ulTcpInSegs;
+    uint32_t ulTcpDrops;
+    uint32_t ulOoseqHighWater;      /* Most out of order segments held by one connection */
+    uint32_t ulOoseqSamples;        /* Samples in which some connection held out of order segments */
+    uint32_t ulSamples;
+    BaseType_t xSampling;           /* pdTRUE while the TCP queue sampler is running */
+} LwipTuningSnapshot_t;
+
+/* Start the measurement window. Must be called from the tcpip thread, for example from the tcpip_init callback. */
+void vLwipTuningInit( void );
+
+/* Start or stop sampling the TCP queues every LWIP_TUNING_SAMPLE_MS. Sampling is off after boot. */
+void vLwipTuningSetSampling( BaseType_t xEnable );
+
+/* Copy the current counters and high-water marks */
+void vLwipTuningGetSnapshot( LwipTuningSnapshot_t * pxSnapshot );
+
+/* Restart the measurement window */
+void vLwipTuningReset( void );
+
+/* Suggested size for a resource given its high-water mark and failures */
+uint32_t ulLwipTuningRecommend( const LwipTuningResource_t * pxResource );
+
+#endif /* _LWIP_TUNING_H_ */
@@ -126,6 +126,37 @@
  */
 #define MEMP_NUM_NETCONN           32
 
+/*
+ * ---------------------------------------
+ * ---------- sys_arch options ----------
+ * ---------------------------------------
+ */
+
+/* SYS_ARCH_STATIC_POOLS==1: Create mailboxes, semaphores and mutexes from
+ * statically allocated pools instead of the FreeRTOS heap, so that sockets
+ * coming and going do not fragment it. When a pool is empty, the object is
+ * allocated from the heap instead and counted as an overflow. */
+#define SYS_ARCH_STATIC_POOLS       1
+
+/* One mailbox per netconn (recvmbox or acceptmbox) and the tcpip mailbox. */
+#define SYS_ARCH_MBOX_POOL_SIZE     ( MEMP_NUM_NETCONN + 1 )
+
+/* Largest mailbox held by the pool: the largest of TCPIP_MBOX_SIZE and the
+ * DEFAULT_*_MBOX_SIZE options. Larger mailboxes come from the heap. */
+#define SYS_ARCH_MAX( a, b )        ( ( ( a ) > ( b ) ) ? ( a ) : ( b ) )
+#define SYS_ARCH_MBOX_MAX_LEN                                                       \
+    SYS_ARCH_MAX( SYS_ARCH_MAX( TCPIP_MBOX_SIZE, DEFAULT_ACCEPTMBOX_SIZE ),         \
+                  SYS_ARCH_MAX( DEFAULT_RAW_RECVMBOX_SIZE,                          \
+                                SYS_ARCH_MAX( DEFAULT_UDP_RECVMBOX_SIZE,            \
+                                              DEFAULT_TCP_RECVMBOX_SIZE ) ) )
+
+/* One op_completed semaphore per netconn, plus the transient ones used by
+ * select() and DNS lookups. */
+#define SYS_ARCH_SEM_POOL_SIZE      ( MEMP_NUM_NETCONN + 8 )
+
+/* The tcpip core lock and the heap mutex, with some spare. */
+#define SYS_ARCH_MUTEX_POOL_SIZE    4
+
 /*
  * ----------------------------------
  * ---------- Pbuf options ----------
@@ -0,0 +1,309 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+/*
+ * Tracks how much of each lwIP pool, the heap, the mailboxes and the TCP
+ * queues is actually used, so that lwipopts.h can be sized from data.
+ * Pool and heap high-water marks come from the lwIP statistics. TCP send
+ * and out of order queues have no statistics, so while sampling is switched
+ * on they are sampled from the tcpip thread every LWIP_TUNING_SAMPLE_MS.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+/* Standard includes. */
+#include <stdint.h>
+#include <string.h>
+
+#include "lwip_tuning.h"
+
+/* Lwip includes. */
+#include "lwip/sys.h"
+#include "lwip/stats.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/memp_priv.h"
+#include "lwip/priv/tcp_priv.h"
+
+#if ( MEMP_STATS == 0 ) || ( MEM_STATS == 0 ) || ( TCP_STATS == 0 ) || ( MIB2_STATS == 0 )
+    #error "lwip_tuning.c requires LWIP_STATS and MIB2_STATS to be enabled."
+#endif
+
+/* The lwipopts.h option sizing each memp pool, in memp_t order */
+static const char * const pcPoolOptions[ MEMP_MAX ] =
+{
+    #define LWIP_MEMPOOL( name, num, size, desc )             "MEMP_NUM_" #name,
+    #define LWIP_PBUF_MEMPOOL( name, num, payload, desc )     "PBUF_POOL_SIZE",
+    #include "lwip/priv/memp_std.h"
+};
+
+/* The lwipopts.h option sizing each sys_arch pool, in sys_arch_pool_t order */
+static const char * const pcSysPoolOptions[ SYS_ARCH_POOL_MAX ] =
+{
+    "SYS_ARCH_MBOX_POOL_SIZE",
+    "SYS_ARCH_SEM_POOL_SIZE",
+    "SYS_ARCH_MUTEX_POOL_SIZE"
+};
+
+/* Sampled state, only written from the tcpip thread or with the core lock held */
+static uint32_t ulSndQueueHighWater = 0;
+static uint32_t ulOoseqHighWater = 0;
+static uint32_t ulOoseqSamples = 0;
+static uint32_t ulSamples = 0;
+static BaseType_t xSampling = pdFALSE;
+
+/* MIB2 counters are shared with other users, so windows are kept as offsets */
+static uint32_t ulTcpOutSegsBase = 0;
+static uint32_t ulTcpRetransSegsBase = 0;
+static uint32_t ulTcpInSegsBase = 0;
+
+/*-----------------------------------------------------------*/
+
+static void prvSampleTcpQueues( void * pvArg )
+{
+    BaseType_t xOoseqSeen = pdFALSE;
+
+    ( void ) pvArg;
+
+    for( struct tcp_pcb * pxPcb = tcp_active_pcbs; pxPcb != NULL; pxPcb = pxPcb->next )
+    {
+        if( pxPcb->snd_queuelen > ulSndQueueHighWater )
+        {
+            ulSndQueueHighWater = pxPcb->snd_queuelen;
+        }
+
+        #if TCP_QUEUE_OOSEQ
+        {
+            uint32_t ulOoseqSegs = 0;
+
+            for( struct tcp_seg * pxSeg = pxPcb->ooseq; pxSeg != NULL; pxSeg = pxSeg->next )
+            {
+                ulOoseqSegs++;
+            }
+
+            if( ulOoseqSegs > 0 )
+            {
+                xOoseqSeen = pdTRUE;
+            }
+
+            if( ulOoseqSegs > ulOoseqHighWater )
+            {
+                ulOoseqHighWater = ulOoseqSegs;
+            }
+        }
+        #endif /* TCP_QUEUE_OOSEQ */
+    }
+
+    if( xOoseqSeen == pdTRUE )
+    {
+        ulOoseqSamples++;
+    }
+
+    ulSamples++;
+
+    if( xSampling == pdTRUE )
+    {
+        sys_timeout( LWIP_TUNING_SAMPLE_MS, prvSampleTcpQueues, NULL );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+void vLwipTuningInit( void )
+{
+    ulTcpOutSegsBase = lwip_stats.mib2.tcpoutsegs;
+    ulTcpRetransSegsBase = lwip_stats.mib2.tcpretranssegs;
+    ulTcpInSegsBase = lwip_stats.mib2.tcpinsegs;
+}
+
+/*-----------------------------------------------------------*/
+
+void vLwipTuningSetSampling( BaseType_t xEnable )
+{
+    LOCK_TCPIP_CORE();
+
+    if( ( xEnable == pdTRUE ) && ( xSampling == pdFALSE ) )
+    {
+        xSampling = pdTRUE;
+        sys_timeout( LWIP_TUNING_SAMPLE_MS, prvSampleTcpQueues, NULL );
+    }
+    else if( ( xEnable == pdFALSE ) && ( xSampling == pdTRUE ) )
+    {
+        xSampling = pdFALSE;
+        sys_untimeout( prvSampleTcpQueues, NULL );
+    }
+    else
+    {
+        /* Already in the requested state */
+    }
+
+    UNLOCK_TCPIP_CORE();
+}
+
+/*-----------------------------------------------------------*/
+
+static void prvFillResource( LwipTuningResource_t * pxResource,
+                            const char * pcOption,
+                            uint32_t ulSize,
+                            uint32_t ulElemSize,
+                            const struct stats_mem * pxStats )
+{
+    pxResource->pcOption = pcOption;
+    pxResource->ulSize = ulSize;
+    pxResource->ulElemSize = ulElemSize;
+    pxResource->ulUsed = pxStats->used;
+    pxResource->ulHighWater = pxStats->max;
+    pxResource->ulFailures = pxStats->err;
+}
+
+void vLwipTuningGetSnapshot( LwipTuningSnapshot_t * pxSnapshot )
+{
+    configASSERT( pxSnapshot != NULL );
+
+    ( void ) memset( pxSnapshot, 0, sizeof( LwipTuningSnapshot_t ) );
+
+    LOCK_TCPIP_CORE();
+
+    for( uint32_t ulPool = 0; ulPool < MEMP_MAX; ulPool++ )
+    {
+        prvFillResource( &( pxSnapshot->xPools[ ulPool ] ),
+                         pcPoolOptions[ ulPool ],
+                         memp_pools[ ulPool ]->num,
+                         memp_pools[ ulPool ]->size,
+                         lwip_stats.memp[ ulPool ] );
+    }
+
+    prvFillResource( &( pxSnapshot->xHeap ), "MEM_SIZE", MEM_SIZE, 1, &( lwip_stats.mem ) );
+
+    pxSnapshot->xMbox.pcOption = "TCPIP_MBOX_SIZE";
+    pxSnapshot->xMbox.ulSize = TCPIP_MBOX_SIZE;
+    pxSnapshot->xMbox.ulElemSize = sizeof( void * );
+    pxSnapshot->xMbox.ulHighWater = sys_arch_tcpip_mbox_depth_max();
+    pxSnapshot->xMbox.ulFailures = sys_arch_tcpip_mbox_full();
+
+    /* Queued segments live in the TCP_SEG pool and pbufs, so no RAM is attributed here */
+    pxSnapshot->xSndQueue.pcOption = "TCP_SND_QUEUELEN";
+    pxSnapshot->xSndQueue.ulSize = TCP_SND_QUEUELEN;
+    pxSnapshot->xSndQueue.ulElemSize = 0;
+    pxSnapshot->xSndQueue.ulHighWater = ulSndQueueHighWater;
+    pxSnapshot->xSndQueue.ulFailures = lwip_stats.tcp.memerr;
+
+    for( uint32_t ulPool = 0; ulPool < SYS_ARCH_POOL_MAX; ulPool++ )
+    {
+        sys_arch_pool_stats_t xPoolStats;
+
+        sys_arch_pool_stats( ( sys_arch_pool_t ) ulPool, &xPoolStats );
+
+        pxSnapshot->xSysPools[ ulPool ].pcOption = pcSysPoolOptions[ ulPool ];
+        pxSnapshot->xSysPools[ ulPool ].ulSize = xPoolStats.ulSize;
+        pxSnapshot->xSysPools[ ulPool ].ulElemSize = xPoolStats.ulSlotSize;
+        pxSnapshot->xSysPools[ ulPool ].ulUsed = xPoolStats.ulUsed;
+        pxSnapshot->xSysPools[ ulPool ].ulHighWater = xPoolStats.ulHighWater;
+        pxSnapshot->xSysPools[ ulPool ].ulFailures = xPoolStats.ulOverflows;
+    }
+
+    pxSnapshot->ulTcpOutSegs = lwip_stats.mib2.tcpoutsegs - ulTcpOutSegsBase;
+    pxSnapshot->ulTcpRetransSegs = lwip_stats.mib2.tcpretranssegs - ulTcpRetransSegsBase;
+    pxSnapshot->ulTcpInSegs = lwip_stats.mib2.tcpinsegs - ulTcpInSegsBase;
+    pxSnapshot->ulTcpDrops = lwip_stats.tcp.drop;
+    pxSnapshot->ulOoseqHighWater = ulOoseqHighWater;
+    pxSnapshot->ulOoseqSamples = ulOoseqSamples;
+    pxSnapshot->ulSamples = ulSamples;
+    pxSnapshot->xSampling = xSampling;
+
+    UNLOCK_TCPIP_CORE();
+}
+
+/*-----------------------------------------------------------*/
+
+void vLwipTuningReset( void )
+{
+    LOCK_TCPIP_CORE();
+
+    for( uint32_t ulPool = 0; ulPool < MEMP_MAX; ulPool++ )
+    {
+        lwip_stats.memp[ ulPool ]->max = lwip_stats.memp[ ulPool ]->used;
+        lwip_stats.memp[ ulPool ]->err = 0;
+    }
+
+    lwip_stats.mem.max = lwip_stats.mem.used;
+    lwip_stats.mem.err = 0;
+    lwip_stats.sys.mbox.err = 0;
+    lwip_stats.tcp.memerr = 0;
+    lwip_stats.tcp.drop = 0;
+
+    ulTcpOutSegsBase = lwip_stats.mib2.tcpoutsegs;
+    ulTcpRetransSegsBase = lwip_stats.mib2.tcpretranssegs;
+    ulTcpInSegsBase = lwip_stats.mib2.tcpinsegs;
+
+    ulSndQueueHighWater = 0;
+    ulOoseqHighWater = 0;
+    ulOoseqSamples = 0;
+    ulSamples = 0;
+
+    sys_arch_tcpip_mbox_stats_reset();
+    sys_arch_pool_stats_reset();
+
+    UNLOCK_TCPIP_CORE();
+
+    LogInfo( "lwIP tuning statistics reset." );
+}
+
+/*-----------------------------------------------------------*/
+
+uint32_t ulLwipTuningRecommend( const LwipTuningResource_t * pxResource )
+{
+    uint32_t ulRecommended;
+
+    configASSERT( pxResource != NULL );
+
+    if( pxResource->ulFailures > 0 )
+    {
+        uint32_t ulGrowth = pxResource->ulSize / 2;
+
+        /* An exhausted resource only shows its limit as the high-water mark, so grow it by half */
+        ulRecommended = pxResource->ulSize +
+                        ( ( ulGrowth < LWIP_TUNING_MIN_HEADROOM ) ? LWIP_TUNING_MIN_HEADROOM : ulGrowth );
+    }
+    else
+    {
+        uint32_t ulHeadroom = pxResource->ulHighWater / 4;
+
+        ulHeadroom = ( ulHeadroom < LWIP_TUNING_MIN_HEADROOM ) ? LWIP_TUNING_MIN_HEADROOM : ulHeadroom;
+        ulRecommended = pxResource->ulHighWater + ulHeadroom;
+
+        /* Without failures there is no evidence for growing a resource */
+        if( ulRecommended > pxResource->ulSize )
+        {
+            ulRecommended = pxResource->ulSize;
+        }
+    }
+
+    return ulRecommended;
+}
@@ -49,6 +49,8 @@
 #include "lwip/mem.h"
 #include "lwip/stats.h"
 
+#include <string.h>
+
 #if !INCLUDE_xTaskAbortDelay
     #error "lwIP FreeRTOS port requires INCLUDE_xTaskAbortDelay"
 #endif
@@ -61,6 +63,287 @@
  * the interrupt handler setting this variable manually. */
 portBASE_TYPE xInsideISR = pdFALSE;
 
+/* The tcpip thread and the mailbox it fetches from, found by name in sys_thread_new and
+ * on its first fetch, so that TCPIP_MBOX_SIZE can be sized apart from the per connection
+ * DEFAULT_*_MBOX_SIZE mailboxes. */
+static TaskHandle_t xTcpipThread = NULL;
+static QueueHandle_t xTcpipMbox = NULL;
+
+/* Deepest the tcpip mailbox has been and posts it refused, since boot or the last reset */
+static volatile UBaseType_t uxTcpipMboxHighWater = 0;
+static volatile uint32_t ulTcpipMboxFull = 0;
+
+static void prvUpdateMboxDepth( QueueHandle_t xMbox )
+{
+    UBaseType_t uxDepth;
+
+    if( xMbox == xTcpipMbox )
+    {
+        if( xInsideISR != pdFALSE )
+        {
+            uxDepth = uxQueueMessagesWaitingFromISR( xMbox );
+        }
+        else
+        {
+            uxDepth = uxQueueMessagesWaiting( xMbox );
+        }
+
+        /* A racing update may lose a sample, which is acceptable for a statistic */
+        if( uxDepth > uxTcpipMboxHighWater )
+        {
+            uxTcpipMboxHighWater = uxDepth;
+        }
+    }
+}
+
+uint32_t sys_arch_tcpip_mbox_depth_max( void )
+{
+    return ( uint32_t ) uxTcpipMboxHighWater;
+}
+
+uint32_t sys_arch_tcpip_mbox_full( void )
+{
+    return ulTcpipMboxFull;
+}
+
+void sys_arch_tcpip_mbox_stats_reset( void )
+{
+    uxTcpipMboxHighWater = 0;
+    ulTcpipMboxFull = 0;
+}
+
+#if SYS_ARCH_STATIC_POOLS
+
+typedef struct
+{
+    StaticQueue_t xQueue; /* First member, so that the queue handle is the slot address */
+    uint8_t ucStorage[ SYS_ARCH_MBOX_MAX_LEN * sizeof( void * ) ];
+} SysArchMboxSlot_t;
+
+typedef struct
+{
+    uint8_t * pucBase;
+    uint8_t * pucInUse;
+    uint32_t ulSlotSize;
+    uint32_t ulSize;
+    uint32_t ulUsed;
+    uint32_t ulHighWater;
+    uint32_t ulOverflows;
+} SysArchPool_t;
+
+static SysArchMboxSlot_t xMboxSlots[ SYS_ARCH_MBOX_POOL_SIZE ];
+static StaticSemaphore_t xSemSlots[ SYS_ARCH_SEM_POOL_SIZE ];
+static StaticSemaphore_t xMutexSlots[ SYS_ARCH_MUTEX_POOL_SIZE ];
+
+static uint8_t ucMboxInUse[ SYS_ARCH_MBOX_POOL_SIZE ];
+static uint8_t ucSemInUse[ SYS_ARCH_SEM_POOL_SIZE ];
+static uint8_t ucMutexInUse[ SYS_ARCH_MUTEX_POOL_SIZE ];
+
+static SysArchPool_t xPools[ SYS_ARCH_POOL_MAX ] =
+{
+    [ SYS_ARCH_POOL_MBOX ] =
+    {
+        .pucBase    = ( uint8_t * ) xMboxSlots,
+        .pucInUse   = ucMboxInUse,
+        .ulSlotSize = sizeof( SysArchMboxSlot_t ),
+        .ulSize     = SYS_ARCH_MBOX_POOL_SIZE
+    },
+    [ SYS_ARCH_POOL_SEM ] =
+    {
+        .pucBase    = ( uint8_t * ) xSemSlots,
+        .pucInUse   = ucSemInUse,
+        .ulSlotSize = sizeof( StaticSemaphore_t ),
+        .ulSize     = SYS_ARCH_SEM_POOL_SIZE
+    },
+    [ SYS_ARCH_POOL_MUTEX ] =
+    {
+        .pucBase    = ( uint8_t * ) xMutexSlots,
+        .pucInUse   = ucMutexInUse,
+        .ulSlotSize = sizeof( StaticSemaphore_t ),
+        .ulSize     = SYS_ARCH_MUTEX_POOL_SIZE
+    }
+};
+
+/* Returns a free slot, or NULL after counting an overflow */
+static void * prvPoolTake( SysArchPool_t * pxPool )
+{
+    void * pvSlot = NULL;
+
+    taskENTER_CRITICAL();
+
+    for( uint32_t ulIdx = 0; ulIdx < pxPool->ulSize; ulIdx++ )
+    {
+        if( pxPool->pucInUse[ ulIdx ] == 0 )
+        {
+            pxPool->pucInUse[ ulIdx ] = 1;
+            pvSlot = pxPool->pucBase + ( ulIdx * pxPool->ulSlotSize );
+            pxPool->ulUsed++;
+
+            if( pxPool->ulUsed > pxPool->ulHighWater )
+            {
+                pxPool->ulHighWater = pxPool->ulUsed;
+            }
+
+            break;
+        }
+    }
+
+    if( pvSlot == NULL )
+    {
+        pxPool->ulOverflows++;
+    }
+
+    taskEXIT_CRITICAL();
+
+    return pvSlot;
+}
+
+/* Releases the slot of an object created from the pool. Objects from the heap are ignored. */
+static void prvPoolGive( SysArchPool_t * pxPool,
+                         const void * pvObject )
+{
+    const uint8_t * pucObject = ( const uint8_t * ) pvObject;
+
+    if( ( pucObject >= pxPool->pucBase ) &&
+        ( pucObject < ( pxPool->pucBase + ( pxPool->ulSize * pxPool->ulSlotSize ) ) ) )
+    {
+        uint32_t ulIdx = ( uint32_t ) ( pucObject - pxPool->pucBase ) / pxPool->ulSlotSize;
+
+        taskENTER_CRITICAL();
+        configASSERT( pxPool->pucInUse[ ulIdx ] != 0 );
+        pxPool->pucInUse[ ulIdx ] = 0;
+        pxPool->ulUsed--;
+        taskEXIT_CRITICAL();
+    }
+}
+
+#endif /* SYS_ARCH_STATIC_POOLS */
+
+void sys_arch_pool_stats( sys_arch_pool_t xPool,
+                          sys_arch_pool_stats_t * pxStats )
+{
+    configASSERT( ( xPool < SYS_ARCH_POOL_MAX ) && ( pxStats != NULL ) );
+
+    ( void ) memset( pxStats, 0, sizeof( sys_arch_pool_stats_t ) );
+
+    #if SYS_ARCH_STATIC_POOLS
+    {
+        taskENTER_CRITICAL();
+        pxStats->ulSize = xPools[ xPool ].ulSize;
+        pxStats->ulSlotSize = xPools[ xPool ].ulSlotSize;
+        pxStats->ulUsed = xPools[ xPool ].ulUsed;
+        pxStats->ulHighWater = xPools[ xPool ].ulHighWater;
+        pxStats->ulOverflows = xPools[ xPool ].ulOverflows;
+        taskEXIT_CRITICAL();
+    }
+    #endif /* SYS_ARCH_STATIC_POOLS */
+}
+
+void sys_arch_pool_stats_reset( void )
+{
+    #if SYS_ARCH_STATIC_POOLS
+    {
+        taskENTER_CRITICAL();
+
+        for( uint32_t ulPool = 0; ulPool < SYS_ARCH_POOL_MAX; ulPool++ )
+        {
+            xPools[ ulPool ].ulHighWater = xPools[ ulPool ].ulUsed;
+            xPools[ ulPool ].ulOverflows = 0;
+        }
+
+        taskEXIT_CRITICAL();
+    }
+    #endif /* SYS_ARCH_STATIC_POOLS */
+}
+
+static QueueHandle_t prvMboxCreate( int iSize )
+{
+    QueueHandle_t xMbox = NULL;
+
+    #if SYS_ARCH_STATIC_POOLS
+    {
+        if( iSize > SYS_ARCH_MBOX_MAX_LEN )
+        {
+            LogWarn( "A mailbox of %d entries exceeds SYS_ARCH_MBOX_MAX_LEN and is allocated from the heap.", iSize );
+        }
+        else
+        {
+            SysArchMboxSlot_t * pxSlot = prvPoolTake( &( xPools[ SYS_ARCH_POOL_MBOX ] ) );
+
+            if( pxSlot != NULL )
+            {
+                xMbox = xQueueCreateStatic( iSize, sizeof( void * ), pxSlot->ucStorage, &( pxSlot->xQueue ) );
+            }
+        }
+    }
+    #endif /* SYS_ARCH_STATIC_POOLS */
+
+    if( xMbox == NULL )
+    {
+        xMbox = xQueueCreate( iSize, sizeof( void * ) );
+    }
+
+    return xMbox;
+}
+
+static SemaphoreHandle_t prvSemCreate( void )
+{
+    SemaphoreHandle_t xSem = NULL;
+
+    #if SYS_ARCH_STATIC_POOLS
+    {
+        StaticSemaphore_t * pxSlot = prvPoolTake( &( xPools[ SYS_ARCH_POOL_SEM ] ) );
+
+        if( pxSlot != NULL )
+        {
+            xSem = xSemaphoreCreateBinaryStatic( pxSlot );
+        }
+    }
+    #endif /* SYS_ARCH_STATIC_POOLS */
+
+    if( xSem == NULL )
+    {
+        xSem = xSemaphoreCreateBinary();
+    }
+
+    return xSem;
+}
+
+static SemaphoreHandle_t prvMutexCreate( void )
+{
+    SemaphoreHandle_t xMutex = NULL;
+
+    #if SYS_ARCH_STATIC_POOLS
+    {
+        StaticSemaphore_t * pxSlot = prvPoolTake( &( xPools[ SYS_ARCH_POOL_MUTEX ] ) );
+
+        if( pxSlot != NULL )
+        {
+            xMutex = xSemaphoreCreateMutexStatic( pxSlot );
+        }
+    }
+    #endif /* SYS_ARCH_STATIC_POOLS */
+
+    if( xMutex == NULL )
+    {
+        xMutex = xSemaphoreCreateMutex();
+    }
+
+    return xMutex;
+}
+
+static void prvObjectDelete( sys_arch_pool_t xPool,
+                             QueueHandle_t xObject )
+{
+    vQueueDelete( xObject );
+
+    #if SYS_ARCH_STATIC_POOLS
+        prvPoolGive( &( xPools[ xPool ] ), xObject );
+    #else
+        ( void ) xPool;
+    #endif
+}
+
 /*---------------------------------------------------------------------------*
 * Routine:  sys_mbox_new
 *---------------------------------------------------------------------------*
@@ -77,7 +360,7 @@ err_t sys_mbox_new( sys_mbox_t * pxMailBox,
     err_t xReturn = ERR_MEM;
     sys_mbox_t pxTempMbox;
 
-    pxTempMbox.xMbox = xQueueCreate( iSize, sizeof( void * ) );
+    pxTempMbox.xMbox = prvMboxCreate( iSize );
 
     if( pxTempMbox.xMbox != NULL )
     {
@@ -86,6 +369,10 @@ err_t sys_mbox_new( sys_mbox_t * pxMailBox,
         xReturn = ERR_OK;
         SYS_STATS_INC_USED( mbox );
     }
+    else
+    {
+        SYS_STATS_INC( mbox.err );
+    }
 
     return xReturn;
 }
@@ -137,7 +424,7 @@ void sys_mbox_free( sys_mbox_t * pxMailBox )
             xTaskAbortDelay( xTask );
         }
 
-        vQueueDelete( xMbox );
+        prvObjectDelete( SYS_ARCH_POOL_MBOX, xMbox );
     }
 }
 
@@ -156,6 +443,8 @@ void sys_mbox_post( sys_mbox_t * pxMailBox,
     while( xQueueSendToBack( pxMailBox->xMbox, &pxMessageToPost, portMAX_DELAY ) != pdTRUE )
     {
     }
+
+    prvUpdateMboxDepth( pxMailBox->xMbox );
 }
 
 /*---------------------------------------------------------------------------*
@@ -189,12 +478,18 @@ err_t sys_mbox_trypost( sys_mbox_t * pxMailBox,
     if( xReturn == pdPASS )
     {
         xReturn = ERR_OK;
+        prvUpdateMboxDepth( pxMailBox->xMbox );
     }
     else
     {
         /* The queue was already full. */
         xReturn = ERR_MEM;
         SYS_STATS_INC( mbox.err );
+
+        if( pxMailBox->xMbox == xTcpipMbox )
+        {
+            ulTcpipMboxFull++;
+        }
     }
 
     return xReturn;
@@ -259,6 +554,12 @@ u32_t sys_arch_mbox_fetch( sys_mbox_t * pxMailBox,
     if( ( xMbox != NULL ) && ( xTask != NULL ) && ( pvxMailBox->xTask == NULL ) )
     {
         pvxMailBox->xTask = xTask;
+
+        /* The tcpip thread only ever fetches from its own mailbox */
+        if( ( xTask == xTcpipThread ) && ( xTcpipMbox == NULL ) )
+        {
+            xTcpipMbox = xMbox;
+        }
     }
     else
     {
@@ -377,13 +678,14 @@ err_t sys_sem_new( sys_sem_t * pxSemaphore,
 {
     err_t xReturn = ERR_MEM;
 
-    vSemaphoreCreateBinary( ( *pxSemaphore ) );
+    *pxSemaphore = prvSemCreate();
 
     if( *pxSemaphore != NULL )
     {
-        if( ucCount == 0U )
+        /* Binary semaphores are created empty */
+        if( ucCount != 0U )
         {
-            xSemaphoreTake( *pxSemaphore, 1UL );
+            xSemaphoreGive( *pxSemaphore );
         }
 
         xReturn = ERR_OK;
@@ -468,7 +770,7 @@ err_t sys_mutex_new( sys_mutex_t * pxMutex )
 {
     err_t xReturn = ERR_MEM;
 
-    *pxMutex = xSemaphoreCreateMutex();
+    *pxMutex = prvMutexCreate();
 
     if( *pxMutex != NULL )
     {
@@ -505,7 +807,7 @@ void sys_mutex_unlock( sys_mutex_t * pxMutex )
 void sys_mutex_free( sys_mutex_t * pxMutex )
 {
     SYS_STATS_DEC( mutex.used );
-    vQueueDelete( *pxMutex );
+    prvObjectDelete( SYS_ARCH_POOL_MUTEX, *pxMutex );
 }
 
 
@@ -542,7 +844,7 @@ void sys_sem_signal( sys_sem_t * pxSemaphore )
 void sys_sem_free( sys_sem_t * pxSemaphore )
 {
     SYS_STATS_DEC( sem.used );
-    vQueueDelete( *pxSemaphore );
+    prvObjectDelete( SYS_ARCH_POOL_SEM, *pxSemaphore );
 }
 
 /*---------------------------------------------------------------------------*
@@ -594,6 +896,11 @@ sys_thread_t sys_thread_new( const char * pcName,
     if( xResult == pdPASS )
     {
         xReturn = xCreatedTask;
+
+        if( strcmp( pcName, TCPIP_THREAD_NAME ) == 0 )
+        {
+            xTcpipThread = xCreatedTask;
+        }
     }
     else
     {
@@ -54,8 +54,19 @@
 
 #include "errno.h"
 
+#include "dns_cache.h"
+
 #define MBEDTLS_DEBUG_THRESHOLD    1
 
+/* Delay before a connection to the next address is started alongside the pending ones */
+#define CONNECT_STAGGER_MS         250
+
+/* Maximum number of connection attempts in progress at once */
+#define CONNECT_MAX_PARALLEL       2
+
+/* Time allowed to connect to any of the addresses of a host */
+#define CONNECT_TIMEOUT_MS         ( 20 * 1000 )
+
 #ifdef MBEDTLS_TRANSPORT_PKCS11
     #include "core_pkcs11_config.h"
     #include "core_pkcs11.h"
@@ -1066,165 +1077,383 @@ TlsTransportStatus_t mbedtls_transport_configure( NetworkContext_t * pxNetworkCo
     return xStatus;
 }
 
-static TlsTransportStatus_t xConnectSocket( TLSContext_t * pxTLSCtx,
-                                            const char * pcHostName,
-                                            uint16_t usPort )
+/*
+ * Starts a non-blocking connection to ulAddr. Returns 0 when connected, EINPROGRESS
+ * when the connection is pending, or another errno value on failure.
+ */
+static int lStartConnect( uint32_t ulAddr,
+                          uint16_t usPort,
+                          SockHandle_t * pxSockHandle )
 {
-    TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
     int lError = 0;
-    struct addrinfo * pxAddrInfo = NULL;
+    struct sockaddr_in xSockAddr = { 0 };
 
-    configASSERT( pxTLSCtx != NULL );
-    configASSERT( pcHostName != NULL );
-    configASSERT( usPort > 0 );
+    xSockAddr.sin_len = sizeof( struct sockaddr_in );
+    xSockAddr.sin_family = AF_INET;
+    xSockAddr.sin_port = htons( usPort );
+    xSockAddr.sin_addr.s_addr = ulAddr;
 
-    /* Close socket if already allocated */
-    if( pxTLSCtx->xSockHandle >= 0 )
+    *pxSockHandle = sock_socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+    if( *pxSockHandle < 0 )
     {
-        ( void ) sock_close( pxTLSCtx->xSockHandle );
-        pxTLSCtx->xSockHandle = -1;
+        lError = ENFILE;
     }
-
-    /* Perform address (DNS) lookup */
-    if( xStatus == TLS_TRANSPORT_SUCCESS )
+    else
     {
-        const struct addrinfo xAddrInfoHint =
-        {
-            .ai_family   = AF_INET,
-            .ai_socktype = SOCK_STREAM,
-            .ai_protocol = IPPROTO_TCP,
-        };
-
-        lError = dns_getaddrinfo( pcHostName, NULL,
-                                  &xAddrInfoHint, &pxAddrInfo );
+        int lFlags = sock_fcntl( *pxSockHandle, F_GETFL, 0 );
 
-        if( ( lError != 0 ) || ( pxAddrInfo == NULL ) )
+        if( ( lFlags == -1 ) ||
+            ( sock_fcntl( *pxSockHandle, F_SETFL, lFlags | O_NONBLOCK ) != 0 ) )
         {
-            LogError( "Failed to resolve hostname: %s to IP address.", pcHostName );
-            xStatus = TLS_TRANSPORT_DNS_FAILED;
+            lError = errno;
+        }
+        else if( sock_connect( *pxSockHandle, ( struct sockaddr * ) &xSockAddr, sizeof( xSockAddr ) ) != 0 )
+        {
+            lError = errno;
+        }
+        else
+        {
+            lError = 0;
+        }
 
-            if( pxAddrInfo != NULL )
-            {
-                dns_freeaddrinfo( pxAddrInfo );
-                pxAddrInfo = NULL;
-            }
+        if( ( lError != 0 ) && ( lError != EINPROGRESS ) )
+        {
+            ( void ) sock_close( *pxSockHandle );
+            *pxSockHandle = -1;
         }
     }
 
-    if( xStatus == TLS_TRANSPORT_SUCCESS )
+    return lError;
+}
+
+/*
+ * Connects to one of the addresses in pxAddrs. When a connection does not complete within
+ * CONNECT_STAGGER_MS, a connection to the next address is started alongside it and the first
+ * one to complete is used.
+ */
+static TlsTransportStatus_t xConnectAddresses( TLSContext_t * pxTLSCtx,
+                                               const char * pcHostName,
+                                               uint16_t usPort,
+                                               const DnsCacheResult_t * pxAddrs )
+{
+    TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+    SockHandle_t xSockets[ DNS_CACHE_MAX_ADDRS ];
+    size_t uxConnected = DNS_CACHE_MAX_ADDRS;
+    size_t uxNext = 0;
+    size_t uxPending = 0;
+    TickType_t xLastStart = 0;
+    TickType_t xRemainingTicks = pdMS_TO_TICKS( CONNECT_TIMEOUT_MS );
+    TimeOut_t xTimeOut;
+
+    vTaskSetTimeOutState( &xTimeOut );
+
+    for( size_t i = 0; i < DNS_CACHE_MAX_ADDRS; i++ )
     {
-        struct addrinfo * pxAddrIter = NULL;
+        xSockets[ i ] = -1;
+    }
 
-        /* Try all of the addresses returned by getaddrinfo */
-        for( pxAddrIter = pxAddrInfo; pxAddrIter != NULL; pxAddrIter = pxAddrIter->ai_next )
+    while( ( uxConnected == DNS_CACHE_MAX_ADDRS ) &&
+           ( xStatus == TLS_TRANSPORT_SUCCESS ) )
+    {
+        TickType_t xSinceStart = xTaskGetTickCount() - xLastStart;
+
+        if( ( uxNext < pxAddrs->uxCount ) &&
+            ( uxPending < CONNECT_MAX_PARALLEL ) &&
+            ( ( uxPending == 0 ) || ( xSinceStart >= pdMS_TO_TICKS( CONNECT_STAGGER_MS ) ) ) )
         {
-            /* Set port number */
-            switch( pxAddrIter->ai_family )
+            char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
+            struct in_addr xInAddr = { .s_addr = pxAddrs->ulAddrs[ uxNext ] };
+            int lError;
+
+            ( void ) inet_ntoa_r( xInAddr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
+            LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
+                     IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
+
+            lError = lStartConnect( pxAddrs->ulAddrs[ uxNext ], usPort, &( xSockets[ uxNext ] ) );
+
+            if( lError == 0 )
             {
-                #if LWIP_IPV4 == 1
-                    case AF_INET:
-                        ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_port = htons( usPort );
-                        break;
-                #endif
-                #if LWIP_IPV6 == 1
-                    case AF_INET6:
-                        ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin6_port = htons( usPort );
-                        break;
-                #endif
-                default:
-                    continue;
-                    break;
+                uxConnected = uxNext;
+            }
+            else if( lError == EINPROGRESS )
+            {
+                uxPending++;
+            }
+            else if( lError == ENFILE )
+            {
+                /* Not the address' fault, only an error when nothing else is pending */
+                if( uxPending == 0 )
+                {
+                    LogError( "Failed to allocate socket." );
+                    xStatus = TLS_TRANSPORT_INSUFFICIENT_SOCKETS;
+                }
+            }
+            else
+            {
+                vDnsCacheReportConnect( pcHostName, pxAddrs->ulAddrs[ uxNext ], pdFALSE );
             }
 
-            #if LWIP_IPV4 == 1
-                if( pxAddrIter->ai_family == AF_INET )
+            xLastStart = xTaskGetTickCount();
+            uxNext++;
+        }
+        else if( ( uxPending == 0 ) ||
+                 ( xTaskCheckForTimeOut( &xTimeOut, &xRemainingTicks ) == pdTRUE ) )
+        {
+            /* All addresses failed or timed out */
+            break;
+        }
+        else
+        {
+            fd_set xWriteSet;
+            fd_set xErrorSet;
+            struct timeval xTimeVal;
+            TickType_t xWaitTicks = xRemainingTicks;
+            int lMaxSock = -1;
+
+            /* Wake up to start the next attempt if there is one */
+            if( ( uxNext < pxAddrs->uxCount ) &&
+                ( uxPending < CONNECT_MAX_PARALLEL ) )
+            {
+                TickType_t xStagger = pdMS_TO_TICKS( CONNECT_STAGGER_MS );
+                TickType_t xUntilNext = ( xSinceStart < xStagger ) ? ( xStagger - xSinceStart ) : 0;
+
+                if( xUntilNext < xWaitTicks )
                 {
-                    char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
-                    ( void ) inet_ntoa_r( ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
-                    LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
-                             IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
+                    xWaitTicks = xUntilNext;
                 }
-            #endif
-            #if LWIP_IPV6 == 1
-                if( pxAddrIter->ai_family == AF_INET6 )
+            }
+
+            FD_ZERO( &xWriteSet );
+            FD_ZERO( &xErrorSet );
+
+            for( size_t i = 0; i < uxNext; i++ )
+            {
+                if( xSockets[ i ] >= 0 )
                 {
-                    char ipAddrBuff[ IP6ADDR_STRLEN_MAX ] = { 0 };
-                    ( void ) inet6_ntoa_r( ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP6ADDR_STRLEN_MAX );
-                    LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
-                             IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
+                    FD_SET( xSockets[ i ], &xWriteSet );
+                    FD_SET( xSockets[ i ], &xErrorSet );
+
+                    if( xSockets[ i ] > lMaxSock )
+                    {
+                        lMaxSock = xSockets[ i ];
+                    }
                 }
-            #endif
+            }
 
-            /* Allocate socket */
-            pxTLSCtx->xSockHandle = sock_socket( pxAddrIter->ai_family,
-                                                 pxAddrIter->ai_socktype,
-                                                 pxAddrIter->ai_protocol );
+            xTimeVal.tv_sec = ( xWaitTicks / configTICK_RATE_HZ );
+            xTimeVal.tv_usec = ( ( xWaitTicks % configTICK_RATE_HZ ) * 1000000 ) / configTICK_RATE_HZ;
 
-            if( pxTLSCtx->xSockHandle < 0 )
+            if( sock_select( lMaxSock + 1, NULL, &xWriteSet, &xErrorSet, &xTimeVal ) > 0 )
             {
-                LogError( "Failed to allocate socket." );
-                xStatus = TLS_TRANSPORT_INSUFFICIENT_SOCKETS;
+                for( size_t i = 0; ( i < uxNext ) && ( uxConnected == DNS_CACHE_MAX_ADDRS ); i++ )
+                {
+                    if( ( xSockets[ i ] >= 0 ) &&
+                        ( FD_ISSET( xSockets[ i ], &xWriteSet ) || FD_ISSET( xSockets[ i ], &xErrorSet ) ) )
+                    {
+                        int lSockError = 0;
+                        socklen_t xOptLen = sizeof( lSockError );
+
+                        if( ( sock_getsockopt( xSockets[ i ], SOL_SOCKET, SO_ERROR, &lSockError, &xOptLen ) == 0 ) &&
+                            ( lSockError == 0 ) )
+                        {
+                            uxConnected = i;
+                        }
+                        else
+                        {
+                            ( void ) sock_close( xSockets[ i ] );
+                            xSockets[ i ] = -1;
+                            uxPending--;
+                            vDnsCacheReportConnect( pcHostName, pxAddrs->ulAddrs[ i ], pdFALSE );
+                        }
+                    }
+                }
             }
-            else
+        }
+    }
+
+    /* Abandon the attempts that lost */
+    for( size_t i = 0; i < DNS_CACHE_MAX_ADDRS; i++ )
+    {
+        if( ( xSockets[ i ] >= 0 ) && ( i != uxConnected ) )
+        {
+            ( void ) sock_close( xSockets[ i ] );
+        }
+    }
+
+    if( uxConnected < DNS_CACHE_MAX_ADDRS )
+    {
+        char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
+        struct in_addr xInAddr = { .s_addr = pxAddrs->ulAddrs[ uxConnected ] };
+        int lFlags = sock_fcntl( xSockets[ uxConnected ], F_GETFL, 0 );
+
+        /* Restore blocking mode, mbedtls_transport_connect sets the final mode */
+        if( ( lFlags == -1 ) ||
+            ( sock_fcntl( xSockets[ uxConnected ], F_SETFL, lFlags & ~O_NONBLOCK ) != 0 ) )
+        {
+            LogError( "Failed to clear socket O_NONBLOCK flag." );
+            ( void ) sock_close( xSockets[ uxConnected ] );
+            xStatus = TLS_TRANSPORT_INTERNAL_ERROR;
+        }
+        else
+        {
+            pxTLSCtx->xSockHandle = xSockets[ uxConnected ];
+
+            vDnsCacheReportConnect( pcHostName, pxAddrs->ulAddrs[ uxConnected ], pdTRUE );
+
+            ( void ) inet_ntoa_r( xInAddr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
+            LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
+                     pxTLSCtx->xSockHandle, pcHostName,
+                     IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort );
+        }
+    }
+    else if( xStatus == TLS_TRANSPORT_SUCCESS )
+    {
+        xStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+    }
+    else
+    {
+        /* Keep the error */
+    }
+
+    return xStatus;
+}
+
+#if LWIP_IPV6 == 1
+
+/*
+ * Connects to the first reachable IPv6 address of pcHostName. The address cache only holds
+ * IPv4 addresses, so these are resolved on every connection.
+ */
+    static TlsTransportStatus_t xConnectAddrInfo6( TLSContext_t * pxTLSCtx,
+                                                   const char * pcHostName,
+                                                   uint16_t usPort )
+    {
+        TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+        struct addrinfo * pxAddrInfo = NULL;
+        struct addrinfo * pxAddrIter = NULL;
+        int lError = 0;
+
+        const struct addrinfo xAddrInfoHint =
+        {
+            .ai_family   = AF_INET6,
+            .ai_socktype = SOCK_STREAM,
+            .ai_protocol = IPPROTO_TCP,
+        };
+
+        lError = dns_getaddrinfo( pcHostName, NULL,
+                                  &xAddrInfoHint, &pxAddrInfo );
+
+        if( ( lError != 0 ) || ( pxAddrInfo == NULL ) )
+        {
+            LogError( "Failed to resolve hostname: %s to IPv6 address.", pcHostName );
+            xStatus = TLS_TRANSPORT_DNS_FAILED;
+        }
+
+        for( pxAddrIter = pxAddrInfo;
+             ( xStatus == TLS_TRANSPORT_SUCCESS ) && ( pxAddrIter != NULL ) && ( pxTLSCtx->xSockHandle < 0 );
+             pxAddrIter = pxAddrIter->ai_next )
+        {
+            if( pxAddrIter->ai_family == AF_INET6 )
             {
-                lError = sock_connect( pxTLSCtx->xSockHandle,
-                                       pxAddrIter->ai_addr,
-                                       pxAddrIter->ai_addrlen );
+                char ipAddrBuff[ IP6ADDR_STRLEN_MAX ] = { 0 };
+
+                ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin6_port = htons( usPort );
+
+                ( void ) inet6_ntoa_r( ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin6_addr, ipAddrBuff, IP6ADDR_STRLEN_MAX );
+                LogInfo( "Trying address: %.*s, port: %uh for host: %s.",
+                         IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort, pcHostName );
 
-                /* Upon connection error, continue to next address */
-                if( lError != 0 )
+                pxTLSCtx->xSockHandle = sock_socket( pxAddrIter->ai_family,
+                                                     pxAddrIter->ai_socktype,
+                                                     pxAddrIter->ai_protocol );
+
+                if( pxTLSCtx->xSockHandle < 0 )
+                {
+                    LogError( "Failed to allocate socket." );
+                    xStatus = TLS_TRANSPORT_INSUFFICIENT_SOCKETS;
+                }
+                else if( sock_connect( pxTLSCtx->xSockHandle,
+                                       pxAddrIter->ai_addr,
+                                       pxAddrIter->ai_addrlen ) != 0 )
                 {
+                    /* Upon connection error, continue to next address */
                     ( void ) sock_close( pxTLSCtx->xSockHandle );
                     pxTLSCtx->xSockHandle = -1;
                 }
                 else
                 {
-                    #if LWIP_IPV4 == 1
-                        if( pxAddrIter->ai_family == AF_INET )
-                        {
-                            char ipAddrBuff[ IP4ADDR_STRLEN_MAX ] = { 0 };
-
-                            ( void ) inet_ntoa_r( ( ( struct sockaddr_in * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP4ADDR_STRLEN_MAX );
-
-                            LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
-                                     pxTLSCtx->xSockHandle, pcHostName,
-                                     IP4ADDR_STRLEN_MAX, ipAddrBuff, usPort );
-                        }
-                    #endif /* if LWIP_IPV4 == 1 */
-                    #if LWIP_IPV6 == 1
-                        if( pxAddrIter->ai_family == AF_INET6 )
-                        {
-                            char ipAddrBuff[ IP6ADDR_STRLEN_MAX ] = { 0 };
-                            ( void ) inet6_ntoa_r( ( ( struct sockaddr_in6 * ) pxAddrIter->ai_addr )->sin_addr, ipAddrBuff, IP6ADDR_STRLEN_MAX );
-                            LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
-                                     pxTLSCtx->xSockHandle, pcHostName,
-                                     IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort );
-                        }
-                    #endif
+                    LogInfo( "Connected socket: %ld to host: %s, address: %.*s, port: %uh.",
+                             pxTLSCtx->xSockHandle, pcHostName,
+                             IP6ADDR_STRLEN_MAX, ipAddrBuff, usPort );
                 }
             }
+        }
 
-            /* Exit loop on an irrecoverable error or successful connection. */
-            if( ( xStatus != TLS_TRANSPORT_SUCCESS ) ||
-                ( pxTLSCtx->xSockHandle >= 0 ) )
-            {
-                break;
-            }
+        if( pxAddrInfo != NULL )
+        {
+            dns_freeaddrinfo( pxAddrInfo );
+        }
+
+        if( ( xStatus == TLS_TRANSPORT_SUCCESS ) &&
+            ( pxTLSCtx->xSockHandle < 0 ) )
+        {
+            xStatus = TLS_TRANSPORT_CONNECT_FAILURE;
         }
+
+        return xStatus;
+    }
+
+#endif /* LWIP_IPV6 == 1 */
+
+static TlsTransportStatus_t xConnectSocket( TLSContext_t * pxTLSCtx,
+                                            const char * pcHostName,
+                                            uint16_t usPort )
+{
+    TlsTransportStatus_t xStatus = TLS_TRANSPORT_SUCCESS;
+    DnsCacheResult_t xAddrs;
+
+    configASSERT( pxTLSCtx != NULL );
+    configASSERT( pcHostName != NULL );
+    configASSERT( usPort > 0 );
+
+    /* Close socket if already allocated */
+    if( pxTLSCtx->xSockHandle >= 0 )
+    {
+        ( void ) sock_close( pxTLSCtx->xSockHandle );
+        pxTLSCtx->xSockHandle = -1;
     }
 
-    if( pxAddrInfo != NULL )
+    /* Perform address (DNS) lookup, or use cached addresses */
+    if( xDnsCacheResolve( pcHostName, &xAddrs, pdFALSE ) == pdFALSE )
     {
-        dns_freeaddrinfo( pxAddrInfo );
-        pxAddrInfo = NULL;
+        LogError( "Failed to resolve hostname: %s to IP address.", pcHostName );
+        xStatus = TLS_TRANSPORT_DNS_FAILED;
     }
 
-    if( ( xStatus == TLS_TRANSPORT_SUCCESS ) &&
-        ( pxTLSCtx->xSockHandle < 0 ) )
+    if( xStatus == TLS_TRANSPORT_SUCCESS )
     {
-        xStatus = TLS_TRANSPORT_CONNECT_FAILURE;
+        xStatus = xConnectAddresses( pxTLSCtx, pcHostName, usPort, &xAddrs );
+
+        /* The cached addresses may be out of date, retry with a fresh lookup */
+        if( ( xStatus == TLS_TRANSPORT_CONNECT_FAILURE ) &&
+            ( xAddrs.xFromCache == pdTRUE ) &&
+            ( xDnsCacheResolve( pcHostName, &xAddrs, pdTRUE ) == pdTRUE ) &&
+            ( xAddrs.xFromCache == pdFALSE ) )
+        {
+            xStatus = xConnectAddresses( pxTLSCtx, pcHostName, usPort, &xAddrs );
+        }
     }
 
+    #if LWIP_IPV6 == 1
+        /* No IPv4 address worked, try the IPv6 ones */
+        if( ( xStatus == TLS_TRANSPORT_DNS_FAILED ) ||
+            ( xStatus == TLS_TRANSPORT_CONNECT_FAILURE ) )
+        {
+            xStatus = xConnectAddrInfo6( pxTLSCtx, pcHostName, usPort );
+        }
+    #endif /* LWIP_IPV6 == 1 */
+
     return xStatus;
 }
 
@@ -207,7 +207,9 @@ static inline BaseType_t xWaitForSPIEvent( TickType_t xTimeout )
  * */
 static inline BaseType_t xDoSpiHeaderTransfer( MxDataplaneCtx_t * pxCtx,
                                                uint16_t * psTxLen,
-                                               uint16_t * psRxLen )
+                                               uint16_t * psRxLen,
+                                               uint8_t ucTxFrames,
+                                               uint8_t * pucRxFrames )
 {
     HAL_StatusTypeDef xHalStatus = HAL_ERROR;
 
@@ -217,6 +219,14 @@ static inline BaseType_t xDoSpiHeaderTransfer( MxDataplaneCtx_t * pxCtx,
     xTxHeader.type = MX_SPI_WRITE;
     xTxHeader.len = *psTxLen;
     xTxHeader.lenx = ~( xTxHeader.len );
+    xTxHeader.ucFrames = ucTxFrames;
+
+    #if MX_SPI_MULTI_FRAME
+        xTxHeader.ucCapsMagic = MX_SPI_CAPS_MAGIC;
+        xTxHeader.ucCaps = MX_SPI_CAP_MULTI_FRAME;
+    #endif
+
+    *pucRxFrames = 0;
 
     ( void ) xTaskNotifyStateClearIndexed( NULL, SPI_EVT_DMA_IDX );
 
@@ -241,6 +251,24 @@ static inline BaseType_t xDoSpiHeaderTransfer( MxDataplaneCtx_t * pxCtx,
         ( ( ( xRxHeader.len ) ^ ( xRxHeader.lenx ) ) == 0xFFFF ) )
     {
         *psRxLen = xRxHeader.len;
+
+        #if MX_SPI_MULTI_FRAME
+            if( ( xRxHeader.ucCapsMagic == MX_SPI_CAPS_MAGIC ) &&
+                ( ( xRxHeader.ucCaps & MX_SPI_CAP_MULTI_FRAME ) != 0 ) )
+            {
+                if( pxCtx->xMultiFrame == pdFALSE )
+                {
+                    LogInfo( "Module supports multi-frame SPI transactions." );
+                    pxCtx->xMultiFrame = pdTRUE;
+                }
+
+                /* Only a peer that saw our advertisement packs frames */
+                if( xRxHeader.ucFrames > 1 )
+                {
+                    *pucRxFrames = xRxHeader.ucFrames;
+                }
+            }
+        #endif /* MX_SPI_MULTI_FRAME */
     }
     else
     {
@@ -327,9 +355,9 @@ static inline BaseType_t xTransmitReceiveMessage( MxDataplaneCtx_t * pxCtx,
 
         xHalStatus |= ( xWaitForSPIEvent( MX_SPI_EVENT_TIMEOUT ) == pdTRUE ) ? HAL_OK : HAL_ERROR;
 
-        xHalStatus |= xTransmitMessage( pxCtx,
-                                        &pucTxBuffer[ usRxDataLen ],
-                                        usTxDataLen - usRxDataLen );
+        xHalStatus |= ( xTransmitMessage( pxCtx,
+                                          &pucTxBuffer[ usRxDataLen ],
+                                          usTxDataLen - usRxDataLen ) == pdTRUE ) ? HAL_OK : HAL_ERROR;
     }
     else if( usTxDataLen < usRxDataLen )
     {
@@ -342,9 +370,9 @@ static inline BaseType_t xTransmitReceiveMessage( MxDataplaneCtx_t * pxCtx,
 
         xHalStatus |= ( xWaitForSPIEvent( MX_SPI_EVENT_TIMEOUT ) == pdTRUE ) ? HAL_OK : HAL_ERROR;
 
-        xHalStatus |= xReceiveMessage( pxCtx,
-                                       &pucRxBuffer[ usTxDataLen ],
-                                       usRxDataLen - usTxDataLen );
+        xHalStatus |= ( xReceiveMessage( pxCtx,
+                                         &pucRxBuffer[ usTxDataLen ],
+                                         usRxDataLen - usTxDataLen ) == pdTRUE ) ? HAL_OK : HAL_ERROR;
     }
     else /* usTxDataLen == usRxDataLen */
     {
@@ -359,6 +387,59 @@ static inline BaseType_t xTransmitReceiveMessage( MxDataplaneCtx_t * pxCtx,
     return xHalStatus == HAL_OK;
 }
 
+/*
+ * Transmit a chained packet buffer one segment at a time within the same chip select window,
+ * receiving into pucRxBuffer while the module has data left to send.
+ */
+static BaseType_t xTransferChain( MxDataplaneCtx_t * pxCtx,
+                                  PacketBuffer_t * pxTxChain,
+                                  uint8_t * pucRxBuffer,
+                                  uint32_t ulRxDataLen )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t ulRxOffset = 0;
+
+    configASSERT( pxTxChain != NULL );
+
+    for( PacketBuffer_t * pxSegment = pxTxChain;
+         ( pxSegment != NULL ) && ( xResult == pdTRUE );
+         pxSegment = pxSegment->next )
+    {
+        if( pxSegment->len == 0 )
+        {
+            continue;
+        }
+
+        if( ulRxOffset < ulRxDataLen )
+        {
+            uint32_t ulRxLen = ulRxDataLen - ulRxOffset;
+
+            if( ulRxLen > pxSegment->len )
+            {
+                ulRxLen = pxSegment->len;
+            }
+
+            xResult = xTransmitReceiveMessage( pxCtx,
+                                               pxSegment->payload,
+                                               pxSegment->len,
+                                               &pucRxBuffer[ ulRxOffset ],
+                                               ulRxLen );
+            ulRxOffset += ulRxLen;
+        }
+        else
+        {
+            xResult = xTransmitMessage( pxCtx, pxSegment->payload, pxSegment->len );
+        }
+    }
+
+    if( ( xResult == pdTRUE ) &&
+        ( ulRxOffset < ulRxDataLen ) )
+    {
+        xResult = xReceiveMessage( pxCtx, &pucRxBuffer[ ulRxOffset ], ulRxDataLen - ulRxOffset );
+    }
+
+    return xResult;
+}
 
 static void vProcessRxPacket( MessageBufferHandle_t * xControlPlaneResponseBuff,
                               NetInterface_t * pxNetif,
@@ -409,10 +490,13 @@ static void vProcessRxPacket( MessageBufferHandle_t * xControlPlaneResponseBuff,
     /* forward to control plane handler */
     else
     {
+        /* The control plane also posts wakeups to its router, so writes are serialized */
+        taskENTER_CRITICAL();
         xResult = xMessageBufferSend( xControlPlaneResponseBuff,
                                       ppxRxPacket,
                                       sizeof( PacketBuffer_t * ),
                                       0 );
+        taskEXIT_CRITICAL();
 
         if( xResult == pdFALSE )
         {
@@ -488,6 +572,329 @@ static inline BaseType_t xWaitForFlow( MxDataplaneCtx_t * pxCtx )
     return( ( BaseType_t ) ( ulFlowValue != 0 ) );
 }
 
+/* Top up the receive ring with pool pbufs large enough for a full frame */
+static void prvRxRingRefill( MxDataplaneCtx_t * pxCtx )
+{
+    while( pxCtx->ulRxRingCount < MX_RX_RING_LEN )
+    {
+        PacketBuffer_t * pxRxBuff = PBUF_ALLOC_RX( MX_RX_BUFF_SZ );
+
+        if( pxRxBuff == NULL )
+        {
+            pxCtx->ulRxAllocFailures++;
+            RX_STATS_MEMERR();
+            break;
+        }
+
+        /* DMA needs a contiguous buffer, so PBUF_POOL_BUFSIZE must hold a full frame */
+        configASSERT( pxRxBuff->next == NULL );
+
+        pxCtx->pxRxRing[ pxCtx->ulRxRingCount ] = pxRxBuff;
+        pxCtx->ulRxRingCount++;
+    }
+}
+
+/*
+ * Take an armed buffer from the receive ring, trimmed to the length announced by the module.
+ * Messages larger than a frame are rare control plane responses and get a buffer of their own,
+ * from the heap since a pool allocation that long would be chained and DMA needs it contiguous.
+ */
+static PacketBuffer_t * prvRxRingTake( MxDataplaneCtx_t * pxCtx,
+                                       uint16_t usRxLen )
+{
+    PacketBuffer_t * pxRxBuff = NULL;
+
+    if( usRxLen > MX_RX_BUFF_SZ )
+    {
+        pxRxBuff = PBUF_ALLOC_RX_CONTIG( usRxLen );
+    }
+    else
+    {
+        if( pxCtx->ulRxRingCount == 0 )
+        {
+            prvRxRingRefill( pxCtx );
+        }
+
+        if( pxCtx->ulRxRingCount > 0 )
+        {
+            pxCtx->ulRxRingCount--;
+            pxRxBuff = pxCtx->pxRxRing[ pxCtx->ulRxRingCount ];
+            pxCtx->pxRxRing[ pxCtx->ulRxRingCount ] = NULL;
+
+            pbuf_realloc( pxRxBuff, usRxLen );
+        }
+    }
+
+    if( pxRxBuff == NULL )
+    {
+        LogWarn( "No rx buffer available for a %d byte message, dropping it.", usRxLen );
+        pxCtx->ulRxDropped++;
+        RX_STATS_DROP();
+    }
+
+    return pxRxBuff;
+}
+
+/* A frame taken off one of the send queues for the current transaction */
+typedef struct
+{
+    MxTxQueueItem_t xItem;
+    MxTxClass_t xClass;
+} MxTxFrame_t;
+
+static const uint8_t ucTxWeights[ MX_TX_CLASS_MAX ] =
+{
+    MX_TX_WEIGHT_CONTROL,
+    MX_TX_WEIGHT_INTERACTIVE,
+    MX_TX_WEIGHT_BULK
+};
+
+static inline QueueHandle_t xTxClassQueue( MxDataplaneCtx_t * pxCtx,
+                                           MxTxClass_t xClass )
+{
+    QueueHandle_t xQueue = pxCtx->xDataPlaneSendQueue;
+
+    if( xClass == MX_TX_CLASS_CONTROL )
+    {
+        xQueue = pxCtx->xControlPlaneSendQueue;
+    }
+    else if( xClass == MX_TX_CLASS_INTERACTIVE )
+    {
+        xQueue = pxCtx->xInteractiveSendQueue;
+    }
+
+    return xQueue;
+}
+
+/*
+ * Weighted round robin: serve the highest priority class that has frames queued and credit left.
+ * A new round starts once every class with frames queued has used up its credit.
+ * Returns MX_TX_CLASS_MAX when all send queues are empty.
+ */
+static MxTxClass_t xSelectTxClass( MxDataplaneCtx_t * pxCtx )
+{
+    MxTxClass_t xSelected = MX_TX_CLASS_MAX;
+
+    for( uint32_t ulPass = 0; ( ulPass < 2 ) && ( xSelected == MX_TX_CLASS_MAX ); ulPass++ )
+    {
+        BaseType_t xPending = pdFALSE;
+
+        for( uint32_t ulClass = 0; ulClass < MX_TX_CLASS_MAX; ulClass++ )
+        {
+            if( uxQueueMessagesWaiting( xTxClassQueue( pxCtx, ( MxTxClass_t ) ulClass ) ) > 0 )
+            {
+                xPending = pdTRUE;
+
+                if( pxCtx->ucTxCredits[ ulClass ] > 0 )
+                {
+                    xSelected = ( MxTxClass_t ) ulClass;
+                    break;
+                }
+            }
+        }
+
+        if( xPending == pdFALSE )
+        {
+            break;
+        }
+
+        if( xSelected == MX_TX_CLASS_MAX )
+        {
+            ( void ) memcpy( pxCtx->ucTxCredits, ucTxWeights, sizeof( ucTxWeights ) );
+        }
+    }
+
+    return xSelected;
+}
+
+/* Account for a frame sent to the module, measuring its latency from the time it was queued */
+static void prvRecordTxStats( MxDataplaneCtx_t * pxCtx,
+                              const MxTxFrame_t * pxFrame )
+{
+    MxTxClassStats_t * pxStats = &( pxCtx->xTxStats[ pxFrame->xClass ] );
+    uint32_t ulLatency = ( uint32_t ) ( xTaskGetTickCount() - pxFrame->xItem.xEnqueueTime );
+
+    pxStats->ulFrames++;
+    pxStats->ulLatencyTotal += ulLatency;
+
+    if( ulLatency > pxStats->ulLatencyMax )
+    {
+        pxStats->ulLatencyMax = ulLatency;
+    }
+}
+
+/*
+ * Take the frames to send in this transaction off the send queues, in the order chosen by
+ * xSelectTxClass. Once the module has advertised multi-frame support, further frames are packed
+ * behind the first one while they fit in a single message.
+ * Returns the number of frames taken.
+ */
+static uint32_t prvDequeueTxFrames( MxDataplaneCtx_t * pxCtx,
+                                    MxTxFrame_t * pxFrames,
+                                    uint8_t ** ppucTxData,
+                                    uint16_t * pusTxLen )
+{
+    uint32_t ulMaxFrames = ( pxCtx->xMultiFrame == pdTRUE ) ? MX_SPI_MAX_FRAMES : 1;
+    uint32_t ulFrames = 0;
+    uint32_t ulPackedLen = 0;
+
+    while( ulFrames < ulMaxFrames )
+    {
+        MxTxClass_t xClass = xSelectTxClass( pxCtx );
+        QueueHandle_t xQueue = NULL;
+        MxTxFrame_t * pxFrame = &( pxFrames[ ulFrames ] );
+        UBaseType_t uxDepth = 0;
+
+        if( xClass == MX_TX_CLASS_MAX )
+        {
+            break;
+        }
+
+        xQueue = xTxClassQueue( pxCtx, xClass );
+
+        if( xQueuePeek( xQueue, &( pxFrame->xItem ), 0 ) != pdTRUE )
+        {
+            break;
+        }
+
+        configASSERT( pxFrame->xItem.pxPacket != NULL );
+        configASSERT( pxFrame->xItem.pxPacket->ref > 0 );
+
+        if( ( ulFrames > 0 ) &&
+            ( ( ulPackedLen + MX_SPI_FRAME_PREFIX_LEN + pxFrame->xItem.pxPacket->tot_len ) >= MX_MAX_MESSAGE_LEN ) )
+        {
+            break;
+        }
+
+        uxDepth = uxQueueMessagesWaiting( xQueue );
+
+        ( void ) xQueueReceive( xQueue, &( pxFrame->xItem ), 0 );
+
+        pxFrame->xClass = xClass;
+        pxCtx->ucTxCredits[ xClass ]--;
+
+        if( uxDepth > pxCtx->xTxStats[ xClass ].ulMaxDepth )
+        {
+            pxCtx->xTxStats[ xClass ].ulMaxDepth = uxDepth;
+        }
+
+        ulFrames++;
+        ulPackedLen += MX_SPI_FRAME_PREFIX_LEN + pxFrame->xItem.pxPacket->tot_len;
+    }
+
+    if( ulFrames == 1 )
+    {
+        *ppucTxData = pxFrames[ 0 ].xItem.pxPacket->payload;
+        *pusTxLen = pxFrames[ 0 ].xItem.pxPacket->tot_len;
+    }
+
+    #if MX_SPI_MULTI_FRAME
+        else if( ulFrames > 1 )
+        {
+            uint32_t ulOffset = 0;
+
+            for( uint32_t ulFrame = 0; ulFrame < ulFrames; ulFrame++ )
+            {
+                PacketBuffer_t * pxPacket = pxFrames[ ulFrame ].xItem.pxPacket;
+                uint16_t usFrameLen = pxPacket->tot_len;
+
+                pxCtx->ucTxPackBuffer[ ulOffset ] = ( uint8_t ) ( usFrameLen & 0xFF );
+                pxCtx->ucTxPackBuffer[ ulOffset + 1 ] = ( uint8_t ) ( usFrameLen >> 8 );
+                ulOffset += MX_SPI_FRAME_PREFIX_LEN;
+
+                ( void ) pbuf_copy_partial( pxPacket, &( pxCtx->ucTxPackBuffer[ ulOffset ] ), usFrameLen, 0 );
+                ulOffset += usFrameLen;
+            }
+
+            *ppucTxData = pxCtx->ucTxPackBuffer;
+            *pusTxLen = ( uint16_t ) ulOffset;
+        }
+    #endif /* MX_SPI_MULTI_FRAME */
+    else
+    {
+        *ppucTxData = NULL;
+        *pusTxLen = 0;
+    }
+
+    return ulFrames;
+}
+
+/*
+ * Return frames that were not sent to the front of their queues, keeping their order and
+ * enqueue time, so that they are retried in the next transaction.
+ */
+static void prvRequeueTxFrames( MxDataplaneCtx_t * pxCtx,
+                                MxTxFrame_t * pxFrames,
+                                uint32_t ulFrames )
+{
+    while( ulFrames > 0 )
+    {
+        MxTxFrame_t * pxFrame = NULL;
+
+        ulFrames--;
+        pxFrame = &( pxFrames[ ulFrames ] );
+
+        pxCtx->ucTxCredits[ pxFrame->xClass ]++;
+
+        if( xQueueSendToFront( xTxClassQueue( pxCtx, pxFrame->xClass ), &( pxFrame->xItem ), 0 ) != pdTRUE )
+        {
+            LogWarn( "Send queue full, dropping packet %p.", pxFrame->xItem.pxPacket );
+            ( void ) Atomic_Decrement_u32( &( pxCtx->ulTxPacketsWaiting ) );
+            PBUF_FREE( pxFrame->xItem.pxPacket );
+        }
+
+        pxFrame->xItem.pxPacket = NULL;
+    }
+}
+
+#if MX_SPI_MULTI_FRAME
+
+/* Split a payload of packed frames received into ucRxPackBuffer into one packet buffer per frame */
+    static void prvProcessPackedRxFrames( MxDataplaneCtx_t * pxCtx,
+                                          uint16_t usRxLen,
+                                          uint8_t ucRxFrames )
+    {
+        uint32_t ulOffset = 0;
+        uint8_t ucFrame = 0;
+
+        while( ( ucFrame < ucRxFrames ) &&
+               ( ( ulOffset + MX_SPI_FRAME_PREFIX_LEN ) <= usRxLen ) )
+        {
+            uint16_t usFrameLen = ( uint16_t ) ( pxCtx->ucRxPackBuffer[ ulOffset ] |
+                                                 ( pxCtx->ucRxPackBuffer[ ulOffset + 1 ] << 8 ) );
+            PacketBuffer_t * pxRxBuff = NULL;
+
+            ulOffset += MX_SPI_FRAME_PREFIX_LEN;
+
+            if( ( usFrameLen == 0 ) ||
+                ( ( ulOffset + usFrameLen ) > usRxLen ) )
+            {
+                break;
+            }
+
+            pxRxBuff = prvRxRingTake( pxCtx, usFrameLen );
+
+            if( pxRxBuff != NULL )
+            {
+                ( void ) pbuf_take( pxRxBuff, &( pxCtx->ucRxPackBuffer[ ulOffset ] ), usFrameLen );
+                vProcessRxPacket( pxCtx->xControlPlaneResponseBuff, pxCtx->pxNetif, &pxRxBuff );
+                pxCtx->ulRxFrames++;
+            }
+
+            ulOffset += usFrameLen;
+            ucFrame++;
+        }
+
+        if( ( ucFrame != ucRxFrames ) ||
+            ( ulOffset != usRxLen ) )
+        {
+            LogError( "Malformed multi-frame payload: %d of %d frames, %d of %d bytes.",
+                      ucFrame, ucRxFrames, ulOffset, usRxLen );
+        }
+    }
+
+#endif /* MX_SPI_MULTI_FRAME */
+
 void vDataplaneThread( void * pvParameters )
 {
     /* Get context struct (contains instance parameters) */
@@ -508,8 +915,11 @@ void vDataplaneThread( void * pvParameters )
 
     while( exitFlag == pdFALSE )
     {
-        PacketBuffer_t * pxTxBuff = NULL;
+        MxTxFrame_t xTxFrames[ MX_SPI_MAX_FRAMES ] = { 0 };
+        uint32_t ulTxFrames = 0;
         PacketBuffer_t * pxRxBuff = NULL;
+        uint8_t ucRxFrames = 0;
+        uint16_t usRxLen = 0;
 
         if( pxCtx->ulTxPacketsWaiting == 0 )
         {
@@ -526,6 +936,18 @@ void vDataplaneThread( void * pvParameters )
             continue;
         }
 
+        /* Keep a DMA target armed before clocking the module */
+        prvRxRingRefill( pxCtx );
+
+        /* Without one, leave pending frames with the module, but still send when it has none */
+        if( ( pxCtx->ulRxRingCount == 0 ) &&
+            ( xGpioGet( pxCtx->gpio_notify ) == pdTRUE ) )
+        {
+            pxCtx->ulRxDeferred++;
+            vTaskDelay( pdMS_TO_TICKS( MX_RX_RING_RETRY_MS ) );
+            continue;
+        }
+
         /* Clear flow state */
         xTaskNotifyStateClearIndexed( NULL, SPI_EVT_FLOW_IDX );
 
@@ -538,96 +960,96 @@ void vDataplaneThread( void * pvParameters )
         if( xWaitForFlow( pxCtx ) == pdTRUE )
         {
             uint16_t usTxLen = 0;
-            uint16_t usRxLen = 0;
+            uint8_t * pucTxData = NULL;
 
-            QueueHandle_t xSourceQueue = NULL;
+            /* Prepare messages for TX, as scheduled between the control, interactive and bulk classes */
+            ulTxFrames = prvDequeueTxFrames( pxCtx, xTxFrames, &pucTxData, &usTxLen );
 
-            /* Prepare a control plane messages for TX */
-            if( xQueuePeek( pxCtx->xControlPlaneSendQueue, &pxTxBuff, 0 ) == pdTRUE )
-            {
-                configASSERT( pxTxBuff != NULL );
-                configASSERT( pxTxBuff->ref > 0 );
-                usTxLen = pxTxBuff->tot_len;
-                xSourceQueue = pxCtx->xControlPlaneSendQueue;
-                LogDebug( "Preparing controlplane message for transmission" );
-            }
-            else if( xQueuePeek( pxCtx->xDataPlaneSendQueue, &pxTxBuff, 0 ) == pdTRUE )
-            {
-                configASSERT( pxTxBuff != NULL );
-                configASSERT( pxTxBuff->ref > 0 );
-                usTxLen = pxTxBuff->tot_len;
-                xSourceQueue = pxCtx->xDataPlaneSendQueue;
-                LogDebug( "Preparing dataplane message for transmission" );
-            }
-            else
-            {
-                /* Empty, no TX packets */
-            }
-
-            if( ( pxTxBuff == NULL ) &&
+            if( ( ulTxFrames == 0 ) &&
                 ( pxCtx->ulTxPacketsWaiting != 0 ) )
             {
                 LogWarn( "Mismatch between ulTxPacketsWaiting and queue contents. Resetting ulTxPacketsWaiting" );
                 pxSpiCtx->ulTxPacketsWaiting = 0;
             }
 
-            if( xResult == pdTRUE )
-            {
-                /* Transfer the header */
-                xResult = xDoSpiHeaderTransfer( pxCtx, &usTxLen, &usRxLen );
-            }
+            /* Transfer the header */
+            xResult = xDoSpiHeaderTransfer( pxCtx, &usTxLen, &usRxLen,
+                                            ( uint8_t ) ( ( ulTxFrames > 1 ) ? ulTxFrames : 0 ),
+                                            &ucRxFrames );
 
             if( xResult == pdTRUE )
             {
                 /* Allocate RX buffer */
-                if( usRxLen > 0 )
+                if( ( usRxLen > 0 ) &&
+                    ( ucRxFrames == 0 ) )
                 {
-                    pxRxBuff = PBUF_ALLOC_RX( usRxLen );
+                    pxRxBuff = prvRxRingTake( pxCtx, usRxLen );
+
+                    if( pxRxBuff == NULL )
+                    {
+                        usRxLen = 0;
+                    }
                 }
 
                 /* Wait for flow pin to go high */
                 xResult = xWaitForFlow( pxCtx );
             }
 
-            /* Read from the queue */
-            if( ( xResult == pdTRUE ) &&
-                ( xSourceQueue != NULL ) )
-            {
-                xResult = xQueueReceive( xSourceQueue, &pxTxBuff, 0 );
-                configASSERT( pxTxBuff != NULL );
-                configASSERT( xResult == pdTRUE );
-            }
-            else if( pxTxBuff != NULL )
+            /* Frames are kept queued until the module is ready to receive them */
+            if( ( xResult != pdTRUE ) ||
+                ( usTxLen == 0 ) )
             {
-                pxTxBuff = NULL;
+                prvRequeueTxFrames( pxCtx, xTxFrames, ulTxFrames );
+                ulTxFrames = 0;
+                usTxLen = 0;
             }
 
             /* Transmit / receive packet data */
             if( xResult == pdTRUE )
             {
+                uint8_t * pucRxData = NULL;
+
+                #if MX_SPI_MULTI_FRAME
+                    if( ucRxFrames > 0 )
+                    {
+                        pucRxData = pxCtx->ucRxPackBuffer;
+                    }
+                    else
+                #endif
+                {
+                    pucRxData = ( pxRxBuff != NULL ) ? pxRxBuff->payload : NULL;
+                }
+
+                /* Scatter-gather case: walk the chain rather than copying it */
+                if( ( ulTxFrames == 1 ) &&
+                    ( usTxLen > 0 ) &&
+                    ( xTxFrames[ 0 ].xItem.pxPacket->next != NULL ) )
+                {
+                    xResult = xTransferChain( pxCtx, xTxFrames[ 0 ].xItem.pxPacket, pucRxData, usRxLen );
+                }
                 /* Transmit case */
-                if( ( usTxLen > 0 ) &&
-                    ( usRxLen == 0 ) )
+                else if( ( usTxLen > 0 ) &&
+                         ( usRxLen == 0 ) )
                 {
-                    configASSERT( pxTxBuff );
-                    xResult = xTransmitMessage( pxCtx, pxTxBuff->payload, usTxLen );
+                    configASSERT( pucTxData );
+                    xResult = xTransmitMessage( pxCtx, pucTxData, usTxLen );
                 }
                 else if( ( usRxLen > 0 ) &&
                          ( usTxLen == 0 ) )
                 {
-                    configASSERT( pxRxBuff );
-                    xResult = xReceiveMessage( pxCtx, pxRxBuff->payload, usRxLen );
+                    configASSERT( pucRxData );
+                    xResult = xReceiveMessage( pxCtx, pucRxData, usRxLen );
                 }
                 else if( ( usRxLen > 0 ) &&
                          ( usTxLen > 0 ) )
                 {
-                    configASSERT( pxRxBuff );
-                    configASSERT( pxTxBuff );
+                    configASSERT( pucRxData );
+                    configASSERT( pucTxData );
 
                     xResult = xTransmitReceiveMessage( pxCtx,
-                                                       pxTxBuff->payload,
+                                                       pucTxData,
                                                        usTxLen,
-                                                       pxRxBuff->payload,
+                                                       pucRxData,
                                                        usRxLen );
                 }
             }
@@ -641,20 +1063,36 @@ void vDataplaneThread( void * pvParameters )
         /* Set CS / NSS high (idle) */
         vGpioSet( pxCtx->gpio_nss );
 
-        if( pxTxBuff != NULL )
+        pxCtx->ulSpiTransactions++;
+        pxCtx->ulTxFrames += ulTxFrames;
+
+        for( uint32_t ulFrame = 0; ulFrame < ulTxFrames; ulFrame++ )
         {
+            PacketBuffer_t * pxTxBuff = xTxFrames[ ulFrame ].xItem.pxPacket;
+
+            prvRecordTxStats( pxCtx, &( xTxFrames[ ulFrame ] ) );
+
             /* Decrement TX packets waiting counter */
             ( void ) Atomic_Decrement_u32( &( pxSpiCtx->ulTxPacketsWaiting ) );
 
             /* Free the TX buffer */
             LogDebug( "Decreasing reference count of pxTxBuff %p from %d to %d", pxTxBuff, pxTxBuff->ref, ( pxTxBuff->ref - 1 ) );
             PBUF_FREE( pxTxBuff );
-            pxTxBuff = NULL;
+            xTxFrames[ ulFrame ].xItem.pxPacket = NULL;
         }
 
+        #if MX_SPI_MULTI_FRAME
+            if( ( xResult == pdTRUE ) &&
+                ( ucRxFrames > 0 ) )
+            {
+                prvProcessPackedRxFrames( pxCtx, usRxLen, ucRxFrames );
+            }
+        #endif
+
         if( ( xResult == pdTRUE ) &&
             ( pxRxBuff != NULL ) )
         {
+            pxCtx->ulRxFrames++;
             vProcessRxPacket( pxCtx->xControlPlaneResponseBuff, pxCtx->pxNetif, &pxRxBuff );
         }
         else if( pxRxBuff != NULL )
@@ -664,7 +1102,6 @@ void vDataplaneThread( void * pvParameters )
             pxRxBuff = NULL;
         }
 
-        configASSERT( pxTxBuff == NULL );
         configASSERT( pxRxBuff == NULL );
     }
 }
@@ -40,12 +40,20 @@
 
 
 /* Local types and enumerations */
-typedef struct
+typedef struct IPCRequestCtx
 {
     volatile uint32_t ulRequestID;
     PacketBuffer_t * pxTxPbuf;
     PacketBuffer_t * pxRxPbuf;
     TaskHandle_t xWaitingTask;
+
+    /* Asynchronous requests */
+    MxRequestCallback_t xCallback;
+    void * pvCallbackCtx;
+    void * pvResponse;
+    uint32_t ulResponseLength;
+    TickType_t xDeadline;
+    struct IPCRequestCtx * pxNextTimer; /* Next request in the same timer wheel slot */
 } IPCRequestCtx_t;
 
 /* Static variables */
@@ -54,6 +62,125 @@ static SemaphoreHandle_t xContextArrayMutex = NULL;     /* Mutex that must be he
 static SemaphoreHandle_t xContextCountSemaphore = NULL; /* Allow clients to block while waiting for an IPCRequestCtx_t. */
 static ControlPlaneCtx_t * pxControlPlaneCtx = NULL;
 
+/*
+ * Timeouts of asynchronous requests are kept in a hashed timer wheel serviced by the control plane
+ * router task. Each slot covers IPC_TIMER_WHEEL_RESOLUTION ticks; deadlines more than one rotation
+ * away stay in their slot until they are reached. Protected by xContextArrayMutex.
+ */
+static IPCRequestCtx_t * pxTimerWheel[ IPC_TIMER_WHEEL_SLOTS ] = { NULL };
+static TickType_t xTimerWheelTime = 0; /* Start of the slot the wheel is at */
+static uint32_t ulTimersPending = 0;
+
+/* pdTRUE when xTime is not later than xNow, allowing for tick count overflow */
+#define TICK_REACHED( xNow, xTime )    ( ( TickType_t ) ( ( xNow ) - ( xTime ) ) < ( portMAX_DELAY / 2 ) )
+
+static inline uint32_t ulTimerWheelSlot( TickType_t xTime )
+{
+    return ( xTime / IPC_TIMER_WHEEL_RESOLUTION ) % IPC_TIMER_WHEEL_SLOTS;
+}
+
+static void prvTimerWheelInsert( IPCRequestCtx_t * pxRequestCtx )
+{
+    uint32_t ulSlot = ulTimerWheelSlot( pxRequestCtx->xDeadline );
+
+    if( ulTimersPending == 0 )
+    {
+        TickType_t xNow = xTaskGetTickCount();
+
+        xTimerWheelTime = xNow - ( xNow % IPC_TIMER_WHEEL_RESOLUTION );
+    }
+
+    pxRequestCtx->pxNextTimer = pxTimerWheel[ ulSlot ];
+    pxTimerWheel[ ulSlot ] = pxRequestCtx;
+    ulTimersPending++;
+}
+
+static BaseType_t xTimerWheelRemove( IPCRequestCtx_t * pxRequestCtx )
+{
+    IPCRequestCtx_t ** ppxLink = &( pxTimerWheel[ ulTimerWheelSlot( pxRequestCtx->xDeadline ) ] );
+    BaseType_t xRemoved = pdFALSE;
+
+    while( ( *ppxLink != NULL ) &&
+           ( *ppxLink != pxRequestCtx ) )
+    {
+        ppxLink = &( ( *ppxLink )->pxNextTimer );
+    }
+
+    if( *ppxLink == pxRequestCtx )
+    {
+        *ppxLink = pxRequestCtx->pxNextTimer;
+        pxRequestCtx->pxNextTimer = NULL;
+        ulTimersPending--;
+        xRemoved = pdTRUE;
+    }
+
+    return xRemoved;
+}
+
+/*
+ * Post an empty message to the router so that it starts servicing the timer wheel. The dataplane
+ * also writes to xControlPlaneResponseBuff, so both writers do so from a critical section.
+ * A full buffer means the router is about to run anyway.
+ */
+static void prvWakeRouter( void )
+{
+    PacketBuffer_t * pxWakeup = NULL;
+
+    taskENTER_CRITICAL();
+    ( void ) xMessageBufferSend( pxControlPlaneCtx->xControlPlaneResponseBuff,
+                                 &pxWakeup,
+                                 sizeof( PacketBuffer_t * ),
+                                 0 );
+    taskEXIT_CRITICAL();
+}
+
+/* Unlink the requests whose deadline has passed and return them as a list */
+static IPCRequestCtx_t * pxTimerWheelExpire( TickType_t xNow )
+{
+    IPCRequestCtx_t * pxExpired = NULL;
+    uint32_t ulSlotsAdvanced = 0;
+
+    while( ulTimersPending > 0 )
+    {
+        IPCRequestCtx_t ** ppxLink = &( pxTimerWheel[ ulTimerWheelSlot( xTimerWheelTime ) ] );
+
+        while( *ppxLink != NULL )
+        {
+            IPCRequestCtx_t * pxRequestCtx = *ppxLink;
+
+            if( TICK_REACHED( xNow, pxRequestCtx->xDeadline ) )
+            {
+                *ppxLink = pxRequestCtx->pxNextTimer;
+                pxRequestCtx->pxNextTimer = pxExpired;
+                pxExpired = pxRequestCtx;
+                ulTimersPending--;
+            }
+            else
+            {
+                ppxLink = &( pxRequestCtx->pxNextTimer );
+            }
+        }
+
+        /* Stay on the current slot, it may hold deadlines later in the same period */
+        if( ( ( TickType_t ) ( xNow - xTimerWheelTime ) < IPC_TIMER_WHEEL_RESOLUTION ) ||
+            ( ulSlotsAdvanced >= IPC_TIMER_WHEEL_SLOTS ) )
+        {
+            break;
+        }
+
+        xTimerWheelTime += IPC_TIMER_WHEEL_RESOLUTION;
+        ulSlotsAdvanced++;
+    }
+
+    /* After a full rotation every slot has been checked, catch up with the current time */
+    if( ulSlotsAdvanced >= IPC_TIMER_WHEEL_SLOTS )
+    {
+        xTimerWheelTime = xNow - ( xNow % IPC_TIMER_WHEEL_RESOLUTION );
+    }
+
+    return pxExpired;
+}
+
 static void vClearCtx( IPCRequestCtx_t * pxRequestCtx )
 {
     if( pxRequestCtx != NULL )
@@ -79,6 +206,13 @@ static void vClearCtx( IPCRequestCtx_t * pxRequestCtx )
         /* Clear the handle of the waiting task */
         pxRequestCtx->xWaitingTask = NULL;
 
+        /* Clear asynchronous request state */
+        pxRequestCtx->xCallback = NULL;
+        pxRequestCtx->pvCallbackCtx = NULL;
+        pxRequestCtx->pvResponse = NULL;
+        pxRequestCtx->ulResponseLength = 0;
+        pxRequestCtx->pxNextTimer = NULL;
+
         /* Free the response buffer pbuf and clear the pointer */
         if( pxRequestCtx->pxRxPbuf != NULL )
         {
@@ -109,13 +243,11 @@ static IPCRequestCtx_t * pxFindAvailableCtx( TickType_t xTimeout,
     /* Wait for a context to become available, then take a token from xContextCountSemaphore */
     xResult = xSemaphoreTake( xContextCountSemaphore, xTimeout );
 
-    configASSERT( xResult == pdTRUE );
-
-    configASSERT( xContextArrayMutex != NULL );
-
-    xResult = xSemaphoreTake( xContextArrayMutex, xTimeout );
-
-    if( xResult == pdTRUE )
+    if( xResult != pdTRUE )
+    {
+        LogError( "Timed out while waiting for a free request context." );
+    }
+    else if( xSemaphoreTake( xContextArrayMutex, xTimeout ) == pdTRUE )
     {
         for( uint32_t i = 0; i < NUM_IPC_REQUEST_CTX; i++ )
         {
@@ -157,11 +289,59 @@ static IPCRequestCtx_t * pxFindAvailableCtx( TickType_t xTimeout,
     else
     {
         LogError( "Timed out while acquiring xContextArrayMutex." );
+        ( void ) xSemaphoreGive( xContextCountSemaphore );
     }
 
     return pxRequestCtx;
 }
 
+/* Hand the request packet of pxRequestCtx to the dataplane thread for transmission */
+static BaseType_t xEnqueueRequest( IPCRequestCtx_t * pxRequestCtx,
+                                   IPCPacket_t * pxTxPkt,
+                                   uint32_t ulTxPacketLen,
+                                   TickType_t xTimeout )
+{
+    BaseType_t xResult;
+
+    /* Set request ID */
+    pxTxPkt->xHeader.ulIPCRequestId = pxRequestCtx->ulRequestID;
+
+    /* Copy to pbuf */
+    ( void ) memcpy( pxRequestCtx->pxTxPbuf->payload, pxTxPkt, ulTxPacketLen );
+
+    configASSERT( pxControlPlaneCtx->xControlPlaneSendQueue != NULL );
+
+    MxTxQueueItem_t xTxItem =
+    {
+        .pxPacket     = pxRequestCtx->pxTxPbuf,
+        .xEnqueueTime = xTaskGetTickCount()
+    };
+
+    /* Send to dataplane thread for transmission */
+    xResult = xQueueSend( pxControlPlaneCtx->xControlPlaneSendQueue,
+                          &xTxItem,
+                          xTimeout );
+
+    if( xResult != pdTRUE )
+    {
+        LogError( "Error when sending message with request id=%d", pxRequestCtx->ulRequestID );
+    }
+    else
+    {
+        Atomic_Increment_u32( pxControlPlaneCtx->pulTxPacketsWaiting );
+
+        /* Clear the pointer. Reference is now owned by the queue. */
+        pxRequestCtx->pxTxPbuf = NULL;
+
+        configASSERT( pxControlPlaneCtx->xDataPlaneTaskHandle != NULL );
+
+        /* Notify dataplane thread of a waiting message */
+        xTaskNotifyGiveIndexed( pxControlPlaneCtx->xDataPlaneTaskHandle, DATA_WAITING_IDX );
+    }
+
+    return xResult;
+}
+
 static IPCError_t xSendIPCRequest( IPCPacket_t * pxTxPkt,
                                    uint32_t ulTxPacketDataLen,
                                    void * pxResponse,
@@ -184,9 +364,6 @@ static IPCError_t xSendIPCRequest( IPCPacket_t * pxTxPkt,
     /* Allocate a request context */
     IPCRequestCtx_t * pxRequestCtx = pxFindAvailableCtx( xTimeout, ulTxPacketLen );
 
-    LogDebug( "Sending IPC packet with request_id: %d, api_id: %d, pktdatalen: %d, total_len: %d",
-              pxRequestCtx->ulRequestID, pxTxPkt->xHeader.usIPCApiId, ulTxPacketDataLen, ulTxPacketLen );
-
     if( pxRequestCtx == NULL )
     {
         LogError( "Timed out while finding a request context." );
@@ -194,39 +371,18 @@ static IPCError_t xSendIPCRequest( IPCPacket_t * pxTxPkt,
     }
     else
     {
-        /* Set request ID */
-        pxTxPkt->xHeader.ulIPCRequestId = pxRequestCtx->ulRequestID;
+        LogDebug( "Sending IPC packet with request_id: %d, api_id: %d, pktdatalen: %d, total_len: %d",
+                  pxRequestCtx->ulRequestID, pxTxPkt->xHeader.usIPCApiId, ulTxPacketDataLen, ulTxPacketLen );
 
         /* Set task handle */
         pxRequestCtx->xWaitingTask = xTaskGetCurrentTaskHandle();
 
-        /* Copy to pbuf */
-        ( void ) memcpy( pxRequestCtx->pxTxPbuf->payload, pxTxPkt, ulTxPacketLen );
-
-        configASSERT( pxControlPlaneCtx->xControlPlaneSendQueue != NULL );
-
-        /* Send to dataplane thread for transmission */
-        xResult = xQueueSend( pxControlPlaneCtx->xControlPlaneSendQueue,
-                              &( pxRequestCtx->pxTxPbuf ),
-                              xTimeout );
-
-        Atomic_Increment_u32( pxControlPlaneCtx->pulTxPacketsWaiting );
+        xResult = xEnqueueRequest( pxRequestCtx, pxTxPkt, ulTxPacketLen, xTimeout );
 
         if( xResult != pdTRUE )
         {
-            LogError( "Error when sending message with request id=%d", pxRequestCtx->ulRequestID );
             xReturnValue = IPC_ERROR_INTERNAL;
         }
-        else
-        {
-            /* Clear the pointer. Reference is now owned by the queue. */
-            pxRequestCtx->pxTxPbuf = NULL;
-
-            configASSERT( pxControlPlaneCtx->xDataPlaneTaskHandle != NULL );
-
-            /* Notify dataplane thread of a waiting message */
-            xTaskNotifyGiveIndexed( pxControlPlaneCtx->xDataPlaneTaskHandle, DATA_WAITING_IDX );
-        }
     }
 
     IPCPacket_t * pxResponsePacket = NULL;
@@ -262,6 +418,116 @@ static IPCError_t xSendIPCRequest( IPCPacket_t * pxTxPkt,
     return xReturnValue;
 }
 
+/*
+ * Queue a request without waiting for its response. The response is copied to pxResponse by the
+ * control plane router task, which then calls xCallback, or calls it with IPC_TIMEOUT once
+ * xTimeout has passed. Only waits for a free request context.
+ */
+static IPCError_t xSendIPCRequestAsync( IPCPacket_t * pxTxPkt,
+                                        uint32_t ulTxPacketDataLen,
+                                        void * pxResponse,
+                                        uint32_t ulResponseLength,
+                                        MxRequestCallback_t xCallback,
+                                        void * pvCallbackCtx,
+                                        TickType_t xTimeout )
+{
+    IPCError_t xReturnValue = IPC_SUCCESS;
+    IPCRequestCtx_t * pxRequestCtx = NULL;
+
+    /* Validate inputs */
+    configASSERT( pxTxPkt != NULL );
+
+    configASSERT( ulTxPacketDataLen <= sizeof( IPCPacketData_t ) );
+
+    configASSERT( ( pxResponse != NULL && ulResponseLength > 0 ) ||
+                  ( pxResponse == NULL && ulResponseLength == 0 ) );
+
+    BaseType_t ulTxPacketLen = sizeof( IPCHeader_t ) + ulTxPacketDataLen;
+
+    if( xCallback == NULL )
+    {
+        xReturnValue = IPC_PARAMETER_ERROR;
+    }
+    else
+    {
+        pxRequestCtx = pxFindAvailableCtx( xTimeout, ulTxPacketLen );
+
+        if( pxRequestCtx == NULL )
+        {
+            LogError( "Timed out while finding a request context." );
+            xReturnValue = IPC_ERROR_INTERNAL;
+        }
+    }
+
+    if( xReturnValue == IPC_SUCCESS )
+    {
+        BaseType_t xWakeRouter = pdFALSE;
+
+        if( xSemaphoreTake( xContextArrayMutex, pdMS_TO_TICKS( MX_DEFAULT_TIMEOUT_MS ) ) != pdTRUE )
+        {
+            LogError( "Timed out while acquiring xContextArrayMutex." );
+            vClearCtx( pxRequestCtx );
+            xReturnValue = IPC_TIMEOUT;
+        }
+        else
+        {
+            BaseType_t xResult;
+
+            pxRequestCtx->xCallback = xCallback;
+            pxRequestCtx->pvCallbackCtx = pvCallbackCtx;
+            pxRequestCtx->pvResponse = pxResponse;
+            pxRequestCtx->ulResponseLength = ulResponseLength;
+            pxRequestCtx->xDeadline = xTaskGetTickCount() + xTimeout;
+
+            /* Queue without blocking while holding the mutex, so the response cannot overtake us */
+            if( xEnqueueRequest( pxRequestCtx, pxTxPkt, ulTxPacketLen, 0 ) != pdTRUE )
+            {
+                xReturnValue = IPC_ERROR_INTERNAL;
+            }
+            else if( xTimeout != portMAX_DELAY )
+            {
+                /* The router blocks without a timeout while the wheel is empty */
+                xWakeRouter = ( ulTimersPending == 0 ) ? pdTRUE : pdFALSE;
+                prvTimerWheelInsert( pxRequestCtx );
+            }
+            else
+            {
+                /* Empty */
+            }
+
+            xResult = xSemaphoreGive( xContextArrayMutex );
+            configASSERT( xResult == pdTRUE );
+
+            if( xReturnValue != IPC_SUCCESS )
+            {
+                vClearCtx( pxRequestCtx );
+            }
+            else if( xWakeRouter == pdTRUE )
+            {
+                prvWakeRouter();
+            }
+            else
+            {
+                /* Empty */
+            }
+        }
+    }
+
+    return xReturnValue;
+}
+
+/* Report completion of an asynchronous request and release its context */
+static void prvCompleteAsyncRequest( IPCRequestCtx_t * pxRequestCtx,
+                                     MxRequestCallback_t xCallback,
+                                     IPCError_t xError )
+{
+    LogDebug( "Completing async request id: %d with status %d", pxRequestCtx->ulRequestID, xError );
+
+    xCallback( xError, pxRequestCtx->pvCallbackCtx );
+
+    vClearCtx( pxRequestCtx );
+}
+
 IPCError_t mx_RequestVersion( char * pcVersionBuffer,
                               uint32_t ulVersionLength,
                               TickType_t xTimeout )
@@ -288,6 +554,35 @@ IPCError_t mx_RequestVersion( char * pcVersionBuffer,
     return xReturnValue;
 }
 
+IPCError_t mx_RequestVersionAsync( char * pcVersionBuffer,
+                                   uint32_t ulVersionLength,
+                                   MxRequestCallback_t xCallback,
+                                   void * pvCallbackCtx,
+                                   TickType_t xTimeout )
+{
+    IPCError_t xReturnValue = IPC_SUCCESS;
+
+    IPCPacket_t xTxPkt;
+
+    xTxPkt.xHeader.usIPCApiId = IPC_SYS_VERSION;
+
+    if( ( pcVersionBuffer != NULL ) &&
+        ( ulVersionLength >= MX_FIRMWARE_REVISION_SIZE ) )
+    {
+        xReturnValue = xSendIPCRequestAsync( &xTxPkt, 0,
+                                             ( IPCPacketData_t * ) pcVersionBuffer,
+                                             ulVersionLength,
+                                             xCallback, pvCallbackCtx,
+                                             xTimeout );
+    }
+    else
+    {
+        xReturnValue = IPC_PARAMETER_ERROR;
+    }
+
+    return xReturnValue;
+}
+
 IPCError_t mx_FactoryReset( TickType_t xTimeout )
 {
     IPCError_t xReturnValue = IPC_SUCCESS;
@@ -326,9 +621,39 @@ IPCError_t mx_GetMacAddress( MacAddress_t * pxMacAddress,
     return xReturnValue;
 }
 
-IPCError_t mx_Connect( const char * pcSSID,
-                       const char * pcPSK,
-                       TickType_t xTimeout )
+IPCError_t mx_GetMacAddressAsync( MacAddress_t * pxMacAddress,
+                                  MxRequestCallback_t xCallback,
+                                  void * pvCallbackCtx,
+                                  TickType_t xTimeout )
+{
+    IPCError_t xReturnValue = IPC_SUCCESS;
+
+    if( pxMacAddress != NULL )
+    {
+        IPCPacket_t xTxPkt;
+        xTxPkt.xHeader.usIPCApiId = IPC_WIFI_GET_MAC;
+
+        xReturnValue = xSendIPCRequestAsync( &xTxPkt,
+                                             0,
+                                             ( IPCPacketData_t * ) pxMacAddress,
+                                             sizeof( struct eth_addr ),
+                                             xCallback, pvCallbackCtx,
+                                             xTimeout );
+    }
+    else
+    {
+        xReturnValue = IPC_PARAMETER_ERROR;
+    }
+
+    return xReturnValue;
+}
+
+static IPCError_t prvConnect( const char * pcSSID,
+                              const char * pcPSK,
+                              const uint8_t * pucBssid,
+                              uint8_t ucChannel,
+                              uint8_t ucSecurity,
+                              TickType_t xTimeout )
 {
     IPCError_t xReturnValue = IPC_SUCCESS;
 
@@ -365,13 +690,28 @@ IPCError_t mx_Connect( const char * pcSSID,
 
         xTxPkt.xHeader.usIPCApiId = IPC_WIFI_CONNECT;
 
-        xTxPkt.xData.xRequestWifiConnect.ucUseAttr = pdFALSE;
         xTxPkt.xData.xRequestWifiConnect.ucUseStaticIp = pdFALSE;
-        xTxPkt.xData.xRequestWifiConnect.ucAccessPointChannel = 0;
-        xTxPkt.xData.xRequestWifiConnect.ucSecurityType = 0;
 
-        ( void ) memset( &( xTxPkt.xData.xRequestWifiConnect.ucAccessPointBssid ),
-                         0, MX_BSSID_LEN );
+        if( pucBssid != NULL )
+        {
+            /* Associate with the given access point without scanning */
+            xTxPkt.xData.xRequestWifiConnect.ucUseAttr = pdTRUE;
+            xTxPkt.xData.xRequestWifiConnect.ucAccessPointChannel = ucChannel;
+            xTxPkt.xData.xRequestWifiConnect.ucSecurityType = ucSecurity;
+
+            ( void ) memcpy( &( xTxPkt.xData.xRequestWifiConnect.ucAccessPointBssid ),
+                             pucBssid, MX_BSSID_LEN );
+        }
+        else
+        {
+            xTxPkt.xData.xRequestWifiConnect.ucUseAttr = pdFALSE;
+            xTxPkt.xData.xRequestWifiConnect.ucAccessPointChannel = 0;
+            xTxPkt.xData.xRequestWifiConnect.ucSecurityType = 0;
+
+            ( void ) memset( &( xTxPkt.xData.xRequestWifiConnect.ucAccessPointBssid ),
+                             0, MX_BSSID_LEN );
+        }
+
         ( void ) memset( &( xTxPkt.xData.xRequestWifiConnect.xStaticIpInfo ),
                          0, sizeof( IPInfoType_t ) );
 
@@ -401,6 +741,76 @@ IPCError_t mx_Connect( const char * pcSSID,
     return xReturnValue;
 }
 
+IPCError_t mx_Connect( const char * pcSSID,
+                       const char * pcPSK,
+                       TickType_t xTimeout )
+{
+    return prvConnect( pcSSID, pcPSK, NULL, 0, 0, xTimeout );
+}
+
+IPCError_t mx_ConnectToBssid( const char * pcSSID,
+                              const char * pcPSK,
+                              const uint8_t * pucBssid,
+                              uint8_t ucChannel,
+                              uint8_t ucSecurity,
+                              TickType_t xTimeout )
+{
+    IPCError_t xReturnValue = IPC_SUCCESS;
+
+    if( ( pucBssid == NULL ) ||
+        ( ucChannel == 0 ) )
+    {
+        LogError( "Invalid pucBssid or ucChannel parameter." );
+        xReturnValue = IPC_PARAMETER_ERROR;
+    }
+    else
+    {
+        xReturnValue = prvConnect( pcSSID, pcPSK, pucBssid, ucChannel, ucSecurity, xTimeout );
+    }
+
+    return xReturnValue;
+}
+
+IPCError_t mx_GetLinkInfo( MxLinkInfo_t * pxLinkInfo,
+                           TickType_t xTimeout )
+{
+    IPCError_t xReturnValue = IPC_SUCCESS;
+
+    if( pxLinkInfo != NULL )
+    {
+        IPCPacket_t xTxPkt;
+        IPCResponseWifiGetLinkInfo_t xResponse;
+
+        xTxPkt.xHeader.usIPCApiId = IPC_WIFI_GET_LINKINFO;
+
+        xReturnValue = xSendIPCRequest( &xTxPkt,
+                                        0,
+                                        ( IPCPacketData_t * ) &xResponse,
+                                        sizeof( IPCResponseWifiGetLinkInfo_t ),
+                                        xTimeout );
+
+        if( ( xReturnValue == IPC_SUCCESS ) &&
+            ( ( xResponse.lStatus != 0 ) || ( xResponse.ucIsConnected == 0 ) ) )
+        {
+            xReturnValue = IPC_ERROR;
+        }
+
+        if( xReturnValue == IPC_SUCCESS )
+        {
+            ( void ) memcpy( pxLinkInfo->ucBssid, xResponse.ucBssid, MX_BSSID_LEN );
+            pxLinkInfo->ucChannel = xResponse.ucChannel;
+            pxLinkInfo->ucSecurity = xResponse.ucSecurity;
+            pxLinkInfo->lRssi = xResponse.lRssi;
+        }
+    }
+    else
+    {
+        xReturnValue = IPC_PARAMETER_ERROR;
+    }
+
+    return xReturnValue;
+}
+
 IPCError_t mx_Disconnect( TickType_t xTimeout )
 {
     IPCError_t xReturnValue = IPC_SUCCESS;
@@ -440,6 +850,33 @@ IPCError_t mx_SetBypassMode( BaseType_t xEnable,
     return xError;
 }
 
+IPCError_t mx_SetBypassModeAsync( BaseType_t xEnable,
+                                  MxRequestCallback_t xCallback,
+                                  void * pvCallbackCtx,
+                                  TickType_t xTimeout )
+{
+    IPCError_t xError = IPC_SUCCESS;
+
+    IPCPacket_t xTxPkt;
+
+    if( ( xEnable == pdFALSE ) ||
+        ( xEnable == pdTRUE ) )
+    {
+        xTxPkt.xHeader.usIPCApiId = IPC_WIFI_BYPASS_SET;
+        xTxPkt.xData.xRequestWifiBypassSet.enable = ( uint32_t ) xEnable;
+        xError = xSendIPCRequestAsync( &xTxPkt, sizeof( IPCRequestWifiBypassSet_t ),
+                                       NULL, 0,
+                                       xCallback, pvCallbackCtx,
+                                       xTimeout );
+    }
+    else
+    {
+        xError = IPC_PARAMETER_ERROR;
+    }
+
+    return xError;
+}
+
 IPCError_t mx_RegisterEventCallback( MxEventCallback_t xCallback,
                                      void * pxCallbackContext )
 {
@@ -489,6 +926,8 @@ void prvControlPlaneRouter( void * pvParameters )
         xIPCRequestCtxArray[ i ].pxTxPbuf = NULL;
         xIPCRequestCtxArray[ i ].pxRxPbuf = NULL;
         xIPCRequestCtxArray[ i ].xWaitingTask = NULL;
+        xIPCRequestCtxArray[ i ].xCallback = NULL;
+        xIPCRequestCtxArray[ i ].pxNextTimer = NULL;
     }
 
     xSemaphoreGive( xContextArrayMutex );
@@ -496,12 +935,40 @@ void prvControlPlaneRouter( void * pvParameters )
     while( 1 )
     {
         PacketBuffer_t * pxRxPbuf = NULL;
+        IPCRequestCtx_t * pxExpired = NULL;
+
+        /* Wake up at the wheel resolution while asynchronous requests are outstanding */
+        TickType_t xWait = ( ulTimersPending > 0 ) ? IPC_TIMER_WHEEL_RESOLUTION : portMAX_DELAY;
 
         /* Block on the input message queue */
         xResult = xMessageBufferReceive( pxCtx->xControlPlaneResponseBuff,
                                          &pxRxPbuf,
                                          sizeof( PacketBuffer_t * ),
-                                         portMAX_DELAY );
+                                         xWait );
+
+        /* Time out asynchronous requests */
+        if( ulTimersPending > 0 )
+        {
+            BaseType_t xMutexResult = xSemaphoreTake( xContextArrayMutex, portMAX_DELAY );
+            configASSERT( xMutexResult == pdTRUE );
+
+            pxExpired = pxTimerWheelExpire( xTaskGetTickCount() );
+
+            xMutexResult = xSemaphoreGive( xContextArrayMutex );
+            configASSERT( xMutexResult == pdTRUE );
+        }
+
+        while( pxExpired != NULL )
+        {
+            IPCRequestCtx_t * pxRequestCtx = pxExpired;
+            MxRequestCallback_t xCallback = pxRequestCtx->xCallback;
+
+            pxExpired = pxRequestCtx->pxNextTimer;
+            pxRequestCtx->xCallback = NULL;
+
+            LogWarn( "Request id: %d timed out.", pxRequestCtx->ulRequestID );
+            prvCompleteAsyncRequest( pxRequestCtx, xCallback, IPC_TIMEOUT );
+        }
 
         if( ( xResult != pdFALSE ) &&
             ( pxRxPbuf != NULL ) )
@@ -540,6 +1007,8 @@ void prvControlPlaneRouter( void * pvParameters )
                 configASSERT( xResult == pdTRUE );
 
                 IPCRequestCtx_t * pxTargetCtx = NULL;
+                IPCRequestCtx_t * pxCompletedCtx = NULL;
+                MxRequestCallback_t xCallback = NULL;
 
                 for( uint32_t i = 0; i < NUM_IPC_REQUEST_CTX; i++ )
                 {
@@ -550,9 +1019,26 @@ void prvControlPlaneRouter( void * pvParameters )
                     }
                 }
 
-                /* Send packet to waiting thread */
+                /* Complete an asynchronous request */
                 if( ( pxTargetCtx != NULL ) &&
-                    ( pxTargetCtx->pxRxPbuf == NULL ) &&
+                    ( pxTargetCtx->xCallback != NULL ) )
+                {
+                    ( void ) xTimerWheelRemove( pxTargetCtx );
+
+                    if( ( pxTargetCtx->pvResponse != NULL ) &&
+                        ( pxTargetCtx->ulResponseLength > 0 ) )
+                    {
+                        ( void ) memcpy( pxTargetCtx->pvResponse, &( pxRxPacket->xData ), pxTargetCtx->ulResponseLength );
+                    }
+
+                    /* Detach the callback so that a duplicate response is dropped */
+                    xCallback = pxTargetCtx->xCallback;
+                    pxTargetCtx->xCallback = NULL;
+                    pxCompletedCtx = pxTargetCtx;
+                }
+                /* Send packet to waiting thread */
+                else if( ( pxTargetCtx != NULL ) &&
+                         ( pxTargetCtx->pxRxPbuf == NULL ) &&
                     ( pxTargetCtx->xWaitingTask != NULL ) )
                 {
                     LogDebug( "Notifying waiting task %d of RX packet.", pxTargetCtx->xWaitingTask );
@@ -582,14 +1068,26 @@ void prvControlPlaneRouter( void * pvParameters )
                 /* Return the mutex */
                 xResult = xSemaphoreGive( xContextArrayMutex );
                 configASSERT( xResult == pdTRUE );
+
+                /* Callbacks may issue further requests, so they run without the mutex held */
+                if( pxCompletedCtx != NULL )
+                {
+                    prvCompleteAsyncRequest( pxCompletedCtx, xCallback, IPC_SUCCESS );
+                }
             }
 
             LogDebug( "Decreasing reference count of pxRxPbuf %p from %d to %d", pxRxPbuf, pxRxPbuf->ref, ( pxRxPbuf->ref - 1 ) );
             PBUF_FREE( pxRxPbuf );
         }
-        else
+        /* A timeout is expected while servicing the timer wheel, and an empty message is a wakeup */
+        else if( ( xResult == pdFALSE ) &&
+                 ( xWait == portMAX_DELAY ) )
         {
             LogError( "Error when reading from xControlPlaneResponseBuff" );
         }
+        else
+        {
+            /* Empty */
+        }
     }
 }
@@ -56,9 +56,22 @@ typedef enum
     MX_STATUS_AP_UP
 } MxStatus_t;
 
+/* Access point the module is currently associated with */
+typedef struct
+{
+    uint8_t ucBssid[ ETH_HWADDR_LEN ];
+    uint8_t ucChannel;
+    uint8_t ucSecurity; /* MxWifiSecurity_t */
+    int32_t lRssi;
+} MxLinkInfo_t;
+
 typedef void ( * MxEventCallback_t )( MxStatus_t,
                                       void * );
 
+/* Completion callback of an asynchronous request, called from the control plane router task */
+typedef void ( * MxRequestCallback_t )( IPCError_t,
+                                        void * );
+
 IPCError_t mx_RequestVersion( char * pcVersionBuffer,
                               uint32_t ulVersionLength,
                               TickType_t xTimeout );
@@ -72,11 +85,43 @@ IPCError_t mx_Connect( const char * pcSSID,
                        const char * pcPSK,
                        TickType_t xTimeout );
 
+/* Connect to a known access point directly, skipping the scan done by mx_Connect */
+IPCError_t mx_ConnectToBssid( const char * pcSSID,
+                              const char * pcPSK,
+                              const uint8_t * pucBssid,
+                              uint8_t ucChannel,
+                              uint8_t ucSecurity,
+                              TickType_t xTimeout );
+
 IPCError_t mx_Disconnect( TickType_t xTimeout );
 
+IPCError_t mx_GetLinkInfo( MxLinkInfo_t * pxLinkInfo,
+                           TickType_t xTimeout );
+
 IPCError_t mx_SetBypassMode( BaseType_t xEnable,
                              TickType_t xTimeout );
 
+/*
+ * Asynchronous variants: the request is queued without waiting for the response and
+ * xCallback is called once the response arrives or xTimeout expires. Response buffers must stay
+ * valid until then. When an error is returned, xCallback is not called.
+ */
+IPCError_t mx_RequestVersionAsync( char * pcVersionBuffer,
+                                   uint32_t ulVersionLength,
+                                   MxRequestCallback_t xCallback,
+                                   void * pvCallbackCtx,
+                                   TickType_t xTimeout );
+
+IPCError_t mx_GetMacAddressAsync( struct eth_addr * pxMacAddress,
+                                  MxRequestCallback_t xCallback,
+                                  void * pvCallbackCtx,
+                                  TickType_t xTimeout );
+
+IPCError_t mx_SetBypassModeAsync( BaseType_t xEnable,
+                                  MxRequestCallback_t xCallback,
+                                  void * pvCallbackCtx,
+                                  TickType_t xTimeout );
+
 IPCError_t mx_RegisterEventCallback( MxEventCallback_t pvCallback,
                                      void * pxCallbackContext );
 
@@ -33,34 +33,93 @@
 #include "atomic.h"
 #include "mx_prv.h"
 
-static void vAddMXHeaderToEthernetFrame( PacketBuffer_t * pxTxPacket )
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+#include "lwip/prot/iana.h"
+
+/*
+ * Prepend the bypass header to an ethernet frame, in the headroom lwIP reserves for it
+ * (PBUF_LINK_ENCAPSULATION_HLEN) or else in a small pbuf chained in front of the frame.
+ * Returns the packet to queue, holding its own reference to the frame, or NULL when out of memory.
+ */
+static PacketBuffer_t * pxAddMXHeaderToEthernetFrame( PacketBuffer_t * pxTxPacket )
 {
+    PacketBuffer_t * pxFrame = pxTxPacket;
+
     configASSERT( pxTxPacket != NULL );
 
     /* Store length of ethernet frame for BypassInOut_t header */
     uint16_t ulEthPacketLen = pxTxPacket->tot_len;
 
     /* Adjust pbuf size to include BypassInOut_t header */
-    uint8_t cErr = pbuf_header( pxTxPacket, sizeof( BypassInOut_t ) );
+    if( pbuf_add_header( pxTxPacket, sizeof( BypassInOut_t ) ) == 0 )
+    {
+        pbuf_ref( pxTxPacket );
+    }
+    else
+    {
+        pxFrame = PBUF_ALLOC_TX( sizeof( BypassInOut_t ) );
+
+        if( pxFrame != NULL )
+        {
+            /* pbuf_chain takes a reference to the ethernet frame */
+            pbuf_chain( pxFrame, pxTxPacket );
+        }
+    }
 
-    configASSERT( cErr == 0 );
+    if( pxFrame != NULL )
+    {
+        /* Add on bypass header */
+        BypassInOut_t * pxBypassHeader = ( BypassInOut_t * ) pxFrame->payload;
 
-    /* Add on bypass header */
-    BypassInOut_t * pxBypassHeader = ( BypassInOut_t * ) pxTxPacket->payload;
+        pxBypassHeader->xHeader.usIPCApiId = IPC_WIFI_BYPASS_OUT;
+        pxBypassHeader->xHeader.ulIPCRequestId = prvGetNextRequestID();
 
-    pxBypassHeader->xHeader.usIPCApiId = IPC_WIFI_BYPASS_OUT;
-    pxBypassHeader->xHeader.ulIPCRequestId = prvGetNextRequestID();
+        /* Send to station interface */
+        pxBypassHeader->lIndex = WIFI_BYPASS_MODE_STATION;
 
-    /* Send to station interface */
-    pxBypassHeader->lIndex = WIFI_BYPASS_MODE_STATION;
+        /* Fill pad region with zeros */
+        ( void ) memset( pxBypassHeader->ucPad, 0, MX_BYPASS_PAD_LEN );
 
-    /* Fill pad region with zeros */
-    ( void ) memset( pxBypassHeader->ucPad, 0, MX_BYPASS_PAD_LEN );
+        /* Set length field */
+        pxBypassHeader->usDataLen = ulEthPacketLen;
 
-    /* Set length field */
-    pxBypassHeader->usDataLen = ulEthPacketLen;
+        configASSERT( pxFrame->ref >= 1 );
+    }
 
-    configASSERT( pxTxPacket->ref >= 1 );
+    return pxFrame;
+}
+
+/* Pick the transmit class of an outgoing ethernet frame: small frames and DNS queries are interactive */
+static MxTxClass_t xClassifyEthernetFrame( PacketBuffer_t * pxTxPacket )
+{
+    MxTxClass_t xClass = MX_TX_CLASS_BULK;
+    uint8_t ucHeaders[ SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN ];
+
+    if( pxTxPacket->tot_len <= MX_TX_INTERACTIVE_MAX_LEN )
+    {
+        xClass = MX_TX_CLASS_INTERACTIVE;
+    }
+    else if( pbuf_copy_partial( pxTxPacket, ucHeaders, sizeof( ucHeaders ), 0 ) == sizeof( ucHeaders ) )
+    {
+        struct eth_hdr * pxEthHeader = ( struct eth_hdr * ) ucHeaders;
+        struct ip_hdr * pxIpHeader = ( struct ip_hdr * ) &( ucHeaders[ SIZEOF_ETH_HDR ] );
+
+        if( ( lwip_htons( pxEthHeader->type ) == ETHTYPE_IP ) &&
+            ( IPH_PROTO( pxIpHeader ) == IP_PROTO_UDP ) &&
+            ( IPH_HL_BYTES( pxIpHeader ) == IP_HLEN ) )
+        {
+            struct udp_hdr * pxUdpHeader = ( struct udp_hdr * ) &( ucHeaders[ SIZEOF_ETH_HDR + IP_HLEN ] );
+
+            if( lwip_htons( pxUdpHeader->dest ) == LWIP_IANA_PORT_DNS )
+            {
+                xClass = MX_TX_CLASS_INTERACTIVE;
+            }
+        }
+    }
+
+    return xClass;
 }
 
 /* Callback for lwip netif events
@@ -123,30 +182,27 @@ err_t prvxLinkOutput( NetInterface_t * pxNetif,
 {
     err_t xError = ERR_OK;
     BaseType_t xReturn = pdFALSE;
-    struct pbuf * pxPbufToSend = pxPbuf;
+    struct pbuf * pxPbufToSend = NULL;
+    MxTxClass_t xClass = MX_TX_CLASS_BULK;
 
     if( ( pxPbuf == NULL ) || ( pxNetif == NULL ) )
     {
         xError = ERR_VAL;
     }
-    /* Handle any chained packets */
-    else if( ( pxPbuf->len != pxPbuf->tot_len ) ||
-             ( pxPbuf->next != NULL ) )
+    else
     {
-        pxPbufToSend = pbuf_clone( PBUF_RAW, PBUF_RAM, pxPbuf );
+        xClass = xClassifyEthernetFrame( pxPbuf );
+
+        /*
+         * Chained frames are queued as they are and walked by the dataplane, so no copy is made.
+         * Input buffer will be freed by lwip after the current function returns.
+         */
+        pxPbufToSend = pxAddMXHeaderToEthernetFrame( pxPbuf );
 
         if( pxPbufToSend == NULL )
         {
             xError = ERR_MEM;
         }
-
-        /* Input buffer will be freed by lwip after the current function returns */
-        /* pbuf_clone sets the refcount = 1 upon creation */
-    }
-    else
-    {
-        /* Increment reference counter */
-        pbuf_ref( pxPbufToSend );
     }
 
 /*    vPrintBuffer("ETH_TX", pxPbuf->payload, pxPbuf->tot_len ); */
@@ -154,27 +210,30 @@ err_t prvxLinkOutput( NetInterface_t * pxNetif,
     /* Get context from netif struct */
     MxNetConnectCtx_t * pxCtx = ( MxNetConnectCtx_t * ) pxNetif->state;
 
-    if( xError == ERR_OK )
-    {
-        vAddMXHeaderToEthernetFrame( pxPbuf );
-    }
-
     configASSERT( pxCtx->xDataPlaneSendQueue != NULL );
+    configASSERT( pxCtx->xInteractiveSendQueue != NULL );
     configASSERT( pxCtx->pulTxPacketsWaiting != NULL );
     configASSERT( pxCtx->xDataPlaneTaskHandle != NULL );
 
     if( xError == ERR_OK )
     {
+        QueueHandle_t xSendQueue = ( xClass == MX_TX_CLASS_INTERACTIVE ) ? pxCtx->xInteractiveSendQueue : pxCtx->xDataPlaneSendQueue;
+        MxTxQueueItem_t xTxItem =
+        {
+            .pxPacket     = pxPbufToSend,
+            .xEnqueueTime = xTaskGetTickCount()
+        };
+
         configASSERT( pxPbufToSend != NULL );
-        xReturn = xQueueSend( pxCtx->xDataPlaneSendQueue,
-                              &pxPbufToSend,
+        xReturn = xQueueSend( xSendQueue,
+                              &xTxItem,
                               MX_ETH_PACKET_ENQUEUE_TIMEOUT );
 
         if( xReturn == pdTRUE )
         {
             xError = ERR_OK;
-            LogDebug( "Packet enqueued into xDataPlaneSendQueue addr: %p, len: %d, refs: %d, remaining space: %d",
-                      pxPbufToSend, pxPbufToSend->tot_len, pxPbufToSend->ref, uxQueueSpacesAvailable( pxCtx->xDataPlaneSendQueue ) );
+            LogDebug( "Packet enqueued for class %d addr: %p, len: %d, refs: %d, remaining space: %d",
+                      xClass, pxPbufToSend, pxPbufToSend->tot_len, pxPbufToSend->ref, uxQueueSpacesAvailable( xSendQueue ) );
 
             ( void ) Atomic_Increment_u32( pxCtx->pulTxPacketsWaiting );
 
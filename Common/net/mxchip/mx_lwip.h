@@ -30,6 +30,7 @@
 #include "lwip/pbuf.h"
 #include "lwip/netifapi.h"
 #include "lwip/prot/dhcp.h"
+#include "lwip/stats.h"
 
 /* Define "generic" types */
 typedef struct netif      NetInterface_t;
@@ -42,10 +43,14 @@ typedef struct eth_addr   MacAddress_t;
       ( ( pbuf )->len > 0 ) &&      \
       ( ( pbuf )->len <= MX_RX_BUFF_SZ ) )
 
-#define PBUF_LEN( buf )         ( ( buf )->len )
-#define PBUF_ALLOC_RX( len )    pbuf_alloc( PBUF_RAW, len, PBUF_POOL )
-#define PBUF_ALLOC_TX( len )    pbuf_alloc( PBUF_RAW, len, PBUF_RAM )
-#define PBUF_FREE( pbuf )       pbuf_free( pbuf )
+#define PBUF_LEN( buf )                ( ( buf )->len )
+#define PBUF_ALLOC_RX( len )           pbuf_alloc( PBUF_RAW, len, PBUF_POOL )
+#define PBUF_ALLOC_RX_CONTIG( len )    pbuf_alloc( PBUF_RAW, len, PBUF_RAM )
+#define PBUF_ALLOC_TX( len )           pbuf_alloc( PBUF_RAW, len, PBUF_RAM )
+#define PBUF_FREE( pbuf )              pbuf_free( pbuf )
+
+#define RX_STATS_DROP()                LINK_STATS_INC( link.drop )
+#define RX_STATS_MEMERR()              LINK_STATS_INC( link.memerr )
 
 /* helper functions */
 static inline void vLogAddress( const char * pucLabel,
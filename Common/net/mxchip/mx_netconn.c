@@ -36,6 +36,7 @@
 #include "mx_netconn.h"
 #include "mx_lwip.h"
 #include "mx_prv.h"
+#include "mx_reconnect.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -47,8 +48,12 @@
 #include "lwip/tcpip.h"
 #include "lwip/netifapi.h"
 #include "lwip/prot/dhcp.h"
+#include "lwip/dhcp.h"
+#include "lwip/etharp.h"
 #include "lwip/apps/lwiperf.h"
 
+#include "lwip_tuning.h"
+
 #include "sys_evt.h"
 
 #include "stm32u5_iot_board.h"
@@ -59,6 +64,11 @@ static TaskHandle_t xNetTaskHandle = NULL;
 static MxDataplaneCtx_t xDataPlaneCtx;
 static ControlPlaneCtx_t xControlPlaneCtx;
 
+/* Only accessed from the net task */
+static MxReconnectCtx_t xReconnectCtx;
+static TickType_t xBackoffStart = 0;
+static TickType_t xBackoffTicks = 0;
+
 #if LOG_LEVEL == LOG_DEBUG
 
 /*
@@ -257,6 +267,9 @@ static void vLwipReadyCallback( void * pvCtx )
 {
     MxNetConnectCtx_t * pxCtx = ( MxNetConnectCtx_t * ) pvCtx;
 
+    /* Runs in the tcpip thread, where the sampler timer must be started */
+    vLwipTuningInit();
+
     if( xNetTaskHandle != NULL )
     {
         ( void ) xTaskNotifyIndexed( pxCtx->xNetTaskHandle,
@@ -269,25 +282,90 @@ static void vLwipReadyCallback( void * pvCtx )
 static char pcSSID[ MX_SSID_BUF_LEN ] = { 0 };
 static char pcPSK[ MX_PSK_BUF_LEN ] = { 0 };
 
-static BaseType_t xConnectToAP( MxNetConnectCtx_t * pxCtx )
+static void vBypassModeCallback( IPCError_t xError,
+                                 void * pvCallbackCtx )
+{
+    ( void ) pvCallbackCtx;
+
+    if( xError != IPC_SUCCESS )
+    {
+        LogError( "Failed to enable bypass mode: %d.", xError );
+    }
+}
+
+static void vLoadFastConnectCache( void )
+{
+    MxFastConnectCache_t xRecord = { 0 };
+    size_t xLength;
+
+    ( void ) KVStore_getString( CS_WIFI_SSID, pcSSID, MX_SSID_BUF_LEN );
+    xLength = KVStore_getBlob( CS_WIFI_FAST_CONNECT, &xRecord, sizeof( MxFastConnectCache_t ) );
+
+    vMxReconnectInit( &xReconnectCtx, &xRecord, xLength, ulMxReconnectHashSsid( pcSSID ) );
+
+    memset( pcSSID, 0, MX_SSID_BUF_LEN );
+}
+
+static void vSaveFastConnectCache( void )
+{
+    MxFastConnectCache_t xRecord;
+
+    /* Written only when the access point or lease changed */
+    if( xMxReconnectTakeDirty( &xReconnectCtx, &xRecord ) )
+    {
+        if( ( KVStore_setBlob( CS_WIFI_FAST_CONNECT, sizeof( MxFastConnectCache_t ), &xRecord ) == pdFALSE ) ||
+            ( KVStore_xCommitKey( CS_WIFI_FAST_CONNECT ) == pdFALSE ) )
+        {
+            LogWarn( "Failed to save fast connect cache." );
+        }
+    }
+}
+
+static BaseType_t xConnectToAP( MxNetConnectCtx_t * pxCtx,
+                                const MxReconnectAction_t * pxAction )
 {
     IPCError_t xErr = IPC_SUCCESS;
+    TickType_t xTimeout = pdMS_TO_TICKS( pxAction->ulTimeoutMs );
 
+    if( pxAction->xDisconnectFirst )
+    {
+        ( void ) mx_Disconnect( pdMS_TO_TICKS( 1000 ) );
+    }
 
     if( ( pxCtx->xStatus == MX_STATUS_NONE ) ||
         ( pxCtx->xStatus == MX_STATUS_STA_DOWN ) )
     {
-        xErr |= mx_SetBypassMode( pdTRUE,
-                                  pdMS_TO_TICKS( MX_DEFAULT_TIMEOUT_MS ) );
+        /* Pipelined ahead of the connect request rather than waited for */
+        xErr = mx_SetBypassModeAsync( pdTRUE,
+                                      vBypassModeCallback,
+                                      NULL,
+                                      pdMS_TO_TICKS( MX_DEFAULT_TIMEOUT_MS ) );
+
+        if( xErr != IPC_SUCCESS )
+        {
+            LogError( "Failed to request bypass mode: %d.", xErr );
+        }
 
         ( void ) KVStore_getString( CS_WIFI_SSID, pcSSID, MX_SSID_BUF_LEN );
         ( void ) KVStore_getString( CS_WIFI_CREDENTIAL, pcPSK, MX_PSK_BUF_LEN );
 
-        xErr = mx_Connect( pcSSID, pcPSK, MX_TIMEOUT_CONNECT );
+        if( pxAction->xType == MX_RECONNECT_ACT_CONNECT_DIRECT )
+        {
+            LogInfo( "Connecting to cached access point on channel %d.", xReconnectCtx.xCache.ucChannel );
+            xErr = mx_ConnectToBssid( pcSSID, pcPSK,
+                                      xReconnectCtx.xCache.ucBssid,
+                                      xReconnectCtx.xCache.ucChannel,
+                                      xReconnectCtx.xCache.ucSecurity,
+                                      xTimeout );
+        }
+        else
+        {
+            xErr = mx_Connect( pcSSID, pcPSK, xTimeout );
+        }
 
         /* Clear sensitive data */
         memset( pcSSID, 0, MX_SSID_BUF_LEN );
-        memset( pcPSK, 0, MX_SSID_BUF_LEN );
+        memset( pcPSK, 0, MX_PSK_BUF_LEN );
 
         if( xErr != IPC_SUCCESS )
         {
@@ -295,13 +373,159 @@ static BaseType_t xConnectToAP( MxNetConnectCtx_t * pxCtx )
         }
         else
         {
-            ( void ) xWaitForMxStatus( pxCtx, MX_STATUS_STA_UP, MX_TIMEOUT_CONNECT );
+            ( void ) xWaitForMxStatus( pxCtx, MX_STATUS_STA_UP, xTimeout );
         }
     }
 
     return( pxCtx->xStatus >= MX_STATUS_STA_UP );
 }
 
+/*
+ * Feeds xEvent to the reconnect state machine and carries out the resulting
+ * connection attempts until the link is up or a backoff period starts.
+ */
+static void vRunReconnect( MxNetConnectCtx_t * pxCtx,
+                           MxReconnectEvent_t xEvent )
+{
+    MxReconnectAction_t xAction = xMxReconnectHandleEvent( &xReconnectCtx, xEvent );
+
+    while( ( xAction.xType == MX_RECONNECT_ACT_CONNECT_DIRECT ) ||
+           ( xAction.xType == MX_RECONNECT_ACT_CONNECT_SCAN ) )
+    {
+        if( xConnectToAP( pxCtx, &xAction ) == pdTRUE )
+        {
+            xEvent = MX_RECONNECT_EVT_LINK_UP;
+        }
+        else
+        {
+            xEvent = MX_RECONNECT_EVT_FAILED;
+        }
+
+        xAction = xMxReconnectHandleEvent( &xReconnectCtx, xEvent );
+    }
+
+    if( xAction.xType == MX_RECONNECT_ACT_WAIT )
+    {
+        xBackoffStart = xTaskGetTickCount();
+        xBackoffTicks = pdMS_TO_TICKS( xAction.ulTimeoutMs );
+    }
+
+    if( xEvent == MX_RECONNECT_EVT_LINK_UP )
+    {
+        MxLinkInfo_t xLinkInfo;
+
+        /* Remember the access point for the next reconnect */
+        if( mx_GetLinkInfo( &xLinkInfo, pdMS_TO_TICKS( 1000 ) ) == IPC_SUCCESS )
+        {
+            vMxReconnectUpdateLink( &xReconnectCtx, xLinkInfo.ucBssid,
+                                    xLinkInfo.ucChannel, xLinkInfo.ucSecurity );
+        }
+    }
+
+    vSaveFastConnectCache();
+}
+
+/*
+ * Drives the reconnect state machine from the current module status.
+ * Returns the time to wait before the next step.
+ */
+static TickType_t xReconnectStep( MxNetConnectCtx_t * pxCtx )
+{
+    TickType_t xTicksToWait = pdMS_TO_TICKS( 30 * 1000 );
+
+    if( ( pxCtx->xStatus == MX_STATUS_STA_UP ) ||
+        ( pxCtx->xStatus == MX_STATUS_STA_GOT_IP ) )
+    {
+        if( xReconnectCtx.xState != MX_RECONNECT_CONNECTED )
+        {
+            vRunReconnect( pxCtx, MX_RECONNECT_EVT_LINK_UP );
+        }
+    }
+    else if( xReconnectCtx.xState == MX_RECONNECT_CONNECTED )
+    {
+        vRunReconnect( pxCtx, MX_RECONNECT_EVT_LINK_DOWN );
+    }
+    else if( xReconnectCtx.xState == MX_RECONNECT_BACKOFF )
+    {
+        TickType_t xElapsed = xTaskGetTickCount() - xBackoffStart;
+
+        if( xElapsed >= xBackoffTicks )
+        {
+            vRunReconnect( pxCtx, MX_RECONNECT_EVT_TIMEOUT );
+        }
+    }
+    else
+    {
+        vRunReconnect( pxCtx, MX_RECONNECT_EVT_START );
+    }
+
+    if( xReconnectCtx.xState == MX_RECONNECT_BACKOFF )
+    {
+        TickType_t xElapsed = xTaskGetTickCount() - xBackoffStart;
+
+        xTicksToWait = ( xElapsed < xBackoffTicks ) ? ( xBackoffTicks - xElapsed ) : 0;
+    }
+
+    return xTicksToWait;
+}
+
+/* ARP for an address before taking it. Returns pdTRUE if no other host answered within MX_FAST_CONNECT_PROBE_MS. */
+static BaseType_t xProbeAddressFree( NetInterface_t * pxNetif,
+                                     const ip4_addr_t * pxIpAddr )
+{
+    struct eth_addr * pxEthAddr = NULL;
+    const ip4_addr_t * pxFoundAddr = NULL;
+    BaseType_t xFree = pdFALSE;
+    err_t xLwipError;
+
+    /* The interface has no address yet, so the request carries a zero sender address as an RFC 5227 probe.
+     * A reply completes the pending entry etharp_query creates. */
+    LOCK_TCPIP_CORE();
+    xLwipError = etharp_query( pxNetif, pxIpAddr, NULL );
+    UNLOCK_TCPIP_CORE();
+
+    if( xLwipError == ERR_OK )
+    {
+        vTaskDelay( pdMS_TO_TICKS( MX_FAST_CONNECT_PROBE_MS ) );
+
+        LOCK_TCPIP_CORE();
+        xFree = ( etharp_find_addr( pxNetif, pxIpAddr, &pxEthAddr, &pxFoundAddr ) < 0 ) ? pdTRUE : pdFALSE;
+        UNLOCK_TCPIP_CORE();
+    }
+    else
+    {
+        LogError( "Failed to probe cached address rc: %d", xLwipError );
+    }
+
+    return xFree;
+}
+
+/* Use the previous lease until DHCP confirms or replaces it, unless another host already holds the address */
+static void vApplyCachedLease( NetInterface_t * pxNetif )
+{
+    ip4_addr_t xIpAddr;
+    ip4_addr_t xNetmask;
+    ip4_addr_t xGateway;
+
+    if( xMxReconnectTakeLease( &xReconnectCtx, &( xIpAddr.addr ),
+                               &( xNetmask.addr ), &( xGateway.addr ) ) )
+    {
+        if( xProbeAddressFree( pxNetif, &xIpAddr ) == pdFALSE )
+        {
+            LogWarn( "Cached address is in use or could not be probed. Waiting for DHCP." );
+        }
+        else
+        {
+            err_t xLwipError = netifapi_netif_set_addr( pxNetif, &xIpAddr, &xNetmask, &xGateway );
+
+            if( xLwipError != ERR_OK )
+            {
+                LogError( "Failed to apply cached lease rc: %d", xLwipError );
+            }
+        }
+    }
+}
+
 static void vInitializeWifiModule( MxNetConnectCtx_t * pxCtx )
 {
     IPCError_t xErr = IPC_ERROR_INTERNAL;
@@ -352,15 +576,19 @@ static void vInitializeContexts( MxNetConnectCtx_t * pxCtx )
     MessageBufferHandle_t xControlPlaneResponseBuff;
     QueueHandle_t xControlPlaneSendQueue;
     QueueHandle_t xDataPlaneSendQueue;
+    QueueHandle_t xInteractiveSendQueue;
 
     /* Construct queues */
-    xDataPlaneSendQueue = xQueueCreate( DATA_PLANE_QUEUE_LEN, sizeof( PacketBuffer_t * ) );
+    xDataPlaneSendQueue = xQueueCreate( DATA_PLANE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
     configASSERT( xDataPlaneSendQueue != NULL );
 
+    xInteractiveSendQueue = xQueueCreate( INTERACTIVE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
+    configASSERT( xInteractiveSendQueue != NULL );
+
     xControlPlaneResponseBuff = xMessageBufferCreate( CONTROL_PLANE_BUFFER_SZ );
     configASSERT( xControlPlaneResponseBuff != NULL );
 
-    xControlPlaneSendQueue = xQueueCreate( CONTROL_PLANE_QUEUE_LEN, sizeof( PacketBuffer_t * ) );
+    xControlPlaneSendQueue = xQueueCreate( CONTROL_PLANE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
     configASSERT( xControlPlaneSendQueue != NULL );
 
 
@@ -371,6 +599,7 @@ static void vInitializeContexts( MxNetConnectCtx_t * pxCtx )
     ( void ) memset( &( pxCtx->xMacAddress ), 0, sizeof( MacAddress_t ) );
 
     pxCtx->xDataPlaneSendQueue = xDataPlaneSendQueue;
+    pxCtx->xInteractiveSendQueue = xInteractiveSendQueue;
     pxCtx->pulTxPacketsWaiting = &( xDataPlaneCtx.ulTxPacketsWaiting );
     pxCtx->xNetTaskHandle = xTaskGetCurrentTaskHandle();
 
@@ -391,6 +620,7 @@ static void vInitializeContexts( MxNetConnectCtx_t * pxCtx )
     xDataPlaneCtx.xControlPlaneSendQueue = xControlPlaneSendQueue;
     xDataPlaneCtx.xControlPlaneResponseBuff = xControlPlaneResponseBuff;
     xDataPlaneCtx.xDataPlaneSendQueue = xDataPlaneSendQueue;
+    xDataPlaneCtx.xInteractiveSendQueue = xInteractiveSendQueue;
     xDataPlaneCtx.pxNetif = &( pxCtx->xNetif );
 
     /* Construct controlplane context */
@@ -420,6 +650,8 @@ void net_main( void * pvParameters )
 
     vInitializeContexts( &xCtx );
 
+    vLoadFastConnectCache();
+
     /* Initialize lwip */
     tcpip_init( vLwipReadyCallback, &xCtx );
 
@@ -481,22 +713,18 @@ void net_main( void * pvParameters )
     /* Outer loop. Reinitializing */
     for( ; ; )
     {
-        /* Make a connection attempt */
-        if( ( xCtx.xStatus != MX_STATUS_STA_UP ) &&
-            ( xCtx.xStatus != MX_STATUS_STA_GOT_IP ) )
-        {
-            xConnectToAP( &xCtx );
-        }
+        /* Make a connection attempt if needed */
+        TickType_t xTicksToWait = xReconnectStep( &xCtx );
 
         /*
-         * Wait for any event or timeout after 30 seconds
+         * Wait for any event or timeout after 30 seconds or the remaining backoff period
          */
         uint32_t ulNotificationValue = 0x0;
         xResult = xTaskNotifyWaitIndexed( NET_EVT_IDX,
                                           0x0,
                                           0xFFFFFFFF,
                                           &ulNotificationValue,
-                                          pdMS_TO_TICKS( 30 * 1000 ) );
+                                          xTicksToWait );
 
         if( ulNotificationValue != 0 )
         {
@@ -516,6 +744,13 @@ void net_main( void * pvParameters )
                 vLogAddress( "Gateway:", pxNetif->gw );
                 vLogAddress( "Netmask:", pxNetif->netmask );
 
+                if( dhcp_supplied_address( pxNetif ) )
+                {
+                    vMxReconnectUpdateLease( &xReconnectCtx, pxNetif->ip_addr.addr,
+                                             pxNetif->netmask.addr, pxNetif->gw.addr );
+                    vSaveFastConnectCache();
+                }
+
                 lwiperf_start_tcp_server_default( NULL, NULL );
                 LogSys( "Started Iperf server" );
 
@@ -534,6 +769,7 @@ void net_main( void * pvParameters )
                 LogInfo( "Link UP event." );
 
                 vSetAdminUp( pxNetif );
+                vApplyCachedLease( pxNetif );
                 vStartDhcp( pxNetif );
                 LogSys( "Network Link Up." );
             }
@@ -561,7 +797,14 @@ void net_main( void * pvParameters )
                 ( void ) xEventGroupClearBits( xSystemEvents, EVT_MASK_NET_CONNECTED );
                 ( void ) mx_SetBypassMode( pdFALSE, pdMS_TO_TICKS( 1000 ) );
                 ( void ) mx_Disconnect( pdMS_TO_TICKS( 1000 ) );
-                xConnectToAP( &xCtx );
+
+                /* Credentials may have changed, forget the cached access point */
+                ( void ) KVStore_getString( CS_WIFI_SSID, pcSSID, MX_SSID_BUF_LEN );
+                vMxReconnectReset( &xReconnectCtx, ulMxReconnectHashSsid( pcSSID ) );
+                memset( pcSSID, 0, MX_SSID_BUF_LEN );
+
+                vSaveFastConnectCache();
+                ( void ) xReconnectStep( &xCtx );
             }
         }
     }
@@ -60,7 +60,9 @@ extern "C"
 #define ASYNC_REQUEST_RECONNECT_BIT      0x80
 
 /* Constants */
-#define NUM_IPC_REQUEST_CTX              1
+#define NUM_IPC_REQUEST_CTX              4
+#define IPC_TIMER_WHEEL_SLOTS            16
+#define IPC_TIMER_WHEEL_RESOLUTION       pdMS_TO_TICKS( 50 )
 #define MX_DEFAULT_TIMEOUT_MS            100
 #define MX_DEFAULT_TIMEOUT_TICK          pdMS_TO_TICKS( MX_DEFAULT_TIMEOUT_MS )
 #define MX_TIMEOUT_CONNECT               pdMS_TO_TICKS( 120 * 1000 )
@@ -78,8 +80,75 @@ extern "C"
 
 #define CONTROL_PLANE_QUEUE_LEN          10
 #define DATA_PLANE_QUEUE_LEN             10
+#define INTERACTIVE_QUEUE_LEN            10
 #define CONTROL_PLANE_BUFFER_SZ          ( 25 * sizeof( void * ) + sizeof( size_t ) )
 
+/*
+ * Multi-frame SPI transactions pack several IPC frames, each preceded by a 16 bit length, into
+ * the payload of one chip select window. Both sides advertise MX_SPI_CAP_MULTI_FRAME in the SPI
+ * header and a side only sends packed payloads after seeing the other side's advertisement, so
+ * module firmware without the extension keeps using one frame per transaction.
+ * Disabled by default since it reserves two MX_MAX_MESSAGE_LEN buffers.
+ */
+#ifndef MX_SPI_MULTI_FRAME
+    #define MX_SPI_MULTI_FRAME           0
+#endif
+
+#define MX_SPI_MAX_FRAMES                8
+#define MX_SPI_FRAME_PREFIX_LEN          2
+#define MX_SPI_CAPS_MAGIC                0xC5
+#define MX_SPI_CAP_MULTI_FRAME           0x01
+
+/*
+ * Number of MTU sized pool pbufs kept armed as DMA targets for received frames. When none can be
+ * armed while the module has frames pending, the dataplane postpones reading them.
+ * The ring holds its pbufs permanently, so PBUF_POOL_SIZE must be sized to include them.
+ */
+#ifndef MX_RX_RING_LEN
+    #define MX_RX_RING_LEN               4
+#endif
+
+#if ( ( 4 * MX_RX_RING_LEN ) > PBUF_POOL_SIZE )
+    #error "MX_RX_RING_LEN takes more than a quarter of PBUF_POOL_SIZE, increase PBUF_POOL_SIZE."
+#endif
+
+#define MX_RX_RING_RETRY_MS              2
+
+/*
+ * Transmit scheduling classes. The dataplane serves them by weighted round robin so that control
+ * messages, TCP ACKs, keep-alives and DNS queries are not stuck behind bulk transfers, while bulk
+ * traffic still gets MX_TX_WEIGHT_BULK frames per round.
+ */
+typedef enum
+{
+    MX_TX_CLASS_CONTROL = 0,
+    MX_TX_CLASS_INTERACTIVE,
+    MX_TX_CLASS_BULK,
+    MX_TX_CLASS_MAX
+} MxTxClass_t;
+
+#define MX_TX_WEIGHT_CONTROL             2
+#define MX_TX_WEIGHT_INTERACTIVE         4
+#define MX_TX_WEIGHT_BULK                2
+
+/* Ethernet frames up to this length (pure ACKs, ARP, MQTT PINGREQ over TLS) are interactive */
+#define MX_TX_INTERACTIVE_MAX_LEN        128
+
+/* Item type of the send queues */
+typedef struct
+{
+    PacketBuffer_t * pxPacket;
+    TickType_t xEnqueueTime;
+} MxTxQueueItem_t;
+
+typedef struct
+{
+    uint32_t ulFrames;
+    uint32_t ulMaxDepth;      /* Deepest queue seen when taking a frame */
+    uint32_t ulLatencyTotal;  /* Ticks spent queued, summed over ulFrames */
+    uint32_t ulLatencyMax;
+} MxTxClassStats_t;
+
 typedef struct
 {
     const IotMappedPin_t * gpio_flow;
@@ -94,6 +163,22 @@ typedef struct
     MessageBufferHandle_t xControlPlaneResponseBuff;
     QueueHandle_t xDataPlaneSendQueue;
     QueueHandle_t xControlPlaneSendQueue;
+    QueueHandle_t xInteractiveSendQueue;
+    uint8_t ucTxCredits[ MX_TX_CLASS_MAX ];
+    MxTxClassStats_t xTxStats[ MX_TX_CLASS_MAX ];
+    BaseType_t xMultiFrame; /* Module advertised MX_SPI_CAP_MULTI_FRAME */
+    uint32_t ulSpiTransactions;
+    uint32_t ulTxFrames;
+    uint32_t ulRxFrames;
+    PacketBuffer_t * pxRxRing[ MX_RX_RING_LEN ];
+    uint32_t ulRxRingCount;
+    uint32_t ulRxAllocFailures; /* Ring refills that found the pbuf pool empty */
+    uint32_t ulRxDeferred;      /* Transactions postponed for lack of an rx buffer */
+    uint32_t ulRxDropped;
+    #if MX_SPI_MULTI_FRAME
+        uint8_t ucTxPackBuffer[ MX_MAX_MESSAGE_LEN ];
+        uint8_t ucRxPackBuffer[ MX_MAX_MESSAGE_LEN ];
+    #endif
 } MxDataplaneCtx_t;
 
 typedef struct
@@ -114,6 +199,7 @@ typedef struct
     volatile MxStatus_t xStatus;
     volatile MxStatus_t xStatusPrevious;
     QueueHandle_t xDataPlaneSendQueue;
+    QueueHandle_t xInteractiveSendQueue;
     volatile uint32_t * pulTxPacketsWaiting;
     TaskHandle_t xNetTaskHandle;
     TaskHandle_t xDataPlaneTaskHandle;
@@ -135,7 +221,7 @@ typedef enum
     IPC_WIFI_SOFTAP_START, /* Not used by this implementation */
     IPC_WIFI_SOFTAP_STOP,  /* Not used by this implementation */
     IPC_WIFI_GET_IP,       /* Not used by this implementation */
-    IPC_WIFI_GET_LINKINFO, /* Not used by this implementation */
+    IPC_WIFI_GET_LINKINFO,
     IPC_WIFI_PS_ON,        /* Not used by this implementation */
     IPC_WIFI_PS_OFF,       /* Not used by this implementation */
     IPC_WIFI_PING,         /* Not used by this implementation */
@@ -213,6 +299,22 @@ struct IPCResponseStatus
 
 typedef struct IPCResponseStatus IPCResponseWifiDisconnect_t;
 
+/*
+ * IPC_WIFI_GET_LINKINFO
+ * wifi_get_linkinfo_rparams_t of the module firmware: the status followed by mwifi_link_info_t,
+ * both packed, as in mx_wifi_ipc.h and mx_wifi.h of ST's MX_WIFI component (x-wifi-emw3080b).
+ */
+typedef struct IPCResponseWifiGetLinkInfo
+{
+    int32_t lStatus;
+    uint8_t ucIsConnected;
+    char cSSID[ MX_SSID_BUF_LEN ];
+    uint8_t ucBssid[ MX_BSSID_LEN ];
+    uint8_t ucSecurity;
+    uint8_t ucChannel;
+    int32_t lRssi;
+} IPCResponseWifiGetLinkInfo_t;
+
 /* IPC_WIFI_BYPASS_SET */
 
 typedef struct IPCRequestWifiBypassSet
@@ -235,6 +337,7 @@ typedef union
     IPCResponseWifiGetMac_t xResponseWifiGetMac;
     IPCRequestWifiConnect_t xRequestWifiConnect;
     IPCResponseWifiDisconnect_t xRequestWifiDisconnect;
+    IPCResponseWifiGetLinkInfo_t xResponseWifiGetLinkInfo;
     IPCRequestWifiBypassSet_t xRequestWifiBypassSet;
     IPCRequestWifiBypassGet_t xRequestWifiBypassGet;
     IPCEventStatus_t xEventStatus;
@@ -271,7 +374,9 @@ typedef struct
     uint8_t type;
     uint16_t len;
     uint16_t lenx;
-    uint8_t pad[ 3 ];
+    uint8_t ucFrames;    /* Frames packed in the payload, 0 or 1 for a single unprefixed frame */
+    uint8_t ucCapsMagic; /* MX_SPI_CAPS_MAGIC when ucCaps is valid */
+    uint8_t ucCaps;      /* MX_SPI_CAP_* flags supported by the sender */
 } SPIHeader_t;
 #pragma pack()
 
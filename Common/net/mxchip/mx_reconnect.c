@@ -0,0 +1,302 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#include <string.h>
+
+#include "mx_reconnect.h"
+
+#define FNV_OFFSET_BASIS    2166136261UL
+#define FNV_PRIME           16777619UL
+
+uint32_t ulMxReconnectHashSsid( const char * pcSSID )
+{
+    uint32_t ulHash = FNV_OFFSET_BASIS;
+
+    if( pcSSID != NULL )
+    {
+        for( const char * pcChar = pcSSID; *pcChar != '\0'; pcChar++ )
+        {
+            ulHash ^= ( uint8_t ) *pcChar;
+            ulHash *= FNV_PRIME;
+        }
+    }
+
+    return ulHash;
+}
+
+static void prvInvalidateCache( MxReconnectCtx_t * pxCtx )
+{
+    if( pxCtx->xCacheValid )
+    {
+        pxCtx->xCacheDirty = true;
+    }
+
+    ( void ) memset( &( pxCtx->xCache ), 0, sizeof( MxFastConnectCache_t ) );
+    pxCtx->xCacheValid = false;
+    pxCtx->xLeaseReusable = false;
+    pxCtx->ulDirectFailures = 0;
+}
+
+void vMxReconnectInit( MxReconnectCtx_t * pxCtx,
+                       const MxFastConnectCache_t * pxStored,
+                       size_t xStoredLength,
+                       uint32_t ulSsidHash )
+{
+    ( void ) memset( pxCtx, 0, sizeof( MxReconnectCtx_t ) );
+
+    pxCtx->xState = MX_RECONNECT_IDLE;
+    pxCtx->ulSsidHash = ulSsidHash;
+    pxCtx->ulBackoffMs = MX_RECONNECT_BACKOFF_MIN_MS;
+
+    if( ( pxStored != NULL ) &&
+        ( xStoredLength == sizeof( MxFastConnectCache_t ) ) &&
+        ( pxStored->ulMagic == MX_FAST_CONNECT_MAGIC ) &&
+        ( pxStored->ulSsidHash == ulSsidHash ) &&
+        ( pxStored->ucChannel != 0 ) )
+    {
+        ( void ) memcpy( &( pxCtx->xCache ), pxStored, sizeof( MxFastConnectCache_t ) );
+        pxCtx->xCacheValid = true;
+    }
+}
+
+void vMxReconnectReset( MxReconnectCtx_t * pxCtx,
+                        uint32_t ulSsidHash )
+{
+    prvInvalidateCache( pxCtx );
+
+    pxCtx->xState = MX_RECONNECT_IDLE;
+    pxCtx->ulSsidHash = ulSsidHash;
+    pxCtx->ulBackoffMs = MX_RECONNECT_BACKOFF_MIN_MS;
+}
+
+static MxReconnectAction_t xBeginConnect( MxReconnectCtx_t * pxCtx )
+{
+    MxReconnectAction_t xAction = { MX_RECONNECT_ACT_NONE, 0, false };
+
+    if( pxCtx->xCacheValid )
+    {
+        pxCtx->xState = MX_RECONNECT_DIRECT;
+        xAction.xType = MX_RECONNECT_ACT_CONNECT_DIRECT;
+        xAction.ulTimeoutMs = MX_FAST_CONNECT_TIMEOUT_MS;
+    }
+    else
+    {
+        pxCtx->xState = MX_RECONNECT_SCAN;
+        xAction.xType = MX_RECONNECT_ACT_CONNECT_SCAN;
+        xAction.ulTimeoutMs = MX_RECONNECT_SCAN_TIMEOUT_MS;
+    }
+
+    return xAction;
+}
+
+static MxReconnectAction_t xHandleFailure( MxReconnectCtx_t * pxCtx )
+{
+    MxReconnectAction_t xAction = { MX_RECONNECT_ACT_NONE, 0, false };
+
+    if( pxCtx->xState == MX_RECONNECT_DIRECT )
+    {
+        pxCtx->ulDirectFailures++;
+
+        /* The access point moved or went away, stop trying it until the next scan finds it */
+        if( pxCtx->ulDirectFailures >= MX_FAST_CONNECT_MAX_FAILURES )
+        {
+            prvInvalidateCache( pxCtx );
+        }
+
+        /* Fall back to a scan straight away */
+        pxCtx->xState = MX_RECONNECT_SCAN;
+        xAction.xType = MX_RECONNECT_ACT_CONNECT_SCAN;
+        xAction.ulTimeoutMs = MX_RECONNECT_SCAN_TIMEOUT_MS;
+        xAction.xDisconnectFirst = true;
+    }
+    else if( pxCtx->xState == MX_RECONNECT_SCAN )
+    {
+        pxCtx->xState = MX_RECONNECT_BACKOFF;
+        xAction.xType = MX_RECONNECT_ACT_WAIT;
+        xAction.ulTimeoutMs = pxCtx->ulBackoffMs;
+
+        pxCtx->ulBackoffMs *= 2;
+
+        if( pxCtx->ulBackoffMs > MX_RECONNECT_BACKOFF_MAX_MS )
+        {
+            pxCtx->ulBackoffMs = MX_RECONNECT_BACKOFF_MAX_MS;
+        }
+    }
+    else
+    {
+        /* Not connecting, nothing to do */
+    }
+
+    return xAction;
+}
+
+MxReconnectAction_t xMxReconnectHandleEvent( MxReconnectCtx_t * pxCtx,
+                                             MxReconnectEvent_t xEvent )
+{
+    MxReconnectAction_t xAction = { MX_RECONNECT_ACT_NONE, 0, false };
+
+    switch( xEvent )
+    {
+        case MX_RECONNECT_EVT_START:
+
+            if( pxCtx->xState == MX_RECONNECT_IDLE )
+            {
+                xAction = xBeginConnect( pxCtx );
+            }
+
+            break;
+
+        case MX_RECONNECT_EVT_TIMEOUT:
+
+            if( pxCtx->xState == MX_RECONNECT_BACKOFF )
+            {
+                xAction = xBeginConnect( pxCtx );
+            }
+
+            break;
+
+        case MX_RECONNECT_EVT_LINK_UP:
+
+            if( pxCtx->xState != MX_RECONNECT_CONNECTED )
+            {
+                /* The lease is only reused on the access point it was bound on */
+                pxCtx->xLeaseReusable = ( pxCtx->xState == MX_RECONNECT_DIRECT ) &&
+                                        ( pxCtx->xCache.ulIpAddr != 0 );
+
+                if( pxCtx->xState == MX_RECONNECT_DIRECT )
+                {
+                    pxCtx->ulDirectFailures = 0;
+                }
+
+                pxCtx->ulBackoffMs = MX_RECONNECT_BACKOFF_MIN_MS;
+                pxCtx->xState = MX_RECONNECT_CONNECTED;
+            }
+
+            break;
+
+        case MX_RECONNECT_EVT_LINK_DOWN:
+
+            if( pxCtx->xState == MX_RECONNECT_CONNECTED )
+            {
+                pxCtx->xLeaseReusable = false;
+                xAction = xBeginConnect( pxCtx );
+            }
+            else
+            {
+                xAction = xHandleFailure( pxCtx );
+            }
+
+            break;
+
+        case MX_RECONNECT_EVT_FAILED:
+            xAction = xHandleFailure( pxCtx );
+            break;
+
+        default:
+            break;
+    }
+
+    return xAction;
+}
+
+void vMxReconnectUpdateLink( MxReconnectCtx_t * pxCtx,
+                             const uint8_t * pucBssid,
+                             uint8_t ucChannel,
+                             uint8_t ucSecurity )
+{
+    if( ( pucBssid != NULL ) && ( ucChannel != 0 ) )
+    {
+        if( ( pxCtx->xCacheValid == false ) ||
+            ( pxCtx->xCache.ulSsidHash != pxCtx->ulSsidHash ) ||
+            ( memcmp( pxCtx->xCache.ucBssid, pucBssid, MX_FAST_CONNECT_BSSID_LEN ) != 0 ) ||
+            ( pxCtx->xCache.ucChannel != ucChannel ) ||
+            ( pxCtx->xCache.ucSecurity != ucSecurity ) )
+        {
+            pxCtx->xCache.ulMagic = MX_FAST_CONNECT_MAGIC;
+            pxCtx->xCache.ulSsidHash = pxCtx->ulSsidHash;
+            ( void ) memcpy( pxCtx->xCache.ucBssid, pucBssid, MX_FAST_CONNECT_BSSID_LEN );
+            pxCtx->xCache.ucChannel = ucChannel;
+            pxCtx->xCache.ucSecurity = ucSecurity;
+
+            pxCtx->xCacheValid = true;
+            pxCtx->xCacheDirty = true;
+            pxCtx->ulDirectFailures = 0;
+        }
+    }
+}
+
+void vMxReconnectUpdateLease( MxReconnectCtx_t * pxCtx,
+                              uint32_t ulIpAddr,
+                              uint32_t ulNetmask,
+                              uint32_t ulGateway )
+{
+    if( ( ulIpAddr != 0 ) &&
+        ( ( pxCtx->xCache.ulIpAddr != ulIpAddr ) ||
+          ( pxCtx->xCache.ulNetmask != ulNetmask ) ||
+          ( pxCtx->xCache.ulGateway != ulGateway ) ) )
+    {
+        pxCtx->xCache.ulIpAddr = ulIpAddr;
+        pxCtx->xCache.ulNetmask = ulNetmask;
+        pxCtx->xCache.ulGateway = ulGateway;
+
+        /* Only worth persisting along with an access point */
+        pxCtx->xCacheDirty = pxCtx->xCacheDirty || pxCtx->xCacheValid;
+    }
+}
+
+bool xMxReconnectTakeLease( MxReconnectCtx_t * pxCtx,
+                            uint32_t * pulIpAddr,
+                            uint32_t * pulNetmask,
+                            uint32_t * pulGateway )
+{
+    bool xReturn = pxCtx->xLeaseReusable;
+
+    if( xReturn )
+    {
+        *pulIpAddr = pxCtx->xCache.ulIpAddr;
+        *pulNetmask = pxCtx->xCache.ulNetmask;
+        *pulGateway = pxCtx->xCache.ulGateway;
+        pxCtx->xLeaseReusable = false;
+    }
+
+    return xReturn;
+}
+
+bool xMxReconnectTakeDirty( MxReconnectCtx_t * pxCtx,
+                            MxFastConnectCache_t * pxRecord )
+{
+    bool xReturn = pxCtx->xCacheDirty;
+
+    if( xReturn )
+    {
+        /* An invalidated cache is written as a zeroed record */
+        ( void ) memcpy( pxRecord, &( pxCtx->xCache ), sizeof( MxFastConnectCache_t ) );
+        pxCtx->xCacheDirty = false;
+    }
+
+    return xReturn;
+}
@@ -0,0 +1,150 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+#ifndef _MX_RECONNECT_H_
+#define _MX_RECONNECT_H_
+
+/*
+ * Fast reconnect state machine.
+ *
+ * The access point and DHCP lease of the last connection are cached so that the next
+ * connection can associate directly with the known BSSID on the known channel instead of
+ * scanning, and the previous address can be used while DHCP confirms it. The state machine
+ * only consumes events and returns the action to perform; it has no dependency on the
+ * module driver, FreeRTOS or lwip and can be driven by a scripted module on a host.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define MX_FAST_CONNECT_MAGIC           0x4D584331UL /* "MXC1", changes with the record layout */
+#define MX_FAST_CONNECT_BSSID_LEN       6
+
+#define MX_FAST_CONNECT_TIMEOUT_MS      1500         /* Time allowed for a direct association */
+#define MX_FAST_CONNECT_MAX_FAILURES    2            /* Consecutive direct failures before the cache is dropped */
+#define MX_FAST_CONNECT_PROBE_MS        250          /* Time allowed for a host holding the cached address to answer ARP */
+#define MX_RECONNECT_SCAN_TIMEOUT_MS    ( 120 * 1000 )
+#define MX_RECONNECT_BACKOFF_MIN_MS     1000
+#define MX_RECONNECT_BACKOFF_MAX_MS     ( 30 * 1000 )
+
+/* Record persisted in the CS_WIFI_FAST_CONNECT key */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulSsidHash;
+    uint8_t ucBssid[ MX_FAST_CONNECT_BSSID_LEN ];
+    uint8_t ucChannel;
+    uint8_t ucSecurity;
+    uint32_t ulIpAddr; /* Last DHCP lease, network byte order. Zero when unknown. */
+    uint32_t ulNetmask;
+    uint32_t ulGateway;
+} MxFastConnectCache_t;
+
+typedef enum
+{
+    MX_RECONNECT_IDLE = 0,
+    MX_RECONNECT_DIRECT,    /* Associating with the cached access point */
+    MX_RECONNECT_SCAN,      /* Associating by SSID after a scan */
+    MX_RECONNECT_BACKOFF,   /* Waiting before the next attempt */
+    MX_RECONNECT_CONNECTED
+} MxReconnectState_t;
+
+typedef enum
+{
+    MX_RECONNECT_EVT_START,     /* Link is down and a connection is wanted */
+    MX_RECONNECT_EVT_LINK_UP,   /* Module reported station up */
+    MX_RECONNECT_EVT_LINK_DOWN, /* Module reported station down */
+    MX_RECONNECT_EVT_FAILED,    /* Connect request failed or did not complete in time */
+    MX_RECONNECT_EVT_TIMEOUT    /* Backoff period elapsed */
+} MxReconnectEvent_t;
+
+typedef enum
+{
+    MX_RECONNECT_ACT_NONE,
+    MX_RECONNECT_ACT_CONNECT_DIRECT, /* Connect to the cached BSSID and channel */
+    MX_RECONNECT_ACT_CONNECT_SCAN,   /* Connect by SSID */
+    MX_RECONNECT_ACT_WAIT            /* Send MX_RECONNECT_EVT_TIMEOUT after ulTimeoutMs */
+} MxReconnectActionType_t;
+
+typedef struct
+{
+    MxReconnectActionType_t xType;
+    uint32_t ulTimeoutMs;   /* Time allowed for the connection, or time to wait */
+    bool xDisconnectFirst;  /* Abort the previous association attempt first */
+} MxReconnectAction_t;
+
+typedef struct
+{
+    MxReconnectState_t xState;
+    MxFastConnectCache_t xCache;
+    uint32_t ulSsidHash;
+    uint32_t ulDirectFailures;
+    uint32_t ulBackoffMs;
+    bool xCacheValid;
+    bool xCacheDirty;    /* Cache differs from the persisted record */
+    bool xLeaseReusable; /* Link came up on the cached access point with a known lease */
+} MxReconnectCtx_t;
+
+uint32_t ulMxReconnectHashSsid( const char * pcSSID );
+
+/* pxStored may be NULL. The record is ignored unless it matches ulSsidHash. */
+void vMxReconnectInit( MxReconnectCtx_t * pxCtx,
+                       const MxFastConnectCache_t * pxStored,
+                       size_t xStoredLength,
+                       uint32_t ulSsidHash );
+
+/* Forget the cached access point, e.g. when the credentials change */
+void vMxReconnectReset( MxReconnectCtx_t * pxCtx,
+                        uint32_t ulSsidHash );
+
+MxReconnectAction_t xMxReconnectHandleEvent( MxReconnectCtx_t * pxCtx,
+                                             MxReconnectEvent_t xEvent );
+
+/* Record the access point the module is associated with */
+void vMxReconnectUpdateLink( MxReconnectCtx_t * pxCtx,
+                             const uint8_t * pucBssid,
+                             uint8_t ucChannel,
+                             uint8_t ucSecurity );
+
+/* Record a lease bound by DHCP */
+void vMxReconnectUpdateLease( MxReconnectCtx_t * pxCtx,
+                              uint32_t ulIpAddr,
+                              uint32_t ulNetmask,
+                              uint32_t ulGateway );
+
+/* Returns the cached lease once after a direct reconnect, for use until DHCP confirms it */
+bool xMxReconnectTakeLease( MxReconnectCtx_t * pxCtx,
+                            uint32_t * pulIpAddr,
+                            uint32_t * pulNetmask,
+                            uint32_t * pulGateway );
+
+/* Returns true and the record to persist when the cache changed */
+bool xMxReconnectTakeDirty( MxReconnectCtx_t * pxCtx,
+                            MxFastConnectCache_t * pxRecord );
+
+#endif /* _MX_RECONNECT_H_ */
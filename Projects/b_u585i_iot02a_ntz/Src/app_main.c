@@ -81,7 +81,11 @@ static int fs_init( void )
     struct lfs_info xDirInfo = { 0 };
 
     /* Block time of up to 1 s for filesystem to initialize */
-    const struct lfs_config * pxCfg = pxInitializeOSPIFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
+    #if LFS_PORT_DEFAULT_FS_INTERNAL_FLASH == 1
+        const struct lfs_config * pxCfg = pxInitializeInternalFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
+    #else
+        const struct lfs_config * pxCfg = pxInitializeOSPIFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
+    #endif
 
     /* mount the filesystem */
     int err = lfs_mount( &xLfsCtx, pxCfg );
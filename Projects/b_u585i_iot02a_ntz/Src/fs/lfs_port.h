@@ -25,9 +25,34 @@
  *
  */
 
+#ifndef _LFS_PORT_H
+#define _LFS_PORT_H
+
 #include "lfs.h"
 #include "lfs_util.h"
 
+/*
+ * Mount the internal flash rather than the OSPI NOR flash as the default filesystem.
+ * Erase count telemetry (the flashwear command) is only available for the internal flash.
+ * The internal flash volume currently shares bank 2 with the OTA staging area, so this
+ * option is rejected at build time wherever the OTA PAL is built.
+ */
+#ifndef LFS_PORT_DEFAULT_FS_INTERNAL_FLASH
+    #define LFS_PORT_DEFAULT_FS_INTERNAL_FLASH    0
+#endif
+
+/* Block device access counters maintained by each lfs port */
+typedef struct LfsPortStats
+{
+    uint32_t ulReadOps;
+    uint32_t ulReadBytes;
+    uint32_t ulProgOps;
+    uint32_t ulProgBytes;
+    uint32_t ulEraseOps;
+    uint32_t ulCacheHits;  /* Reads serviced from the read-ahead cache */
+    uint32_t ulCacheFills; /* Whole block device reads made to fill the read-ahead cache */
+} LfsPortStats_t;
+
 #ifdef LFS_NO_MALLOC
     const struct lfs_config * pxInitializeOSPIFlashFsStatic( TickType_t xBlockTime );
     const struct lfs_config * pxInitializeInternalFlashFsStatic( TickType_t xBlockTime );
@@ -36,5 +61,14 @@
     const struct lfs_config * pxInitializeInternalFlashFs( TickType_t xBlockTime );
 #endif
 
+/* Erase count telemetry for the internal flash filesystem */
+const uint32_t * pulGetInternalFlashEraseCounts( size_t * pxBlockCount );
+
+/* Snapshot the block device access counters of a mounted filesystem */
+void vLfsPortGetStats( const struct lfs_config * pxCfg,
+                       LfsPortStats_t * pxStats );
+
 /* Provided outside of the lfs port */
 lfs_t * pxGetDefaultFsCtx( void );
+
+#endif /* _LFS_PORT_H */
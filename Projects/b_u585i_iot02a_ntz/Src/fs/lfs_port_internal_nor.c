@@ -25,6 +25,8 @@
  *
  */
 
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_ERROR
 #include "logging.h"
 
 #include "FreeRTOS.h"
@@ -32,6 +34,7 @@
 
 #include "lfs_util.h"
 #include "lfs.h"
+#include "lfs_port.h"
 #include "lfs_port_prv.h"
 
 #include "stm32u585xx.h"
@@ -47,7 +50,70 @@
 /* Use second bank to avoid program flash. TODO: Should add variable in linker script to mark end of program flash */
 #define CONFIG_LFS_FLASH_BASE        ( FLASH_BASE + FLASH_BANK_SIZE )
 #define LFS_CONFIG_LOOKAHEAD_SIZE    16
-#define LFS_CONFIG_CACHE_SIZE        16
+
+/* Larger caches allow littlefs to hand whole bursts to lfs_port_prog */
+#define LFS_CONFIG_CACHE_SIZE        256
+
+/* Smallest programmable unit of the STM32U5 internal flash */
+#define LFS_CONFIG_PROG_SIZE         ( 4 * sizeof( uint32_t ) )
+
+/* Size of a burst program operation (8 quad-words) */
+#define LFS_PORT_BURST_SIZE          ( 8 * LFS_CONFIG_PROG_SIZE )
+
+#ifndef LFS_CONFIG_BLOCK_CYCLES
+    #define LFS_CONFIG_BLOCK_CYCLES    500
+#endif
+
+/* The last page of the bank is reserved for erase count tracking */
+#define LFS_PORT_BLOCK_COUNT         ( FLASH_PAGE_NB - 1 )
+
+/*
+ * Volumes formatted before the erase count page was reserved span the whole bank.
+ * They are detected from the littlefs superblock and keep their geometry, with erase counts held in RAM only.
+ */
+#define LFS_PORT_LEGACY_BLOCK_COUNT    ( FLASH_PAGE_NB )
+
+/* Offsets of the magic string and geometry in the first commit of a littlefs superblock */
+#define LFS_SUPERBLOCK_MAGIC_OFFSET          ( 8 )
+#define LFS_SUPERBLOCK_BLOCK_SIZE_OFFSET     ( 24 )
+#define LFS_SUPERBLOCK_BLOCK_COUNT_OFFSET    ( 28 )
+#define LFS_PORT_WEAR_PAGE           ( FLASH_PAGE_NB - 1 )
+#define LFS_PORT_WEAR_PAGE_ADDR      ( CONFIG_LFS_FLASH_BASE + ( LFS_PORT_WEAR_PAGE * FLASH_PAGE_SIZE ) )
+
+/*
+ * Layout of the erase count page:
+ *  - A header quad-word, written last when the page is rewritten.
+ *  - A snapshot of the erase count of every block.
+ *  - A journal of quad-word records, one appended for each block erase.
+ * Once the journal is full, the page is erased and a new snapshot is written.
+ */
+#define WEAR_MAGIC                   ( 0x52414557 ) /* "WEAR" */
+#define WEAR_SNAPSHOT_LEN            ( ( ( FLASH_PAGE_NB * sizeof( uint32_t ) ) + LFS_CONFIG_PROG_SIZE - 1 ) & ~( LFS_CONFIG_PROG_SIZE - 1 ) )
+#define WEAR_SNAPSHOT_ADDR           ( LFS_PORT_WEAR_PAGE_ADDR + sizeof( WearHeader_t ) )
+#define WEAR_JOURNAL_ADDR            ( WEAR_SNAPSHOT_ADDR + WEAR_SNAPSHOT_LEN )
+#define WEAR_JOURNAL_ENTRIES         ( ( LFS_PORT_WEAR_PAGE_ADDR + FLASH_PAGE_SIZE - WEAR_JOURNAL_ADDR ) / sizeof( WearJournalEntry_t ) )
+
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulBlockCount;
+    uint32_t ulSnapshotCrc;
+    uint32_t ulMagicInv;
+} WearHeader_t;
+
+typedef struct
+{
+    uint32_t ulBlock;
+    uint32_t ulEraseCount;
+    uint32_t ulBlockInv;
+    uint32_t ulEraseCountInv;
+} WearJournalEntry_t;
+
+/* Erase count of each page of the bank (including the tracking page), padded to a whole number of quad-words */
+static uint32_t __ALIGN_BEGIN ulEraseCounts[ WEAR_SNAPSHOT_LEN / sizeof( uint32_t ) ] __ALIGN_END = { 0 };
+static uint32_t ulJournalIdx = 0;
+static BaseType_t xWearInitialized = pdFALSE;
+static BaseType_t xWearPersistent = pdTRUE;
 
 #ifdef LFS_NO_MALLOC
 static uint8_t __ALIGN_BEGIN ucReadBuffer[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
@@ -58,6 +124,276 @@ static struct LfsPortCtx xLfsCtx = { 0 };
 static StaticSemaphore_t xMutexStatic;
 #endif
 
+/*
+ * Program a quad-word aligned region of the internal flash. The flash must already be unlocked.
+ * Uses 8 quad-word burst operations wherever the destination is burst aligned.
+ */
+static HAL_StatusTypeDef prvProgramFlash( uint32_t ulDestAddr,
+                                          const void * pvSrc,
+                                          uint32_t ulLen )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    uint32_t ulSrcAddr = ( uint32_t ) pvSrc;
+    uint32_t ulEndAddr = ulDestAddr + ulLen;
+
+    configASSERT( ( ulDestAddr % LFS_CONFIG_PROG_SIZE ) == 0 );
+    configASSERT( ( ulLen % LFS_CONFIG_PROG_SIZE ) == 0 );
+    configASSERT( ( ulSrcAddr % sizeof( uint32_t ) ) == 0 );
+
+    while( ( xHalStatus == HAL_OK ) &&
+           ( ulDestAddr < ulEndAddr ) )
+    {
+        uint32_t ulStep;
+
+        if( ( ( ulDestAddr % LFS_PORT_BURST_SIZE ) == 0 ) &&
+            ( ( ulEndAddr - ulDestAddr ) >= LFS_PORT_BURST_SIZE ) )
+        {
+            xHalStatus = HAL_FLASH_Program( FLASH_TYPEPROGRAM_BURST, ulDestAddr, ulSrcAddr );
+            ulStep = LFS_PORT_BURST_SIZE;
+        }
+        else
+        {
+            xHalStatus = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, ulDestAddr, ulSrcAddr );
+            ulStep = LFS_CONFIG_PROG_SIZE;
+        }
+
+        ulDestAddr += ulStep;
+        ulSrcAddr += ulStep;
+    }
+
+    return xHalStatus;
+}
+
+static HAL_StatusTypeDef prvErasePage( uint32_t ulPage )
+{
+    uint32_t ulPageError = 0;
+    FLASH_EraseInitTypeDef xEraseConfig =
+    {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks     = FLASH_BANK_2,
+        .Page      = ulPage,
+        .NbPages   = 1,
+    };
+
+    return HAL_FLASHEx_Erase( &xEraseConfig, &ulPageError );
+}
+
+static inline BaseType_t xIsErased( const uint32_t * pulData,
+                                    size_t uxWords )
+{
+    BaseType_t xErased = pdTRUE;
+
+    for( size_t uxIdx = 0; uxIdx < uxWords; uxIdx++ )
+    {
+        if( pulData[ uxIdx ] != 0xFFFFFFFF )
+        {
+            xErased = pdFALSE;
+            break;
+        }
+    }
+
+    return xErased;
+}
+
+/*
+ * Erase the erase count page and write a fresh snapshot of the in-memory erase counts.
+ * The flash must already be unlocked.
+ */
+static HAL_StatusTypeDef prvWearCompact( void )
+{
+    HAL_StatusTypeDef xHalStatus = prvErasePage( LFS_PORT_WEAR_PAGE );
+
+    /* Count the erase of the tracking page itself so that its wear is reported too */
+    ulEraseCounts[ LFS_PORT_WEAR_PAGE ]++;
+
+    if( xHalStatus == HAL_OK )
+    {
+        xHalStatus = prvProgramFlash( WEAR_SNAPSHOT_ADDR, ulEraseCounts, WEAR_SNAPSHOT_LEN );
+    }
+
+    /* The header is written last so that an interrupted rewrite is detected on the next boot */
+    if( xHalStatus == HAL_OK )
+    {
+        WearHeader_t xHeader =
+        {
+            .ulMagic       = WEAR_MAGIC,
+            .ulBlockCount  = LFS_PORT_BLOCK_COUNT,
+            .ulSnapshotCrc = lfs_crc( 0xFFFFFFFF, ulEraseCounts, WEAR_SNAPSHOT_LEN ),
+            .ulMagicInv    = ~WEAR_MAGIC,
+        };
+
+        xHalStatus = prvProgramFlash( LFS_PORT_WEAR_PAGE_ADDR, &xHeader, sizeof( xHeader ) );
+    }
+
+    ulJournalIdx = 0;
+
+    return xHalStatus;
+}
+
+/*
+ * Returns pdTRUE if either superblock of an existing volume records a block count covering the whole bank.
+ */
+static BaseType_t xIsLegacyVolume( void )
+{
+    BaseType_t xLegacy = pdFALSE;
+
+    for( uint32_t ulBlock = 0; ulBlock < 2; ulBlock++ )
+    {
+        const uint8_t * pucBlock = ( const uint8_t * ) ( CONFIG_LFS_FLASH_BASE + ( ulBlock * FLASH_PAGE_SIZE ) );
+        uint32_t ulBlockSize = 0;
+        uint32_t ulBlockCount = 0;
+
+        ( void ) memcpy( &ulBlockSize, &( pucBlock[ LFS_SUPERBLOCK_BLOCK_SIZE_OFFSET ] ), sizeof( uint32_t ) );
+        ( void ) memcpy( &ulBlockCount, &( pucBlock[ LFS_SUPERBLOCK_BLOCK_COUNT_OFFSET ] ), sizeof( uint32_t ) );
+
+        if( ( memcmp( &( pucBlock[ LFS_SUPERBLOCK_MAGIC_OFFSET ] ), "littlefs", 8 ) == 0 ) &&
+            ( lfs_fromle32( ulBlockSize ) == FLASH_PAGE_SIZE ) &&
+            ( lfs_fromle32( ulBlockCount ) == LFS_PORT_LEGACY_BLOCK_COUNT ) )
+        {
+            xLegacy = pdTRUE;
+        }
+    }
+
+    return xLegacy;
+}
+
+/*
+ * Load the erase counts from the snapshot and journal, rebuilding the page if it is not valid.
+ * On a legacy volume the tracking page belongs to the filesystem, so the counts are kept in RAM only.
+ */
+static void vWearInit( void )
+{
+    const WearHeader_t * pxHeader = ( const WearHeader_t * ) LFS_PORT_WEAR_PAGE_ADDR;
+    const WearJournalEntry_t * pxJournal = ( const WearJournalEntry_t * ) WEAR_JOURNAL_ADDR;
+    BaseType_t xValid = pdFALSE;
+
+    if( xWearPersistent == pdFALSE )
+    {
+        LogWarn( "Volume predates the erase count page. Erase counts are not persisted until it is reformatted." );
+    }
+    else if( ( pxHeader->ulMagic == WEAR_MAGIC ) &&
+             ( pxHeader->ulMagicInv == ~WEAR_MAGIC ) &&
+             ( pxHeader->ulBlockCount == LFS_PORT_BLOCK_COUNT ) )
+    {
+        ( void ) memcpy( ulEraseCounts, ( const void * ) WEAR_SNAPSHOT_ADDR, WEAR_SNAPSHOT_LEN );
+
+        xValid = ( lfs_crc( 0xFFFFFFFF, ulEraseCounts, WEAR_SNAPSHOT_LEN ) == pxHeader->ulSnapshotCrc );
+    }
+
+    if( xValid == pdTRUE )
+    {
+        for( ulJournalIdx = 0; ulJournalIdx < WEAR_JOURNAL_ENTRIES; ulJournalIdx++ )
+        {
+            const WearJournalEntry_t * pxEntry = &( pxJournal[ ulJournalIdx ] );
+
+            if( xIsErased( ( const uint32_t * ) pxEntry, sizeof( WearJournalEntry_t ) / sizeof( uint32_t ) ) == pdTRUE )
+            {
+                break;
+            }
+            else if( ( pxEntry->ulBlockInv == ~( pxEntry->ulBlock ) ) &&
+                     ( pxEntry->ulEraseCountInv == ~( pxEntry->ulEraseCount ) ) &&
+                     ( pxEntry->ulBlock < LFS_PORT_BLOCK_COUNT ) )
+            {
+                ulEraseCounts[ pxEntry->ulBlock ] = pxEntry->ulEraseCount;
+            }
+            else
+            {
+                LogWarn( "Skipping corrupt erase count journal entry %lu.", ulJournalIdx );
+            }
+        }
+    }
+    else if( xWearPersistent == pdTRUE )
+    {
+        LogWarn( "Erase count page is not valid. Erase counts restart from zero." );
+
+        ( void ) memset( ulEraseCounts, 0, sizeof( ulEraseCounts ) );
+        ulJournalIdx = WEAR_JOURNAL_ENTRIES;
+    }
+    else
+    {
+        ( void ) memset( ulEraseCounts, 0, sizeof( ulEraseCounts ) );
+    }
+
+    /* Rewrite the page if it was invalid or the journal is full */
+    if( ( xWearPersistent == pdTRUE ) &&
+        ( ulJournalIdx >= WEAR_JOURNAL_ENTRIES ) )
+    {
+        HAL_StatusTypeDef xHalStatus;
+
+        HAL_FLASH_Unlock();
+        __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
+
+        xHalStatus = prvWearCompact();
+
+        HAL_FLASH_Lock();
+
+        if( xHalStatus != HAL_OK )
+        {
+            LogError( "Failed to write erase count page. xHalStatus: %d", xHalStatus );
+        }
+    }
+
+    xWearInitialized = pdTRUE;
+}
+
+/*
+ * Record an erase of the given block. The flash must already be unlocked.
+ */
+static HAL_StatusTypeDef prvWearRecordErase( lfs_block_t block )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+
+    ulEraseCounts[ block ]++;
+
+    if( xWearPersistent == pdFALSE )
+    {
+        /* The tracking page is part of a legacy volume */
+    }
+    else if( ulJournalIdx >= WEAR_JOURNAL_ENTRIES )
+    {
+        xHalStatus = prvWearCompact();
+    }
+    else
+    {
+        WearJournalEntry_t xEntry =
+        {
+            .ulBlock         = block,
+            .ulEraseCount    = ulEraseCounts[ block ],
+            .ulBlockInv      = ~block,
+            .ulEraseCountInv = ~( ulEraseCounts[ block ] ),
+        };
+
+        xHalStatus = prvProgramFlash( WEAR_JOURNAL_ADDR + ( ulJournalIdx * sizeof( WearJournalEntry_t ) ),
+                                      &xEntry,
+                                      sizeof( xEntry ) );
+        ulJournalIdx++;
+    }
+
+    return xHalStatus;
+}
+
+/*
+ * Returns the erase count of each page of the bank, with the erase count tracking page
+ * (or the last block of a legacy volume) as the last entry, or NULL if the filesystem has not been initialized.
+ * @param[out] pxBlockCount Number of entries in the returned array
+ */
+const uint32_t * pulGetInternalFlashEraseCounts( size_t * pxBlockCount )
+{
+    const uint32_t * pulCounts = NULL;
+
+    if( xWearInitialized == pdTRUE )
+    {
+        pulCounts = ulEraseCounts;
+
+        if( pxBlockCount != NULL )
+        {
+            *pxBlockCount = LFS_PORT_BLOCK_COUNT + 1;
+        }
+    }
+
+    return pulCounts;
+}
+
 static int lfs_port_read( const struct lfs_config * c,
                           lfs_block_t block,
                           lfs_off_t off,
@@ -73,6 +409,11 @@ static int lfs_port_read( const struct lfs_config * c,
 
     HAL_FLASH_Lock();
 
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
+
+    pxCtx->xStats.ulReadOps++;
+    pxCtx->xStats.ulReadBytes += size;
+
     return 0;
 }
 
@@ -83,53 +424,52 @@ static int lfs_port_prog( const struct lfs_config * c,
                           lfs_size_t size )
 {
     HAL_StatusTypeDef xHAL_Status = HAL_OK;
-    uint32_t n_rows = size / c->prog_size;
-    uint32_t dest_address = 0;
-    uint32_t src_address = 0;
-    uint32_t block_base_addr = CONFIG_LFS_FLASH_BASE + block * c->block_size;
+    uint32_t dest_address = CONFIG_LFS_FLASH_BASE + block * c->block_size + off;
 
     struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
 
     configASSERT( xQueueGetMutexHolder( pxCtx->xMutex ) == xTaskGetCurrentTaskHandle() );
+    configASSERT( block < c->block_count );
 
     HAL_FLASH_Unlock();
     __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
 
-    for( uint32_t i_row = 0; i_row < n_rows; i_row++ )
-    {
-        dest_address = block_base_addr + off + i_row * 4 * sizeof( uint32_t );
-        src_address = ( uint32_t ) buffer + i_row * 4 * sizeof( uint32_t );
-        xHAL_Status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, dest_address, src_address );
-
-        if( xHAL_Status != HAL_OK )
-        {
-            HAL_FLASH_Lock();
-            return -1;
-        }
-    }
+    xHAL_Status = prvProgramFlash( dest_address, buffer, size );
 
     HAL_FLASH_Lock();
 
-    return 0;
+    if( xHAL_Status == HAL_OK )
+    {
+        pxCtx->xStats.ulProgOps++;
+        pxCtx->xStats.ulProgBytes += size;
+    }
+
+    return xHAL_Status == HAL_OK ? 0 : -1;
 }
 
 static int lfs_port_erase( const struct lfs_config * c,
                            lfs_block_t block )
 {
-    uint32_t ulPageError = 0;
-    FLASH_EraseInitTypeDef xErase_Config = { 0 };
     struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
 
     configASSERT( xQueueGetMutexHolder( pxCtx->xMutex ) == xTaskGetCurrentTaskHandle() );
-
-    xErase_Config.TypeErase = FLASH_TYPEERASE_PAGES;
-    xErase_Config.Banks = FLASH_BANK_2;
-    xErase_Config.Page = block;
-    xErase_Config.NbPages = 1;
+    configASSERT( block < c->block_count );
 
     HAL_FLASH_Unlock();
     __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
-    HAL_StatusTypeDef xHAL_Status = HAL_FLASHEx_Erase( &xErase_Config, &ulPageError );
+
+    HAL_StatusTypeDef xHAL_Status = prvErasePage( block );
+
+    pxCtx->xStats.ulEraseOps++;
+
+    if( xHAL_Status == HAL_OK )
+    {
+        /* Failing to record the erase only affects telemetry */
+        if( prvWearRecordErase( block ) != HAL_OK )
+        {
+            LogWarn( "Failed to record erase of block %lu.", block );
+        }
+    }
 
     HAL_FLASH_Lock();
 
@@ -154,15 +494,17 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
     #ifdef LFS_THREADSAFE
         pxCfg->lock = &lfs_port_lock;
-        pxCfg->lock = &lfs_port_unlock;
+        pxCfg->unlock = &lfs_port_unlock;
     #endif
 
     pxCfg->read_size = 1;
-    pxCfg->prog_size = 16;
+    pxCfg->prog_size = LFS_CONFIG_PROG_SIZE;
     pxCfg->block_size = FLASH_PAGE_SIZE;
 
-    pxCfg->block_count = FLASH_PAGE_NB;
-    pxCfg->block_cycles = 500;
+    xWearPersistent = ( xIsLegacyVolume() == pdTRUE ) ? pdFALSE : pdTRUE;
+
+    pxCfg->block_count = ( xWearPersistent == pdTRUE ) ? LFS_PORT_BLOCK_COUNT : LFS_PORT_LEGACY_BLOCK_COUNT;
+    pxCfg->block_cycles = LFS_CONFIG_BLOCK_CYCLES;
 
     pxCfg->cache_size = LFS_CONFIG_CACHE_SIZE;
     pxCfg->lookahead_size = LFS_CONFIG_LOOKAHEAD_SIZE;
@@ -194,12 +536,16 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
     {
         xLfsCfg.context = ( void * ) &xLfsCtx;
 
-        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &( &xMutexStatic ) );
+        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &xMutexStatic );
         xLfsCtx.xBlockTime = xBlockTime;
 
         configASSERT( xLfsCtx.xMutex != NULL );
 
         vPopulateConfig( &xLfsCfg, &xLfsCtx );
+
+        vWearInit();
+
+        return &xLfsCfg;
     }
 #else /* ifdef LFS_NO_MALLOC */
 
@@ -214,15 +560,19 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
         configASSERT( pxCfg != NULL );
 
-        struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) ( pvPortMalloc( sizeof( struct lfs_config ) ) );
+        struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) ( pvPortMalloc( sizeof( struct LfsPortCtx ) ) );
 
         configASSERT( pxCtx != NULL );
 
+        ( void ) memset( &( pxCtx->xStats ), 0, sizeof( LfsPortStats_t ) );
         pxCtx->xBlockTime = xBlockTime;
         pxCtx->xMutex = xSemaphoreCreateMutex();
         configASSERT( pxCtx->xMutex != NULL );
 
         vPopulateConfig( pxCfg, pxCtx );
+
+        vWearInit();
+
         return pxCfg;
     }
 #endif /* LFS_NO_MALLOC */
@@ -41,6 +41,100 @@
  * LittleFS port for the external NOR flash connected to the STM32U5 octo-spi interface
  */
 
+/*
+ * Read the flash through the OCTOSPI2 memory mapped window rather than with indirect 8READ commands.
+ * Program and erase operations switch back to indirect mode for their duration.
+ */
+#ifndef LFS_PORT_OSPI_MEM_MAPPED_READ
+    #define LFS_PORT_OSPI_MEM_MAPPED_READ    1
+#endif
+
+/*
+ * Number of sectors held in the read-ahead cache. Reads smaller than a sector are
+ * serviced by fetching the whole containing sector with a single DMA transfer so that
+ * sequential small reads do not each pay the OSPI command overhead.
+ *
+ * The cache only applies to the indirect DMA read path, built with LFS_PORT_OSPI_MEM_MAPPED_READ
+ * set to 0. Memory mapped reads are cached by DCACHE1 instead, so the cache is not built for them.
+ * Define as 0 to disable the read-ahead cache on the DMA read path.
+ */
+#if LFS_PORT_OSPI_MEM_MAPPED_READ == 1
+    #if defined( LFS_PORT_OSPI_READ_CACHE_LINES ) && ( LFS_PORT_OSPI_READ_CACHE_LINES > 0 )
+        #error "LFS_PORT_OSPI_READ_CACHE_LINES requires LFS_PORT_OSPI_MEM_MAPPED_READ to be 0"
+    #endif
+    #undef LFS_PORT_OSPI_READ_CACHE_LINES
+    #define LFS_PORT_OSPI_READ_CACHE_LINES    0
+#elif !defined( LFS_PORT_OSPI_READ_CACHE_LINES )
+    #define LFS_PORT_OSPI_READ_CACHE_LINES    2
+#endif
+
+#if LFS_PORT_OSPI_READ_CACHE_LINES > 0
+
+    #define LFS_PORT_OSPI_CACHE_INVALID    ( ( lfs_block_t ) 0xFFFFFFFF )
+
+typedef struct
+{
+    lfs_block_t xBlock;
+    uint8_t ucData[ MX25LM_SECTOR_SZ ];
+} OspiReadCacheLine_t;
+
+static OspiReadCacheLine_t __ALIGN_BEGIN xReadCache[ LFS_PORT_OSPI_READ_CACHE_LINES ] __ALIGN_END = { 0 };
+
+static void vReadCacheInit( void )
+{
+    for( uint32_t ulIdx = 0; ulIdx < LFS_PORT_OSPI_READ_CACHE_LINES; ulIdx++ )
+    {
+        xReadCache[ ulIdx ].xBlock = LFS_PORT_OSPI_CACHE_INVALID;
+    }
+}
+
+/*
+ * Find the cache line which holds the given block, filling the line from flash on a miss.
+ * Returns NULL if the line could not be filled.
+ */
+static OspiReadCacheLine_t * pxReadCacheLookup( const struct lfs_config * c,
+                                                lfs_block_t block )
+{
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) c->context;
+    OspiReadCacheLine_t * pxLine = &( xReadCache[ block % LFS_PORT_OSPI_READ_CACHE_LINES ] );
+
+    if( pxLine->xBlock != block )
+    {
+        uint32_t ulReadAddr = OPI_START_ADDRESS + ( block * c->block_size );
+
+        if( ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
+                           ulReadAddr,
+                           pxLine->ucData,
+                           c->block_size,
+                           pdMS_TO_TICKS( MX25LM_READ_TIMEOUT_MS ) ) == pdTRUE )
+        {
+            pxLine->xBlock = block;
+            pxCtx->xStats.ulCacheFills++;
+        }
+        else
+        {
+            pxLine->xBlock = LFS_PORT_OSPI_CACHE_INVALID;
+            pxLine = NULL;
+        }
+
+        LogDebug( "Read-ahead of block %lu, address 0x%010lX, success: %d", block, ulReadAddr, ( pxLine != NULL ) );
+    }
+
+    return pxLine;
+}
+
+/*
+ * Return the cache line holding the given block without filling it, or NULL if the block is not cached.
+ */
+static inline OspiReadCacheLine_t * pxReadCacheFind( lfs_block_t block )
+{
+    OspiReadCacheLine_t * pxLine = &( xReadCache[ block % LFS_PORT_OSPI_READ_CACHE_LINES ] );
+
+    return( pxLine->xBlock == block ? pxLine : NULL );
+}
+
+#endif /* LFS_PORT_OSPI_READ_CACHE_LINES > 0 */
+
 #ifdef LFS_NO_MALLOC
 static uint8_t __ALIGN_BEGIN ucReadBuffer[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
 static uint8_t __ALIGN_BEGIN ucProgBuffer[ CONFIG_SIZE_CACHE_BUFFER ] __ALIGN_END = { 0 };
@@ -115,6 +209,26 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
     pxCfg->metadata_max = 0;
 }
 
+/*
+ * Initialize the OSPI flash device and, if configured, switch it to memory mapped reads.
+ */
+static void vInitializeFlash( struct LfsPortCtx * pxCtx )
+{
+    BaseType_t xSuccess = ospi_Init( &( pxCtx->xOSPIHandle ) );
+
+    configASSERT( xSuccess == pdTRUE );
+
+    #if LFS_PORT_OSPI_MEM_MAPPED_READ == 1
+        xSuccess = ospi_EnableMemMappedMode( &( pxCtx->xOSPIHandle ),
+                                             pdMS_TO_TICKS( MX25LM_DEFAULT_TIMEOUT_MS ) );
+
+        if( xSuccess != pdTRUE )
+        {
+            LogError( "Failed to enable memory mapped mode. Falling back to indirect reads." );
+        }
+    #endif
+}
+
 #ifndef LFS_THREADSAFE
     #warning "Building littlefs with LFS_THREADSAFE is strongly suggested."
 #endif
@@ -129,13 +243,21 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
     {
         xLfsCfg.context = ( void * ) &xLfsCtx;
 
-        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &( &xMutexStatic ) );
+        xLfsCtx.xMutex = xSemaphoreCreateMutexStatic( &xMutexStatic );
         ( void ) xSemaphoreGive( xLfsCtx.xMutex );
         xLfsCtx.xBlockTime = xBlockTime;
 
         configASSERT( xLfsCtx.xMutex != NULL );
 
         vPopulateConfig( &xLfsCfg, &xLfsCtx );
+
+        #if LFS_PORT_OSPI_READ_CACHE_LINES > 0
+            vReadCacheInit();
+        #endif
+
+        vInitializeFlash( &xLfsCtx );
+
+        return &xLfsCfg;
     }
 #else /* ifdef LFS_NO_MALLOC */
 
@@ -154,6 +276,7 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
         configASSERT( pxCtx != NULL );
 
+        ( void ) memset( &( pxCtx->xStats ), 0, sizeof( LfsPortStats_t ) );
         pxCtx->xBlockTime = xBlockTime;
         pxCtx->xMutex = xSemaphoreCreateMutex();
 
@@ -162,9 +285,11 @@ static void vPopulateConfig( struct lfs_config * pxCfg,
 
         vPopulateConfig( pxCfg, pxCtx );
 
-        BaseType_t xSuccess = ospi_Init( &( pxCtx->xOSPIHandle ) );
+        #if LFS_PORT_OSPI_READ_CACHE_LINES > 0
+            vReadCacheInit();
+        #endif
 
-        configASSERT( xSuccess == pdTRUE );
+        vInitializeFlash( pxCtx );
 
         ( void ) xSemaphoreGive( pxCtx->xMutex );
 
@@ -198,14 +323,47 @@ static int lfs_port_read( const struct lfs_config * c,
 
     uint32_t ulReadAddr = OPI_START_ADDRESS + ( block * c->block_size ) + off;
 
-    if( ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
-                       ulReadAddr,
-                       pvBuffer,
-                       size,
-                       pdMS_TO_TICKS( MX25LM_READ_TIMEOUT_MS ) ) != pdTRUE )
+    BaseType_t xCachedRead = pdFALSE;
+
+    #if LFS_PORT_OSPI_READ_CACHE_LINES > 0
+        /* Whole block reads are streamed directly into the destination buffer */
+        if( size < c->block_size )
+        {
+            OspiReadCacheLine_t * pxLine = pxReadCacheLookup( c, block );
+
+            configASSERT( ( off + size ) <= c->block_size );
+
+            if( pxLine != NULL )
+            {
+                ( void ) memcpy( pvBuffer, &( pxLine->ucData[ off ] ), size );
+                pxCtx->xStats.ulCacheHits++;
+            }
+            else
+            {
+                lReturnValue = -1;
+            }
+
+            xCachedRead = pdTRUE;
+        }
+    #endif /* LFS_PORT_OSPI_READ_CACHE_LINES > 0 */
+
+    if( xCachedRead == pdTRUE )
+    {
+        /* Serviced from the read-ahead cache */
+    }
+    else if( ospi_ReadAddr( &( pxCtx->xOSPIHandle ),
+                            ulReadAddr,
+                            pvBuffer,
+                            size,
+                            pdMS_TO_TICKS( MX25LM_READ_TIMEOUT_MS ) ) != pdTRUE )
     {
         lReturnValue = -1;
     }
+    else
+    {
+        pxCtx->xStats.ulReadOps++;
+        pxCtx->xStats.ulReadBytes += size;
+    }
 
     LogDebug( "Reading address 0x%010lX, size: %lu, rv: %ld", ulReadAddr, size, lReturnValue );
 
@@ -234,25 +392,42 @@ static int lfs_port_prog( const struct lfs_config * pxCfg,
     /* Determine the 4-byte write address */
     uint32_t ulStartAddr = OPI_START_ADDRESS + ( block * pxCfg->block_size ) + off;
 
-    uint32_t ulLastAddr = ulStartAddr + size - MX25LM_PROGRAM_FIFO_LEN;
+    if( ospi_ProgramPages( &( pxCtx->xOSPIHandle ),
+                           ulStartAddr,
+                           pvBuffer,
+                           size,
+                           pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) ) != pdTRUE )
+    {
+        lReturnValue = -1;
+    }
+    else
+    {
+        pxCtx->xStats.ulProgOps++;
+        pxCtx->xStats.ulProgBytes += size;
+    }
 
-    LogDebug( "Programming Start Addr: 0x%010lX, End Addr: 0x%010lX, size: %lu, block: %lu, offset: %lu, rv: %ld",
-              ulStartAddr, ulLastAddr, size, block, off, lReturnValue );
+    LogDebug( "Programming Start Addr: 0x%010lX, size: %lu, block: %lu, offset: %lu, rv: %ld",
+              ulStartAddr, size, block, off, lReturnValue );
 
-    for( uint32_t ulWriteAddr = ulStartAddr; ulWriteAddr <= ulLastAddr; ulWriteAddr += MX25LM_PROGRAM_FIFO_LEN )
+    #if LFS_PORT_OSPI_READ_CACHE_LINES > 0
     {
-        LogDebug( "Writing block at addr: 0x%010lX, len: %lu", ulWriteAddr, MX25LM_PROGRAM_FIFO_LEN );
+        /* littlefs only programs erased regions, so a cached copy of the block can be updated in place */
+        OspiReadCacheLine_t * pxLine = pxReadCacheFind( block );
 
-        if( ospi_WriteAddr( &( pxCtx->xOSPIHandle ),
-                            ulWriteAddr,
-                            &( ( ( uint8_t * ) pvBuffer )[ ulWriteAddr - ulStartAddr ] ),
-                            MX25LM_PROGRAM_FIFO_LEN,
-                            pdMS_TO_TICKS( MX25LM_WRITE_TIMEOUT_MS ) ) != pdTRUE )
+        if( pxLine == NULL )
         {
-            lReturnValue = -1;
-            break;
+            /* Block is not cached */
+        }
+        else if( lReturnValue == 0 )
+        {
+            ( void ) memcpy( &( pxLine->ucData[ off ] ), pvBuffer, size );
+        }
+        else
+        {
+            pxLine->xBlock = LFS_PORT_OSPI_CACHE_INVALID;
         }
     }
+    #endif /* LFS_PORT_OSPI_READ_CACHE_LINES > 0 */
 
     return lReturnValue;
 }
@@ -271,6 +446,17 @@ static int lfs_port_erase( const struct lfs_config * pxCfg,
 
     LogDebug( "Starting erase operation addr: 0x%010lX ", ulEraseAddr );
 
+    #if LFS_PORT_OSPI_READ_CACHE_LINES > 0
+    {
+        OspiReadCacheLine_t * pxLine = pxReadCacheFind( block );
+
+        if( pxLine != NULL )
+        {
+            pxLine->xBlock = LFS_PORT_OSPI_CACHE_INVALID;
+        }
+    }
+    #endif /* LFS_PORT_OSPI_READ_CACHE_LINES > 0 */
+
     if( ospi_EraseSector( &( pxCtx->xOSPIHandle ),
                           ulEraseAddr,
                           pdMS_TO_TICKS( MX25LM_ERASE_TIMEOUT_MS ) ) != pdTRUE )
@@ -278,6 +464,8 @@ static int lfs_port_erase( const struct lfs_config * pxCfg,
         lReturnValue = -1;
     }
 
+    pxCtx->xStats.ulEraseOps++;
+
     LogDebug( "Erase operation completed. Address: 0x%010lX Return Value: %ld", ulEraseAddr, lReturnValue );
 
     return lReturnValue;
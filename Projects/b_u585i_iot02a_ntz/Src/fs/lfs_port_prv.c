@@ -28,6 +28,8 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 
+#include <string.h>
+
 #include "lfs_util.h"
 #include "lfs.h"
 #include "lfs_port_prv.h"
@@ -52,6 +54,26 @@ int lfs_port_unlock( const struct lfs_config * c )
     return ( int ) ( xReturnVal == pdTRUE ? 0 : -1 );
 }
 
+void vLfsPortGetStats( const struct lfs_config * pxCfg,
+                       LfsPortStats_t * pxStats )
+{
+    configASSERT( pxCfg != NULL );
+    configASSERT( pxStats != NULL );
+
+    struct LfsPortCtx * pxCtx = ( struct LfsPortCtx * ) pxCfg->context;
+
+    /* The counters are only updated by block device callbacks, which run with the lock held */
+    if( lfs_port_lock( pxCfg ) == 0 )
+    {
+        *pxStats = pxCtx->xStats;
+        ( void ) lfs_port_unlock( pxCfg );
+    }
+    else
+    {
+        ( void ) memset( pxStats, 0, sizeof( LfsPortStats_t ) );
+    }
+}
+
 /* The following function lfs_crc is derived from lfs_util.c and
  * is available under the following terms:
  * Copyright (c) 2017, Arm Limited. All rights reserved.
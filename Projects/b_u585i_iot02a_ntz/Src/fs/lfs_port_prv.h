@@ -29,12 +29,14 @@
 #include "semphr.h"
 
 #include "lfs.h"
+#include "lfs_port.h"
 
 struct LfsPortCtx
 {
     SemaphoreHandle_t xMutex;
     TickType_t xBlockTime;
     OSPI_HandleTypeDef xOSPIHandle;
+    LfsPortStats_t xStats;
 };
 
 int lfs_port_lock( const struct lfs_config * c );
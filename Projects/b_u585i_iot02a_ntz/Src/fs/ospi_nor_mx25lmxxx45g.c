@@ -31,12 +31,44 @@
 #include "logging.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "hw_defs.h"
+#include <string.h>
 
 #include "ospi_nor_mx25lmxxx45g.h"
 
 static TaskHandle_t xTaskHandle = NULL;
 static OSPI_HandleTypeDef * s_pxOSPI = NULL;
 
+/* Set while the flash is (or should be, outside of program / erase operations) mapped for reads */
+static BaseType_t xMemMappedEnabled = pdFALSE;
+static BaseType_t xMemMappedActive = pdFALSE;
+
+/*
+ * GPDMA channel used for OCTOSPI2 data transfers.
+ * Channels 12 through 15 have a 32 byte FIFO, allowing the DMA to keep up with the octal interface.
+ * The HAL reverses the transfer direction as needed, so a single channel serves both reads and writes.
+ */
+static DMA_HandleTypeDef xHndlGpdmaOspi =
+{
+    .Instance                  = GPDMA1_Channel12,
+    .Init                      =
+    {
+        .Request               = GPDMA1_REQUEST_OCTOSPI2,
+        .BlkHWRequest          = DMA_BREQ_SINGLE_BURST,
+        .Direction             = DMA_PERIPH_TO_MEMORY,
+        .SrcInc                = DMA_SINC_FIXED,
+        .DestInc               = DMA_DINC_INCREMENTED,
+        .SrcDataWidth          = DMA_SRC_DATAWIDTH_BYTE,
+        .DestDataWidth         = DMA_DEST_DATAWIDTH_BYTE,
+        .Priority              = DMA_LOW_PRIORITY_HIGH_WEIGHT,
+        .SrcBurstLength        = 1,
+        .DestBurstLength       = 1,
+        .TransferAllocatedPort = DMA_SRC_ALLOCATED_PORT0 | DMA_DEST_ALLOCATED_PORT1,
+        .TransferEventMode     = DMA_TCEM_BLOCK_TRANSFER,
+        .Mode                  = DMA_NORMAL,
+    },
+};
+
 static inline void ospi_HandleCallback( OSPI_HandleTypeDef * pxOSPI,
                                         HAL_OSPI_CallbackIDTypeDef xCallbackId )
 {
@@ -123,6 +155,13 @@ static void ospi_IRQHandler( void )
     HAL_OSPI_IRQHandler( s_pxOSPI );
 }
 
+static void ospi_DmaIRQHandler( void )
+{
+    configASSERT( s_pxOSPI != NULL );
+    configASSERT( s_pxOSPI->hdma != NULL );
+    HAL_DMA_IRQHandler( s_pxOSPI->hdma );
+}
+
 /* Initialize static variables for the current operation */
 static inline void ospi_OpInit( OSPI_HandleTypeDef * pxOSPI )
 {
@@ -136,8 +175,6 @@ static void ospi_MspInitCallback( OSPI_HandleTypeDef * pxOSPI )
     RCC_PeriphCLKInitTypeDef PeriphClkInit = { 0 };
     HAL_StatusTypeDef xHalStatus = HAL_OK;
 
-    ( void ) pxOSPI;
-
     PeriphClkInit.PeriphClockSelection = RCC_PERIPHCLK_OSPI;
     PeriphClkInit.OspiClockSelection = RCC_OSPICLKSOURCE_SYSCLK;
     xHalStatus = HAL_RCCEx_PeriphCLKConfig( &PeriphClkInit );
@@ -195,12 +232,35 @@ static void ospi_MspInitCallback( OSPI_HandleTypeDef * pxOSPI )
     /* OCTOSPI2 interrupt Init */
     HAL_NVIC_SetPriority( OCTOSPI2_IRQn, 5, 0 );
     HAL_NVIC_EnableIRQ( OCTOSPI2_IRQn );
+
+    /* Setup the DMA channel used for data transfers. Fall back to interrupt driven transfers on failure. */
+    __HAL_RCC_GPDMA1_CLK_ENABLE();
+
+    xHalStatus = HAL_DMA_Init( &xHndlGpdmaOspi );
+
+    if( xHalStatus == HAL_OK )
+    {
+        xHalStatus = HAL_DMA_ConfigChannelAttributes( &xHndlGpdmaOspi, DMA_CHANNEL_NPRIV );
+    }
+
+    if( xHalStatus == HAL_OK )
+    {
+        __HAL_LINKDMA( pxOSPI, hdma, xHndlGpdmaOspi );
+
+        NVIC_SetVector( GPDMA1_Channel12_IRQn, ( uint32_t ) ospi_DmaIRQHandler );
+
+        HAL_NVIC_SetPriority( GPDMA1_Channel12_IRQn, 5, 0 );
+        HAL_NVIC_EnableIRQ( GPDMA1_Channel12_IRQn );
+    }
+    else
+    {
+        LogError( "Error while configuring GPDMA channel for OSPI2." );
+        pxOSPI->hdma = NULL;
+    }
 }
 
 static void ospi_MspDeInitCallback( OSPI_HandleTypeDef * pxOSPI )
 {
-    ( void ) pxOSPI;
-
     __HAL_RCC_OSPI2_CLK_DISABLE();
 
     /**OCTOSPI2 GPIO Configuration
@@ -225,6 +285,13 @@ static void ospi_MspDeInitCallback( OSPI_HandleTypeDef * pxOSPI )
 
     /* OCTOSPI2 interrupt DeInit */
     HAL_NVIC_DisableIRQ( OCTOSPI2_IRQn );
+
+    if( pxOSPI->hdma != NULL )
+    {
+        HAL_NVIC_DisableIRQ( GPDMA1_Channel12_IRQn );
+        ( void ) HAL_DMA_DeInit( pxOSPI->hdma );
+        pxOSPI->hdma = NULL;
+    }
 }
 
 static BaseType_t ospi_InitDriver( OSPI_HandleTypeDef * pxOSPI )
@@ -632,6 +699,213 @@ static BaseType_t ospi_cmd_SPI_8BitSTRMode( OSPI_HandleTypeDef * pxOSPI,
 
 
 
+/*
+ * Configure the controller to issue 8READ commands for any access to the memory mapped window.
+ */
+static BaseType_t ospi_MemMappedEnter( OSPI_HandleTypeDef * pxOSPI,
+                                       TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    BaseType_t xSuccess = pdTRUE;
+
+    /* The HAL requires a write configuration as well, although writes through the window are not used. */
+    OSPI_RegularCmdTypeDef xCmd =
+    {
+        .OperationType      = HAL_OSPI_OPTYPE_WRITE_CFG,
+        .FlashId            = HAL_OSPI_FLASH_ID_1,
+
+        .Instruction        = MX25LM_OPI_PP,
+        .InstructionMode    = HAL_OSPI_INSTRUCTION_8_LINES, /* 8 line STR mode */
+        .InstructionSize    = HAL_OSPI_INSTRUCTION_16_BITS, /* 2 byte instructions */
+        .InstructionDtrMode = HAL_OSPI_INSTRUCTION_DTR_DISABLE,
+
+        .AddressMode        = HAL_OSPI_ADDRESS_8_LINES,
+        .AddressSize        = HAL_OSPI_ADDRESS_32_BITS,
+        .AddressDtrMode     = HAL_OSPI_DATA_DTR_DISABLE,
+
+        .AlternateBytesMode = HAL_OSPI_ALTERNATE_BYTES_NONE,
+
+        .DataMode           = HAL_OSPI_DATA_8_LINES,
+        .DataDtrMode        = HAL_OSPI_DATA_DTR_DISABLE,
+
+        .DummyCycles        = 0,
+        .DQSMode            = HAL_OSPI_DQS_ENABLE, /* Required for memory mapped writes */
+        .SIOOMode           = HAL_OSPI_SIOO_INST_EVERY_CMD,
+    };
+
+    OSPI_MemoryMappedTypeDef xMemMappedCfg =
+    {
+        .TimeOutActivation = HAL_OSPI_TIMEOUT_COUNTER_ENABLE,
+        .TimeOutPeriod     = 0x34,
+    };
+
+    /* Flash must be idle before it is read through the window */
+    xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                       MX25LM_REG_SR_WIP,
+                                       0x0,
+                                       xTimeout );
+
+    if( xSuccess == pdTRUE )
+    {
+        xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout );
+    }
+
+    if( ( xSuccess == pdTRUE ) &&
+        ( xHalStatus == HAL_OK ) )
+    {
+        xCmd.OperationType = HAL_OSPI_OPTYPE_READ_CFG;
+        xCmd.Instruction = MX25LM_OPI_8READ;
+        xCmd.DummyCycles = MX25LM_8READ_DUMMY_CYCLES;
+        xCmd.DQSMode = HAL_OSPI_DQS_DISABLE;
+
+        xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout );
+    }
+
+    if( ( xSuccess == pdTRUE ) &&
+        ( xHalStatus == HAL_OK ) )
+    {
+        xHalStatus = HAL_OSPI_MemoryMapped( pxOSPI, &xMemMappedCfg );
+    }
+
+    if( ( xSuccess != pdTRUE ) ||
+        ( xHalStatus != HAL_OK ) )
+    {
+        LogError( "Failed to enter memory mapped mode. xHalStatus: %d", xHalStatus );
+        ( void ) HAL_OSPI_Abort( pxOSPI );
+        xSuccess = pdFALSE;
+    }
+    else
+    {
+        xMemMappedActive = pdTRUE;
+    }
+
+    return xSuccess;
+}
+
+static BaseType_t ospi_MemMappedExit( OSPI_HandleTypeDef * pxOSPI )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    /* Aborting is the only way to leave memory mapped mode */
+    if( HAL_OSPI_Abort( pxOSPI ) != HAL_OK )
+    {
+        LogError( "Failed to exit memory mapped mode." );
+        xSuccess = pdFALSE;
+    }
+
+    xMemMappedActive = pdFALSE;
+
+    return xSuccess;
+}
+
+/*
+ * Switch to indirect mode ahead of a program or erase operation.
+ */
+static BaseType_t ospi_MemMappedSuspend( OSPI_HandleTypeDef * pxOSPI )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    if( xMemMappedActive == pdTRUE )
+    {
+        xSuccess = ospi_MemMappedExit( pxOSPI );
+    }
+
+    return xSuccess;
+}
+
+/*
+ * Drop any stale data cache lines covering the modified range and return to memory mapped mode if enabled.
+ */
+static BaseType_t ospi_MemMappedResume( OSPI_HandleTypeDef * pxOSPI,
+                                        uint32_t ulAddr,
+                                        uint32_t ulLen,
+                                        TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    if( ( xMemMappedEnabled == pdTRUE ) &&
+        ( xMemMappedActive == pdFALSE ) )
+    {
+        if( pxHndlDCache != NULL )
+        {
+            ( void ) HAL_DCACHE_InvalidateByAddr( pxHndlDCache,
+                                                  ( const uint32_t * ) ( MX25LM_MEM_MAPPED_BASE + ulAddr ),
+                                                  ulLen );
+        }
+
+        xSuccess = ospi_MemMappedEnter( pxOSPI, xTimeout );
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief Map the flash into the OCTOSPI2 address space for reads.
+ * Program and erase operations temporarily switch back to indirect mode.
+ */
+BaseType_t ospi_EnableMemMappedMode( OSPI_HandleTypeDef * pxOSPI,
+                                     TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( xMemMappedActive == pdFALSE )
+    {
+        if( pxHndlDCache != NULL )
+        {
+            ( void ) HAL_DCACHE_InvalidateByAddr( pxHndlDCache,
+                                                  ( const uint32_t * ) MX25LM_MEM_MAPPED_BASE,
+                                                  MX25LM_MEM_SZ_BYTES );
+        }
+
+        xSuccess = ospi_MemMappedEnter( pxOSPI, xTimeout );
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        xMemMappedEnabled = pdTRUE;
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief Return the flash to indirect mode for all operations.
+ */
+BaseType_t ospi_DisableMemMappedMode( OSPI_HandleTypeDef * pxOSPI )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    xMemMappedEnabled = pdFALSE;
+
+    if( xMemMappedActive == pdTRUE )
+    {
+        xSuccess = ospi_MemMappedExit( pxOSPI );
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief Return a pointer to the given flash address within the memory mapped window,
+ * or NULL if memory mapped mode is not active.
+ */
+const void * ospi_GetMemMappedAddr( uint32_t ulAddr )
+{
+    const void * pvAddr = NULL;
+
+    if( ( xMemMappedActive == pdTRUE ) &&
+        ( ulAddr < MX25LM_MEM_SZ_BYTES ) )
+    {
+        pvAddr = ( const void * ) ( MX25LM_MEM_MAPPED_BASE + ulAddr );
+    }
+
+    return pvAddr;
+}
+
 /*
  * @Brief Initialize octospi flash controller and related peripherals
  */
@@ -691,55 +965,35 @@ BaseType_t ospi_Init( OSPI_HandleTypeDef * pxOSPI )
     return xSuccess;
 }
 
-BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
-                          uint32_t ulAddr,
-                          void * pxBuffer,
-                          uint32_t ulBufferLen,
-                          TickType_t xTimeout )
+/*
+ * Read from the flash with an indirect mode 8READ command.
+ * The flash must be in indirect mode and the arguments already validated.
+ */
+static BaseType_t ospi_OPI_Read( OSPI_HandleTypeDef * pxOSPI,
+                                 uint32_t ulAddr,
+                                 void * pxBuffer,
+                                 uint32_t ulBufferLen,
+                                 TickType_t xTimeout )
 {
     HAL_StatusTypeDef xHalStatus = HAL_OK;
     BaseType_t xSuccess = pdTRUE;
 
-    ospi_OpInit( pxOSPI );
-
-    if( pxOSPI == NULL )
-    {
-        xSuccess = pdFALSE;
-        LogError( "pxOSPI is NULL." );
-    }
-
-    if( ulAddr >= MX25LM_MEM_SZ_BYTES )
-    {
-        xSuccess = pdFALSE;
-        LogError( "Address is out of range." );
-    }
-
-    if( pxBuffer == NULL )
+    if( xSuccess == pdTRUE )
     {
-        xSuccess = pdFALSE;
-        LogError( "pxBuffer is NULL." );
-    }
+        /* Wait for idle condition (WIP bit should be 0) */
+        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                           MX25LM_REG_SR_WIP,
+                                           0x0,
+                                           MX25LM_DEFAULT_TIMEOUT_MS );
 
-    if( ulBufferLen == 0 )
-    {
-        xSuccess = pdFALSE;
-        LogError( "ulBufferLen is 0." );
+        if( xSuccess != pdTRUE )
+        {
+            ospi_AbortTransaction( pxOSPI, MX25LM_DEFAULT_TIMEOUT_MS );
+            LogError( "Timed out while waiting for OSPI IDLE condition." );
+        }
     }
 
-    /*TODO is there a limit to the number of bytes read? */
-
-    /* Wait for idle condition (WIP bit should be 0) */
-    xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                       MX25LM_REG_SR_WIP,
-                                       0x0,
-                                       MX25LM_DEFAULT_TIMEOUT_MS );
-
-    if( xSuccess != pdTRUE )
-    {
-        ospi_AbortTransaction( pxOSPI, MX25LM_DEFAULT_TIMEOUT_MS );
-        LogError( "Timed out while waiting for OSPI IDLE condition." );
-    }
-    else
+    if( xSuccess == pdTRUE )
     {
         /* Setup an 8READ transaction */
         OSPI_RegularCmdTypeDef xCmd =
@@ -787,28 +1041,43 @@ BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
         /* Clear notification state */
         ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
 
-        xHalStatus = HAL_OSPI_Receive_IT( pxOSPI, pxBuffer );
+        /* Short reads are cheaper to service from the FIFO than to setup a DMA transfer for */
+        if( ( pxOSPI->hdma != NULL ) &&
+            ( ulBufferLen >= MX25LM_DMA_MIN_LEN ) )
+        {
+            xHalStatus = HAL_OSPI_Receive_DMA( pxOSPI, pxBuffer );
+        }
+        else
+        {
+            xHalStatus = HAL_OSPI_Receive_IT( pxOSPI, pxBuffer );
+        }
 
         /* Wait for receive op to complete */
         if( xHalStatus == HAL_OK )
         {
             xSuccess = ospi_WaitForCallback( HAL_OSPI_RX_CPLT_CB_ID, xTimeout );
         }
+        else
+        {
+            xSuccess = pdFALSE;
+        }
+
+        if( xSuccess != pdTRUE )
+        {
+            ospi_AbortTransaction( pxOSPI, MX25LM_DEFAULT_TIMEOUT_MS );
+            LogError( "Failed to receive data from OSPI." );
+        }
     }
 
     return( xSuccess );
 }
 
-/*
- * @Brief write up to 256 bytes to the given address.
- */
-BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
-                           uint32_t ulAddr,
-                           const void * pxBuffer,
-                           uint32_t ulBufferLen,
-                           TickType_t xTimeout )
+BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
+                          uint32_t ulAddr,
+                          void * pxBuffer,
+                          uint32_t ulBufferLen,
+                          TickType_t xTimeout )
 {
-    HAL_StatusTypeDef xHalStatus = HAL_OK;
     BaseType_t xSuccess = pdTRUE;
 
     ospi_OpInit( pxOSPI );
@@ -816,33 +1085,74 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
     if( pxOSPI == NULL )
     {
         xSuccess = pdFALSE;
+        LogError( "pxOSPI is NULL." );
     }
 
-    if( ( ulBufferLen > 256 ) ||
-        ( ulBufferLen == 0 ) )
+    if( ulAddr >= MX25LM_MEM_SZ_BYTES )
     {
         xSuccess = pdFALSE;
+        LogError( "Address is out of range." );
     }
 
     if( pxBuffer == NULL )
     {
         xSuccess = pdFALSE;
+        LogError( "pxBuffer is NULL." );
     }
 
-    if( xSuccess == pdTRUE )
+    if( ulBufferLen == 0 )
     {
-        /* Wait for idle condition (WIP bit should be 0) */
-        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WIP,
-                                           0x0,
-                                           xTimeout );
+        xSuccess = pdFALSE;
+        LogError( "ulBufferLen is 0." );
     }
 
-    if( xSuccess == pdTRUE )
+    /*TODO is there a limit to the number of bytes read? */
+
+    if( xSuccess != pdTRUE )
     {
-        /* Enable write */
-        xSuccess = ospi_cmd_OPI_WREN( pxOSPI, xTimeout );
+        /* Invalid arguments */
     }
+    else if( xMemMappedActive == pdTRUE )
+    {
+        const void * pvSrc = ospi_GetMemMappedAddr( ulAddr );
+
+        if( ( pvSrc == NULL ) ||
+            ( ( ulAddr + ulBufferLen ) > MX25LM_MEM_SZ_BYTES ) )
+        {
+            xSuccess = pdFALSE;
+            LogError( "Read extends past the end of the device." );
+        }
+        else
+        {
+            ( void ) memcpy( pxBuffer, pvSrc, ulBufferLen );
+        }
+    }
+    else
+    {
+        xSuccess = ospi_OPI_Read( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
+    }
+
+    return( xSuccess );
+}
+
+/*
+ * Program up to one page at the given address. The flash must be idle and in indirect mode.
+ * Returns once the program operation has completed, leaving the flash idle.
+ */
+static BaseType_t ospi_OPI_PageProgram( OSPI_HandleTypeDef * pxOSPI,
+                                        uint32_t ulAddr,
+                                        const void * pxBuffer,
+                                        uint32_t ulBufferLen,
+                                        TickType_t xTimeout )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_OK;
+    BaseType_t xSuccess = pdTRUE;
+
+    configASSERT( ulBufferLen <= MX25LM_PROGRAM_FIFO_LEN );
+    configASSERT( ( ( ulAddr % MX25LM_PROGRAM_FIFO_LEN ) + ulBufferLen ) <= MX25LM_PROGRAM_FIFO_LEN );
+
+    /* Enable write */
+    xSuccess = ospi_cmd_OPI_WREN( pxOSPI, xTimeout );
 
     /* Wait for Write Enable Latch */
     if( xSuccess == pdTRUE )
@@ -884,43 +1194,188 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
 
         /* Send command */
         xHalStatus = HAL_OSPI_Command( pxOSPI, &xCmd, xTimeout );
+
+        if( xHalStatus != HAL_OK )
+        {
+            xSuccess = pdFALSE;
+        }
     }
 
-    /* Clear notification state */
-    ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
+    if( xSuccess == pdTRUE )
+    {
+        /* Clear notification state */
+        ( void ) xTaskNotifyStateClearIndexed( NULL, 1 );
 
-    if( xHalStatus != HAL_OK )
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
+
+        if( ( pxOSPI->hdma != NULL ) &&
+            ( ulBufferLen >= MX25LM_DMA_MIN_LEN ) )
+        {
+            xHalStatus = HAL_OSPI_Transmit_DMA( pxOSPI, pxBuffer );
+        }
+        else
+        {
+            xHalStatus = HAL_OSPI_Transmit_IT( pxOSPI, pxBuffer );
+        }
+
+        #pragma GCC diagnostic pop
+
+        if( xHalStatus != HAL_OK )
+        {
+            xSuccess = pdFALSE;
+        }
+        else
+        {
+            xSuccess = ospi_WaitForCallback( HAL_OSPI_TX_CPLT_CB_ID, xTimeout );
+        }
+    }
+
+    if( xSuccess == pdTRUE )
     {
-        xSuccess = pdFALSE;
+        /* Auto-polling blocks on the status match interrupt, so there is no need to sleep first */
+        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                           MX25LM_REG_SR_WIP | MX25LM_REG_SR_WEL,
+                                           0x0,
+                                           xTimeout );
     }
     else
     {
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wdiscarded-qualifiers"
-        xHalStatus = HAL_OSPI_Transmit_IT( pxOSPI, pxBuffer );
-        #pragma GCC diagnostic pop
+        ospi_AbortTransaction( pxOSPI, xTimeout );
     }
 
-    if( xHalStatus != HAL_OK )
+    return xSuccess;
+}
+
+/*
+ * @Brief write up to 256 bytes to the given address.
+ */
+BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
+                           uint32_t ulAddr,
+                           const void * pxBuffer,
+                           uint32_t ulBufferLen,
+                           TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
     {
         xSuccess = pdFALSE;
     }
-    else
+
+    if( ( ulBufferLen > MX25LM_PROGRAM_FIFO_LEN ) ||
+        ( ulBufferLen == 0 ) )
     {
-        xSuccess = ospi_WaitForCallback( HAL_OSPI_TX_CPLT_CB_ID, xTimeout );
+        xSuccess = pdFALSE;
+    }
+
+    if( pxBuffer == NULL )
+    {
+        xSuccess = pdFALSE;
     }
 
     if( xSuccess == pdTRUE )
     {
-        vTaskDelay( 1 );
+        xSuccess = ospi_MemMappedSuspend( pxOSPI );
+    }
 
+    if( xSuccess == pdTRUE )
+    {
         /* Wait for idle condition (WIP bit should be 0) */
         xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
-                                           MX25LM_REG_SR_WIP | MX25LM_REG_SR_WEL,
+                                           MX25LM_REG_SR_WIP,
                                            0x0,
                                            xTimeout );
     }
 
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_OPI_PageProgram( pxOSPI, ulAddr, pxBuffer, ulBufferLen, xTimeout );
+    }
+
+    if( ospi_MemMappedResume( pxOSPI, ulAddr, ulBufferLen, xTimeout ) != pdTRUE )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    return xSuccess;
+}
+
+/*
+ * @Brief Program an arbitrary length buffer, splitting it on page boundaries.
+ * Each page is programmed back to back: the status poll which completes one page
+ * leaves the flash idle, so the next page's write enable and DMA transfer are issued
+ * immediately without an additional idle poll or scheduler delay.
+ */
+BaseType_t ospi_ProgramPages( OSPI_HandleTypeDef * pxOSPI,
+                              uint32_t ulAddr,
+                              const void * pxBuffer,
+                              uint32_t ulBufferLen,
+                              TickType_t xTimeout )
+{
+    BaseType_t xSuccess = pdTRUE;
+
+    ospi_OpInit( pxOSPI );
+
+    if( pxOSPI == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( ( ulBufferLen == 0 ) ||
+        ( ulAddr >= MX25LM_MEM_SZ_BYTES ) ||
+        ( ( ulAddr + ulBufferLen ) > MX25LM_MEM_SZ_BYTES ) )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( pxBuffer == NULL )
+    {
+        xSuccess = pdFALSE;
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_MemMappedSuspend( pxOSPI );
+    }
+
+    if( xSuccess == pdTRUE )
+    {
+        /* Wait for idle condition (WIP bit should be 0) */
+        xSuccess = ospi_OPI_WaitForStatus( pxOSPI,
+                                           MX25LM_REG_SR_WIP,
+                                           0x0,
+                                           xTimeout );
+    }
+
+    for( uint32_t ulOffset = 0; ( xSuccess == pdTRUE ) && ( ulOffset < ulBufferLen ); )
+    {
+        uint32_t ulPageAddr = ulAddr + ulOffset;
+
+        /* Do not cross a page boundary within a single program operation */
+        uint32_t ulChunkLen = MX25LM_PROGRAM_FIFO_LEN - ( ulPageAddr % MX25LM_PROGRAM_FIFO_LEN );
+
+        if( ulChunkLen > ( ulBufferLen - ulOffset ) )
+        {
+            ulChunkLen = ulBufferLen - ulOffset;
+        }
+
+        xSuccess = ospi_OPI_PageProgram( pxOSPI,
+                                         ulPageAddr,
+                                         &( ( ( const uint8_t * ) pxBuffer )[ ulOffset ] ),
+                                         ulChunkLen,
+                                         xTimeout );
+
+        ulOffset += ulChunkLen;
+    }
+
+    if( ospi_MemMappedResume( pxOSPI, ulAddr, ulBufferLen, xTimeout ) != pdTRUE )
+    {
+        xSuccess = pdFALSE;
+    }
+
     return xSuccess;
 }
 
@@ -944,6 +1399,11 @@ BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
         xSuccess = pdFALSE;
     }
 
+    if( xSuccess == pdTRUE )
+    {
+        xSuccess = ospi_MemMappedSuspend( pxOSPI );
+    }
+
     if( xSuccess == pdTRUE )
     {
         /* Wait for idle condition (WIP bit should be 0) */
@@ -1023,5 +1483,13 @@ BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
                                            xTimeout );
     }
 
+    if( ospi_MemMappedResume( pxOSPI,
+                              ulAddr & ~( MX25LM_SECTOR_SZ - 1 ),
+                              MX25LM_SECTOR_SZ,
+                              xTimeout ) != pdTRUE )
+    {
+        xSuccess = pdFALSE;
+    }
+
     return( xSuccess );
 }
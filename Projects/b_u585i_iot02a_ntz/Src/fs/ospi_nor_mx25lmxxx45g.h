@@ -49,9 +49,15 @@
 
 #define MX25LM_DEFAULT_TIMEOUT_MS    ( 1000 )
 
+/* Base of the OCTOSPI2 memory mapped window */
+#define MX25LM_MEM_MAPPED_BASE       ( OCTOSPI2_BASE )
+
 
 #define MX25LM_8READ_DUMMY_CYCLES    ( 20 )
 
+/* Transfers shorter than this are done with interrupts rather than DMA */
+#define MX25LM_DMA_MIN_LEN           ( 32 )
+
 /* SPI mode command codes */
 #define MX25LM_SPI_WREN              ( 0x06 )
 #define MX25LM_SPI_WRCR2             ( 0x72 )
@@ -86,6 +92,12 @@ BaseType_t ospi_WriteAddr( OSPI_HandleTypeDef * pxOSPI,
                            uint32_t ulBufferLen,
                            TickType_t xTimeout );
 
+BaseType_t ospi_ProgramPages( OSPI_HandleTypeDef * pxOSPI,
+                              uint32_t ulAddr,
+                              const void * pxBuffer,
+                              uint32_t ulBufferLen,
+                              TickType_t xTimeout );
+
 BaseType_t ospi_EraseSector( OSPI_HandleTypeDef * pxOSPI,
                              uint32_t ulAddr,
                              TickType_t xTimeout );
@@ -96,5 +108,12 @@ BaseType_t ospi_ReadAddr( OSPI_HandleTypeDef * pxOSPI,
                           uint32_t ulBufferLen,
                           TickType_t xTimeout );
 
+BaseType_t ospi_EnableMemMappedMode( OSPI_HandleTypeDef * pxOSPI,
+                                     TickType_t xTimeout );
+
+BaseType_t ospi_DisableMemMappedMode( OSPI_HandleTypeDef * pxOSPI );
+
+const void * ospi_GetMemMappedAddr( uint32_t ulAddr );
+
 
 #endif /* _OSPI_NOR_DRV */
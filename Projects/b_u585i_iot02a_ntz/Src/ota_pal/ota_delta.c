@@ -0,0 +1,372 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file ota_delta.c Streaming decoder for differential (delta) firmware images.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <string.h>
+
+#include "ota_delta.h"
+
+#include "mbedtls/md.h"
+#include "mbedtls_error_utils.h"
+
+#define VARINT_MAX_SHIFT            ( 28UL )
+#define VARINT_LAST_BYTE_INVALID    ( 0xF0U )
+
+static uint32_t prvReadU32LE( const uint8_t * pucBuf )
+{
+    return ( ( uint32_t ) pucBuf[ 0 ] ) |
+           ( ( uint32_t ) pucBuf[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucBuf[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucBuf[ 3 ] << 24 );
+}
+
+static void prvFail( OtaDeltaCtx_t * pxCtx,
+                     OtaDeltaStatus_t xStatus )
+{
+    pxCtx->xState = OTA_DELTA_STATE_ERROR;
+    pxCtx->xStatus = xStatus;
+}
+
+static OtaDeltaStatus_t prvParseHeader( OtaDeltaCtx_t * pxCtx )
+{
+    OtaDeltaStatus_t xStatus = OTA_DELTA_OK;
+    const uint8_t * pucHeader = pxCtx->ucHeader;
+
+    pxCtx->ulSourceSize = prvReadU32LE( &pucHeader[ 8 ] );
+    pxCtx->ulTargetSize = prvReadU32LE( &pucHeader[ 12 ] );
+
+    if( ( memcmp( pucHeader, OTA_DELTA_MAGIC, 4 ) != 0 ) ||
+        ( prvReadU32LE( &pucHeader[ 4 ] ) != OTA_DELTA_VERSION ) )
+    {
+        LogError( "Delta image header is not valid." );
+        xStatus = OTA_DELTA_ERR_FORMAT;
+    }
+    else if( ( pxCtx->ulSourceSize == 0 ) ||
+             ( pxCtx->ulSourceSize > pxCtx->uxSourceMaxLen ) ||
+             ( pxCtx->ulTargetSize == 0 ) ||
+             ( pxCtx->ulTargetSize > pxCtx->uxTargetMaxLen ) )
+    {
+        LogError( "Delta image sizes are out of range. source: %lu, target: %lu",
+                  pxCtx->ulSourceSize, pxCtx->ulTargetSize );
+        xStatus = OTA_DELTA_ERR_BOUNDS;
+    }
+    else
+    {
+        uint8_t ucSourceHash[ OTA_DELTA_HASH_LEN ];
+        int lRslt = mbedtls_md( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ),
+                                pxCtx->pucSource, pxCtx->ulSourceSize, ucSourceHash );
+
+        MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to hash the delta source image." );
+
+        if( ( lRslt != 0 ) ||
+            ( memcmp( ucSourceHash, &pucHeader[ 16 ], OTA_DELTA_HASH_LEN ) != 0 ) )
+        {
+            LogError( "Delta image was not generated against the running image." );
+            xStatus = OTA_DELTA_ERR_SOURCE;
+        }
+        else
+        {
+            ( void ) memcpy( pxCtx->ucTargetHash, &pucHeader[ 16 + OTA_DELTA_HASH_LEN ], OTA_DELTA_HASH_LEN );
+
+            LogInfo( "Delta image: source %lu bytes, target %lu bytes.",
+                     pxCtx->ulSourceSize, pxCtx->ulTargetSize );
+        }
+    }
+
+    return xStatus;
+}
+
+/* Accumulate one byte of an LEB128 varint. Returns pdTRUE when the value is complete.
+ * The fifth byte may only carry the top four bits of a uint32_t and must end the varint. */
+static BaseType_t prvVarintPush( OtaDeltaCtx_t * pxCtx,
+                                 uint8_t ucByte,
+                                 BaseType_t * pxOverflow )
+{
+    BaseType_t xComplete = pdFALSE;
+
+    *pxOverflow = pdFALSE;
+
+    if( ( pxCtx->ulVarintShift > VARINT_MAX_SHIFT ) ||
+        ( ( pxCtx->ulVarintShift == VARINT_MAX_SHIFT ) &&
+          ( ( ucByte & VARINT_LAST_BYTE_INVALID ) != 0 ) ) )
+    {
+        *pxOverflow = pdTRUE;
+    }
+    else
+    {
+        pxCtx->ulVarint |= ( ( uint32_t ) ( ucByte & 0x7FU ) ) << pxCtx->ulVarintShift;
+        pxCtx->ulVarintShift += 7UL;
+
+        xComplete = ( ( ucByte & 0x80U ) == 0 ) ? pdTRUE : pdFALSE;
+    }
+
+    return xComplete;
+}
+
+static void prvVarintReset( OtaDeltaCtx_t * pxCtx )
+{
+    pxCtx->ulVarint = 0;
+    pxCtx->ulVarintShift = 0;
+}
+
+static void prvOperationDone( OtaDeltaCtx_t * pxCtx )
+{
+    if( pxCtx->ulOutputLen == pxCtx->ulTargetSize )
+    {
+        pxCtx->xState = OTA_DELTA_STATE_DONE;
+    }
+    else
+    {
+        pxCtx->xState = OTA_DELTA_STATE_OPCODE;
+    }
+}
+
+static OtaDeltaStatus_t prvCheckLength( OtaDeltaCtx_t * pxCtx,
+                                        uint32_t ulLength )
+{
+    OtaDeltaStatus_t xStatus = OTA_DELTA_OK;
+
+    if( ulLength == 0 )
+    {
+        xStatus = OTA_DELTA_ERR_FORMAT;
+    }
+    else if( ulLength > ( pxCtx->ulTargetSize - pxCtx->ulOutputLen ) )
+    {
+        xStatus = OTA_DELTA_ERR_BOUNDS;
+    }
+
+    return xStatus;
+}
+
+static OtaDeltaStatus_t prvApplyCopy( OtaDeltaCtx_t * pxCtx,
+                                      uint32_t ulLength )
+{
+    OtaDeltaStatus_t xStatus = prvCheckLength( pxCtx, ulLength );
+    int64_t llPos = ( int64_t ) pxCtx->ulSourcePos + pxCtx->lCopyOffset;
+
+    if( xStatus != OTA_DELTA_OK )
+    {
+        /* Empty */
+    }
+    else if( ( llPos < 0 ) ||
+             ( ( llPos + ulLength ) > ( int64_t ) pxCtx->ulSourceSize ) )
+    {
+        xStatus = OTA_DELTA_ERR_BOUNDS;
+    }
+    else if( pxCtx->xWriteFn( pxCtx->pvWriteCtx, &( pxCtx->pucSource[ llPos ] ), ulLength ) != pdTRUE )
+    {
+        xStatus = OTA_DELTA_ERR_WRITE;
+    }
+    else
+    {
+        pxCtx->ulSourcePos = ( uint32_t ) llPos + ulLength;
+        pxCtx->ulOutputLen += ulLength;
+        prvOperationDone( pxCtx );
+    }
+
+    return xStatus;
+}
+
+void vOtaDeltaInit( OtaDeltaCtx_t * pxCtx,
+                    const uint8_t * pucSource,
+                    size_t uxSourceMaxLen,
+                    size_t uxTargetMaxLen,
+                    OtaDeltaWriteFn_t xWriteFn,
+                    void * pvWriteCtx )
+{
+    configASSERT( pxCtx != NULL );
+    configASSERT( pucSource != NULL );
+    configASSERT( xWriteFn != NULL );
+
+    ( void ) memset( pxCtx, 0, sizeof( OtaDeltaCtx_t ) );
+
+    pxCtx->xState = OTA_DELTA_STATE_HEADER;
+    pxCtx->xStatus = OTA_DELTA_OK;
+    pxCtx->pucSource = pucSource;
+    pxCtx->uxSourceMaxLen = uxSourceMaxLen;
+    pxCtx->uxTargetMaxLen = uxTargetMaxLen;
+    pxCtx->xWriteFn = xWriteFn;
+    pxCtx->pvWriteCtx = pvWriteCtx;
+}
+
+OtaDeltaStatus_t xOtaDeltaFeed( OtaDeltaCtx_t * pxCtx,
+                                const uint8_t * pucData,
+                                size_t uxLength )
+{
+    OtaDeltaStatus_t xStatus;
+
+    configASSERT( pxCtx != NULL );
+    configASSERT( ( pucData != NULL ) || ( uxLength == 0 ) );
+
+    xStatus = pxCtx->xStatus;
+
+    while( ( uxLength > 0 ) && ( xStatus == OTA_DELTA_OK ) )
+    {
+        BaseType_t xOverflow = pdFALSE;
+
+        switch( pxCtx->xState )
+        {
+            case OTA_DELTA_STATE_HEADER:
+               {
+                   size_t uxChunk = OTA_DELTA_HEADER_LEN - pxCtx->uxHeaderLen;
+
+                   uxChunk = ( uxChunk < uxLength ) ? uxChunk : uxLength;
+
+                   ( void ) memcpy( &( pxCtx->ucHeader[ pxCtx->uxHeaderLen ] ), pucData, uxChunk );
+                   pxCtx->uxHeaderLen += uxChunk;
+                   pucData += uxChunk;
+                   uxLength -= uxChunk;
+
+                   if( pxCtx->uxHeaderLen == OTA_DELTA_HEADER_LEN )
+                   {
+                       xStatus = prvParseHeader( pxCtx );
+                       pxCtx->xState = OTA_DELTA_STATE_OPCODE;
+                   }
+
+                   break;
+               }
+
+            case OTA_DELTA_STATE_OPCODE:
+                prvVarintReset( pxCtx );
+
+                if( *pucData == OTA_DELTA_OP_COPY )
+                {
+                    pxCtx->xState = OTA_DELTA_STATE_COPY_OFFSET;
+                }
+                else if( *pucData == OTA_DELTA_OP_INSERT )
+                {
+                    pxCtx->xState = OTA_DELTA_STATE_INSERT_LENGTH;
+                }
+                else
+                {
+                    LogError( "Unknown delta operation 0x%02X at output offset %lu.", *pucData, pxCtx->ulOutputLen );
+                    xStatus = OTA_DELTA_ERR_FORMAT;
+                }
+
+                pucData++;
+                uxLength--;
+                break;
+
+            case OTA_DELTA_STATE_COPY_OFFSET:
+
+                if( prvVarintPush( pxCtx, *pucData, &xOverflow ) == pdTRUE )
+                {
+                    /* Zigzag decode */
+                    pxCtx->lCopyOffset = ( int32_t ) ( pxCtx->ulVarint >> 1 ) ^ -( int32_t ) ( pxCtx->ulVarint & 1UL );
+                    prvVarintReset( pxCtx );
+                    pxCtx->xState = OTA_DELTA_STATE_COPY_LENGTH;
+                }
+
+                pucData++;
+                uxLength--;
+                break;
+
+            case OTA_DELTA_STATE_COPY_LENGTH:
+
+                if( prvVarintPush( pxCtx, *pucData, &xOverflow ) == pdTRUE )
+                {
+                    xStatus = prvApplyCopy( pxCtx, pxCtx->ulVarint );
+                }
+
+                pucData++;
+                uxLength--;
+                break;
+
+            case OTA_DELTA_STATE_INSERT_LENGTH:
+
+                if( prvVarintPush( pxCtx, *pucData, &xOverflow ) == pdTRUE )
+                {
+                    xStatus = prvCheckLength( pxCtx, pxCtx->ulVarint );
+                    pxCtx->ulRemaining = pxCtx->ulVarint;
+                    pxCtx->xState = OTA_DELTA_STATE_INSERT_DATA;
+                }
+
+                pucData++;
+                uxLength--;
+                break;
+
+            case OTA_DELTA_STATE_INSERT_DATA:
+               {
+                   size_t uxChunk = ( pxCtx->ulRemaining < uxLength ) ? pxCtx->ulRemaining : uxLength;
+
+                   if( pxCtx->xWriteFn( pxCtx->pvWriteCtx, pucData, uxChunk ) != pdTRUE )
+                   {
+                       xStatus = OTA_DELTA_ERR_WRITE;
+                   }
+                   else
+                   {
+                       pxCtx->ulRemaining -= uxChunk;
+                       pxCtx->ulOutputLen += uxChunk;
+                       pucData += uxChunk;
+                       uxLength -= uxChunk;
+
+                       if( pxCtx->ulRemaining == 0 )
+                       {
+                           prvOperationDone( pxCtx );
+                       }
+                   }
+
+                   break;
+               }
+
+            case OTA_DELTA_STATE_DONE:
+                LogError( "Delta image has %lu trailing bytes.", ( uint32_t ) uxLength );
+                xStatus = OTA_DELTA_ERR_FORMAT;
+                break;
+
+            case OTA_DELTA_STATE_ERROR:
+            default:
+                xStatus = OTA_DELTA_ERR_FORMAT;
+                break;
+        }
+
+        if( xOverflow == pdTRUE )
+        {
+            xStatus = OTA_DELTA_ERR_FORMAT;
+        }
+    }
+
+    if( xStatus != OTA_DELTA_OK )
+    {
+        prvFail( pxCtx, xStatus );
+    }
+
+    return xStatus;
+}
+
+BaseType_t xOtaDeltaIsComplete( const OtaDeltaCtx_t * pxCtx )
+{
+    return ( pxCtx->xState == OTA_DELTA_STATE_DONE ) ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,139 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file ota_delta.h Streaming decoder for differential (delta) firmware images.
+ *
+ * A delta image describes the new firmware as a sequence of operations against
+ * the image in the running bank:
+ *
+ *  Header (80 bytes, little endian):
+ *      magic "OTAD", version, source size, target size,
+ *      SHA-256 of the source image, SHA-256 of the target image.
+ *  Operations, repeated until target size bytes have been produced:
+ *      0x01 COPY   <zigzag varint: source offset relative to the end of the previous copy> <varint: length>
+ *      0x02 INSERT <varint: length> <length literal bytes>
+ *
+ * Patches are produced by tools/ota_delta.py. The decoder consumes the patch in
+ * arbitrary sized pieces and emits the reconstructed image through a callback,
+ * so RAM usage is bounded by the header regardless of the image size.
+ */
+
+#ifndef _OTA_DELTA_H
+#define _OTA_DELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+
+#define OTA_DELTA_MAGIC          "OTAD"
+#define OTA_DELTA_VERSION        ( 1UL )
+#define OTA_DELTA_HASH_LEN       ( 32UL )
+#define OTA_DELTA_HEADER_LEN     ( 16UL + ( 2UL * OTA_DELTA_HASH_LEN ) )
+
+#define OTA_DELTA_OP_COPY        ( 0x01U )
+#define OTA_DELTA_OP_INSERT      ( 0x02U )
+
+typedef enum
+{
+    OTA_DELTA_OK = 0,
+    OTA_DELTA_ERR_FORMAT,   /* Malformed header or operation */
+    OTA_DELTA_ERR_SOURCE,   /* Patch was not generated against the running image */
+    OTA_DELTA_ERR_BOUNDS,   /* Operation reads or writes outside of the images */
+    OTA_DELTA_ERR_WRITE     /* Output callback failed */
+} OtaDeltaStatus_t;
+
+typedef enum
+{
+    OTA_DELTA_STATE_HEADER = 0,
+    OTA_DELTA_STATE_OPCODE,
+    OTA_DELTA_STATE_COPY_OFFSET,
+    OTA_DELTA_STATE_COPY_LENGTH,
+    OTA_DELTA_STATE_INSERT_LENGTH,
+    OTA_DELTA_STATE_INSERT_DATA,
+    OTA_DELTA_STATE_DONE,
+    OTA_DELTA_STATE_ERROR
+} OtaDeltaState_t;
+
+/* Consume uxLength bytes of reconstructed image. Returns pdTRUE on success. */
+typedef BaseType_t ( * OtaDeltaWriteFn_t )( void * pvWriteCtx,
+                                            const uint8_t * pucData,
+                                            size_t uxLength );
+
+typedef struct OtaDeltaCtx
+{
+    OtaDeltaState_t xState;
+    OtaDeltaStatus_t xStatus;
+
+    const uint8_t * pucSource;
+    size_t uxSourceMaxLen;
+    size_t uxTargetMaxLen;
+
+    OtaDeltaWriteFn_t xWriteFn;
+    void * pvWriteCtx;
+
+    uint8_t ucHeader[ OTA_DELTA_HEADER_LEN ];
+    size_t uxHeaderLen;
+
+    uint32_t ulSourceSize;
+    uint32_t ulTargetSize;
+    uint8_t ucTargetHash[ OTA_DELTA_HASH_LEN ];
+
+    uint32_t ulVarint;
+    uint32_t ulVarintShift;
+    int32_t lCopyOffset;
+
+    uint32_t ulSourcePos;  /* Source position following the previous copy */
+    uint32_t ulRemaining;  /* Bytes left in the current operation */
+    uint32_t ulOutputLen;  /* Bytes of target image produced so far */
+} OtaDeltaCtx_t;
+
+/**
+ * Prepare a decoder for a patch against the image at pucSource.
+ * uxSourceMaxLen and uxTargetMaxLen bound the sizes a patch header may declare.
+ */
+void vOtaDeltaInit( OtaDeltaCtx_t * pxCtx,
+                    const uint8_t * pucSource,
+                    size_t uxSourceMaxLen,
+                    size_t uxTargetMaxLen,
+                    OtaDeltaWriteFn_t xWriteFn,
+                    void * pvWriteCtx );
+
+/**
+ * Feed the next uxLength bytes of the patch to the decoder.
+ * Once an error is returned, every following call returns the same error.
+ */
+OtaDeltaStatus_t xOtaDeltaFeed( OtaDeltaCtx_t * pxCtx,
+                                const uint8_t * pucData,
+                                size_t uxLength );
+
+/* Returns pdTRUE once the whole target image has been produced */
+BaseType_t xOtaDeltaIsComplete( const OtaDeltaCtx_t * pxCtx );
+
+#endif /* _OTA_DELTA_H */
@@ -0,0 +1,654 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file ota_lz4.c Streaming decoder for LZ4 compressed firmware images.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <string.h>
+
+#include "ota_lz4.h"
+
+#define LZ4_FLG_VERSION_MASK      ( 0xC0U )
+#define LZ4_FLG_VERSION           ( 0x40U )
+#define LZ4_FLG_BLOCK_CHECKSUM    ( 0x10U )
+#define LZ4_FLG_CONTENT_SIZE      ( 0x08U )
+#define LZ4_FLG_CONTENT_CHECKSUM  ( 0x04U )
+#define LZ4_FLG_RESERVED          ( 0x02U )
+#define LZ4_FLG_DICT_ID           ( 0x01U )
+
+#define LZ4_BD_RESERVED           ( 0x8FU )
+#define LZ4_BD_MAX_SIZE_MIN       ( 4U )
+
+#define LZ4_BLOCK_UNCOMPRESSED    ( 0x80000000UL )
+#define LZ4_BLOCK_MAX_SIZE        ( 4UL * 1024UL * 1024UL )
+
+#define LZ4_MIN_MATCH             ( 4UL )
+#define LZ4_LENGTH_EXTENDED       ( 15UL )
+
+/* Size of the stack buffer used to copy matches out of the decompressed image */
+#define LZ4_COPY_CHUNK_LEN        ( 32UL )
+
+#define XXH32_PRIME1              ( ( uint32_t ) 2654435761UL )
+#define XXH32_PRIME2              ( ( uint32_t ) 2246822519UL )
+#define XXH32_PRIME3              ( ( uint32_t ) 3266489917UL )
+#define XXH32_PRIME4              ( ( uint32_t ) 668265263UL )
+#define XXH32_PRIME5              ( ( uint32_t ) 374761393UL )
+
+static uint32_t prvReadU32LE( const uint8_t * pucBuf )
+{
+    return ( ( uint32_t ) pucBuf[ 0 ] ) |
+           ( ( uint32_t ) pucBuf[ 1 ] << 8 ) |
+           ( ( uint32_t ) pucBuf[ 2 ] << 16 ) |
+           ( ( uint32_t ) pucBuf[ 3 ] << 24 );
+}
+
+static inline uint32_t prvRotl32( uint32_t ulValue,
+                                  uint32_t ulCount )
+{
+    return ( ulValue << ulCount ) | ( ulValue >> ( 32U - ulCount ) );
+}
+
+static inline uint32_t prvXxh32Round( uint32_t ulAcc,
+                                      uint32_t ulInput )
+{
+    ulAcc += ulInput * XXH32_PRIME2;
+    ulAcc = prvRotl32( ulAcc, 13 );
+
+    return ulAcc * XXH32_PRIME1;
+}
+
+/* Start an xxHash32 with a seed of 0, as used by every LZ4 frame checksum */
+static void prvXxh32Reset( OtaLz4Xxh32_t * pxHash )
+{
+    pxHash->ulAcc[ 0 ] = XXH32_PRIME1 + XXH32_PRIME2;
+    pxHash->ulAcc[ 1 ] = XXH32_PRIME2;
+    pxHash->ulAcc[ 2 ] = 0;
+    pxHash->ulAcc[ 3 ] = 0 - XXH32_PRIME1;
+    pxHash->ulTotalLen = 0;
+    pxHash->uxStripeLen = 0;
+}
+
+static void prvXxh32Update( OtaLz4Xxh32_t * pxHash,
+                            const uint8_t * pucData,
+                            size_t uxLength )
+{
+    pxHash->ulTotalLen += ( uint32_t ) uxLength;
+
+    while( uxLength > 0 )
+    {
+        size_t uxChunk = sizeof( pxHash->ucStripe ) - pxHash->uxStripeLen;
+
+        uxChunk = ( uxChunk < uxLength ) ? uxChunk : uxLength;
+
+        ( void ) memcpy( &( pxHash->ucStripe[ pxHash->uxStripeLen ] ), pucData, uxChunk );
+        pxHash->uxStripeLen += uxChunk;
+        pucData += uxChunk;
+        uxLength -= uxChunk;
+
+        if( pxHash->uxStripeLen == sizeof( pxHash->ucStripe ) )
+        {
+            for( uint32_t i = 0; i < 4; i++ )
+            {
+                pxHash->ulAcc[ i ] = prvXxh32Round( pxHash->ulAcc[ i ], prvReadU32LE( &( pxHash->ucStripe[ i * 4 ] ) ) );
+            }
+
+            pxHash->uxStripeLen = 0;
+        }
+    }
+}
+
+static uint32_t prvXxh32Digest( const OtaLz4Xxh32_t * pxHash )
+{
+    uint32_t ulHash;
+    size_t uxPos = 0;
+
+    if( pxHash->ulTotalLen >= sizeof( pxHash->ucStripe ) )
+    {
+        ulHash = prvRotl32( pxHash->ulAcc[ 0 ], 1 ) + prvRotl32( pxHash->ulAcc[ 1 ], 7 ) +
+                 prvRotl32( pxHash->ulAcc[ 2 ], 12 ) + prvRotl32( pxHash->ulAcc[ 3 ], 18 );
+    }
+    else
+    {
+        ulHash = XXH32_PRIME5;
+    }
+
+    ulHash += pxHash->ulTotalLen;
+
+    for( ; ( uxPos + 4 ) <= pxHash->uxStripeLen; uxPos += 4 )
+    {
+        ulHash += prvReadU32LE( &( pxHash->ucStripe[ uxPos ] ) ) * XXH32_PRIME3;
+        ulHash = prvRotl32( ulHash, 17 ) * XXH32_PRIME4;
+    }
+
+    for( ; uxPos < pxHash->uxStripeLen; uxPos++ )
+    {
+        ulHash += pxHash->ucStripe[ uxPos ] * XXH32_PRIME5;
+        ulHash = prvRotl32( ulHash, 11 ) * XXH32_PRIME1;
+    }
+
+    ulHash ^= ulHash >> 15;
+    ulHash *= XXH32_PRIME2;
+    ulHash ^= ulHash >> 13;
+    ulHash *= XXH32_PRIME3;
+    ulHash ^= ulHash >> 16;
+
+    return ulHash;
+}
+
+static inline BaseType_t xIsBlockState( OtaLz4State_t xState )
+{
+    return ( ( xState == OTA_LZ4_STATE_BLOCK_RAW ) ||
+             ( xState == OTA_LZ4_STATE_TOKEN ) ||
+             ( xState == OTA_LZ4_STATE_LITERAL_LENGTH ) ||
+             ( xState == OTA_LZ4_STATE_LITERALS ) ||
+             ( xState == OTA_LZ4_STATE_OFFSET ) ||
+             ( xState == OTA_LZ4_STATE_MATCH_LENGTH ) ) ? pdTRUE : pdFALSE;
+}
+
+/* Compare a received checksum field with the digest of the data it covers */
+static OtaLz4Status_t prvCheckHash( const OtaLz4Ctx_t * pxCtx,
+                                    const OtaLz4Xxh32_t * pxHash,
+                                    const char * pcName )
+{
+    OtaLz4Status_t xStatus = OTA_LZ4_OK;
+    uint32_t ulExpected = prvReadU32LE( pxCtx->ucField );
+    uint32_t ulActual = prvXxh32Digest( pxHash );
+
+    if( ulActual != ulExpected )
+    {
+        LogError( "LZ4 %s checksum mismatch: expected 0x%08lX, calculated 0x%08lX.", pcName, ulExpected, ulActual );
+        xStatus = OTA_LZ4_ERR_CHECKSUM;
+    }
+
+    return xStatus;
+}
+
+static void prvExpectField( OtaLz4Ctx_t * pxCtx,
+                            OtaLz4State_t xState,
+                            size_t uxLength )
+{
+    pxCtx->xState = xState;
+    pxCtx->uxFieldLen = 0;
+    pxCtx->uxFieldNeed = uxLength;
+}
+
+static OtaLz4Status_t prvParseDescriptor( OtaLz4Ctx_t * pxCtx )
+{
+    OtaLz4Status_t xStatus = OTA_LZ4_OK;
+    uint8_t ucBd = pxCtx->ucField[ 1 ];
+    OtaLz4Xxh32_t xHeaderHash;
+
+    /* The header checksum is the second byte of the hash of the descriptor up to the checksum itself */
+    prvXxh32Reset( &xHeaderHash );
+    prvXxh32Update( &xHeaderHash, pxCtx->ucField, pxCtx->uxFieldNeed - 1 );
+
+    if( ( uint8_t ) ( prvXxh32Digest( &xHeaderHash ) >> 8 ) != pxCtx->ucField[ pxCtx->uxFieldNeed - 1 ] )
+    {
+        LogError( "LZ4 frame header checksum mismatch." );
+        xStatus = OTA_LZ4_ERR_CHECKSUM;
+    }
+    else if( ( pxCtx->ucFlags & LZ4_FLG_DICT_ID ) != 0 )
+    {
+        LogError( "LZ4 frames with a dictionary are not supported." );
+        xStatus = OTA_LZ4_ERR_FORMAT;
+    }
+    else if( ( ( ucBd & LZ4_BD_RESERVED ) != 0 ) ||
+             ( ( ucBd >> 4 ) < LZ4_BD_MAX_SIZE_MIN ) )
+    {
+        LogError( "LZ4 block descriptor is not valid: 0x%02X.", ucBd );
+        xStatus = OTA_LZ4_ERR_FORMAT;
+    }
+    else if( pxCtx->xHasContentSize == pdTRUE )
+    {
+        uint32_t ulSizeHigh = prvReadU32LE( &( pxCtx->ucField[ 6 ] ) );
+
+        pxCtx->ulContentSize = prvReadU32LE( &( pxCtx->ucField[ 2 ] ) );
+
+        if( ( ulSizeHigh != 0 ) ||
+            ( pxCtx->ulContentSize > pxCtx->uxTargetMaxLen ) )
+        {
+            LogError( "LZ4 content size is too large." );
+            xStatus = OTA_LZ4_ERR_BOUNDS;
+        }
+        else
+        {
+            LogInfo( "LZ4 image: %lu bytes decompressed.", pxCtx->ulContentSize );
+        }
+    }
+
+    if( xStatus == OTA_LZ4_OK )
+    {
+        prvExpectField( pxCtx, OTA_LZ4_STATE_BLOCK_SIZE, 4 );
+    }
+
+    return xStatus;
+}
+
+static OtaLz4Status_t prvParseBlockSize( OtaLz4Ctx_t * pxCtx )
+{
+    OtaLz4Status_t xStatus = OTA_LZ4_OK;
+    uint32_t ulBlockSize = prvReadU32LE( pxCtx->ucField );
+    uint32_t ulDataSize = ulBlockSize & ~LZ4_BLOCK_UNCOMPRESSED;
+
+    if( ulBlockSize == 0 )
+    {
+        /* End mark */
+        if( ( pxCtx->xHasContentSize == pdTRUE ) &&
+            ( pxCtx->ulOutputLen != pxCtx->ulContentSize ) )
+        {
+            LogError( "LZ4 frame ended after %lu of %lu bytes.", pxCtx->ulOutputLen, pxCtx->ulContentSize );
+            xStatus = OTA_LZ4_ERR_FORMAT;
+        }
+        else if( ( pxCtx->ucFlags & LZ4_FLG_CONTENT_CHECKSUM ) != 0 )
+        {
+            prvExpectField( pxCtx, OTA_LZ4_STATE_CONTENT_CHECKSUM, 4 );
+        }
+        else
+        {
+            pxCtx->xState = OTA_LZ4_STATE_DONE;
+        }
+    }
+    else if( ( ulDataSize == 0 ) ||
+             ( ulDataSize > LZ4_BLOCK_MAX_SIZE ) )
+    {
+        LogError( "LZ4 block size is not valid: %lu.", ulDataSize );
+        xStatus = OTA_LZ4_ERR_FORMAT;
+    }
+    else
+    {
+        pxCtx->ulBlockRemaining = ulDataSize;
+        prvXxh32Reset( &( pxCtx->xBlockHash ) );
+        pxCtx->xState = ( ( ulBlockSize & LZ4_BLOCK_UNCOMPRESSED ) != 0 ) ? OTA_LZ4_STATE_BLOCK_RAW : OTA_LZ4_STATE_TOKEN;
+    }
+
+    return xStatus;
+}
+
+static void prvBlockDone( OtaLz4Ctx_t * pxCtx )
+{
+    if( ( pxCtx->ucFlags & LZ4_FLG_BLOCK_CHECKSUM ) != 0 )
+    {
+        prvExpectField( pxCtx, OTA_LZ4_STATE_BLOCK_CHECKSUM, 4 );
+    }
+    else
+    {
+        prvExpectField( pxCtx, OTA_LZ4_STATE_BLOCK_SIZE, 4 );
+    }
+}
+
+static OtaLz4Status_t prvWriteLiterals( OtaLz4Ctx_t * pxCtx,
+                                        const uint8_t * pucData,
+                                        size_t uxLength )
+{
+    OtaLz4Status_t xStatus = OTA_LZ4_OK;
+
+    if( uxLength > ( pxCtx->uxTargetMaxLen - pxCtx->ulOutputLen ) )
+    {
+        xStatus = OTA_LZ4_ERR_BOUNDS;
+    }
+    else if( pxCtx->xWriteFn( pxCtx->pvCallbackCtx, pucData, uxLength ) != pdTRUE )
+    {
+        xStatus = OTA_LZ4_ERR_WRITE;
+    }
+    else
+    {
+        pxCtx->ulOutputLen += uxLength;
+
+        if( ( pxCtx->ucFlags & LZ4_FLG_CONTENT_CHECKSUM ) != 0 )
+        {
+            prvXxh32Update( &( pxCtx->xContentHash ), pucData, uxLength );
+        }
+    }
+
+    return xStatus;
+}
+
+static OtaLz4Status_t prvCopyMatch( OtaLz4Ctx_t * pxCtx,
+                                    uint32_t ulOffset,
+                                    uint32_t ulLength )
+{
+    OtaLz4Status_t xStatus = OTA_LZ4_OK;
+
+    if( ( ulOffset == 0 ) ||
+        ( ulOffset > pxCtx->ulOutputLen ) ||
+        ( ulLength > ( pxCtx->uxTargetMaxLen - pxCtx->ulOutputLen ) ) )
+    {
+        xStatus = OTA_LZ4_ERR_BOUNDS;
+    }
+
+    while( ( xStatus == OTA_LZ4_OK ) && ( ulLength > 0 ) )
+    {
+        uint8_t ucChunk[ LZ4_COPY_CHUNK_LEN ];
+        uint32_t ulChunkLen = ( ulLength < LZ4_COPY_CHUNK_LEN ) ? ulLength : LZ4_COPY_CHUNK_LEN;
+        uint32_t ulReadLen = ( ulOffset < ulChunkLen ) ? ulOffset : ulChunkLen;
+        uint32_t i;
+
+        pxCtx->xReadFn( pxCtx->pvCallbackCtx, pxCtx->ulOutputLen - ulOffset, ucChunk, ulReadLen );
+
+        /* Matches closer than their length repeat the last ulOffset bytes */
+        for( i = ulReadLen; i < ulChunkLen; i++ )
+        {
+            ucChunk[ i ] = ucChunk[ i - ulOffset ];
+        }
+
+        xStatus = prvWriteLiterals( pxCtx, ucChunk, ulChunkLen );
+        ulLength -= ulChunkLen;
+    }
+
+    return xStatus;
+}
+
+void vOtaLz4Init( OtaLz4Ctx_t * pxCtx,
+                  size_t uxTargetMaxLen,
+                  OtaLz4WriteFn_t xWriteFn,
+                  OtaLz4ReadFn_t xReadFn,
+                  void * pvCallbackCtx )
+{
+    configASSERT( pxCtx != NULL );
+    configASSERT( xWriteFn != NULL );
+    configASSERT( xReadFn != NULL );
+
+    ( void ) memset( pxCtx, 0, sizeof( OtaLz4Ctx_t ) );
+
+    pxCtx->xStatus = OTA_LZ4_OK;
+    pxCtx->uxTargetMaxLen = uxTargetMaxLen;
+    pxCtx->xWriteFn = xWriteFn;
+    pxCtx->xReadFn = xReadFn;
+    pxCtx->pvCallbackCtx = pvCallbackCtx;
+    pxCtx->xHasContentSize = pdFALSE;
+
+    prvXxh32Reset( &( pxCtx->xContentHash ) );
+    prvExpectField( pxCtx, OTA_LZ4_STATE_MAGIC, 4 );
+}
+
+OtaLz4Status_t xOtaLz4Feed( OtaLz4Ctx_t * pxCtx,
+                            const uint8_t * pucData,
+                            size_t uxLength )
+{
+    OtaLz4Status_t xStatus;
+
+    configASSERT( pxCtx != NULL );
+    configASSERT( ( pucData != NULL ) || ( uxLength == 0 ) );
+
+    xStatus = pxCtx->xStatus;
+
+    while( ( uxLength > 0 ) && ( xStatus == OTA_LZ4_OK ) )
+    {
+        const uint8_t * pucStart = pucData;
+        BaseType_t xInBlock = xIsBlockState( pxCtx->xState );
+
+        switch( pxCtx->xState )
+        {
+            /* Fixed size fields outside of blocks */
+            case OTA_LZ4_STATE_MAGIC:
+            case OTA_LZ4_STATE_DESCRIPTOR:
+            case OTA_LZ4_STATE_BLOCK_SIZE:
+            case OTA_LZ4_STATE_BLOCK_CHECKSUM:
+            case OTA_LZ4_STATE_CONTENT_CHECKSUM:
+                pxCtx->ucField[ pxCtx->uxFieldLen ] = *pucData;
+                pxCtx->uxFieldLen++;
+                pucData++;
+                uxLength--;
+
+                if( ( pxCtx->xState == OTA_LZ4_STATE_DESCRIPTOR ) &&
+                    ( pxCtx->uxFieldLen == 1 ) )
+                {
+                    /* FLG determines the length of the rest of the descriptor */
+                    pxCtx->ucFlags = pxCtx->ucField[ 0 ];
+                    pxCtx->xHasContentSize = ( ( pxCtx->ucFlags & LZ4_FLG_CONTENT_SIZE ) != 0 ) ? pdTRUE : pdFALSE;
+                    pxCtx->uxFieldNeed = 3 + ( ( pxCtx->xHasContentSize == pdTRUE ) ? 8 : 0 ) +
+                                         ( ( ( pxCtx->ucFlags & LZ4_FLG_DICT_ID ) != 0 ) ? 4 : 0 );
+
+                    if( ( ( pxCtx->ucFlags & LZ4_FLG_VERSION_MASK ) != LZ4_FLG_VERSION ) ||
+                        ( ( pxCtx->ucFlags & LZ4_FLG_RESERVED ) != 0 ) )
+                    {
+                        LogError( "LZ4 frame flags are not valid: 0x%02X.", pxCtx->ucFlags );
+                        xStatus = OTA_LZ4_ERR_FORMAT;
+                    }
+                }
+
+                if( ( xStatus == OTA_LZ4_OK ) &&
+                    ( pxCtx->uxFieldLen == pxCtx->uxFieldNeed ) )
+                {
+                    switch( pxCtx->xState )
+                    {
+                        case OTA_LZ4_STATE_MAGIC:
+
+                            if( prvReadU32LE( pxCtx->ucField ) != OTA_LZ4_FRAME_MAGIC )
+                            {
+                                LogError( "Image is not an LZ4 frame." );
+                                xStatus = OTA_LZ4_ERR_FORMAT;
+                            }
+                            else
+                            {
+                                prvExpectField( pxCtx, OTA_LZ4_STATE_DESCRIPTOR, 1 );
+                            }
+
+                            break;
+
+                        case OTA_LZ4_STATE_DESCRIPTOR:
+                            xStatus = prvParseDescriptor( pxCtx );
+                            break;
+
+                        case OTA_LZ4_STATE_BLOCK_SIZE:
+                            xStatus = prvParseBlockSize( pxCtx );
+                            break;
+
+                        case OTA_LZ4_STATE_BLOCK_CHECKSUM:
+                            xStatus = prvCheckHash( pxCtx, &( pxCtx->xBlockHash ), "block" );
+                            prvExpectField( pxCtx, OTA_LZ4_STATE_BLOCK_SIZE, 4 );
+                            break;
+
+                        case OTA_LZ4_STATE_CONTENT_CHECKSUM:
+                        default:
+                            xStatus = prvCheckHash( pxCtx, &( pxCtx->xContentHash ), "content" );
+                            pxCtx->xState = OTA_LZ4_STATE_DONE;
+                            break;
+                    }
+                }
+
+                break;
+
+            case OTA_LZ4_STATE_BLOCK_RAW:
+               {
+                   size_t uxChunk = ( pxCtx->ulBlockRemaining < uxLength ) ? pxCtx->ulBlockRemaining : uxLength;
+
+                   xStatus = prvWriteLiterals( pxCtx, pucData, uxChunk );
+                   pxCtx->ulBlockRemaining -= uxChunk;
+                   pucData += uxChunk;
+                   uxLength -= uxChunk;
+
+                   if( pxCtx->ulBlockRemaining == 0 )
+                   {
+                       prvBlockDone( pxCtx );
+                   }
+
+                   break;
+               }
+
+            case OTA_LZ4_STATE_TOKEN:
+                pxCtx->ulLength = ( uint32_t ) ( *pucData >> 4 );
+                pxCtx->ulMatchLength = ( uint32_t ) ( *pucData & 0x0FU );
+                pxCtx->ulBlockRemaining--;
+                pucData++;
+                uxLength--;
+
+                if( pxCtx->ulLength == LZ4_LENGTH_EXTENDED )
+                {
+                    pxCtx->xState = OTA_LZ4_STATE_LITERAL_LENGTH;
+                }
+                else
+                {
+                    pxCtx->xState = OTA_LZ4_STATE_LITERALS;
+                }
+
+                break;
+
+            case OTA_LZ4_STATE_LITERAL_LENGTH:
+            case OTA_LZ4_STATE_MATCH_LENGTH:
+               {
+                   uint8_t ucByte = *pucData;
+
+                   pxCtx->ulBlockRemaining--;
+                   pucData++;
+                   uxLength--;
+
+                   if( pxCtx->ulLength > LZ4_BLOCK_MAX_SIZE )
+                   {
+                       xStatus = OTA_LZ4_ERR_FORMAT;
+                   }
+                   else
+                   {
+                       pxCtx->ulLength += ucByte;
+
+                       if( ucByte != 0xFFU )
+                       {
+                           if( pxCtx->xState == OTA_LZ4_STATE_LITERAL_LENGTH )
+                           {
+                               pxCtx->xState = OTA_LZ4_STATE_LITERALS;
+                           }
+                           else
+                           {
+                               xStatus = prvCopyMatch( pxCtx, pxCtx->ulMatchOffset, pxCtx->ulLength + LZ4_MIN_MATCH );
+                               pxCtx->xState = OTA_LZ4_STATE_TOKEN;
+                           }
+                       }
+                   }
+
+                   break;
+               }
+
+            case OTA_LZ4_STATE_LITERALS:
+               {
+                   size_t uxChunk = ( pxCtx->ulLength < uxLength ) ? pxCtx->ulLength : uxLength;
+
+                   if( uxChunk > pxCtx->ulBlockRemaining )
+                   {
+                       xStatus = OTA_LZ4_ERR_FORMAT;
+                   }
+                   else if( uxChunk > 0 )
+                   {
+                       xStatus = prvWriteLiterals( pxCtx, pucData, uxChunk );
+                       pxCtx->ulLength -= uxChunk;
+                       pxCtx->ulBlockRemaining -= uxChunk;
+                       pucData += uxChunk;
+                       uxLength -= uxChunk;
+                   }
+
+                   if( ( xStatus == OTA_LZ4_OK ) && ( pxCtx->ulLength == 0 ) )
+                   {
+                       if( pxCtx->ulBlockRemaining == 0 )
+                       {
+                           /* The last sequence of a block has no match */
+                           prvBlockDone( pxCtx );
+                       }
+                       else
+                       {
+                           prvExpectField( pxCtx, OTA_LZ4_STATE_OFFSET, 2 );
+                       }
+                   }
+
+                   break;
+               }
+
+            case OTA_LZ4_STATE_OFFSET:
+                pxCtx->ucField[ pxCtx->uxFieldLen ] = *pucData;
+                pxCtx->uxFieldLen++;
+                pxCtx->ulBlockRemaining--;
+                pucData++;
+                uxLength--;
+
+                if( pxCtx->uxFieldLen == pxCtx->uxFieldNeed )
+                {
+                    uint32_t ulOffset = ( uint32_t ) pxCtx->ucField[ 0 ] | ( ( uint32_t ) pxCtx->ucField[ 1 ] << 8 );
+
+                    pxCtx->ulMatchOffset = ulOffset;
+
+                    if( pxCtx->ulMatchLength == LZ4_LENGTH_EXTENDED )
+                    {
+                        pxCtx->ulLength = LZ4_LENGTH_EXTENDED;
+                        pxCtx->xState = OTA_LZ4_STATE_MATCH_LENGTH;
+                    }
+                    else
+                    {
+                        xStatus = prvCopyMatch( pxCtx, ulOffset, pxCtx->ulMatchLength + LZ4_MIN_MATCH );
+                        pxCtx->xState = OTA_LZ4_STATE_TOKEN;
+                    }
+                }
+
+                break;
+
+            case OTA_LZ4_STATE_DONE:
+                LogError( "LZ4 image has %lu trailing bytes.", ( uint32_t ) uxLength );
+                xStatus = OTA_LZ4_ERR_FORMAT;
+                break;
+
+            case OTA_LZ4_STATE_ERROR:
+            default:
+                xStatus = OTA_LZ4_ERR_FORMAT;
+                break;
+        }
+
+        /* The block checksum covers the block as stored, whether compressed or not */
+        if( ( xInBlock == pdTRUE ) &&
+            ( ( pxCtx->ucFlags & LZ4_FLG_BLOCK_CHECKSUM ) != 0 ) )
+        {
+            prvXxh32Update( &( pxCtx->xBlockHash ), pucStart, ( size_t ) ( pucData - pucStart ) );
+        }
+
+        /* Sequences may not run past the end of their block */
+        if( ( xStatus == OTA_LZ4_OK ) &&
+            ( pxCtx->ulBlockRemaining == 0 ) &&
+            ( ( pxCtx->xState == OTA_LZ4_STATE_TOKEN ) ||
+              ( pxCtx->xState == OTA_LZ4_STATE_LITERAL_LENGTH ) ||
+              ( pxCtx->xState == OTA_LZ4_STATE_OFFSET ) ||
+              ( pxCtx->xState == OTA_LZ4_STATE_MATCH_LENGTH ) ) )
+        {
+            LogError( "LZ4 sequence crosses a block boundary." );
+            xStatus = OTA_LZ4_ERR_FORMAT;
+        }
+    }
+
+    if( xStatus != OTA_LZ4_OK )
+    {
+        pxCtx->xState = OTA_LZ4_STATE_ERROR;
+        pxCtx->xStatus = xStatus;
+    }
+
+    return xStatus;
+}
+
+BaseType_t xOtaLz4IsComplete( const OtaLz4Ctx_t * pxCtx )
+{
+    return ( pxCtx->xState == OTA_LZ4_STATE_DONE ) ? pdTRUE : pdFALSE;
+}
@@ -0,0 +1,152 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ *
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * https://www.FreeRTOS.org
+ * https://github.com/FreeRTOS
+ *
+ */
+
+
+/**
+ * @file ota_lz4.h Streaming decoder for LZ4 compressed firmware images.
+ *
+ * Accepts a single LZ4 frame as produced by the lz4 command line tool or
+ * tools/ota_compress.py. Linked and independent blocks are supported. The
+ * header checksum is always verified, and block and content checksums are
+ * verified when the frame flags say they are present, so a corrupt frame is
+ * rejected before the signature check. Dictionary IDs and skippable frames
+ * are rejected.
+ *
+ * Matches refer back up to 64 KB into the decompressed image. Rather than
+ * keeping that window in RAM, the decoder reads it back through a callback,
+ * which lets the OTA PAL serve it from the flash bank being programmed.
+ */
+
+#ifndef _OTA_LZ4_H
+#define _OTA_LZ4_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+
+#define OTA_LZ4_FRAME_MAGIC       ( 0x184D2204UL )
+
+/* Largest frame descriptor: FLG, BD, content size, dictionary ID and header checksum */
+#define OTA_LZ4_MAX_DESC_LEN      ( 15UL )
+
+typedef enum
+{
+    OTA_LZ4_OK = 0,
+    OTA_LZ4_ERR_FORMAT,   /* Malformed or unsupported frame */
+    OTA_LZ4_ERR_BOUNDS,   /* Match or output outside of the image */
+    OTA_LZ4_ERR_CHECKSUM, /* Header, block or content checksum mismatch */
+    OTA_LZ4_ERR_WRITE     /* Output callback failed */
+} OtaLz4Status_t;
+
+typedef enum
+{
+    OTA_LZ4_STATE_MAGIC = 0,
+    OTA_LZ4_STATE_DESCRIPTOR,
+    OTA_LZ4_STATE_BLOCK_SIZE,
+    OTA_LZ4_STATE_BLOCK_RAW,
+    OTA_LZ4_STATE_TOKEN,
+    OTA_LZ4_STATE_LITERAL_LENGTH,
+    OTA_LZ4_STATE_LITERALS,
+    OTA_LZ4_STATE_OFFSET,
+    OTA_LZ4_STATE_MATCH_LENGTH,
+    OTA_LZ4_STATE_BLOCK_CHECKSUM,
+    OTA_LZ4_STATE_CONTENT_CHECKSUM,
+    OTA_LZ4_STATE_DONE,
+    OTA_LZ4_STATE_ERROR
+} OtaLz4State_t;
+
+/* Running xxHash32 state */
+typedef struct OtaLz4Xxh32
+{
+    uint32_t ulAcc[ 4 ];
+    uint32_t ulTotalLen;
+    uint8_t ucStripe[ 16 ];
+    size_t uxStripeLen;
+} OtaLz4Xxh32_t;
+
+/* Consume uxLength bytes of decompressed image. Returns pdTRUE on success. */
+typedef BaseType_t ( * OtaLz4WriteFn_t )( void * pvCtx,
+                                          const uint8_t * pucData,
+                                          size_t uxLength );
+
+/* Read back uxLength bytes of decompressed image starting at ulOffset. */
+typedef void ( * OtaLz4ReadFn_t )( void * pvCtx,
+                                   uint32_t ulOffset,
+                                   uint8_t * pucBuffer,
+                                   size_t uxLength );
+
+typedef struct OtaLz4Ctx
+{
+    OtaLz4State_t xState;
+    OtaLz4Status_t xStatus;
+
+    size_t uxTargetMaxLen;
+    OtaLz4WriteFn_t xWriteFn;
+    OtaLz4ReadFn_t xReadFn;
+    void * pvCallbackCtx;
+
+    uint8_t ucField[ OTA_LZ4_MAX_DESC_LEN ];
+    size_t uxFieldLen;    /* Bytes of the current fixed size field received */
+    size_t uxFieldNeed;   /* Size of the current fixed size field */
+
+    uint8_t ucFlags;
+    BaseType_t xHasContentSize;
+    uint32_t ulContentSize;
+
+    uint32_t ulBlockRemaining;  /* Bytes of the current block not yet consumed */
+    uint32_t ulLength;          /* Literal or match length being accumulated */
+    uint32_t ulMatchLength;     /* Match length from the current token */
+    uint32_t ulMatchOffset;
+
+    uint32_t ulOutputLen;       /* Bytes of decompressed image produced so far */
+
+    OtaLz4Xxh32_t xBlockHash;   /* Hash of the stored bytes of the current block */
+    OtaLz4Xxh32_t xContentHash; /* Hash of the decompressed image */
+} OtaLz4Ctx_t;
+
+/**
+ * Prepare a decoder for a frame decompressing to at most uxTargetMaxLen bytes.
+ */
+void vOtaLz4Init( OtaLz4Ctx_t * pxCtx,
+                  size_t uxTargetMaxLen,
+                  OtaLz4WriteFn_t xWriteFn,
+                  OtaLz4ReadFn_t xReadFn,
+                  void * pvCallbackCtx );
+
+/**
+ * Feed the next uxLength bytes of the frame to the decoder.
+ * Once an error is returned, every following call returns the same error.
+ */
+OtaLz4Status_t xOtaLz4Feed( OtaLz4Ctx_t * pxCtx,
+                            const uint8_t * pucData,
+                            size_t uxLength );
+
+/* Returns pdTRUE once the end of the frame has been reached */
+BaseType_t xOtaLz4IsComplete( const OtaLz4Ctx_t * pxCtx );
+
+#endif /* _OTA_LZ4_H */
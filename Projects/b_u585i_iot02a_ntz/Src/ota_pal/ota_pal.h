@@ -226,4 +226,34 @@ OtaPalImageState_t otaPal_GetPlatformImageState( OtaFileContext_t * const pFileC
  */
 OtaPalStatus_t otaPal_ResetDevice( OtaFileContext_t * const pFileContext );
 
+/**
+ * @brief Work done by the PAL for the file currently or most recently received.
+ *
+ * The counters are cleared by otaPal_CreateFileForRx. Times are in run time counter
+ * ticks, as returned by portGET_RUN_TIME_COUNTER_VALUE().
+ */
+typedef struct OtaPalStats
+{
+    uint32_t ulBlocksWritten;   /**< Blocks accepted by otaPal_WriteBlock. */
+    uint32_t ulBytesWritten;    /**< File bytes accepted by otaPal_WriteBlock. */
+    uint32_t ulBytesProgrammed; /**< Bytes programmed to the staging bank. */
+    uint32_t ulPagesErased;     /**< Staging bank pages erased. */
+    uint32_t ulCheckpoints;     /**< Download progress checkpoints saved. */
+    uint32_t ulProgramTime;     /**< Time spent programming and verifying flash. */
+    uint32_t ulEraseTime;       /**< Time spent erasing flash. */
+    uint32_t ulHashTime;        /**< Time spent hashing the image. */
+    uint32_t ulSignatureTime;   /**< Time spent loading the signing key and verifying the signature. */
+    uint32_t ulCheckpointTime;  /**< Time spent saving progress checkpoints. */
+    uint32_t ulCreateTime;      /**< Counter value when the file was created. */
+    uint32_t ulLastWriteTime;   /**< Counter value when the last block was written. */
+    uint32_t ulCloseTime;       /**< Counter value when the file was closed. */
+} OtaPalStats_t;
+
+/**
+ * @brief Get a copy of the PAL statistics.
+ *
+ * @param[out] pxStats Statistics of the current or most recent file.
+ */
+void vOtaPalGetStats( OtaPalStats_t * pxStats );
+
 #endif /* ifndef OTA_PAL_H_ */
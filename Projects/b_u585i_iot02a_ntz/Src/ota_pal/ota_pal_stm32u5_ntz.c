@@ -35,6 +35,7 @@
 #include "task.h"
 
 #include "ota.h"
+#include "ota_config.h"
 #include "ota_pal.h"
 #include "stm32u5xx.h"
 #include "stm32u5xx_hal_flash.h"
@@ -47,16 +48,64 @@
 
 #include "PkiObject.h"
 
+#include "ota_delta.h"
+#include "ota_lz4.h"
+
 #define FLASH_START_INACTIVE_BANK    ( ( uint32_t ) ( FLASH_BASE + FLASH_BANK_SIZE ) )
 
-#define NUM_QUAD_WORDS( length )         ( length >> 4UL )
+/* The internal flash filesystem occupies the inactive bank, which is erased to stage each update. */
+#if LFS_PORT_DEFAULT_FS_INTERNAL_FLASH == 1
+    #error "LFS_PORT_DEFAULT_FS_INTERNAL_FLASH cannot be used with the OTA PAL: the internal flash volume overlaps the OTA staging bank."
+#endif
 
 #define NUM_REMAINING_BYTES( length )    ( length & 0x0F )
 
+/* Eight quad-words are programmed per burst operation */
+#define FLASH_BURST_LEN                  ( 8UL * 16UL )
+
+#define PAGE_BITMAP_WORDS                ( ( FLASH_PAGE_NB + 31UL ) / 32UL )
+
 #define IMAGE_CONTEXT_FILE_NAME    "/ota/image_state"
 
 #define OTA_IMAGE_MIN_SIZE         ( 16 )
 
+#define OTA_IMAGE_FILE_NAME        "b_u585i_iot02a_ntz.bin"
+#define OTA_DELTA_FILE_NAME        "b_u585i_iot02a_ntz.delta"
+#define OTA_LZ4_FILE_NAME          "b_u585i_iot02a_ntz.bin.lz4"
+
+/* Blocks of a delta or compressed image received ahead of a missing block, kept until it arrives */
+#define OTA_STAGING_FILE_NAME      "/ota/staged_file"
+
+/*
+ * Size of the buffer collecting decoded image data into whole quad-words for programming.
+ * Together with the decoder contexts this bounds the RAM used to decode an image. Must be a multiple of 16.
+ */
+#ifndef OTA_OUTPUT_BUFFER_LEN
+    #define OTA_OUTPUT_BUFFER_LEN    ( 256 )
+#endif
+
+/* Size of the chunks read back from the staging file */
+#define OTA_STAGING_READ_LEN       ( 256 )
+
+/* Received block and erased page maps of an interrupted download, used to resume the same job after a reset */
+#define OTA_PROGRESS_FILE_NAME     "/ota/progress"
+#define OTA_PROGRESS_MAGIC         ( 0x5250544FUL ) /* "OTPR" */
+#define OTA_PROGRESS_VERSION       ( 1UL )
+#define OTA_PROGRESS_JOB_NAME_LEN  ( 72 )
+
+/*
+ * Number of blocks written between checkpoints of the progress file. A reset loses at most this
+ * many blocks, plus the blocks sharing a page with a block that was not yet received.
+ */
+#ifndef OTA_CHECKPOINT_INTERVAL_BLOCKS
+    #define OTA_CHECKPOINT_INTERVAL_BLOCKS    ( 32UL )
+#endif
+
+#define BLOCK_BITMAP_WORDS         ( ( ( FLASH_BANK_SIZE / otaconfigFILE_BLOCK_SIZE ) + 31UL ) / 32UL )
+
+/* Timestamp for the PAL statistics */
+#define OTA_PAL_STATS_NOW()        ( ( uint32_t ) portGET_RUN_TIME_COUNTER_VALUE() )
+
 
 typedef enum
 {
@@ -88,12 +137,31 @@ static const char * ppcPalStateString[] =
     "Invalid"
 };
 
+typedef enum
+{
+    OTA_PAL_IMAGE_INVALID = 0,
+    OTA_PAL_IMAGE_RAW,    /* File is the image itself, written directly to the staging bank */
+    OTA_PAL_IMAGE_DELTA,  /* File is a delta against the running image, decoded into the staging bank */
+    OTA_PAL_IMAGE_LZ4     /* File is an LZ4 frame, decompressed into the staging bank */
+} OtaPalImageFormat_t;
+
 typedef struct
 {
     OtaPalState_t xPalState;
     uint32_t ulFileTargetBank;
 } OtaPalNvContext_t;
 
+/* Followed by the erased page map and the received block map in the progress file */
+typedef struct
+{
+    uint32_t ulMagic;
+    uint32_t ulVersion;
+    char cJobName[ OTA_PROGRESS_JOB_NAME_LEN ];
+    uint32_t ulImageSize;
+    uint32_t ulTargetBank;
+    uint32_t ulBlockSize;
+} OtaPalProgressHeader_t;
+
 typedef struct
 {
     uint32_t ulTargetBank;
@@ -101,6 +169,24 @@ typedef struct
     uint32_t ulBaseAddress;
     uint32_t ulImageSize;
     OtaPalState_t xPalState;
+    mbedtls_md_context_t xImageHashCtx; /* Running hash of the staged image */
+    uint32_t ulHashedLength;            /* Length of the contiguous image prefix included in xImageHashCtx */
+    BaseType_t xImageHashActive;
+    OtaPalImageFormat_t xImageFormat;
+    lfs_file_t xStagingFile;           /* Blocks received ahead of the decode cursor */
+    BaseType_t xStagingFileOpen;
+    uint32_t ulStreamedLength;         /* Length of the contiguous file prefix fed to the decoder */
+    uint32_t ulOutputLength;           /* Length of the decoded image programmed to the staging bank */
+    uint8_t ucOutputBuffer[ OTA_OUTPUT_BUFFER_LEN ];
+    size_t uxOutputBufferLength;
+    OtaDeltaCtx_t xDeltaCtx;
+    OtaLz4Ctx_t xLz4Ctx;
+    uint32_t ulErasedPages[ PAGE_BITMAP_WORDS ]; /* Staging bank pages erased since the file was created */
+    uint32_t ulErasedPageCount;
+    uint32_t ulReceivedBlocks[ BLOCK_BITMAP_WORDS ]; /* Blocks of a raw image programmed to the staging bank, or blocks of a
+                                                      * delta or compressed image kept in the staging file */
+    uint32_t ulBlocksSinceCheckpoint;
+    char cJobName[ OTA_PROGRESS_JOB_NAME_LEN ];
 } OtaPalContext_t;
 
 
@@ -108,15 +194,21 @@ const char OTA_JsonFileSignatureKey[] = "sig-sha256-ecdsa";
 
 static OtaPalContext_t xPalContext =
 {
-    .xPalState     = OTA_PAL_NOT_INITIALIZED,
-    .ulTargetBank  = 0,
-    .ulPendingBank = 0,
-    .ulBaseAddress = 0,
-    .ulImageSize   = 0,
+    .xPalState        = OTA_PAL_NOT_INITIALIZED,
+    .ulTargetBank     = 0,
+    .ulPendingBank    = 0,
+    .ulBaseAddress    = 0,
+    .ulImageSize      = 0,
+    .ulHashedLength   = 0,
+    .xImageHashActive = pdFALSE,
+    .xImageFormat     = OTA_PAL_IMAGE_INVALID,
+    .xStagingFileOpen = pdFALSE,
 };
 
 static uint32_t ulBankAtBootup = 0;
 
+static OtaPalStats_t xPalStats = { 0 };
+
 /* Static function forward declarations */
 
 /* Load/Save/Delete */
@@ -143,6 +235,25 @@ static HAL_StatusTypeDef prvWriteToFlash( uint32_t destination,
 
 static BaseType_t prvEraseBank( uint32_t bankNumber );
 
+static void prvResetErasedPages( OtaPalContext_t * pxContext );
+static BaseType_t prvErasePagesForWrite( OtaPalContext_t * pxContext,
+                                         uint32_t ulOffset,
+                                         uint32_t ulLength );
+static BaseType_t prvEraseWrittenPages( OtaPalContext_t * pxContext );
+static BaseType_t prvEraseStagingBank( OtaPalContext_t * pxContext );
+static HAL_StatusTypeDef prvStageToFlash( OtaPalContext_t * pxContext,
+                                          uint32_t ulOffset,
+                                          uint8_t * pSource,
+                                          uint32_t ulLength );
+
+/* Interrupted download checkpoints */
+static BaseType_t prvProgressSave( OtaPalContext_t * pxContext );
+static void prvProgressDelete( void );
+static uint32_t prvProgressRestore( OtaPalContext_t * pxContext,
+                                    OtaFileContext_t * const pxFileContext );
+static void prvMarkBlockReceived( OtaPalContext_t * pxContext,
+                                  uint32_t ulOffset );
+
 /* Verify signature */
 static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
                                             const unsigned char * pucSignature,
@@ -156,6 +267,39 @@ static BaseType_t xCalculateImageHash( const unsigned char * pucImageAddress,
                                        size_t uxHashBufferLength,
                                        size_t * puxHashLength );
 
+/* Running image hash */
+static void prvImageHashStart( OtaPalContext_t * pxContext );
+static void prvImageHashUpdate( OtaPalContext_t * pxContext,
+                                uint32_t ulEndOffset );
+static BaseType_t prvImageHashFinish( OtaPalContext_t * pxContext,
+                                      uint32_t ulImageLength,
+                                      unsigned char * pucHashBuffer,
+                                      size_t uxHashBufferLength,
+                                      size_t * puxHashLength );
+static void prvImageHashFree( OtaPalContext_t * pxContext );
+
+/* Delta and compressed images */
+static BaseType_t prvStagingFileOpen( OtaPalContext_t * pxContext );
+static void prvStagingFileClose( OtaPalContext_t * pxContext );
+static BaseType_t prvStagingFileWrite( OtaPalContext_t * pxContext,
+                                       uint32_t ulOffset,
+                                       const uint8_t * pucData,
+                                       uint32_t ulLength );
+static BaseType_t prvDecodeOutputFlush( OtaPalContext_t * pxContext );
+static BaseType_t prvDecodeOutputWrite( void * pvWriteCtx,
+                                        const uint8_t * pucData,
+                                        size_t uxLength );
+static void prvDecodeOutputRead( void * pvReadCtx,
+                                 uint32_t ulOffset,
+                                 uint8_t * pucBuffer,
+                                 size_t uxLength );
+static void prvDecodeStart( OtaPalContext_t * pxContext );
+static BaseType_t prvDecodeFeed( OtaPalContext_t * pxContext,
+                                 const uint8_t * pucData,
+                                 uint32_t ulLength );
+static BaseType_t prvDecodeDrainStaged( OtaPalContext_t * pxContext );
+static BaseType_t prvDecodeFinish( OtaPalContext_t * pxContext );
+
 const char * otaImageStateToString( OtaImageState_t xState )
 {
     const char * pcStateString;
@@ -541,199 +685,1059 @@ static uint32_t prvGetBankSettingFromOB( void )
     /* Get the Dual boot configuration status */
     HAL_FLASHEx_OBGetConfig( &xObContext );
 
-    if( ( xObContext.USERConfig & OB_SWAP_BANK_ENABLE ) == OB_SWAP_BANK_ENABLE )
+    if( ( xObContext.USERConfig & OB_SWAP_BANK_ENABLE ) == OB_SWAP_BANK_ENABLE )
+    {
+        ulCurrentBank = FLASH_BANK_2;
+    }
+    else
+    {
+        ulCurrentBank = FLASH_BANK_1;
+    }
+
+    return ulCurrentBank;
+}
+
+static uint32_t prvGetInactiveBank( void )
+{
+    uint32_t ulActiveBank = prvGetActiveBank();
+
+    uint32_t ulInactiveBank;
+
+    if( ulActiveBank == FLASH_BANK_1 )
+    {
+        ulInactiveBank = FLASH_BANK_2;
+    }
+    else if( ulActiveBank == FLASH_BANK_2 )
+    {
+        ulInactiveBank = FLASH_BANK_1;
+    }
+    else
+    {
+        ulInactiveBank = 0UL;
+    }
+
+    return ulInactiveBank;
+}
+
+
+/*
+ * Program ulLength bytes to the staging bank. Runs of eight quad-words aligned on a burst boundary
+ * are programmed with a single burst operation and the rest one quad-word at a time. The programmed
+ * data is verified once the whole range has been written.
+ */
+static HAL_StatusTypeDef prvWriteToFlash( uint32_t destination,
+                                          uint8_t * pSource,
+                                          uint32_t ulLength )
+{
+    HAL_StatusTypeDef status = HAL_OK;
+    uint32_t ulBuffer[ FLASH_BURST_LEN / sizeof( uint32_t ) ];
+    uint32_t ulStartAddress = destination;
+    uint8_t * pucStartSource = pSource;
+    uint32_t ulProgramLength = ulLength - NUM_REMAINING_BYTES( ulLength );
+    uint32_t remainingBytes = NUM_REMAINING_BYTES( ulLength );
+    uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
+    /* Pet the watchdog */
+    vPetWatchdog();
+
+    /* Unlock the Flash to enable the flash control register access *************/
+    HAL_FLASH_Unlock();
+
+    while( ( status == HAL_OK ) && ( ulProgramLength > 0 ) )
+    {
+        uint32_t ulChunk = 16UL;
+        uint32_t ulType = FLASH_TYPEPROGRAM_QUADWORD;
+        uint32_t ulData = ( uint32_t ) pSource;
+
+        if( ( ( destination % FLASH_BURST_LEN ) == 0 ) &&
+            ( ulProgramLength >= FLASH_BURST_LEN ) )
+        {
+            ulChunk = FLASH_BURST_LEN;
+            ulType = FLASH_TYPEPROGRAM_BURST;
+        }
+
+        /* The HAL reads the source a word at a time */
+        if( ( ulData % sizeof( uint32_t ) ) != 0 )
+        {
+            ( void ) memcpy( ulBuffer, pSource, ulChunk );
+            ulData = ( uint32_t ) ulBuffer;
+        }
+
+        status = HAL_FLASH_Program( ulType, destination, ulData );
+
+        destination += ulChunk;
+        pSource += ulChunk;
+        ulProgramLength -= ulChunk;
+    }
+
+    if( ( status == HAL_OK ) && ( remainingBytes > 0 ) )
+    {
+        ( void ) memcpy( ulBuffer, pSource, remainingBytes );
+        ( void ) memset( ( ( uint8_t * ) ulBuffer + remainingBytes ), 0xFF, ( 16UL - remainingBytes ) );
+
+        status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, destination, ( uint32_t ) ulBuffer );
+    }
+
+    /* Lock the Flash to disable the flash control register access (recommended
+     *  to protect the FLASH memory against possible unwanted operation) *********/
+    HAL_FLASH_Lock();
+
+    /* Check the written value */
+    if( ( status == HAL_OK ) &&
+        ( memcmp( ( void * ) ulStartAddress, pucStartSource, ulLength ) != 0 ) )
+    {
+        /* Flash content doesn't match SRAM content */
+        LogError( "Flash verification failed for %lu bytes at 0x%08lx.", ulLength, ulStartAddress );
+        status = HAL_ERROR;
+    }
+
+    xPalStats.ulProgramTime += OTA_PAL_STATS_NOW() - ulStartTime;
+    xPalStats.ulBytesProgrammed += ulLength;
+
+    return status;
+}
+
+static BaseType_t prvEraseBank( uint32_t bankNumber )
+{
+    BaseType_t xResult = pdTRUE;
+
+    configASSERT( ( bankNumber == FLASH_BANK_1 ) || ( bankNumber == FLASH_BANK_2 ) );
+
+    configASSERT( bankNumber != prvGetActiveBank() );
+
+    if( HAL_FLASH_Unlock() == HAL_OK )
+    {
+        uint32_t pageError = 0U;
+        FLASH_EraseInitTypeDef pEraseInit;
+
+        pEraseInit.Banks = bankNumber;
+        pEraseInit.NbPages = FLASH_PAGE_NB;
+        pEraseInit.Page = 0U;
+        pEraseInit.TypeErase = FLASH_TYPEERASE_MASSERASE;
+
+        uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
+        if( HAL_FLASHEx_Erase( &pEraseInit, &pageError ) != HAL_OK )
+        {
+            LogError( "Failed to erase the flash bank, errorCode = %u, pageError = %u.", HAL_FLASH_GetError(), pageError );
+            xResult = pdFALSE;
+        }
+
+        xPalStats.ulEraseTime += OTA_PAL_STATS_NOW() - ulStartTime;
+        xPalStats.ulPagesErased += FLASH_PAGE_NB;
+
+        ( void ) HAL_FLASH_Lock();
+    }
+    else
+    {
+        LogError( "Failed to lock flash for erase, errorCode = %u.", HAL_FLASH_GetError() );
+        xResult = pdFALSE;
+    }
+
+    return xResult;
+}
+
+static void prvResetErasedPages( OtaPalContext_t * pxContext )
+{
+    ( void ) memset( pxContext->ulErasedPages, 0, sizeof( pxContext->ulErasedPages ) );
+    pxContext->ulErasedPageCount = 0;
+}
+
+static inline BaseType_t xIsPageErased( const OtaPalContext_t * pxContext,
+                                        uint32_t ulPage )
+{
+    return ( ( pxContext->ulErasedPages[ ulPage / 32UL ] & ( 1UL << ( ulPage % 32UL ) ) ) != 0 ) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t prvErasePage( OtaPalContext_t * pxContext,
+                                uint32_t ulPage )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t pageError = 0U;
+    FLASH_EraseInitTypeDef pEraseInit;
+
+    configASSERT( ulPage < FLASH_PAGE_NB );
+    configASSERT( pxContext->ulTargetBank != prvGetActiveBank() );
+
+    pEraseInit.Banks = pxContext->ulTargetBank;
+    pEraseInit.NbPages = 1U;
+    pEraseInit.Page = ulPage;
+    pEraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+
+    if( HAL_FLASH_Unlock() != HAL_OK )
+    {
+        LogError( "Failed to unlock flash for erase, errorCode = %u.", HAL_FLASH_GetError() );
+        xResult = pdFALSE;
+    }
+    else
+    {
+        uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
+        if( HAL_FLASHEx_Erase( &pEraseInit, &pageError ) != HAL_OK )
+        {
+            LogError( "Failed to erase page %u, errorCode = %u, pageError = %u.", ulPage, HAL_FLASH_GetError(), pageError );
+            xResult = pdFALSE;
+        }
+
+        xPalStats.ulEraseTime += OTA_PAL_STATS_NOW() - ulStartTime;
+        xPalStats.ulPagesErased++;
+
+        ( void ) HAL_FLASH_Lock();
+    }
+
+    return xResult;
+}
+
+/*
+ * Erase the staging bank pages covering [ulOffset, ulOffset + ulLength) that have not been erased
+ * since the file was created. Replaces a mass erase of the whole bank when the file is created, so
+ * the first block can be written immediately and pages beyond the image are left alone.
+ */
+static BaseType_t prvErasePagesForWrite( OtaPalContext_t * pxContext,
+                                         uint32_t ulOffset,
+                                         uint32_t ulLength )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t ulPage = ulOffset / FLASH_PAGE_SIZE;
+    uint32_t ulEndPage = ( ulOffset + ulLength + FLASH_PAGE_SIZE - 1UL ) / FLASH_PAGE_SIZE;
+
+    for( ; ( ulPage < ulEndPage ) && ( xResult == pdTRUE ); ulPage++ )
+    {
+        if( xIsPageErased( pxContext, ulPage ) == pdFALSE )
+        {
+            xResult = prvErasePage( pxContext, ulPage );
+
+            if( xResult == pdTRUE )
+            {
+                pxContext->ulErasedPages[ ulPage / 32UL ] |= ( 1UL << ( ulPage % 32UL ) );
+                pxContext->ulErasedPageCount++;
+            }
+        }
+    }
+
+    return xResult;
+}
+
+/* Erase the pages programmed since the file was created rather than the whole staging bank */
+static BaseType_t prvEraseWrittenPages( OtaPalContext_t * pxContext )
+{
+    BaseType_t xResult = pdTRUE;
+    uint32_t ulPage;
+
+    for( ulPage = 0; ( ulPage < FLASH_PAGE_NB ) && ( xResult == pdTRUE ); ulPage++ )
+    {
+        if( xIsPageErased( pxContext, ulPage ) == pdTRUE )
+        {
+            vPetWatchdog();
+            xResult = prvErasePage( pxContext, ulPage );
+        }
+    }
+
+    prvResetErasedPages( pxContext );
+
+    return xResult;
+}
+
+/*
+ * Clear the staging bank after a failed or aborted update. The erased page map is only valid for a
+ * file created since boot, so states restored from the NV context fall back to a mass erase.
+ */
+static BaseType_t prvEraseStagingBank( OtaPalContext_t * pxContext )
+{
+    BaseType_t xResult;
+
+    if( ( pxContext->xPalState == OTA_PAL_FILE_OPEN ) ||
+        ( pxContext->xPalState == OTA_PAL_PENDING_ACTIVATION ) )
+    {
+        LogInfo( "Erasing %lu pages of the staging bank.", pxContext->ulErasedPageCount );
+        xResult = prvEraseWrittenPages( pxContext );
+    }
+    else
+    {
+        xResult = prvEraseBank( pxContext->ulTargetBank );
+    }
+
+    /* The staged blocks described by a checkpoint are gone */
+    prvProgressDelete();
+
+    return xResult;
+}
+
+static HAL_StatusTypeDef prvStageToFlash( OtaPalContext_t * pxContext,
+                                          uint32_t ulOffset,
+                                          uint8_t * pSource,
+                                          uint32_t ulLength )
+{
+    HAL_StatusTypeDef xHalStatus = HAL_ERROR;
+
+    if( prvErasePagesForWrite( pxContext, ulOffset, ulLength ) == pdTRUE )
+    {
+        xHalStatus = prvWriteToFlash( pxContext->ulBaseAddress + ulOffset, pSource, ulLength );
+    }
+
+    return xHalStatus;
+}
+
+static inline BaseType_t xIsBlockReceived( const OtaPalContext_t * pxContext,
+                                           uint32_t ulBlock )
+{
+    return ( ( pxContext->ulReceivedBlocks[ ulBlock / 32UL ] & ( 1UL << ( ulBlock % 32UL ) ) ) != 0 ) ? pdTRUE : pdFALSE;
+}
+
+/*
+ * Checkpoint the received block and erased page maps of a raw image. littlefs commits the new
+ * contents of a file when it is closed, so a reset while saving leaves the previous checkpoint intact.
+ */
+static BaseType_t prvProgressSave( OtaPalContext_t * pxContext )
+{
+    BaseType_t xResult = pdFALSE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+
+    if( pxLfsCtx == NULL )
+    {
+        LogError( "File system not ready." );
+    }
+    else
+    {
+        lfs_file_t xFile = { 0 };
+        OtaPalProgressHeader_t xHeader = { 0 };
+        int lLfsErr;
+
+        xHeader.ulMagic = OTA_PROGRESS_MAGIC;
+        xHeader.ulVersion = OTA_PROGRESS_VERSION;
+        ( void ) memcpy( xHeader.cJobName, pxContext->cJobName, sizeof( xHeader.cJobName ) );
+        xHeader.ulImageSize = pxContext->ulImageSize;
+        xHeader.ulTargetBank = pxContext->ulTargetBank;
+        xHeader.ulBlockSize = otaconfigFILE_BLOCK_SIZE;
+
+        uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
+        lLfsErr = lfs_file_open( pxLfsCtx, &xFile, OTA_PROGRESS_FILE_NAME, ( LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC ) );
+
+        if( lLfsErr == LFS_ERR_OK )
+        {
+            if( ( lfs_file_write( pxLfsCtx, &xFile, &xHeader, sizeof( xHeader ) ) == ( lfs_ssize_t ) sizeof( xHeader ) ) &&
+                ( lfs_file_write( pxLfsCtx, &xFile, pxContext->ulErasedPages,
+                                  sizeof( pxContext->ulErasedPages ) ) == ( lfs_ssize_t ) sizeof( pxContext->ulErasedPages ) ) &&
+                ( lfs_file_write( pxLfsCtx, &xFile, pxContext->ulReceivedBlocks,
+                                  sizeof( pxContext->ulReceivedBlocks ) ) == ( lfs_ssize_t ) sizeof( pxContext->ulReceivedBlocks ) ) )
+            {
+                xResult = pdTRUE;
+            }
+
+            lLfsErr = lfs_file_close( pxLfsCtx, &xFile );
+
+            if( lLfsErr != LFS_ERR_OK )
+            {
+                xResult = pdFALSE;
+            }
+        }
+
+        if( xResult != pdTRUE )
+        {
+            LogError( "Failed to save OTA download progress to file %s, error = %d.", OTA_PROGRESS_FILE_NAME, lLfsErr );
+        }
+
+        xPalStats.ulCheckpointTime += OTA_PAL_STATS_NOW() - ulStartTime;
+        xPalStats.ulCheckpoints++;
+    }
+
+    return xResult;
+}
+
+static void prvProgressDelete( void )
+{
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+
+    if( pxLfsCtx != NULL )
+    {
+        struct lfs_info xFileInfo = { 0 };
+
+        if( lfs_stat( pxLfsCtx, OTA_PROGRESS_FILE_NAME, &xFileInfo ) == LFS_ERR_OK )
+        {
+            ( void ) lfs_remove( pxLfsCtx, OTA_PROGRESS_FILE_NAME );
+        }
+    }
+}
+
+/*
+ * Restore the checkpoint of an interrupted download of the same job and image, credit the blocks it
+ * records to the OTA library and catch the running hash up to the contiguous prefix.
+ * A page holding any block that was not received may have been partially programmed after the
+ * checkpoint, so such pages are erased again and all their blocks downloaded again.
+ * Returns the number of blocks credited, or zero if the download starts from the beginning.
+ */
+static uint32_t prvProgressRestore( OtaPalContext_t * pxContext,
+                                    OtaFileContext_t * const pxFileContext )
+{
+    uint32_t ulResumedBlocks = 0;
+    uint32_t ulNumBlocks = ( pxContext->ulImageSize + otaconfigFILE_BLOCK_SIZE - 1UL ) / otaconfigFILE_BLOCK_SIZE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+    lfs_file_t xFile = { 0 };
+    OtaPalProgressHeader_t xHeader = { 0 };
+    BaseType_t xValid = pdFALSE;
+
+    if( ( pxLfsCtx != NULL ) &&
+        ( pxFileContext->pRxBlockBitmap != NULL ) &&
+        ( ulNumBlocks <= ( pxFileContext->blockBitmapMaxSize * 8UL ) ) &&
+        ( otaconfigFILE_BLOCK_SIZE <= FLASH_PAGE_SIZE ) &&
+        ( lfs_file_open( pxLfsCtx, &xFile, OTA_PROGRESS_FILE_NAME, LFS_O_RDONLY ) == LFS_ERR_OK ) )
+    {
+        if( ( lfs_file_read( pxLfsCtx, &xFile, &xHeader, sizeof( xHeader ) ) == ( lfs_ssize_t ) sizeof( xHeader ) ) &&
+            ( xHeader.ulMagic == OTA_PROGRESS_MAGIC ) &&
+            ( xHeader.ulVersion == OTA_PROGRESS_VERSION ) &&
+            ( strncmp( xHeader.cJobName, pxContext->cJobName, sizeof( xHeader.cJobName ) ) == 0 ) &&
+            ( xHeader.ulImageSize == pxContext->ulImageSize ) &&
+            ( xHeader.ulTargetBank == pxContext->ulTargetBank ) &&
+            ( xHeader.ulBlockSize == otaconfigFILE_BLOCK_SIZE ) &&
+            ( lfs_file_read( pxLfsCtx, &xFile, pxContext->ulErasedPages,
+                             sizeof( pxContext->ulErasedPages ) ) == ( lfs_ssize_t ) sizeof( pxContext->ulErasedPages ) ) &&
+            ( lfs_file_read( pxLfsCtx, &xFile, pxContext->ulReceivedBlocks,
+                             sizeof( pxContext->ulReceivedBlocks ) ) == ( lfs_ssize_t ) sizeof( pxContext->ulReceivedBlocks ) ) )
+        {
+            xValid = pdTRUE;
+        }
+
+        ( void ) lfs_file_close( pxLfsCtx, &xFile );
+    }
+
+    if( xValid == pdTRUE )
+    {
+        uint32_t ulPage;
+        uint32_t ulBlock;
+
+        pxContext->ulErasedPageCount = 0;
+
+        for( ulPage = 0; ulPage < FLASH_PAGE_NB; ulPage++ )
+        {
+            uint32_t ulFirstBlock = ( ulPage * FLASH_PAGE_SIZE ) / otaconfigFILE_BLOCK_SIZE;
+            uint32_t ulEndBlock = ( ( ulPage + 1UL ) * FLASH_PAGE_SIZE ) / otaconfigFILE_BLOCK_SIZE;
+            BaseType_t xPageComplete = xIsPageErased( pxContext, ulPage );
+
+            if( ulEndBlock > ulNumBlocks )
+            {
+                ulEndBlock = ulNumBlocks;
+            }
+
+            for( ulBlock = ulFirstBlock; ( ulBlock < ulEndBlock ) && ( xPageComplete == pdTRUE ); ulBlock++ )
+            {
+                xPageComplete = xIsBlockReceived( pxContext, ulBlock );
+            }
+
+            if( xPageComplete == pdTRUE )
+            {
+                pxContext->ulErasedPageCount++;
+            }
+            else
+            {
+                pxContext->ulErasedPages[ ulPage / 32UL ] &= ~( 1UL << ( ulPage % 32UL ) );
+
+                for( ulBlock = ulFirstBlock; ulBlock < ulEndBlock; ulBlock++ )
+                {
+                    pxContext->ulReceivedBlocks[ ulBlock / 32UL ] &= ~( 1UL << ( ulBlock % 32UL ) );
+                }
+            }
+        }
+
+        for( ulBlock = 0; ulBlock < ulNumBlocks; ulBlock++ )
+        {
+            if( ( xIsBlockReceived( pxContext, ulBlock ) == pdTRUE ) &&
+                ( ( pxFileContext->pRxBlockBitmap[ ulBlock >> 3 ] & ( 1U << ( ulBlock & 7UL ) ) ) != 0 ) )
+            {
+                ulResumedBlocks++;
+            }
+        }
+
+        /* Nothing to gain from a checkpoint that is empty or that the OTA library would consider complete */
+        if( ( ulResumedBlocks == 0 ) ||
+            ( ulResumedBlocks >= pxFileContext->blocksRemaining ) )
+        {
+            ulResumedBlocks = 0;
+        }
+    }
+
+    if( ulResumedBlocks > 0 )
+    {
+        uint32_t ulBlock;
+
+        for( ulBlock = 0; ulBlock < ulNumBlocks; ulBlock++ )
+        {
+            if( xIsBlockReceived( pxContext, ulBlock ) == pdTRUE )
+            {
+                pxFileContext->pRxBlockBitmap[ ulBlock >> 3 ] &= ( uint8_t ) ~( 1U << ( ulBlock & 7UL ) );
+            }
+        }
+
+        pxFileContext->blocksRemaining -= ulResumedBlocks;
+
+        /* Re-read the staged prefix rather than persisting the hash state */
+        ulBlock = 0;
+
+        while( ( ulBlock < ulNumBlocks ) && ( xIsBlockReceived( pxContext, ulBlock ) == pdTRUE ) )
+        {
+            ulBlock++;
+        }
+
+        prvImageHashUpdate( pxContext, ( ulBlock == ulNumBlocks ) ? pxContext->ulImageSize : ( ulBlock * otaconfigFILE_BLOCK_SIZE ) );
+    }
+    else
+    {
+        prvResetErasedPages( pxContext );
+        ( void ) memset( pxContext->ulReceivedBlocks, 0, sizeof( pxContext->ulReceivedBlocks ) );
+        prvProgressDelete();
+    }
+
+    return ulResumedBlocks;
+}
+
+static void prvMarkBlockReceived( OtaPalContext_t * pxContext,
+                                  uint32_t ulOffset )
+{
+    uint32_t ulBlock = ulOffset / otaconfigFILE_BLOCK_SIZE;
+
+    pxContext->ulReceivedBlocks[ ulBlock / 32UL ] |= ( 1UL << ( ulBlock % 32UL ) );
+    pxContext->ulBlocksSinceCheckpoint++;
+
+    if( pxContext->ulBlocksSinceCheckpoint >= OTA_CHECKPOINT_INTERVAL_BLOCKS )
+    {
+        /* A failed checkpoint only costs the blocks received since the last one */
+        ( void ) prvProgressSave( pxContext );
+        pxContext->ulBlocksSinceCheckpoint = 0;
+    }
+}
+
+static BaseType_t xCalculateImageHash( const unsigned char * pucImageAddress,
+                                       const size_t uxImageLength,
+                                       unsigned char * pucHashBuffer,
+                                       size_t uxHashBufferLength,
+                                       size_t * puxHashLength )
+{
+    BaseType_t xResult = pdTRUE;
+    const mbedtls_md_info_t * pxMdInfo = NULL;
+
+    pxMdInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+
+    configASSERT( pucHashBuffer != NULL );
+    configASSERT( pucImageAddress != NULL );
+    configASSERT( uxImageLength > 0 );
+    configASSERT( uxHashBufferLength > 0 );
+
+    if( pxMdInfo == NULL )
+    {
+        LogError( "Failed to initialize mbedtls md_info object." );
+        xResult = pdFALSE;
+    }
+    else if( mbedtls_md_get_size( pxMdInfo ) > uxHashBufferLength )
+    {
+        LogError( "Hash buffer is too small." );
+        xResult = pdFALSE;
+    }
+    else
+    {
+        int lRslt = 0;
+        size_t uxHashLength = 0;
+
+        uxHashLength = mbedtls_md_get_size( pxMdInfo );
+
+        configASSERT( uxHashLength <= MBEDTLS_MD_MAX_SIZE );
+
+        uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
+        lRslt = mbedtls_md( pxMdInfo, pucImageAddress, uxImageLength, pucHashBuffer );
+
+        xPalStats.ulHashTime += OTA_PAL_STATS_NOW() - ulStartTime;
+
+        MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to compute hash of the staged firmware image." );
+
+        if( lRslt != 0 )
+        {
+            xResult = pdFALSE;
+        }
+        else
+        {
+            *puxHashLength = uxHashLength;
+        }
+    }
+
+    return xResult;
+}
+
+static void prvImageHashFree( OtaPalContext_t * pxContext )
+{
+    if( pxContext->xImageHashActive == pdTRUE )
+    {
+        mbedtls_md_free( &( pxContext->xImageHashCtx ) );
+        pxContext->xImageHashActive = pdFALSE;
+    }
+
+    pxContext->ulHashedLength = 0;
+}
+
+static void prvImageHashStart( OtaPalContext_t * pxContext )
+{
+    const mbedtls_md_info_t * pxMdInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
+    int lRslt = -1;
+
+    prvImageHashFree( pxContext );
+
+    mbedtls_md_init( &( pxContext->xImageHashCtx ) );
+
+    if( pxMdInfo != NULL )
+    {
+        lRslt = mbedtls_md_setup( &( pxContext->xImageHashCtx ), pxMdInfo, 0 );
+
+        if( lRslt == 0 )
+        {
+            lRslt = mbedtls_md_starts( &( pxContext->xImageHashCtx ) );
+        }
+    }
+
+    if( lRslt == 0 )
+    {
+        pxContext->xImageHashActive = pdTRUE;
+    }
+    else
+    {
+        MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to start the running image hash. The image will be hashed at close." );
+        mbedtls_md_free( &( pxContext->xImageHashCtx ) );
+    }
+}
+
+/*
+ * Extend the running hash from the contiguous prefix cursor up to ulEndOffset.
+ * The data is read back from the staging bank so the hash covers exactly what was programmed.
+ */
+static void prvImageHashUpdate( OtaPalContext_t * pxContext,
+                                uint32_t ulEndOffset )
+{
+    if( ( pxContext->xImageHashActive == pdTRUE ) &&
+        ( ulEndOffset > pxContext->ulHashedLength ) )
+    {
+        uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+        int lRslt = mbedtls_md_update( &( pxContext->xImageHashCtx ),
+                                       ( const unsigned char * ) ( pxContext->ulBaseAddress + pxContext->ulHashedLength ),
+                                       ( size_t ) ( ulEndOffset - pxContext->ulHashedLength ) );
+
+        xPalStats.ulHashTime += OTA_PAL_STATS_NOW() - ulStartTime;
+
+        if( lRslt == 0 )
+        {
+            pxContext->ulHashedLength = ulEndOffset;
+        }
+        else
+        {
+            MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to update the running image hash. The image will be hashed at close." );
+            prvImageHashFree( pxContext );
+        }
+    }
+}
+
+/*
+ * Hash any part of the first ulImageLength bytes of the image beyond the contiguous prefix cursor
+ * and finalize the running hash.
+ * Returns pdFALSE if the running hash is unavailable, in which case the caller should hash the whole image.
+ */
+static BaseType_t prvImageHashFinish( OtaPalContext_t * pxContext,
+                                      uint32_t ulImageLength,
+                                      unsigned char * pucHashBuffer,
+                                      size_t uxHashBufferLength,
+                                      size_t * puxHashLength )
+{
+    BaseType_t xResult = pdFALSE;
+
+    if( pxContext->xImageHashActive == pdTRUE )
+    {
+        if( pxContext->ulHashedLength < ulImageLength )
+        {
+            LogInfo( "Hashing %lu bytes of the image received out of order.",
+                     ulImageLength - pxContext->ulHashedLength );
+        }
+
+        prvImageHashUpdate( pxContext, ulImageLength );
+    }
+
+    if( pxContext->xImageHashActive == pdTRUE )
+    {
+        size_t uxHashLength = mbedtls_md_get_size( mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 ) );
+
+        if( uxHashLength > uxHashBufferLength )
+        {
+            LogError( "Hash buffer is too small." );
+        }
+        else
+        {
+            int lRslt = mbedtls_md_finish( &( pxContext->xImageHashCtx ), pucHashBuffer );
+
+            MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to finalize the running image hash." );
+
+            if( lRslt == 0 )
+            {
+                *puxHashLength = uxHashLength;
+                xResult = pdTRUE;
+            }
+        }
+    }
+
+    prvImageHashFree( pxContext );
+
+    return xResult;
+}
+
+static BaseType_t prvStagingFileOpen( OtaPalContext_t * pxContext )
+{
+    BaseType_t xResult = pdFALSE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+
+    if( pxLfsCtx == NULL )
+    {
+        LogError( "File system not ready." );
+    }
+    else
+    {
+        int lLfsErr = lfs_file_open( pxLfsCtx, &( pxContext->xStagingFile ), OTA_STAGING_FILE_NAME,
+                                     ( LFS_O_RDWR | LFS_O_CREAT | LFS_O_TRUNC ) );
+
+        if( lLfsErr == LFS_ERR_OK )
+        {
+            pxContext->xStagingFileOpen = pdTRUE;
+            xResult = pdTRUE;
+        }
+        else
+        {
+            LogError( "Failed to open file %s, error = %d.", OTA_STAGING_FILE_NAME, lLfsErr );
+        }
+    }
+
+    return xResult;
+}
+
+static void prvStagingFileClose( OtaPalContext_t * pxContext )
+{
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+
+    if( ( pxContext->xStagingFileOpen == pdTRUE ) &&
+        ( pxLfsCtx != NULL ) )
+    {
+        ( void ) lfs_file_close( pxLfsCtx, &( pxContext->xStagingFile ) );
+        ( void ) lfs_remove( pxLfsCtx, OTA_STAGING_FILE_NAME );
+    }
+
+    pxContext->xStagingFileOpen = pdFALSE;
+}
+
+static BaseType_t prvStagingFileWrite( OtaPalContext_t * pxContext,
+                                       uint32_t ulOffset,
+                                       const uint8_t * pucData,
+                                       uint32_t ulLength )
+{
+    BaseType_t xResult = pdFALSE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
+
+    /* The file is only created once the first block arrives out of order */
+    if( pxContext->xStagingFileOpen != pdTRUE )
+    {
+        ( void ) prvStagingFileOpen( pxContext );
+    }
+
+    if( ( pxContext->xStagingFileOpen != pdTRUE ) ||
+        ( pxLfsCtx == NULL ) )
     {
-        ulCurrentBank = FLASH_BANK_2;
+        LogError( "Staging file is not open." );
     }
     else
     {
-        ulCurrentBank = FLASH_BANK_1;
+        lfs_soff_t xLfsOff = lfs_file_seek( pxLfsCtx, &( pxContext->xStagingFile ), ( lfs_soff_t ) ulOffset, LFS_SEEK_SET );
+        lfs_ssize_t xLfsLen = LFS_ERR_INVAL;
+
+        if( xLfsOff == ( lfs_soff_t ) ulOffset )
+        {
+            xLfsLen = lfs_file_write( pxLfsCtx, &( pxContext->xStagingFile ), pucData, ulLength );
+        }
+
+        if( xLfsLen == ( lfs_ssize_t ) ulLength )
+        {
+            xResult = pdTRUE;
+        }
+        else
+        {
+            LogError( "Failed to write %lu bytes at offset %lu to %s, error = %d.",
+                      ulLength, ulOffset, OTA_STAGING_FILE_NAME, ( xLfsOff < 0 ) ? xLfsOff : xLfsLen );
+        }
     }
 
-    return ulCurrentBank;
+    return xResult;
 }
 
-static uint32_t prvGetInactiveBank( void )
+/*
+ * Program the decoded data collected so far. Only the final flush may be shorter than the buffer.
+ * The signature of a compressed image covers the decompressed image, so it is hashed as it is programmed.
+ */
+static BaseType_t prvDecodeOutputFlush( OtaPalContext_t * pxContext )
 {
-    uint32_t ulActiveBank = prvGetActiveBank();
-
-    uint32_t ulInactiveBank;
+    BaseType_t xResult = pdTRUE;
 
-    if( ulActiveBank == FLASH_BANK_1 )
-    {
-        ulInactiveBank = FLASH_BANK_2;
-    }
-    else if( ulActiveBank == FLASH_BANK_2 )
+    if( pxContext->uxOutputBufferLength > 0 )
     {
-        ulInactiveBank = FLASH_BANK_1;
+        if( prvStageToFlash( pxContext, pxContext->ulOutputLength,
+                             pxContext->ucOutputBuffer,
+                             pxContext->uxOutputBufferLength ) == HAL_OK )
+        {
+            pxContext->ulOutputLength += pxContext->uxOutputBufferLength;
+            pxContext->uxOutputBufferLength = 0;
+        }
+        else
+        {
+            LogError( "Failed to program the decoded image at offset %lu.", pxContext->ulOutputLength );
+            xResult = pdFALSE;
+        }
     }
-    else
+
+    if( ( xResult == pdTRUE ) &&
+        ( pxContext->xImageFormat == OTA_PAL_IMAGE_LZ4 ) )
     {
-        ulInactiveBank = 0UL;
+        prvImageHashUpdate( pxContext, pxContext->ulOutputLength );
     }
 
-    return ulInactiveBank;
+    return xResult;
 }
 
-
-static HAL_StatusTypeDef prvWriteToFlash( uint32_t destination,
-                                          uint8_t * pSource,
-                                          uint32_t ulLength )
+static BaseType_t prvDecodeOutputWrite( void * pvWriteCtx,
+                                        const uint8_t * pucData,
+                                        size_t uxLength )
 {
-    HAL_StatusTypeDef status = HAL_OK;
-    uint32_t i = 0U;
-    uint8_t quadWord[ 16 ] = { 0 };
-    uint32_t numQuadWords = NUM_QUAD_WORDS( ulLength );
-    uint32_t remainingBytes = NUM_REMAINING_BYTES( ulLength );
-
-    /* Unlock the Flash to enable the flash control register access *************/
-    HAL_FLASH_Unlock();
+    OtaPalContext_t * pxContext = ( OtaPalContext_t * ) pvWriteCtx;
+    BaseType_t xResult = pdTRUE;
 
-    for( i = 0U; i < numQuadWords; i++ )
+    while( ( uxLength > 0 ) && ( xResult == pdTRUE ) )
     {
-        /* Pet the watchdog */
-        vPetWatchdog();
+        size_t uxChunk = OTA_OUTPUT_BUFFER_LEN - pxContext->uxOutputBufferLength;
 
-        /* Device voltage range supposed to be [2.7V to 3.6V], the operation will
-         * be done by word */
+        uxChunk = ( uxChunk < uxLength ) ? uxChunk : uxLength;
 
-        memcpy( quadWord, pSource, 16UL );
-        status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, destination, ( uint32_t ) quadWord );
+        ( void ) memcpy( &( pxContext->ucOutputBuffer[ pxContext->uxOutputBufferLength ] ), pucData, uxChunk );
+        pxContext->uxOutputBufferLength += uxChunk;
+        pucData += uxChunk;
+        uxLength -= uxChunk;
 
-        if( status == HAL_OK )
+        if( pxContext->uxOutputBufferLength == OTA_OUTPUT_BUFFER_LEN )
         {
-            /* Check the written value */
-            if( memcmp( ( void * ) destination, quadWord, 16UL ) != 0 )
-            {
-                /* Flash content doesn't match SRAM content */
-                status = HAL_ERROR;
-            }
+            xResult = prvDecodeOutputFlush( pxContext );
         }
+    }
 
-        if( status == HAL_OK )
+    return xResult;
+}
+
+/*
+ * Read back decoded data for LZ4 matches. The match window lives in the staging bank rather than
+ * in RAM, apart from the tail still held in the output buffer.
+ */
+static void prvDecodeOutputRead( void * pvReadCtx,
+                                 uint32_t ulOffset,
+                                 uint8_t * pucBuffer,
+                                 size_t uxLength )
+{
+    OtaPalContext_t * pxContext = ( OtaPalContext_t * ) pvReadCtx;
+
+    configASSERT( ( ulOffset + uxLength ) <= ( pxContext->ulOutputLength + pxContext->uxOutputBufferLength ) );
+
+    while( uxLength > 0 )
+    {
+        size_t uxChunk = uxLength;
+
+        if( ulOffset < pxContext->ulOutputLength )
         {
-            /* Increment FLASH destination address and the source address. */
-            destination += 16UL;
-            pSource += 16UL;
+            uxChunk = ( uxChunk < ( pxContext->ulOutputLength - ulOffset ) ) ? uxChunk : ( pxContext->ulOutputLength - ulOffset );
+            ( void ) memcpy( pucBuffer, ( const void * ) ( pxContext->ulBaseAddress + ulOffset ), uxChunk );
         }
         else
         {
-            break;
+            ( void ) memcpy( pucBuffer, &( pxContext->ucOutputBuffer[ ulOffset - pxContext->ulOutputLength ] ), uxChunk );
         }
+
+        pucBuffer += uxChunk;
+        ulOffset += uxChunk;
+        uxLength -= uxChunk;
     }
+}
 
-    if( status == HAL_OK )
+static void prvDecodeStart( OtaPalContext_t * pxContext )
+{
+    pxContext->ulStreamedLength = 0;
+    pxContext->ulOutputLength = 0;
+    pxContext->uxOutputBufferLength = 0;
+    ( void ) memset( pxContext->ulReceivedBlocks, 0, sizeof( pxContext->ulReceivedBlocks ) );
+
+    if( pxContext->xImageFormat == OTA_PAL_IMAGE_DELTA )
     {
-        if( remainingBytes > 0 )
-        {
-            memcpy( quadWord, pSource, remainingBytes );
-            memset( ( quadWord + remainingBytes ), 0xFF, ( 16UL - remainingBytes ) );
+        /* The running image is always mapped at the start of flash */
+        vOtaDeltaInit( &( pxContext->xDeltaCtx ),
+                       ( const uint8_t * ) FLASH_BASE, FLASH_BANK_SIZE,
+                       FLASH_BANK_SIZE,
+                       prvDecodeOutputWrite, pxContext );
+    }
+    else
+    {
+        vOtaLz4Init( &( pxContext->xLz4Ctx ),
+                     FLASH_BANK_SIZE,
+                     prvDecodeOutputWrite, prvDecodeOutputRead, pxContext );
+    }
+}
+
+/*
+ * Feed the next part of the contiguous file prefix to the decoder.
+ * The signature of a delta covers the received delta, so it is hashed here rather than as it is programmed.
+ */
+static BaseType_t prvDecodeFeed( OtaPalContext_t * pxContext,
+                                 const uint8_t * pucData,
+                                 uint32_t ulLength )
+{
+    BaseType_t xResult = pdTRUE;
 
-            status = HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, destination, ( uint32_t ) quadWord );
+    if( pxContext->xImageFormat == OTA_PAL_IMAGE_DELTA )
+    {
+        if( pxContext->xImageHashActive == pdTRUE )
+        {
+            int lRslt = mbedtls_md_update( &( pxContext->xImageHashCtx ), pucData, ( size_t ) ulLength );
 
-            if( status == HAL_OK )
+            if( lRslt == 0 )
             {
-                /* Check the written value */
-                if( memcmp( ( void * ) destination, quadWord, 16UL ) != 0 )
-                {
-                    /* Flash content doesn't match SRAM content */
-                    status = HAL_ERROR;
-                }
+                pxContext->ulHashedLength += ulLength;
+            }
+            else
+            {
+                MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to update the running image hash." );
+                prvImageHashFree( pxContext );
             }
         }
+
+        xResult = ( xOtaDeltaFeed( &( pxContext->xDeltaCtx ), pucData, ( size_t ) ulLength ) == OTA_DELTA_OK ) ? pdTRUE : pdFALSE;
+    }
+    else
+    {
+        xResult = ( xOtaLz4Feed( &( pxContext->xLz4Ctx ), pucData, ( size_t ) ulLength ) == OTA_LZ4_OK ) ? pdTRUE : pdFALSE;
     }
 
-    /* Lock the Flash to disable the flash control register access (recommended
-     *  to protect the FLASH memory against possible unwanted operation) *********/
-    HAL_FLASH_Lock();
+    if( xResult == pdTRUE )
+    {
+        pxContext->ulStreamedLength += ulLength;
+    }
+    else
+    {
+        LogError( "Failed to decode the image at offset %lu.", pxContext->ulStreamedLength );
+    }
 
-    return status;
+    return xResult;
 }
 
-static BaseType_t prvEraseBank( uint32_t bankNumber )
+/*
+ * Feed the staged blocks that directly follow the decoded prefix, once the block missing ahead of them
+ * has arrived.
+ */
+static BaseType_t prvDecodeDrainStaged( OtaPalContext_t * pxContext )
 {
     BaseType_t xResult = pdTRUE;
+    lfs_t * pxLfsCtx = pxGetDefaultFsCtx();
 
-    configASSERT( ( bankNumber == FLASH_BANK_1 ) || ( bankNumber == FLASH_BANK_2 ) );
-
-    configASSERT( bankNumber != prvGetActiveBank() );
-
-    if( HAL_FLASH_Unlock() == HAL_OK )
+    while( ( xResult == pdTRUE ) &&
+           ( pxContext->xStagingFileOpen == pdTRUE ) &&
+           ( pxLfsCtx != NULL ) &&
+           ( pxContext->ulStreamedLength < pxContext->ulImageSize ) &&
+           ( xIsBlockReceived( pxContext, pxContext->ulStreamedLength / otaconfigFILE_BLOCK_SIZE ) == pdTRUE ) )
     {
-        uint32_t pageError = 0U;
-        FLASH_EraseInitTypeDef pEraseInit;
+        uint8_t ucChunk[ OTA_STAGING_READ_LEN ];
+        uint32_t ulBlockEnd = ( ( pxContext->ulStreamedLength / otaconfigFILE_BLOCK_SIZE ) + 1UL ) * otaconfigFILE_BLOCK_SIZE;
+        uint32_t ulChunkLength;
+        lfs_ssize_t xLfsLen = LFS_ERR_INVAL;
 
-        pEraseInit.Banks = bankNumber;
-        pEraseInit.NbPages = FLASH_PAGE_NB;
-        pEraseInit.Page = 0U;
-        pEraseInit.TypeErase = FLASH_TYPEERASE_MASSERASE;
+        ulBlockEnd = ( ulBlockEnd < pxContext->ulImageSize ) ? ulBlockEnd : pxContext->ulImageSize;
+        ulChunkLength = ulBlockEnd - pxContext->ulStreamedLength;
+        ulChunkLength = ( ulChunkLength < OTA_STAGING_READ_LEN ) ? ulChunkLength : OTA_STAGING_READ_LEN;
 
-        if( HAL_FLASHEx_Erase( &pEraseInit, &pageError ) != HAL_OK )
+        if( lfs_file_seek( pxLfsCtx, &( pxContext->xStagingFile ),
+                           ( lfs_soff_t ) pxContext->ulStreamedLength, LFS_SEEK_SET ) == ( lfs_soff_t ) pxContext->ulStreamedLength )
         {
-            LogError( "Failed to erase the flash bank, errorCode = %u, pageError = %u.", HAL_FLASH_GetError(), pageError );
-            xResult = pdFALSE;
+            xLfsLen = lfs_file_read( pxLfsCtx, &( pxContext->xStagingFile ), ucChunk, ulChunkLength );
         }
 
-        ( void ) HAL_FLASH_Lock();
-    }
-    else
-    {
-        LogError( "Failed to lock flash for erase, errorCode = %u.", HAL_FLASH_GetError() );
-        xResult = pdFALSE;
+        if( xLfsLen != ( lfs_ssize_t ) ulChunkLength )
+        {
+            LogError( "Failed to read %s, error = %d.", OTA_STAGING_FILE_NAME, xLfsLen );
+            xResult = pdFALSE;
+        }
+        else
+        {
+            xResult = prvDecodeFeed( pxContext, ucChunk, ulChunkLength );
+        }
     }
 
     return xResult;
 }
 
-static BaseType_t xCalculateImageHash( const unsigned char * pucImageAddress,
-                                       const size_t uxImageLength,
-                                       unsigned char * pucHashBuffer,
-                                       size_t uxHashBufferLength,
-                                       size_t * puxHashLength )
+/*
+ * Program the remainder of the new image. Staged blocks are decoded as soon as the blocks ahead of them
+ * arrive, so the whole file has been decoded unless a block is missing.
+ * A delta is also checked against the target hash recorded in its header.
+ */
+static BaseType_t prvDecodeFinish( OtaPalContext_t * pxContext )
 {
     BaseType_t xResult = pdTRUE;
-    const mbedtls_md_info_t * pxMdInfo = NULL;
-
-    pxMdInfo = mbedtls_md_info_from_type( MBEDTLS_MD_SHA256 );
-
-    configASSERT( pucHashBuffer != NULL );
-    configASSERT( pucImageAddress != NULL );
-    configASSERT( uxImageLength > 0 );
-    configASSERT( uxHashBufferLength > 0 );
+    BaseType_t xComplete = pdFALSE;
 
-    if( pxMdInfo == NULL )
+    if( pxContext->ulStreamedLength < pxContext->ulImageSize )
     {
-        LogError( "Failed to initialize mbedtls md_info object." );
+        LogError( "Image file is missing %lu bytes.",
+                  pxContext->ulImageSize - pxContext->ulStreamedLength );
         xResult = pdFALSE;
     }
-    else if( mbedtls_md_get_size( pxMdInfo ) > uxHashBufferLength )
+
+    if( pxContext->xImageFormat == OTA_PAL_IMAGE_DELTA )
     {
-        LogError( "Hash buffer is too small." );
-        xResult = pdFALSE;
+        xComplete = xOtaDeltaIsComplete( &( pxContext->xDeltaCtx ) );
     }
     else
     {
-        int lRslt = 0;
-        size_t uxHashLength = 0;
-
-        uxHashLength = mbedtls_md_get_size( pxMdInfo );
+        xComplete = xOtaLz4IsComplete( &( pxContext->xLz4Ctx ) );
+    }
 
-        configASSERT( uxHashLength <= MBEDTLS_MD_MAX_SIZE );
+    if( ( xResult == pdTRUE ) &&
+        ( xComplete != pdTRUE ) )
+    {
+        LogError( "Image file ended after %lu bytes of the new image.",
+                  pxContext->ulOutputLength + pxContext->uxOutputBufferLength );
+        xResult = pdFALSE;
+    }
 
-        lRslt = mbedtls_md( pxMdInfo, pucImageAddress, uxImageLength, pucHashBuffer );
+    if( xResult == pdTRUE )
+    {
+        xResult = prvDecodeOutputFlush( pxContext );
+    }
 
-        MBEDTLS_MSG_IF_ERROR( lRslt, "Failed to compute hash of the staged firmware image." );
+    if( ( xResult == pdTRUE ) &&
+        ( pxContext->xImageFormat == OTA_PAL_IMAGE_DELTA ) )
+    {
+        unsigned char pucHashBuffer[ MBEDTLS_MD_MAX_SIZE ];
+        size_t uxHashLength = 0;
 
-        if( lRslt != 0 )
+        if( ( xCalculateImageHash( ( unsigned char * ) ( pxContext->ulBaseAddress ),
+                                   ( size_t ) pxContext->ulOutputLength,
+                                   pucHashBuffer, MBEDTLS_MD_MAX_SIZE, &uxHashLength ) != pdTRUE ) ||
+            ( uxHashLength != OTA_DELTA_HASH_LEN ) ||
+            ( memcmp( pucHashBuffer, pxContext->xDeltaCtx.ucTargetHash, OTA_DELTA_HASH_LEN ) != 0 ) )
         {
+            LogError( "Decoded image does not match the delta target hash." );
             xResult = pdFALSE;
         }
-        else
-        {
-            *puxHashLength = uxHashLength;
-        }
     }
 
+    if( xResult == pdTRUE )
+    {
+        LogInfo( "Decoded a %lu byte image from a %lu byte file.",
+                 pxContext->ulOutputLength, pxContext->ulImageSize );
+    }
+
+    prvStagingFileClose( pxContext );
+
     return xResult;
 }
 
@@ -758,6 +1762,8 @@ static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
         return uxStatus;
     }
 
+    uint32_t ulStartTime = OTA_PAL_STATS_NOW();
+
     mbedtls_pk_init( &xPubKeyCtx );
 
     xOtaSigningPubKey = xPkiObjectFromLabel( pcPubKeyLabel );
@@ -784,6 +1790,8 @@ static OtaPalStatus_t prvValidateSignature( const char * pcPubKeyLabel,
 
     mbedtls_pk_free( &xPubKeyCtx );
 
+    xPalStats.ulSignatureTime += OTA_PAL_STATS_NOW() - ulStartTime;
+
     return uxStatus;
 }
 
@@ -791,6 +1799,20 @@ OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
 {
     OtaPalStatus_t uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
     OtaPalContext_t * pxContext = prvGetImageContext();
+    OtaPalImageFormat_t xImageFormat = OTA_PAL_IMAGE_INVALID;
+
+    if( strncmp( OTA_IMAGE_FILE_NAME, ( char * ) pxFileContext->pFilePath, pxFileContext->filePathMaxSize ) == 0 )
+    {
+        xImageFormat = OTA_PAL_IMAGE_RAW;
+    }
+    else if( strncmp( OTA_DELTA_FILE_NAME, ( char * ) pxFileContext->pFilePath, pxFileContext->filePathMaxSize ) == 0 )
+    {
+        xImageFormat = OTA_PAL_IMAGE_DELTA;
+    }
+    else if( strncmp( OTA_LZ4_FILE_NAME, ( char * ) pxFileContext->pFilePath, pxFileContext->filePathMaxSize ) == 0 )
+    {
+        xImageFormat = OTA_PAL_IMAGE_LZ4;
+    }
 
     /* Handle back to back updates */
     if( ( pxContext->xPalState == OTA_PAL_ACCEPTED ) ||
@@ -806,7 +1828,7 @@ OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
     {
         uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileTooLarge, 0 );
     }
-    else if( strncmp( "b_u585i_iot02a_ntz.bin", ( char * ) pxFileContext->pFilePath, pxFileContext->filePathMaxSize ) != 0 )
+    else if( xImageFormat == OTA_PAL_IMAGE_INVALID )
     {
         uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
     }
@@ -836,18 +1858,49 @@ OtaPalStatus_t otaPal_CreateFileForRx( OtaFileContext_t * const pxFileContext )
             }
         }
 
-        if( ( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess ) &&
-            ( prvEraseBank( ulTargetBank ) != pdTRUE ) )
-        {
-            uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalRxFileCreateFailed, 0 );
-        }
-
         if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
         {
+            ( void ) memset( &xPalStats, 0, sizeof( xPalStats ) );
+            xPalStats.ulCreateTime = OTA_PAL_STATS_NOW();
+
             pxContext->ulTargetBank = ulTargetBank;
             pxContext->ulPendingBank = prvGetActiveBank();
             pxContext->ulBaseAddress = FLASH_START_INACTIVE_BANK;
             pxContext->ulImageSize = pxFileContext->fileSize;
+            pxContext->xImageFormat = xImageFormat;
+            pxContext->ulBlocksSinceCheckpoint = 0;
+
+            ( void ) memset( pxContext->cJobName, 0, sizeof( pxContext->cJobName ) );
+
+            if( pxFileContext->pJobName != NULL )
+            {
+                ( void ) strncpy( pxContext->cJobName, ( const char * ) pxFileContext->pJobName, sizeof( pxContext->cJobName ) - 1 );
+            }
+
+            prvImageHashStart( pxContext );
+
+            if( xImageFormat == OTA_PAL_IMAGE_RAW )
+            {
+                /* Pages of the staging bank are erased as blocks are first written to them, unless restored from a checkpoint */
+                uint32_t ulResumedBlocks = prvProgressRestore( pxContext, pxFileContext );
+
+                if( ulResumedBlocks > 0 )
+                {
+                    LogInfo( "Resuming download of job %s with %lu blocks already staged.", pxContext->cJobName, ulResumedBlocks );
+                }
+            }
+            else
+            {
+                /* Decoder state is not checkpointed, so delta and compressed downloads start over */
+                prvResetErasedPages( pxContext );
+                prvProgressDelete();
+
+                prvDecodeStart( pxContext );
+            }
+        }
+
+        if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
+        {
             pxContext->xPalState = OTA_PAL_FILE_OPEN;
             pxFileContext->pFile = pxContext;
         }
@@ -897,9 +1950,54 @@ int16_t otaPal_WriteBlock( OtaFileContext_t * const pxFileContext,
     {
         LogError( "pData is NULL." );
     }
-    else if( prvWriteToFlash( ( pxContext->ulBaseAddress + offset ), pData, blockSize ) == HAL_OK )
+    else if( pxContext->xImageFormat != OTA_PAL_IMAGE_RAW )
+    {
+        /* Only blocks received ahead of the cursor are staged in the file system. In order blocks go
+         * straight to the decoder, followed by the staged blocks the cursor has caught up with. */
+        if( ( offset + blockSize ) <= pxContext->ulStreamedLength )
+        {
+            sBytesWritten = ( int16_t ) blockSize;
+        }
+        else if( offset <= pxContext->ulStreamedLength )
+        {
+            uint32_t ulSkip = pxContext->ulStreamedLength - offset;
+
+            if( ( prvDecodeFeed( pxContext, &( pData[ ulSkip ] ), blockSize - ulSkip ) == pdTRUE ) &&
+                ( prvDecodeDrainStaged( pxContext ) == pdTRUE ) )
+            {
+                sBytesWritten = ( int16_t ) blockSize;
+            }
+        }
+        else if( prvStagingFileWrite( pxContext, offset, pData, blockSize ) == pdTRUE )
+        {
+            uint32_t ulBlock = offset / otaconfigFILE_BLOCK_SIZE;
+
+            pxContext->ulReceivedBlocks[ ulBlock / 32UL ] |= ( 1UL << ( ulBlock % 32UL ) );
+            sBytesWritten = ( int16_t ) blockSize;
+        }
+        else
+        {
+            /* Empty */
+        }
+    }
+    else if( prvStageToFlash( pxContext, offset, pData, blockSize ) == HAL_OK )
     {
         sBytesWritten = ( int16_t ) blockSize;
+
+        prvMarkBlockReceived( pxContext, offset );
+
+        /* Blocks received ahead of the cursor are picked up when the image is closed */
+        if( offset <= pxContext->ulHashedLength )
+        {
+            prvImageHashUpdate( pxContext, offset + blockSize );
+        }
+    }
+
+    if( sBytesWritten > 0 )
+    {
+        xPalStats.ulBlocksWritten++;
+        xPalStats.ulBytesWritten += ( uint32_t ) sBytesWritten;
+        xPalStats.ulLastWriteTime = OTA_PAL_STATS_NOW();
     }
 
     return sBytesWritten;
@@ -921,13 +2019,38 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
     {
         unsigned char pucHashBuffer[ MBEDTLS_MD_MAX_SIZE ];
         size_t uxHashLength = 0;
+        uint32_t ulSignedLength = pxContext->ulImageSize;
 
-        if( xCalculateImageHash( ( unsigned char * ) ( pxContext->ulBaseAddress ),
-                                 ( size_t ) pxContext->ulImageSize,
-                                 pucHashBuffer, MBEDTLS_MD_MAX_SIZE, &uxHashLength ) != pdTRUE )
+        if( ( pxContext->xImageFormat != OTA_PAL_IMAGE_RAW ) &&
+            ( prvDecodeFinish( pxContext ) != pdTRUE ) )
         {
+            prvImageHashFree( pxContext );
             uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
         }
+        else
+        {
+            /* The signature of a compressed image covers the decompressed image */
+            if( pxContext->xImageFormat == OTA_PAL_IMAGE_LZ4 )
+            {
+                ulSignedLength = pxContext->ulOutputLength;
+            }
+
+            if( prvImageHashFinish( pxContext, ulSignedLength, pucHashBuffer, MBEDTLS_MD_MAX_SIZE, &uxHashLength ) == pdTRUE )
+            {
+                /* Running hash covers the whole signed length */
+            }
+            else if( pxContext->xImageFormat == OTA_PAL_IMAGE_DELTA )
+            {
+                /* The received delta is no longer available to hash */
+                uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+            }
+            else if( xCalculateImageHash( ( unsigned char * ) ( pxContext->ulBaseAddress ),
+                                          ( size_t ) ulSignedLength,
+                                          pucHashBuffer, MBEDTLS_MD_MAX_SIZE, &uxHashLength ) != pdTRUE )
+            {
+                uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
+            }
+        }
 
         if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
         {
@@ -940,7 +2063,9 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
 
         if( OTA_PAL_MAIN_ERR( uxOtaStatus ) == OtaPalSuccess )
         {
+            LogInfo( "Staged image using %lu of %lu pages of the staging bank.", pxContext->ulErasedPageCount, FLASH_PAGE_NB );
             pxContext->xPalState = OTA_PAL_PENDING_ACTIVATION;
+            prvProgressDelete();
         }
         else
         {
@@ -956,6 +2081,8 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
         uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalFileClose, 0 );
     }
 
+    xPalStats.ulCloseTime = OTA_PAL_STATS_NOW();
+
     return uxOtaStatus;
 }
 
@@ -963,6 +2090,13 @@ OtaPalStatus_t otaPal_CloseFile( OtaFileContext_t * const pxFileContext )
 OtaPalStatus_t otaPal_Abort( OtaFileContext_t * const pxFileContext )
 {
     OtaPalStatus_t palStatus = otaPal_SetPlatformImageState( pxFileContext, OtaImageStateAborted );
+    OtaPalContext_t * pxContext = prvGetImageContext();
+
+    if( pxContext != NULL )
+    {
+        prvImageHashFree( pxContext );
+        prvStagingFileClose( pxContext );
+    }
 
     pxFileContext->pFile = NULL;
 
@@ -1111,7 +2245,7 @@ OtaPalStatus_t otaPal_SetPlatformImageState( OtaFileContext_t * const pxFileCont
                     case OTA_PAL_FILE_OPEN:
                         pxContext->ulPendingBank = ulGetOtherBank( pxContext->ulTargetBank );
 
-                        if( ( prvEraseBank( pxContext->ulTargetBank ) == pdTRUE ) &&
+                        if( ( prvEraseStagingBank( pxContext ) == pdTRUE ) &&
                             ( prvDeletePalNvContext() == pdTRUE ) )
                         {
                             uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
@@ -1183,7 +2317,7 @@ OtaPalStatus_t otaPal_SetPlatformImageState( OtaFileContext_t * const pxFileCont
                         /* Clear any pending bank swap */
                         pxContext->ulPendingBank = prvGetActiveBank();
 
-                        if( ( prvEraseBank( pxContext->ulTargetBank ) == pdTRUE ) &&
+                        if( ( prvEraseStagingBank( pxContext ) == pdTRUE ) &&
                             ( prvDeletePalNvContext() == pdTRUE ) )
                         {
                             uxOtaStatus = OTA_PAL_COMBINE_ERR( OtaPalSuccess, 0 );
@@ -1356,3 +2490,12 @@ OtaPalStatus_t otaPal_ResetDevice( OtaFileContext_t * const pxFileContext )
 
     return uxStatus;
 }
+
+void vOtaPalGetStats( OtaPalStats_t * pxStats )
+{
+    configASSERT( pxStats != NULL );
+
+    taskENTER_CRITICAL();
+    ( void ) memcpy( pxStats, &xPalStats, sizeof( OtaPalStats_t ) );
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,367 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * littlefs benchmark for the lfs_config of each port in Projects/b_u585i_iot02a_ntz/Src/fs. littlefs
+ * is built for the host and mounted through the unmodified ports, on top of the RAM models of the
+ * MX25LM51245G (mx25lm_sim.c) and of the STM32U5 internal flash (stm32u5_flash_sim.c). The models
+ * charge each program, erase and read its typical duration, and the benchmark reports that device time
+ * rather than host time, so the figures are repeatable.
+ *
+ * Each workload rewrites its files a number of times on a freshly formatted volume and reports:
+ *  - the bytes written by the application and the device time taken, as throughput;
+ *  - write amplification, the bytes programmed on the device per byte written, including the
+ *    metadata and any port bookkeeping such as the internal flash erase count journal;
+ *  - the number of erases and the highest erase count of any one block.
+ *
+ * Usage: fsbench [ospi | internal]... [kv | pkcs11 | ota]...
+ * All ports and workloads are run when none are given.
+ */
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "lfs.h"
+#include "lfs_port.h"
+#include "ospi_nor_mx25lmxxx45g.h"
+
+#include "mx25lm_sim.h"
+#include "stm32u5_flash_sim.h"
+
+#define TEST_CHECK( x )           configASSERT( x )
+
+#define FSBENCH_DIR               "/bench"
+#define FSBENCH_PATH_LEN          32
+
+/* Matches otaconfigFILE_BLOCK_SIZE */
+#define FSBENCH_OTA_BLOCK_SIZE    2048
+#define FSBENCH_MAX_WRITE         ( 4 * 1024 )
+
+/* Each workload rewrites uxFileCount files uxIterations times, in uxWriteSize chunks */
+typedef struct
+{
+    const char * pcName;
+    size_t uxFileCount;
+    size_t uxFileSize;
+    size_t uxWriteSize;
+    size_t uxIterations;
+} FsBenchWorkload_t;
+
+static const FsBenchWorkload_t xWorkloads[] =
+{
+    /* KVStore commit: small TLV value rewritten with O_TRUNC */
+    { "kv",     1, 72,         72,                     256 },
+    /* PKCS#11 object: certificate sized objects written in one call */
+    { "pkcs11", 4, 1200,       1200,                   16  },
+    /* OTA staging: one large image streamed in OTA block sized writes */
+    { "ota",    1, 256 * 1024, FSBENCH_OTA_BLOCK_SIZE, 2   },
+};
+
+#define FSBENCH_NUM_WORKLOADS    ( sizeof( xWorkloads ) / sizeof( xWorkloads[ 0 ] ) )
+
+/* Device counters, read from the model behind each port */
+typedef struct
+{
+    uint64_t ullBusyNs;
+    uint64_t ullProgBytes;
+    uint32_t ulErases;
+    const uint32_t * pulEraseCounts;
+    size_t uxEraseCountLen;
+} FsBenchCounters_t;
+
+typedef struct
+{
+    const char * pcName;
+    const struct lfs_config * ( *pxInitialize )( void );
+    void ( * vGetCounters )( FsBenchCounters_t * pxCounters );
+} FsBenchPort_t;
+
+static const struct lfs_config * prvMountOspi( void )
+{
+    return pxInitializeOSPIFlashFs( portMAX_DELAY );
+}
+
+static void prvGetOspiCounters( FsBenchCounters_t * pxCounters )
+{
+    pxCounters->ullBusyNs = xMx25lmSim.ullBusyNs;
+    pxCounters->ullProgBytes = xMx25lmSim.ulProgramBytes;
+    pxCounters->ulErases = xMx25lmSim.ulSectorErases;
+    pxCounters->pulEraseCounts = xMx25lmSim.ulSectorEraseCounts;
+    pxCounters->uxEraseCountLen = MX25LM_SIM_SECTOR_COUNT;
+}
+
+static const struct lfs_config * prvMountInternal( void )
+{
+    return pxInitializeInternalFlashFs( portMAX_DELAY );
+}
+
+static void prvGetInternalCounters( FsBenchCounters_t * pxCounters )
+{
+    pxCounters->ullBusyNs = xFlashSimStats.ullBusyNs;
+    pxCounters->ullProgBytes = ( ( uint64_t ) xFlashSimStats.ulQuadWordPrograms * 16 ) +
+                               ( ( uint64_t ) xFlashSimStats.ulBurstPrograms * 128 );
+    pxCounters->ulErases = xFlashSimStats.ulPageErases;
+    pxCounters->pulEraseCounts = xFlashSimStats.ulPageEraseCounts;
+    pxCounters->uxEraseCountLen = FLASH_SIZE / FLASH_PAGE_SIZE;
+}
+
+static const FsBenchPort_t xPorts[] =
+{
+    { "ospi",     prvMountOspi,     prvGetOspiCounters     },
+    { "internal", prvMountInternal, prvGetInternalCounters },
+};
+
+#define FSBENCH_NUM_PORTS    ( sizeof( xPorts ) / sizeof( xPorts[ 0 ] ) )
+
+static uint8_t ucWriteBuffer[ FSBENCH_MAX_WRITE ];
+static uint32_t ulEraseCountsBefore[ MX25LM_SIM_SECTOR_COUNT ];
+
+static BaseType_t xPortSelected[ FSBENCH_NUM_PORTS ];
+static BaseType_t xWorkloadSelected[ FSBENCH_NUM_WORKLOADS ];
+
+static int prvWriteFile( lfs_t * pxLfs,
+                         const char * pcPath,
+                         const FsBenchWorkload_t * pxWorkload )
+{
+    lfs_file_t xFile = { 0 };
+    int lError = lfs_file_open( pxLfs, &xFile, pcPath, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC );
+
+    if( lError == LFS_ERR_OK )
+    {
+        size_t uxWritten = 0;
+
+        while( ( lError == LFS_ERR_OK ) &&
+               ( uxWritten < pxWorkload->uxFileSize ) )
+        {
+            size_t uxChunk = pxWorkload->uxFileSize - uxWritten;
+            lfs_ssize_t lResult;
+
+            uxChunk = ( uxChunk > pxWorkload->uxWriteSize ) ? pxWorkload->uxWriteSize : uxChunk;
+
+            lResult = lfs_file_write( pxLfs, &xFile, ucWriteBuffer, uxChunk );
+
+            if( lResult == ( lfs_ssize_t ) uxChunk )
+            {
+                uxWritten += uxChunk;
+            }
+            else
+            {
+                lError = ( lResult < 0 ) ? lResult : LFS_ERR_NOSPC;
+            }
+        }
+
+        int lCloseError = lfs_file_close( pxLfs, &xFile );
+
+        lError = ( lError == LFS_ERR_OK ) ? lCloseError : lError;
+    }
+
+    return lError;
+}
+
+static void prvRunWorkload( const FsBenchPort_t * pxPort,
+                            const struct lfs_config * pxCfg,
+                            const FsBenchWorkload_t * pxWorkload )
+{
+    static lfs_t xLfs;
+    char pcPath[ FSBENCH_PATH_LEN ] = { 0 };
+    FsBenchCounters_t xBefore = { 0 };
+    FsBenchCounters_t xAfter = { 0 };
+    uint32_t ulMaxBlockErases = 0;
+    int lError;
+
+    TEST_CHECK( pxWorkload->uxWriteSize <= FSBENCH_MAX_WRITE );
+
+    /* Start from a freshly formatted volume, so the workloads are independent */
+    lError = lfs_format( &xLfs, pxCfg );
+    lError = ( lError == LFS_ERR_OK ) ? lfs_mount( &xLfs, pxCfg ) : lError;
+    lError = ( lError == LFS_ERR_OK ) ? lfs_mkdir( &xLfs, FSBENCH_DIR ) : lError;
+
+    pxPort->vGetCounters( &xBefore );
+    ( void ) memcpy( ulEraseCountsBefore, xBefore.pulEraseCounts, xBefore.uxEraseCountLen * sizeof( uint32_t ) );
+
+    for( size_t uxIter = 0; ( uxIter < pxWorkload->uxIterations ) && ( lError == LFS_ERR_OK ); uxIter++ )
+    {
+        for( size_t uxFile = 0; ( uxFile < pxWorkload->uxFileCount ) && ( lError == LFS_ERR_OK ); uxFile++ )
+        {
+            ( void ) snprintf( pcPath, FSBENCH_PATH_LEN, FSBENCH_DIR "/%s_%lu",
+                               pxWorkload->pcName, ( unsigned long ) uxFile );
+
+            /* Vary the content between rewrites */
+            ucWriteBuffer[ 0 ] = ( uint8_t ) uxIter;
+
+            lError = prvWriteFile( &xLfs, pcPath, pxWorkload );
+        }
+    }
+
+    pxPort->vGetCounters( &xAfter );
+
+    for( size_t uxIdx = 0; uxIdx < xAfter.uxEraseCountLen; uxIdx++ )
+    {
+        uint32_t ulErases = xAfter.pulEraseCounts[ uxIdx ] - ulEraseCountsBefore[ uxIdx ];
+
+        ulMaxBlockErases = ( ulErases > ulMaxBlockErases ) ? ulErases : ulMaxBlockErases;
+    }
+
+    ( void ) lfs_unmount( &xLfs );
+
+    if( lError != LFS_ERR_OK )
+    {
+        printf( "%-9s %-8s Error: littlefs returned %d.\n", pxPort->pcName, pxWorkload->pcName, lError );
+    }
+    else
+    {
+        uint64_t ullUserBytes = ( uint64_t ) pxWorkload->uxFileCount * pxWorkload->uxFileSize * pxWorkload->uxIterations;
+        uint64_t ullBusyUs = ( xAfter.ullBusyNs - xBefore.ullBusyNs ) / 1000;
+        uint64_t ullProgBytes = xAfter.ullProgBytes - xBefore.ullProgBytes;
+        uint64_t ullWriteAmp = ( ullProgBytes * 100 ) / ullUserBytes;
+
+        ullBusyUs = ( ullBusyUs == 0 ) ? 1 : ullBusyUs;
+
+        printf( "%-9s %-8s %9llu %9llu.%03llu %8llu %4llu.%02llu %10llu %7lu %6lu\n",
+                pxPort->pcName,
+                pxWorkload->pcName,
+                ( unsigned long long ) ullUserBytes,
+                ( unsigned long long ) ( ullBusyUs / 1000 ),
+                ( unsigned long long ) ( ullBusyUs % 1000 ),
+                ( unsigned long long ) ( ( ullUserBytes * 1000000 ) / ( ullBusyUs * 1024 ) ),
+                ( unsigned long long ) ( ullWriteAmp / 100 ),
+                ( unsigned long long ) ( ullWriteAmp % 100 ),
+                ( unsigned long long ) ullProgBytes,
+                ( unsigned long ) ( xAfter.ulErases - xBefore.ulErases ),
+                ( unsigned long ) ulMaxBlockErases );
+    }
+}
+
+static void prvRunBenchmarks( void * pvArg )
+{
+    ( void ) pvArg;
+
+    for( size_t uxIdx = 0; uxIdx < FSBENCH_MAX_WRITE; uxIdx++ )
+    {
+        ucWriteBuffer[ uxIdx ] = ( uint8_t ) ( uxIdx * 31 );
+    }
+
+    for( size_t uxPort = 0; uxPort < FSBENCH_NUM_PORTS; uxPort++ )
+    {
+        if( xPortSelected[ uxPort ] == pdTRUE )
+        {
+            /* The port is initialized once, as at boot, and each workload formats the volume */
+            const struct lfs_config * pxCfg = xPorts[ uxPort ].pxInitialize();
+
+            TEST_CHECK( pxCfg != NULL );
+
+            printf( "%-9s blocks: %lu x %lu, read: %lu, prog: %lu, cache: %lu, lookahead: %lu, cycles: %ld\n",
+                    xPorts[ uxPort ].pcName,
+                    ( unsigned long ) pxCfg->block_count,
+                    ( unsigned long ) pxCfg->block_size,
+                    ( unsigned long ) pxCfg->read_size,
+                    ( unsigned long ) pxCfg->prog_size,
+                    ( unsigned long ) pxCfg->cache_size,
+                    ( unsigned long ) pxCfg->lookahead_size,
+                    ( long ) pxCfg->block_cycles );
+            printf( "Port      Workload      Bytes   Device ms     KB/s  W.Amp Prog bytes  Erases MaxBlk\n" );
+
+            for( size_t uxIdx = 0; uxIdx < FSBENCH_NUM_WORKLOADS; uxIdx++ )
+            {
+                if( xWorkloadSelected[ uxIdx ] == pdTRUE )
+                {
+                    prvRunWorkload( &( xPorts[ uxPort ] ), pxCfg, &( xWorkloads[ uxIdx ] ) );
+                }
+            }
+        }
+    }
+}
+
+/* Select the named ports and workloads, or all of either kind when none of it is named */
+static BaseType_t prvParseArgs( int argc,
+                                char * argv[] )
+{
+    BaseType_t xArgsValid = pdTRUE;
+    BaseType_t xAnyPort = pdFALSE;
+    BaseType_t xAnyWorkload = pdFALSE;
+
+    for( int lArg = 1; lArg < argc; lArg++ )
+    {
+        BaseType_t xFound = pdFALSE;
+
+        for( size_t uxIdx = 0; uxIdx < FSBENCH_NUM_PORTS; uxIdx++ )
+        {
+            if( strcmp( xPorts[ uxIdx ].pcName, argv[ lArg ] ) == 0 )
+            {
+                xPortSelected[ uxIdx ] = pdTRUE;
+                xAnyPort = pdTRUE;
+                xFound = pdTRUE;
+            }
+        }
+
+        for( size_t uxIdx = 0; uxIdx < FSBENCH_NUM_WORKLOADS; uxIdx++ )
+        {
+            if( strcmp( xWorkloads[ uxIdx ].pcName, argv[ lArg ] ) == 0 )
+            {
+                xWorkloadSelected[ uxIdx ] = pdTRUE;
+                xAnyWorkload = pdTRUE;
+                xFound = pdTRUE;
+            }
+        }
+
+        if( xFound == pdFALSE )
+        {
+            fprintf( stderr, "Unrecognized port or workload: %s\n", argv[ lArg ] );
+            xArgsValid = pdFALSE;
+        }
+    }
+
+    for( size_t uxIdx = 0; ( xAnyPort == pdFALSE ) && ( uxIdx < FSBENCH_NUM_PORTS ); uxIdx++ )
+    {
+        xPortSelected[ uxIdx ] = pdTRUE;
+    }
+
+    for( size_t uxIdx = 0; ( xAnyWorkload == pdFALSE ) && ( uxIdx < FSBENCH_NUM_WORKLOADS ); uxIdx++ )
+    {
+        xWorkloadSelected[ uxIdx ] = pdTRUE;
+    }
+
+    return xArgsValid;
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int lResult = 1;
+
+    if( prvParseArgs( argc, argv ) == pdTRUE )
+    {
+        /* Map both devices before the heap is limited to brk, then keep littlefs buffers below 4 GiB for the flash HAL */
+        vMx25lmSimInit();
+        vFlashSimInit();
+        ( void ) mallopt( M_MMAP_MAX, 0 );
+
+        TEST_CHECK( xFlashSimRun( prvRunBenchmarks, NULL ) == pdPASS );
+        lResult = 0;
+    }
+
+    return lResult;
+}
@@ -0,0 +1,407 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Drive Projects/b_u585i_iot02a_ntz/Src/fs/lfs_port_internal_nor.c against the RAM model of the
+ * STM32U5 internal flash in stm32u5_flash_sim.c. The port is included directly so that the tests
+ * can reach prvProgramFlash and the erase count page layout.
+ *
+ * Usage: internal_nor_test
+ */
+#include "lfs_port_internal_nor.c"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "stm32u5_flash_sim.h"
+
+#define TEST_CHECK( x )       configASSERT( x )
+
+#define TEST_BANK_OFFSET( ulOffset )    ( CONFIG_LFS_FLASH_BASE + ( ulOffset ) )
+#define TEST_WEAR_FLASH_PAGE            ( FLASH_PAGE_NB + LFS_PORT_WEAR_PAGE )
+
+static uint8_t * pucPattern = NULL;
+
+static uint8_t ucQuadWord[ 16 ] __attribute__( ( aligned( 16 ) ) );
+
+/* Bursts are used where the destination is burst aligned, quad-words everywhere else */
+static void prvTestProgramAlignment( void )
+{
+    vFlashSimInit();
+
+    for( uint32_t ulIdx = 0; ulIdx < FLASH_PAGE_SIZE; ulIdx++ )
+    {
+        pucPattern[ ulIdx ] = ( uint8_t ) ( ulIdx * 7 );
+    }
+
+    ( void ) HAL_FLASH_Unlock();
+
+    /* 7 quad-words up to the first burst boundary, one burst, then a 32 byte tail */
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( 0x10 ), pucPattern, 0x110 ) == HAL_OK );
+    TEST_CHECK( xFlashSimStats.ulBurstPrograms == 1 );
+    TEST_CHECK( xFlashSimStats.ulQuadWordPrograms == 9 );
+    TEST_CHECK( memcmp( ( const void * ) TEST_BANK_OFFSET( 0x10 ), pucPattern, 0x110 ) == 0 );
+
+    /* A whole page is programmed in bursts */
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( FLASH_PAGE_SIZE ), pucPattern, FLASH_PAGE_SIZE ) == HAL_OK );
+    TEST_CHECK( xFlashSimStats.ulBurstPrograms == 1 + ( FLASH_PAGE_SIZE / LFS_PORT_BURST_SIZE ) );
+    TEST_CHECK( xFlashSimStats.ulQuadWordPrograms == 9 );
+
+    /* A short aligned region never uses a burst */
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( 2 * FLASH_PAGE_SIZE ), pucPattern, LFS_PORT_BURST_SIZE - LFS_CONFIG_PROG_SIZE ) == HAL_OK );
+    TEST_CHECK( xFlashSimStats.ulBurstPrograms == 1 + ( FLASH_PAGE_SIZE / LFS_PORT_BURST_SIZE ) );
+    TEST_CHECK( xFlashSimStats.ulQuadWordPrograms == 16 );
+    TEST_CHECK( xFlashSimStats.ulErrors == 0 );
+
+    /* The model rejects programming a quad-word twice, and the error sticks until cleared */
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( 0x10 ), pucPattern, LFS_CONFIG_PROG_SIZE ) != HAL_OK );
+    TEST_CHECK( ( ulFlashSimGetFlags() & FLASH_SIM_PROGERR ) != 0 );
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( 3 * FLASH_PAGE_SIZE ), pucPattern, LFS_CONFIG_PROG_SIZE ) != HAL_OK );
+    __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
+    TEST_CHECK( prvProgramFlash( TEST_BANK_OFFSET( 3 * FLASH_PAGE_SIZE ), pucPattern, LFS_CONFIG_PROG_SIZE ) == HAL_OK );
+
+    ( void ) HAL_FLASH_Lock();
+
+    printf( "program alignment: %lu bursts, %lu quad-words\n",
+            ( unsigned long ) xFlashSimStats.ulBurstPrograms,
+            ( unsigned long ) xFlashSimStats.ulQuadWordPrograms );
+}
+
+/* Mount the port as a reboot would, checking the block device is usable */
+static const struct lfs_config * prvBoot( void )
+{
+    const struct lfs_config * pxCfg = pxInitializeInternalFlashFs( portMAX_DELAY );
+
+    TEST_CHECK( pxCfg != NULL );
+    TEST_CHECK( xWearInitialized == pdTRUE );
+
+    return pxCfg;
+}
+
+static void prvErase( const struct lfs_config * pxCfg,
+                      lfs_block_t xBlock,
+                      uint32_t ulTimes )
+{
+    TEST_CHECK( pxCfg->lock( pxCfg ) == 0 );
+
+    for( uint32_t ulIdx = 0; ulIdx < ulTimes; ulIdx++ )
+    {
+        TEST_CHECK( pxCfg->erase( pxCfg, xBlock ) == 0 );
+    }
+
+    TEST_CHECK( pxCfg->unlock( pxCfg ) == 0 );
+}
+
+/* Reboot and check the erase counts read back from flash match those held before the reboot */
+static const struct lfs_config * prvRebootAndCompare( void )
+{
+    static uint32_t ulBefore[ WEAR_SNAPSHOT_LEN / sizeof( uint32_t ) ];
+    const struct lfs_config * pxCfg;
+
+    ( void ) memcpy( ulBefore, ulEraseCounts, sizeof( ulBefore ) );
+    ( void ) memset( ulEraseCounts, 0xA5, sizeof( ulEraseCounts ) );
+
+    pxCfg = prvBoot();
+
+    TEST_CHECK( memcmp( ulBefore, ulEraseCounts, sizeof( ulBefore ) ) == 0 );
+
+    return pxCfg;
+}
+
+/* Erases are journalled, survive a reboot, and a full journal is folded into a new snapshot */
+static void prvTestJournal( void )
+{
+    const struct lfs_config * pxCfg;
+    uint32_t ulEntries;
+
+    vFlashSimInit();
+
+    /* A blank page is not valid, so the first boot writes a snapshot */
+    pxCfg = prvBoot();
+    TEST_CHECK( pxCfg->block_count == LFS_PORT_BLOCK_COUNT );
+    TEST_CHECK( xWearPersistent == pdTRUE );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ TEST_WEAR_FLASH_PAGE ] == 1 );
+    TEST_CHECK( ulEraseCounts[ LFS_PORT_WEAR_PAGE ] == 1 );
+    TEST_CHECK( ulJournalIdx == 0 );
+
+    prvErase( pxCfg, 3, 5 );
+    prvErase( pxCfg, 7, 1 );
+    TEST_CHECK( ulEraseCounts[ 3 ] == 5 );
+    TEST_CHECK( ulEraseCounts[ 7 ] == 1 );
+    TEST_CHECK( ulJournalIdx == 6 );
+
+    pxCfg = prvRebootAndCompare();
+    TEST_CHECK( ulJournalIdx == 6 );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ TEST_WEAR_FLASH_PAGE ] == 1 );
+
+    /* Fill the journal, then wrap into a new snapshot with one more erase */
+    ulEntries = WEAR_JOURNAL_ENTRIES - ulJournalIdx;
+    prvErase( pxCfg, 9, ulEntries );
+    TEST_CHECK( ulJournalIdx == WEAR_JOURNAL_ENTRIES );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ TEST_WEAR_FLASH_PAGE ] == 1 );
+
+    prvErase( pxCfg, 9, 1 );
+    TEST_CHECK( ulJournalIdx == 0 );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ TEST_WEAR_FLASH_PAGE ] == 2 );
+    TEST_CHECK( ulEraseCounts[ LFS_PORT_WEAR_PAGE ] == 2 );
+    TEST_CHECK( ulEraseCounts[ 9 ] == ulEntries + 1 );
+
+    prvErase( pxCfg, 3, 2 );
+    pxCfg = prvRebootAndCompare();
+    TEST_CHECK( ulJournalIdx == 2 );
+    TEST_CHECK( ulEraseCounts[ 3 ] == 7 );
+
+    /* The counts kept by the port agree with the erases the flash saw */
+    for( uint32_t ulBlock = 0; ulBlock <= LFS_PORT_WEAR_PAGE; ulBlock++ )
+    {
+        TEST_CHECK( ulEraseCounts[ ulBlock ] == xFlashSimStats.ulPageEraseCounts[ FLASH_PAGE_NB + ulBlock ] );
+    }
+
+    /* Bank 1 holds the running image and must never be touched */
+    for( uint32_t ulPage = 0; ulPage < FLASH_PAGE_NB; ulPage++ )
+    {
+        TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ ulPage ] == 0 );
+    }
+
+    TEST_CHECK( xFlashSimStats.ulErrors == 0 );
+
+    printf( "journal: %lu entries per page, wrapped after %lu erases\n",
+            ( unsigned long ) WEAR_JOURNAL_ENTRIES, ( unsigned long ) ( 6 + ulEntries + 1 ) );
+}
+
+/* A corrupt snapshot restarts the counts from zero and rewrites the page */
+static void prvTestCorruptSnapshot( void )
+{
+    const struct lfs_config * pxCfg;
+    uint32_t * pulSnapshot = ( uint32_t * ) WEAR_SNAPSHOT_ADDR;
+
+    vFlashSimInit();
+
+    pxCfg = prvBoot();
+    prvErase( pxCfg, 11, 4 );
+
+    /* Compact so that the counts are in the snapshot rather than the journal */
+    ( void ) HAL_FLASH_Unlock();
+    TEST_CHECK( prvWearCompact() == HAL_OK );
+    ( void ) HAL_FLASH_Lock();
+    TEST_CHECK( pulSnapshot[ 11 ] == 4 );
+
+    pulSnapshot[ 11 ] = 0;
+
+    pxCfg = prvBoot();
+    TEST_CHECK( ulEraseCounts[ 11 ] == 0 );
+    TEST_CHECK( ulEraseCounts[ LFS_PORT_WEAR_PAGE ] == 1 );
+    TEST_CHECK( ulJournalIdx == 0 );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ TEST_WEAR_FLASH_PAGE ] == 3 );
+
+    /* A torn journal entry is skipped, and later entries still apply */
+    prvErase( pxCfg, 12, 2 );
+    ( ( WearJournalEntry_t * ) WEAR_JOURNAL_ADDR )[ 0 ].ulEraseCountInv = 0;
+
+    pxCfg = prvBoot();
+    TEST_CHECK( ulEraseCounts[ 12 ] == 2 );
+    TEST_CHECK( ulJournalIdx == 2 );
+
+    TEST_CHECK( xFlashSimStats.ulErrors == 0 );
+
+    printf( "corrupt snapshot: counts restarted, torn journal entry skipped\n" );
+}
+
+/* Write the superblock fields xIsLegacyVolume reads into one of the first two blocks */
+static void prvWriteSuperblock( lfs_block_t xBlock,
+                                uint32_t ulBlockCount )
+{
+    uint8_t * pucBlock = ( uint8_t * ) ( CONFIG_LFS_FLASH_BASE + ( xBlock * FLASH_PAGE_SIZE ) );
+    uint32_t ulBlockSize = lfs_tole32( FLASH_PAGE_SIZE );
+
+    ulBlockCount = lfs_tole32( ulBlockCount );
+
+    ( void ) memcpy( &( pucBlock[ LFS_SUPERBLOCK_MAGIC_OFFSET ] ), "littlefs", 8 );
+    ( void ) memcpy( &( pucBlock[ LFS_SUPERBLOCK_BLOCK_SIZE_OFFSET ] ), &ulBlockSize, sizeof( uint32_t ) );
+    ( void ) memcpy( &( pucBlock[ LFS_SUPERBLOCK_BLOCK_COUNT_OFFSET ] ), &ulBlockCount, sizeof( uint32_t ) );
+}
+
+/* Volumes spanning the whole bank keep their geometry, and the last page is left to the filesystem */
+static void prvTestLegacyVolume( void )
+{
+    const struct lfs_config * pxCfg;
+    uint8_t ucLastPage[ 64 ];
+
+    for( lfs_block_t xSuperblock = 0; xSuperblock < 2; xSuperblock++ )
+    {
+        vFlashSimInit();
+        prvWriteSuperblock( xSuperblock, LFS_PORT_LEGACY_BLOCK_COUNT );
+
+        /* Data the filesystem holds in what is the erase count page of a new volume */
+        ( void ) memset( ucLastPage, 0x5A, sizeof( ucLastPage ) );
+        ( void ) memcpy( ( void * ) LFS_PORT_WEAR_PAGE_ADDR, ucLastPage, sizeof( ucLastPage ) );
+
+        pxCfg = prvBoot();
+        TEST_CHECK( xWearPersistent == pdFALSE );
+        TEST_CHECK( pxCfg->block_count == LFS_PORT_LEGACY_BLOCK_COUNT );
+        TEST_CHECK( memcmp( ( const void * ) LFS_PORT_WEAR_PAGE_ADDR, ucLastPage, sizeof( ucLastPage ) ) == 0 );
+
+        /* Erases are counted in RAM only */
+        prvErase( pxCfg, 5, 3 );
+        prvErase( pxCfg, LFS_PORT_WEAR_PAGE, 1 );
+        TEST_CHECK( ulEraseCounts[ 5 ] == 3 );
+        TEST_CHECK( ulEraseCounts[ LFS_PORT_WEAR_PAGE ] == 1 );
+        TEST_CHECK( xFlashSimStats.ulQuadWordPrograms + xFlashSimStats.ulBurstPrograms == 0 );
+        TEST_CHECK( xFlashSimStats.ulErrors == 0 );
+    }
+
+    /* A volume formatted with the reserved page is not legacy */
+    vFlashSimInit();
+    prvWriteSuperblock( 0, LFS_PORT_BLOCK_COUNT );
+    pxCfg = prvBoot();
+    TEST_CHECK( xWearPersistent == pdTRUE );
+    TEST_CHECK( pxCfg->block_count == LFS_PORT_BLOCK_COUNT );
+
+    /* Neither is a volume with another block size */
+    vFlashSimInit();
+    prvWriteSuperblock( 0, LFS_PORT_LEGACY_BLOCK_COUNT );
+    ( ( uint8_t * ) CONFIG_LFS_FLASH_BASE )[ LFS_SUPERBLOCK_BLOCK_SIZE_OFFSET + 1 ] = 0x10;
+    pxCfg = prvBoot();
+    TEST_CHECK( xWearPersistent == pdTRUE );
+
+    TEST_CHECK( xFlashSimStats.ulErrors == 0 );
+
+    printf( "legacy volume: detected from either superblock\n" );
+}
+
+static void prvRunTests( void * pvArg )
+{
+    ( void ) pvArg;
+
+    pucPattern = pvFlashSimAlloc( FLASH_PAGE_SIZE );
+
+    prvTestProgramAlignment();
+    prvTestJournal();
+    prvTestCorruptSnapshot();
+    prvTestLegacyVolume();
+}
+
+/* First boot: program both banks, then request the swap, which only applies once the option bytes are launched */
+static void prvBootBeforeSwap( void )
+{
+    FLASH_OBProgramInitTypeDef xOb = { 0 };
+
+    HAL_FLASHEx_OBGetConfig( &xOb );
+    TEST_CHECK( ( xOb.USERConfig & OB_DUALBANK_DUAL ) == OB_DUALBANK_DUAL );
+    TEST_CHECK( ( xOb.USERConfig & OB_SWAP_BANK_ENABLE ) == 0 );
+
+    ( void ) HAL_FLASH_Unlock();
+    ( void ) memset( ucQuadWord, 0x11, sizeof( ucQuadWord ) );
+    TEST_CHECK( HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, FLASH_BASE, ( uint32_t ) ucQuadWord ) == HAL_OK );
+    ( void ) memset( ucQuadWord, 0x22, sizeof( ucQuadWord ) );
+    TEST_CHECK( HAL_FLASH_Program( FLASH_TYPEPROGRAM_QUADWORD, FLASH_BASE + FLASH_BANK_SIZE, ( uint32_t ) ucQuadWord ) == HAL_OK );
+
+    xOb.OptionType = OPTIONBYTE_USER;
+    xOb.USERType = OB_USER_SWAP_BANK;
+    xOb.USERConfig = OB_SWAP_BANK_ENABLE;
+    TEST_CHECK( HAL_FLASHEx_OBProgram( &xOb ) == HAL_ERROR );
+    TEST_CHECK( HAL_FLASH_GetError() == FLASH_SIM_WRPERR );
+    __HAL_FLASH_CLEAR_FLAG( FLASH_FLAG_ALL_ERRORS );
+
+    TEST_CHECK( HAL_FLASH_OB_Unlock() == HAL_OK );
+    TEST_CHECK( HAL_FLASHEx_OBProgram( &xOb ) == HAL_OK );
+    TEST_CHECK( *( volatile uint8_t * ) FLASH_BASE == 0x11 );
+
+    ( void ) HAL_FLASH_OB_Launch();
+    TEST_CHECK( pdFALSE );
+}
+
+/* Second boot: bank 2 is mapped at FLASH_BASE, and erasing bank 1 clears the upper half */
+static void prvBootAfterSwap( void )
+{
+    FLASH_OBProgramInitTypeDef xOb = { 0 };
+    FLASH_EraseInitTypeDef xErase = { 0 };
+    uint32_t ulPageError = 0;
+
+    HAL_FLASHEx_OBGetConfig( &xOb );
+    TEST_CHECK( ( xOb.USERConfig & OB_SWAP_BANK_ENABLE ) == OB_SWAP_BANK_ENABLE );
+    TEST_CHECK( *( volatile uint8_t * ) FLASH_BASE == 0x22 );
+    TEST_CHECK( *( volatile uint8_t * ) ( FLASH_BASE + FLASH_BANK_SIZE ) == 0x11 );
+
+    xErase.TypeErase = FLASH_TYPEERASE_PAGES;
+    xErase.Banks = FLASH_BANK_1;
+    xErase.Page = 0;
+    xErase.NbPages = 1;
+    ( void ) HAL_FLASH_Unlock();
+    TEST_CHECK( HAL_FLASHEx_Erase( &xErase, &ulPageError ) == HAL_OK );
+    TEST_CHECK( *( volatile uint8_t * ) ( FLASH_BASE + FLASH_BANK_SIZE ) == 0xFF );
+    TEST_CHECK( *( volatile uint8_t * ) FLASH_BASE == 0x22 );
+    TEST_CHECK( xFlashSimStats.ulPageEraseCounts[ 0 ] == 1 );
+}
+
+static int prvBootProcess( const char * pcPath,
+                           void ( * pvBoot )( void ) )
+{
+    int lStatus = -1;
+    pid_t xPid = fork();
+
+    TEST_CHECK( xPid >= 0 );
+
+    if( xPid == 0 )
+    {
+        vFlashSimBoot( pcPath );
+        pvBoot();
+        _exit( 0 );
+    }
+
+    TEST_CHECK( waitpid( xPid, &lStatus, 0 ) == xPid );
+    TEST_CHECK( WIFEXITED( lStatus ) );
+
+    return WEXITSTATUS( lStatus );
+}
+
+/* The option bytes persist in the backing file with the array, and SWAP_BANK remaps the banks at boot */
+static void prvTestBankSwap( void )
+{
+    char cPath[] = "/tmp/internal_nor_test_XXXXXX";
+    int lFd = mkstemp( cPath );
+
+    TEST_CHECK( lFd >= 0 );
+    ( void ) close( lFd );
+
+    TEST_CHECK( prvBootProcess( cPath, prvBootBeforeSwap ) == FLASH_SIM_EXIT_RESET );
+    TEST_CHECK( prvBootProcess( cPath, prvBootAfterSwap ) == 0 );
+
+    ( void ) unlink( cPath );
+}
+
+int main( void )
+{
+    /* Before vFlashSimInit, as each boot maps the flash in a child process */
+    prvTestBankSwap();
+
+    vFlashSimInit();
+
+    TEST_CHECK( xFlashSimRun( prvRunTests, NULL ) == pdPASS );
+
+    printf( "internal_nor_test passed\n" );
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Declarations the littlefs ports need from lfs.h, so the port level tests build without the
+ * Middleware/ARM/littlefs submodule. tools/flash_sim.py uses the real header when it is checked out.
+ * The names and layout follow littlefs v2.
+ */
+#ifndef FLASH_HOST_LFS_H
+#define FLASH_HOST_LFS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lfs_util.h"
+
+typedef uint32_t   lfs_size_t;
+typedef uint32_t   lfs_off_t;
+typedef int32_t    lfs_ssize_t;
+typedef int32_t    lfs_soff_t;
+typedef uint32_t   lfs_block_t;
+
+typedef struct lfs lfs_t;
+
+enum lfs_error
+{
+    LFS_ERR_OK = 0,
+    LFS_ERR_IO = -5,
+    LFS_ERR_CORRUPT = -84,
+    LFS_ERR_NOENT = -2,
+    LFS_ERR_EXIST = -17,
+    LFS_ERR_INVAL = -22,
+    LFS_ERR_NOSPC = -28,
+    LFS_ERR_NOMEM = -12,
+};
+
+struct lfs_config
+{
+    void * context;
+    int ( * read )( const struct lfs_config * c,
+                    lfs_block_t block,
+                    lfs_off_t off,
+                    void * buffer,
+                    lfs_size_t size );
+    int ( * prog )( const struct lfs_config * c,
+                    lfs_block_t block,
+                    lfs_off_t off,
+                    const void * buffer,
+                    lfs_size_t size );
+    int ( * erase )( const struct lfs_config * c,
+                     lfs_block_t block );
+    int ( * sync )( const struct lfs_config * c );
+    #ifdef LFS_THREADSAFE
+        int ( * lock )( const struct lfs_config * c );
+        int ( * unlock )( const struct lfs_config * c );
+    #endif
+    lfs_size_t read_size;
+    lfs_size_t prog_size;
+    lfs_size_t block_size;
+    lfs_size_t block_count;
+    int32_t block_cycles;
+    lfs_size_t cache_size;
+    lfs_size_t lookahead_size;
+    void * read_buffer;
+    void * prog_buffer;
+    void * lookahead_buffer;
+    lfs_size_t name_max;
+    lfs_size_t file_max;
+    lfs_size_t attr_max;
+    lfs_size_t metadata_max;
+};
+
+#endif /* FLASH_HOST_LFS_H */
@@ -0,0 +1,918 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Model of the MX25LM51245G behind the OCTOSPI HAL shim and of DCACHE1 over its memory mapped window.
+ * See mx25lm_sim.h for the rules enforced.
+ *
+ * The window is a shared memory object mapped twice: read only at OCTOSPI2_BASE, where the driver reads
+ * it, and read write for the model, which fills it as the cache contents. Pages of the window holding
+ * an invalid line are kept inaccessible, and the SIGSEGV handler fills the invalid lines of a page from
+ * the device array on first access.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "stm32u5xx.h"
+#include "mx25lm_sim.h"
+
+#define MX25LM_SIM_PAGE_LEN          ( 256UL )
+#define MX25LM_SIM_SECTOR_LEN        ( 4096UL )
+#define MX25LM_SIM_DEFAULT_BUSY      ( 3UL )
+#define MX25LM_SIM_POLL_LIMIT        ( 100000UL )
+
+#define MX25LM_SIM_SR_WIP            ( 0x01U )
+#define MX25LM_SIM_SR_WEL            ( 0x02U )
+#define MX25LM_SIM_CR2_SPI           ( 0x00U )
+#define MX25LM_SIM_CR2_SOPI          ( 0x01U )
+
+/* Commands decoded by the model */
+#define MX25LM_SIM_SPI_WREN          ( 0x06U )
+#define MX25LM_SIM_SPI_RDSR          ( 0x05U )
+#define MX25LM_SIM_SPI_WRCR2         ( 0x72U )
+#define MX25LM_SIM_OPI_WREN          ( 0x06F9U )
+#define MX25LM_SIM_OPI_RDSR          ( 0x05FAU )
+#define MX25LM_SIM_OPI_8READ         ( 0xEC13U )
+#define MX25LM_SIM_OPI_PP            ( 0x12EDU )
+#define MX25LM_SIM_OPI_SE            ( 0x21DEU )
+#define MX25LM_SIM_OPI_RDSR_DUMMY    ( 4UL )
+#define MX25LM_SIM_OPI_8READ_DUMMY   ( 20UL )
+
+#define OSPI_SIM_STATE_READY         ( 0UL )
+#define OSPI_SIM_STATE_CMD           ( 1UL )
+#define OSPI_SIM_STATE_MEM_MAPPED    ( 2UL )
+
+Mx25lmSim_t xMx25lmSim;
+
+/* Peripheral instances referenced by the driver */
+OCTOSPI_TypeDef xHostOctospi2;
+DLYB_TypeDef xHostDlybOctospi2;
+DMA_Channel_TypeDef xHostGpdma1Channel12;
+GPIO_TypeDef xHostGpioF;
+GPIO_TypeDef xHostGpioH;
+GPIO_TypeDef xHostGpioI;
+
+static DCACHE_HandleTypeDef xHndlDCache;
+DCACHE_HandleTypeDef * pxHndlDCache = &xHndlDCache;
+
+static uint8_t * pucArray = NULL;
+static uint8_t * pucCache = NULL;
+static uint8_t * pucLineValid = NULL;
+static size_t xHostPageSize = 0;
+
+static uint8_t ucStatus = 0;
+static uint32_t ulBusyRemaining = 0;
+static OSPI_RegularCmdTypeDef xReadCfg;
+
+static void prvLogEvent( Mx25lmEventType_t xType,
+                         uint32_t ulAddr,
+                         uint32_t ulLen )
+{
+    /* Events beyond the end of the log are dropped, tests reset ulEventCount between scenarios */
+    if( xMx25lmSim.ulEventCount < MX25LM_SIM_MAX_EVENTS )
+    {
+        xMx25lmSim.xEvents[ xMx25lmSim.ulEventCount ].xType = xType;
+        xMx25lmSim.xEvents[ xMx25lmSim.ulEventCount ].ulAddr = ulAddr;
+        xMx25lmSim.xEvents[ xMx25lmSim.ulEventCount ].ulLen = ulLen;
+        xMx25lmSim.ulEventCount++;
+    }
+}
+
+static void prvError( uint32_t ulInstruction )
+{
+    xMx25lmSim.ulErrors++;
+    prvLogEvent( eMx25lmEventError, ulInstruction, 0 );
+}
+
+static void prvWindowMessage( const char * pcMessage )
+{
+    ( void ) write( STDERR_FILENO, pcMessage, strlen( pcMessage ) );
+}
+
+/* Fill the invalid lines of the window page holding the fault address, or abort on an access the hardware would fault on */
+static void prvWindowFault( int lSignal,
+                            siginfo_t * pxInfo,
+                            void * pvContext )
+{
+    uintptr_t uxAddr = ( uintptr_t ) pxInfo->si_addr;
+
+    ( void ) pvContext;
+
+    if( ( uxAddr < OCTOSPI2_BASE ) || ( uxAddr >= ( OCTOSPI2_BASE + MX25LM_SIM_SIZE ) ) )
+    {
+        /* Not the window, let the fault happen */
+        ( void ) signal( lSignal, SIG_DFL );
+    }
+    else
+    {
+        uint32_t ulPage = ( uint32_t ) ( uxAddr - OCTOSPI2_BASE ) & ~( ( uint32_t ) xHostPageSize - 1 );
+        BaseType_t xFilled = pdTRUE;
+
+        for( uint32_t ulLine = ulPage; ulLine < ( ulPage + xHostPageSize ); ulLine += MX25LM_SIM_LINE_SIZE )
+        {
+            xFilled &= ( pucLineValid[ ulLine / MX25LM_SIM_LINE_SIZE ] != 0 ) ? pdTRUE : pdFALSE;
+        }
+
+        if( xFilled == pdTRUE )
+        {
+            /* Every line of the page is readable, so this is a write */
+            prvWindowMessage( "mx25lm_sim: write through the OCTOSPI2 memory mapped window\n" );
+            abort();
+        }
+        else if( xMx25lmSim.xMemMapped != pdTRUE )
+        {
+            prvWindowMessage( "mx25lm_sim: OCTOSPI2 window read outside memory mapped mode\n" );
+            abort();
+        }
+        else
+        {
+            for( uint32_t ulLine = ulPage; ulLine < ( ulPage + xHostPageSize ); ulLine += MX25LM_SIM_LINE_SIZE )
+            {
+                if( pucLineValid[ ulLine / MX25LM_SIM_LINE_SIZE ] == 0 )
+                {
+                    ( void ) memcpy( &( pucCache[ ulLine ] ), &( pucArray[ ulLine ] ), MX25LM_SIM_LINE_SIZE );
+                    pucLineValid[ ulLine / MX25LM_SIM_LINE_SIZE ] = 1;
+                    xMx25lmSim.ulLineFills++;
+                    xMx25lmSim.ullBusyNs += MX25LM_SIM_COMMAND_NS + ( MX25LM_SIM_LINE_SIZE * MX25LM_SIM_BYTE_NS );
+                }
+            }
+
+            ( void ) mprotect( ( void * ) ( OCTOSPI2_BASE + ulPage ), xHostPageSize, PROT_READ );
+        }
+    }
+}
+
+static void prvMapWindow( int lArrayFd )
+{
+    char cName[ 32 ];
+    int lFd;
+    struct sigaction xAction = { 0 };
+
+    ( void ) snprintf( cName, sizeof( cName ), "/mx25lm_dcache_%ld", ( long ) getpid() );
+    lFd = shm_open( cName, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    ( void ) shm_unlink( cName );
+
+    xHostPageSize = ( size_t ) sysconf( _SC_PAGESIZE );
+
+    configASSERT( lFd >= 0 );
+    configASSERT( ftruncate( lFd, MX25LM_SIM_SIZE ) == 0 );
+
+    pucCache = mmap( NULL, MX25LM_SIM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, lFd, 0 );
+    configASSERT( pucCache != MAP_FAILED );
+
+    configASSERT( mmap( ( void * ) OCTOSPI2_BASE, MX25LM_SIM_SIZE, PROT_NONE,
+                        MAP_SHARED | MAP_FIXED_NOREPLACE, lFd, 0 ) == ( void * ) OCTOSPI2_BASE );
+
+    ( void ) close( lFd );
+
+    if( lArrayFd >= 0 )
+    {
+        pucArray = mmap( NULL, MX25LM_SIM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, lArrayFd, 0 );
+        configASSERT( pucArray != MAP_FAILED );
+    }
+    else
+    {
+        pucArray = malloc( MX25LM_SIM_SIZE );
+    }
+
+    pucLineValid = malloc( MX25LM_SIM_SIZE / MX25LM_SIM_LINE_SIZE );
+    configASSERT( ( pucArray != NULL ) && ( pucLineValid != NULL ) );
+
+    xAction.sa_sigaction = prvWindowFault;
+    xAction.sa_flags = SA_SIGINFO | SA_NODEFER;
+    ( void ) sigemptyset( &xAction.sa_mask );
+    configASSERT( sigaction( SIGSEGV, &xAction, NULL ) == 0 );
+}
+
+static void prvInvalidate( uint32_t ulAddr,
+                           uint32_t ulLen )
+{
+    uint32_t ulStart = ulAddr & ~( MX25LM_SIM_LINE_SIZE - 1 );
+    uint32_t ulEnd = ulAddr + ulLen;
+
+    if( ulEnd > MX25LM_SIM_SIZE )
+    {
+        ulEnd = MX25LM_SIM_SIZE;
+    }
+
+    if( ulStart < ulEnd )
+    {
+        uint32_t ulPageStart = ulStart & ~( ( uint32_t ) xHostPageSize - 1 );
+        uint32_t ulPageEnd = ( ulEnd + ( uint32_t ) xHostPageSize - 1 ) & ~( ( uint32_t ) xHostPageSize - 1 );
+
+        ( void ) memset( &( pucLineValid[ ulStart / MX25LM_SIM_LINE_SIZE ] ), 0,
+                         ( ( ulEnd - ulStart ) + MX25LM_SIM_LINE_SIZE - 1 ) / MX25LM_SIM_LINE_SIZE );
+        ( void ) mprotect( ( void * ) ( OCTOSPI2_BASE + ulPageStart ), ulPageEnd - ulPageStart, PROT_NONE );
+    }
+}
+
+void vMx25lmSimInit( void )
+{
+    if( pucArray == NULL )
+    {
+        prvMapWindow( -1 );
+    }
+
+    ( void ) memset( pucArray, 0xFF, MX25LM_SIM_SIZE );
+    ( void ) memset( &xMx25lmSim, 0, sizeof( xMx25lmSim ) );
+    xMx25lmSim.ulBusyPolls = MX25LM_SIM_DEFAULT_BUSY;
+    prvInvalidate( 0, MX25LM_SIM_SIZE );
+    vMx25lmSimPowerOnReset();
+}
+
+void vMx25lmSimBoot( const char * pcPath )
+{
+    int lFd;
+    off_t xSize;
+
+    configASSERT( pucArray == NULL );
+
+    lFd = open( pcPath, O_RDWR | O_CREAT, 0600 );
+    configASSERT( lFd >= 0 );
+
+    xSize = lseek( lFd, 0, SEEK_END );
+
+    if( xSize == 0 )
+    {
+        uint8_t * pucErased = malloc( MX25LM_SIM_SECTOR_LEN );
+
+        configASSERT( pucErased != NULL );
+        ( void ) memset( pucErased, 0xFF, MX25LM_SIM_SECTOR_LEN );
+
+        for( uint32_t ulSector = 0; ulSector < MX25LM_SIM_SIZE; ulSector += MX25LM_SIM_SECTOR_LEN )
+        {
+            configASSERT( pwrite( lFd, pucErased, MX25LM_SIM_SECTOR_LEN, ulSector ) == ( ssize_t ) MX25LM_SIM_SECTOR_LEN );
+        }
+
+        free( pucErased );
+    }
+    else
+    {
+        configASSERT( xSize == ( off_t ) MX25LM_SIM_SIZE );
+    }
+
+    prvMapWindow( lFd );
+    ( void ) close( lFd );
+
+    ( void ) memset( &xMx25lmSim, 0, sizeof( xMx25lmSim ) );
+    xMx25lmSim.ulBusyPolls = MX25LM_SIM_DEFAULT_BUSY;
+    prvInvalidate( 0, MX25LM_SIM_SIZE );
+    vMx25lmSimPowerOnReset();
+}
+
+void vMx25lmSimPowerOnReset( void )
+{
+    xMx25lmSim.xOctalMode = pdFALSE;
+    ucStatus = 0;
+    ulBusyRemaining = 0;
+}
+
+uint8_t * pucMx25lmSimArray( uint32_t ulAddr )
+{
+    configASSERT( ulAddr < MX25LM_SIM_SIZE );
+
+    return &( pucArray[ ulAddr ] );
+}
+
+uint32_t ulMx25lmSimFindEvent( Mx25lmEventType_t xType,
+                               uint32_t ulFrom )
+{
+    uint32_t ulIdx = ulFrom;
+
+    while( ( ulIdx < xMx25lmSim.ulEventCount ) &&
+           ( xMx25lmSim.xEvents[ ulIdx ].xType != xType ) )
+    {
+        ulIdx++;
+    }
+
+    return ulIdx;
+}
+
+uint32_t ulMx25lmSimCountEvents( Mx25lmEventType_t xType,
+                                 uint32_t ulFrom )
+{
+    uint32_t ulCount = 0;
+
+    for( uint32_t ulIdx = ulFrom; ulIdx < xMx25lmSim.ulEventCount; ulIdx++ )
+    {
+        ulCount += ( xMx25lmSim.xEvents[ ulIdx ].xType == xType ) ? 1 : 0;
+    }
+
+    return ulCount;
+}
+
+/* Decode a command against the current mode, returning its OPI code or 0 if the device would ignore it */
+static uint32_t prvDecode( const OSPI_RegularCmdTypeDef * pxCmd )
+{
+    uint32_t ulCommand = 0;
+
+    if( xMx25lmSim.xOctalMode == pdFALSE )
+    {
+        if( ( pxCmd->InstructionMode == HAL_OSPI_INSTRUCTION_1_LINE ) &&
+            ( pxCmd->InstructionSize == HAL_OSPI_INSTRUCTION_8_BITS ) )
+        {
+            switch( pxCmd->Instruction )
+            {
+                case MX25LM_SIM_SPI_WREN:
+                    ulCommand = MX25LM_SIM_OPI_WREN;
+                    break;
+
+                case MX25LM_SIM_SPI_RDSR:
+                    ulCommand = MX25LM_SIM_OPI_RDSR;
+                    break;
+
+                case MX25LM_SIM_SPI_WRCR2:
+                    ulCommand = ( pxCmd->AlternateBytesMode == HAL_OSPI_ALTERNATE_BYTES_1_LINE ) ? MX25LM_SIM_SPI_WRCR2 : 0;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+    }
+    else if( ( pxCmd->InstructionMode == HAL_OSPI_INSTRUCTION_8_LINES ) &&
+             ( pxCmd->InstructionSize == HAL_OSPI_INSTRUCTION_16_BITS ) )
+    {
+        BaseType_t xOctalAddress = ( pxCmd->AddressMode == HAL_OSPI_ADDRESS_8_LINES ) &&
+                                   ( pxCmd->AddressSize == HAL_OSPI_ADDRESS_32_BITS );
+
+        switch( pxCmd->Instruction )
+        {
+            case MX25LM_SIM_OPI_WREN:
+                ulCommand = pxCmd->Instruction;
+                break;
+
+            case MX25LM_SIM_OPI_RDSR:
+                ulCommand = ( xOctalAddress && ( pxCmd->DummyCycles == MX25LM_SIM_OPI_RDSR_DUMMY ) ) ? pxCmd->Instruction : 0;
+                break;
+
+            case MX25LM_SIM_OPI_8READ:
+                ulCommand = ( xOctalAddress && ( pxCmd->DummyCycles == MX25LM_SIM_OPI_8READ_DUMMY ) ) ? pxCmd->Instruction : 0;
+                break;
+
+            case MX25LM_SIM_OPI_PP:
+            case MX25LM_SIM_OPI_SE:
+                ulCommand = xOctalAddress ? pxCmd->Instruction : 0;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if( ulCommand == 0 )
+    {
+        prvError( pxCmd->Instruction );
+    }
+
+    return ulCommand;
+}
+
+static uint8_t prvReadStatus( void )
+{
+    uint8_t ucValue = ucStatus | ( ( ulBusyRemaining > 0 ) ? MX25LM_SIM_SR_WIP : 0 );
+
+    if( ulBusyRemaining > 0 )
+    {
+        ulBusyRemaining--;
+
+        if( ulBusyRemaining == 0 )
+        {
+            /* The write enable latch resets when the operation completes */
+            ucStatus &= ~MX25LM_SIM_SR_WEL;
+            prvLogEvent( eMx25lmEventIdle, 0, 0 );
+        }
+    }
+
+    return ucValue;
+}
+
+/* Program, erase and register writes need the latch set and the device idle */
+static BaseType_t prvWriteAllowed( uint32_t ulCommand )
+{
+    BaseType_t xAllowed = pdTRUE;
+
+    if( ( ulBusyRemaining > 0 ) ||
+        ( ( ucStatus & MX25LM_SIM_SR_WEL ) == 0 ) )
+    {
+        prvError( ulCommand );
+        xAllowed = pdFALSE;
+    }
+
+    return xAllowed;
+}
+
+static void prvExecute( const OSPI_RegularCmdTypeDef * pxCmd )
+{
+    switch( prvDecode( pxCmd ) )
+    {
+        case MX25LM_SIM_OPI_WREN:
+
+            if( ulBusyRemaining > 0 )
+            {
+                prvError( pxCmd->Instruction );
+            }
+            else
+            {
+                ucStatus |= MX25LM_SIM_SR_WEL;
+                prvLogEvent( eMx25lmEventWriteEnable, 0, 0 );
+            }
+
+            break;
+
+        case MX25LM_SIM_SPI_WRCR2:
+
+            if( prvWriteAllowed( pxCmd->Instruction ) == pdTRUE )
+            {
+                if( pxCmd->AlternateBytes == MX25LM_SIM_CR2_SOPI )
+                {
+                    xMx25lmSim.xOctalMode = pdTRUE;
+                }
+                else if( pxCmd->AlternateBytes != MX25LM_SIM_CR2_SPI )
+                {
+                    /* DTR OPI is not modelled */
+                    prvError( pxCmd->Instruction );
+                }
+
+                ucStatus &= ~MX25LM_SIM_SR_WEL;
+                prvLogEvent( eMx25lmEventWriteCR2, pxCmd->AlternateBytes, 0 );
+            }
+
+            break;
+
+        case MX25LM_SIM_OPI_SE:
+
+            if( pxCmd->Address >= MX25LM_SIM_SIZE )
+            {
+                prvError( pxCmd->Instruction );
+            }
+            else if( prvWriteAllowed( pxCmd->Instruction ) == pdTRUE )
+            {
+                uint32_t ulSector = pxCmd->Address & ~( MX25LM_SIM_SECTOR_LEN - 1 );
+
+                ( void ) memset( &( pucArray[ ulSector ] ), 0xFF, MX25LM_SIM_SECTOR_LEN );
+                ulBusyRemaining = xMx25lmSim.ulBusyPolls;
+                xMx25lmSim.ulSectorErases++;
+                xMx25lmSim.ulSectorEraseCounts[ ulSector / MX25LM_SIM_SECTOR_LEN ]++;
+                xMx25lmSim.ullBusyNs += MX25LM_SIM_COMMAND_NS + MX25LM_SIM_SECTOR_ERASE_NS;
+                prvLogEvent( eMx25lmEventErase, ulSector, MX25LM_SIM_SECTOR_LEN );
+            }
+
+            break;
+
+        case 0:
+            /* Ignored by the device */
+            break;
+
+        default:
+            /* A command with a data phase sent without one */
+            prvError( pxCmd->Instruction );
+            break;
+    }
+}
+
+static void prvCallback( OSPI_HandleTypeDef * hospi,
+                         HAL_OSPI_CallbackIDTypeDef xCallbackId )
+{
+    if( hospi->pxCallbacks[ xCallbackId ] != NULL )
+    {
+        hospi->pxCallbacks[ xCallbackId ]( hospi );
+    }
+}
+
+static HAL_StatusTypeDef prvCommand( OSPI_HandleTypeDef * hospi,
+                                     OSPI_RegularCmdTypeDef * cmd,
+                                     BaseType_t xInterrupt )
+{
+    HAL_StatusTypeDef xStatus = HAL_OK;
+
+    configASSERT( ( hospi != NULL ) && ( cmd != NULL ) );
+
+    if( hospi->ulState != OSPI_SIM_STATE_READY )
+    {
+        /* The HAL refuses commands while memory mapped or with a transfer pending */
+        prvError( cmd->Instruction );
+        xStatus = HAL_BUSY;
+    }
+    else if( cmd->OperationType == HAL_OSPI_OPTYPE_READ_CFG )
+    {
+        xReadCfg = *cmd;
+    }
+    else if( cmd->OperationType == HAL_OSPI_OPTYPE_WRITE_CFG )
+    {
+        /* Writes through the window are not modelled */
+    }
+    else if( cmd->DataMode != HAL_OSPI_DATA_NONE )
+    {
+        hospi->xPendingCmd = *cmd;
+        hospi->ulState = OSPI_SIM_STATE_CMD;
+    }
+    else
+    {
+        prvExecute( cmd );
+
+        if( xInterrupt == pdTRUE )
+        {
+            prvCallback( hospi, HAL_OSPI_CMD_CPLT_CB_ID );
+        }
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Command( OSPI_HandleTypeDef * hospi,
+                                    OSPI_RegularCmdTypeDef * cmd,
+                                    uint32_t Timeout )
+{
+    ( void ) Timeout;
+
+    return prvCommand( hospi, cmd, pdFALSE );
+}
+
+HAL_StatusTypeDef HAL_OSPI_Command_IT( OSPI_HandleTypeDef * hospi,
+                                       OSPI_RegularCmdTypeDef * cmd )
+{
+    return prvCommand( hospi, cmd, pdTRUE );
+}
+
+/* Take the command latched for a data phase, or return NULL if there is none */
+static const OSPI_RegularCmdTypeDef * prvTakePending( OSPI_HandleTypeDef * hospi )
+{
+    const OSPI_RegularCmdTypeDef * pxCmd = NULL;
+
+    if( hospi->ulState == OSPI_SIM_STATE_CMD )
+    {
+        pxCmd = &( hospi->xPendingCmd );
+        hospi->ulState = OSPI_SIM_STATE_READY;
+    }
+    else
+    {
+        prvError( 0 );
+    }
+
+    return pxCmd;
+}
+
+static HAL_StatusTypeDef prvReceive( OSPI_HandleTypeDef * hospi,
+                                     uint8_t * pData )
+{
+    const OSPI_RegularCmdTypeDef * pxCmd = prvTakePending( hospi );
+    HAL_StatusTypeDef xStatus = ( pxCmd != NULL ) ? HAL_OK : HAL_ERROR;
+
+    if( pxCmd != NULL )
+    {
+        /* Undriven data lines read as ones */
+        ( void ) memset( pData, 0xFF, pxCmd->NbData );
+
+        switch( prvDecode( pxCmd ) )
+        {
+            case MX25LM_SIM_OPI_RDSR:
+                ( void ) memset( pData, prvReadStatus(), pxCmd->NbData );
+                prvLogEvent( eMx25lmEventStatusRead, 0, 0 );
+                break;
+
+            case MX25LM_SIM_OPI_8READ:
+
+                if( ( ulBusyRemaining > 0 ) ||
+                    ( pxCmd->Address >= MX25LM_SIM_SIZE ) ||
+                    ( pxCmd->NbData > ( MX25LM_SIM_SIZE - pxCmd->Address ) ) )
+                {
+                    prvError( pxCmd->Instruction );
+                }
+                else
+                {
+                    ( void ) memcpy( pData, &( pucArray[ pxCmd->Address ] ), pxCmd->NbData );
+                    xMx25lmSim.ullBusyNs += MX25LM_SIM_COMMAND_NS + ( pxCmd->NbData * MX25LM_SIM_BYTE_NS );
+                    prvLogEvent( eMx25lmEventRead, pxCmd->Address, pxCmd->NbData );
+                }
+
+                break;
+
+            case 0:
+                break;
+
+            default:
+                prvError( pxCmd->Instruction );
+                break;
+        }
+
+        prvCallback( hospi, HAL_OSPI_RX_CPLT_CB_ID );
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Receive_IT( OSPI_HandleTypeDef * hospi,
+                                       uint8_t * pData )
+{
+    return prvReceive( hospi, pData );
+}
+
+HAL_StatusTypeDef HAL_OSPI_Receive_DMA( OSPI_HandleTypeDef * hospi,
+                                        uint8_t * pData )
+{
+    configASSERT( hospi->hdma != NULL );
+
+    return prvReceive( hospi, pData );
+}
+
+static HAL_StatusTypeDef prvTransmit( OSPI_HandleTypeDef * hospi,
+                                      uint8_t * pData )
+{
+    const OSPI_RegularCmdTypeDef * pxCmd = prvTakePending( hospi );
+    HAL_StatusTypeDef xStatus = ( pxCmd != NULL ) ? HAL_OK : HAL_ERROR;
+
+    if( pxCmd == NULL )
+    {
+        /* No command to send the data with */
+    }
+    else if( prvDecode( pxCmd ) != MX25LM_SIM_OPI_PP )
+    {
+        prvError( pxCmd->Instruction );
+    }
+    else if( ( pxCmd->Address >= MX25LM_SIM_SIZE ) ||
+             ( pxCmd->NbData == 0 ) ||
+             ( ( ( pxCmd->Address % MX25LM_SIM_PAGE_LEN ) + pxCmd->NbData ) > MX25LM_SIM_PAGE_LEN ) )
+    {
+        /* The device would wrap around to the start of the page */
+        prvError( pxCmd->Instruction );
+    }
+    else if( prvWriteAllowed( pxCmd->Instruction ) == pdTRUE )
+    {
+        for( uint32_t ulIdx = 0; ulIdx < pxCmd->NbData; ulIdx++ )
+        {
+            pucArray[ pxCmd->Address + ulIdx ] &= pData[ ulIdx ];
+        }
+
+        ulBusyRemaining = xMx25lmSim.ulBusyPolls;
+        xMx25lmSim.ulProgramBytes += pxCmd->NbData;
+        xMx25lmSim.ullBusyNs += MX25LM_SIM_COMMAND_NS + ( pxCmd->NbData * MX25LM_SIM_BYTE_NS ) + MX25LM_SIM_PAGE_PROGRAM_NS;
+        prvLogEvent( eMx25lmEventProgram, pxCmd->Address, pxCmd->NbData );
+    }
+
+    if( pxCmd != NULL )
+    {
+        prvCallback( hospi, HAL_OSPI_TX_CPLT_CB_ID );
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Transmit_IT( OSPI_HandleTypeDef * hospi,
+                                        uint8_t * pData )
+{
+    return prvTransmit( hospi, pData );
+}
+
+HAL_StatusTypeDef HAL_OSPI_Transmit_DMA( OSPI_HandleTypeDef * hospi,
+                                         uint8_t * pData )
+{
+    configASSERT( hospi->hdma != NULL );
+
+    return prvTransmit( hospi, pData );
+}
+
+/* Poll the status register until it matches, as the controller does. A status that never matches leaves the caller to time out. */
+HAL_StatusTypeDef HAL_OSPI_AutoPolling_IT( OSPI_HandleTypeDef * hospi,
+                                           OSPI_AutoPollingTypeDef * cfg )
+{
+    const OSPI_RegularCmdTypeDef * pxCmd = prvTakePending( hospi );
+    HAL_StatusTypeDef xStatus = ( pxCmd != NULL ) ? HAL_OK : HAL_ERROR;
+
+    if( ( pxCmd != NULL ) &&
+        ( prvDecode( pxCmd ) == MX25LM_SIM_OPI_RDSR ) )
+    {
+        BaseType_t xMatch = pdFALSE;
+
+        prvLogEvent( eMx25lmEventStatusRead, 0, 0 );
+
+        for( uint32_t ulPoll = 0; ( ulPoll < MX25LM_SIM_POLL_LIMIT ) && ( xMatch == pdFALSE ); ulPoll++ )
+        {
+            xMatch = ( ( prvReadStatus() & cfg->Mask ) == cfg->Match ) ? pdTRUE : pdFALSE;
+        }
+
+        if( xMatch == pdTRUE )
+        {
+            prvCallback( hospi, HAL_OSPI_STATUS_MATCH_CB_ID );
+        }
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_OSPI_MemoryMapped( OSPI_HandleTypeDef * hospi,
+                                         OSPI_MemoryMappedTypeDef * cfg )
+{
+    HAL_StatusTypeDef xStatus = HAL_ERROR;
+
+    ( void ) cfg;
+
+    if( ( hospi->ulState != OSPI_SIM_STATE_READY ) ||
+        ( xReadCfg.OperationType != HAL_OSPI_OPTYPE_READ_CFG ) ||
+        ( xReadCfg.DataMode != HAL_OSPI_DATA_8_LINES ) ||
+        ( prvDecode( &xReadCfg ) != MX25LM_SIM_OPI_8READ ) )
+    {
+        prvError( xReadCfg.Instruction );
+    }
+    else if( ulBusyRemaining > 0 )
+    {
+        /* Reads during a program or erase return the status register rather than the array */
+        prvError( xReadCfg.Instruction );
+    }
+    else
+    {
+        hospi->ulState = OSPI_SIM_STATE_MEM_MAPPED;
+        xMx25lmSim.xMemMapped = pdTRUE;
+        prvLogEvent( eMx25lmEventMemMapEnter, 0, 0 );
+        xStatus = HAL_OK;
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Abort( OSPI_HandleTypeDef * hospi )
+{
+    if( hospi->ulState == OSPI_SIM_STATE_MEM_MAPPED )
+    {
+        xMx25lmSim.xMemMapped = pdFALSE;
+        prvLogEvent( eMx25lmEventMemMapExit, 0, 0 );
+    }
+
+    hospi->ulState = OSPI_SIM_STATE_READY;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Abort_IT( OSPI_HandleTypeDef * hospi )
+{
+    HAL_StatusTypeDef xStatus = HAL_OSPI_Abort( hospi );
+
+    prvCallback( hospi, HAL_OSPI_ABORT_CB_ID );
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_DCACHE_InvalidateByAddr( DCACHE_HandleTypeDef * hdcache,
+                                               const uint32_t * const pAddr,
+                                               uint32_t dSize )
+{
+    uint32_t ulAddr = ( uint32_t ) ( ( uintptr_t ) pAddr - OCTOSPI2_BASE );
+
+    configASSERT( hdcache != NULL );
+    configASSERT( ( uintptr_t ) pAddr >= OCTOSPI2_BASE );
+
+    prvLogEvent( eMx25lmEventInvalidate, ulAddr, dSize );
+    prvInvalidate( ulAddr, dSize );
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_OSPI_Init( OSPI_HandleTypeDef * hospi )
+{
+    hospi->ulState = OSPI_SIM_STATE_READY;
+    prvCallback( hospi, HAL_OSPI_MSP_INIT_CB_ID );
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_OSPI_RegisterCallback( OSPI_HandleTypeDef * hospi,
+                                             HAL_OSPI_CallbackIDTypeDef CallbackID,
+                                             pOSPI_CallbackTypeDef pCallback )
+{
+    configASSERT( CallbackID < HAL_OSPI_CALLBACK_COUNT );
+
+    hospi->pxCallbacks[ CallbackID ] = pCallback;
+
+    return HAL_OK;
+}
+
+void HAL_OSPI_IRQHandler( OSPI_HandleTypeDef * hospi )
+{
+    /* Callbacks are made from the HAL calls themselves */
+    ( void ) hospi;
+}
+
+HAL_StatusTypeDef HAL_OSPIM_Config( OSPI_HandleTypeDef * hospi,
+                                    OSPIM_CfgTypeDef * cfg,
+                                    uint32_t Timeout )
+{
+    ( void ) hospi;
+    ( void ) cfg;
+    ( void ) Timeout;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_OSPI_DLYB_SetConfig( OSPI_HandleTypeDef * hospi,
+                                           HAL_OSPI_DLYB_CfgTypeDef * pdlyb_cfg )
+{
+    ( void ) hospi;
+    ( void ) pdlyb_cfg;
+
+    return HAL_OK;
+}
+
+/* Peripheral setup performed by the driver's MSP callbacks has no effect on the host */
+HAL_StatusTypeDef HAL_DMA_Init( DMA_HandleTypeDef * hdma )
+{
+    ( void ) hdma;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit( DMA_HandleTypeDef * hdma )
+{
+    ( void ) hdma;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes( DMA_HandleTypeDef * hdma,
+                                                   uint32_t ChannelAttributes )
+{
+    ( void ) hdma;
+    ( void ) ChannelAttributes;
+
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler( DMA_HandleTypeDef * hdma )
+{
+    ( void ) hdma;
+}
+
+void HAL_GPIO_Init( GPIO_TypeDef * GPIOx,
+                    GPIO_InitTypeDef * GPIO_Init )
+{
+    ( void ) GPIOx;
+    ( void ) GPIO_Init;
+}
+
+void HAL_GPIO_DeInit( GPIO_TypeDef * GPIOx,
+                      uint32_t GPIO_Pin )
+{
+    ( void ) GPIOx;
+    ( void ) GPIO_Pin;
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig( RCC_PeriphCLKInitTypeDef * PeriphClkInit )
+{
+    ( void ) PeriphClkInit;
+
+    return HAL_OK;
+}
+
+void NVIC_SetVector( IRQn_Type IRQn,
+                     uint32_t vector )
+{
+    ( void ) IRQn;
+    ( void ) vector;
+}
+
+void HAL_NVIC_SetPriority( IRQn_Type IRQn,
+                           uint32_t PreemptPriority,
+                           uint32_t SubPriority )
+{
+    ( void ) IRQn;
+    ( void ) PreemptPriority;
+    ( void ) SubPriority;
+}
+
+void HAL_NVIC_EnableIRQ( IRQn_Type IRQn )
+{
+    ( void ) IRQn;
+}
+
+void HAL_NVIC_DisableIRQ( IRQn_Type IRQn )
+{
+    ( void ) IRQn;
+}
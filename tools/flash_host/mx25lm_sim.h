@@ -0,0 +1,132 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Model of the Macronix MX25LM51245G octal NOR flash on OCTOSPI2, behind the OCTOSPI HAL shim, together
+ * with DCACHE1 in front of the memory mapped window. It enforces what the driver has to get right:
+ *  - Commands are only decoded in the mode the device is in: 1 line SPI after power on, 8 line STR OPI
+ *    once CR2 has been written with SOPI. Commands sent in the wrong mode are ignored and counted as errors.
+ *  - Program, erase and CR2 writes need the write enable latch and are refused while a previous
+ *    operation is in progress. Program and erase leave WIP set for ulBusyPolls status reads.
+ *  - A page program may not wrap around its 256 byte page, and can only clear bits.
+ *  - Indirect commands are refused while the controller is in memory mapped mode, and the window can
+ *    only be entered with an 8READ read configuration while the device is idle in OPI mode.
+ *  - The window at OCTOSPI2_BASE is read through a model of DCACHE1 with 16 byte lines. A line keeps the
+ *    data it was filled with until HAL_DCACHE_InvalidateByAddr drops it, so reads after a program or
+ *    erase without an invalidation return stale data. A cache miss outside memory mapped mode, or any
+ *    write through the window, aborts the test.
+ * Each operation is appended to an event log so that tests can check the order the driver issued them in,
+ * and adds its typical duration to ullBusyNs for the benchmarks.
+ */
+#ifndef MX25LM_SIM_H
+#define MX25LM_SIM_H
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "stm32u5xx.h"
+
+#define MX25LM_SIM_SIZE           ( 64UL * 1024UL * 1024UL )
+#define MX25LM_SIM_LINE_SIZE      ( 16UL )
+#define MX25LM_SIM_MAX_EVENTS     ( 4096UL )
+#define MX25LM_SIM_SECTOR_COUNT   ( MX25LM_SIM_SIZE / 4096UL )
+
+/*
+ * Typical MX25LM51245G operation times, and transfer times at the 40 MHz STR octal clock the driver
+ * configures. The command time covers the instruction, address and dummy cycles and the interrupt.
+ */
+#ifndef MX25LM_SIM_PAGE_PROGRAM_NS
+    #define MX25LM_SIM_PAGE_PROGRAM_NS    ( 150000ULL )
+#endif
+#ifndef MX25LM_SIM_SECTOR_ERASE_NS
+    #define MX25LM_SIM_SECTOR_ERASE_NS    ( 25000000ULL )
+#endif
+#ifndef MX25LM_SIM_COMMAND_NS
+    #define MX25LM_SIM_COMMAND_NS         ( 2000ULL )
+#endif
+#ifndef MX25LM_SIM_BYTE_NS
+    #define MX25LM_SIM_BYTE_NS            ( 25ULL )
+#endif
+
+typedef enum
+{
+    eMx25lmEventWriteEnable,  /* WREN, either mode */
+    eMx25lmEventWriteCR2,     /* WRCR2, ulAddr holds the value written */
+    eMx25lmEventStatusRead,   /* RDSR, either mode */
+    eMx25lmEventIdle,         /* WIP cleared at the end of a program or erase */
+    eMx25lmEventRead,         /* Indirect 8READ */
+    eMx25lmEventProgram,      /* Page program */
+    eMx25lmEventErase,        /* Sector erase, ulAddr is the sector base */
+    eMx25lmEventMemMapEnter,
+    eMx25lmEventMemMapExit,
+    eMx25lmEventInvalidate,   /* DCACHE invalidation, ulAddr is relative to OCTOSPI2_BASE */
+    eMx25lmEventError         /* Command refused by the model, ulAddr holds the instruction */
+} Mx25lmEventType_t;
+
+typedef struct Mx25lmEvent
+{
+    Mx25lmEventType_t xType;
+    uint32_t ulAddr;
+    uint32_t ulLen;
+} Mx25lmEvent_t;
+
+typedef struct Mx25lmSim
+{
+    BaseType_t xOctalMode;
+    BaseType_t xMemMapped;
+    uint32_t ulBusyPolls;   /* Status reads which return WIP set after each program or erase */
+    uint32_t ulErrors;
+    uint32_t ulLineFills;   /* DCACHE lines filled from the device through the window */
+    uint32_t ulProgramBytes;
+    uint32_t ulSectorErases;
+    uint64_t ullBusyNs;
+    uint32_t ulSectorEraseCounts[ MX25LM_SIM_SECTOR_COUNT ];
+    uint32_t ulEventCount;
+    Mx25lmEvent_t xEvents[ MX25LM_SIM_MAX_EVENTS ];
+} Mx25lmSim_t;
+
+extern Mx25lmSim_t xMx25lmSim;
+
+/* Erase the device, put it in SPI mode as after power on, and drop the DCACHE contents and event log */
+void vMx25lmSimInit( void );
+
+/* Map the device array from a backing file, created erased if it does not exist, and power on in SPI mode */
+void vMx25lmSimBoot( const char * pcPath );
+
+/* Return the device to SPI mode and idle, as a reset of the flash alone would, keeping its contents */
+void vMx25lmSimPowerOnReset( void );
+
+/* Access the device array directly, bypassing the controller and the DCACHE */
+uint8_t * pucMx25lmSimArray( uint32_t ulAddr );
+
+/* Index of the first event of the given type at or after ulFrom, or ulEventCount if there is none */
+uint32_t ulMx25lmSimFindEvent( Mx25lmEventType_t xType,
+                               uint32_t ulFrom );
+
+/* Number of events of the given type from ulFrom onwards */
+uint32_t ulMx25lmSimCountEvents( Mx25lmEventType_t xType,
+                                 uint32_t ulFrom );
+
+#endif /* MX25LM_SIM_H */
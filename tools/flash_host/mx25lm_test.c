@@ -0,0 +1,309 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Drive Projects/b_u585i_iot02a_ntz/Src/fs/ospi_nor_mx25lmxxx45g.c and lfs_port_ospi.c against the
+ * MX25LM51245G and DCACHE1 model in mx25lm_sim.c: the switch from SPI to OPI mode, the suspension of
+ * memory mapped mode around program and erase operations, the DCACHE invalidation which has to follow
+ * them, and the read path the littlefs port is built with.
+ *
+ * Built once for each value of LFS_PORT_OSPI_MEM_MAPPED_READ.
+ *
+ * Usage: mx25lm_test
+ */
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "hw_defs.h"
+#include "lfs.h"
+#include "lfs_port.h"
+#include "ospi_nor_mx25lmxxx45g.h"
+
+#include "mx25lm_sim.h"
+
+#define TEST_CHECK( x )        configASSERT( x )
+
+#define TEST_TIMEOUT           pdMS_TO_TICKS( MX25LM_DEFAULT_TIMEOUT_MS )
+#define TEST_BUFFER_LEN        ( 2 * MX25LM_SECTOR_SZ )
+
+/* A program which starts part way into one page and ends part way into the third */
+#define TEST_PROGRAM_ADDR      ( OPI_START_ADDRESS + 0x1F0 )
+#define TEST_PROGRAM_LEN       ( 0x120 )
+
+#define TEST_ERASE_ADDR        ( OPI_START_ADDRESS + 0x100 )
+#define TEST_LFS_BLOCK         ( 3 )
+
+static OSPI_HandleTypeDef xOSPI;
+static uint8_t ucPattern[ TEST_BUFFER_LEN ];
+static uint8_t ucRead[ TEST_BUFFER_LEN ];
+static uint8_t ucErased[ TEST_BUFFER_LEN ];
+
+static void prvCheckRead( uint32_t ulAddr,
+                          const uint8_t * pucExpected,
+                          uint32_t ulLen )
+{
+    ( void ) memset( ucRead, 0xA5, ulLen );
+    TEST_CHECK( ospi_ReadAddr( &xOSPI, ulAddr, ucRead, ulLen, TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( memcmp( ucRead, pucExpected, ulLen ) == 0 );
+}
+
+/*
+ * Check the event log of a program or erase issued in memory mapped mode: the window is left before the
+ * first command, and the range is invalidated only once the device is idle again, before the window is
+ * re-entered.
+ */
+static void prvCheckSuspendResume( Mx25lmEventType_t xOperation,
+                                   uint32_t ulAddr,
+                                   uint32_t ulLen )
+{
+    uint32_t ulExit = ulMx25lmSimFindEvent( eMx25lmEventMemMapExit, 0 );
+    uint32_t ulFirst = ulMx25lmSimFindEvent( xOperation, 0 );
+    uint32_t ulLast = ulFirst;
+    uint32_t ulIdle;
+    uint32_t ulInvalidate;
+    uint32_t ulEnter;
+
+    for( uint32_t ulIdx = ulFirst; ulIdx < xMx25lmSim.ulEventCount; ulIdx = ulMx25lmSimFindEvent( xOperation, ulIdx + 1 ) )
+    {
+        ulLast = ulIdx;
+    }
+
+    ulIdle = ulMx25lmSimFindEvent( eMx25lmEventIdle, ulLast );
+    ulInvalidate = ulMx25lmSimFindEvent( eMx25lmEventInvalidate, 0 );
+    ulEnter = ulMx25lmSimFindEvent( eMx25lmEventMemMapEnter, 0 );
+
+    TEST_CHECK( ulFirst < xMx25lmSim.ulEventCount );
+    TEST_CHECK( ulExit < ulFirst );
+    TEST_CHECK( ulLast < ulIdle );
+    TEST_CHECK( ulIdle < ulInvalidate );
+    TEST_CHECK( ulInvalidate < ulEnter );
+    TEST_CHECK( ulEnter < xMx25lmSim.ulEventCount );
+    TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventInvalidate, 0 ) == 1 );
+
+    /* The invalidated range covers the modified one */
+    TEST_CHECK( xMx25lmSim.xEvents[ ulInvalidate ].ulAddr <= ulAddr );
+    TEST_CHECK( ( xMx25lmSim.xEvents[ ulInvalidate ].ulAddr + xMx25lmSim.xEvents[ ulInvalidate ].ulLen ) >= ( ulAddr + ulLen ) );
+
+    TEST_CHECK( xMx25lmSim.xMemMapped == pdTRUE );
+    TEST_CHECK( xMx25lmSim.ulErrors == 0 );
+}
+
+/* The device powers up in SPI mode and the driver moves it to OPI before any other command */
+static void prvTestModeSwitch( void )
+{
+    vMx25lmSimInit();
+    TEST_CHECK( xMx25lmSim.xOctalMode == pdFALSE );
+
+    TEST_CHECK( ospi_Init( &xOSPI ) == pdTRUE );
+    TEST_CHECK( xMx25lmSim.xOctalMode == pdTRUE );
+    TEST_CHECK( ulMx25lmSimFindEvent( eMx25lmEventWriteEnable, 0 ) < ulMx25lmSimFindEvent( eMx25lmEventWriteCR2, 0 ) );
+    TEST_CHECK( xMx25lmSim.xEvents[ ulMx25lmSimFindEvent( eMx25lmEventWriteCR2, 0 ) ].ulAddr == MX25LM_REG_CR2_0_SOPI );
+    TEST_CHECK( xMx25lmSim.ulErrors == 0 );
+
+    /* Short reads use the FIFO, longer ones DMA; both are indirect 8READ commands */
+    prvCheckRead( OPI_START_ADDRESS, ucErased, 4 );
+    prvCheckRead( OPI_START_ADDRESS, ucErased, MX25LM_SECTOR_SZ );
+    TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventRead, 0 ) == 2 );
+
+    /* After a reset of the flash alone, OPI commands are ignored and the driver times out */
+    vMx25lmSimPowerOnReset();
+    TEST_CHECK( ospi_ReadAddr( &xOSPI, OPI_START_ADDRESS, ucRead, 4, TEST_TIMEOUT ) == pdFALSE );
+    TEST_CHECK( xMx25lmSim.ulErrors > 0 );
+
+    /* Initializing again recovers */
+    xMx25lmSim.ulErrors = 0;
+    TEST_CHECK( ospi_Init( &xOSPI ) == pdTRUE );
+    prvCheckRead( OPI_START_ADDRESS, ucErased, 4 );
+    TEST_CHECK( xMx25lmSim.ulErrors == 0 );
+
+    printf( "mode switch: SPI to OPI on init, OPI commands ignored after a flash reset\n" );
+}
+
+/* Program and erase leave memory mapped mode, then invalidate the modified range before returning to it */
+static void prvTestMemMappedProgramErase( void )
+{
+    TEST_CHECK( ospi_EnableMemMappedMode( &xOSPI, TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( xMx25lmSim.xMemMapped == pdTRUE );
+
+    /* Reads are served from the window, filling the cache */
+    xMx25lmSim.ulEventCount = 0;
+    prvCheckRead( OPI_START_ADDRESS, ucErased, TEST_BUFFER_LEN );
+    TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventRead, 0 ) == 0 );
+    TEST_CHECK( xMx25lmSim.ulLineFills == ( TEST_BUFFER_LEN / MX25LM_SIM_LINE_SIZE ) );
+
+    xMx25lmSim.ulEventCount = 0;
+    TEST_CHECK( ospi_ProgramPages( &xOSPI, TEST_PROGRAM_ADDR, ucPattern, TEST_PROGRAM_LEN, TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventProgram, 0 ) == 3 );
+    prvCheckSuspendResume( eMx25lmEventProgram, TEST_PROGRAM_ADDR, TEST_PROGRAM_LEN );
+    prvCheckRead( TEST_PROGRAM_ADDR, ucPattern, TEST_PROGRAM_LEN );
+    prvCheckRead( OPI_START_ADDRESS, ucErased, TEST_PROGRAM_ADDR - OPI_START_ADDRESS );
+
+    xMx25lmSim.ulEventCount = 0;
+    TEST_CHECK( ospi_WriteAddr( &xOSPI, TEST_PROGRAM_ADDR + MX25LM_SECTOR_SZ, ucPattern, 16, TEST_TIMEOUT ) == pdTRUE );
+    prvCheckSuspendResume( eMx25lmEventProgram, TEST_PROGRAM_ADDR + MX25LM_SECTOR_SZ, 16 );
+    prvCheckRead( TEST_PROGRAM_ADDR + MX25LM_SECTOR_SZ, ucPattern, 16 );
+
+    /* Erasing part way into a sector invalidates the whole sector */
+    xMx25lmSim.ulEventCount = 0;
+    TEST_CHECK( ospi_EraseSector( &xOSPI, TEST_ERASE_ADDR, TEST_TIMEOUT ) == pdTRUE );
+    prvCheckSuspendResume( eMx25lmEventErase, OPI_START_ADDRESS, MX25LM_SECTOR_SZ );
+    prvCheckRead( OPI_START_ADDRESS, ucErased, MX25LM_SECTOR_SZ );
+
+    /* The next sector was left alone */
+    prvCheckRead( TEST_PROGRAM_ADDR + MX25LM_SECTOR_SZ, ucPattern, 16 );
+
+    printf( "memory mapped: program and erase suspend, then invalidate before resuming\n" );
+}
+
+/* The model returns stale data when an invalidation is missing, so the checks above can fail */
+static void prvTestStaleDetection( void )
+{
+    DCACHE_HandleTypeDef * pxDCache = pxHndlDCache;
+    uint32_t ulAddr = OPI_START_ADDRESS + ( 2 * MX25LM_SECTOR_SZ );
+
+    prvCheckRead( ulAddr, ucErased, 256 );
+
+    /* Without a DCACHE handle the driver cannot invalidate, and the window keeps the erased data */
+    pxHndlDCache = NULL;
+    TEST_CHECK( ospi_ProgramPages( &xOSPI, ulAddr, ucPattern, 256, TEST_TIMEOUT ) == pdTRUE );
+    pxHndlDCache = pxDCache;
+    TEST_CHECK( memcmp( pucMx25lmSimArray( ulAddr ), ucPattern, 256 ) == 0 );
+    prvCheckRead( ulAddr, ucErased, 256 );
+
+    TEST_CHECK( HAL_DCACHE_InvalidateByAddr( pxHndlDCache, ( const uint32_t * ) ( MX25LM_MEM_MAPPED_BASE + ulAddr ), 256 ) == HAL_OK );
+    prvCheckRead( ulAddr, ucPattern, 256 );
+
+    TEST_CHECK( ospi_DisableMemMappedMode( &xOSPI ) == pdTRUE );
+    TEST_CHECK( xMx25lmSim.xMemMapped == pdFALSE );
+
+    /* Reading uncached lines of the window outside memory mapped mode aborts */
+    pid_t xChild = fork();
+
+    if( xChild == 0 )
+    {
+        ( void ) close( STDERR_FILENO );
+        ( void ) ( ( volatile const uint8_t * ) MX25LM_MEM_MAPPED_BASE )[ 3 * MX25LM_SECTOR_SZ ];
+        _exit( 0 );
+    }
+    else
+    {
+        int lStatus = 0;
+
+        TEST_CHECK( waitpid( xChild, &lStatus, 0 ) == xChild );
+        TEST_CHECK( WIFSIGNALED( lStatus ) );
+    }
+
+    TEST_CHECK( xMx25lmSim.ulErrors == 0 );
+
+    printf( "stale data: detected without an invalidation, window reads outside memory mapped mode abort\n" );
+}
+
+static void prvLfsRead( const struct lfs_config * pxCfg,
+                        lfs_off_t xOff,
+                        const uint8_t * pucExpected,
+                        lfs_size_t xSize )
+{
+    TEST_CHECK( pxCfg->lock( pxCfg ) == 0 );
+    ( void ) memset( ucRead, 0xA5, xSize );
+    TEST_CHECK( pxCfg->read( pxCfg, TEST_LFS_BLOCK, xOff, ucRead, xSize ) == 0 );
+    TEST_CHECK( pxCfg->unlock( pxCfg ) == 0 );
+    TEST_CHECK( memcmp( ucRead, pucExpected, xSize ) == 0 );
+}
+
+/* Block device reads see every program and erase, whichever read path the port is built with */
+static void prvTestLfsPort( void )
+{
+    const struct lfs_config * pxCfg;
+    LfsPortStats_t xStats;
+
+    vMx25lmSimInit();
+    pxCfg = pxInitializeOSPIFlashFs( portMAX_DELAY );
+    TEST_CHECK( pxCfg != NULL );
+    TEST_CHECK( xMx25lmSim.xMemMapped == ( LFS_PORT_OSPI_MEM_MAPPED_READ == 1 ) );
+    xMx25lmSim.ulEventCount = 0;
+
+    prvLfsRead( pxCfg, 16, ucErased, 16 );
+    prvLfsRead( pxCfg, 64, ucErased, 16 );
+
+    TEST_CHECK( pxCfg->lock( pxCfg ) == 0 );
+    TEST_CHECK( pxCfg->prog( pxCfg, TEST_LFS_BLOCK, 0, ucPattern, 256 ) == 0 );
+    TEST_CHECK( pxCfg->unlock( pxCfg ) == 0 );
+    prvLfsRead( pxCfg, 16, &( ucPattern[ 16 ] ), 16 );
+
+    TEST_CHECK( pxCfg->lock( pxCfg ) == 0 );
+    TEST_CHECK( pxCfg->erase( pxCfg, TEST_LFS_BLOCK ) == 0 );
+    TEST_CHECK( pxCfg->unlock( pxCfg ) == 0 );
+    prvLfsRead( pxCfg, 16, ucErased, 16 );
+
+    /* Whole block reads are never served from the read-ahead cache */
+    prvLfsRead( pxCfg, 0, ucErased, pxCfg->block_size );
+
+    vLfsPortGetStats( pxCfg, &xStats );
+
+    #if LFS_PORT_OSPI_MEM_MAPPED_READ == 1
+        TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventRead, 0 ) == 0 );
+        TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventInvalidate, 0 ) == 2 );
+        TEST_CHECK( xStats.ulCacheFills == 0 );
+        TEST_CHECK( xStats.ulReadOps == 5 );
+    #else
+        /* One fill for the first reads, kept up to date by the program, and one after the erase */
+        TEST_CHECK( xStats.ulCacheFills == 2 );
+        TEST_CHECK( xStats.ulCacheHits == 4 );
+        TEST_CHECK( xStats.ulReadOps == 1 );
+        TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventRead, 0 ) == 3 );
+        TEST_CHECK( ulMx25lmSimCountEvents( eMx25lmEventInvalidate, 0 ) == 0 );
+    #endif
+
+    TEST_CHECK( xStats.ulProgOps == 1 );
+    TEST_CHECK( xStats.ulEraseOps == 1 );
+    TEST_CHECK( xMx25lmSim.ulErrors == 0 );
+
+    printf( "lfs port: %s reads coherent, %lu cache fills, %lu cache hits\n",
+            ( LFS_PORT_OSPI_MEM_MAPPED_READ == 1 ) ? "memory mapped" : "indirect",
+            ( unsigned long ) xStats.ulCacheFills,
+            ( unsigned long ) xStats.ulCacheHits );
+}
+
+int main( void )
+{
+    for( uint32_t ulIdx = 0; ulIdx < TEST_BUFFER_LEN; ulIdx++ )
+    {
+        ucPattern[ ulIdx ] = ( uint8_t ) ( ( ulIdx * 13 ) + 1 );
+    }
+
+    ( void ) memset( ucErased, 0xFF, sizeof( ucErased ) );
+
+    prvTestModeSwitch();
+    prvTestMemMappedProgramErase();
+    prvTestStaleDetection();
+    prvTestLfsPort();
+
+    printf( "mx25lm_test passed\n" );
+
+    return 0;
+}
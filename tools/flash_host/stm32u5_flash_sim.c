@@ -0,0 +1,410 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * RAM model of the STM32U5 internal flash behind the flash HAL shim. See stm32u5_flash_sim.h for the rules enforced.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "stm32u5xx.h"
+#include "stm32u5_flash_sim.h"
+
+#define FLASH_QUADWORD_LEN       ( 16UL )
+#define FLASH_BURST_LEN          ( 8UL * FLASH_QUADWORD_LEN )
+#define FLASH_SIM_STACK_SIZE     ( 1024UL * 1024UL )
+
+/* Option bytes as shipped: dual bank, no swap. They are kept after the array in a backing file. */
+#define FLASH_SIM_OPTR_DEFAULT   ( OB_DUALBANK_DUAL )
+#define FLASH_SIM_OPTR_OFFSET    ( FLASH_SIZE )
+
+FlashSimStats_t xFlashSimStats;
+
+static uint8_t * pucFlash = NULL;
+static BaseType_t xLocked = pdTRUE;
+static uint32_t ulFlags = 0;
+static BaseType_t xOptionsLocked = pdTRUE;
+static uint32_t ulOptr = FLASH_SIM_OPTR_DEFAULT;
+
+/* SWAP_BANK as loaded at boot, which decides the bank mapped at FLASH_BASE until the next reset */
+static BaseType_t xBanksSwapped = pdFALSE;
+static int lBackingFd = -1;
+
+void vFlashSimInit( void )
+{
+    if( pucFlash == NULL )
+    {
+        pucFlash = mmap( ( void * ) FLASH_BASE, FLASH_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+        configASSERT( pucFlash == ( uint8_t * ) FLASH_BASE );
+    }
+
+    configASSERT( lBackingFd < 0 );
+
+    ( void ) memset( pucFlash, 0xFF, FLASH_SIZE );
+    ( void ) memset( &xFlashSimStats, 0, sizeof( xFlashSimStats ) );
+    xLocked = pdTRUE;
+    xOptionsLocked = pdTRUE;
+    ulFlags = 0;
+    ulOptr = FLASH_SIM_OPTR_DEFAULT;
+    xBanksSwapped = pdFALSE;
+}
+
+void vFlashSimBoot( const char * pcPath )
+{
+    struct stat xStat;
+
+    configASSERT( pucFlash == NULL );
+
+    lBackingFd = open( pcPath, O_RDWR | O_CREAT, 0600 );
+    configASSERT( lBackingFd >= 0 );
+    configASSERT( fstat( lBackingFd, &xStat ) == 0 );
+
+    if( xStat.st_size == 0 )
+    {
+        uint8_t * pucErased = malloc( FLASH_SIZE );
+
+        configASSERT( pucErased != NULL );
+        ( void ) memset( pucErased, 0xFF, FLASH_SIZE );
+        configASSERT( pwrite( lBackingFd, pucErased, FLASH_SIZE, 0 ) == ( ssize_t ) FLASH_SIZE );
+        configASSERT( pwrite( lBackingFd, &ulOptr, sizeof( ulOptr ), FLASH_SIM_OPTR_OFFSET ) == sizeof( ulOptr ) );
+        free( pucErased );
+    }
+
+    configASSERT( pread( lBackingFd, &ulOptr, sizeof( ulOptr ), FLASH_SIM_OPTR_OFFSET ) == sizeof( ulOptr ) );
+    xBanksSwapped = ( ( ulOptr & OB_SWAP_BANK_ENABLE ) != 0 ) ? pdTRUE : pdFALSE;
+
+    /* The reset loads SWAP_BANK: with it set, bank 2 is read and programmed at FLASH_BASE */
+    configASSERT( mmap( ( void * ) FLASH_BASE, FLASH_BANK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED_NOREPLACE, lBackingFd,
+                        ( xBanksSwapped == pdTRUE ) ? FLASH_BANK_SIZE : 0 ) == ( void * ) FLASH_BASE );
+    configASSERT( mmap( ( void * ) ( FLASH_BASE + FLASH_BANK_SIZE ), FLASH_BANK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_FIXED_NOREPLACE, lBackingFd,
+                        ( xBanksSwapped == pdTRUE ) ? 0 : FLASH_BANK_SIZE ) == ( void * ) ( FLASH_BASE + FLASH_BANK_SIZE ) );
+
+    pucFlash = ( uint8_t * ) FLASH_BASE;
+    ( void ) memset( &xFlashSimStats, 0, sizeof( xFlashSimStats ) );
+    xLocked = pdTRUE;
+    xOptionsLocked = pdTRUE;
+    ulFlags = 0;
+}
+
+void vFlashSimReset( void )
+{
+    if( lBackingFd >= 0 )
+    {
+        ( void ) msync( pucFlash, FLASH_SIZE, MS_SYNC );
+        ( void ) fsync( lBackingFd );
+    }
+
+    ( void ) fflush( NULL );
+    _exit( FLASH_SIM_EXIT_RESET );
+}
+
+uint32_t ulFlashSimGetFlags( void )
+{
+    return ulFlags;
+}
+
+void * pvFlashSimAlloc( size_t xSize )
+{
+    void * pvBuffer = mmap( NULL, xSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0 );
+
+    configASSERT( pvBuffer != MAP_FAILED );
+
+    return pvBuffer;
+}
+
+BaseType_t xFlashSimRun( void ( * pvEntry )( void * ),
+                         void * pvArg )
+{
+    pthread_attr_t xAttr;
+    pthread_t xThread;
+    BaseType_t xResult = pdFAIL;
+
+    ( void ) pthread_attr_init( &xAttr );
+
+    if( ( pthread_attr_setstack( &xAttr, pvFlashSimAlloc( FLASH_SIM_STACK_SIZE ), FLASH_SIM_STACK_SIZE ) == 0 ) &&
+        ( pthread_create( &xThread, &xAttr, ( void * ( * )( void * ) )pvEntry, pvArg ) == 0 ) )
+    {
+        ( void ) pthread_join( xThread, NULL );
+        xResult = pdPASS;
+    }
+
+    ( void ) pthread_attr_destroy( &xAttr );
+
+    return xResult;
+}
+
+static HAL_StatusTypeDef prvFail( uint32_t ulFlag )
+{
+    ulFlags |= ulFlag;
+    xFlashSimStats.ulErrors++;
+
+    return HAL_ERROR;
+}
+
+/* Pending errors fail the next operation, as FLASH_WaitForLastOperation does on target */
+static HAL_StatusTypeDef prvCheckReady( void )
+{
+    HAL_StatusTypeDef xStatus = HAL_OK;
+
+    if( ulFlags != 0 )
+    {
+        xFlashSimStats.ulErrors++;
+        xStatus = HAL_ERROR;
+    }
+    else if( xLocked == pdTRUE )
+    {
+        xStatus = prvFail( FLASH_SIM_WRPERR );
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock( void )
+{
+    xLocked = pdFALSE;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock( void )
+{
+    xLocked = pdTRUE;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock( void )
+{
+    HAL_StatusTypeDef xStatus = HAL_OK;
+
+    /* OPTLOCK can only be cleared once the control register is unlocked */
+    if( xLocked == pdTRUE )
+    {
+        xStatus = HAL_ERROR;
+    }
+    else
+    {
+        xOptionsLocked = pdFALSE;
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Lock( void )
+{
+    xOptionsLocked = pdTRUE;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_OB_Launch( void )
+{
+    if( xOptionsLocked == pdFALSE )
+    {
+        /* OBL_LAUNCH resets the device to load the option bytes, and does not return */
+        vFlashSimReset();
+    }
+
+    return HAL_ERROR;
+}
+
+uint32_t HAL_FLASH_GetError( void )
+{
+    return ulFlags;
+}
+
+void vFlashSimClearFlags( uint32_t ulClear )
+{
+    ( void ) ulClear;
+    ulFlags = 0;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program( uint32_t TypeProgram,
+                                     uint32_t Address,
+                                     uint32_t DataAddress )
+{
+    HAL_StatusTypeDef xStatus = prvCheckReady();
+    uint32_t ulLen = ( TypeProgram == FLASH_TYPEPROGRAM_BURST ) ? FLASH_BURST_LEN : FLASH_QUADWORD_LEN;
+    const uint8_t * pucSrc = ( const uint8_t * ) ( uintptr_t ) DataAddress;
+
+    configASSERT( ( TypeProgram == FLASH_TYPEPROGRAM_BURST ) || ( TypeProgram == FLASH_TYPEPROGRAM_QUADWORD ) );
+    configASSERT( ( DataAddress % sizeof( uint32_t ) ) == 0 );
+
+    if( xStatus != HAL_OK )
+    {
+        /* Already rejected */
+    }
+    else if( ( Address < FLASH_BASE ) ||
+             ( ( Address + ulLen ) > ( FLASH_BASE + FLASH_SIZE ) ) ||
+             ( ( Address % ulLen ) != 0 ) )
+    {
+        xStatus = prvFail( FLASH_SIM_PGAERR );
+    }
+    else
+    {
+        uint8_t * pucDest = &( pucFlash[ Address - FLASH_BASE ] );
+
+        for( uint32_t ulOffset = 0; ( ulOffset < ulLen ) && ( xStatus == HAL_OK ); ulOffset += FLASH_QUADWORD_LEN )
+        {
+            BaseType_t xErased = pdTRUE;
+            BaseType_t xZero = pdTRUE;
+
+            for( uint32_t ulIdx = 0; ulIdx < FLASH_QUADWORD_LEN; ulIdx++ )
+            {
+                xErased &= ( pucDest[ ulOffset + ulIdx ] == 0xFF ) ? pdTRUE : pdFALSE;
+                xZero &= ( pucSrc[ ulOffset + ulIdx ] == 0x00 ) ? pdTRUE : pdFALSE;
+            }
+
+            if( ( xErased == pdFALSE ) && ( xZero == pdFALSE ) )
+            {
+                xStatus = prvFail( FLASH_SIM_PROGERR );
+            }
+        }
+
+        if( xStatus == HAL_OK )
+        {
+            ( void ) memcpy( pucDest, pucSrc, ulLen );
+
+            if( TypeProgram == FLASH_TYPEPROGRAM_BURST )
+            {
+                xFlashSimStats.ulBurstPrograms++;
+                xFlashSimStats.ullBusyNs += FLASH_SIM_BURST_NS;
+            }
+            else
+            {
+                xFlashSimStats.ulQuadWordPrograms++;
+                xFlashSimStats.ullBusyNs += FLASH_SIM_QUADWORD_NS;
+            }
+        }
+    }
+
+    return xStatus;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase( FLASH_EraseInitTypeDef * pEraseInit,
+                                     uint32_t * PageError )
+{
+    HAL_StatusTypeDef xStatus = prvCheckReady();
+    uint32_t ulFirstPage = 0;
+    uint32_t ulPages = FLASH_PAGE_NB;
+
+    configASSERT( pEraseInit != NULL );
+    configASSERT( PageError != NULL );
+    configASSERT( ( pEraseInit->Banks == FLASH_BANK_1 ) || ( pEraseInit->Banks == FLASH_BANK_2 ) );
+
+    *PageError = 0xFFFFFFFFUL;
+
+    if( pEraseInit->TypeErase == FLASH_TYPEERASE_PAGES )
+    {
+        ulFirstPage = pEraseInit->Page;
+        ulPages = pEraseInit->NbPages;
+    }
+
+    if( xStatus != HAL_OK )
+    {
+        /* Already rejected */
+    }
+    else if( ( ulFirstPage + ulPages ) > FLASH_PAGE_NB )
+    {
+        *PageError = ulFirstPage;
+        xStatus = prvFail( FLASH_SIM_PGAERR );
+    }
+    else
+    {
+        /* Banks names the physical bank, which is mapped at the upper address when the banks are swapped */
+        uint32_t ulBankPage = ( pEraseInit->Banks == FLASH_BANK_2 ) ? FLASH_PAGE_NB : 0;
+        uint32_t ulMappedPage = ( ( pEraseInit->Banks == FLASH_BANK_2 ) != ( xBanksSwapped == pdTRUE ) ) ? FLASH_PAGE_NB : 0;
+
+        for( uint32_t ulPage = ulFirstPage; ulPage < ( ulFirstPage + ulPages ); ulPage++ )
+        {
+            ( void ) memset( &( pucFlash[ ( ulMappedPage + ulPage ) * FLASH_PAGE_SIZE ] ), 0xFF, FLASH_PAGE_SIZE );
+            xFlashSimStats.ulPageErases++;
+            xFlashSimStats.ulPageEraseCounts[ ulBankPage + ulPage ]++;
+            xFlashSimStats.ullBusyNs += FLASH_SIM_PAGE_ERASE_NS;
+        }
+    }
+
+    return xStatus;
+}
+
+void HAL_FLASHEx_OBGetConfig( FLASH_OBProgramInitTypeDef * pOBInit )
+{
+    configASSERT( pOBInit != NULL );
+
+    pOBInit->OptionType = OPTIONBYTE_USER;
+    pOBInit->USERType = OB_USER_SWAP_BANK | OB_USER_DUALBANK;
+    pOBInit->USERConfig = ulOptr;
+}
+
+HAL_StatusTypeDef HAL_FLASHEx_OBProgram( FLASH_OBProgramInitTypeDef * pOBInit )
+{
+    HAL_StatusTypeDef xStatus = prvCheckReady();
+    uint32_t ulMask = 0;
+
+    configASSERT( pOBInit != NULL );
+    configASSERT( pOBInit->OptionType == OPTIONBYTE_USER );
+
+    if( ( pOBInit->USERType & OB_USER_SWAP_BANK ) != 0 )
+    {
+        ulMask |= OB_SWAP_BANK_ENABLE;
+    }
+
+    if( ( pOBInit->USERType & OB_USER_DUALBANK ) != 0 )
+    {
+        ulMask |= OB_DUALBANK_DUAL;
+    }
+
+    if( xStatus != HAL_OK )
+    {
+        /* Already rejected */
+    }
+    else if( xOptionsLocked == pdTRUE )
+    {
+        xStatus = prvFail( FLASH_SIM_WRPERR );
+    }
+    else
+    {
+        /* Takes effect at the next reset, as the banks stay mapped as they were loaded */
+        ulOptr = ( ulOptr & ~ulMask ) | ( pOBInit->USERConfig & ulMask );
+
+        if( lBackingFd >= 0 )
+        {
+            configASSERT( pwrite( lBackingFd, &ulOptr, sizeof( ulOptr ), FLASH_SIM_OPTR_OFFSET ) == sizeof( ulOptr ) );
+        }
+    }
+
+    return xStatus;
+}
@@ -0,0 +1,102 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * RAM model of the STM32U5 internal flash, enforcing the programming rules of the flash interface:
+ *  - The flash must be unlocked to program or erase, and error flags left set fail the next operation.
+ *  - Quad-word programs must be 16 byte aligned, burst programs 128 byte aligned.
+ *  - A quad-word can only be programmed once after an erase, apart from overwriting it with zeros.
+ *  - Option bytes can only be programmed with both the flash and the option bytes unlocked.
+ * Rejected operations set the matching error flag, count in xFlashSimStats and leave the flash untouched.
+ * Successful operations add their typical duration to xFlashSimStats.ullBusyNs, for the benchmarks.
+ *
+ * Erases name the physical bank. SWAP_BANK only changes which bank is mapped at FLASH_BASE when it is
+ * loaded by a reset, so a test that swaps banks boots each image as a separate process from a backing file.
+ */
+#ifndef STM32U5_FLASH_SIM_H
+#define STM32U5_FLASH_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "stm32u5xx.h"
+
+/* Error flags, using the bit positions of FLASH_NSSR */
+#define FLASH_SIM_PROGERR    ( 0x00000008UL )
+#define FLASH_SIM_WRPERR     ( 0x00000010UL )
+#define FLASH_SIM_PGAERR     ( 0x00000020UL )
+
+/* Exit status of a process reset through HAL_FLASH_OB_Launch or vFlashSimReset */
+#define FLASH_SIM_EXIT_RESET    ( 64 )
+
+/* Typical operation times of the STM32U5 internal flash, override to model other parts */
+#ifndef FLASH_SIM_QUADWORD_NS
+    #define FLASH_SIM_QUADWORD_NS      ( 118000ULL )
+#endif
+#ifndef FLASH_SIM_BURST_NS
+    #define FLASH_SIM_BURST_NS         ( 496000ULL )
+#endif
+#ifndef FLASH_SIM_PAGE_ERASE_NS
+    #define FLASH_SIM_PAGE_ERASE_NS    ( 1500000ULL )
+#endif
+
+typedef struct FlashSimStats
+{
+    uint32_t ulQuadWordPrograms;
+    uint32_t ulBurstPrograms;
+    uint32_t ulPageErases;
+    uint32_t ulErrors;
+    uint64_t ullBusyNs;
+    uint32_t ulPageEraseCounts[ FLASH_SIZE / FLASH_PAGE_SIZE ];
+} FlashSimStats_t;
+
+extern FlashSimStats_t xFlashSimStats;
+
+/* Map the flash at FLASH_BASE, erased with the default option bytes, and reset the statistics */
+void vFlashSimInit( void );
+
+/*
+ * Map the flash at FLASH_BASE from a backing file holding the array and the option bytes, as a power
+ * on would, creating it erased when it does not exist yet. Replaces vFlashSimInit for tests which reset.
+ */
+void vFlashSimBoot( const char * pcPath );
+
+/* Write the flash back to its backing file and exit with FLASH_SIM_EXIT_RESET, as a system reset */
+void vFlashSimReset( void );
+
+/* Return the error flags set since they were last cleared */
+uint32_t ulFlashSimGetFlags( void );
+
+/*
+ * The flash HAL takes source buffers as 32 bit addresses, as on target. Buffers handed to it must be
+ * allocated below 4 GiB with pvFlashSimAlloc, and code passing stack buffers must run through xFlashSimRun.
+ * Test binaries are linked with -no-pie so that static buffers qualify as well.
+ */
+void * pvFlashSimAlloc( size_t xSize );
+BaseType_t xFlashSimRun( void ( * pvEntry )( void * ),
+                         void * pvArg );
+
+#endif /* STM32U5_FLASH_SIM_H */
@@ -0,0 +1,54 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Host shim for the STM32U5 device header. On target FreeRTOSConfig.h pulls this in, so the host
+ * builds force include it. The internal flash is a RAM model mapped at FLASH_BASE by stm32u5_flash_sim.c,
+ * and the OCTOSPI2 window at OCTOSPI2_BASE is backed by mx25lm_sim.c.
+ */
+#ifndef FLASH_HOST_STM32U5XX_H
+#define FLASH_HOST_STM32U5XX_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+#define FLASH_BASE         ( 0x08000000UL )
+#define FLASH_SIZE         ( 0x00200000UL )
+#define FLASH_BANK_SIZE    ( FLASH_SIZE >> 1 )
+#define FLASH_PAGE_SIZE    ( 0x00002000UL )
+#define FLASH_PAGE_NB      ( FLASH_BANK_SIZE / FLASH_PAGE_SIZE )
+
+#define __ALIGN_BEGIN
+#define __ALIGN_END        __attribute__( ( aligned( 4 ) ) )
+
+#include "stm32u5xx_hal_flash.h"
+#include "stm32u5xx_hal_flash_ex.h"
+#include "stm32u5xx_hal_periph.h"
+#include "stm32u5xx_hal_dma.h"
+#include "stm32u5xx_hal_dcache.h"
+#include "stm32u5xx_hal_ospi.h"
+
+#endif /* FLASH_HOST_STM32U5XX_H */
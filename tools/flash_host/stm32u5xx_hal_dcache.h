@@ -0,0 +1,43 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/* Host shim for the STM32U5 DCACHE HAL. The model of DCACHE1 over the OCTOSPI2 window is in mx25lm_sim.c. */
+#ifndef FLASH_HOST_STM32U5XX_HAL_DCACHE_H
+#define FLASH_HOST_STM32U5XX_HAL_DCACHE_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+typedef struct
+{
+    uint32_t ulUnused;
+} DCACHE_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_DCACHE_InvalidateByAddr( DCACHE_HandleTypeDef * hdcache,
+                                               const uint32_t * const pAddr,
+                                               uint32_t dSize );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_DCACHE_H */
@@ -0,0 +1,93 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/* Host shim for the STM32U5 GPDMA HAL. Transfers complete as soon as the model has copied the data. */
+#ifndef FLASH_HOST_STM32U5XX_HAL_DMA_H
+#define FLASH_HOST_STM32U5XX_HAL_DMA_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+typedef struct
+{
+    uint32_t ulUnused;
+} DMA_Channel_TypeDef;
+
+extern DMA_Channel_TypeDef xHostGpdma1Channel12;
+
+#define GPDMA1_Channel12    ( &xHostGpdma1Channel12 )
+
+typedef struct
+{
+    uint32_t Request;
+    uint32_t BlkHWRequest;
+    uint32_t Direction;
+    uint32_t SrcInc;
+    uint32_t DestInc;
+    uint32_t SrcDataWidth;
+    uint32_t DestDataWidth;
+    uint32_t Priority;
+    uint32_t SrcBurstLength;
+    uint32_t DestBurstLength;
+    uint32_t TransferAllocatedPort;
+    uint32_t TransferEventMode;
+    uint32_t Mode;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef
+{
+    DMA_Channel_TypeDef * Instance;
+    DMA_InitTypeDef Init;
+    void * Parent;
+} DMA_HandleTypeDef;
+
+#define GPDMA1_REQUEST_OCTOSPI2          ( 40U )
+#define DMA_BREQ_SINGLE_BURST            ( 0U )
+#define DMA_PERIPH_TO_MEMORY             ( 0U )
+#define DMA_SINC_FIXED                   ( 0U )
+#define DMA_DINC_INCREMENTED             ( 1U )
+#define DMA_SRC_DATAWIDTH_BYTE           ( 0U )
+#define DMA_DEST_DATAWIDTH_BYTE          ( 0U )
+#define DMA_LOW_PRIORITY_HIGH_WEIGHT     ( 2U )
+#define DMA_SRC_ALLOCATED_PORT0          ( 0U )
+#define DMA_DEST_ALLOCATED_PORT1         ( 1U )
+#define DMA_TCEM_BLOCK_TRANSFER          ( 0U )
+#define DMA_NORMAL                       ( 0U )
+#define DMA_CHANNEL_NPRIV                ( 0U )
+
+#define __HAL_LINKDMA( __HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__ ) \
+    do {                                                               \
+        ( __HANDLE__ )->__PPP_DMA_FIELD__ = &( __DMA_HANDLE__ );       \
+        ( __DMA_HANDLE__ ).Parent = ( __HANDLE__ );                    \
+    } while( 0 )
+
+HAL_StatusTypeDef HAL_DMA_Init( DMA_HandleTypeDef * hdma );
+HAL_StatusTypeDef HAL_DMA_DeInit( DMA_HandleTypeDef * hdma );
+HAL_StatusTypeDef HAL_DMA_ConfigChannelAttributes( DMA_HandleTypeDef * hdma,
+                                                   uint32_t ChannelAttributes );
+void HAL_DMA_IRQHandler( DMA_HandleTypeDef * hdma );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_DMA_H */
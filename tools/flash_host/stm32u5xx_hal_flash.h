@@ -0,0 +1,54 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/* Host shim for the STM32U5 flash HAL, implemented over the RAM model in stm32u5_flash_sim.c */
+#ifndef FLASH_HOST_STM32U5XX_HAL_FLASH_H
+#define FLASH_HOST_STM32U5XX_HAL_FLASH_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+#define FLASH_TYPEPROGRAM_QUADWORD    ( 0x00000001UL )
+#define FLASH_TYPEPROGRAM_BURST       ( 0x00004001UL )
+
+#define FLASH_FLAG_ALL_ERRORS         ( 0x000020FAUL )
+
+#define __HAL_FLASH_CLEAR_FLAG( __FLAG__ )    vFlashSimClearFlags( __FLAG__ )
+
+HAL_StatusTypeDef HAL_FLASH_Unlock( void );
+HAL_StatusTypeDef HAL_FLASH_Lock( void );
+HAL_StatusTypeDef HAL_FLASH_Program( uint32_t TypeProgram,
+                                     uint32_t Address,
+                                     uint32_t DataAddress );
+uint32_t HAL_FLASH_GetError( void );
+
+HAL_StatusTypeDef HAL_FLASH_OB_Unlock( void );
+HAL_StatusTypeDef HAL_FLASH_OB_Lock( void );
+HAL_StatusTypeDef HAL_FLASH_OB_Launch( void );
+
+void vFlashSimClearFlags( uint32_t ulFlags );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_FLASH_H */
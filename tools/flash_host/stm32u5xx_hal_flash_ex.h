@@ -0,0 +1,71 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/* Host shim for the STM32U5 flash HAL extension: page and mass erase, and the user option bytes */
+#ifndef FLASH_HOST_STM32U5XX_HAL_FLASH_EX_H
+#define FLASH_HOST_STM32U5XX_HAL_FLASH_EX_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+#define FLASH_TYPEERASE_PAGES        ( 0x00000002UL )
+#define FLASH_TYPEERASE_MASSERASE    ( 0x00008004UL )
+
+#define FLASH_BANK_1                 ( 0x00000001UL )
+#define FLASH_BANK_2                 ( 0x00000002UL )
+
+typedef struct
+{
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t Page;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+#define OPTIONBYTE_USER              ( 0x00000004UL )
+
+#define OB_USER_SWAP_BANK            ( 0x00000100UL )
+#define OB_USER_DUALBANK             ( 0x00000200UL )
+
+/* User option values, using the bit positions of FLASH_OPTR */
+#define OB_SWAP_BANK_DISABLE         ( 0x00000000UL )
+#define OB_SWAP_BANK_ENABLE          ( 0x00100000UL )
+#define OB_DUALBANK_SINGLE           ( 0x00000000UL )
+#define OB_DUALBANK_DUAL             ( 0x00200000UL )
+
+typedef struct
+{
+    uint32_t OptionType;
+    uint32_t USERType;
+    uint32_t USERConfig;
+} FLASH_OBProgramInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASHEx_Erase( FLASH_EraseInitTypeDef * pEraseInit,
+                                     uint32_t * PageError );
+HAL_StatusTypeDef HAL_FLASHEx_OBProgram( FLASH_OBProgramInitTypeDef * pOBInit );
+void HAL_FLASHEx_OBGetConfig( FLASH_OBProgramInitTypeDef * pOBInit );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_FLASH_EX_H */
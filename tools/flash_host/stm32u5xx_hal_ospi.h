@@ -0,0 +1,254 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Host shim for the STM32U5 OCTOSPI HAL. The calls are served by the MX25LM51245G model in
+ * mx25lm_sim.c, which also backs the OCTOSPI2 memory mapped window.
+ */
+#ifndef FLASH_HOST_STM32U5XX_HAL_OSPI_H
+#define FLASH_HOST_STM32U5XX_HAL_OSPI_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+#include "stm32u5xx_hal_dma.h"
+
+#define OCTOSPI2_BASE    ( 0x70000000UL )
+
+typedef struct
+{
+    volatile uint32_t CR;
+    volatile uint32_t DCR1;
+    volatile uint32_t DCR2;
+    volatile uint32_t DCR3;
+    volatile uint32_t DCR4;
+} OCTOSPI_TypeDef;
+
+typedef struct
+{
+    volatile uint32_t CR;
+    volatile uint32_t CFGR;
+} DLYB_TypeDef;
+
+extern OCTOSPI_TypeDef xHostOctospi2;
+extern DLYB_TypeDef xHostDlybOctospi2;
+
+#define OCTOSPI2              ( &xHostOctospi2 )
+#define DLYB_OCTOSPI2_NS      ( &xHostDlybOctospi2 )
+#define OCTOSPI_DCR1_FRCK     ( 0x00000002UL )
+
+#define SET_BIT( REG, BIT )      ( ( REG ) |= ( BIT ) )
+#define CLEAR_BIT( REG, BIT )    ( ( REG ) &= ~( BIT ) )
+
+typedef struct
+{
+    uint32_t FifoThreshold;
+    uint32_t DualQuad;
+    uint32_t MemoryType;
+    uint32_t DeviceSize;
+    uint32_t ChipSelectHighTime;
+    uint32_t FreeRunningClock;
+    uint32_t ClockMode;
+    uint32_t WrapSize;
+    uint32_t ClockPrescaler;
+    uint32_t SampleShifting;
+    uint32_t DelayHoldQuarterCycle;
+    uint32_t ChipSelectBoundary;
+    uint32_t DelayBlockBypass;
+    uint32_t MaxTran;
+    uint32_t Refresh;
+} OSPI_InitTypeDef;
+
+typedef struct
+{
+    uint32_t OperationType;
+    uint32_t FlashId;
+    uint32_t Instruction;
+    uint32_t InstructionMode;
+    uint32_t InstructionSize;
+    uint32_t InstructionDtrMode;
+    uint32_t Address;
+    uint32_t AddressMode;
+    uint32_t AddressSize;
+    uint32_t AddressDtrMode;
+    uint32_t AlternateBytes;
+    uint32_t AlternateBytesMode;
+    uint32_t AlternateBytesSize;
+    uint32_t AlternateBytesDtrMode;
+    uint32_t DataMode;
+    uint32_t NbData;
+    uint32_t DataDtrMode;
+    uint32_t DummyCycles;
+    uint32_t DQSMode;
+    uint32_t SIOOMode;
+} OSPI_RegularCmdTypeDef;
+
+typedef struct
+{
+    uint32_t Match;
+    uint32_t Mask;
+    uint32_t MatchMode;
+    uint32_t AutomaticStop;
+    uint32_t Interval;
+} OSPI_AutoPollingTypeDef;
+
+typedef struct
+{
+    uint32_t TimeOutActivation;
+    uint32_t TimeOutPeriod;
+} OSPI_MemoryMappedTypeDef;
+
+typedef struct
+{
+    uint32_t ClkPort;
+    uint32_t DQSPort;
+    uint32_t NCSPort;
+    uint32_t IOLowPort;
+    uint32_t IOHighPort;
+} OSPIM_CfgTypeDef;
+
+typedef struct
+{
+    uint32_t Units;
+    uint32_t PhaseSel;
+} HAL_OSPI_DLYB_CfgTypeDef;
+
+typedef enum
+{
+    HAL_OSPI_ERROR_CB_ID = 0x00U,
+    HAL_OSPI_ABORT_CB_ID = 0x01U,
+    HAL_OSPI_FIFO_THRESHOLD_CB_ID = 0x02U,
+    HAL_OSPI_CMD_CPLT_CB_ID = 0x03U,
+    HAL_OSPI_RX_CPLT_CB_ID = 0x04U,
+    HAL_OSPI_TX_CPLT_CB_ID = 0x05U,
+    HAL_OSPI_RX_HALF_CPLT_CB_ID = 0x06U,
+    HAL_OSPI_TX_HALF_CPLT_CB_ID = 0x07U,
+    HAL_OSPI_STATUS_MATCH_CB_ID = 0x08U,
+    HAL_OSPI_TIMEOUT_CB_ID = 0x09U,
+    HAL_OSPI_MSP_INIT_CB_ID = 0x0AU,
+    HAL_OSPI_MSP_DEINIT_CB_ID = 0x0BU
+} HAL_OSPI_CallbackIDTypeDef;
+
+#define HAL_OSPI_CALLBACK_COUNT    ( 0x0CU )
+
+typedef struct __OSPI_HandleTypeDef
+{
+    OCTOSPI_TypeDef * Instance;
+    OSPI_InitTypeDef Init;
+    DMA_HandleTypeDef * hdma;
+    void ( * pxCallbacks[ HAL_OSPI_CALLBACK_COUNT ] )( struct __OSPI_HandleTypeDef * hospi );
+
+    /* Command latched by HAL_OSPI_Command until its data phase */
+    OSPI_RegularCmdTypeDef xPendingCmd;
+    uint32_t ulState;
+} OSPI_HandleTypeDef;
+
+typedef void ( * pOSPI_CallbackTypeDef )( OSPI_HandleTypeDef * hospi );
+
+/* Values match the HAL where the driver or the model depend on them */
+#define HAL_OSPI_OPTYPE_COMMON_CFG              ( 0x00000000UL )
+#define HAL_OSPI_OPTYPE_READ_CFG                ( 0x00000001UL )
+#define HAL_OSPI_OPTYPE_WRITE_CFG               ( 0x00000002UL )
+
+#define HAL_OSPI_FLASH_ID_1                     ( 0x00000000UL )
+
+#define HAL_OSPI_INSTRUCTION_NONE               ( 0x00000000UL )
+#define HAL_OSPI_INSTRUCTION_1_LINE             ( 0x00000001UL )
+#define HAL_OSPI_INSTRUCTION_8_LINES            ( 0x00000004UL )
+#define HAL_OSPI_INSTRUCTION_8_BITS             ( 0x00000000UL )
+#define HAL_OSPI_INSTRUCTION_16_BITS            ( 0x00000010UL )
+#define HAL_OSPI_INSTRUCTION_DTR_DISABLE        ( 0x00000000UL )
+
+#define HAL_OSPI_ADDRESS_NONE                   ( 0x00000000UL )
+#define HAL_OSPI_ADDRESS_1_LINE                 ( 0x00000100UL )
+#define HAL_OSPI_ADDRESS_8_LINES                ( 0x00000400UL )
+#define HAL_OSPI_ADDRESS_32_BITS                ( 0x00003000UL )
+#define HAL_OSPI_ADDRESS_DTR_DISABLE            ( 0x00000000UL )
+
+#define HAL_OSPI_ALTERNATE_BYTES_NONE           ( 0x00000000UL )
+#define HAL_OSPI_ALTERNATE_BYTES_1_LINE         ( 0x00010000UL )
+#define HAL_OSPI_ALTERNATE_BYTES_8_BITS         ( 0x00000000UL )
+#define HAL_OSPI_ALTERNATE_BYTES_DTR_DISABLE    ( 0x00000000UL )
+
+#define HAL_OSPI_DATA_NONE                      ( 0x00000000UL )
+#define HAL_OSPI_DATA_1_LINE                    ( 0x01000000UL )
+#define HAL_OSPI_DATA_8_LINES                   ( 0x04000000UL )
+#define HAL_OSPI_DATA_DTR_DISABLE               ( 0x00000000UL )
+
+#define HAL_OSPI_DQS_DISABLE                    ( 0x00000000UL )
+#define HAL_OSPI_DQS_ENABLE                     ( 0x20000000UL )
+#define HAL_OSPI_SIOO_INST_EVERY_CMD            ( 0x00000000UL )
+
+#define HAL_OSPI_MATCH_MODE_AND                 ( 0x00000000UL )
+#define HAL_OSPI_AUTOMATIC_STOP_ENABLE          ( 0x00400000UL )
+#define HAL_OSPI_TIMEOUT_COUNTER_ENABLE         ( 0x00000010UL )
+#define HAL_OSPI_TIMEOUT_DEFAULT_VALUE          ( 5000UL )
+
+#define HAL_OSPI_DUALQUAD_DISABLE               ( 0x00000000UL )
+#define HAL_OSPI_MEMTYPE_MACRONIX               ( 0x01000000UL )
+#define HAL_OSPI_FREERUNCLK_ENABLE              ( 0x00000002UL )
+#define HAL_OSPI_CLOCK_MODE_0                   ( 0x00000000UL )
+#define HAL_OSPI_WRAP_NOT_SUPPORTED             ( 0x00000000UL )
+#define HAL_OSPI_SAMPLE_SHIFTING_NONE           ( 0x00000000UL )
+#define HAL_OSPI_DHQC_ENABLE                    ( 0x10000000UL )
+#define HAL_OSPI_DELAY_BLOCK_USED               ( 0x00000000UL )
+
+#define HAL_OSPIM_IOPORT_2_LOW                  ( 0x00000002UL )
+#define HAL_OSPIM_IOPORT_2_HIGH                 ( 0x00000012UL )
+
+#define __HAL_OSPI_ENABLE( __HANDLE__ )     ( ( __HANDLE__ )->Instance->CR |= 0x1UL )
+#define __HAL_OSPI_DISABLE( __HANDLE__ )    ( ( __HANDLE__ )->Instance->CR &= ~0x1UL )
+
+HAL_StatusTypeDef HAL_OSPI_Init( OSPI_HandleTypeDef * hospi );
+HAL_StatusTypeDef HAL_OSPI_RegisterCallback( OSPI_HandleTypeDef * hospi,
+                                             HAL_OSPI_CallbackIDTypeDef CallbackID,
+                                             pOSPI_CallbackTypeDef pCallback );
+HAL_StatusTypeDef HAL_OSPIM_Config( OSPI_HandleTypeDef * hospi,
+                                    OSPIM_CfgTypeDef * cfg,
+                                    uint32_t Timeout );
+HAL_StatusTypeDef HAL_OSPI_DLYB_SetConfig( OSPI_HandleTypeDef * hospi,
+                                           HAL_OSPI_DLYB_CfgTypeDef * pdlyb_cfg );
+HAL_StatusTypeDef HAL_OSPI_Command( OSPI_HandleTypeDef * hospi,
+                                    OSPI_RegularCmdTypeDef * cmd,
+                                    uint32_t Timeout );
+HAL_StatusTypeDef HAL_OSPI_Command_IT( OSPI_HandleTypeDef * hospi,
+                                       OSPI_RegularCmdTypeDef * cmd );
+HAL_StatusTypeDef HAL_OSPI_AutoPolling_IT( OSPI_HandleTypeDef * hospi,
+                                           OSPI_AutoPollingTypeDef * cfg );
+HAL_StatusTypeDef HAL_OSPI_Receive_IT( OSPI_HandleTypeDef * hospi,
+                                       uint8_t * pData );
+HAL_StatusTypeDef HAL_OSPI_Receive_DMA( OSPI_HandleTypeDef * hospi,
+                                        uint8_t * pData );
+HAL_StatusTypeDef HAL_OSPI_Transmit_IT( OSPI_HandleTypeDef * hospi,
+                                        uint8_t * pData );
+HAL_StatusTypeDef HAL_OSPI_Transmit_DMA( OSPI_HandleTypeDef * hospi,
+                                         uint8_t * pData );
+HAL_StatusTypeDef HAL_OSPI_MemoryMapped( OSPI_HandleTypeDef * hospi,
+                                         OSPI_MemoryMappedTypeDef * cfg );
+HAL_StatusTypeDef HAL_OSPI_Abort( OSPI_HandleTypeDef * hospi );
+HAL_StatusTypeDef HAL_OSPI_Abort_IT( OSPI_HandleTypeDef * hospi );
+void HAL_OSPI_IRQHandler( OSPI_HandleTypeDef * hospi );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_OSPI_H */
@@ -0,0 +1,105 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/* Host shim for the GPIO, RCC and NVIC calls made while setting up peripherals. They have no effect on the host. */
+#ifndef FLASH_HOST_STM32U5XX_HAL_PERIPH_H
+#define FLASH_HOST_STM32U5XX_HAL_PERIPH_H
+
+#include <stdint.h>
+
+#include "stm32u5xx_hal.h"
+
+typedef struct
+{
+    uint32_t Pin;
+    uint32_t Mode;
+    uint32_t Pull;
+    uint32_t Speed;
+    uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+extern GPIO_TypeDef xHostGpioF;
+extern GPIO_TypeDef xHostGpioH;
+extern GPIO_TypeDef xHostGpioI;
+
+#define GPIOF                         ( &xHostGpioF )
+#define GPIOH                         ( &xHostGpioH )
+#define GPIOI                         ( &xHostGpioI )
+
+#define GPIO_PIN_0                    ( 0x0001U )
+#define GPIO_PIN_1                    ( 0x0002U )
+#define GPIO_PIN_2                    ( 0x0004U )
+#define GPIO_PIN_3                    ( 0x0008U )
+#define GPIO_PIN_4                    ( 0x0010U )
+#define GPIO_PIN_5                    ( 0x0020U )
+#define GPIO_PIN_9                    ( 0x0200U )
+#define GPIO_PIN_10                   ( 0x0400U )
+#define GPIO_PIN_11                   ( 0x0800U )
+#define GPIO_PIN_12                   ( 0x1000U )
+
+#define GPIO_MODE_AF_PP               ( 0x00000002U )
+#define GPIO_NOPULL                   ( 0x00000000U )
+#define GPIO_PULLUP                   ( 0x00000001U )
+#define GPIO_SPEED_FREQ_VERY_HIGH     ( 0x00000003U )
+#define GPIO_AF5_OCTOSPI2             ( 0x05U )
+
+void HAL_GPIO_Init( GPIO_TypeDef * GPIOx,
+                    GPIO_InitTypeDef * GPIO_Init );
+void HAL_GPIO_DeInit( GPIO_TypeDef * GPIOx,
+                      uint32_t GPIO_Pin );
+
+typedef struct
+{
+    uint32_t PeriphClockSelection;
+    uint32_t OspiClockSelection;
+} RCC_PeriphCLKInitTypeDef;
+
+#define RCC_PERIPHCLK_OSPI            ( 0x00000001U )
+#define RCC_OSPICLKSOURCE_SYSCLK      ( 0x00000000U )
+
+#define __HAL_RCC_OSPI2_CLK_ENABLE()     do {} while( 0 )
+#define __HAL_RCC_OSPI2_CLK_DISABLE()    do {} while( 0 )
+#define __HAL_RCC_GPIOF_CLK_ENABLE()     do {} while( 0 )
+#define __HAL_RCC_GPIOH_CLK_ENABLE()     do {} while( 0 )
+#define __HAL_RCC_GPIOI_CLK_ENABLE()     do {} while( 0 )
+#define __HAL_RCC_GPDMA1_CLK_ENABLE()    do {} while( 0 )
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig( RCC_PeriphCLKInitTypeDef * PeriphClkInit );
+
+typedef enum
+{
+    OCTOSPI2_IRQn = 76,
+    GPDMA1_Channel12_IRQn = 94
+} IRQn_Type;
+
+void NVIC_SetVector( IRQn_Type IRQn,
+                     uint32_t vector );
+void HAL_NVIC_SetPriority( IRQn_Type IRQn,
+                           uint32_t PreemptPriority,
+                           uint32_t SubPriority );
+void HAL_NVIC_EnableIRQ( IRQn_Type IRQn );
+void HAL_NVIC_DisableIRQ( IRQn_Type IRQn );
+
+#endif /* FLASH_HOST_STM32U5XX_HAL_PERIPH_H */
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+"""Build and run the flash host tests in tools/flash_host.
+
+The tests compile the littlefs ports of Projects/b_u585i_iot02a_ntz/Src/fs for Linux, with the
+kernel shim of tools/mx_host and RAM models of the flash devices behind the HAL:
+    internal_nor_test   lfs_port_internal_nor.c against the STM32U5 internal flash model in
+                        stm32u5_flash_sim.c: burst and quad-word program alignment, the erase
+                        count journal and its wrap, and legacy volume detection. Also swaps
+                        the banks through the option bytes, booting each side of the reset
+                        as a separate process on a file backed flash array.
+    mx25lm_test         ospi_nor_mx25lmxxx45g.c and lfs_port_ospi.c against the MX25LM51245G
+                        command set and DCACHE1 model in mx25lm_sim.c: the SPI to OPI mode
+                        switch, memory mapped mode suspended around program and erase, and
+                        the DCACHE invalidation order. Built with LFS_PORT_OSPI_MEM_MAPPED_READ
+                        set to 1 and to 0, covering the read-ahead cache of the indirect path.
+
+The bench command builds littlefs from the Middleware/ARM/littlefs submodule with both ports and
+runs tools/flash_host/fsbench.c: KVStore commit, PKCS#11 object and OTA staging workloads on the
+unmodified lfs_config of each port. The flash models charge every program, erase and read its
+typical duration, and the benchmark reports throughput in that device time, write amplification
+and erase counts. Macros such as LFS_PORT_OSPI_MEM_MAPPED_READ, or the model latencies in
+mx25lm_sim.h and stm32u5_flash_sim.h, can be overridden with --define. selftest also runs the
+benchmark when the submodule is checked out.
+
+The models hand the port 32 bit addresses as the hardware does, so the binaries are linked
+without PIE and keep their buffers below 4 GiB.
+
+Usage:
+    flash_sim.py selftest
+    flash_sim.py bench [--define NAME=VALUE]... [ospi | internal]... [kv | pkcs11 | ota]...
+"""
+import argparse
+import os
+import subprocess
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOST_DIR = os.path.join(ROOT, "tools", "flash_host")
+FS_DIR = os.path.join(ROOT, "Projects", "b_u585i_iot02a_ntz", "Src", "fs")
+LITTLEFS_DIR = os.path.join(ROOT, "Middleware", "ARM", "littlefs")
+
+
+def lfs_include_dir():
+    """Use littlefs when the submodule is checked out, otherwise the declarations the ports need."""
+    if os.path.exists(os.path.join(LITTLEFS_DIR, "lfs.h")):
+        return LITTLEFS_DIR
+    return os.path.join(HOST_DIR, "lfs_decl")
+
+
+def build(out_dir, name, sources, defines=()):
+    """Build a test from tools/flash_host/NAME.c and the given repo sources."""
+    binary = os.path.join(out_dir, name)
+    subprocess.run([os.environ.get("CC", "cc"), "-O1", "-g", "-pthread", "-no-pie",
+                    "-Wno-incompatible-pointer-types", "-Wno-pointer-to-int-cast",
+                    "-Wno-int-to-pointer-cast",
+                    "-I", HOST_DIR,
+                    "-I", lfs_include_dir(),
+                    "-I", os.path.join(ROOT, "tools", "mx_host"),
+                    "-I", FS_DIR,
+                    "-include", "stm32u5xx.h",
+                    "-DLFS_CONFIG=lfs_config.h"] +
+                   ["-D%s" % define for define in defines] +
+                   [os.path.join(HOST_DIR, name + ".c"),
+                    os.path.join(ROOT, "tools", "mx_host", "mx_host_shim.c")] +
+                   sources + ["-o", binary], check=True)
+    return binary
+
+
+def fsbench_sources():
+    """Sources of the benchmark, or None when the littlefs submodule is not checked out."""
+    if not os.path.exists(os.path.join(LITTLEFS_DIR, "lfs.c")):
+        return None
+    return [os.path.join(LITTLEFS_DIR, "lfs.c"),
+            os.path.join(LITTLEFS_DIR, "lfs_util.c"),
+            os.path.join(HOST_DIR, "mx25lm_sim.c"),
+            os.path.join(HOST_DIR, "stm32u5_flash_sim.c"),
+            os.path.join(FS_DIR, "ospi_nor_mx25lmxxx45g.c"),
+            os.path.join(FS_DIR, "lfs_port_ospi.c"),
+            os.path.join(FS_DIR, "lfs_port_internal_nor.c"),
+            os.path.join(FS_DIR, "lfs_port_prv.c")]
+
+
+def cmd_bench(args):
+    sources = fsbench_sources()
+    if sources is None:
+        raise SystemExit("littlefs is not checked out: git submodule update --init Middleware/ARM/littlefs")
+
+    with tempfile.TemporaryDirectory() as tmp:
+        binary = build(tmp, "fsbench", sources, defines=args.define)
+        subprocess.run([binary] + args.selection, check=True)
+
+
+def cmd_selftest(args):
+    with tempfile.TemporaryDirectory() as tmp:
+        binary = build(tmp, "internal_nor_test",
+                       [os.path.join(HOST_DIR, "stm32u5_flash_sim.c"),
+                        os.path.join(FS_DIR, "lfs_port_prv.c")])
+        subprocess.run([binary], check=True, timeout=120)
+
+        for mem_mapped in ("1", "0"):
+            binary = build(tmp, "mx25lm_test",
+                           [os.path.join(HOST_DIR, "mx25lm_sim.c"),
+                            os.path.join(FS_DIR, "ospi_nor_mx25lmxxx45g.c"),
+                            os.path.join(FS_DIR, "lfs_port_ospi.c"),
+                            os.path.join(FS_DIR, "lfs_port_prv.c")],
+                           defines=["LFS_PORT_OSPI_MEM_MAPPED_READ=" + mem_mapped])
+            subprocess.run([binary], check=True, timeout=120)
+
+        if fsbench_sources() is None:
+            print("littlefs is not checked out, skipping fsbench")
+        else:
+            binary = build(tmp, "fsbench", fsbench_sources())
+            subprocess.run([binary, "kv"], check=True, timeout=300)
+
+    print("selftest passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    selftest = sub.add_parser("selftest", help="build and run the flash host tests")
+    selftest.set_defaults(func=cmd_selftest)
+
+    bench = sub.add_parser("bench", help="benchmark the littlefs configuration of each port")
+    bench.add_argument("--define", action="append", default=[], metavar="NAME=VALUE",
+                       help="define a macro when building the ports and models")
+    bench.add_argument("selection", nargs="*", metavar="PORT_OR_WORKLOAD",
+                       help="ospi, internal, kv, pkcs11 or ota; all are run when none are given")
+    bench.set_defaults(func=cmd_bench)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
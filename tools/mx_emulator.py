@@ -0,0 +1,583 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+"""Emulate the MXCHIP EMW3080 Wi-Fi module on a Linux host.
+
+Implements the module side of the protocol used by Common/net/mxchip:
+the SPI link (SPIHeader_t exchange, FLOW and NOTIFY pin semantics, and the
+multi-frame caps negotiation of MX_SPI_MULTI_FRAME) and the IPC command set
+used by the driver, including bypass mode frames. Ethernet
+frames are exchanged with a TAP device, or with a small built-in peer that
+answers ARP and ICMP echo requests for the gateway address. A TCP/IP peer
+is the host stack behind the TAP device; the built-in peer stays at ARP and
+ICMP because the host tests link no lwIP that could drive a TCP connection.
+
+The emulator serves a Unix socket for the HAL shim in tools/mx_host, which
+builds Common/net/mxchip for Linux. Each message is a type byte, a 16 bit
+little endian length and a payload:
+    'S' host -> emulator    NSS level (1 byte)
+    'X' host -> emulator    bytes clocked out on MOSI, answered by an 'X'
+                            message holding the same number of MISO bytes
+    'G' emulator -> host    pin level change: pin (0 FLOW, 1 NOTIFY), level
+    'C' host -> emulator    test control command:
+                            hold     keep responses to requests back
+                            release  send the responses held back
+                            drop     report the station down, as when the
+                                     access point drops it
+                            move     replace the access point by one with
+                                     the next BSSID
+
+Usage:
+    mx_emulator.py serve [--socket PATH] [--tap IFNAME] [--scan-delay S] [--direct-delay S]
+                         [--no-multi-frame]
+    mx_emulator.py selftest [--pings N]
+
+The selftest builds the dataplane with and without MX_SPI_MULTI_FRAME and
+runs tools/mx_host/mx_host_test.c against the emulator with and without
+multi-frame support. tools/mx_host/mx_reconnect_test.c drives the reconnect
+state machine of mx_reconnect.c with scripted module events: a direct
+connection, a failed one followed by a scan, the cache dropped after two
+failures, and the scan backoff. The selftest then runs
+tools/mx_host/mx_netconn_test.c, which
+links mx_ipc.c, mx_netconn.c and mx_reconnect.c as well and starts net_main:
+concurrent asynchronous requests and their timeouts on the control plane
+router, and the fast connect cache across reconnects.
+"""
+import argparse
+import os
+import select
+import socket
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+from collections import deque
+
+from mx_spi_sim import (MX_MAX_MESSAGE_LEN, MX_SPI_FRAME_PREFIX_LEN, MX_SPI_MAX_FRAMES,
+                        MX_SPI_READ, MX_SPI_WRITE, SPI_HEADER, pack_frames, pack_header,
+                        unpack_frames, unpack_header)
+
+# IPCCommand_t
+IPC_SYS_VERSION = 0x0003
+IPC_SYS_RESET = 0x0004
+IPC_WIFI_GET_MAC = 0x0101
+IPC_WIFI_CONNECT = 0x0103
+IPC_WIFI_DISCONNECT = 0x0104
+IPC_WIFI_GET_LINKINFO = 0x0108
+IPC_WIFI_BYPASS_SET = 0x010C
+IPC_WIFI_BYPASS_GET = 0x010D
+IPC_WIFI_BYPASS_OUT = 0x010E
+IPC_WIFI_EVT_STATUS = 0x8101
+IPC_WIFI_EVT_BYPASS_IN = 0x8102
+
+# MxStatus_t
+MX_STATUS_STA_DOWN = 1
+MX_STATUS_STA_UP = 2
+
+MX_FIRMWARE_REVISION_SIZE = 24
+MX_BYPASS_PAD_LEN = 16
+
+IPC_HEADER = struct.Struct("<IH")                       # IPCHeader_t
+BYPASS_HEADER = struct.Struct("<IHi%dsH" % MX_BYPASS_PAD_LEN)  # BypassInOut_t
+WIFI_CONNECT = struct.Struct("<33s65siBB6sBB64s")        # IPCRequestWifiConnect_t
+LINK_INFO = struct.Struct("<iB33s6sBBi")                 # IPCResponseWifiGetLinkInfo_t
+
+WIFI_SEC_WPA2_AES = 5
+
+PIN_FLOW = 0
+PIN_NOTIFY = 1
+
+ETHTYPE_IP = 0x0800
+ETHTYPE_ARP = 0x0806
+
+
+def checksum(data):
+    if len(data) % 2:
+        data += b"\0"
+    total = sum(struct.unpack("!%dH" % (len(data) // 2), data))
+    while total >> 16:
+        total = (total & 0xFFFF) + (total >> 16)
+    return ~total & 0xFFFF
+
+
+class EchoPeer:
+    """Userspace network peer answering ARP and ICMP echo for one address."""
+
+    def __init__(self, ip="192.168.0.1", mac=b"\x02\x00\x00\x00\x00\x01"):
+        self.ip = socket.inet_aton(ip)
+        self.mac = mac
+        self.rx = deque()
+
+    def send(self, frame):
+        dst, src, ethtype = struct.unpack_from("!6s6sH", frame)
+        body = frame[14:]
+        if ethtype == ETHTYPE_ARP and len(body) >= 28:
+            oper = struct.unpack_from("!H", body, 6)[0]
+            sha, spa, tpa = body[8:14], body[14:18], body[24:28]
+            if oper == 1 and tpa == self.ip:
+                reply = struct.pack("!HHBBH6s4s6s4s", 1, ETHTYPE_IP, 6, 4, 2,
+                                    self.mac, self.ip, sha, spa)
+                self.rx.append(struct.pack("!6s6sH", src, self.mac, ETHTYPE_ARP) + reply)
+        elif ethtype == ETHTYPE_IP and len(body) >= 28 and body[9] == 1:
+            ihl = (body[0] & 0xF) * 4
+            if body[16:20] == self.ip and body[ihl] == 8:
+                icmp = bytearray(body[ihl:])
+                icmp[0] = 0
+                icmp[2:4] = b"\0\0"
+                icmp[2:4] = struct.pack("!H", checksum(bytes(icmp)))
+                ip = bytearray(body[:ihl])
+                ip[12:16], ip[16:20] = body[16:20], body[12:16]
+                ip[10:12] = b"\0\0"
+                ip[10:12] = struct.pack("!H", checksum(bytes(ip)))
+                self.rx.append(struct.pack("!6s6sH", src, self.mac, ETHTYPE_IP) + bytes(ip) + bytes(icmp))
+
+    def fileno(self):
+        return None
+
+    def recv(self):
+        return self.rx.popleft() if self.rx else None
+
+
+class TapPeer:
+    """Exchange ethernet frames with a Linux TAP interface."""
+
+    TUNSETIFF = 0x400454CA
+    IFF_TAP = 0x0002
+    IFF_NO_PI = 0x1000
+
+    def __init__(self, ifname):
+        import fcntl
+        self.fd = os.open("/dev/net/tun", os.O_RDWR | os.O_NONBLOCK)
+        ifr = struct.pack("16sH", ifname.encode(), self.IFF_TAP | self.IFF_NO_PI)
+        fcntl.ioctl(self.fd, self.TUNSETIFF, ifr)
+
+    def send(self, frame):
+        os.write(self.fd, frame)
+
+    def fileno(self):
+        return self.fd
+
+    def recv(self):
+        try:
+            return os.read(self.fd, 2048)
+        except BlockingIOError:
+            return None
+
+
+class MxModule:
+    """IPC command handling and module state."""
+
+    def __init__(self, peer, version="EMU-0.1.0", mac=b"\x02\x80\xe1\x00\x00\x01",
+                 connect_delay=0.05, direct_delay=0.005,
+                 ap_bssid=b"\x02\xa0\x00\x00\x00\x01", ap_channel=6):
+        self.peer = peer
+        self.version = version
+        self.mac = mac
+        # A connect by SSID scans all channels, one with a BSSID and channel only associates
+        self.connect_delay = connect_delay
+        self.direct_delay = direct_delay
+        self.ap_bssid = ap_bssid
+        self.ap_channel = ap_channel
+        self.ssid = b""
+        self.bypass = False
+        self.connected = False
+        self.pending_events = []
+        self.to_host = deque()
+        self.held = None
+        self.stats = {"requests": 0, "bypass_out": 0, "bypass_in": 0,
+                      "scan_connects": 0, "direct_connects": 0}
+
+    def _reply(self, request_id, api_id, data=b""):
+        reply = IPC_HEADER.pack(request_id, api_id) + data
+        if self.held is not None and api_id != IPC_WIFI_BYPASS_OUT:
+            self.held.append(reply)
+        else:
+            self.to_host.append(reply)
+
+    def control(self, command):
+        """Test control commands sent by the host, see the 'C' message."""
+        if command == "hold":
+            self.held = []
+        elif command == "release":
+            self.to_host.extend(self.held or [])
+            self.held = None
+        elif command == "drop":
+            self.pending_events.append((time.monotonic(), MX_STATUS_STA_DOWN))
+        elif command == "move":
+            self.ap_bssid = self.ap_bssid[:5] + bytes([(self.ap_bssid[5] + 1) & 0xFF])
+        else:
+            print("unknown control command %r" % command)
+
+    def _event(self, api_id, data):
+        self.to_host.append(IPC_HEADER.pack(0, api_id) + data)
+
+    def handle(self, message):
+        request_id, api_id = IPC_HEADER.unpack_from(message)
+        data = message[IPC_HEADER.size:]
+        status_ok = struct.pack("<i", 0)
+
+        if api_id == IPC_WIFI_BYPASS_OUT:
+            _, _, _, _, length = BYPASS_HEADER.unpack_from(message)
+            self.stats["bypass_out"] += 1
+            if self.bypass and self.connected:
+                self.peer.send(message[BYPASS_HEADER.size:BYPASS_HEADER.size + length])
+            self._reply(request_id, api_id, status_ok)
+            return
+
+        self.stats["requests"] += 1
+        if api_id == IPC_SYS_VERSION:
+            self._reply(request_id, api_id,
+                        self.version.encode().ljust(MX_FIRMWARE_REVISION_SIZE, b"\0"))
+        elif api_id == IPC_WIFI_GET_MAC:
+            self._reply(request_id, api_id, self.mac)
+        elif api_id == IPC_WIFI_BYPASS_SET:
+            self.bypass = struct.unpack_from("<i", data)[0] != 0
+            self._reply(request_id, api_id, status_ok)
+        elif api_id == IPC_WIFI_BYPASS_GET:
+            self._reply(request_id, api_id, struct.pack("<i", int(self.bypass)))
+        elif api_id == IPC_WIFI_CONNECT:
+            ssid, _, _, use_attr, _, bssid, channel, _, _ = WIFI_CONNECT.unpack_from(data)
+            self._reply(request_id, api_id, status_ok)
+            self.ssid = ssid.rstrip(b"\0")
+            if not use_attr:
+                self.stats["scan_connects"] += 1
+                self.pending_events.append((time.monotonic() + self.connect_delay, MX_STATUS_STA_UP))
+            elif bssid == self.ap_bssid and channel == self.ap_channel:
+                self.stats["direct_connects"] += 1
+                self.pending_events.append((time.monotonic() + self.direct_delay, MX_STATUS_STA_UP))
+            # A direct connect to an access point that is not there never completes
+        elif api_id == IPC_WIFI_GET_LINKINFO:
+            self._reply(request_id, api_id,
+                        LINK_INFO.pack(0 if self.connected else -1, int(self.connected), self.ssid,
+                                       self.ap_bssid, WIFI_SEC_WPA2_AES, self.ap_channel, -50))
+        elif api_id in (IPC_WIFI_DISCONNECT, IPC_SYS_RESET):
+            self._reply(request_id, api_id, status_ok)
+            self.pending_events.append((time.monotonic(), MX_STATUS_STA_DOWN))
+        else:
+            self._reply(request_id, api_id, struct.pack("<i", -1))
+
+    def poll(self):
+        now = time.monotonic()
+        for event in [e for e in self.pending_events if e[0] <= now]:
+            self.pending_events.remove(event)
+            self.connected = event[1] == MX_STATUS_STA_UP
+            self._event(IPC_WIFI_EVT_STATUS, struct.pack("<I", event[1]))
+        while self.bypass and self.connected:
+            frame = self.peer.recv()
+            if frame is None:
+                break
+            self.stats["bypass_in"] += 1
+            header = BYPASS_HEADER.pack(0, IPC_WIFI_EVT_BYPASS_IN, 0,
+                                        b"\0" * MX_BYPASS_PAD_LEN, len(frame))
+            self.to_host.append(header + frame)
+
+
+class SpiSlave:
+    """Module side of one SPI transaction, driven by NSS edges and transfers."""
+
+    def __init__(self, module, set_pin, multi_frame=True):
+        self.module = module
+        self.set_pin = set_pin
+        self.multi_frame = multi_frame
+        self.nss_low = False
+        self.state = "idle"
+        self.mosi = bytearray()
+        self.miso = b""
+        self.tx_len = 0
+        self.tx_frames = 0
+        self.rx_frames = 0
+        self.payload_len = 0
+        self.host_multi_frame = False
+        self.pins = {PIN_FLOW: 0, PIN_NOTIFY: 0}
+        self.transactions = 0
+        self.packed_transactions = 0
+
+    def _pin(self, pin, level):
+        if self.pins[pin] != level:
+            self.pins[pin] = level
+            self.set_pin(pin, level)
+
+    def update_notify(self):
+        self.module.poll()
+        self._pin(PIN_NOTIFY, 1 if self.module.to_host else 0)
+
+    def nss(self, level):
+        if level == 0 and not self.nss_low:
+            self.nss_low = True
+            self.state = "header"
+            self.mosi = bytearray()
+            # NOTIFY drops for the transaction, so each message still pending raises a new edge
+            self._pin(PIN_NOTIFY, 0)
+            self._pin(PIN_FLOW, 1)
+        elif level == 1 and self.nss_low:
+            self.nss_low = False
+            self._finish()
+            self._pin(PIN_FLOW, 0)
+            self.update_notify()
+
+    def _take_messages(self):
+        """One message, or as many as fit packed once the host has advertised its caps."""
+        to_host = self.module.to_host
+        if not to_host:
+            return b"", 0
+        if not (self.multi_frame and self.host_multi_frame) or len(to_host) == 1:
+            return to_host[0], 1
+        batch = []
+        packed_len = 0
+        for message in to_host:
+            need = MX_SPI_FRAME_PREFIX_LEN + len(message)
+            if len(batch) == MX_SPI_MAX_FRAMES or (batch and packed_len + need >= MX_MAX_MESSAGE_LEN):
+                break
+            packed_len += need
+            batch.append(message)
+        if len(batch) == 1:
+            return batch[0], 1
+        return pack_frames(batch), len(batch)
+
+    def transfer(self, mosi):
+        if not self.nss_low:
+            return b"\0" * len(mosi)
+        if self.state == "header":
+            if len(mosi) != SPI_HEADER.size:
+                self.state = "error"
+                return b"\0" * len(mosi)
+            msg_type, self.tx_len, self.tx_frames, host_caps = unpack_header(mosi)
+            if msg_type != MX_SPI_WRITE:
+                self.tx_len = 0
+            # Only a host that saw our caps packs frames, and we only pack after seeing its caps
+            if not self.multi_frame:
+                self.tx_frames = 0
+            self.host_multi_frame = host_caps
+            self.module.poll()
+            self.miso, self.rx_frames = self._take_messages()
+            self.payload_len = max(self.tx_len, len(self.miso))
+            self.state = "payload"
+            # Drop FLOW while preparing the payload, then raise it again
+            self._pin(PIN_FLOW, 0)
+            self._pin(PIN_FLOW, 1)
+            return pack_header(MX_SPI_READ, len(self.miso),
+                               self.rx_frames if self.rx_frames > 1 else 0, caps=self.multi_frame)
+        if self.state == "payload":
+            offset = len(self.mosi)
+            self.mosi += mosi
+            return self.miso[offset:offset + len(mosi)].ljust(len(mosi), b"\0")
+        return b"\0" * len(mosi)
+
+    def _finish(self):
+        if self.state == "payload" and len(self.mosi) >= self.payload_len:
+            self.transactions += 1
+            if self.rx_frames > 1 or self.tx_frames > 1:
+                self.packed_transactions += 1
+            for _ in range(self.rx_frames):
+                self.module.to_host.popleft()
+            if self.tx_len:
+                payload = bytes(self.mosi[:self.tx_len])
+                try:
+                    messages = unpack_frames(payload, self.tx_frames) if self.tx_frames > 1 else [payload]
+                except ValueError as error:
+                    print("dropping packed payload: %s" % error)
+                    messages = []
+                for message in messages:
+                    self.module.handle(message)
+        self.state = "idle"
+
+
+def recv_exact(conn, length):
+    data = b""
+    while len(data) < length:
+        chunk = conn.recv(length - len(data))
+        if not chunk:
+            raise ConnectionError("shim disconnected")
+        data += chunk
+    return data
+
+
+def serve_connection(conn, peer, slave):
+    """Run SPI transactions for one connected shim until it disconnects."""
+    try:
+        while True:
+            fds = [conn] + ([peer.fileno()] if peer.fileno() is not None else [])
+            readable, _, _ = select.select(fds, [], [], 0.002)
+            if conn in readable:
+                msg_type, length = struct.unpack("<cH", recv_exact(conn, 3))
+                payload = recv_exact(conn, length)
+                if msg_type == b"S":
+                    slave.nss(payload[0])
+                elif msg_type == b"X":
+                    miso = slave.transfer(payload)
+                    conn.sendall(b"X" + struct.pack("<H", len(miso)) + miso)
+                elif msg_type == b"C":
+                    slave.module.control(payload.decode())
+            if not slave.nss_low:
+                slave.update_notify()
+    except (ConnectionError, BrokenPipeError):
+        conn.close()
+
+
+def listen(path):
+    if os.path.exists(path):
+        os.unlink(path)
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    server.listen(1)
+    return server
+
+
+def cmd_serve(args):
+    peer = TapPeer(args.tap) if args.tap else EchoPeer(args.gateway)
+    module = MxModule(peer, connect_delay=args.scan_delay, direct_delay=args.direct_delay)
+    server = listen(args.socket)
+    print("waiting for a driver on %s" % args.socket)
+
+    while True:
+        conn, _ = server.accept()
+
+        def set_pin(pin, level):
+            conn.sendall(b"G" + struct.pack("<HBB", 2, pin, level))
+
+        slave = SpiSlave(module, set_pin, multi_frame=not args.no_multi_frame)
+        serve_connection(conn, peer, slave)
+        print("driver disconnected after %d transactions (%d packed), %s" %
+              (slave.transactions, slave.packed_transactions, module.stats))
+
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOST_DIR = os.path.join(ROOT, "tools", "mx_host")
+MXCHIP_DIR = os.path.join(ROOT, "Common", "net", "mxchip")
+
+NETCONN_SOURCES = ["mx_dataplane.c", "mx_ipc.c", "mx_netconn.c", "mx_reconnect.c"]
+NETCONN_INCLUDE_DIRS = [os.path.join(HOST_DIR, "netconn_decl"), os.path.join(ROOT, "Common", "include")]
+NETCONN_SCAN_DELAY_MS = 1000
+
+
+def build_host_test(out_dir, name, multi_frame, sources, include_dirs=()):
+    """Build tools/mx_host/NAME.c with the tools/mx_host shim and the given Common/net/mxchip sources."""
+    binary = os.path.join(out_dir, "%s_%d" % (name, multi_frame))
+    subprocess.run([os.environ.get("CC", "cc"), "-O1", "-g", "-pthread",
+                    "-Wno-incompatible-pointer-types",
+                    "-I", HOST_DIR] +
+                   [arg for include_dir in include_dirs for arg in ("-I", include_dir)] +
+                   ["-I", MXCHIP_DIR,
+                    "-DMX_SPI_MULTI_FRAME=%d" % multi_frame,
+                    os.path.join(HOST_DIR, name + ".c"),
+                    os.path.join(HOST_DIR, "mx_host_shim.c")] +
+                   [os.path.join(MXCHIP_DIR, source) for source in sources] +
+                   ["-o", binary], check=True)
+    return binary
+
+
+def run_host_test(out_dir, module, multi_frame, argv):
+    """Serve MODULE to the host test started with ARGV and the socket path, return its SpiSlave."""
+    path = os.path.join(out_dir, "mx_emulator.sock")
+    server = listen(path)
+    result = {}
+
+    def run_module():
+        conn, _ = server.accept()
+
+        def set_pin(pin, level):
+            conn.sendall(b"G" + struct.pack("<HBB", 2, pin, level))
+
+        result["slave"] = SpiSlave(module, set_pin, multi_frame=multi_frame)
+        serve_connection(conn, module.peer, result["slave"])
+
+    thread = threading.Thread(target=run_module, daemon=True)
+    thread.start()
+    subprocess.run([argv[0], path] + argv[1:], check=True, timeout=120)
+    thread.join(timeout=5)
+    server.close()
+
+    return result["slave"]
+
+
+def cmd_selftest(args):
+    with tempfile.TemporaryDirectory() as tmp:
+        binaries = {multi: build_host_test(tmp, "mx_host_test", multi, ["mx_dataplane.c"])
+                    for multi in (0, 1)}
+
+        # Caps negotiation must only enable packing when both sides support it
+        for driver_multi, module_multi in ((0, 0), (0, 1), (1, 0), (1, 1)):
+            module = MxModule(EchoPeer("192.168.0.1"), connect_delay=0.01)
+            expect = int(driver_multi and module_multi)
+            print("driver MX_SPI_MULTI_FRAME=%d, module multi-frame %s:" %
+                  (driver_multi, "on" if module_multi else "off"))
+            slave = run_host_test(tmp, module, bool(module_multi),
+                                  [binaries[driver_multi], str(expect), str(args.pings)])
+
+            assert (slave.packed_transactions > 0) == bool(expect), \
+                "%d packed transactions" % slave.packed_transactions
+            print("module: %d transactions, %d packed, %s" %
+                  (slave.transactions, slave.packed_transactions, module.stats))
+
+        # The reconnect state machine alone, driven by scripted module events
+        reconnect = build_host_test(tmp, "mx_reconnect_test", 0, ["mx_reconnect.c"])
+        subprocess.run([reconnect], check=True, timeout=60)
+
+        # net_main with the control plane router, against a scan that takes NETCONN_SCAN_DELAY_MS
+        netconn = build_host_test(tmp, "mx_netconn_test", 1, NETCONN_SOURCES, NETCONN_INCLUDE_DIRS)
+        module = MxModule(EchoPeer("192.168.0.1"), connect_delay=NETCONN_SCAN_DELAY_MS / 1000.0)
+        print("net_main, control plane router and fast connect:")
+        slave = run_host_test(tmp, module, True, [netconn, str(NETCONN_SCAN_DELAY_MS)])
+
+        # A scan to start with and after the access point was replaced, one direct reconnect
+        assert module.stats["scan_connects"] == 2, module.stats
+        assert module.stats["direct_connects"] == 1, module.stats
+        print("module: %d transactions, %d packed, %s" %
+              (slave.transactions, slave.packed_transactions, module.stats))
+
+    print("selftest passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    serve = sub.add_parser("serve", help="serve a HAL shim over a Unix socket")
+    serve.add_argument("--socket", default="/tmp/mx_emulator.sock")
+    serve.add_argument("--tap", help="exchange frames with this TAP interface")
+    serve.add_argument("--gateway", default="192.168.0.1",
+                       help="address answered by the built-in peer")
+    serve.add_argument("--scan-delay", type=float, default=2.0,
+                       help="seconds taken by a connect by SSID")
+    serve.add_argument("--direct-delay", type=float, default=0.2,
+                       help="seconds taken by a connect to a known BSSID and channel")
+    serve.add_argument("--no-multi-frame", action="store_true",
+                       help="behave like module firmware without multi-frame transactions")
+    serve.set_defaults(func=cmd_serve)
+
+    selftest = sub.add_parser("selftest",
+                              help="build the C dataplane with tools/mx_host and run it against the emulator")
+    selftest.add_argument("--pings", type=int, default=64)
+    selftest.set_defaults(func=cmd_selftest)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
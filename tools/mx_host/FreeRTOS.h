@@ -0,0 +1,208 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Host shim for building Common/net/mxchip on Linux against tools/mx_emulator.py.
+ * Provides the subset of the FreeRTOS kernel API used by the driver on top of pthreads.
+ * Every kernel object shares one lock and condition variable, which is plenty for a test.
+ */
+#ifndef MX_HOST_FREERTOS_H
+#define MX_HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef long             BaseType_t;
+typedef unsigned long    UBaseType_t;
+typedef uint32_t         TickType_t;
+
+#define pdTRUE                     ( ( BaseType_t ) 1 )
+#define pdFALSE                    ( ( BaseType_t ) 0 )
+#define pdPASS                     pdTRUE
+#define pdFAIL                     pdFALSE
+#define portMAX_DELAY              ( ( TickType_t ) 0xFFFFFFFFUL )
+
+#define configTICK_RATE_HZ         ( 10000UL )
+#define pdMS_TO_TICKS( xTimeInMs )    ( ( TickType_t ) ( ( ( uint64_t ) ( xTimeInMs ) * configTICK_RATE_HZ ) / 1000ULL ) )
+
+#define configASSERT( x )                                                          \
+    do {                                                                           \
+        if( !( x ) )                                                               \
+        {                                                                          \
+            fprintf( stderr, "Assertion failed: %s (%s:%d)\n", #x, __FILE__, __LINE__ ); \
+            abort();                                                               \
+        }                                                                          \
+    } while( 0 )
+
+#define portYIELD_FROM_ISR( x )    ( ( void ) ( x ) )
+
+/* Every shim kernel object call already runs under the shim lock */
+#define taskENTER_CRITICAL()
+#define taskEXIT_CRITICAL()
+
+/* Tasks and direct to task notifications */
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES    4
+
+typedef struct HostTask * TaskHandle_t;
+typedef void ( * TaskFunction_t )( void * );
+
+typedef enum
+{
+    eNoAction = 0,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite
+} eNotifyAction;
+
+typedef struct
+{
+    TickType_t xTimeOnEntering;
+} TimeOut_t;
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * pcName,
+                        uint32_t ulStackDepth,
+                        void * pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * pxCreatedTask );
+void vTaskDelay( TickType_t xTicksToDelay );
+TickType_t xTaskGetTickCount( void );
+TaskHandle_t xTaskGetCurrentTaskHandle( void );
+void vTaskSetTimeOutState( TimeOut_t * pxTimeOut );
+BaseType_t xTaskCheckForTimeOut( TimeOut_t * pxTimeOut,
+                                 TickType_t * pxTicksToWait );
+
+BaseType_t xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                               UBaseType_t uxIndexToNotify,
+                               uint32_t ulValue,
+                               eNotifyAction eAction );
+BaseType_t xTaskNotifyWaitIndexed( UBaseType_t uxIndexToWaitOn,
+                                   uint32_t ulBitsToClearOnEntry,
+                                   uint32_t ulBitsToClearOnExit,
+                                   uint32_t * pulNotificationValue,
+                                   TickType_t xTicksToWait );
+uint32_t ulTaskNotifyTakeIndexed( UBaseType_t uxIndexToWaitOn,
+                                  BaseType_t xClearCountOnExit,
+                                  TickType_t xTicksToWait );
+BaseType_t xTaskNotifyStateClearIndexed( TaskHandle_t xTask,
+                                         UBaseType_t uxIndexToClear );
+
+#define xTaskNotifyIndexed( xTask, uxIndex, ulValue, eAction ) \
+    xTaskGenericNotify( ( xTask ), ( uxIndex ), ( ulValue ), ( eAction ) )
+#define xTaskNotifyIndexedFromISR( xTask, uxIndex, ulValue, eAction, pxWoken ) \
+    xTaskGenericNotify( ( xTask ), ( uxIndex ), ( ulValue ), ( eAction ) )
+#define xTaskNotifyGiveIndexed( xTask, uxIndex ) \
+    xTaskGenericNotify( ( xTask ), ( uxIndex ), 0, eIncrement )
+#define vTaskNotifyGiveIndexedFromISR( xTask, uxIndex, pxWoken ) \
+    ( ( void ) xTaskGenericNotify( ( xTask ), ( uxIndex ), 0, eIncrement ) )
+#define xTaskNotify( xTask, ulValue, eAction ) \
+    xTaskGenericNotify( ( xTask ), 0, ( ulValue ), ( eAction ) )
+#define xTaskNotifyWait( ulBitsToClearOnEntry, ulBitsToClearOnExit, pulNotificationValue, xTicksToWait ) \
+    xTaskNotifyWaitIndexed( 0, ( ulBitsToClearOnEntry ), ( ulBitsToClearOnExit ), ( pulNotificationValue ), ( xTicksToWait ) )
+
+/* Queues and message buffers */
+typedef struct HostQueue * QueueHandle_t;
+typedef struct HostQueue * MessageBufferHandle_t;
+
+QueueHandle_t xQueueCreate( UBaseType_t uxQueueLength,
+                            UBaseType_t uxItemSize );
+BaseType_t xQueueSend( QueueHandle_t xQueue,
+                       const void * pvItemToQueue,
+                       TickType_t xTicksToWait );
+BaseType_t xQueueSendToFront( QueueHandle_t xQueue,
+                              const void * pvItemToQueue,
+                              TickType_t xTicksToWait );
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * pvBuffer,
+                          TickType_t xTicksToWait );
+BaseType_t xQueuePeek( QueueHandle_t xQueue,
+                       void * pvBuffer,
+                       TickType_t xTicksToWait );
+UBaseType_t uxQueueMessagesWaiting( QueueHandle_t xQueue );
+UBaseType_t uxQueueSpacesAvailable( QueueHandle_t xQueue );
+
+MessageBufferHandle_t xMessageBufferCreate( size_t xBufferSizeBytes );
+size_t xMessageBufferSend( MessageBufferHandle_t xMessageBuffer,
+                           const void * pvTxData,
+                           size_t xDataLengthBytes,
+                           TickType_t xTicksToWait );
+size_t xMessageBufferReceive( MessageBufferHandle_t xMessageBuffer,
+                              void * pvRxData,
+                              size_t xBufferLengthBytes,
+                              TickType_t xTicksToWait );
+
+/* Mutexes and counting semaphores. Static allocation falls back to the heap, the buffer only has to exist. */
+#define configSUPPORT_DYNAMIC_ALLOCATION    1
+
+typedef struct HostQueue * SemaphoreHandle_t;
+
+typedef struct
+{
+    void * pvDummy;
+} StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex( void );
+SemaphoreHandle_t xSemaphoreCreateMutexStatic( StaticSemaphore_t * pxMutexBuffer );
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount );
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xTicksToWait );
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore );
+TaskHandle_t xQueueGetMutexHolder( QueueHandle_t xSemaphore );
+
+/* Event groups */
+typedef struct HostEventGroup * EventGroupHandle_t;
+typedef TickType_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate( void );
+EventBits_t xEventGroupSetBits( EventGroupHandle_t xEventGroup,
+                                const EventBits_t uxBitsToSet );
+EventBits_t xEventGroupClearBits( EventGroupHandle_t xEventGroup,
+                                  const EventBits_t uxBitsToClear );
+EventBits_t xEventGroupGetBits( EventGroupHandle_t xEventGroup );
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t xEventGroup,
+                                 const EventBits_t uxBitsToWaitFor,
+                                 const BaseType_t xClearOnExit,
+                                 const BaseType_t xWaitForAllBits,
+                                 TickType_t xTicksToWait );
+
+/* Atomics, returning the value before the operation like FreeRTOS atomic.h */
+static inline uint32_t Atomic_Increment_u32( uint32_t volatile * pulAddend )
+{
+    return __atomic_fetch_add( pulAddend, 1U, __ATOMIC_SEQ_CST );
+}
+
+static inline uint32_t Atomic_Decrement_u32( uint32_t volatile * pulAddend )
+{
+    return __atomic_fetch_sub( pulAddend, 1U, __ATOMIC_SEQ_CST );
+}
+
+void * pvPortMalloc( size_t xSize );
+void vPortFree( void * pv );
+
+#endif /* MX_HOST_FREERTOS_H */
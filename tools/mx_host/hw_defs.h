@@ -0,0 +1,15 @@
+/* Host shim for hw_defs.h */
+#ifndef MX_HOST_HW_DEFS_H
+#define MX_HOST_HW_DEFS_H
+
+#include "stm32u5xx_hal.h"
+
+typedef void ( * GPIOInterruptCallback_t ) ( void * pvContext );
+
+extern SPI_HandleTypeDef * pxHndlSpi2;
+
+void GPIO_EXTI_Register_Callback( uint16_t usGpioPinMask,
+                                  GPIOInterruptCallback_t pvCallback,
+                                  void * pvContext );
+
+#endif /* MX_HOST_HW_DEFS_H */
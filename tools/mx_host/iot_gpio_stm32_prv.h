@@ -0,0 +1,13 @@
+/* Host shim for iot_gpio_stm32_prv.h */
+#ifndef MX_HOST_IOT_GPIO_STM32_PRV_H
+#define MX_HOST_IOT_GPIO_STM32_PRV_H
+
+#include "stm32u5xx_hal.h"
+
+typedef struct
+{
+    GPIO_TypeDef * xPort;
+    uint16_t xPinMask;
+} IotMappedPin_t;
+
+#endif /* MX_HOST_IOT_GPIO_STM32_PRV_H */
@@ -0,0 +1,20 @@
+/* Host shim for logging.h: errors and warnings go to stderr, the rest is dropped */
+#ifndef MX_HOST_LOGGING_H
+#define MX_HOST_LOGGING_H
+
+#include <stdio.h>
+
+#define MX_HOST_LOG( level, ... )                      \
+    do {                                               \
+        fprintf( stderr, "[%s] %s:%d ", level, __FILE__, __LINE__ ); \
+        fprintf( stderr, __VA_ARGS__ );                \
+        fprintf( stderr, "\n" );                       \
+    } while( 0 )
+
+#define LogError( ... )    MX_HOST_LOG( "ERROR", __VA_ARGS__ )
+#define LogWarn( ... )     MX_HOST_LOG( "WARN", __VA_ARGS__ )
+#define LogInfo( ... )     do {} while( 0 )
+#define LogDebug( ... )    do {} while( 0 )
+#define LogSys( ... )      do {} while( 0 )
+
+#endif /* MX_HOST_LOGGING_H */
@@ -0,0 +1,11 @@
+/* Host shim for logging_levels.h */
+#ifndef MX_HOST_LOGGING_LEVELS_H
+#define MX_HOST_LOGGING_LEVELS_H
+
+#define LOG_NONE     0
+#define LOG_ERROR    1
+#define LOG_WARN     2
+#define LOG_INFO     3
+#define LOG_DEBUG    4
+
+#endif /* MX_HOST_LOGGING_LEVELS_H */
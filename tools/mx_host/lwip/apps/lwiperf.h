@@ -0,0 +1,20 @@
+/* Host shim for lwip/apps/lwiperf.h */
+#ifndef MX_HOST_LWIP_APPS_LWIPERF_H
+#define MX_HOST_LWIP_APPS_LWIPERF_H
+
+#include <stdint.h>
+
+typedef void ( * lwiperf_report_fn )( void * arg,
+                                      int report_type,
+                                      const void * local_addr,
+                                      uint16_t local_port,
+                                      const void * remote_addr,
+                                      uint16_t remote_port,
+                                      uint32_t bytes_transferred,
+                                      uint32_t ms_duration,
+                                      uint32_t bandwidth_kbitpsec );
+
+void * lwiperf_start_tcp_server_default( lwiperf_report_fn report_fn,
+                                         void * report_arg );
+
+#endif /* MX_HOST_LWIP_APPS_LWIPERF_H */
@@ -0,0 +1,10 @@
+/* Host shim for lwip/dhcp.h */
+#ifndef MX_HOST_LWIP_DHCP_H
+#define MX_HOST_LWIP_DHCP_H
+
+#include "lwip/netifapi.h"
+#include "lwip/prot/dhcp.h"
+
+uint8_t dhcp_supplied_address( const struct netif * netif );
+
+#endif /* MX_HOST_LWIP_DHCP_H */
@@ -0,0 +1,18 @@
+/* Host shim for lwip/etharp.h */
+#ifndef MX_HOST_LWIP_ETHARP_H
+#define MX_HOST_LWIP_ETHARP_H
+
+#include "netif/ethernet.h"
+#include "lwip/netifapi.h"
+
+#include <sys/types.h>
+
+err_t etharp_query( struct netif * netif,
+                    const ip4_addr_t * ipaddr,
+                    struct pbuf * q );
+ssize_t etharp_find_addr( struct netif * netif,
+                          const ip4_addr_t * ipaddr,
+                          struct eth_addr ** eth_ret,
+                          const ip4_addr_t ** ip_ret );
+
+#endif /* MX_HOST_LWIP_ETHARP_H */
@@ -0,0 +1,54 @@
+/* Host shim for the netif declarations referenced by mx_lwip.h. None of them are called by the dataplane. */
+#ifndef MX_HOST_LWIP_NETIFAPI_H
+#define MX_HOST_LWIP_NETIFAPI_H
+
+#include "lwip/opt.h"
+
+struct ip4_addr
+{
+    uint32_t addr;
+};
+
+typedef struct ip4_addr ip_addr_t;
+typedef struct ip4_addr ip4_addr_t;
+
+#define NETIF_FLAG_UP         0x01U
+#define NETIF_FLAG_LINK_UP    0x04U
+
+struct dhcp;
+struct netif;
+struct pbuf;
+
+typedef err_t ( * netif_init_fn )( struct netif * netif );
+typedef err_t ( * netif_input_fn )( struct pbuf * p,
+                                    struct netif * inp );
+
+struct netif
+{
+    ip_addr_t ip_addr;
+    ip_addr_t netmask;
+    ip_addr_t gw;
+    uint8_t flags;
+    void * state;
+};
+
+struct dhcp * netif_dhcp_data( struct netif * netif );
+err_t netifapi_netif_add( struct netif * netif,
+                          const ip4_addr_t * ipaddr,
+                          const ip4_addr_t * netmask,
+                          const ip4_addr_t * gw,
+                          void * state,
+                          netif_init_fn init,
+                          netif_input_fn input );
+err_t netifapi_netif_set_default( struct netif * netif );
+err_t netifapi_netif_set_addr( struct netif * netif,
+                               const struct ip4_addr * ipaddr,
+                               const struct ip4_addr * netmask,
+                               const struct ip4_addr * gw );
+err_t netifapi_dhcp_start( struct netif * netif );
+err_t netifapi_netif_set_up( struct netif * netif );
+err_t netifapi_netif_set_down( struct netif * netif );
+err_t netifapi_netif_set_link_up( struct netif * netif );
+err_t netifapi_netif_set_link_down( struct netif * netif );
+
+#endif /* MX_HOST_LWIP_NETIFAPI_H */
@@ -0,0 +1,24 @@
+/* Host shim for the lwIP options and types used by the MXCHIP driver, see Common/config/lwipopts.h */
+#ifndef MX_HOST_LWIP_OPT_H
+#define MX_HOST_LWIP_OPT_H
+
+#include <stdint.h>
+
+#ifndef PBUF_POOL_SIZE
+    #define PBUF_POOL_SIZE       40
+#endif
+
+#ifndef PBUF_POOL_BUFSIZE
+    #define PBUF_POOL_BUFSIZE    ( 1536 + 128 )
+#endif
+
+#define PBUF_LINK_HLEN           14
+
+typedef int8_t err_t;
+
+#define ERR_OK         0
+#define ERR_MEM        -1
+#define ERR_TIMEOUT    -3
+#define ERR_VAL        -6
+
+#endif /* MX_HOST_LWIP_OPT_H */
@@ -0,0 +1,54 @@
+/*
+ * Host shim for lwip/pbuf.h. PBUF_POOL buffers come from a pool of PBUF_POOL_SIZE buffers of
+ * PBUF_POOL_BUFSIZE bytes and are chained like lwIP does for longer allocations.
+ */
+#ifndef MX_HOST_LWIP_PBUF_H
+#define MX_HOST_LWIP_PBUF_H
+
+#include "lwip/opt.h"
+
+typedef enum
+{
+    PBUF_RAW = 0
+} pbuf_layer;
+
+typedef enum
+{
+    PBUF_RAM = 0,
+    PBUF_POOL
+} pbuf_type;
+
+struct pbuf
+{
+    struct pbuf * next;
+    void * payload;
+    uint16_t tot_len;
+    uint16_t len;
+    uint8_t type;
+    uint8_t ref;
+    uint8_t * pucBase; /* Start of the buffer, payload may be moved past a removed header */
+};
+
+struct pbuf * pbuf_alloc( pbuf_layer layer,
+                          uint16_t length,
+                          pbuf_type type );
+uint8_t pbuf_free( struct pbuf * p );
+void pbuf_ref( struct pbuf * p );
+void pbuf_realloc( struct pbuf * p,
+                   uint16_t size );
+uint8_t pbuf_remove_header( struct pbuf * p,
+                            size_t header_size );
+void pbuf_cat( struct pbuf * head,
+               struct pbuf * tail );
+uint16_t pbuf_copy_partial( const struct pbuf * p,
+                            void * dataptr,
+                            uint16_t len,
+                            uint16_t offset );
+err_t pbuf_take( struct pbuf * buf,
+                 const void * dataptr,
+                 uint16_t len );
+
+/* Pool buffers currently allocated, for leak checks */
+uint32_t ulHostPbufPoolUsed( void );
+
+#endif /* MX_HOST_LWIP_PBUF_H */
@@ -0,0 +1,14 @@
+/* Host shim for lwip/prot/dhcp.h */
+#ifndef MX_HOST_LWIP_PROT_DHCP_H
+#define MX_HOST_LWIP_PROT_DHCP_H
+
+#include <stdint.h>
+
+#define DHCP_STATE_OFF    0
+
+struct dhcp
+{
+    uint8_t state;
+};
+
+#endif /* MX_HOST_LWIP_PROT_DHCP_H */
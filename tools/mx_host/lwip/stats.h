@@ -0,0 +1,22 @@
+/* Host shim for lwip/stats.h */
+#ifndef MX_HOST_LWIP_STATS_H
+#define MX_HOST_LWIP_STATS_H
+
+#include <stdint.h>
+
+struct stats_link
+{
+    uint32_t drop;
+    uint32_t memerr;
+};
+
+struct stats_
+{
+    struct stats_link link;
+};
+
+extern struct stats_ lwip_stats;
+
+#define LINK_STATS_INC( x )    ( lwip_stats.x++ )
+
+#endif /* MX_HOST_LWIP_STATS_H */
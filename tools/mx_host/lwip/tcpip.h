@@ -0,0 +1,17 @@
+/* Host shim for lwip/tcpip.h. There is no tcpip thread, so the core lock is a no-op. */
+#ifndef MX_HOST_LWIP_TCPIP_H
+#define MX_HOST_LWIP_TCPIP_H
+
+#include "lwip/netifapi.h"
+
+typedef void ( * tcpip_init_done_fn )( void * arg );
+
+void tcpip_init( tcpip_init_done_fn initfunc,
+                 void * arg );
+err_t tcpip_input( struct pbuf * p,
+                   struct netif * inp );
+
+#define LOCK_TCPIP_CORE()
+#define UNLOCK_TCPIP_CORE()
+
+#endif /* MX_HOST_LWIP_TCPIP_H */
@@ -0,0 +1,1267 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Host implementation of the kernel, HAL and pbuf shims. SPI transfers and the NSS pin are
+ * forwarded to tools/mx_emulator.py over its Unix socket, and FLOW / NOTIFY pin changes coming
+ * back from it call the registered EXTI callbacks from a reader thread, standing in for the ISR.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "hw_defs.h"
+#include "stm32u5xx_hal.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "mx_host_shim.h"
+
+struct stats_ lwip_stats;
+
+static pthread_mutex_t xKernelLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xKernelCond;
+static pthread_once_t xKernelOnce = PTHREAD_ONCE_INIT;
+
+/* Kernel */
+
+struct HostTask
+{
+    pthread_t xThread;
+    TaskFunction_t pxTaskCode;
+    void * pvParameters;
+    uint32_t ulNotifiedValue[ configTASK_NOTIFICATION_ARRAY_ENTRIES ];
+    BaseType_t xNotifyPending[ configTASK_NOTIFICATION_ARRAY_ENTRIES ];
+};
+
+static __thread struct HostTask * pxCurrentTask = NULL;
+
+static void prvKernelInit( void )
+{
+    pthread_condattr_t xAttr;
+
+    ( void ) pthread_condattr_init( &xAttr );
+    ( void ) pthread_condattr_setclock( &xAttr, CLOCK_MONOTONIC );
+    ( void ) pthread_cond_init( &xKernelCond, &xAttr );
+}
+
+static void prvLock( void )
+{
+    ( void ) pthread_once( &xKernelOnce, prvKernelInit );
+    ( void ) pthread_mutex_lock( &xKernelLock );
+}
+
+static void prvUnlock( void )
+{
+    ( void ) pthread_cond_broadcast( &xKernelCond );
+    ( void ) pthread_mutex_unlock( &xKernelLock );
+}
+
+static struct timespec prvDeadline( TickType_t xTicks )
+{
+    struct timespec xNow;
+    uint64_t ullNs;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+    ullNs = ( uint64_t ) xNow.tv_nsec + ( ( uint64_t ) xTicks * 1000000000ULL ) / configTICK_RATE_HZ;
+    xNow.tv_sec += ( time_t ) ( ullNs / 1000000000ULL );
+    xNow.tv_nsec = ( long ) ( ullNs % 1000000000ULL );
+
+    return xNow;
+}
+
+/* Wait on the kernel condition with the lock held. Returns pdFALSE once the deadline has passed. */
+static BaseType_t prvWait( TickType_t xTicksToWait,
+                           const struct timespec * pxDeadline )
+{
+    BaseType_t xResult = pdTRUE;
+
+    if( xTicksToWait == 0 )
+    {
+        xResult = pdFALSE;
+    }
+    else if( xTicksToWait == portMAX_DELAY )
+    {
+        ( void ) pthread_cond_wait( &xKernelCond, &xKernelLock );
+    }
+    else if( pthread_cond_timedwait( &xKernelCond, &xKernelLock, pxDeadline ) == ETIMEDOUT )
+    {
+        xResult = pdFALSE;
+    }
+
+    return xResult;
+}
+
+static struct HostTask * prvCurrentTask( void )
+{
+    if( pxCurrentTask == NULL )
+    {
+        pxCurrentTask = calloc( 1, sizeof( struct HostTask ) );
+        configASSERT( pxCurrentTask != NULL );
+        pxCurrentTask->xThread = pthread_self();
+    }
+
+    return pxCurrentTask;
+}
+
+static void * prvTaskEntry( void * pvTask )
+{
+    pxCurrentTask = ( struct HostTask * ) pvTask;
+    pxCurrentTask->pxTaskCode( pxCurrentTask->pvParameters );
+
+    return NULL;
+}
+
+BaseType_t xTaskCreate( TaskFunction_t pxTaskCode,
+                        const char * pcName,
+                        uint32_t ulStackDepth,
+                        void * pvParameters,
+                        UBaseType_t uxPriority,
+                        TaskHandle_t * pxCreatedTask )
+{
+    struct HostTask * pxTask = calloc( 1, sizeof( struct HostTask ) );
+    BaseType_t xResult = pdFAIL;
+
+    ( void ) pcName;
+    ( void ) ulStackDepth;
+    ( void ) uxPriority;
+
+    if( pxTask != NULL )
+    {
+        pxTask->pxTaskCode = pxTaskCode;
+        pxTask->pvParameters = pvParameters;
+
+        /* The handle must be visible before the task can receive notifications */
+        if( pxCreatedTask != NULL )
+        {
+            *pxCreatedTask = pxTask;
+        }
+
+        if( pthread_create( &( pxTask->xThread ), NULL, prvTaskEntry, pxTask ) == 0 )
+        {
+            ( void ) pthread_detach( pxTask->xThread );
+            xResult = pdPASS;
+        }
+    }
+
+    return xResult;
+}
+
+void vTaskDelay( TickType_t xTicksToDelay )
+{
+    uint64_t ullUs = ( ( uint64_t ) xTicksToDelay * 1000000ULL ) / configTICK_RATE_HZ;
+
+    ( void ) usleep( ( useconds_t ) ullUs );
+}
+
+TickType_t xTaskGetTickCount( void )
+{
+    struct timespec xNow;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &xNow );
+
+    return ( TickType_t ) ( ( ( uint64_t ) xNow.tv_sec * configTICK_RATE_HZ ) +
+                            ( ( uint64_t ) xNow.tv_nsec * configTICK_RATE_HZ ) / 1000000000ULL );
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle( void )
+{
+    return prvCurrentTask();
+}
+
+void vTaskSetTimeOutState( TimeOut_t * pxTimeOut )
+{
+    pxTimeOut->xTimeOnEntering = xTaskGetTickCount();
+}
+
+BaseType_t xTaskCheckForTimeOut( TimeOut_t * pxTimeOut,
+                                 TickType_t * pxTicksToWait )
+{
+    TickType_t xElapsed = xTaskGetTickCount() - pxTimeOut->xTimeOnEntering;
+    BaseType_t xTimedOut = pdFALSE;
+
+    if( *pxTicksToWait == portMAX_DELAY )
+    {
+        /* Never times out */
+    }
+    else if( xElapsed >= *pxTicksToWait )
+    {
+        *pxTicksToWait = 0;
+        xTimedOut = pdTRUE;
+    }
+    else
+    {
+        *pxTicksToWait -= xElapsed;
+        vTaskSetTimeOutState( pxTimeOut );
+    }
+
+    return xTimedOut;
+}
+
+BaseType_t xTaskGenericNotify( TaskHandle_t xTaskToNotify,
+                               UBaseType_t uxIndexToNotify,
+                               uint32_t ulValue,
+                               eNotifyAction eAction )
+{
+    configASSERT( xTaskToNotify != NULL );
+    configASSERT( uxIndexToNotify < configTASK_NOTIFICATION_ARRAY_ENTRIES );
+
+    prvLock();
+
+    if( eAction == eSetBits )
+    {
+        xTaskToNotify->ulNotifiedValue[ uxIndexToNotify ] |= ulValue;
+    }
+    else if( eAction == eIncrement )
+    {
+        xTaskToNotify->ulNotifiedValue[ uxIndexToNotify ]++;
+    }
+    else if( eAction == eSetValueWithOverwrite )
+    {
+        xTaskToNotify->ulNotifiedValue[ uxIndexToNotify ] = ulValue;
+    }
+
+    xTaskToNotify->xNotifyPending[ uxIndexToNotify ] = pdTRUE;
+
+    prvUnlock();
+
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyWaitIndexed( UBaseType_t uxIndexToWaitOn,
+                                   uint32_t ulBitsToClearOnEntry,
+                                   uint32_t ulBitsToClearOnExit,
+                                   uint32_t * pulNotificationValue,
+                                   TickType_t xTicksToWait )
+{
+    struct HostTask * pxTask = prvCurrentTask();
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    BaseType_t xResult = pdFALSE;
+
+    prvLock();
+
+    if( pxTask->xNotifyPending[ uxIndexToWaitOn ] == pdFALSE )
+    {
+        pxTask->ulNotifiedValue[ uxIndexToWaitOn ] &= ~ulBitsToClearOnEntry;
+    }
+
+    while( ( pxTask->xNotifyPending[ uxIndexToWaitOn ] == pdFALSE ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    if( pulNotificationValue != NULL )
+    {
+        *pulNotificationValue = pxTask->ulNotifiedValue[ uxIndexToWaitOn ];
+    }
+
+    if( pxTask->xNotifyPending[ uxIndexToWaitOn ] == pdTRUE )
+    {
+        pxTask->ulNotifiedValue[ uxIndexToWaitOn ] &= ~ulBitsToClearOnExit;
+        xResult = pdTRUE;
+    }
+
+    pxTask->xNotifyPending[ uxIndexToWaitOn ] = pdFALSE;
+
+    prvUnlock();
+
+    return xResult;
+}
+
+uint32_t ulTaskNotifyTakeIndexed( UBaseType_t uxIndexToWaitOn,
+                                  BaseType_t xClearCountOnExit,
+                                  TickType_t xTicksToWait )
+{
+    struct HostTask * pxTask = prvCurrentTask();
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    uint32_t ulValue;
+
+    prvLock();
+
+    while( ( pxTask->ulNotifiedValue[ uxIndexToWaitOn ] == 0 ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    ulValue = pxTask->ulNotifiedValue[ uxIndexToWaitOn ];
+
+    if( ulValue != 0 )
+    {
+        pxTask->ulNotifiedValue[ uxIndexToWaitOn ] = ( xClearCountOnExit == pdTRUE ) ? 0 : ( ulValue - 1 );
+    }
+
+    pxTask->xNotifyPending[ uxIndexToWaitOn ] = pdFALSE;
+
+    prvUnlock();
+
+    return ulValue;
+}
+
+BaseType_t xTaskNotifyStateClearIndexed( TaskHandle_t xTask,
+                                         UBaseType_t uxIndexToClear )
+{
+    struct HostTask * pxTask = ( xTask != NULL ) ? xTask : prvCurrentTask();
+    BaseType_t xWasPending;
+
+    prvLock();
+    xWasPending = pxTask->xNotifyPending[ uxIndexToClear ];
+    pxTask->xNotifyPending[ uxIndexToClear ] = pdFALSE;
+    prvUnlock();
+
+    return xWasPending;
+}
+
+void * pvPortMalloc( size_t xSize )
+{
+    return malloc( xSize );
+}
+
+void vPortFree( void * pv )
+{
+    free( pv );
+}
+
+/* Queues. A message buffer is a queue of length prefixed items of up to MX_HOST_MSG_MAX bytes. */
+
+#define MX_HOST_MSG_MAX    64
+
+struct HostQueue
+{
+    uint8_t * pucItems;
+    UBaseType_t uxLength;
+    UBaseType_t uxItemSize;
+    UBaseType_t uxHead;
+    UBaseType_t uxCount;
+    struct HostTask * pxMutexHolder;
+};
+
+QueueHandle_t xQueueCreate( UBaseType_t uxQueueLength,
+                            UBaseType_t uxItemSize )
+{
+    struct HostQueue * pxQueue = calloc( 1, sizeof( struct HostQueue ) );
+
+    if( pxQueue != NULL )
+    {
+        pxQueue->pucItems = calloc( uxQueueLength, uxItemSize );
+        pxQueue->uxLength = uxQueueLength;
+        pxQueue->uxItemSize = uxItemSize;
+    }
+
+    return pxQueue;
+}
+
+static BaseType_t prvQueuePut( QueueHandle_t xQueue,
+                               const void * pvItem,
+                               BaseType_t xToFront,
+                               TickType_t xTicksToWait )
+{
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    BaseType_t xResult = pdFALSE;
+
+    prvLock();
+
+    while( ( xQueue->uxCount == xQueue->uxLength ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    if( xQueue->uxCount < xQueue->uxLength )
+    {
+        UBaseType_t uxSlot;
+
+        if( xToFront == pdTRUE )
+        {
+            xQueue->uxHead = ( xQueue->uxHead + xQueue->uxLength - 1 ) % xQueue->uxLength;
+            uxSlot = xQueue->uxHead;
+        }
+        else
+        {
+            uxSlot = ( xQueue->uxHead + xQueue->uxCount ) % xQueue->uxLength;
+        }
+
+        ( void ) memcpy( &( xQueue->pucItems[ uxSlot * xQueue->uxItemSize ] ), pvItem, xQueue->uxItemSize );
+        xQueue->uxCount++;
+        xResult = pdTRUE;
+    }
+
+    prvUnlock();
+
+    return xResult;
+}
+
+static BaseType_t prvQueueGet( QueueHandle_t xQueue,
+                               void * pvBuffer,
+                               BaseType_t xRemove,
+                               TickType_t xTicksToWait )
+{
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    BaseType_t xResult = pdFALSE;
+
+    prvLock();
+
+    while( ( xQueue->uxCount == 0 ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    if( xQueue->uxCount > 0 )
+    {
+        ( void ) memcpy( pvBuffer, &( xQueue->pucItems[ xQueue->uxHead * xQueue->uxItemSize ] ), xQueue->uxItemSize );
+
+        if( xRemove == pdTRUE )
+        {
+            xQueue->uxHead = ( xQueue->uxHead + 1 ) % xQueue->uxLength;
+            xQueue->uxCount--;
+        }
+
+        xResult = pdTRUE;
+    }
+
+    prvUnlock();
+
+    return xResult;
+}
+
+BaseType_t xQueueSend( QueueHandle_t xQueue,
+                       const void * pvItemToQueue,
+                       TickType_t xTicksToWait )
+{
+    return prvQueuePut( xQueue, pvItemToQueue, pdFALSE, xTicksToWait );
+}
+
+BaseType_t xQueueSendToFront( QueueHandle_t xQueue,
+                              const void * pvItemToQueue,
+                              TickType_t xTicksToWait )
+{
+    return prvQueuePut( xQueue, pvItemToQueue, pdTRUE, xTicksToWait );
+}
+
+BaseType_t xQueueReceive( QueueHandle_t xQueue,
+                          void * pvBuffer,
+                          TickType_t xTicksToWait )
+{
+    return prvQueueGet( xQueue, pvBuffer, pdTRUE, xTicksToWait );
+}
+
+BaseType_t xQueuePeek( QueueHandle_t xQueue,
+                       void * pvBuffer,
+                       TickType_t xTicksToWait )
+{
+    return prvQueueGet( xQueue, pvBuffer, pdFALSE, xTicksToWait );
+}
+
+UBaseType_t uxQueueMessagesWaiting( QueueHandle_t xQueue )
+{
+    UBaseType_t uxCount;
+
+    prvLock();
+    uxCount = xQueue->uxCount;
+    prvUnlock();
+
+    return uxCount;
+}
+
+UBaseType_t uxQueueSpacesAvailable( QueueHandle_t xQueue )
+{
+    UBaseType_t uxSpaces;
+
+    prvLock();
+    uxSpaces = xQueue->uxLength - xQueue->uxCount;
+    prvUnlock();
+
+    return uxSpaces;
+}
+
+/* A mutex is an item-less queue of length one whose count is one while it is free */
+SemaphoreHandle_t xSemaphoreCreateMutex( void )
+{
+    struct HostQueue * pxMutex = calloc( 1, sizeof( struct HostQueue ) );
+
+    if( pxMutex != NULL )
+    {
+        pxMutex->uxLength = 1;
+        pxMutex->uxCount = 1;
+    }
+
+    return pxMutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic( StaticSemaphore_t * pxMutexBuffer )
+{
+    configASSERT( pxMutexBuffer != NULL );
+
+    return xSemaphoreCreateMutex();
+}
+
+/* A counting semaphore is the same item-less queue with a longer length */
+SemaphoreHandle_t xSemaphoreCreateCounting( UBaseType_t uxMaxCount,
+                                            UBaseType_t uxInitialCount )
+{
+    struct HostQueue * pxSemaphore = calloc( 1, sizeof( struct HostQueue ) );
+
+    configASSERT( uxInitialCount <= uxMaxCount );
+
+    if( pxSemaphore != NULL )
+    {
+        pxSemaphore->uxLength = uxMaxCount;
+        pxSemaphore->uxCount = uxInitialCount;
+    }
+
+    return pxSemaphore;
+}
+
+BaseType_t xSemaphoreTake( SemaphoreHandle_t xSemaphore,
+                           TickType_t xTicksToWait )
+{
+    struct HostTask * pxTask = prvCurrentTask();
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    BaseType_t xResult = pdFALSE;
+
+    prvLock();
+
+    while( ( xSemaphore->uxCount == 0 ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    if( xSemaphore->uxCount > 0 )
+    {
+        xSemaphore->uxCount--;
+        xSemaphore->pxMutexHolder = pxTask;
+        xResult = pdTRUE;
+    }
+
+    prvUnlock();
+
+    return xResult;
+}
+
+BaseType_t xSemaphoreGive( SemaphoreHandle_t xSemaphore )
+{
+    BaseType_t xResult = pdFALSE;
+
+    prvLock();
+
+    if( xSemaphore->uxCount < xSemaphore->uxLength )
+    {
+        xSemaphore->uxCount++;
+        xSemaphore->pxMutexHolder = NULL;
+        xResult = pdTRUE;
+    }
+
+    prvUnlock();
+
+    return xResult;
+}
+
+TaskHandle_t xQueueGetMutexHolder( QueueHandle_t xSemaphore )
+{
+    TaskHandle_t xHolder;
+
+    prvLock();
+    xHolder = xSemaphore->pxMutexHolder;
+    prvUnlock();
+
+    return xHolder;
+}
+
+MessageBufferHandle_t xMessageBufferCreate( size_t xBufferSizeBytes )
+{
+    return xQueueCreate( ( xBufferSizeBytes / sizeof( void * ) ) + 1, sizeof( size_t ) + MX_HOST_MSG_MAX );
+}
+
+size_t xMessageBufferSend( MessageBufferHandle_t xMessageBuffer,
+                           const void * pvTxData,
+                           size_t xDataLengthBytes,
+                           TickType_t xTicksToWait )
+{
+    uint8_t ucItem[ sizeof( size_t ) + MX_HOST_MSG_MAX ] = { 0 };
+    size_t xSent = 0;
+
+    configASSERT( xDataLengthBytes <= MX_HOST_MSG_MAX );
+
+    ( void ) memcpy( ucItem, &xDataLengthBytes, sizeof( size_t ) );
+    ( void ) memcpy( &( ucItem[ sizeof( size_t ) ] ), pvTxData, xDataLengthBytes );
+
+    if( prvQueuePut( xMessageBuffer, ucItem, pdFALSE, xTicksToWait ) == pdTRUE )
+    {
+        xSent = xDataLengthBytes;
+    }
+
+    return xSent;
+}
+
+size_t xMessageBufferReceive( MessageBufferHandle_t xMessageBuffer,
+                              void * pvRxData,
+                              size_t xBufferLengthBytes,
+                              TickType_t xTicksToWait )
+{
+    uint8_t ucItem[ sizeof( size_t ) + MX_HOST_MSG_MAX ];
+    size_t xReceived = 0;
+
+    if( prvQueueGet( xMessageBuffer, ucItem, pdTRUE, xTicksToWait ) == pdTRUE )
+    {
+        ( void ) memcpy( &xReceived, ucItem, sizeof( size_t ) );
+        configASSERT( xReceived <= xBufferLengthBytes );
+        ( void ) memcpy( pvRxData, &( ucItem[ sizeof( size_t ) ] ), xReceived );
+    }
+
+    return xReceived;
+}
+
+/* Event groups */
+
+struct HostEventGroup
+{
+    EventBits_t uxBits;
+};
+
+EventGroupHandle_t xEventGroupCreate( void )
+{
+    return calloc( 1, sizeof( struct HostEventGroup ) );
+}
+
+EventBits_t xEventGroupSetBits( EventGroupHandle_t xEventGroup,
+                                const EventBits_t uxBitsToSet )
+{
+    EventBits_t uxBits;
+
+    prvLock();
+    xEventGroup->uxBits |= uxBitsToSet;
+    uxBits = xEventGroup->uxBits;
+    prvUnlock();
+
+    return uxBits;
+}
+
+EventBits_t xEventGroupClearBits( EventGroupHandle_t xEventGroup,
+                                  const EventBits_t uxBitsToClear )
+{
+    EventBits_t uxBits;
+
+    prvLock();
+    uxBits = xEventGroup->uxBits;
+    xEventGroup->uxBits &= ~uxBitsToClear;
+    prvUnlock();
+
+    return uxBits;
+}
+
+EventBits_t xEventGroupGetBits( EventGroupHandle_t xEventGroup )
+{
+    EventBits_t uxBits;
+
+    prvLock();
+    uxBits = xEventGroup->uxBits;
+    prvUnlock();
+
+    return uxBits;
+}
+
+static BaseType_t prvEventBitsMet( EventBits_t uxBits,
+                                   EventBits_t uxBitsToWaitFor,
+                                   BaseType_t xWaitForAllBits )
+{
+    return ( xWaitForAllBits == pdTRUE ) ? ( ( uxBits & uxBitsToWaitFor ) == uxBitsToWaitFor ) :
+           ( ( uxBits & uxBitsToWaitFor ) != 0 );
+}
+
+EventBits_t xEventGroupWaitBits( EventGroupHandle_t xEventGroup,
+                                 const EventBits_t uxBitsToWaitFor,
+                                 const BaseType_t xClearOnExit,
+                                 const BaseType_t xWaitForAllBits,
+                                 TickType_t xTicksToWait )
+{
+    struct timespec xDeadline = prvDeadline( xTicksToWait );
+    EventBits_t uxBits;
+
+    prvLock();
+
+    while( ( prvEventBitsMet( xEventGroup->uxBits, uxBitsToWaitFor, xWaitForAllBits ) == pdFALSE ) &&
+           ( prvWait( xTicksToWait, &xDeadline ) == pdTRUE ) )
+    {
+    }
+
+    uxBits = xEventGroup->uxBits;
+
+    if( ( xClearOnExit == pdTRUE ) &&
+        ( prvEventBitsMet( uxBits, uxBitsToWaitFor, xWaitForAllBits ) == pdTRUE ) )
+    {
+        xEventGroup->uxBits &= ~uxBitsToWaitFor;
+    }
+
+    prvUnlock();
+
+    return uxBits;
+}
+
+/* pbufs */
+
+static uint32_t ulPoolUsed = 0;
+
+static struct pbuf * prvPbufNew( uint16_t usLength,
+                                 pbuf_type xType )
+{
+    struct pbuf * p = NULL;
+    BaseType_t xAvailable = pdTRUE;
+
+    if( xType == PBUF_POOL )
+    {
+        prvLock();
+
+        if( ulPoolUsed < PBUF_POOL_SIZE )
+        {
+            ulPoolUsed++;
+        }
+        else
+        {
+            xAvailable = pdFALSE;
+        }
+
+        prvUnlock();
+    }
+
+    if( xAvailable == pdTRUE )
+    {
+        p = calloc( 1, sizeof( struct pbuf ) );
+        configASSERT( p != NULL );
+        p->pucBase = calloc( 1, ( xType == PBUF_POOL ) ? PBUF_POOL_BUFSIZE : usLength );
+        configASSERT( p->pucBase != NULL );
+        p->payload = p->pucBase;
+        p->len = usLength;
+        p->tot_len = usLength;
+        p->type = ( uint8_t ) xType;
+        p->ref = 1;
+    }
+
+    return p;
+}
+
+struct pbuf * pbuf_alloc( pbuf_layer layer,
+                          uint16_t length,
+                          pbuf_type type )
+{
+    struct pbuf * pxHead = NULL;
+
+    ( void ) layer;
+
+    if( type == PBUF_RAM )
+    {
+        pxHead = prvPbufNew( length, PBUF_RAM );
+    }
+    else
+    {
+        /* Pool buffers hold at most PBUF_POOL_BUFSIZE bytes each, longer allocations are chained */
+        struct pbuf * pxTail = NULL;
+        uint16_t usRemaining = length;
+
+        do
+        {
+            uint16_t usLen = ( usRemaining > PBUF_POOL_BUFSIZE ) ? PBUF_POOL_BUFSIZE : usRemaining;
+            struct pbuf * p = prvPbufNew( usLen, PBUF_POOL );
+
+            if( p == NULL )
+            {
+                if( pxHead != NULL )
+                {
+                    ( void ) pbuf_free( pxHead );
+                }
+
+                pxHead = NULL;
+                break;
+            }
+
+            p->tot_len = usRemaining;
+
+            if( pxHead == NULL )
+            {
+                pxHead = p;
+            }
+            else
+            {
+                pxTail->next = p;
+            }
+
+            pxTail = p;
+            usRemaining -= usLen;
+        } while( usRemaining > 0 );
+    }
+
+    return pxHead;
+}
+
+uint8_t pbuf_free( struct pbuf * p )
+{
+    uint8_t ucFreed = 0;
+
+    while( p != NULL )
+    {
+        struct pbuf * pxNext = p->next;
+        uint8_t ucRef;
+
+        /* The router and a waiting task may drop their references to a response concurrently */
+        prvLock();
+        configASSERT( p->ref > 0 );
+        p->ref--;
+        ucRef = p->ref;
+        prvUnlock();
+
+        if( ucRef > 0 )
+        {
+            break;
+        }
+
+        if( p->type == PBUF_POOL )
+        {
+            prvLock();
+            ulPoolUsed--;
+            prvUnlock();
+        }
+
+        free( p->pucBase );
+        free( p );
+        ucFreed++;
+        p = pxNext;
+    }
+
+    return ucFreed;
+}
+
+void pbuf_ref( struct pbuf * p )
+{
+    prvLock();
+    configASSERT( p->ref < UINT8_MAX );
+    p->ref++;
+    prvUnlock();
+}
+
+void pbuf_realloc( struct pbuf * p,
+                   uint16_t size )
+{
+    uint16_t usRemaining = size;
+
+    configASSERT( size <= p->tot_len );
+
+    while( usRemaining > p->len )
+    {
+        usRemaining -= p->len;
+        p->tot_len = ( uint16_t ) ( usRemaining + p->len );
+        p = p->next;
+    }
+
+    p->len = usRemaining;
+    p->tot_len = usRemaining;
+
+    if( p->next != NULL )
+    {
+        ( void ) pbuf_free( p->next );
+        p->next = NULL;
+    }
+}
+
+uint8_t pbuf_remove_header( struct pbuf * p,
+                            size_t header_size )
+{
+    uint8_t ucResult = 1;
+
+    if( header_size <= p->len )
+    {
+        p->payload = ( uint8_t * ) p->payload + header_size;
+        p->len -= ( uint16_t ) header_size;
+        p->tot_len -= ( uint16_t ) header_size;
+        ucResult = 0;
+    }
+
+    return ucResult;
+}
+
+void pbuf_cat( struct pbuf * head,
+               struct pbuf * tail )
+{
+    struct pbuf * p = head;
+
+    while( p->next != NULL )
+    {
+        p->tot_len += tail->tot_len;
+        p = p->next;
+    }
+
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+
+uint16_t pbuf_copy_partial( const struct pbuf * p,
+                            void * dataptr,
+                            uint16_t len,
+                            uint16_t offset )
+{
+    uint16_t usCopied = 0;
+
+    for( ; ( p != NULL ) && ( usCopied < len ); p = p->next )
+    {
+        if( offset >= p->len )
+        {
+            offset -= p->len;
+        }
+        else
+        {
+            uint16_t usChunk = p->len - offset;
+
+            usChunk = ( usChunk > ( len - usCopied ) ) ? ( len - usCopied ) : usChunk;
+            ( void ) memcpy( ( uint8_t * ) dataptr + usCopied, ( uint8_t * ) p->payload + offset, usChunk );
+            usCopied += usChunk;
+            offset = 0;
+        }
+    }
+
+    return usCopied;
+}
+
+err_t pbuf_take( struct pbuf * buf,
+                 const void * dataptr,
+                 uint16_t len )
+{
+    uint16_t usCopied = 0;
+    err_t xResult = ERR_MEM;
+
+    if( len <= buf->tot_len )
+    {
+        for( struct pbuf * p = buf; ( p != NULL ) && ( usCopied < len ); p = p->next )
+        {
+            uint16_t usChunk = ( p->len > ( len - usCopied ) ) ? ( len - usCopied ) : p->len;
+
+            ( void ) memcpy( p->payload, ( const uint8_t * ) dataptr + usCopied, usChunk );
+            usCopied += usChunk;
+        }
+
+        xResult = ERR_OK;
+    }
+
+    return xResult;
+}
+
+uint32_t ulHostPbufPoolUsed( void )
+{
+    uint32_t ulUsed;
+
+    prvLock();
+    ulUsed = ulPoolUsed;
+    prvUnlock();
+
+    return ulUsed;
+}
+
+/* Link to the emulator */
+
+#define MX_HOST_PIN_FLOW      0
+#define MX_HOST_PIN_NOTIFY    1
+
+static int lSocket = -1;
+static pthread_mutex_t xSendLock = PTHREAD_MUTEX_INITIALIZER;
+static uint16_t usNssPinMask;
+static uint16_t usPinMasks[ 2 ];
+static GPIOInterruptCallback_t pxPinCallbacks[ 2 ];
+static void * pvPinContexts[ 2 ];
+static volatile GPIO_PinState xPinLevels[ 2 ];
+
+/* Reply to the transfer in progress, filled in by the reader thread */
+static uint8_t ucMiso[ 8192 ];
+static uint16_t usMisoLen;
+static BaseType_t xMisoReady = pdFALSE;
+
+static BaseType_t prvReadExact( void * pvBuffer,
+                                size_t xLength )
+{
+    size_t xDone = 0;
+
+    while( xDone < xLength )
+    {
+        ssize_t xRead = read( lSocket, ( uint8_t * ) pvBuffer + xDone, xLength - xDone );
+
+        if( xRead <= 0 )
+        {
+            return pdFALSE;
+        }
+
+        xDone += ( size_t ) xRead;
+    }
+
+    return pdTRUE;
+}
+
+static void prvSend( char cType,
+                     const uint8_t * pucPayload,
+                     uint16_t usLength )
+{
+    uint8_t ucHeader[ 3 ] = { ( uint8_t ) cType, ( uint8_t ) ( usLength & 0xFF ), ( uint8_t ) ( usLength >> 8 ) };
+
+    /* Test tasks send control messages alongside the dataplane's transfers */
+    ( void ) pthread_mutex_lock( &xSendLock );
+
+    configASSERT( write( lSocket, ucHeader, sizeof( ucHeader ) ) == ( ssize_t ) sizeof( ucHeader ) );
+
+    if( usLength > 0 )
+    {
+        configASSERT( write( lSocket, pucPayload, usLength ) == ( ssize_t ) usLength );
+    }
+
+    ( void ) pthread_mutex_unlock( &xSendLock );
+}
+
+static void * prvReaderThread( void * pvArg )
+{
+    uint8_t ucHeader[ 3 ];
+
+    ( void ) pvArg;
+
+    while( prvReadExact( ucHeader, sizeof( ucHeader ) ) == pdTRUE )
+    {
+        uint16_t usLength = ( uint16_t ) ( ucHeader[ 1 ] | ( ucHeader[ 2 ] << 8 ) );
+        uint8_t ucPayload[ sizeof( ucMiso ) ];
+
+        configASSERT( usLength <= sizeof( ucPayload ) );
+
+        if( prvReadExact( ucPayload, usLength ) != pdTRUE )
+        {
+            break;
+        }
+
+        if( ( ucHeader[ 0 ] == 'G' ) && ( usLength == 2 ) && ( ucPayload[ 0 ] < 2 ) )
+        {
+            uint8_t ucPin = ucPayload[ 0 ];
+            GPIO_PinState xLevel = ( ucPayload[ 1 ] != 0 ) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+            GPIO_PinState xPrevious = xPinLevels[ ucPin ];
+
+            xPinLevels[ ucPin ] = xLevel;
+
+            /* Both pins interrupt on the rising edge, see hw_init */
+            if( ( xPrevious == GPIO_PIN_RESET ) &&
+                ( xLevel == GPIO_PIN_SET ) &&
+                ( pxPinCallbacks[ ucPin ] != NULL ) )
+            {
+                pxPinCallbacks[ ucPin ]( pvPinContexts[ ucPin ] );
+            }
+        }
+        else if( ucHeader[ 0 ] == 'X' )
+        {
+            prvLock();
+            ( void ) memcpy( ucMiso, ucPayload, usLength );
+            usMisoLen = usLength;
+            xMisoReady = pdTRUE;
+            prvUnlock();
+        }
+    }
+
+    fprintf( stderr, "Emulator disconnected.\n" );
+    exit( 2 );
+
+    return NULL;
+}
+
+BaseType_t xHostShimConnect( const char * pcSocketPath,
+                             uint16_t usNssPin,
+                             uint16_t usFlowPin,
+                             uint16_t usNotifyPin )
+{
+    struct sockaddr_un xAddr = { 0 };
+    pthread_t xReader;
+    BaseType_t xResult = pdFALSE;
+
+    usNssPinMask = usNssPin;
+    usPinMasks[ MX_HOST_PIN_FLOW ] = usFlowPin;
+    usPinMasks[ MX_HOST_PIN_NOTIFY ] = usNotifyPin;
+
+    xAddr.sun_family = AF_UNIX;
+    ( void ) strncpy( xAddr.sun_path, pcSocketPath, sizeof( xAddr.sun_path ) - 1 );
+
+    lSocket = socket( AF_UNIX, SOCK_STREAM, 0 );
+
+    if( ( lSocket >= 0 ) &&
+        ( connect( lSocket, ( struct sockaddr * ) &xAddr, sizeof( xAddr ) ) == 0 ) &&
+        ( pthread_create( &xReader, NULL, prvReaderThread, NULL ) == 0 ) )
+    {
+        ( void ) pthread_detach( xReader );
+        xResult = pdTRUE;
+    }
+
+    return xResult;
+}
+
+void vHostShimControl( const char * pcCommand )
+{
+    prvSend( 'C', ( const uint8_t * ) pcCommand, ( uint16_t ) strlen( pcCommand ) );
+}
+
+void GPIO_EXTI_Register_Callback( uint16_t usGpioPinMask,
+                                  GPIOInterruptCallback_t pvCallback,
+                                  void * pvContext )
+{
+    for( uint32_t ulPin = 0; ulPin < 2; ulPin++ )
+    {
+        if( usPinMasks[ ulPin ] == usGpioPinMask )
+        {
+            pvPinContexts[ ulPin ] = pvContext;
+            pxPinCallbacks[ ulPin ] = pvCallback;
+        }
+    }
+}
+
+void HAL_GPIO_WritePin( GPIO_TypeDef * GPIOx,
+                        uint16_t GPIO_Pin,
+                        GPIO_PinState PinState )
+{
+    ( void ) GPIOx;
+
+    if( GPIO_Pin == usNssPinMask )
+    {
+        uint8_t ucLevel = ( PinState == GPIO_PIN_SET ) ? 1 : 0;
+
+        prvSend( 'S', &ucLevel, 1 );
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin( GPIO_TypeDef * GPIOx,
+                                uint16_t GPIO_Pin )
+{
+    GPIO_PinState xLevel = GPIO_PIN_RESET;
+
+    ( void ) GPIOx;
+
+    for( uint32_t ulPin = 0; ulPin < 2; ulPin++ )
+    {
+        if( usPinMasks[ ulPin ] == GPIO_Pin )
+        {
+            xLevel = xPinLevels[ ulPin ];
+        }
+    }
+
+    return xLevel;
+}
+
+HAL_StatusTypeDef HAL_SPI_RegisterCallback( SPI_HandleTypeDef * hspi,
+                                            HAL_SPI_CallbackIDTypeDef CallbackID,
+                                            pSPI_CallbackTypeDef pCallback )
+{
+    HAL_StatusTypeDef xResult = HAL_OK;
+
+    switch( CallbackID )
+    {
+        case HAL_SPI_TX_COMPLETE_CB_ID:
+            hspi->TxCpltCallback = pCallback;
+            break;
+
+        case HAL_SPI_RX_COMPLETE_CB_ID:
+            hspi->RxCpltCallback = pCallback;
+            break;
+
+        case HAL_SPI_TX_RX_COMPLETE_CB_ID:
+            hspi->TxRxCpltCallback = pCallback;
+            break;
+
+        case HAL_SPI_ERROR_CB_ID:
+            hspi->ErrorCallback = pCallback;
+            break;
+
+        default:
+            xResult = HAL_ERROR;
+            break;
+    }
+
+    return xResult;
+}
+
+/* Clock Size bytes out and in, then complete the "DMA" like the SPI interrupt would */
+static HAL_StatusTypeDef prvTransfer( SPI_HandleTypeDef * hspi,
+                                      const uint8_t * pucTx,
+                                      uint8_t * pucRx,
+                                      uint16_t usSize,
+                                      pSPI_CallbackTypeDef pxDone )
+{
+    uint8_t ucMosi[ sizeof( ucMiso ) ] = { 0 };
+
+    configASSERT( usSize <= sizeof( ucMosi ) );
+
+    if( pucTx != NULL )
+    {
+        ( void ) memcpy( ucMosi, pucTx, usSize );
+    }
+
+    prvLock();
+    xMisoReady = pdFALSE;
+    prvUnlock();
+
+    prvSend( 'X', ucMosi, usSize );
+
+    prvLock();
+
+    while( xMisoReady == pdFALSE )
+    {
+        ( void ) prvWait( portMAX_DELAY, NULL );
+    }
+
+    if( pucRx != NULL )
+    {
+        ( void ) memcpy( pucRx, ucMiso, ( usMisoLen < usSize ) ? usMisoLen : usSize );
+    }
+
+    prvUnlock();
+
+    if( usMisoLen != usSize )
+    {
+        pxDone = hspi->ErrorCallback;
+    }
+
+    if( pxDone != NULL )
+    {
+        pxDone( hspi );
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA( SPI_HandleTypeDef * hspi,
+                                        const uint8_t * pData,
+                                        uint16_t Size )
+{
+    return prvTransfer( hspi, pData, NULL, Size, hspi->TxCpltCallback );
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive_DMA( SPI_HandleTypeDef * hspi,
+                                       uint8_t * pData,
+                                       uint16_t Size )
+{
+    return prvTransfer( hspi, NULL, pData, Size, hspi->RxCpltCallback );
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA( SPI_HandleTypeDef * hspi,
+                                               const uint8_t * pTxData,
+                                               uint8_t * pRxData,
+                                               uint16_t Size )
+{
+    return prvTransfer( hspi, pTxData, pRxData, Size, hspi->TxRxCpltCallback );
+}
@@ -0,0 +1,42 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+#ifndef MX_HOST_SHIM_H
+#define MX_HOST_SHIM_H
+
+#include "FreeRTOS.h"
+
+/*
+ * Connect the HAL shim to an emulator listening on pcSocketPath. Writes to usNssPin drive the
+ * emulator's chip select, and its FLOW / NOTIFY pin changes are reported on usFlowPin and usNotifyPin.
+ */
+BaseType_t xHostShimConnect( const char * pcSocketPath,
+                             uint16_t usNssPin,
+                             uint16_t usFlowPin,
+                             uint16_t usNotifyPin );
+
+/* Send a test control command to the emulator, see the 'C' message in tools/mx_emulator.py */
+void vHostShimControl( const char * pcCommand );
+
+#endif /* MX_HOST_SHIM_H */
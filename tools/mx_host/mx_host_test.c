@@ -0,0 +1,444 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Drive Common/net/mxchip/mx_dataplane.c against tools/mx_emulator.py. The test stands in for
+ * the control plane router and lwIP: it queues IPC requests and bypass frames the way mx_ipc.c
+ * and mx_lwip.c do, and reads responses and received frames back from the dataplane.
+ *
+ * Usage: mx_host_test SOCKET EXPECT_MULTI_FRAME PINGS
+ */
+#include "logging_levels.h"
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "mx_ipc.h"
+#include "mx_prv.h"
+#include "mx_host_shim.h"
+
+#define TEST_PIN_NSS       0x0001
+#define TEST_PIN_FLOW      0x0002
+#define TEST_PIN_NOTIFY    0x0004
+#define TEST_PIN_RESET     0x0008
+
+#define TEST_TIMEOUT       pdMS_TO_TICKS( 2000 )
+#define TEST_BURST_LEN     8
+#define TEST_PING_SIZE     56
+
+#define TEST_CHECK( x )    configASSERT( x )
+
+static GPIO_TypeDef xPort;
+static const IotMappedPin_t xNssPin = { &xPort, TEST_PIN_NSS };
+static const IotMappedPin_t xFlowPin = { &xPort, TEST_PIN_FLOW };
+static const IotMappedPin_t xNotifyPin = { &xPort, TEST_PIN_NOTIFY };
+static const IotMappedPin_t xResetPin = { &xPort, TEST_PIN_RESET };
+
+static SPI_HandleTypeDef xSpiHandle;
+static NetInterface_t xNetif;
+static MxDataplaneCtx_t xCtx;
+static QueueHandle_t xLinkInputQueue;
+
+static const uint8_t ucGatewayIp[ 4 ] = { 192, 168, 0, 1 };
+static const uint8_t ucLocalIp[ 4 ] = { 192, 168, 0, 2 };
+static const uint8_t ucGatewayMac[ 6 ] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static uint8_t ucLocalMac[ 6 ];
+
+/* Frames received in bypass mode are handed to lwIP here */
+BaseType_t prvxLinkInput( NetInterface_t * pxNetif,
+                          PacketBuffer_t * pxPbufIn )
+{
+    ( void ) pxNetif;
+
+    return xQueueSend( xLinkInputQueue, &pxPbufIn, 0 );
+}
+
+/* Queue a message for the dataplane and wake it, like xSendIPCRequest and prvxLinkOutput */
+static void prvEnqueue( QueueHandle_t xQueue,
+                        PacketBuffer_t * pxPacket )
+{
+    MxTxQueueItem_t xTxItem =
+    {
+        .pxPacket    = pxPacket,
+        .xEnqueueTime= xTaskGetTickCount()
+    };
+
+    TEST_CHECK( xQueueSend( xQueue, &xTxItem, TEST_TIMEOUT ) == pdTRUE );
+
+    ( void ) Atomic_Increment_u32( &( xCtx.ulTxPacketsWaiting ) );
+    ( void ) xTaskNotifyGiveIndexed( xCtx.xDataPlaneTaskHandle, DATA_WAITING_IDX );
+}
+
+static uint32_t prvRequest( IPCCommand_t xCommand,
+                            const void * pvData,
+                            uint16_t usDataLen )
+{
+    PacketBuffer_t * pxPacket = PBUF_ALLOC_TX( sizeof( IPCHeader_t ) + usDataLen );
+    IPCHeader_t * pxHeader = NULL;
+
+    TEST_CHECK( pxPacket != NULL );
+
+    pxHeader = ( IPCHeader_t * ) pxPacket->payload;
+    pxHeader->ulIPCRequestId = prvGetNextRequestID();
+    pxHeader->usIPCApiId = ( uint16_t ) xCommand;
+
+    if( usDataLen > 0 )
+    {
+        ( void ) memcpy( ( uint8_t * ) pxPacket->payload + sizeof( IPCHeader_t ), pvData, usDataLen );
+    }
+
+    prvEnqueue( xCtx.xControlPlaneSendQueue, pxPacket );
+
+    return pxHeader->ulIPCRequestId;
+}
+
+/*
+ * Wait for a control plane message with the given request id, or any request id when ulRequestId
+ * is 0, and API id. Other messages are discarded. Returns NULL on timeout.
+ */
+static PacketBuffer_t * prvWaitMessage( uint32_t ulRequestId,
+                                        IPCCommand_t xCommand,
+                                        TickType_t xTimeout )
+{
+    TickType_t xDeadline = xTaskGetTickCount() + xTimeout;
+    PacketBuffer_t * pxMatch = NULL;
+
+    while( ( pxMatch == NULL ) &&
+           ( ( int32_t ) ( xDeadline - xTaskGetTickCount() ) > 0 ) )
+    {
+        PacketBuffer_t * pxPacket = NULL;
+
+        if( xMessageBufferReceive( xCtx.xControlPlaneResponseBuff, &pxPacket, sizeof( pxPacket ),
+                                   xDeadline - xTaskGetTickCount() ) == sizeof( pxPacket ) )
+        {
+            IPCHeader_t * pxHeader = ( IPCHeader_t * ) pxPacket->payload;
+
+            if( ( pxHeader->usIPCApiId == ( uint16_t ) xCommand ) &&
+                ( ( ulRequestId == 0 ) || ( pxHeader->ulIPCRequestId == ulRequestId ) ) )
+            {
+                pxMatch = pxPacket;
+            }
+            else
+            {
+                PBUF_FREE( pxPacket );
+            }
+        }
+    }
+
+    return pxMatch;
+}
+
+static void * prvPayload( PacketBuffer_t * pxPacket )
+{
+    return ( uint8_t * ) pxPacket->payload + sizeof( IPCHeader_t );
+}
+
+static void prvRequestResponse( IPCCommand_t xCommand,
+                                const void * pvData,
+                                uint16_t usDataLen,
+                                void * pvResponse,
+                                uint16_t usResponseLen )
+{
+    uint32_t ulRequestId = prvRequest( xCommand, pvData, usDataLen );
+    PacketBuffer_t * pxResponse = prvWaitMessage( ulRequestId, xCommand, TEST_TIMEOUT );
+
+    TEST_CHECK( pxResponse != NULL );
+    TEST_CHECK( pxResponse->len >= sizeof( IPCHeader_t ) + usResponseLen );
+
+    if( pvResponse != NULL )
+    {
+        ( void ) memcpy( pvResponse, prvPayload( pxResponse ), usResponseLen );
+    }
+
+    PBUF_FREE( pxResponse );
+}
+
+/* Connect and return the status reported by the following IPC_WIFI_EVT_STATUS, or 0 without one */
+static uint32_t prvConnect( const uint8_t * pucBssid,
+                            uint8_t ucChannel )
+{
+    IPCRequestWifiConnect_t xRequest = { 0 };
+    PacketBuffer_t * pxEvent = NULL;
+    uint32_t ulStatus = 0;
+
+    ( void ) strcpy( xRequest.cSSID, "emu" );
+
+    if( pucBssid != NULL )
+    {
+        xRequest.ucUseAttr = 1;
+        xRequest.ucAccessPointChannel = ucChannel;
+        ( void ) memcpy( xRequest.ucAccessPointBssid, pucBssid, MX_BSSID_LEN );
+    }
+
+    prvRequestResponse( IPC_WIFI_CONNECT, &xRequest, sizeof( xRequest ), NULL, 0 );
+
+    pxEvent = prvWaitMessage( 0, IPC_WIFI_EVT_STATUS, pdMS_TO_TICKS( 500 ) );
+
+    if( pxEvent != NULL )
+    {
+        ulStatus = ( ( IPCEventStatus_t * ) prvPayload( pxEvent ) )->status;
+        PBUF_FREE( pxEvent );
+    }
+
+    return ulStatus;
+}
+
+static void prvDisconnect( void )
+{
+    PacketBuffer_t * pxEvent = NULL;
+
+    prvRequestResponse( IPC_WIFI_DISCONNECT, NULL, 0, NULL, 0 );
+
+    pxEvent = prvWaitMessage( 0, IPC_WIFI_EVT_STATUS, TEST_TIMEOUT );
+    TEST_CHECK( pxEvent != NULL );
+    TEST_CHECK( ( ( IPCEventStatus_t * ) prvPayload( pxEvent ) )->status == MX_STATUS_STA_DOWN );
+    PBUF_FREE( pxEvent );
+}
+
+static uint16_t prvChecksum( const uint8_t * pucData,
+                             size_t xLength )
+{
+    uint32_t ulSum = 0;
+
+    for( size_t i = 0; i < xLength; i += 2 )
+    {
+        ulSum += ( uint32_t ) pucData[ i ] << 8;
+
+        if( ( i + 1 ) < xLength )
+        {
+            ulSum += pucData[ i + 1 ];
+        }
+    }
+
+    while( ( ulSum >> 16 ) != 0 )
+    {
+        ulSum = ( ulSum & 0xFFFF ) + ( ulSum >> 16 );
+    }
+
+    return ( uint16_t ) ~ulSum;
+}
+
+/*
+ * Queue an ICMP echo request to the gateway as a bypass frame, chaining the BypassInOut_t header
+ * in front of the ethernet frame like prvxLinkOutput does.
+ */
+static void prvSendPing( uint16_t usSeq )
+{
+    uint16_t usFrameLen = 14 + 20 + 8 + TEST_PING_SIZE;
+    PacketBuffer_t * pxHeader = PBUF_ALLOC_TX( sizeof( BypassInOut_t ) );
+    PacketBuffer_t * pxFrame = PBUF_ALLOC_TX( usFrameLen );
+    BypassInOut_t * pxBypass = NULL;
+    uint8_t * pucEth = NULL;
+    uint8_t * pucIp = NULL;
+    uint8_t * pucIcmp = NULL;
+    uint16_t usSum;
+
+    TEST_CHECK( ( pxHeader != NULL ) && ( pxFrame != NULL ) );
+
+    pxBypass = ( BypassInOut_t * ) pxHeader->payload;
+    ( void ) memset( pxBypass, 0, sizeof( BypassInOut_t ) );
+    pxBypass->xHeader.ulIPCRequestId = prvGetNextRequestID();
+    pxBypass->xHeader.usIPCApiId = IPC_WIFI_BYPASS_OUT;
+    pxBypass->usDataLen = usFrameLen;
+
+    pucEth = pxFrame->payload;
+    ( void ) memset( pucEth, 'x', usFrameLen );
+    ( void ) memcpy( &pucEth[ 0 ], ucGatewayMac, 6 );
+    ( void ) memcpy( &pucEth[ 6 ], ucLocalMac, 6 );
+    pucEth[ 12 ] = 0x08;
+    pucEth[ 13 ] = 0x00;
+
+    pucIp = &pucEth[ 14 ];
+    ( void ) memset( pucIp, 0, 20 );
+    pucIp[ 0 ] = 0x45;
+    pucIp[ 2 ] = ( uint8_t ) ( ( usFrameLen - 14 ) >> 8 );
+    pucIp[ 3 ] = ( uint8_t ) ( usFrameLen - 14 );
+    pucIp[ 8 ] = 64;
+    pucIp[ 9 ] = 1;
+    ( void ) memcpy( &pucIp[ 12 ], ucLocalIp, 4 );
+    ( void ) memcpy( &pucIp[ 16 ], ucGatewayIp, 4 );
+    usSum = prvChecksum( pucIp, 20 );
+    pucIp[ 10 ] = ( uint8_t ) ( usSum >> 8 );
+    pucIp[ 11 ] = ( uint8_t ) usSum;
+
+    pucIcmp = &pucIp[ 20 ];
+    ( void ) memset( pucIcmp, 0, 8 );
+    pucIcmp[ 0 ] = 8;
+    pucIcmp[ 5 ] = 1;
+    pucIcmp[ 6 ] = ( uint8_t ) ( usSeq >> 8 );
+    pucIcmp[ 7 ] = ( uint8_t ) usSeq;
+    usSum = prvChecksum( pucIcmp, 8 + TEST_PING_SIZE );
+    pucIcmp[ 2 ] = ( uint8_t ) ( usSum >> 8 );
+    pucIcmp[ 3 ] = ( uint8_t ) usSum;
+
+    pbuf_cat( pxHeader, pxFrame );
+
+    prvEnqueue( xCtx.xDataPlaneSendQueue, pxHeader );
+}
+
+/* Wait for an echo reply and return its sequence number */
+static uint16_t prvReceivePong( void )
+{
+    PacketBuffer_t * pxFrame = NULL;
+    uint8_t ucFrame[ 14 + 20 + 8 ];
+    uint16_t usSeq;
+
+    TEST_CHECK( xQueueReceive( xLinkInputQueue, &pxFrame, TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( pbuf_copy_partial( pxFrame, ucFrame, sizeof( ucFrame ), 0 ) == sizeof( ucFrame ) );
+
+    /* Ethertype IPv4, ICMP echo reply from the gateway */
+    TEST_CHECK( ( ucFrame[ 12 ] == 0x08 ) && ( ucFrame[ 13 ] == 0x00 ) );
+    TEST_CHECK( memcmp( &ucFrame[ 14 + 12 ], ucGatewayIp, 4 ) == 0 );
+    TEST_CHECK( ucFrame[ 14 + 20 ] == 0 );
+
+    usSeq = ( uint16_t ) ( ( ucFrame[ 14 + 20 + 6 ] << 8 ) | ucFrame[ 14 + 20 + 7 ] );
+
+    PBUF_FREE( pxFrame );
+
+    return usSeq;
+}
+
+int main( int argc,
+          char ** argv )
+{
+    IPCResponseSysVersion_t xVersion = { 0 };
+    IPCRequestWifiBypassSet_t xBypass = { .enable = 1 };
+    IPCResponseWifiGetLinkInfo_t xLinkInfo = { 0 };
+    const uint8_t ucUnknownBssid[ MX_BSSID_LEN ] = { 0x02, 0xa0, 0x00, 0x00, 0x00, 0x02 };
+    BaseType_t xExpectMultiFrame;
+    uint32_t ulPings;
+    uint32_t ulTransactions;
+    TickType_t xStart;
+
+    if( argc != 4 )
+    {
+        fprintf( stderr, "usage: %s SOCKET EXPECT_MULTI_FRAME PINGS\n", argv[ 0 ] );
+        return 1;
+    }
+
+    xExpectMultiFrame = ( BaseType_t ) atoi( argv[ 2 ] );
+    ulPings = ( uint32_t ) atoi( argv[ 3 ] );
+
+    TEST_CHECK( xHostShimConnect( argv[ 1 ], TEST_PIN_NSS, TEST_PIN_FLOW, TEST_PIN_NOTIFY ) == pdTRUE );
+
+    xLinkInputQueue = xQueueCreate( 2 * TEST_BURST_LEN, sizeof( PacketBuffer_t * ) );
+
+    /* Same objects as vInitializeWifiModule creates for the dataplane */
+    xCtx.gpio_flow = &xFlowPin;
+    xCtx.gpio_reset = &xResetPin;
+    xCtx.gpio_nss = &xNssPin;
+    xCtx.gpio_notify = &xNotifyPin;
+    xCtx.pxSpiHandle = &xSpiHandle;
+    xCtx.pxNetif = &xNetif;
+    xCtx.xControlPlaneResponseBuff = xMessageBufferCreate( CONTROL_PLANE_BUFFER_SZ );
+    xCtx.xDataPlaneSendQueue = xQueueCreate( DATA_PLANE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
+    xCtx.xControlPlaneSendQueue = xQueueCreate( CONTROL_PLANE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
+    xCtx.xInteractiveSendQueue = xQueueCreate( INTERACTIVE_QUEUE_LEN, sizeof( MxTxQueueItem_t ) );
+
+    TEST_CHECK( xTaskCreate( vDataplaneThread, "MxDataPlane", 4096, &xCtx, 25, &( xCtx.xDataPlaneTaskHandle ) ) == pdPASS );
+
+    /* Request ids are handed out once the dataplane has exported its context */
+    while( prvGetNextRequestID() == 0 )
+    {
+        vTaskDelay( pdMS_TO_TICKS( 1 ) );
+    }
+
+    prvRequestResponse( IPC_SYS_VERSION, NULL, 0, &xVersion, sizeof( xVersion ) );
+    TEST_CHECK( strncmp( xVersion.cFirmwareRevision, "EMU-", 4 ) == 0 );
+
+    prvRequestResponse( IPC_WIFI_GET_MAC, NULL, 0, ucLocalMac, sizeof( ucLocalMac ) );
+    prvRequestResponse( IPC_WIFI_BYPASS_SET, &xBypass, sizeof( xBypass ), NULL, 0 );
+
+    /* Connect by SSID, then reconnect directly to the access point it reports */
+    TEST_CHECK( prvConnect( NULL, 0 ) == MX_STATUS_STA_UP );
+    prvRequestResponse( IPC_WIFI_GET_LINKINFO, NULL, 0, &xLinkInfo, sizeof( xLinkInfo ) );
+    TEST_CHECK( ( xLinkInfo.lStatus == 0 ) && ( xLinkInfo.ucIsConnected == 1 ) );
+    TEST_CHECK( strcmp( xLinkInfo.cSSID, "emu" ) == 0 );
+
+    prvDisconnect();
+    TEST_CHECK( prvConnect( xLinkInfo.ucBssid, xLinkInfo.ucChannel ) == MX_STATUS_STA_UP );
+    prvDisconnect();
+    TEST_CHECK( prvConnect( ucUnknownBssid, xLinkInfo.ucChannel ) == 0 );
+    TEST_CHECK( prvConnect( NULL, 0 ) == MX_STATUS_STA_UP );
+
+    /* One echo at a time, then bursts that let both sides pack frames */
+    ulTransactions = xCtx.ulSpiTransactions;
+    xStart = xTaskGetTickCount();
+
+    for( uint32_t ulSeq = 0; ulSeq < ulPings; ulSeq++ )
+    {
+        prvSendPing( ( uint16_t ) ulSeq );
+        TEST_CHECK( prvReceivePong() == ( uint16_t ) ulSeq );
+    }
+
+    printf( "%lu single echoes: %lu transactions, %lu ms\n",
+            ( unsigned long ) ulPings,
+            ( unsigned long ) ( xCtx.ulSpiTransactions - ulTransactions ),
+            ( unsigned long ) ( ( xTaskGetTickCount() - xStart ) * 1000 / configTICK_RATE_HZ ) );
+
+    ulTransactions = xCtx.ulSpiTransactions;
+    xStart = xTaskGetTickCount();
+
+    for( uint32_t ulBurst = 0; ulBurst < ( ulPings / TEST_BURST_LEN ); ulBurst++ )
+    {
+        uint32_t ulSeen = 0;
+
+        for( uint32_t ulSeq = 0; ulSeq < TEST_BURST_LEN; ulSeq++ )
+        {
+            prvSendPing( ( uint16_t ) ulSeq );
+        }
+
+        for( uint32_t ulSeq = 0; ulSeq < TEST_BURST_LEN; ulSeq++ )
+        {
+            ulSeen |= 1UL << prvReceivePong();
+        }
+
+        TEST_CHECK( ulSeen == ( ( 1UL << TEST_BURST_LEN ) - 1 ) );
+    }
+
+    printf( "%lu echoes in bursts of %d: %lu transactions, %lu ms\n",
+            ( unsigned long ) ( ulPings / TEST_BURST_LEN * TEST_BURST_LEN ), TEST_BURST_LEN,
+            ( unsigned long ) ( xCtx.ulSpiTransactions - ulTransactions ),
+            ( unsigned long ) ( ( xTaskGetTickCount() - xStart ) * 1000 / configTICK_RATE_HZ ) );
+
+    /* Let the dataplane finish the bypass out acknowledgements */
+    vTaskDelay( pdMS_TO_TICKS( 50 ) );
+
+    printf( "multi-frame: %s, %lu transactions, %lu tx frames, %lu rx frames, %lu rx dropped\n",
+            ( xCtx.xMultiFrame == pdTRUE ) ? "negotiated" : "off",
+            ( unsigned long ) xCtx.ulSpiTransactions,
+            ( unsigned long ) xCtx.ulTxFrames,
+            ( unsigned long ) xCtx.ulRxFrames,
+            ( unsigned long ) xCtx.ulRxDropped );
+
+    TEST_CHECK( xCtx.xMultiFrame == xExpectMultiFrame );
+    TEST_CHECK( xCtx.ulRxDropped == 0 );
+
+    /* Everything but the armed receive ring has been returned to the pool */
+    TEST_CHECK( ulHostPbufPoolUsed() == xCtx.ulRxRingCount );
+
+    printf( "dataplane test passed\n" );
+
+    return 0;
+}
@@ -0,0 +1,793 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Run Common/net/mxchip/mx_netconn.c with the control plane router of mx_ipc.c and the dataplane of
+ * mx_dataplane.c against tools/mx_emulator.py. net_main brings the module up and connects as it
+ * does on the target; the test stands in for lwIP and the key-value store and steers the module
+ * with the emulator's control commands to check:
+ *  - asynchronous requests issued from several tasks at once, more than there are request contexts
+ *  - timeouts of asynchronous requests while the module holds its responses: a lone request wakes
+ *    the router, requests expire in deadline order and not early, and late responses are dropped
+ *  - fast connect: the first connect scans and is cached, a reconnect goes straight to the cached
+ *    access point and uses the cached lease until DHCP binds, and a replaced access point falls
+ *    back to a scan
+ *
+ * Usage: mx_netconn_test SOCKET SCAN_DELAY_MS
+ */
+#include "logging_levels.h"
+#include "logging.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "event_groups.h"
+#include "mx_ipc.h"
+#include "mx_prv.h"
+#include "mx_netconn.h"
+#include "mx_reconnect.h"
+#include "mx_host_shim.h"
+#include "kvstore.h"
+#include "sys_evt.h"
+#include "stm32u5_iot_board.h"
+#include "lwip_tuning.h"
+
+#include "lwip/tcpip.h"
+#include "lwip/dhcp.h"
+#include "lwip/etharp.h"
+#include "lwip/apps/lwiperf.h"
+
+#define TEST_PIN_NSS            0x0001
+#define TEST_PIN_FLOW           0x0002
+#define TEST_PIN_NOTIFY         0x0004
+#define TEST_PIN_RESET          0x0008
+
+#define TEST_NOTIFY_IDX         2    /* 0 carries IPC responses, 1 NET_EVT_IDX and 3 DATA_WAITING_IDX */
+#define TEST_TIMEOUT            pdMS_TO_TICKS( 2000 )
+#define TEST_ASYNC_TASKS        3
+#define TEST_ASYNC_PER_TASK     4
+#define TEST_DHCP_DELAY         pdMS_TO_TICKS( 500 )
+#define TEST_DHCP_RUNNING       1
+
+/* Time allowed past a deadline: the wheel resolution plus scheduling on a loaded host */
+#define TEST_TIMER_SLACK        ( IPC_TIMER_WHEEL_RESOLUTION + pdMS_TO_TICKS( 50 ) )
+
+#define TEST_CHECK( x )         configASSERT( x )
+#define TICKS_TO_MS( x )        ( ( unsigned long ) ( ( x ) * 1000 / configTICK_RATE_HZ ) )
+
+static const uint8_t ucTestBssid[ MX_BSSID_LEN ] = { 0x02, 0xa0, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t ucMovedBssid[ MX_BSSID_LEN ] = { 0x02, 0xa0, 0x00, 0x00, 0x00, 0x02 };
+static const uint8_t ucLeaseIp[ 4 ] = { 192, 168, 0, 50 };
+static const uint8_t ucLeaseNetmask[ 4 ] = { 255, 255, 255, 0 };
+static const uint8_t ucLeaseGateway[ 4 ] = { 192, 168, 0, 1 };
+
+/* Board */
+
+static GPIO_TypeDef xPort;
+static SPI_HandleTypeDef xSpiHandle;
+
+const IotMappedPin_t xGpioMap[ GPIO_MAX ] =
+{
+    [ GPIO_MX_FLOW ] =   { &xPort, TEST_PIN_FLOW   },
+    [ GPIO_MX_RESET ] =  { &xPort, TEST_PIN_RESET  },
+    [ GPIO_MX_NSS ] =    { &xPort, TEST_PIN_NSS    },
+    [ GPIO_MX_NOTIFY ] = { &xPort, TEST_PIN_NOTIFY },
+};
+
+SPI_HandleTypeDef * pxHndlSpi2 = &xSpiHandle;
+EventGroupHandle_t xSystemEvents = NULL;
+
+/* Key-value store */
+
+static SemaphoreHandle_t xKvMutex;
+static MxFastConnectCache_t xKvFastConnect;
+static size_t xKvFastConnectLength = 0;
+static volatile uint32_t ulKvCommits = 0;
+
+size_t KVStore_getString( KVStoreKey_t key,
+                          char * pvBuffer,
+                          size_t xMaxLength )
+{
+    const char * pcValue = ( key == CS_WIFI_SSID ) ? "emu" : "emu-psk";
+
+    TEST_CHECK( ( key == CS_WIFI_SSID ) || ( key == CS_WIFI_CREDENTIAL ) );
+    ( void ) strncpy( pvBuffer, pcValue, xMaxLength );
+
+    return strlen( pcValue );
+}
+
+size_t KVStore_getBlob( KVStoreKey_t key,
+                        void * pvBuffer,
+                        size_t xMaxLength )
+{
+    size_t xLength;
+
+    TEST_CHECK( key == CS_WIFI_FAST_CONNECT );
+    TEST_CHECK( xSemaphoreTake( xKvMutex, portMAX_DELAY ) == pdTRUE );
+
+    xLength = ( xKvFastConnectLength < xMaxLength ) ? xKvFastConnectLength : xMaxLength;
+    ( void ) memcpy( pvBuffer, &xKvFastConnect, xLength );
+
+    ( void ) xSemaphoreGive( xKvMutex );
+
+    return xLength;
+}
+
+BaseType_t KVStore_setBlob( KVStoreKey_t key,
+                            size_t xLength,
+                            const void * pvNewValue )
+{
+    TEST_CHECK( key == CS_WIFI_FAST_CONNECT );
+    TEST_CHECK( xLength <= sizeof( xKvFastConnect ) );
+    TEST_CHECK( xSemaphoreTake( xKvMutex, portMAX_DELAY ) == pdTRUE );
+
+    ( void ) memcpy( &xKvFastConnect, pvNewValue, xLength );
+    xKvFastConnectLength = xLength;
+
+    ( void ) xSemaphoreGive( xKvMutex );
+
+    return pdTRUE;
+}
+
+BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey )
+{
+    TEST_CHECK( xKey == CS_WIFI_FAST_CONNECT );
+    ulKvCommits++;
+
+    return pdTRUE;
+}
+
+/*
+ * lwIP. Netif changes are reported to the net task like vLwipStatusCallback in mx_lwip.c does, and
+ * a DHCP server task binds ucLeaseIp TEST_DHCP_DELAY after DHCP starts or the link comes up.
+ */
+
+static SemaphoreHandle_t xLwipMutex; /* Stands in for the tcpip thread */
+static TaskHandle_t xDhcpTask = NULL;
+static struct netif * pxTestNetif = NULL;
+static struct dhcp xDhcp = { DHCP_STATE_OFF };
+static BaseType_t xDhcpBound = pdFALSE;
+static volatile uint32_t ulLinkUps = 0;
+static volatile TickType_t xLinkUpTime = 0;
+static volatile uint32_t ulLeasesApplied = 0; /* Addresses set other than by DHCP */
+static volatile TickType_t xLeaseAppliedTime = 0;
+
+static uint32_t prvAddr( const uint8_t * pucOctets )
+{
+    uint32_t ulAddr;
+
+    ( void ) memcpy( &ulAddr, pucOctets, sizeof( ulAddr ) );
+
+    return ulAddr;
+}
+
+static void prvLwipLock( void )
+{
+    TEST_CHECK( xSemaphoreTake( xLwipMutex, portMAX_DELAY ) == pdTRUE );
+}
+
+static void prvLwipUnlock( void )
+{
+    ( void ) xSemaphoreGive( xLwipMutex );
+}
+
+/* Same notifications as vLwipStatusCallback, called with the lwIP lock held */
+static void prvNetifChanged( struct netif * pxNetif )
+{
+    static ip_addr_t xLastAddr = { 0 };
+    static uint8_t ucLastFlags = 0;
+    MxNetConnectCtx_t * pxCtx = ( MxNetConnectCtx_t * ) pxNetif->state;
+    uint32_t ulNotifyValue = 0;
+
+    if( ( pxNetif->flags ^ ucLastFlags ) & NETIF_FLAG_UP )
+    {
+        ulNotifyValue |= ( pxNetif->flags & NETIF_FLAG_UP ) ? NET_LWIP_IFUP_BIT : NET_LWIP_IFDOWN_BIT;
+    }
+    else if( ( pxNetif->flags ^ ucLastFlags ) & NETIF_FLAG_LINK_UP )
+    {
+        ulNotifyValue |= ( pxNetif->flags & NETIF_FLAG_LINK_UP ) ? NET_LWIP_LINK_UP_BIT : NET_LWIP_LINK_DOWN_BIT;
+    }
+
+    if( pxNetif->ip_addr.addr != xLastAddr.addr )
+    {
+        ulNotifyValue |= NET_LWIP_IP_CHANGE_BIT;
+    }
+
+    if( ulNotifyValue > 0 )
+    {
+        ( void ) xTaskNotifyIndexed( pxCtx->xNetTaskHandle, NET_EVT_IDX, ulNotifyValue, eSetBits );
+    }
+
+    xLastAddr = pxNetif->ip_addr;
+    ucLastFlags = pxNetif->flags;
+}
+
+static void prvDhcpServerTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) ulTaskNotifyTakeIndexed( 0, pdTRUE, portMAX_DELAY );
+        vTaskDelay( TEST_DHCP_DELAY );
+
+        prvLwipLock();
+
+        if( ( pxTestNetif != NULL ) &&
+            ( pxTestNetif->flags & NETIF_FLAG_LINK_UP ) &&
+            ( xDhcp.state != DHCP_STATE_OFF ) &&
+            ( xDhcpBound == pdFALSE ) )
+        {
+            pxTestNetif->ip_addr.addr = prvAddr( ucLeaseIp );
+            pxTestNetif->netmask.addr = prvAddr( ucLeaseNetmask );
+            pxTestNetif->gw.addr = prvAddr( ucLeaseGateway );
+            xDhcpBound = pdTRUE;
+            prvNetifChanged( pxTestNetif );
+        }
+
+        prvLwipUnlock();
+    }
+}
+
+void tcpip_init( tcpip_init_done_fn initfunc,
+                 void * arg )
+{
+    initfunc( arg );
+}
+
+err_t tcpip_input( struct pbuf * p,
+                   struct netif * inp )
+{
+    ( void ) inp;
+    ( void ) pbuf_free( p );
+
+    return ERR_OK;
+}
+
+void vLwipTuningInit( void )
+{
+}
+
+void * lwiperf_start_tcp_server_default( lwiperf_report_fn report_fn,
+                                         void * report_arg )
+{
+    ( void ) report_fn;
+    ( void ) report_arg;
+
+    return NULL;
+}
+
+err_t prvInitNetInterface( NetInterface_t * pxNetif )
+{
+    pxNetif->flags = 0;
+
+    return ERR_OK;
+}
+
+/* Nothing is sent in bypass mode, see mx_host_test.c for the dataplane */
+BaseType_t prvxLinkInput( NetInterface_t * pxNetif,
+                          PacketBuffer_t * pxPbufIn )
+{
+    ( void ) pxNetif;
+    ( void ) pbuf_free( pxPbufIn );
+
+    return pdTRUE;
+}
+
+err_t netifapi_netif_add( struct netif * netif,
+                          const ip4_addr_t * ipaddr,
+                          const ip4_addr_t * netmask,
+                          const ip4_addr_t * gw,
+                          void * state,
+                          netif_init_fn init,
+                          netif_input_fn input )
+{
+    err_t xError;
+
+    ( void ) input;
+
+    prvLwipLock();
+
+    netif->ip_addr.addr = ( ipaddr != NULL ) ? ipaddr->addr : 0;
+    netif->netmask.addr = ( netmask != NULL ) ? netmask->addr : 0;
+    netif->gw.addr = ( gw != NULL ) ? gw->addr : 0;
+    netif->state = state;
+    xError = init( netif );
+    pxTestNetif = netif;
+
+    prvLwipUnlock();
+
+    return xError;
+}
+
+err_t netifapi_netif_set_default( struct netif * netif )
+{
+    TEST_CHECK( netif == pxTestNetif );
+
+    return ERR_OK;
+}
+
+err_t netifapi_netif_set_up( struct netif * netif )
+{
+    prvLwipLock();
+    netif->flags |= NETIF_FLAG_UP;
+    prvNetifChanged( netif );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+err_t netifapi_netif_set_down( struct netif * netif )
+{
+    prvLwipLock();
+    netif->flags &= ( uint8_t ) ~NETIF_FLAG_UP;
+    prvNetifChanged( netif );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+/* DHCP restarts on link up, as dhcp_network_changed does */
+err_t netifapi_netif_set_link_up( struct netif * netif )
+{
+    prvLwipLock();
+
+    netif->flags |= NETIF_FLAG_LINK_UP;
+    ulLinkUps++;
+    xLinkUpTime = xTaskGetTickCount();
+
+    if( xDhcp.state != DHCP_STATE_OFF )
+    {
+        xDhcpBound = pdFALSE;
+        ( void ) xTaskNotifyGiveIndexed( xDhcpTask, 0 );
+    }
+
+    prvNetifChanged( netif );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+err_t netifapi_netif_set_link_down( struct netif * netif )
+{
+    prvLwipLock();
+    netif->flags &= ( uint8_t ) ~NETIF_FLAG_LINK_UP;
+    xDhcpBound = pdFALSE;
+    prvNetifChanged( netif );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+err_t netifapi_netif_set_addr( struct netif * netif,
+                               const struct ip4_addr * ipaddr,
+                               const struct ip4_addr * netmask,
+                               const struct ip4_addr * gw )
+{
+    prvLwipLock();
+
+    netif->ip_addr.addr = ipaddr->addr;
+    netif->netmask.addr = netmask->addr;
+    netif->gw.addr = gw->addr;
+
+    if( ipaddr->addr != 0 )
+    {
+        ulLeasesApplied++;
+        xLeaseAppliedTime = xTaskGetTickCount();
+    }
+
+    prvNetifChanged( netif );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+err_t netifapi_dhcp_start( struct netif * netif )
+{
+    ( void ) netif;
+
+    prvLwipLock();
+    xDhcp.state = TEST_DHCP_RUNNING;
+    xDhcpBound = pdFALSE;
+    ( void ) xTaskNotifyGiveIndexed( xDhcpTask, 0 );
+    prvLwipUnlock();
+
+    return ERR_OK;
+}
+
+struct dhcp * netif_dhcp_data( struct netif * netif )
+{
+    ( void ) netif;
+
+    return &xDhcp;
+}
+
+uint8_t dhcp_supplied_address( const struct netif * netif )
+{
+    ( void ) netif;
+
+    return ( xDhcpBound == pdTRUE ) ? 1 : 0;
+}
+
+/* No other host holds the cached address */
+err_t etharp_query( struct netif * netif,
+                    const ip4_addr_t * ipaddr,
+                    struct pbuf * q )
+{
+    ( void ) netif;
+    ( void ) q;
+    TEST_CHECK( ipaddr->addr == prvAddr( ucLeaseIp ) );
+
+    return ERR_OK;
+}
+
+ssize_t etharp_find_addr( struct netif * netif,
+                          const ip4_addr_t * ipaddr,
+                          struct eth_addr ** eth_ret,
+                          const ip4_addr_t ** ip_ret )
+{
+    ( void ) netif;
+    ( void ) ipaddr;
+    ( void ) eth_ret;
+    ( void ) ip_ret;
+
+    return -1;
+}
+
+/* Test */
+
+typedef struct
+{
+    char cVersion[ MX_FIRMWARE_REVISION_SIZE ];
+    struct eth_addr xMac;
+    TaskHandle_t xTask;
+    TickType_t xTimeout;
+    TickType_t xIssued;
+    TickType_t xCompleted;
+    IPCError_t xResult;
+    uint32_t ulCalls;
+    uint32_t ulOrder;
+} TestRequest_t;
+
+typedef struct
+{
+    TaskHandle_t xMainTask;
+    TestRequest_t xRequests[ TEST_ASYNC_PER_TASK ];
+} TestWorker_t;
+
+static struct eth_addr xModuleMac;
+static volatile uint32_t ulCompletions = 0;
+
+static void prvRequestDone( IPCError_t xError,
+                            void * pvCtx )
+{
+    TestRequest_t * pxRequest = ( TestRequest_t * ) pvCtx;
+
+    pxRequest->xResult = xError;
+    pxRequest->xCompleted = xTaskGetTickCount();
+    pxRequest->ulOrder = Atomic_Increment_u32( &ulCompletions );
+    pxRequest->ulCalls++;
+
+    ( void ) xTaskNotifyGiveIndexed( pxRequest->xTask, TEST_NOTIFY_IDX );
+}
+
+static void prvIssueVersion( TestRequest_t * pxRequest,
+                             TickType_t xTimeout )
+{
+    pxRequest->xTask = xTaskGetCurrentTaskHandle();
+    pxRequest->xTimeout = xTimeout;
+    pxRequest->xIssued = xTaskGetTickCount();
+
+    TEST_CHECK( mx_RequestVersionAsync( pxRequest->cVersion, sizeof( pxRequest->cVersion ),
+                                        prvRequestDone, pxRequest, xTimeout ) == IPC_SUCCESS );
+}
+
+static void prvWaitCompletions( uint32_t ulCount )
+{
+    for( uint32_t i = 0; i < ulCount; i++ )
+    {
+        TEST_CHECK( ulTaskNotifyTakeIndexed( TEST_NOTIFY_IDX, pdFALSE, TEST_TIMEOUT ) > 0 );
+    }
+}
+
+/* Poll until *pulCounter has moved past ulStart */
+static BaseType_t prvWaitCounter( volatile uint32_t * pulCounter,
+                                  uint32_t ulStart,
+                                  TickType_t xTimeout )
+{
+    TickType_t xStart = xTaskGetTickCount();
+
+    while( ( *pulCounter == ulStart ) &&
+           ( ( xTaskGetTickCount() - xStart ) < xTimeout ) )
+    {
+        vTaskDelay( pdMS_TO_TICKS( 1 ) );
+    }
+
+    return ( *pulCounter != ulStart ) ? pdTRUE : pdFALSE;
+}
+
+static BaseType_t prvWaitConnected( TickType_t xTimeout )
+{
+    EventBits_t uxBits = xEventGroupWaitBits( xSystemEvents, EVT_MASK_NET_CONNECTED,
+                                              pdFALSE, pdTRUE, xTimeout );
+
+    return ( uxBits & EVT_MASK_NET_CONNECTED ) ? pdTRUE : pdFALSE;
+}
+
+static void prvCheckCache( const uint8_t * pucBssid )
+{
+    MxFastConnectCache_t xRecord = { 0 };
+
+    TEST_CHECK( KVStore_getBlob( CS_WIFI_FAST_CONNECT, &xRecord, sizeof( xRecord ) ) == sizeof( xRecord ) );
+    TEST_CHECK( xRecord.ulMagic == MX_FAST_CONNECT_MAGIC );
+    TEST_CHECK( xRecord.ulSsidHash == ulMxReconnectHashSsid( "emu" ) );
+    TEST_CHECK( memcmp( xRecord.ucBssid, pucBssid, MX_BSSID_LEN ) == 0 );
+    TEST_CHECK( xRecord.ucChannel == 6 );
+    TEST_CHECK( xRecord.ulIpAddr == prvAddr( ucLeaseIp ) );
+}
+
+/* No cached access point yet, so net_main scans, then saves the access point and lease */
+static void prvTestFirstConnect( TickType_t xScanDelay )
+{
+    TickType_t xStart = xTaskGetTickCount();
+
+    TEST_CHECK( xEventGroupWaitBits( xSystemEvents, EVT_MASK_NET_INIT, pdFALSE, pdTRUE, TEST_TIMEOUT ) & EVT_MASK_NET_INIT );
+    TEST_CHECK( prvWaitConnected( xScanDelay + TEST_TIMEOUT ) == pdTRUE );
+
+    prvCheckCache( ucTestBssid );
+    TEST_CHECK( ulKvCommits > 0 );
+    TEST_CHECK( ulLeasesApplied == 0 );
+
+    TEST_CHECK( mx_GetMacAddress( &xModuleMac, TEST_TIMEOUT ) == IPC_SUCCESS );
+
+    printf( "first connect by scan: %lu ms\n", TICKS_TO_MS( xTaskGetTickCount() - xStart ) );
+}
+
+static void prvAsyncWorker( void * pvParameters )
+{
+    TestWorker_t * pxWorker = ( TestWorker_t * ) pvParameters;
+
+    /* Blocks on the request context semaphore while all contexts are in use */
+    for( uint32_t i = 0; i < TEST_ASYNC_PER_TASK; i++ )
+    {
+        TestRequest_t * pxRequest = &( pxWorker->xRequests[ i ] );
+
+        if( ( i % 2 ) == 0 )
+        {
+            prvIssueVersion( pxRequest, TEST_TIMEOUT );
+        }
+        else
+        {
+            pxRequest->xTask = xTaskGetCurrentTaskHandle();
+            TEST_CHECK( mx_GetMacAddressAsync( &( pxRequest->xMac ), prvRequestDone,
+                                               pxRequest, TEST_TIMEOUT ) == IPC_SUCCESS );
+        }
+    }
+
+    prvWaitCompletions( TEST_ASYNC_PER_TASK );
+
+    for( uint32_t i = 0; i < TEST_ASYNC_PER_TASK; i++ )
+    {
+        TestRequest_t * pxRequest = &( pxWorker->xRequests[ i ] );
+
+        TEST_CHECK( pxRequest->xResult == IPC_SUCCESS );
+        TEST_CHECK( pxRequest->ulCalls == 1 );
+
+        if( ( i % 2 ) == 0 )
+        {
+            TEST_CHECK( strncmp( pxRequest->cVersion, "EMU-", 4 ) == 0 );
+        }
+        else
+        {
+            TEST_CHECK( memcmp( &( pxRequest->xMac ), &xModuleMac, sizeof( xModuleMac ) ) == 0 );
+        }
+    }
+
+    /* The shim ends the thread when the task returns */
+    ( void ) xTaskNotifyGiveIndexed( pxWorker->xMainTask, TEST_NOTIFY_IDX );
+}
+
+static void prvTestConcurrentRequests( void )
+{
+    static TestWorker_t xWorkers[ TEST_ASYNC_TASKS ];
+    TickType_t xStart = xTaskGetTickCount();
+
+    for( uint32_t i = 0; i < TEST_ASYNC_TASKS; i++ )
+    {
+        xWorkers[ i ].xMainTask = xTaskGetCurrentTaskHandle();
+        TEST_CHECK( xTaskCreate( prvAsyncWorker, "Worker", 1024, &( xWorkers[ i ] ), 20, NULL ) == pdPASS );
+    }
+
+    prvWaitCompletions( TEST_ASYNC_TASKS );
+
+    printf( "%d asynchronous requests from %d tasks on %d contexts: %lu ms\n",
+            TEST_ASYNC_TASKS * TEST_ASYNC_PER_TASK, TEST_ASYNC_TASKS, NUM_IPC_REQUEST_CTX,
+            TICKS_TO_MS( xTaskGetTickCount() - xStart ) );
+}
+
+static void prvCheckTimedOut( const TestRequest_t * pxRequest )
+{
+    TickType_t xElapsed = pxRequest->xCompleted - pxRequest->xIssued;
+
+    TEST_CHECK( pxRequest->xResult == IPC_TIMEOUT );
+    TEST_CHECK( pxRequest->ulCalls == 1 );
+    TEST_CHECK( xElapsed >= pxRequest->xTimeout );
+    TEST_CHECK( xElapsed < pxRequest->xTimeout + TEST_TIMER_SLACK );
+}
+
+static void prvTestRequestTimeouts( void )
+{
+    /* Out of deadline order, and the longest past one rotation of the timer wheel */
+    const uint32_t ulTimeoutsMs[ NUM_IPC_REQUEST_CTX ] = { 300, 100, 1000, 200 };
+    TestRequest_t xSingle = { 0 };
+    TestRequest_t xRequests[ NUM_IPC_REQUEST_CTX ] = { 0 };
+    char cVersion[ MX_FIRMWARE_REVISION_SIZE ];
+    uint32_t ulFirst;
+
+    vHostShimControl( "hold" );
+
+    /* The router blocks without a timeout while no timers are pending, so this one must wake it */
+    prvIssueVersion( &xSingle, pdMS_TO_TICKS( 100 ) );
+    prvWaitCompletions( 1 );
+    prvCheckTimedOut( &xSingle );
+
+    ulFirst = ulCompletions;
+
+    for( uint32_t i = 0; i < NUM_IPC_REQUEST_CTX; i++ )
+    {
+        prvIssueVersion( &( xRequests[ i ] ), pdMS_TO_TICKS( ulTimeoutsMs[ i ] ) );
+    }
+
+    prvWaitCompletions( NUM_IPC_REQUEST_CTX );
+
+    for( uint32_t i = 0; i < NUM_IPC_REQUEST_CTX; i++ )
+    {
+        uint32_t ulEarlier = 0;
+
+        prvCheckTimedOut( &( xRequests[ i ] ) );
+
+        for( uint32_t j = 0; j < NUM_IPC_REQUEST_CTX; j++ )
+        {
+            ulEarlier += ( ulTimeoutsMs[ j ] < ulTimeoutsMs[ i ] ) ? 1 : 0;
+        }
+
+        TEST_CHECK( xRequests[ i ].ulOrder == ulFirst + ulEarlier );
+    }
+
+    /* The responses arrive after their requests completed and are dropped */
+    vHostShimControl( "release" );
+    vTaskDelay( pdMS_TO_TICKS( 100 ) );
+
+    TEST_CHECK( xSingle.ulCalls == 1 );
+
+    for( uint32_t i = 0; i < NUM_IPC_REQUEST_CTX; i++ )
+    {
+        TEST_CHECK( xRequests[ i ].ulCalls == 1 );
+    }
+
+    TEST_CHECK( mx_RequestVersion( cVersion, sizeof( cVersion ), TEST_TIMEOUT ) == IPC_SUCCESS );
+
+    /* The dropped responses were freed, only buffers armed in the dataplane's receive ring remain */
+    TEST_CHECK( ulHostPbufPoolUsed() <= MX_RX_RING_LEN );
+
+    printf( "asynchronous timeouts of 100, 200, 300 and 1000 ms completed in deadline order\n" );
+}
+
+/* The access point drops the station, net_main reconnects to the cached BSSID without a scan */
+static void prvTestFastReconnect( TickType_t xScanDelay )
+{
+    uint32_t ulLinkUpsBefore = ulLinkUps;
+    uint32_t ulLeasesBefore = ulLeasesApplied;
+    TickType_t xStart = xTaskGetTickCount();
+    TickType_t xReconnect;
+
+    vHostShimControl( "drop" );
+
+    TEST_CHECK( prvWaitCounter( &ulLinkUps, ulLinkUpsBefore, xScanDelay + TEST_TIMEOUT ) == pdTRUE );
+    xReconnect = xLinkUpTime - xStart;
+    TEST_CHECK( xReconnect < xScanDelay );
+
+    /* The cached lease is in use before DHCP could have bound one */
+    TEST_CHECK( prvWaitCounter( &ulLeasesApplied, ulLeasesBefore, TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( ( xLeaseAppliedTime - xLinkUpTime ) < TEST_DHCP_DELAY );
+    TEST_CHECK( pxTestNetif->ip_addr.addr == prvAddr( ucLeaseIp ) );
+    TEST_CHECK( prvWaitConnected( TEST_TIMEOUT ) == pdTRUE );
+
+    prvCheckCache( ucTestBssid );
+
+    printf( "direct reconnect: link up after %lu ms, cached address after %lu ms\n",
+            TICKS_TO_MS( xReconnect ), TICKS_TO_MS( xLeaseAppliedTime - xStart ) );
+}
+
+/* The access point is replaced, the direct attempt times out and a scan finds the new one */
+static void prvTestMovedAccessPoint( TickType_t xScanDelay )
+{
+    uint32_t ulLinkUpsBefore = ulLinkUps;
+    uint32_t ulLeasesBefore = ulLeasesApplied;
+    TickType_t xStart = xTaskGetTickCount();
+    TickType_t xReconnect;
+    MxFastConnectCache_t xRecord;
+
+    vHostShimControl( "move" );
+    vHostShimControl( "drop" );
+
+    TEST_CHECK( prvWaitCounter( &ulLinkUps, ulLinkUpsBefore,
+                                pdMS_TO_TICKS( MX_FAST_CONNECT_TIMEOUT_MS ) + xScanDelay + TEST_TIMEOUT ) == pdTRUE );
+    xReconnect = xLinkUpTime - xStart;
+    TEST_CHECK( xReconnect >= pdMS_TO_TICKS( MX_FAST_CONNECT_TIMEOUT_MS ) + xScanDelay );
+
+    /* The new access point is cached once the link info has been read */
+    for( uint32_t i = 0; i < 100; i++ )
+    {
+        ( void ) KVStore_getBlob( CS_WIFI_FAST_CONNECT, &xRecord, sizeof( xRecord ) );
+
+        if( memcmp( xRecord.ucBssid, ucMovedBssid, MX_BSSID_LEN ) == 0 )
+        {
+            break;
+        }
+
+        vTaskDelay( pdMS_TO_TICKS( 10 ) );
+    }
+
+    prvCheckCache( ucMovedBssid );
+
+    /* The lease is only reused on the access point it was bound on */
+    TEST_CHECK( prvWaitConnected( TEST_TIMEOUT ) == pdTRUE );
+    TEST_CHECK( ulLeasesApplied == ulLeasesBefore );
+
+    printf( "replaced access point: link up after %lu ms\n", TICKS_TO_MS( xReconnect ) );
+}
+
+int main( int argc,
+          char ** argv )
+{
+    TickType_t xScanDelay;
+
+    if( argc != 3 )
+    {
+        fprintf( stderr, "usage: %s SOCKET SCAN_DELAY_MS\n", argv[ 0 ] );
+        return 1;
+    }
+
+    xScanDelay = pdMS_TO_TICKS( atoi( argv[ 2 ] ) );
+
+    TEST_CHECK( xHostShimConnect( argv[ 1 ], TEST_PIN_NSS, TEST_PIN_FLOW, TEST_PIN_NOTIFY ) == pdTRUE );
+
+    xSystemEvents = xEventGroupCreate();
+    xKvMutex = xSemaphoreCreateMutex();
+    xLwipMutex = xSemaphoreCreateMutex();
+
+    TEST_CHECK( xTaskCreate( prvDhcpServerTask, "Dhcp", 1024, NULL, 20, &xDhcpTask ) == pdPASS );
+    TEST_CHECK( xTaskCreate( net_main, "MxNet", 4096, NULL, 23, NULL ) == pdPASS );
+
+    prvTestFirstConnect( xScanDelay );
+    prvTestConcurrentRequests();
+    prvTestRequestTimeouts();
+    prvTestFastReconnect( xScanDelay );
+    prvTestMovedAccessPoint( xScanDelay );
+
+    printf( "netconn test passed\n" );
+
+    return 0;
+}
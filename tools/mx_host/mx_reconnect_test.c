@@ -0,0 +1,314 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Drive the fast reconnect state machine in Common/net/mxchip/mx_reconnect.c with scripted
+ * module events: each step is the event the module reports, the way net_main forwards it, and
+ * the action the state machine must answer with.
+ *
+ * Usage: mx_reconnect_test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mx_reconnect.h"
+
+#define TEST_CHECK( x )                                                                    \
+    do {                                                                                   \
+        if( !( x ) )                                                                       \
+        {                                                                                  \
+            fprintf( stderr, "Assertion failed: %s (%s:%d)\n", #x, __FILE__, __LINE__ ); \
+            abort();                                                                       \
+        }                                                                                  \
+    } while( 0 )
+
+#define TEST_SSID          "emu"
+#define TEST_IP_ADDR       0x3200A8C0UL /* 192.168.0.50 */
+#define TEST_NETMASK       0x00FFFFFFUL /* 255.255.255.0 */
+#define TEST_GATEWAY       0x0100A8C0UL /* 192.168.0.1 */
+#define TEST_CHANNEL       6
+#define TEST_SECURITY      4
+
+#define TEST_STEPS( x )    ( sizeof( x ) / sizeof( ( x )[ 0 ] ) )
+
+typedef struct
+{
+    MxReconnectEvent_t xEvent;
+    MxReconnectActionType_t xType;
+    uint32_t ulTimeoutMs;
+    bool xDisconnectFirst;
+} TestStep_t;
+
+static const uint8_t ucCachedBssid[ MX_FAST_CONNECT_BSSID_LEN ] = { 0x02, 0xa0, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t ucMovedBssid[ MX_FAST_CONNECT_BSSID_LEN ] = { 0x02, 0xa0, 0x00, 0x00, 0x00, 0x02 };
+
+/* The steps shared by the cases: a connection by either path and the module's answers */
+#define STEP_START_DIRECT    { MX_RECONNECT_EVT_START, MX_RECONNECT_ACT_CONNECT_DIRECT, MX_FAST_CONNECT_TIMEOUT_MS, false }
+#define STEP_START_SCAN      { MX_RECONNECT_EVT_START, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, false }
+#define STEP_LINK_UP         { MX_RECONNECT_EVT_LINK_UP, MX_RECONNECT_ACT_NONE, 0, false }
+#define STEP_DIRECT_FAILED   { MX_RECONNECT_EVT_FAILED, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, true }
+#define STEP_SCAN_FAILED( ulBackoffMs ) \
+    { MX_RECONNECT_EVT_FAILED, MX_RECONNECT_ACT_WAIT, ( ulBackoffMs ), false }
+#define STEP_RETRY_DIRECT    { MX_RECONNECT_EVT_TIMEOUT, MX_RECONNECT_ACT_CONNECT_DIRECT, MX_FAST_CONNECT_TIMEOUT_MS, false }
+#define STEP_RETRY_SCAN      { MX_RECONNECT_EVT_TIMEOUT, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, false }
+
+static void prvRunSteps( MxReconnectCtx_t * pxCtx,
+                         const TestStep_t * pxSteps,
+                         size_t xStepCount )
+{
+    for( size_t xStep = 0; xStep < xStepCount; xStep++ )
+    {
+        MxReconnectAction_t xAction = xMxReconnectHandleEvent( pxCtx, pxSteps[ xStep ].xEvent );
+
+        if( ( xAction.xType != pxSteps[ xStep ].xType ) ||
+            ( xAction.ulTimeoutMs != pxSteps[ xStep ].ulTimeoutMs ) ||
+            ( xAction.xDisconnectFirst != pxSteps[ xStep ].xDisconnectFirst ) )
+        {
+            fprintf( stderr, "step %zu, event %d: action %d, %u ms, disconnect %d, expected %d, %u ms, disconnect %d\n",
+                     xStep, ( int ) pxSteps[ xStep ].xEvent,
+                     ( int ) xAction.xType, ( unsigned ) xAction.ulTimeoutMs, ( int ) xAction.xDisconnectFirst,
+                     ( int ) pxSteps[ xStep ].xType, ( unsigned ) pxSteps[ xStep ].ulTimeoutMs,
+                     ( int ) pxSteps[ xStep ].xDisconnectFirst );
+            abort();
+        }
+    }
+}
+
+/* Record persisted by a previous connection to ucCachedBssid */
+static void prvStoredRecord( MxFastConnectCache_t * pxRecord )
+{
+    ( void ) memset( pxRecord, 0, sizeof( MxFastConnectCache_t ) );
+    pxRecord->ulMagic = MX_FAST_CONNECT_MAGIC;
+    pxRecord->ulSsidHash = ulMxReconnectHashSsid( TEST_SSID );
+    ( void ) memcpy( pxRecord->ucBssid, ucCachedBssid, MX_FAST_CONNECT_BSSID_LEN );
+    pxRecord->ucChannel = TEST_CHANNEL;
+    pxRecord->ucSecurity = TEST_SECURITY;
+    pxRecord->ulIpAddr = TEST_IP_ADDR;
+    pxRecord->ulNetmask = TEST_NETMASK;
+    pxRecord->ulGateway = TEST_GATEWAY;
+}
+
+static void prvInitStored( MxReconnectCtx_t * pxCtx )
+{
+    MxFastConnectCache_t xStored;
+
+    prvStoredRecord( &xStored );
+    vMxReconnectInit( pxCtx, &xStored, sizeof( xStored ), ulMxReconnectHashSsid( TEST_SSID ) );
+}
+
+/* Only a record of the current layout, for the configured SSID, is used */
+static void prvTestStoredRecord( void )
+{
+    MxReconnectCtx_t xCtx;
+    MxFastConnectCache_t xStored;
+    const TestStep_t xSteps[] = { STEP_START_SCAN };
+
+    vMxReconnectInit( &xCtx, NULL, 0, ulMxReconnectHashSsid( TEST_SSID ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    prvStoredRecord( &xStored );
+    vMxReconnectInit( &xCtx, &xStored, sizeof( xStored ) - 1, ulMxReconnectHashSsid( TEST_SSID ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    vMxReconnectInit( &xCtx, &xStored, sizeof( xStored ), ulMxReconnectHashSsid( "other" ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    xStored.ulMagic++;
+    vMxReconnectInit( &xCtx, &xStored, sizeof( xStored ), ulMxReconnectHashSsid( TEST_SSID ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    /* The zeroed record written when the cache is dropped */
+    ( void ) memset( &xStored, 0, sizeof( xStored ) );
+    vMxReconnectInit( &xCtx, &xStored, sizeof( xStored ), ulMxReconnectHashSsid( TEST_SSID ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    printf( "stored record: only a matching record is used\n" );
+}
+
+/* The cached access point answers: no scan, and the cached lease is used until DHCP confirms it */
+static void prvTestDirectSuccess( void )
+{
+    MxReconnectCtx_t xCtx;
+    MxFastConnectCache_t xRecord;
+    uint32_t ulIpAddr = 0;
+    uint32_t ulNetmask = 0;
+    uint32_t ulGateway = 0;
+    const TestStep_t xConnect[] = { STEP_START_DIRECT, STEP_LINK_UP };
+    const TestStep_t xReconnect[] =
+    {
+        { MX_RECONNECT_EVT_LINK_DOWN, MX_RECONNECT_ACT_CONNECT_DIRECT, MX_FAST_CONNECT_TIMEOUT_MS, false },
+        STEP_LINK_UP
+    };
+
+    prvInitStored( &xCtx );
+    prvRunSteps( &xCtx, xConnect, TEST_STEPS( xConnect ) );
+    TEST_CHECK( xCtx.xState == MX_RECONNECT_CONNECTED );
+
+    TEST_CHECK( xMxReconnectTakeLease( &xCtx, &ulIpAddr, &ulNetmask, &ulGateway ) );
+    TEST_CHECK( ulIpAddr == TEST_IP_ADDR );
+    TEST_CHECK( ulNetmask == TEST_NETMASK );
+    TEST_CHECK( ulGateway == TEST_GATEWAY );
+    TEST_CHECK( xMxReconnectTakeLease( &xCtx, &ulIpAddr, &ulNetmask, &ulGateway ) == false );
+
+    /* The same access point and lease reported again leave the persisted record alone */
+    vMxReconnectUpdateLink( &xCtx, ucCachedBssid, TEST_CHANNEL, TEST_SECURITY );
+    vMxReconnectUpdateLease( &xCtx, TEST_IP_ADDR, TEST_NETMASK, TEST_GATEWAY );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) == false );
+
+    /* A renewed lease with a new address is persisted */
+    vMxReconnectUpdateLease( &xCtx, TEST_IP_ADDR + 0x01000000UL, TEST_NETMASK, TEST_GATEWAY );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) );
+    TEST_CHECK( xRecord.ulIpAddr == TEST_IP_ADDR + 0x01000000UL );
+    TEST_CHECK( memcmp( xRecord.ucBssid, ucCachedBssid, MX_FAST_CONNECT_BSSID_LEN ) == 0 );
+
+    /* Losing the link goes straight back to the cached access point */
+    prvRunSteps( &xCtx, xReconnect, TEST_STEPS( xReconnect ) );
+    TEST_CHECK( xMxReconnectTakeLease( &xCtx, &ulIpAddr, &ulNetmask, &ulGateway ) );
+    TEST_CHECK( ulIpAddr == TEST_IP_ADDR + 0x01000000UL );
+
+    printf( "direct success: connected without a scan, cached lease handed out once\n" );
+}
+
+/* The cached access point does not answer: scan at once, and cache the access point found */
+static void prvTestDirectFailure( void )
+{
+    MxReconnectCtx_t xCtx;
+    MxFastConnectCache_t xRecord;
+    uint32_t ulIpAddr = 0;
+    uint32_t ulNetmask = 0;
+    uint32_t ulGateway = 0;
+    const TestStep_t xSteps[] = { STEP_START_DIRECT, STEP_DIRECT_FAILED, STEP_LINK_UP };
+
+    prvInitStored( &xCtx );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+    TEST_CHECK( xCtx.xState == MX_RECONNECT_CONNECTED );
+
+    /* The lease was bound on another access point, DHCP has to run */
+    TEST_CHECK( xMxReconnectTakeLease( &xCtx, &ulIpAddr, &ulNetmask, &ulGateway ) == false );
+
+    /* A single failure keeps the cache until the scan tells where the network went */
+    TEST_CHECK( xCtx.xCacheValid );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) == false );
+
+    vMxReconnectUpdateLink( &xCtx, ucMovedBssid, TEST_CHANNEL + 5, TEST_SECURITY );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) );
+    TEST_CHECK( xRecord.ulMagic == MX_FAST_CONNECT_MAGIC );
+    TEST_CHECK( xRecord.ulSsidHash == ulMxReconnectHashSsid( TEST_SSID ) );
+    TEST_CHECK( memcmp( xRecord.ucBssid, ucMovedBssid, MX_FAST_CONNECT_BSSID_LEN ) == 0 );
+    TEST_CHECK( xRecord.ucChannel == TEST_CHANNEL + 5 );
+    TEST_CHECK( xCtx.ulDirectFailures == 0 );
+
+    printf( "direct failure: scanned at once, new access point cached\n" );
+}
+
+/* Two direct attempts in a row fail: the cache is dropped and written back as a zeroed record */
+static void prvTestCacheInvalidation( void )
+{
+    MxReconnectCtx_t xCtx;
+    MxFastConnectCache_t xRecord;
+    MxFastConnectCache_t xZero;
+    const TestStep_t xSteps[] =
+    {
+        STEP_START_DIRECT,
+        STEP_DIRECT_FAILED,
+        STEP_SCAN_FAILED( MX_RECONNECT_BACKOFF_MIN_MS ),
+        STEP_RETRY_DIRECT,
+        /* The module reporting the station down during the attempt is a failure too */
+        { MX_RECONNECT_EVT_LINK_DOWN, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, true },
+    };
+    const TestStep_t xAfter[] =
+    {
+        STEP_SCAN_FAILED( 2 * MX_RECONNECT_BACKOFF_MIN_MS ),
+        STEP_RETRY_SCAN,
+        STEP_LINK_UP,
+        { MX_RECONNECT_EVT_LINK_DOWN, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, false }
+    };
+
+    prvInitStored( &xCtx );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    TEST_CHECK( xCtx.xCacheValid == false );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) );
+    ( void ) memset( &xZero, 0, sizeof( xZero ) );
+    TEST_CHECK( memcmp( &xRecord, &xZero, sizeof( xRecord ) ) == 0 );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) == false );
+
+    /* Without a cache every attempt scans, and a lease alone is not worth persisting */
+    prvRunSteps( &xCtx, xAfter, TEST_STEPS( xAfter ) );
+    vMxReconnectUpdateLease( &xCtx, TEST_IP_ADDR, TEST_NETMASK, TEST_GATEWAY );
+    TEST_CHECK( xMxReconnectTakeDirty( &xCtx, &xRecord ) == false );
+
+    printf( "cache invalidation: dropped after %d direct failures\n", MX_FAST_CONNECT_MAX_FAILURES );
+}
+
+/* Failed scans back off exponentially up to the limit, a connection resets the backoff */
+static void prvTestScanBackoff( void )
+{
+    MxReconnectCtx_t xCtx;
+    const TestStep_t xSteps[] =
+    {
+        STEP_START_SCAN,
+        STEP_SCAN_FAILED( 1000 ),
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( 2000 ),
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( 4000 ),
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( 8000 ),
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( 16000 ),
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( MX_RECONNECT_BACKOFF_MAX_MS ),
+        /* Events the wait does not expect change nothing */
+        { MX_RECONNECT_EVT_FAILED, MX_RECONNECT_ACT_NONE, 0, false },
+        { MX_RECONNECT_EVT_START, MX_RECONNECT_ACT_NONE, 0, false },
+        STEP_RETRY_SCAN,
+        STEP_SCAN_FAILED( MX_RECONNECT_BACKOFF_MAX_MS ),
+        STEP_RETRY_SCAN,
+        STEP_LINK_UP,
+        { MX_RECONNECT_EVT_TIMEOUT, MX_RECONNECT_ACT_NONE, 0, false },
+        { MX_RECONNECT_EVT_LINK_DOWN, MX_RECONNECT_ACT_CONNECT_SCAN, MX_RECONNECT_SCAN_TIMEOUT_MS, false },
+        STEP_SCAN_FAILED( MX_RECONNECT_BACKOFF_MIN_MS )
+    };
+
+    vMxReconnectInit( &xCtx, NULL, 0, ulMxReconnectHashSsid( TEST_SSID ) );
+    prvRunSteps( &xCtx, xSteps, TEST_STEPS( xSteps ) );
+
+    printf( "scan backoff: doubled up to %d ms, reset by a connection\n", MX_RECONNECT_BACKOFF_MAX_MS );
+}
+
+int main( void )
+{
+    prvTestStoredRecord();
+    prvTestDirectSuccess();
+    prvTestDirectFailure();
+    prvTestCacheInvalidation();
+    prvTestScanBackoff();
+
+    printf( "reconnect test passed\n" );
+
+    return 0;
+}
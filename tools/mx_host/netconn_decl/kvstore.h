@@ -0,0 +1,26 @@
+/* Keys and accessors of Common/kvstore/kvstore.h used by mx_netconn.c, backed by the test */
+#ifndef MX_HOST_KVSTORE_H
+#define MX_HOST_KVSTORE_H
+
+#include "FreeRTOS.h"
+
+typedef enum KvStoreEnum
+{
+    CS_WIFI_SSID,
+    CS_WIFI_CREDENTIAL,
+    CS_WIFI_FAST_CONNECT,
+    CS_NUM_KEYS
+} KVStoreKey_t;
+
+size_t KVStore_getBlob( KVStoreKey_t key,
+                        void * pvBuffer,
+                        size_t xMaxLength );
+BaseType_t KVStore_setBlob( KVStoreKey_t key,
+                            size_t xLength,
+                            const void * pvNewValue );
+size_t KVStore_getString( KVStoreKey_t key,
+                          char * pvBuffer,
+                          size_t xMaxLength );
+BaseType_t KVStore_xCommitKey( KVStoreKey_t xKey );
+
+#endif /* MX_HOST_KVSTORE_H */
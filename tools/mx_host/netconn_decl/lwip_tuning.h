@@ -0,0 +1,7 @@
+/* Host shim for Common/net/lwip_port/include/lwip_tuning.h */
+#ifndef MX_HOST_LWIP_TUNING_H
+#define MX_HOST_LWIP_TUNING_H
+
+void vLwipTuningInit( void );
+
+#endif /* MX_HOST_LWIP_TUNING_H */
@@ -0,0 +1,18 @@
+/* Host shim for Common/boards/stm32u5_iot_board.h, the pin map is defined by the test */
+#ifndef MX_HOST_STM32U5_IOT_BOARD_H
+#define MX_HOST_STM32U5_IOT_BOARD_H
+
+#include "iot_gpio_stm32_prv.h"
+
+typedef enum GpioPin
+{
+    GPIO_MX_FLOW,
+    GPIO_MX_RESET,
+    GPIO_MX_NSS,
+    GPIO_MX_NOTIFY,
+    GPIO_MAX
+} GpioPin_t;
+
+extern const IotMappedPin_t xGpioMap[ GPIO_MAX ];
+
+#endif /* MX_HOST_STM32U5_IOT_BOARD_H */
@@ -0,0 +1,14 @@
+/* Host shim for netif/ethernet.h */
+#ifndef MX_HOST_NETIF_ETHERNET_H
+#define MX_HOST_NETIF_ETHERNET_H
+
+#include "lwip/pbuf.h"
+
+#define ETH_HWADDR_LEN    6
+
+struct eth_addr
+{
+    uint8_t addr[ ETH_HWADDR_LEN ];
+};
+
+#endif /* MX_HOST_NETIF_ETHERNET_H */
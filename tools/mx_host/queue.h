@@ -0,0 +1,7 @@
+/* Host shim: the kernel API lives in FreeRTOS.h */
+#ifndef MX_HOST_QUEUE_H
+#define MX_HOST_QUEUE_H
+
+#include "FreeRTOS.h"
+
+#endif /* MX_HOST_QUEUE_H */
@@ -0,0 +1,67 @@
+/*
+ * Host shim for the parts of the STM32U5 HAL used by the MXCHIP dataplane. SPI transfers and
+ * GPIO levels are forwarded to tools/mx_emulator.py, see mx_host_shim.c.
+ */
+#ifndef MX_HOST_STM32U5XX_HAL_H
+#define MX_HOST_STM32U5XX_HAL_H
+
+#include <stdint.h>
+
+typedef enum
+{
+    HAL_OK = 0x00,
+    HAL_ERROR = 0x01,
+    HAL_BUSY = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+typedef struct
+{
+    uint32_t ulUnused;
+} GPIO_TypeDef;
+
+void HAL_GPIO_WritePin( GPIO_TypeDef * GPIOx,
+                        uint16_t GPIO_Pin,
+                        GPIO_PinState PinState );
+GPIO_PinState HAL_GPIO_ReadPin( GPIO_TypeDef * GPIOx,
+                                uint16_t GPIO_Pin );
+
+typedef enum
+{
+    HAL_SPI_TX_COMPLETE_CB_ID = 0x00,
+    HAL_SPI_RX_COMPLETE_CB_ID = 0x01,
+    HAL_SPI_TX_RX_COMPLETE_CB_ID = 0x02,
+    HAL_SPI_ERROR_CB_ID = 0x06
+} HAL_SPI_CallbackIDTypeDef;
+
+typedef struct __SPI_HandleTypeDef
+{
+    void ( * TxCpltCallback )( struct __SPI_HandleTypeDef * hspi );
+    void ( * RxCpltCallback )( struct __SPI_HandleTypeDef * hspi );
+    void ( * TxRxCpltCallback )( struct __SPI_HandleTypeDef * hspi );
+    void ( * ErrorCallback )( struct __SPI_HandleTypeDef * hspi );
+} SPI_HandleTypeDef;
+
+typedef void ( * pSPI_CallbackTypeDef )( SPI_HandleTypeDef * hspi );
+
+HAL_StatusTypeDef HAL_SPI_RegisterCallback( SPI_HandleTypeDef * hspi,
+                                            HAL_SPI_CallbackIDTypeDef CallbackID,
+                                            pSPI_CallbackTypeDef pCallback );
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA( SPI_HandleTypeDef * hspi,
+                                        const uint8_t * pData,
+                                        uint16_t Size );
+HAL_StatusTypeDef HAL_SPI_Receive_DMA( SPI_HandleTypeDef * hspi,
+                                       uint8_t * pData,
+                                       uint16_t Size );
+HAL_StatusTypeDef HAL_SPI_TransmitReceive_DMA( SPI_HandleTypeDef * hspi,
+                                               const uint8_t * pTxData,
+                                               uint8_t * pRxData,
+                                               uint16_t Size );
+
+#endif /* MX_HOST_STM32U5XX_HAL_H */
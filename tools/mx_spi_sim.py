@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+"""Model the SPI link between the STM32U5 and the MXCHIP EMW3080 module.
+
+Compares the legacy dataplane, which moves one frame per chip select window,
+with the multi-frame mode of Common/net/mxchip/mx_dataplane.c
+(MX_SPI_MULTI_FRAME), which packs several length prefixed frames into one
+transaction. The transaction model follows vDataplaneThread: NSS low, flow
+wait, header exchange, flow wait, payload DMA, NSS high.
+
+Usage:
+    mx_spi_sim.py run [--frames N] [--size BYTES] [--rx-ratio R]
+    mx_spi_sim.py selftest
+"""
+import argparse
+import random
+import struct
+
+MX_MAX_MESSAGE_LEN = 4096
+MX_SPI_MAX_FRAMES = 8
+MX_SPI_FRAME_PREFIX_LEN = 2
+MX_SPI_CAPS_MAGIC = 0xC5
+MX_SPI_CAP_MULTI_FRAME = 0x01
+MX_SPI_WRITE = 0x0A
+MX_SPI_READ = 0x0B
+
+# SPIHeader_t: type, len, lenx, ucFrames, ucCapsMagic, ucCaps
+SPI_HEADER = struct.Struct("<BHHBBB")
+
+
+class LinkModel:
+    """Timing parameters of one SPI transaction, in seconds."""
+
+    def __init__(self, args):
+        self.bit_time = 1.0 / args.clock
+        self.flow_latency = args.flow_us * 1e-6
+        self.dma_setup = args.dma_us * 1e-6
+        self.nss_idle = args.nss_us * 1e-6
+        self.copy_rate = args.copy_mbps * 1e6 / 8
+
+    def transfer(self, nbytes):
+        return self.dma_setup + nbytes * 8 * self.bit_time
+
+    def transaction(self, tx_len, rx_len, packed):
+        """Time spent with NSS low plus the idle gap before the next window."""
+        t = self.nss_idle + self.flow_latency
+        t += self.transfer(SPI_HEADER.size)
+        t += self.flow_latency
+        payload = max(tx_len, rx_len)
+        if payload:
+            t += self.transfer(payload)
+        if packed:
+            t += (tx_len + rx_len) / self.copy_rate
+        return t
+
+
+def pack_header(msg_type, length, frames, caps=True):
+    return SPI_HEADER.pack(msg_type, length, ~length & 0xFFFF, frames,
+                           MX_SPI_CAPS_MAGIC if caps else 0,
+                           MX_SPI_CAP_MULTI_FRAME if caps else 0)
+
+
+def unpack_header(data):
+    msg_type, length, lenx, frames, magic, caps = SPI_HEADER.unpack(data)
+    if length ^ lenx != 0xFFFF:
+        raise ValueError("length check failed")
+    multi = magic == MX_SPI_CAPS_MAGIC and caps & MX_SPI_CAP_MULTI_FRAME
+    return msg_type, length, frames if multi and frames > 1 else 0, bool(multi)
+
+
+def pack_frames(frames):
+    out = bytearray()
+    for frame in frames:
+        out += struct.pack("<H", len(frame)) + frame
+    if len(out) >= MX_MAX_MESSAGE_LEN:
+        raise ValueError("packed payload too long")
+    return bytes(out)
+
+
+def unpack_frames(payload, count):
+    frames = []
+    offset = 0
+    while len(frames) < count and offset + MX_SPI_FRAME_PREFIX_LEN <= len(payload):
+        (length,) = struct.unpack_from("<H", payload, offset)
+        offset += MX_SPI_FRAME_PREFIX_LEN
+        if length == 0 or offset + length > len(payload):
+            break
+        frames.append(payload[offset:offset + length])
+        offset += length
+    if len(frames) != count or offset != len(payload):
+        raise ValueError("malformed packed payload")
+    return frames
+
+
+def take_batch(queue, multi):
+    """Mirror prvDequeueTxFrames: pack frames while they fit in one message."""
+    batch = []
+    packed_len = 0
+    limit = MX_SPI_MAX_FRAMES if multi else 1
+    while queue and len(batch) < limit:
+        need = MX_SPI_FRAME_PREFIX_LEN + queue[0]
+        if batch and packed_len + need >= MX_MAX_MESSAGE_LEN:
+            break
+        packed_len += need
+        batch.append(queue.pop(0))
+    if len(batch) == 1:
+        packed_len = batch[0]
+    return batch, packed_len
+
+
+def simulate(link, tx_sizes, rx_sizes, multi):
+    tx_queue = list(tx_sizes)
+    rx_queue = list(rx_sizes)
+    elapsed = 0.0
+    transactions = 0
+    payload_bytes = 0
+    while tx_queue or rx_queue:
+        tx_batch, tx_len = take_batch(tx_queue, multi)
+        rx_batch, rx_len = take_batch(rx_queue, multi)
+        packed = len(tx_batch) > 1 or len(rx_batch) > 1
+        elapsed += link.transaction(tx_len, rx_len, packed)
+        transactions += 1
+        payload_bytes += sum(tx_batch) + sum(rx_batch)
+    frames = len(tx_sizes) + len(rx_sizes)
+    return {
+        "transactions": transactions,
+        "frames_per_s": frames / elapsed,
+        "mbit_per_s": payload_bytes * 8 / elapsed / 1e6,
+        "frames_per_txn": frames / transactions,
+    }
+
+
+def cmd_run(args):
+    rng = random.Random(args.seed)
+    link = LinkModel(args)
+    n_rx = int(args.frames * args.rx_ratio)
+    n_tx = args.frames - n_rx
+
+    def size():
+        return args.size if args.size else rng.choice((60, 90, 590, 1514))
+
+    tx_sizes = [size() for _ in range(n_tx)]
+    rx_sizes = [size() for _ in range(n_rx)]
+
+    print("{:<8} {:>12} {:>12} {:>10} {:>12}".format(
+        "mode", "transactions", "frames/s", "Mbit/s", "frames/txn"))
+    for name, multi in (("legacy", False), ("multi", True)):
+        r = simulate(link, tx_sizes, rx_sizes, multi)
+        print("{:<8} {:>12} {:>12.0f} {:>10.2f} {:>12.2f}".format(
+            name, r["transactions"], r["frames_per_s"], r["mbit_per_s"],
+            r["frames_per_txn"]))
+
+
+def cmd_selftest(args):
+    rng = random.Random(1)
+    for _ in range(1000):
+        count = rng.randint(2, MX_SPI_MAX_FRAMES)
+        frames = [bytes(rng.getrandbits(8) for _ in range(rng.randint(1, 400)))
+                  for _ in range(count)]
+        payload = pack_frames(frames)
+        header = pack_header(MX_SPI_READ, len(payload), count)
+        assert len(header) == 8
+        msg_type, length, rx_frames, multi = unpack_header(header)
+        assert (msg_type, length, rx_frames, multi) == (MX_SPI_READ, len(payload), count, True)
+        assert unpack_frames(payload, count) == frames
+        for bad in (payload[:-1], payload + b"\0"):
+            try:
+                unpack_frames(bad, count)
+            except ValueError:
+                pass
+            else:
+                raise AssertionError("truncated payload accepted")
+
+    # A legacy module leaves the trailing header bytes zero
+    assert unpack_header(pack_header(MX_SPI_READ, 100, 3, caps=False))[2:] == (0, False)
+
+    # Batching never exceeds a single message
+    queue = [1514] * 10
+    batch, length = take_batch(queue, True)
+    assert len(batch) == 2 and length < MX_MAX_MESSAGE_LEN
+    print("selftest passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    run = sub.add_parser("run", help="compare legacy and multi-frame throughput")
+    run.add_argument("--frames", type=int, default=10000)
+    run.add_argument("--size", type=int, default=0,
+                     help="fixed frame size, default is a mix of 60..1514 bytes")
+    run.add_argument("--rx-ratio", type=float, default=0.8,
+                     help="fraction of frames received from the module")
+    run.add_argument("--clock", type=float, default=20e6, help="SPI clock in Hz")
+    run.add_argument("--flow-us", type=float, default=30.0,
+                     help="module latency before raising the flow pin")
+    run.add_argument("--dma-us", type=float, default=8.0, help="DMA setup and completion overhead")
+    run.add_argument("--nss-us", type=float, default=5.0, help="idle time between transactions")
+    run.add_argument("--copy-mbps", type=float, default=400.0,
+                     help="memcpy rate for packing and unpacking frames")
+    run.add_argument("--seed", type=int, default=0)
+    run.set_defaults(func=cmd_run)
+
+    selftest = sub.add_parser("selftest", help="check the framing against the C layout")
+    selftest.set_defaults(func=cmd_selftest)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
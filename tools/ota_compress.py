@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+"""Compress firmware images for OTA updates of the b_u585i_iot02a_ntz project.
+
+Images are written as standard LZ4 frames, decoded on the device by
+Projects/b_u585i_iot02a_ntz/Src/ota_pal/ota_lz4.c. Frames produced by the lz4
+command line tool (lz4 -9 --content-size) are accepted by the device as well.
+
+Usage:
+    ota_compress.py compress <image> <image.lz4>
+    ota_compress.py decompress <image.lz4> <image>
+    ota_compress.py selftest [image ...]
+"""
+import argparse
+import random
+import struct
+import sys
+
+FRAME_MAGIC = 0x184D2204
+
+FLG_VERSION = 0x40
+FLG_BLOCK_INDEPENDENT = 0x20
+FLG_BLOCK_CHECKSUM = 0x10
+FLG_CONTENT_SIZE = 0x08
+FLG_CONTENT_CHECKSUM = 0x04
+FLG_DICT_ID = 0x01
+
+BLOCK_UNCOMPRESSED = 0x80000000
+BLOCK_MAX_SIZES = {4: 64 * 1024, 5: 256 * 1024, 6: 1024 * 1024, 7: 4 * 1024 * 1024}
+
+# Block size used when compressing: BD 4 (64 KB blocks), linked blocks.
+BLOCK_SIZE_ID = 4
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+# A match may not start within the last MFLIMIT bytes of a block, and the last
+# LAST_LITERALS bytes of a block are always literals.
+MFLIMIT = 12
+LAST_LITERALS = 5
+
+PRIME32_1 = 2654435761
+PRIME32_2 = 2246822519
+PRIME32_3 = 3266489917
+PRIME32_4 = 668265263
+PRIME32_5 = 374761393
+MASK32 = 0xFFFFFFFF
+
+
+class Lz4Error(Exception):
+    pass
+
+
+def _rotl32(value, count):
+    return ((value << count) | (value >> (32 - count))) & MASK32
+
+
+def xxh32(data, seed=0):
+    """xxHash32, used for the LZ4 frame header and content checksums."""
+    length = len(data)
+    pos = 0
+    if length >= 16:
+        v = [
+            (seed + PRIME32_1 + PRIME32_2) & MASK32,
+            (seed + PRIME32_2) & MASK32,
+            seed & MASK32,
+            (seed - PRIME32_1) & MASK32,
+        ]
+        stripes = length - length % 16
+        for i, lane in enumerate(struct.unpack_from("<{}I".format(stripes // 4), data)):
+            v[i & 3] = (_rotl32((v[i & 3] + lane * PRIME32_2) & MASK32, 13) * PRIME32_1) & MASK32
+        pos = stripes
+        h = (_rotl32(v[0], 1) + _rotl32(v[1], 7) + _rotl32(v[2], 12) + _rotl32(v[3], 18)) & MASK32
+    else:
+        h = (seed + PRIME32_5) & MASK32
+    h = (h + length) & MASK32
+    while pos + 4 <= length:
+        (lane,) = struct.unpack_from("<I", data, pos)
+        h = (_rotl32((h + lane * PRIME32_3) & MASK32, 17) * PRIME32_4) & MASK32
+        pos += 4
+    while pos < length:
+        h = (_rotl32((h + data[pos] * PRIME32_5) & MASK32, 11) * PRIME32_1) & MASK32
+        pos += 1
+    h ^= h >> 15
+    h = (h * PRIME32_2) & MASK32
+    h ^= h >> 13
+    h = (h * PRIME32_3) & MASK32
+    h ^= h >> 16
+    return h
+
+
+def _encode_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def _match_length(data, a_pos, b_pos, limit):
+    length = 0
+    step = 256
+    while length < limit:
+        n = min(step, limit - length)
+        if data[a_pos + length : a_pos + length + n] == data[b_pos + length : b_pos + length + n]:
+            length += n
+        elif n == 1:
+            break
+        else:
+            step = max(1, n // 2)
+    return length
+
+
+def compress_block(data, start, end, table):
+    """Greedy LZ4 block encoding of data[start:end]. Matches may reach into earlier blocks."""
+    out = bytearray()
+    anchor = start
+    pos = start
+    match_limit = end - MFLIMIT
+
+    while pos < match_limit:
+        key = data[pos : pos + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is None or pos - candidate > MAX_OFFSET:
+            pos += 1
+            continue
+
+        length = MIN_MATCH + _match_length(
+            data, candidate + MIN_MATCH, pos + MIN_MATCH, end - LAST_LITERALS - pos - MIN_MATCH
+        )
+        literal_length = pos - anchor
+        match_code = length - MIN_MATCH
+        out.append((min(literal_length, 15) << 4) | min(match_code, 15))
+        if literal_length >= 15:
+            _encode_length(out, literal_length - 15)
+        out += data[anchor:pos]
+        out += struct.pack("<H", pos - candidate)
+        if match_code >= 15:
+            _encode_length(out, match_code - 15)
+        pos += length
+        anchor = pos
+
+    literal_length = end - anchor
+    out.append(min(literal_length, 15) << 4)
+    if literal_length >= 15:
+        _encode_length(out, literal_length - 15)
+    out += data[anchor:end]
+    return bytes(out)
+
+
+def compress(data):
+    flags = FLG_VERSION | FLG_CONTENT_SIZE | FLG_CONTENT_CHECKSUM
+    descriptor = struct.pack("<BBQ", flags, BLOCK_SIZE_ID << 4, len(data))
+    frame = bytearray(struct.pack("<I", FRAME_MAGIC))
+    frame += descriptor
+    frame.append((xxh32(descriptor) >> 8) & 0xFF)
+
+    block_size = BLOCK_MAX_SIZES[BLOCK_SIZE_ID]
+    table = {}
+    for start in range(0, len(data), block_size):
+        end = min(start + block_size, len(data))
+        block = compress_block(data, start, end, table)
+        if len(block) < end - start:
+            frame += struct.pack("<I", len(block)) + block
+        else:
+            frame += struct.pack("<I", (end - start) | BLOCK_UNCOMPRESSED) + data[start:end]
+
+    frame += struct.pack("<II", 0, xxh32(data))
+    return bytes(frame)
+
+
+def _read(data, pos, length):
+    if pos + length > len(data):
+        raise Lz4Error("frame is truncated")
+    return data[pos : pos + length], pos + length
+
+
+def _decode_length(data, pos, length):
+    while True:
+        (byte,), pos = _read(data, pos, 1)
+        length += byte
+        if byte != 255:
+            return length, pos
+
+
+def decompress_block(block, out):
+    pos = 0
+    while True:
+        (token,), pos = _read(block, pos, 1)
+        literal_length = token >> 4
+        if literal_length == 15:
+            literal_length, pos = _decode_length(block, pos, literal_length)
+        literals, pos = _read(block, pos, literal_length)
+        out += literals
+        if pos == len(block):
+            return
+        raw, pos = _read(block, pos, 2)
+        (offset,) = struct.unpack("<H", raw)
+        match_length = token & 0x0F
+        if match_length == 15:
+            match_length, pos = _decode_length(block, pos, match_length)
+        match_length += MIN_MATCH
+        if offset == 0 or offset > len(out):
+            raise Lz4Error("match offset out of range")
+        start = len(out) - offset
+        for i in range(match_length):
+            out.append(out[start + i])
+
+
+def decompress(frame):
+    """Reference decoder mirroring ota_lz4.c, with checksum verification."""
+    raw, pos = _read(frame, 0, 4)
+    if struct.unpack("<I", raw)[0] != FRAME_MAGIC:
+        raise Lz4Error("not an LZ4 frame")
+    (flags, bd), pos = _read(frame, pos, 2)
+    desc_start = pos - 2
+    if flags & 0xC2 != FLG_VERSION or flags & FLG_DICT_ID or bd & 0x8F or (bd >> 4) < 4:
+        raise Lz4Error("unsupported frame descriptor")
+    content_size = None
+    if flags & FLG_CONTENT_SIZE:
+        raw, pos = _read(frame, pos, 8)
+        (content_size,) = struct.unpack("<Q", raw)
+    (header_checksum,), pos = _read(frame, pos, 1)
+    if header_checksum != (xxh32(frame[desc_start : pos - 1]) >> 8) & 0xFF:
+        raise Lz4Error("frame header checksum mismatch")
+
+    out = bytearray()
+    while True:
+        raw, pos = _read(frame, pos, 4)
+        (block_size,) = struct.unpack("<I", raw)
+        if block_size == 0:
+            break
+        data_size = block_size & ~BLOCK_UNCOMPRESSED
+        block, pos = _read(frame, pos, data_size)
+        if block_size & BLOCK_UNCOMPRESSED:
+            out += block
+        else:
+            decompress_block(block, out)
+        if flags & FLG_BLOCK_CHECKSUM:
+            _, pos = _read(frame, pos, 4)
+
+    if content_size is not None and content_size != len(out):
+        raise Lz4Error("content size mismatch")
+    if flags & FLG_CONTENT_CHECKSUM:
+        raw, pos = _read(frame, pos, 4)
+        if struct.unpack("<I", raw)[0] != xxh32(bytes(out)):
+            raise Lz4Error("content checksum mismatch")
+    if pos != len(frame):
+        raise Lz4Error("{} trailing bytes after the frame".format(len(frame) - pos))
+    return bytes(out)
+
+
+def generated_images():
+    """Code-like images: repeated instruction words, literal pools and erased padding."""
+    rng = random.Random(0x1A4)
+    vocabulary = [rng.getrandbits(32).to_bytes(4, "little") for _ in range(1024)]
+    for size in (0, 1, 17, 4096, 65536 + 13, 300 * 1024):
+        image = bytearray(b"".join(rng.choice(vocabulary) for _ in range(size // 4)))
+        image += bytes(rng.getrandbits(8) for _ in range(size % 4))
+        if size > 4096:
+            pad = rng.randrange(size // 2)
+            image[pad : pad + 2048] = b"\xff" * 2048
+        yield "generated {} bytes".format(size), bytes(image)
+
+
+def selftest(paths):
+    images = [(path, read_file(path)) for path in paths] if paths else generated_images()
+    count = 0
+    for name, image in images:
+        frame = compress(image)
+        if decompress(frame) != image:
+            raise Lz4Error("round trip of {} failed".format(name))
+        count += 1
+        print(
+            "{}: {} -> {} bytes ({:.1f}%)".format(
+                name, len(image), len(frame), 100.0 * len(frame) / max(len(image), 1)
+            )
+        )
+    print("{} round trips passed".format(count))
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    comp = subparsers.add_parser("compress", help="compress an image")
+    comp.add_argument("image")
+    comp.add_argument("output")
+
+    decomp = subparsers.add_parser("decompress", help="decompress an LZ4 frame")
+    decomp.add_argument("frame")
+    decomp.add_argument("output")
+
+    test = subparsers.add_parser("selftest", help="round trip images through the compressor")
+    test.add_argument("images", nargs="*", help="images to round trip instead of generated ones")
+
+    args = parser.parse_args()
+
+    try:
+        if args.command == "compress":
+            image = read_file(args.image)
+            frame = compress(image)
+            # Never ship a frame that does not reproduce the image.
+            if decompress(frame) != image:
+                raise Lz4Error("compressed image does not round trip")
+            write_file(args.output, frame)
+            print(
+                "Compressed image: {} bytes for a {} byte image ({:.1f}%)".format(
+                    len(frame), len(image), 100.0 * len(frame) / max(len(image), 1)
+                )
+            )
+        elif args.command == "decompress":
+            write_file(args.output, decompress(read_file(args.frame)))
+        else:
+            selftest(args.images)
+    except Lz4Error as e:
+        print("Error: {}".format(e), file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,328 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+#
+#
+"""Generate and apply differential (delta) OTA images for the b_u585i_iot02a_ntz project.
+
+A delta image reconstructs a new firmware image from the image currently running on
+the device. The format is decoded by Projects/b_u585i_iot02a_ntz/Src/ota_pal/ota_delta.c:
+
+    header   "OTAD" | u32 version | u32 source size | u32 target size
+             | sha256(source) | sha256(target)                        (little endian)
+    COPY     0x01 | zigzag varint source offset delta | varint length
+    INSERT   0x02 | varint length | literal bytes
+
+Usage:
+    ota_delta.py create <running image> <new image> <delta out>
+    ota_delta.py apply <running image> <delta> <image out>
+    ota_delta.py selftest [--count N] [--size BYTES]
+"""
+import argparse
+import hashlib
+import random
+import struct
+import sys
+
+MAGIC = b"OTAD"
+VERSION = 1
+HEADER_FORMAT = "<4sIII32s32s"
+HEADER_LEN = struct.calcsize(HEADER_FORMAT)
+
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+# Shortest match worth a COPY operation, and the key length used to index the source image.
+MIN_MATCH = 12
+INDEX_KEY_LEN = 8
+
+
+class DeltaError(Exception):
+    pass
+
+
+def encode_varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def decode_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise DeltaError("truncated or oversized varint at offset {}".format(pos))
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag_encode(value):
+    return value << 1 if value >= 0 else ((-value) << 1) - 1
+
+
+def zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def match_length(a, a_pos, b, b_pos, limit):
+    """Length of the common run of a[a_pos:] and b[b_pos:], up to limit bytes."""
+    length = 0
+    step = 256
+    while length < limit:
+        n = min(step, limit - length)
+        if a[a_pos + length : a_pos + length + n] == b[b_pos + length : b_pos + length + n]:
+            length += n
+        elif n == 1:
+            break
+        else:
+            step = max(1, n // 2)
+    return length
+
+
+def build_index(source):
+    """Map each INDEX_KEY_LEN byte sequence of the source to its first position."""
+    index = {}
+    for pos in range(len(source) - INDEX_KEY_LEN, -1, -1):
+        index[source[pos : pos + INDEX_KEY_LEN]] = pos
+    return index
+
+
+def create_delta(source, target):
+    """Greedy COPY/INSERT encoding of target against source."""
+    index = build_index(source)
+    ops = bytearray()
+    literal = bytearray()
+    src_pos = 0
+    pos = 0
+
+    def flush_literal():
+        if literal:
+            ops.append(OP_INSERT)
+            ops.extend(encode_varint(len(literal)))
+            ops.extend(literal)
+            literal.clear()
+
+    while pos < len(target):
+        remaining = len(target) - pos
+        best_len = 0
+        best_src = 0
+
+        # Prefer continuing from where the previous copy ended; it encodes as a zero offset.
+        if src_pos < len(source):
+            best_len = match_length(source, src_pos, target, pos, min(remaining, len(source) - src_pos))
+            best_src = src_pos
+
+        if best_len < MIN_MATCH and remaining >= INDEX_KEY_LEN:
+            candidate = index.get(bytes(target[pos : pos + INDEX_KEY_LEN]))
+            if candidate is not None:
+                length = match_length(
+                    source, candidate, target, pos, min(remaining, len(source) - candidate)
+                )
+                if length > best_len:
+                    best_len = length
+                    best_src = candidate
+
+        if best_len >= MIN_MATCH:
+            flush_literal()
+            ops.append(OP_COPY)
+            ops.extend(encode_varint(zigzag_encode(best_src - src_pos)))
+            ops.extend(encode_varint(best_len))
+            src_pos = best_src + best_len
+            pos += best_len
+        else:
+            literal.append(target[pos])
+            pos += 1
+
+    flush_literal()
+
+    header = struct.pack(
+        HEADER_FORMAT,
+        MAGIC,
+        VERSION,
+        len(source),
+        len(target),
+        hashlib.sha256(source).digest(),
+        hashlib.sha256(target).digest(),
+    )
+    return header + bytes(ops)
+
+
+def apply_delta(source, delta):
+    """Reference decoder mirroring ota_delta.c."""
+    if len(delta) < HEADER_LEN:
+        raise DeltaError("delta is shorter than its header")
+
+    magic, version, source_size, target_size, source_hash, target_hash = struct.unpack_from(
+        HEADER_FORMAT, delta
+    )
+    if magic != MAGIC or version != VERSION:
+        raise DeltaError("not a version {} delta image".format(VERSION))
+    if source_size > len(source) or hashlib.sha256(source[:source_size]).digest() != source_hash:
+        raise DeltaError("delta was not generated against this source image")
+
+    out = bytearray()
+    src_pos = 0
+    pos = HEADER_LEN
+    while len(out) < target_size:
+        if pos >= len(delta):
+            raise DeltaError("delta is truncated")
+        op = delta[pos]
+        pos += 1
+        if op == OP_COPY:
+            offset, pos = decode_varint(delta, pos)
+            length, pos = decode_varint(delta, pos)
+            start = src_pos + zigzag_decode(offset)
+            if start < 0 or start + length > source_size:
+                raise DeltaError("copy outside of the source image")
+            out += source[start : start + length]
+            src_pos = start + length
+        elif op == OP_INSERT:
+            length, pos = decode_varint(delta, pos)
+            if pos + length > len(delta):
+                raise DeltaError("insert is truncated")
+            out += delta[pos : pos + length]
+            pos += length
+        else:
+            raise DeltaError("unknown operation 0x{:02x} at offset {}".format(op, pos - 1))
+        if length == 0 or len(out) > target_size:
+            raise DeltaError("operation length out of range")
+
+    if pos != len(delta):
+        raise DeltaError("{} trailing bytes after the last operation".format(len(delta) - pos))
+    if hashlib.sha256(out).digest() != target_hash:
+        raise DeltaError("reconstructed image does not match the target hash")
+    return bytes(out)
+
+
+def mutate_image(rng, source):
+    """Derive a plausible firmware revision: patched words, shifted code and appended data."""
+    target = bytearray(source)
+    for _ in range(rng.randint(1, 32)):
+        pos = rng.randrange(0, len(target) - 4) & ~3
+        target[pos : pos + 4] = rng.getrandbits(32).to_bytes(4, "little")
+    for _ in range(rng.randint(0, 4)):
+        pos = rng.randrange(0, len(target))
+        if rng.random() < 0.5:
+            target[pos:pos] = bytes(rng.getrandbits(8) for _ in range(rng.randint(1, 600)))
+        else:
+            del target[pos : pos + rng.randint(1, 600)]
+    target += bytes(rng.getrandbits(8) for _ in range(rng.randint(0, 256)))
+    return bytes(target)
+
+
+def selftest(count, size):
+    rng = random.Random(0x0DA7A)
+    # Compressible, code-like source: a small vocabulary of repeated words.
+    vocabulary = [rng.getrandbits(32).to_bytes(4, "little") for _ in range(512)]
+    for i in range(count):
+        source = b"".join(rng.choice(vocabulary) for _ in range(size // 4))
+        target = mutate_image(rng, source)
+        delta = create_delta(source, target)
+        if apply_delta(source, delta) != target:
+            raise DeltaError("round trip {} failed".format(i))
+
+        # A patch must refuse to apply to any other image.
+        other = bytearray(source)
+        other[rng.randrange(len(other))] ^= 0xFF
+        try:
+            apply_delta(bytes(other), delta)
+        except DeltaError:
+            pass
+        else:
+            raise DeltaError("round trip {} applied to the wrong source".format(i))
+
+        print(
+            "{}: source {} target {} delta {} ({:.1f}%)".format(
+                i, len(source), len(target), len(delta), 100.0 * len(delta) / len(target)
+            )
+        )
+    print("{} round trips passed".format(count))
+
+
+def read_file(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    subparsers = parser.add_subparsers(dest="command", required=True)
+
+    create = subparsers.add_parser("create", help="generate a delta image")
+    create.add_argument("source", help="image currently running on the device")
+    create.add_argument("target", help="new image")
+    create.add_argument("delta", help="output delta image")
+
+    apply = subparsers.add_parser("apply", help="reconstruct an image from a delta")
+    apply.add_argument("source", help="image currently running on the device")
+    apply.add_argument("delta", help="delta image")
+    apply.add_argument("target", help="output image")
+
+    test = subparsers.add_parser("selftest", help="round trip randomly generated images")
+    test.add_argument("--count", type=int, default=8)
+    test.add_argument("--size", type=int, default=256 * 1024)
+
+    args = parser.parse_args()
+
+    try:
+        if args.command == "create":
+            source = read_file(args.source)
+            target = read_file(args.target)
+            delta = create_delta(source, target)
+            # Never ship a patch that does not reproduce the target.
+            apply_delta(source, delta)
+            write_file(args.delta, delta)
+            print(
+                "Delta image: {} bytes for a {} byte image ({:.1f}%)".format(
+                    len(delta), len(target), 100.0 * len(delta) / len(target)
+                )
+            )
+        elif args.command == "apply":
+            write_file(args.target, apply_delta(read_file(args.source), read_file(args.delta)))
+        else:
+            selftest(args.count, args.size)
+    except DeltaError as e:
+        print("Error: {}".format(e), file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
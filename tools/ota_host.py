@@ -0,0 +1,352 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+"""Run the OTA update task of Common/app/ota on the host against a stand-in AWS IoT back end.
+
+tools/ota_host/ota_host.c builds ota_update_task.c, the OTA library and the b_u585i_iot02a_ntz OTA
+PAL for the FreeRTOS POSIX port, with the flash models of tools/flash_host behind the HAL and the
+MQTT agent, Jobs and file streams services replaced by tasks of the harness. Each run of the binary
+is one boot of the device. This script keeps the internal flash, option bytes included, and the
+OSPI NOR flash in files between boots, reads the SWAP_BANK option of the internal flash to find
+the active bank, and boots the binary built for the firmware version of the image in that bank.
+
+The selftest delivers version 2 of a synthetic image to a device running version 1:
+    raw         the image as is
+    lz4         the image as an LZ4 frame, see ota_compress.py, on a lossy link delivering
+                blocks out of order
+    delta       a delta against version 1, see ota_delta.py
+    resume      the image as is, with the power cut part way through the download, so that
+                the next boot resumes from the PAL checkpoint
+Each scenario expects the PAL to swap banks and reset, the new image to pass its self test, the
+job to end SUCCEEDED and version 2 to run from the active bank. The script reports the blocks the
+service sent, the device time the download took on the modelled link and the PAL statistics.
+
+The harness needs the kernel, OTA, coreMQTT, coreMQTT-Agent, coreJSON, tinycbor, mbedtls and
+littlefs submodules; selftest is skipped when they are not checked out.
+
+Usage:
+    ota_host.py selftest
+    ota_host.py run [--rtt MS] [--link KBPS] [--drop PERCENT] [--reorder] [--cut-after BLOCKS]
+                    [raw | lz4 | delta]
+"""
+import argparse
+import os
+import random
+import struct
+import subprocess
+import tempfile
+
+import ota_compress
+import ota_delta
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOST_DIR = os.path.join(ROOT, "tools", "ota_host")
+FLASH_HOST_DIR = os.path.join(ROOT, "tools", "flash_host")
+NTZ_DIR = os.path.join(ROOT, "Projects", "b_u585i_iot02a_ntz")
+KERNEL_DIR = os.path.join(ROOT, "Middleware", "FreeRTOS", "kernel")
+POSIX_PORT_DIR = os.path.join(KERNEL_DIR, "portable", "ThirdParty", "GCC", "Posix")
+OTA_DIR = os.path.join(ROOT, "Middleware", "AWS", "OTA")
+COREMQTT_DIR = os.path.join(ROOT, "Middleware", "FreeRTOS", "coreMQTT")
+COREMQTT_AGENT_DIR = os.path.join(ROOT, "Middleware", "FreeRTOS", "coreMQTT-Agent")
+COREJSON_DIR = os.path.join(ROOT, "Middleware", "FreeRTOS", "coreJSON")
+TINYCBOR_DIR = os.path.join(ROOT, "Middleware", "tinycbor")
+MBEDTLS_DIR = os.path.join(ROOT, "Middleware", "ARM", "mbedtls")
+LITTLEFS_DIR = os.path.join(ROOT, "Middleware", "ARM", "littlefs")
+
+SUBMODULES = [KERNEL_DIR, OTA_DIR, COREMQTT_DIR, COREMQTT_AGENT_DIR, COREJSON_DIR, TINYCBOR_DIR,
+              MBEDTLS_DIR, LITTLEFS_DIR]
+
+# Layout of the internal flash backing file, see vFlashSimBoot in stm32u5_flash_sim.c
+FLASH_SIZE = 0x200000
+BANK_SIZE = FLASH_SIZE // 2
+OPTR_SWAP_BANK = 0x00100000
+OPTR_DUALBANK = 0x00200000
+
+# Image header checked by the harness: magic, then the build number of the firmware version
+IMAGE_MAGIC = b"OTAHOST\0"
+IMAGE_SIZE = 192 * 1024
+
+# File names the PAL recognizes, see ota_pal_stm32u5_ntz.c
+FILE_NAMES = {
+    "raw": "b_u585i_iot02a_ntz.bin",
+    "lz4": "b_u585i_iot02a_ntz.bin.lz4",
+    "delta": "b_u585i_iot02a_ntz.delta",
+}
+
+EXIT_DONE = 0
+EXIT_RESET = 64
+EXIT_POWER_CUT = 65
+MAX_BOOTS = 8
+
+
+def missing_submodules():
+    return [os.path.relpath(path, ROOT) for path in SUBMODULES if not os.listdir(path)]
+
+
+def sources():
+    def files(directory, exclude=()):
+        return [os.path.join(directory, name) for name in sorted(os.listdir(directory))
+                if name.endswith(".c") and name not in exclude]
+
+    return ([os.path.join(KERNEL_DIR, name) for name in
+             ("tasks.c", "queue.c", "list.c", "timers.c", "event_groups.c", "stream_buffer.c")] +
+            [os.path.join(KERNEL_DIR, "portable", "MemMang", "heap_4.c"),
+             os.path.join(POSIX_PORT_DIR, "port.c"),
+             os.path.join(POSIX_PORT_DIR, "utils", "wait_for_event.c")] +
+            [path for path in files(os.path.join(OTA_DIR, "source")) if not path.endswith("ota_http.c")] +
+            [os.path.join(OTA_DIR, "source", "portable", "os", "ota_os_freertos.c")] +
+            files(os.path.join(COREJSON_DIR, "source")) +
+            files(os.path.join(TINYCBOR_DIR, "src"), exclude=("open_memstream.c",)) +
+            [os.path.join(COREMQTT_DIR, "source", name) for name in
+             ("core_mqtt.c", "core_mqtt_serializer.c", "core_mqtt_state.c")] +
+            files(os.path.join(MBEDTLS_DIR, "library")) +
+            [os.path.join(LITTLEFS_DIR, "lfs.c"), os.path.join(LITTLEFS_DIR, "lfs_util.c")] +
+            [os.path.join(NTZ_DIR, "Src", "fs", name) for name in
+             ("ospi_nor_mx25lmxxx45g.c", "lfs_port_ospi.c", "lfs_port_prv.c")] +
+            [os.path.join(NTZ_DIR, "Src", "ota_pal", name) for name in
+             ("ota_pal_stm32u5_ntz.c", "ota_delta.c", "ota_lz4.c")] +
+            [os.path.join(ROOT, "Common", "app", "ota", "ota_update_task.c"),
+             os.path.join(FLASH_HOST_DIR, "stm32u5_flash_sim.c"),
+             os.path.join(FLASH_HOST_DIR, "mx25lm_sim.c"),
+             os.path.join(HOST_DIR, "ota_host.c")])
+
+
+def build(out_dir, build_number):
+    """Build the harness for firmware version 0.9.BUILD_NUMBER."""
+    binary = os.path.join(out_dir, "ota_host_%d" % build_number)
+    # The host headers come first, then the kernel ahead of the tools/mx_host shims of its headers
+    include_dirs = [HOST_DIR,
+                    os.path.join(KERNEL_DIR, "include"),
+                    POSIX_PORT_DIR,
+                    os.path.join(POSIX_PORT_DIR, "utils"),
+                    FLASH_HOST_DIR,
+                    os.path.join(ROOT, "tools", "mx_host"),
+                    os.path.join(ROOT, "Common", "config"),
+                    os.path.join(ROOT, "Common", "include"),
+                    os.path.join(ROOT, "Common", "app", "mqtt"),
+                    os.path.join(ROOT, "Common", "kvstore"),
+                    os.path.join(NTZ_DIR, "Inc"),
+                    os.path.join(NTZ_DIR, "Src"),
+                    os.path.join(NTZ_DIR, "Src", "fs"),
+                    os.path.join(NTZ_DIR, "Src", "ota_pal"),
+                    os.path.join(OTA_DIR, "source", "include"),
+                    os.path.join(OTA_DIR, "source", "portable", "os"),
+                    os.path.join(COREMQTT_DIR, "source", "include"),
+                    os.path.join(COREMQTT_DIR, "source", "interface"),
+                    os.path.join(COREMQTT_AGENT_DIR, "source", "include"),
+                    os.path.join(COREJSON_DIR, "source", "include"),
+                    os.path.join(TINYCBOR_DIR, "src"),
+                    os.path.join(MBEDTLS_DIR, "include"),
+                    LITTLEFS_DIR]
+    subprocess.run([os.environ.get("CC", "cc"), "-O1", "-g", "-pthread", "-no-pie",
+                    "-Wno-incompatible-pointer-types", "-Wno-pointer-to-int-cast",
+                    "-Wno-int-to-pointer-cast"] +
+                   [arg for include_dir in include_dirs for arg in ("-I", include_dir)] +
+                   ["-include", "stm32u5xx.h",
+                    "-DLFS_CONFIG=lfs_config.h",
+                    "-DLFS_PORT_OSPI_MEM_MAPPED_READ=0",
+                    "-DMBEDTLS_PLATFORM_MEMORY",
+                    "-DOTA_HOST_APP_VERSION_BUILD=%d" % build_number] +
+                   sources() + ["-o", binary], check=True)
+    return binary
+
+
+def make_image(build_number, rng):
+    """A synthetic firmware image; version 2 keeps most of version 1 so that deltas stay small."""
+    body = bytearray(random.Random(1).randbytes(IMAGE_SIZE - 12))
+    for _ in range(build_number - 1):
+        offset = rng.randrange(len(body) - 4096)
+        body[offset:offset + 4096] = rng.randbytes(4096)
+    return IMAGE_MAGIC + struct.pack("<I", build_number) + bytes(body)
+
+
+def write_file(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def init_flash(path, image):
+    """Internal flash with the image in bank 1, dual bank and not swapped."""
+    flash = bytearray(b"\xff" * FLASH_SIZE)
+    flash[0:len(image)] = image
+    write_file(path, bytes(flash) + struct.pack("<I", OPTR_DUALBANK))
+
+
+def active_build(path):
+    """Build number of the image the bootloader runs: bank 2 first when SWAP_BANK is set."""
+    with open(path, "rb") as f:
+        data = f.read()
+    (optr,) = struct.unpack_from("<I", data, FLASH_SIZE)
+    bank = BANK_SIZE if optr & OPTR_SWAP_BANK else 0
+    if data[bank:bank + len(IMAGE_MAGIC)] != IMAGE_MAGIC:
+        return None
+    return struct.unpack_from("<I", data, bank + len(IMAGE_MAGIC))[0]
+
+
+def parse_summary(output):
+    for line in output.splitlines():
+        if line.startswith("ota_host: "):
+            return dict(field.split("=", 1) for field in line[len("ota_host: "):].split())
+    return None
+
+
+def run_update(tmp, binaries, kind, args, cut_after=0, label=None):
+    """Deliver version 2 to a device running version 1, returning the summary of each boot."""
+    label = label or kind
+    rng = random.Random(args.seed)
+    image_v1 = make_image(1, rng)
+    image_v2 = make_image(2, rng)
+
+    if kind == "raw":
+        file_data, signed = image_v2, image_v2
+    elif kind == "lz4":
+        file_data, signed = ota_compress.compress(image_v2), image_v2
+    else:
+        file_data = ota_delta.create_delta(image_v1, image_v2)
+        signed = file_data
+
+    paths = {name: os.path.join(tmp, "%s.%s" % (label, name)) for name in ("flash", "nor", "job", "file", "signed")}
+    init_flash(paths["flash"], image_v1)
+    for name in ("nor", "job"):
+        if os.path.exists(paths[name]):
+            os.unlink(paths[name])
+    write_file(paths["file"], file_data)
+    write_file(paths["signed"], signed)
+
+    boots = []
+    while True:
+        if len(boots) == MAX_BOOTS:
+            raise SystemExit("%s: no result after %d boots" % (label, MAX_BOOTS))
+        build_number = active_build(paths["flash"])
+        if build_number not in binaries:
+            raise SystemExit("%s: no bootable image in the active bank" % label)
+
+        command = [binaries[build_number],
+                   "--flash", paths["flash"], "--nor", paths["nor"], "--job", paths["job"],
+                   "--file", paths["file"], "--name", FILE_NAMES[kind], "--signed", paths["signed"],
+                   "--rtt", str(args.rtt), "--link", str(args.link), "--drop", str(args.drop),
+                   "--seed", str(args.seed + len(boots))]
+        if args.reorder:
+            command.append("--reorder")
+        if cut_after and not boots:
+            command += ["--cut-after", str(cut_after)]
+
+        result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                                universal_newlines=True, timeout=args.timeout)
+        summary = parse_summary(result.stdout)
+        if summary is None or result.returncode not in (EXIT_DONE, EXIT_RESET, EXIT_POWER_CUT):
+            print(result.stdout)
+            raise SystemExit("%s: boot %d of build %d exited with %d" %
+                             (label, len(boots) + 1, build_number, result.returncode))
+        boots.append(summary)
+        if result.returncode == EXIT_DONE:
+            break
+
+    with open(paths["job"]) as f:
+        status = f.readline().strip()
+    if status != "SUCCEEDED" or active_build(paths["flash"]) != 2:
+        raise SystemExit("%s: job %s with build %s active" % (label, status, active_build(paths["flash"])))
+
+    report(label, len(file_data), boots)
+    return boots
+
+
+def report(label, file_length, boots):
+    # The download ends with the boot which resets into the new image
+    download = [boot for boot in boots if boot["result"] in ("reset", "power_cut")]
+    elapsed_ms = sum(int(boot["elapsed_ms"]) for boot in download)
+    print("%-8s %7d bytes in %6d ms (%5.1f KB/s), boots %d, blocks sent %s dropped %s, "
+          "programmed %s, pages erased %s, checkpoints %s" %
+          (label, file_length, elapsed_ms, file_length / 1024 / max(elapsed_ms / 1000, 0.001), len(boots),
+           "+".join(boot["blocks_sent"] for boot in download),
+           "+".join(boot["blocks_dropped"] for boot in download),
+           "+".join(boot["programmed"] for boot in download),
+           "+".join(boot["pages_erased"] for boot in download),
+           "+".join(boot["checkpoints"] for boot in download)))
+
+
+def build_all(tmp):
+    missing = missing_submodules()
+    if missing:
+        return None, missing
+    return {build_number: build(tmp, build_number) for build_number in (1, 2)}, []
+
+
+def cmd_run(args):
+    with tempfile.TemporaryDirectory() as tmp:
+        binaries, missing = build_all(tmp)
+        if binaries is None:
+            raise SystemExit("%s not checked out: git submodule update --init" % ", ".join(missing))
+        run_update(tmp, binaries, args.kind, args, cut_after=args.cut_after)
+
+
+def cmd_selftest(args):
+    with tempfile.TemporaryDirectory() as tmp:
+        binaries, missing = build_all(tmp)
+        if binaries is None:
+            print("%s not checked out, skipping ota_host" % ", ".join(missing))
+            return
+
+        full = run_update(tmp, binaries, "raw", args)
+        lossy = argparse.Namespace(**vars(args))
+        lossy.drop = 5
+        lossy.reorder = True
+        run_update(tmp, binaries, "lz4", lossy)
+        run_update(tmp, binaries, "delta", args)
+
+        blocks = int(full[0]["blocks_sent"])
+        resumed = run_update(tmp, binaries, "raw", args, cut_after=blocks // 2, label="resume")
+        if resumed[0]["result"] != "power_cut" or int(resumed[1]["blocks_sent"]) >= blocks:
+            raise SystemExit("resume: the download restarted after the power cut")
+
+    print("selftest passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rtt", type=int, default=50, help="round trip time to the broker in ms")
+    parser.add_argument("--link", type=int, default=400, help="link rate from the broker in KB/s")
+    parser.add_argument("--drop", type=int, default=0, help="percentage of blocks lost")
+    parser.add_argument("--reorder", action="store_true", help="deliver blocks in swapped pairs")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the images and block losses")
+    parser.add_argument("--timeout", type=int, default=600, help="wall clock limit of each boot in s")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    selftest = sub.add_parser("selftest", help="update over each file type and across a power cut")
+    selftest.set_defaults(func=cmd_selftest)
+
+    run = sub.add_parser("run", help="deliver one update and report the download statistics")
+    run.add_argument("--cut-after", type=int, default=0, metavar="BLOCKS",
+                     help="cut the power after this many blocks on the first boot")
+    run.add_argument("kind", nargs="?", default="raw", choices=sorted(FILE_NAMES))
+    run.set_defaults(func=cmd_run)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,92 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * FreeRTOS configuration of tools/ota_host, which runs the OTA update task on the kernel's POSIX port.
+ * Task stacks come from the static heap_4 array, so they stay below 4 GiB in the non-PIE harness
+ * binary and can be handed to the flash HAL as 32 bit addresses, as on target.
+ */
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#include "logging.h"
+
+#define configUSE_PREEMPTION                       1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION    0
+#define configSUPPORT_STATIC_ALLOCATION            1
+#define configSUPPORT_DYNAMIC_ALLOCATION           1
+#define configUSE_IDLE_HOOK                        0
+#define configUSE_TICK_HOOK                        0
+#define configTICK_RATE_HZ                         ( ( TickType_t ) 1000 )
+#define configMAX_PRIORITIES                       ( 56 )
+#define configMINIMAL_STACK_SIZE                   ( ( uint16_t ) 4096 )
+#define configTOTAL_HEAP_SIZE                      ( ( size_t ) 32 * 1024 * 1024 )
+#define configMAX_TASK_NAME_LEN                    ( 32 )
+#define configUSE_TRACE_FACILITY                   1
+#define configUSE_16_BIT_TICKS                     0
+#define configUSE_MUTEXES                          1
+#define configQUEUE_REGISTRY_SIZE                  8
+#define configUSE_RECURSIVE_MUTEXES                1
+#define configUSE_COUNTING_SEMAPHORES              1
+#define configCHECK_FOR_STACK_OVERFLOW             0
+#define configUSE_CO_ROUTINES                      0
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES      8
+
+/* The POSIX port provides portGET_RUN_TIME_COUNTER_VALUE, which the PAL statistics use */
+#define configGENERATE_RUN_TIME_STATS              1
+
+#define configUSE_TIMERS                           1
+#define configTIMER_TASK_PRIORITY                  ( 24 )
+#define configTIMER_QUEUE_LENGTH                   10
+#define configTIMER_TASK_STACK_DEPTH               4096
+
+#define INCLUDE_vTaskPrioritySet                   1
+#define INCLUDE_uxTaskPriorityGet                  1
+#define INCLUDE_vTaskDelete                        1
+#define INCLUDE_vTaskSuspend                       1
+#define INCLUDE_vTaskDelayUntil                    1
+#define INCLUDE_xTaskAbortDelay                    1
+#define INCLUDE_vTaskDelay                         1
+#define INCLUDE_xTaskGetSchedulerState             1
+#define INCLUDE_xTaskGetHandle                     1
+#define INCLUDE_xTimerPendFunctionCall             1
+#define INCLUDE_xQueueGetMutexHolder               1
+#define INCLUDE_uxTaskGetStackHighWaterMark        1
+#define INCLUDE_xTaskGetCurrentTaskHandle          1
+#define INCLUDE_eTaskGetState                      1
+
+void vAssertCalled( const char * pcFile,
+                    unsigned long ulLine );
+
+#define configASSERT( x )                          \
+    do {                                           \
+        if( ( x ) == 0 ) {                         \
+            vAssertCalled( __FILE__, __LINE__ );   \
+        }                                          \
+    } while( 0 )
+
+#include "hw_defs.h"
+
+#endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,86 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Host logging.h for tools/ota_host, accepting the single and the double parenthesis forms used across
+ * Common, as Common/cli/logging.h does. Lines go to stdout with the tick count, printed with the scheduler
+ * suspended so that a task switch never lands inside stdio.
+ */
+#ifndef OTA_HOST_LOGGING_H
+#define OTA_HOST_LOGGING_H
+
+#include "logging_levels.h"
+
+#ifndef LOG_LEVEL
+    #define LOG_LEVEL    LOG_INFO
+#endif
+
+/* Get rid of extra C89 style parentheses generated by core FreeRTOS libraries */
+#define REMOVE_PARENS( ... )    STR( OVE __VA_ARGS__ )
+#define OVE( ... )              OVE __VA_ARGS__
+#define STR( ... )              STR_( __VA_ARGS__ )
+#define STR_( ... )             REM ## __VA_ARGS__
+#define REMOVE
+
+void vLoggingPrintf( const char * const pcLogLevel,
+                     const char * const pcFunctionName,
+                     const unsigned long ulLineNumber,
+                     const char * const pcFormat,
+                     ... );
+void vDyingGasp( void );
+
+#define __NAME_ARG__            ( __builtin_strrchr( __FILE__, '/' ) ? __builtin_strrchr( __FILE__, '/' ) + 1 : __FILE__ )
+
+#define SdkLog( level, ... )    do { vLoggingPrintf( level, __NAME_ARG__, __LINE__, __VA_ARGS__ ); } while( 0 )
+
+#define LogAssert( ... )        SdkLog( "ASRT", __VA_ARGS__ )
+#define LogSys( ... )           SdkLog( "SYS", __VA_ARGS__ )
+#define LogKernel( ... )        SdkLog( "KRN", __VA_ARGS__ )
+
+#if ( LOG_LEVEL >= LOG_ERROR )
+    #define LogError( ... )    SdkLog( "ERR", REMOVE_PARENS( __VA_ARGS__ ) )
+#else
+    #define LogError( ... )
+#endif
+
+#if ( LOG_LEVEL >= LOG_WARN )
+    #define LogWarn( ... )    SdkLog( "WRN", REMOVE_PARENS( __VA_ARGS__ ) )
+#else
+    #define LogWarn( ... )
+#endif
+
+#if ( LOG_LEVEL >= LOG_INFO )
+    #define LogInfo( ... )    SdkLog( "INF", REMOVE_PARENS( __VA_ARGS__ ) )
+#else
+    #define LogInfo( ... )
+#endif
+
+#if ( LOG_LEVEL >= LOG_DEBUG )
+    #define LogDebug( ... )    SdkLog( "DBG", REMOVE_PARENS( __VA_ARGS__ ) )
+#else
+    #define LogDebug( ... )
+#endif
+
+#endif /* OTA_HOST_LOGGING_H */
@@ -0,0 +1,1250 @@
+/*
+ * FreeRTOS STM32 Reference Integration
+ * Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * http://www.FreeRTOS.org
+ * http://aws.amazon.com/freertos
+ */
+
+/*
+ * Runs Common/app/ota/ota_update_task.c with the b_u585i_iot02a_ntz OTA PAL on the FreeRTOS POSIX port,
+ * against a stand-in for the MQTT agent and for the AWS IoT Jobs and MQTT file streams services:
+ *  - The agent keeps the subscriptions and delivers the service responses to their callbacks, from its own
+ *    task as coreMQTT-Agent does.
+ *  - The service answers $next/get with a single job for the file given on the command line, signed with
+ *    a key generated by the harness, records the status updates of the job, and answers each stream request
+ *    with the first missing blocks of the bitmap. Requests reach it after half the round trip, and blocks
+ *    are sent one after the other at the link rate, each with the other half of the round trip added.
+ *    Blocks can be dropped at random or sent in swapped pairs.
+ *  - The internal flash and the MX25LM51245G are the tools/flash_host models, backed by files so that they
+ *    keep their contents, option bytes included, across resets.
+ *
+ * Each process is one boot of the device. It ends with:
+ *  - FLASH_SIM_EXIT_RESET when the device resets, through the PAL or an option byte launch;
+ *  - OTA_HOST_EXIT_POWER_CUT after --cut-after blocks have been delivered;
+ *  - 0 once the job reaches a terminal status, and 1 on a timeout or an error.
+ * The job status is kept in the --job file between boots. A line starting with "ota_host:" summarizes
+ * each boot for tools/ota_host.py, which builds one binary per firmware version and boots the binary
+ * matching the image header in the active bank.
+ *
+ * Usage: ota_host --flash <file> --nor <file> --job <file> --file <path> --name <file name>
+ *                 [--signed <path>] [--rtt <ms>] [--link <KB/s>] [--drop <percent>] [--reorder]
+ *                 [--seed <n>] [--cut-after <blocks>] [--timeout <s>]
+ * --signed is the file covered by the signature, the decompressed image of an LZ4 file for example.
+ */
+
+#include "logging_levels.h"
+#define LOG_LEVEL    LOG_INFO
+#include "logging.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "timers.h"
+#include "event_groups.h"
+
+#include "sys_evt.h"
+#include "kvstore.h"
+#include "core_mqtt.h"
+#include "core_mqtt_agent.h"
+#include "mqtt_agent_task.h"
+#include "subscription_manager.h"
+#include "core_json.h"
+#include "cbor.h"
+
+#include "ota_appversion32.h"
+#include "ota_pal.h"
+#include "PkiObject.h"
+#include "lfs.h"
+#include "fs/lfs_port.h"
+
+#include "mbedtls/base64.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/ecp.h"
+#include "mbedtls/platform.h"
+#include "mbedtls/sha256.h"
+
+#include "mx25lm_sim.h"
+#include "stm32u5_flash_sim.h"
+
+#ifndef OTA_HOST_APP_VERSION_BUILD
+    #define OTA_HOST_APP_VERSION_BUILD    1
+#endif
+
+#define OTA_HOST_EXIT_DONE           ( 0 )
+#define OTA_HOST_EXIT_FAIL           ( 1 )
+#define OTA_HOST_EXIT_USAGE          ( 2 )
+#define OTA_HOST_EXIT_POWER_CUT      ( 65 )
+
+#define OTA_HOST_THING_NAME          "ota_host"
+#define OTA_HOST_JOB_ID              "AFR_OTA-ota_host"
+#define OTA_HOST_STREAM_NAME         "AFR_OTA-ota_host-stream"
+#define OTA_HOST_SIGNER_LABEL        "ota_host_signer"
+
+/* Header tools/ota_host.py puts at the start of each image: the magic, then the build number */
+#define OTA_HOST_IMAGE_MAGIC         "OTAHOST"
+#define OTA_HOST_IMAGE_MAGIC_LEN     ( 8 )
+
+#define OTA_HOST_TOPIC_LEN           ( 128 )
+#define OTA_HOST_MAX_SUBSCRIPTIONS   ( 8 )
+#define OTA_HOST_QUEUE_LEN           ( 256 )
+#define OTA_HOST_STATUS_LEN          ( 32 )
+#define OTA_HOST_DETAILS_LEN         ( 512 )
+#define OTA_HOST_JOB_DOC_LEN         ( 2048 )
+#define OTA_HOST_PEM_LEN             ( 256 )
+#define OTA_HOST_SIGNATURE_LEN       ( 128 )
+#define OTA_HOST_MAX_BLOCK_SIZE      ( 4096 )
+#define OTA_HOST_MAX_BITMAP_LEN      ( 1024 )
+#define OTA_HOST_MAX_BLOCKS_PER_REQ  ( 64 )
+#define OTA_HOST_BLOCK_OVERHEAD      ( 32 )
+
+#define OTA_HOST_TASK_STACK_SIZE     ( 4096 )
+#define OTA_HOST_AGENT_PRIORITY      ( 10 )
+#define OTA_HOST_SERVICE_PRIORITY    ( 11 )
+
+/* Suffixes of the topics the service answers, after $aws/things/<thing name>/ */
+#define OTA_HOST_JOB_GET_SUFFIX      "/jobs/$next/get"
+#define OTA_HOST_JOB_UPDATE_SUFFIX   "/update"
+#define OTA_HOST_STREAM_GET_SUFFIX   "/get/cbor"
+#define OTA_HOST_STREAM_DATA_SUFFIX  "/data/cbor"
+
+typedef struct OtaHostConfig
+{
+    const char * pcFlashPath;
+    const char * pcNorPath;
+    const char * pcJobPath;
+    const char * pcFilePath;
+    const char * pcFileName;
+    const char * pcSignedPath;
+    uint32_t ulRttMs;
+    uint32_t ulLinkKBps;
+    uint32_t ulDropPercent;
+    BaseType_t xReorder;
+    unsigned int uSeed;
+    uint32_t ulCutAfterBlocks;
+    uint32_t ulTimeoutS;
+} OtaHostConfig_t;
+
+/* A publish in flight, in either direction */
+typedef struct OtaHostMessage
+{
+    TickType_t xDue; /* Tick at which it reaches the other end */
+    char cTopic[ OTA_HOST_TOPIC_LEN ];
+    uint16_t usTopicLength;
+    uint8_t * pucPayload;
+    size_t uxPayloadLength;
+} OtaHostMessage_t;
+
+typedef struct OtaHostSubscription
+{
+    char cTopicFilter[ OTA_HOST_TOPIC_LEN ];
+    IncomingPubCallback_t pxCallback;
+    void * pvCallbackCtx;
+} OtaHostSubscription_t;
+
+/* Job execution as the Jobs service keeps it, saved to the --job file after each update */
+typedef struct OtaHostJob
+{
+    char cStatus[ OTA_HOST_STATUS_LEN ];
+    char cStatusDetails[ OTA_HOST_DETAILS_LEN ];
+} OtaHostJob_t;
+
+typedef struct OtaHostStats
+{
+    uint32_t ulJobRequests;
+    uint32_t ulStreamRequests;
+    uint32_t ulBlocksSent;
+    uint32_t ulBlocksDropped;
+    uint32_t ulBlocksDelivered;
+} OtaHostStats_t;
+
+const AppVersion32_t appFirmwareVersion =
+{
+    .u.x.major = 0,
+    .u.x.minor = 9,
+    .u.x.build = OTA_HOST_APP_VERSION_BUILD,
+};
+
+EventGroupHandle_t xSystemEvents = NULL;
+
+static OtaHostConfig_t xConfig =
+{
+    .ulRttMs          = 50,
+    .ulLinkKBps       = 400,
+    .uSeed            = 1,
+    .ulTimeoutS       = 300,
+};
+
+static OtaHostJob_t xJob;
+static OtaHostStats_t xStats;
+
+static MQTTAgentContext_t xAgentContext;
+static QueueHandle_t xUplink = NULL;
+static QueueHandle_t xDownlink = NULL;
+static SemaphoreHandle_t xSubscriptionMutex = NULL;
+static OtaHostSubscription_t xSubscriptions[ OTA_HOST_MAX_SUBSCRIPTIONS ];
+
+static lfs_t * pxLfsCtx = NULL;
+
+static uint8_t * pucFile = NULL;
+static size_t uxFileLength = 0;
+static char cSignerPem[ OTA_HOST_PEM_LEN ];
+static char cSignature[ OTA_HOST_SIGNATURE_LEN ];
+
+/* Microseconds since the scheduler started at which the link is free to send the next block */
+static uint64_t ullLinkFreeUs = 0;
+
+static TickType_t xBootTick = 0;
+static BaseType_t xSummaryPrinted = pdFALSE;
+
+extern void vOTAUpdateTask( void * pvParam );
+
+/*-----------------------------------------------------------*/
+
+void vLoggingPrintf( const char * const pcLogLevel,
+                     const char * const pcFunctionName,
+                     const unsigned long ulLineNumber,
+                     const char * const pcFormat,
+                     ... )
+{
+    va_list xArgs;
+    BaseType_t xRunning = ( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING ) ? pdTRUE : pdFALSE;
+
+    if( xRunning == pdTRUE )
+    {
+        vTaskSuspendAll();
+    }
+
+    ( void ) printf( "%lu %s %s:%lu ", ( unsigned long ) xTaskGetTickCount(), pcLogLevel, pcFunctionName, ulLineNumber );
+    va_start( xArgs, pcFormat );
+    ( void ) vprintf( pcFormat, xArgs );
+    va_end( xArgs );
+    ( void ) printf( "\n" );
+
+    if( xRunning == pdTRUE )
+    {
+        ( void ) xTaskResumeAll();
+    }
+}
+
+static void prvPrintSummary( const char * pcResult )
+{
+    OtaPalStats_t xPalStats = { 0 };
+
+    if( xSummaryPrinted == pdFALSE )
+    {
+        xSummaryPrinted = pdTRUE;
+        vOtaPalGetStats( &xPalStats );
+
+        ( void ) printf( "ota_host: result=%s build=%u status=%s elapsed_ms=%lu job_requests=%u stream_requests=%u "
+                         "blocks_sent=%u blocks_dropped=%u blocks_delivered=%u pal_blocks=%u pal_bytes=%u "
+                         "programmed=%u pages_erased=%u checkpoints=%u flash_busy_ms=%llu nor_busy_ms=%llu "
+                         "nor_erases=%u\n",
+                         pcResult, OTA_HOST_APP_VERSION_BUILD, xJob.cStatus,
+                         ( unsigned long ) ( ( xTaskGetTickCount() - xBootTick ) * portTICK_PERIOD_MS ),
+                         xStats.ulJobRequests, xStats.ulStreamRequests,
+                         xStats.ulBlocksSent, xStats.ulBlocksDropped, xStats.ulBlocksDelivered,
+                         xPalStats.ulBlocksWritten, xPalStats.ulBytesWritten,
+                         xPalStats.ulBytesProgrammed, xPalStats.ulPagesErased, xPalStats.ulCheckpoints,
+                         ( unsigned long long ) ( xFlashSimStats.ullBusyNs / 1000000ULL ),
+                         ( unsigned long long ) ( xMx25lmSim.ullBusyNs / 1000000ULL ),
+                         xMx25lmSim.ulSectorErases );
+        ( void ) fflush( stdout );
+    }
+}
+
+static void prvFinish( int lExitStatus,
+                       const char * pcResult )
+{
+    vTaskSuspendAll();
+    prvPrintSummary( pcResult );
+    ( void ) fflush( NULL );
+    _exit( lExitStatus );
+}
+
+void vAssertCalled( const char * pcFile,
+                    unsigned long ulLine )
+{
+    ( void ) printf( "Assertion failed: %s:%lu\n", pcFile, ulLine );
+    prvFinish( OTA_HOST_EXIT_FAIL, "assert" );
+}
+
+/* The PAL drains the logs before an option byte launch, which resets the device without returning */
+void vDyingGasp( void )
+{
+    prvPrintSummary( "reset" );
+    ( void ) fflush( NULL );
+}
+
+void vDoSystemReset( void )
+{
+    prvPrintSummary( "reset" );
+    vFlashSimReset();
+}
+
+/*-----------------------------------------------------------*/
+
+void vApplicationGetIdleTaskMemory( StaticTask_t ** ppxIdleTaskTCBBuffer,
+                                    StackType_t ** ppxIdleTaskStackBuffer,
+                                    uint32_t * pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+void vApplicationGetTimerTaskMemory( StaticTask_t ** ppxTimerTaskTCBBuffer,
+                                     StackType_t ** ppxTimerTaskStackBuffer,
+                                     uint32_t * pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+
+/* mbedtls allocates from the FreeRTOS heap, as the C library allocator is not safe across task switches of the port */
+static void * prvCalloc( size_t uxCount,
+                         size_t uxSize )
+{
+    void * pvBuffer = NULL;
+    size_t uxTotal = uxCount * uxSize;
+
+    if( ( uxSize != 0 ) && ( ( uxTotal / uxSize ) == uxCount ) )
+    {
+        pvBuffer = pvPortMalloc( uxTotal );
+
+        if( pvBuffer != NULL )
+        {
+            ( void ) memset( pvBuffer, 0, uxTotal );
+        }
+    }
+
+    return pvBuffer;
+}
+
+/*-----------------------------------------------------------*/
+
+char * KVStore_getStringHeap( KVStoreKey_t key,
+                              size_t * pxLength )
+{
+    char * pcValue = NULL;
+
+    if( key == CS_CORE_THING_NAME )
+    {
+        size_t uxLength = strlen( OTA_HOST_THING_NAME );
+
+        pcValue = pvPortMalloc( uxLength + 1 );
+
+        if( pcValue != NULL )
+        {
+            ( void ) memcpy( pcValue, OTA_HOST_THING_NAME, uxLength + 1 );
+
+            if( pxLength != NULL )
+            {
+                *pxLength = uxLength;
+            }
+        }
+    }
+
+    return pcValue;
+}
+
+PkiObject_t xPkiObjectFromLabel( const char * pcLabel )
+{
+    PkiObject_t xObject = { .xForm = OBJ_FORM_NONE };
+
+    if( ( pcLabel != NULL ) &&
+        ( strcmp( pcLabel, OTA_HOST_SIGNER_LABEL ) == 0 ) )
+    {
+        /* PEM lengths include the terminator for mbedtls */
+        xObject.xForm = OBJ_FORM_PEM;
+        xObject.uxLen = strlen( cSignerPem ) + 1;
+        xObject.pucBuffer = ( const unsigned char * ) cSignerPem;
+    }
+
+    return xObject;
+}
+
+PkiStatus_t xPkiReadPublicKey( mbedtls_pk_context * pxPkCtx,
+                               const PkiObject_t * pxPublicKey )
+{
+    PkiStatus_t xStatus = PKI_ERR_OBJ_NOT_FOUND;
+
+    if( ( pxPkCtx == NULL ) || ( pxPublicKey == NULL ) )
+    {
+        xStatus = PKI_ERR_ARG_INVALID;
+    }
+    else if( pxPublicKey->xForm == OBJ_FORM_PEM )
+    {
+        xStatus = ( mbedtls_pk_parse_public_key( pxPkCtx, pxPublicKey->pucBuffer, pxPublicKey->uxLen ) == 0 ) ?
+                  PKI_SUCCESS : PKI_ERR_OBJ_PARSING_FAILED;
+    }
+
+    return xStatus;
+}
+
+lfs_t * pxGetDefaultFsCtx( void )
+{
+    configASSERT( pxLfsCtx != NULL );
+
+    return pxLfsCtx;
+}
+
+/* Mount the OSPI volume as app_main.c does, formatting it on the first boot */
+static BaseType_t prvFsInit( void )
+{
+    static lfs_t xLfsCtx = { 0 };
+    struct lfs_info xDirInfo = { 0 };
+    const struct lfs_config * pxCfg = pxInitializeOSPIFlashFs( pdMS_TO_TICKS( 30 * 1000 ) );
+    int lErr = LFS_ERR_IO;
+
+    if( pxCfg != NULL )
+    {
+        lErr = lfs_mount( &xLfsCtx, pxCfg );
+
+        if( lErr != LFS_ERR_OK )
+        {
+            LogInfo( "Formatting the OSPI volume on first boot." );
+            lErr = lfs_format( &xLfsCtx, pxCfg );
+
+            if( lErr == LFS_ERR_OK )
+            {
+                lErr = lfs_mount( &xLfsCtx, pxCfg );
+            }
+        }
+    }
+
+    if( ( lErr == LFS_ERR_OK ) &&
+        ( lfs_stat( &xLfsCtx, "/ota", &xDirInfo ) == LFS_ERR_NOENT ) )
+    {
+        lErr = lfs_mkdir( &xLfsCtx, "/ota" );
+    }
+
+    if( lErr == LFS_ERR_OK )
+    {
+        pxLfsCtx = &xLfsCtx;
+    }
+    else
+    {
+        LogError( "Failed to mount the OSPI volume: %d.", lErr );
+    }
+
+    return ( lErr == LFS_ERR_OK ) ? pdTRUE : pdFALSE;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTAgentHandle_t xGetMqttAgentHandle( void )
+{
+    return &xAgentContext;
+}
+
+MQTTStatus_t MqttAgent_SubscribeSync( MQTTAgentHandle_t xHandle,
+                                      const char * pcTopicFilter,
+                                      MQTTQoS_t xRequestedQoS,
+                                      IncomingPubCallback_t pxCallback,
+                                      void * pvCallbackCtx )
+{
+    MQTTStatus_t xStatus = MQTTNoMemory;
+
+    ( void ) xHandle;
+    ( void ) xRequestedQoS;
+
+    configASSERT( strlen( pcTopicFilter ) < OTA_HOST_TOPIC_LEN );
+
+    ( void ) xSemaphoreTake( xSubscriptionMutex, portMAX_DELAY );
+
+    for( size_t uxIdx = 0; ( xStatus != MQTTSuccess ) && ( uxIdx < OTA_HOST_MAX_SUBSCRIPTIONS ); uxIdx++ )
+    {
+        if( xSubscriptions[ uxIdx ].pxCallback == NULL )
+        {
+            ( void ) strcpy( xSubscriptions[ uxIdx ].cTopicFilter, pcTopicFilter );
+            xSubscriptions[ uxIdx ].pxCallback = pxCallback;
+            xSubscriptions[ uxIdx ].pvCallbackCtx = pvCallbackCtx;
+            xStatus = MQTTSuccess;
+        }
+    }
+
+    ( void ) xSemaphoreGive( xSubscriptionMutex );
+
+    return xStatus;
+}
+
+MQTTStatus_t MqttAgent_UnSubscribeSync( MQTTAgentHandle_t xHandle,
+                                        const char * pcTopicFilter,
+                                        IncomingPubCallback_t pxCallback,
+                                        void * pvCallbackCtx )
+{
+    ( void ) xHandle;
+
+    ( void ) xSemaphoreTake( xSubscriptionMutex, portMAX_DELAY );
+
+    for( size_t uxIdx = 0; uxIdx < OTA_HOST_MAX_SUBSCRIPTIONS; uxIdx++ )
+    {
+        if( ( xSubscriptions[ uxIdx ].pxCallback == pxCallback ) &&
+            ( xSubscriptions[ uxIdx ].pvCallbackCtx == pvCallbackCtx ) &&
+            ( strcmp( xSubscriptions[ uxIdx ].cTopicFilter, pcTopicFilter ) == 0 ) )
+        {
+            ( void ) memset( &( xSubscriptions[ uxIdx ] ), 0, sizeof( xSubscriptions[ uxIdx ] ) );
+        }
+    }
+
+    ( void ) xSemaphoreGive( xSubscriptionMutex );
+
+    return MQTTSuccess;
+}
+
+static BaseType_t prvQueueMessage( QueueHandle_t xQueue,
+                                   TickType_t xDue,
+                                   const char * pcTopic,
+                                   uint16_t usTopicLength,
+                                   const void * pvPayload,
+                                   size_t uxPayloadLength )
+{
+    OtaHostMessage_t xMessage = { 0 };
+    BaseType_t xResult = pdFALSE;
+
+    configASSERT( usTopicLength < OTA_HOST_TOPIC_LEN );
+
+    xMessage.xDue = xDue;
+    xMessage.usTopicLength = usTopicLength;
+    ( void ) memcpy( xMessage.cTopic, pcTopic, usTopicLength );
+    xMessage.uxPayloadLength = uxPayloadLength;
+    xMessage.pucPayload = pvPortMalloc( uxPayloadLength + 1 );
+
+    if( xMessage.pucPayload != NULL )
+    {
+        ( void ) memcpy( xMessage.pucPayload, pvPayload, uxPayloadLength );
+        xMessage.pucPayload[ uxPayloadLength ] = 0;
+        xResult = xQueueSend( xQueue, &xMessage, portMAX_DELAY );
+    }
+
+    return xResult;
+}
+
+/* Publishes are handed to the service after half the round trip, and complete once queued as with QoS 0 */
+MQTTStatus_t MQTTAgent_Publish( const MQTTAgentContext_t * pMqttAgentContext,
+                                MQTTPublishInfo_t * pPublishInfo,
+                                const MQTTAgentCommandInfo_t * pCommandInfo )
+{
+    MQTTStatus_t xStatus = MQTTNoMemory;
+
+    ( void ) pMqttAgentContext;
+
+    if( prvQueueMessage( xUplink, xTaskGetTickCount() + pdMS_TO_TICKS( xConfig.ulRttMs / 2 ),
+                         pPublishInfo->pTopicName, pPublishInfo->topicNameLength,
+                         pPublishInfo->pPayload, pPublishInfo->payloadLength ) == pdTRUE )
+    {
+        xStatus = MQTTSuccess;
+
+        if( ( pCommandInfo != NULL ) && ( pCommandInfo->cmdCompleteCallback != NULL ) )
+        {
+            MQTTAgentReturnInfo_t xReturnInfo = { .returnCode = MQTTSuccess };
+
+            pCommandInfo->cmdCompleteCallback( pCommandInfo->pCmdCompleteCallbackContext, &xReturnInfo );
+        }
+    }
+
+    return xStatus;
+}
+
+static void prvWaitUntil( TickType_t xDue )
+{
+    TickType_t xNow = xTaskGetTickCount();
+
+    if( ( TickType_t ) ( xDue - xNow ) < portMAX_DELAY / 2 )
+    {
+        vTaskDelay( xDue - xNow );
+    }
+}
+
+/* Stand-in for the MQTT agent task: delivers incoming publishes to the matching subscriptions */
+static void prvAgentTask( void * pvParameters )
+{
+    OtaHostMessage_t xMessage;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        OtaHostSubscription_t xMatches[ OTA_HOST_MAX_SUBSCRIPTIONS ];
+        size_t uxMatches = 0;
+        MQTTPublishInfo_t xPublishInfo = { 0 };
+
+        ( void ) xQueueReceive( xDownlink, &xMessage, portMAX_DELAY );
+        prvWaitUntil( xMessage.xDue );
+
+        ( void ) xSemaphoreTake( xSubscriptionMutex, portMAX_DELAY );
+
+        for( size_t uxIdx = 0; uxIdx < OTA_HOST_MAX_SUBSCRIPTIONS; uxIdx++ )
+        {
+            bool xMatch = false;
+
+            if( xSubscriptions[ uxIdx ].pxCallback != NULL )
+            {
+                ( void ) MQTT_MatchTopic( xMessage.cTopic, xMessage.usTopicLength,
+                                          xSubscriptions[ uxIdx ].cTopicFilter,
+                                          ( uint16_t ) strlen( xSubscriptions[ uxIdx ].cTopicFilter ),
+                                          &xMatch );
+            }
+
+            if( xMatch == true )
+            {
+                xMatches[ uxMatches++ ] = xSubscriptions[ uxIdx ];
+            }
+        }
+
+        ( void ) xSemaphoreGive( xSubscriptionMutex );
+
+        xPublishInfo.qos = MQTTQoS0;
+        xPublishInfo.pTopicName = xMessage.cTopic;
+        xPublishInfo.topicNameLength = xMessage.usTopicLength;
+        xPublishInfo.pPayload = xMessage.pucPayload;
+        xPublishInfo.payloadLength = xMessage.uxPayloadLength;
+
+        for( size_t uxIdx = 0; uxIdx < uxMatches; uxIdx++ )
+        {
+            xMatches[ uxIdx ].pxCallback( xMatches[ uxIdx ].pvCallbackCtx, &xPublishInfo );
+        }
+
+        vPortFree( xMessage.pucPayload );
+
+        if( ( xMessage.usTopicLength > strlen( OTA_HOST_STREAM_DATA_SUFFIX ) ) &&
+            ( strcmp( &( xMessage.cTopic[ xMessage.usTopicLength - strlen( OTA_HOST_STREAM_DATA_SUFFIX ) ] ),
+                      OTA_HOST_STREAM_DATA_SUFFIX ) == 0 ) )
+        {
+            xStats.ulBlocksDelivered++;
+
+            if( ( xConfig.ulCutAfterBlocks != 0 ) && ( xStats.ulBlocksDelivered == xConfig.ulCutAfterBlocks ) )
+            {
+                prvFinish( OTA_HOST_EXIT_POWER_CUT, "power_cut" );
+            }
+        }
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+/* Send a response over the link: serialized with the responses before it, then half the round trip */
+static void prvServiceSend( const char * pcTopic,
+                            const void * pvPayload,
+                            size_t uxPayloadLength )
+{
+    uint64_t ullNowUs = ( uint64_t ) xTaskGetTickCount() * portTICK_PERIOD_MS * 1000ULL;
+    uint64_t ullDueUs;
+
+    if( ullLinkFreeUs < ullNowUs )
+    {
+        ullLinkFreeUs = ullNowUs;
+    }
+
+    ullLinkFreeUs += ( ( uint64_t ) ( uxPayloadLength + OTA_HOST_BLOCK_OVERHEAD ) * 1000000ULL ) / ( ( uint64_t ) xConfig.ulLinkKBps * 1024ULL );
+    ullDueUs = ullLinkFreeUs + ( ( uint64_t ) xConfig.ulRttMs * 500ULL );
+
+    configASSERT( prvQueueMessage( xDownlink, ( TickType_t ) ( ( ullDueUs + 999ULL ) / ( portTICK_PERIOD_MS * 1000ULL ) ),
+                                   pcTopic, ( uint16_t ) strlen( pcTopic ), pvPayload, uxPayloadLength ) == pdTRUE );
+}
+
+static BaseType_t prvIsTerminal( const char * pcStatus )
+{
+    return ( ( strcmp( pcStatus, "SUCCEEDED" ) == 0 ) ||
+             ( strcmp( pcStatus, "FAILED" ) == 0 ) ||
+             ( strcmp( pcStatus, "REJECTED" ) == 0 ) ||
+             ( strcmp( pcStatus, "CANCELED" ) == 0 ) ) ? pdTRUE : pdFALSE;
+}
+
+static void prvLoadJob( void )
+{
+    FILE * pxFile = fopen( xConfig.pcJobPath, "r" );
+
+    ( void ) strcpy( xJob.cStatus, "QUEUED" );
+    xJob.cStatusDetails[ 0 ] = '\0';
+
+    if( pxFile != NULL )
+    {
+        if( fgets( xJob.cStatus, sizeof( xJob.cStatus ), pxFile ) != NULL )
+        {
+            xJob.cStatus[ strcspn( xJob.cStatus, "\n" ) ] = '\0';
+        }
+
+        if( fgets( xJob.cStatusDetails, sizeof( xJob.cStatusDetails ), pxFile ) != NULL )
+        {
+            xJob.cStatusDetails[ strcspn( xJob.cStatusDetails, "\n" ) ] = '\0';
+        }
+
+        ( void ) fclose( pxFile );
+    }
+}
+
+static void prvSaveJob( void )
+{
+    FILE * pxFile = fopen( xConfig.pcJobPath, "w" );
+
+    configASSERT( pxFile != NULL );
+    ( void ) fprintf( pxFile, "%s\n%s\n", xJob.cStatus, xJob.cStatusDetails );
+    ( void ) fclose( pxFile );
+}
+
+static void prvServiceJobRequest( const OtaHostMessage_t * pxRequest )
+{
+    char cTopic[ OTA_HOST_TOPIC_LEN ];
+    char * pcDoc = pvPortMalloc( OTA_HOST_JOB_DOC_LEN );
+    int lLength;
+
+    configASSERT( pcDoc != NULL );
+
+    xStats.ulJobRequests++;
+    ( void ) snprintf( cTopic, sizeof( cTopic ), "%s/accepted", pxRequest->cTopic );
+
+    if( prvIsTerminal( xJob.cStatus ) == pdTRUE )
+    {
+        lLength = snprintf( pcDoc, OTA_HOST_JOB_DOC_LEN, "{\"clientToken\":\"ota_host\",\"timestamp\":1}" );
+    }
+    else
+    {
+        char cDetails[ OTA_HOST_DETAILS_LEN + 20 ] = "";
+
+        if( xJob.cStatusDetails[ 0 ] != '\0' )
+        {
+            ( void ) snprintf( cDetails, sizeof( cDetails ), "\"statusDetails\":%s,", xJob.cStatusDetails );
+        }
+
+        lLength = snprintf( pcDoc, OTA_HOST_JOB_DOC_LEN,
+                            "{\"clientToken\":\"ota_host\",\"timestamp\":1,\"execution\":{"
+                            "\"jobId\":\"" OTA_HOST_JOB_ID "\",\"status\":\"%s\",%s"
+                            "\"queuedAt\":1,\"lastUpdatedAt\":1,\"versionNumber\":1,\"executionNumber\":1,"
+                            "\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],"
+                            "\"streamname\":\"" OTA_HOST_STREAM_NAME "\",\"files\":[{"
+                            "\"filepath\":\"%s\",\"filesize\":%lu,\"fileid\":0,"
+                            "\"certfile\":\"" OTA_HOST_SIGNER_LABEL "\",\"sig-sha256-ecdsa\":\"%s\"}]}}}}",
+                            xJob.cStatus, cDetails, xConfig.pcFileName, ( unsigned long ) uxFileLength, cSignature );
+    }
+
+    configASSERT( ( lLength > 0 ) && ( lLength < OTA_HOST_JOB_DOC_LEN ) );
+    prvServiceSend( cTopic, pcDoc, ( size_t ) lLength );
+    vPortFree( pcDoc );
+}
+
+static void prvServiceJobUpdate( const OtaHostMessage_t * pxRequest )
+{
+    char * pcJson = ( char * ) pxRequest->pucPayload;
+    size_t uxJsonLength = pxRequest->uxPayloadLength;
+    char * pcValue = NULL;
+    size_t uxValueLength = 0;
+
+    if( ( JSON_Validate( pcJson, uxJsonLength ) == JSONSuccess ) &&
+        ( JSON_Search( pcJson, uxJsonLength, "status", strlen( "status" ), &pcValue, &uxValueLength ) == JSONSuccess ) &&
+        ( uxValueLength < OTA_HOST_STATUS_LEN ) )
+    {
+        ( void ) memcpy( xJob.cStatus, pcValue, uxValueLength );
+        xJob.cStatus[ uxValueLength ] = '\0';
+
+        if( ( JSON_Search( pcJson, uxJsonLength, "statusDetails", strlen( "statusDetails" ), &pcValue, &uxValueLength ) == JSONSuccess ) &&
+            ( uxValueLength < OTA_HOST_DETAILS_LEN ) )
+        {
+            ( void ) memcpy( xJob.cStatusDetails, pcValue, uxValueLength );
+            xJob.cStatusDetails[ uxValueLength ] = '\0';
+        }
+
+        LogInfo( "Job status %s, details %s", xJob.cStatus, xJob.cStatusDetails );
+        prvSaveJob();
+
+        if( prvIsTerminal( xJob.cStatus ) == pdTRUE )
+        {
+            prvFinish( OTA_HOST_EXIT_DONE, "done" );
+        }
+    }
+    else
+    {
+        LogError( "Malformed job update: %.*s", ( int ) uxJsonLength, pcJson );
+    }
+}
+
+static void prvServiceSendBlock( const char * pcTopic,
+                                 int64_t llFileId,
+                                 uint32_t ulBlock,
+                                 uint32_t ulBlockSize )
+{
+    static uint8_t ucResponse[ OTA_HOST_MAX_BLOCK_SIZE + OTA_HOST_BLOCK_OVERHEAD ];
+    size_t uxOffset = ( size_t ) ulBlock * ulBlockSize;
+    size_t uxLength = ( ( uxFileLength - uxOffset ) < ulBlockSize ) ? ( uxFileLength - uxOffset ) : ulBlockSize;
+    CborEncoder xEncoder;
+    CborEncoder xMap;
+    CborError xError;
+
+    cbor_encoder_init( &xEncoder, ucResponse, sizeof( ucResponse ), 0 );
+    xError = cbor_encoder_create_map( &xEncoder, &xMap, 4 );
+    xError |= cbor_encode_text_stringz( &xMap, "f" );
+    xError |= cbor_encode_int( &xMap, llFileId );
+    xError |= cbor_encode_text_stringz( &xMap, "i" );
+    xError |= cbor_encode_int( &xMap, ulBlock );
+    xError |= cbor_encode_text_stringz( &xMap, "l" );
+    xError |= cbor_encode_int( &xMap, ( int64_t ) uxLength );
+    xError |= cbor_encode_text_stringz( &xMap, "p" );
+    xError |= cbor_encode_byte_string( &xMap, &( pucFile[ uxOffset ] ), uxLength );
+    xError |= cbor_encoder_close_container_checked( &xEncoder, &xMap );
+    configASSERT( xError == CborNoError );
+
+    xStats.ulBlocksSent++;
+
+    if( ( uint32_t ) ( rand_r( &( xConfig.uSeed ) ) % 100 ) < xConfig.ulDropPercent )
+    {
+        /* Lost on the way, after taking its share of the link */
+        xStats.ulBlocksDropped++;
+        ullLinkFreeUs += ( ( uint64_t ) ( uxLength + OTA_HOST_BLOCK_OVERHEAD ) * 1000000ULL ) / ( ( uint64_t ) xConfig.ulLinkKBps * 1024ULL );
+    }
+    else
+    {
+        prvServiceSend( pcTopic, ucResponse, cbor_encoder_get_buffer_size( &xEncoder, ucResponse ) );
+    }
+}
+
+/* Answer a stream request with the first missing blocks of its bitmap, starting at block "o" */
+static void prvServiceStreamRequest( const OtaHostMessage_t * pxRequest )
+{
+    static uint8_t ucBitmap[ OTA_HOST_MAX_BITMAP_LEN ];
+    uint32_t ulBlocks[ OTA_HOST_MAX_BLOCKS_PER_REQ ];
+    uint32_t ulBlockCount = 0;
+    size_t uxBitmapLength = sizeof( ucBitmap );
+    int64_t llFileId = 0;
+    int lBlockSize = 0;
+    int lOffset = 0;
+    int lNumBlocks = 0;
+    char cTopic[ OTA_HOST_TOPIC_LEN ];
+    CborParser xParser;
+    CborValue xMap;
+    CborValue xValue;
+    CborError xError;
+
+    xStats.ulStreamRequests++;
+
+    xError = cbor_parser_init( pxRequest->pucPayload, pxRequest->uxPayloadLength, 0, &xParser, &xMap );
+    xError |= cbor_value_map_find_value( &xMap, "f", &xValue );
+    xError |= cbor_value_get_int64( &xValue, &llFileId );
+    xError |= cbor_value_map_find_value( &xMap, "l", &xValue );
+    xError |= cbor_value_get_int( &xValue, &lBlockSize );
+    xError |= cbor_value_map_find_value( &xMap, "o", &xValue );
+    xError |= cbor_value_get_int( &xValue, &lOffset );
+    xError |= cbor_value_map_find_value( &xMap, "n", &xValue );
+    xError |= cbor_value_get_int( &xValue, &lNumBlocks );
+    xError |= cbor_value_map_find_value( &xMap, "b", &xValue );
+    xError |= cbor_value_copy_byte_string( &xValue, ucBitmap, &uxBitmapLength, NULL );
+
+    if( ( xError != CborNoError ) ||
+        ( lBlockSize <= 0 ) || ( lBlockSize > OTA_HOST_MAX_BLOCK_SIZE ) ||
+        ( lOffset < 0 ) || ( lNumBlocks <= 0 ) )
+    {
+        LogError( "Malformed stream request, CBOR error %d.", xError );
+    }
+    else
+    {
+        uint32_t ulFileBlocks = ( uint32_t ) ( ( uxFileLength + ( size_t ) lBlockSize - 1 ) / ( size_t ) lBlockSize );
+
+        if( lNumBlocks > OTA_HOST_MAX_BLOCKS_PER_REQ )
+        {
+            lNumBlocks = OTA_HOST_MAX_BLOCKS_PER_REQ;
+        }
+
+        for( uint32_t ulBit = 0; ( ulBit < ( uxBitmapLength * 8 ) ) && ( ulBlockCount < ( uint32_t ) lNumBlocks ); ulBit++ )
+        {
+            uint32_t ulBlock = ( uint32_t ) lOffset + ulBit;
+
+            if( ( ulBlock < ulFileBlocks ) &&
+                ( ( ucBitmap[ ulBit / 8 ] & ( 1U << ( ulBit % 8 ) ) ) != 0 ) )
+            {
+                ulBlocks[ ulBlockCount++ ] = ulBlock;
+            }
+        }
+
+        /* Swapped pairs stand in for a broker delivering out of order */
+        for( uint32_t ulIdx = 0; ( xConfig.xReorder == pdTRUE ) && ( ( ulIdx + 1 ) < ulBlockCount ); ulIdx += 2 )
+        {
+            uint32_t ulTemp = ulBlocks[ ulIdx ];
+
+            ulBlocks[ ulIdx ] = ulBlocks[ ulIdx + 1 ];
+            ulBlocks[ ulIdx + 1 ] = ulTemp;
+        }
+
+        configASSERT( pxRequest->usTopicLength > strlen( OTA_HOST_STREAM_GET_SUFFIX ) );
+        ( void ) snprintf( cTopic, sizeof( cTopic ), "%.*s" OTA_HOST_STREAM_DATA_SUFFIX,
+                           ( int ) ( pxRequest->usTopicLength - strlen( OTA_HOST_STREAM_GET_SUFFIX ) ), pxRequest->cTopic );
+
+        for( uint32_t ulIdx = 0; ulIdx < ulBlockCount; ulIdx++ )
+        {
+            prvServiceSendBlock( cTopic, llFileId, ulBlocks[ ulIdx ], ( uint32_t ) lBlockSize );
+        }
+    }
+}
+
+static BaseType_t prvTopicEndsWith( const OtaHostMessage_t * pxMessage,
+                                    const char * pcSuffix )
+{
+    size_t uxSuffixLength = strlen( pcSuffix );
+
+    return ( ( pxMessage->usTopicLength >= uxSuffixLength ) &&
+             ( memcmp( &( pxMessage->cTopic[ pxMessage->usTopicLength - uxSuffixLength ] ), pcSuffix, uxSuffixLength ) == 0 ) ) ?
+           pdTRUE : pdFALSE;
+}
+
+/* Stand-in for the Jobs and file streams services */
+static void prvServiceTask( void * pvParameters )
+{
+    OtaHostMessage_t xMessage;
+
+    ( void ) pvParameters;
+
+    for( ; ; )
+    {
+        ( void ) xQueueReceive( xUplink, &xMessage, portMAX_DELAY );
+        prvWaitUntil( xMessage.xDue );
+
+        if( prvTopicEndsWith( &xMessage, OTA_HOST_JOB_GET_SUFFIX ) == pdTRUE )
+        {
+            prvServiceJobRequest( &xMessage );
+        }
+        else if( ( strstr( xMessage.cTopic, "/jobs/" ) != NULL ) &&
+                 ( prvTopicEndsWith( &xMessage, OTA_HOST_JOB_UPDATE_SUFFIX ) == pdTRUE ) )
+        {
+            prvServiceJobUpdate( &xMessage );
+        }
+        else if( ( strstr( xMessage.cTopic, "/streams/" ) != NULL ) &&
+                 ( prvTopicEndsWith( &xMessage, OTA_HOST_STREAM_GET_SUFFIX ) == pdTRUE ) )
+        {
+            prvServiceStreamRequest( &xMessage );
+        }
+        else
+        {
+            LogWarn( "No service for topic %s.", xMessage.cTopic );
+        }
+
+        vPortFree( xMessage.pucPayload );
+    }
+}
+
+/*-----------------------------------------------------------*/
+
+static uint8_t * prvReadFile( const char * pcPath,
+                              size_t * puxLength )
+{
+    uint8_t * pucData = NULL;
+    FILE * pxFile = fopen( pcPath, "rb" );
+
+    if( pxFile != NULL )
+    {
+        long lLength;
+
+        ( void ) fseek( pxFile, 0, SEEK_END );
+        lLength = ftell( pxFile );
+        ( void ) fseek( pxFile, 0, SEEK_SET );
+
+        pucData = malloc( ( size_t ) lLength + 1 );
+
+        if( ( pucData != NULL ) &&
+            ( fread( pucData, 1, ( size_t ) lLength, pxFile ) == ( size_t ) lLength ) )
+        {
+            *puxLength = ( size_t ) lLength;
+        }
+        else
+        {
+            free( pucData );
+            pucData = NULL;
+        }
+
+        ( void ) fclose( pxFile );
+    }
+
+    return pucData;
+}
+
+/* The same fixed entropy on every boot gives the same signing key, which is all a test needs */
+static int prvFixedEntropy( void * pvCtx,
+                            unsigned char * pucOutput,
+                            size_t uxLength )
+{
+    ( void ) pvCtx;
+    ( void ) memset( pucOutput, 0x5A, uxLength );
+
+    return 0;
+}
+
+/* Generate the code signing key and sign the --signed file, as the OTA job creation would */
+static BaseType_t prvSignFile( void )
+{
+    mbedtls_ctr_drbg_context xDrbg;
+    mbedtls_pk_context xSigner;
+    unsigned char ucHash[ 32 ];
+    unsigned char ucSignature[ MBEDTLS_PK_SIGNATURE_MAX_SIZE ];
+    size_t uxSignatureLength = 0;
+    size_t uxEncodedLength = 0;
+    size_t uxSignedLength = 0;
+    uint8_t * pucSigned = prvReadFile( xConfig.pcSignedPath, &uxSignedLength );
+    int lError = ( pucSigned != NULL ) ? 0 : -1;
+
+    mbedtls_ctr_drbg_init( &xDrbg );
+    mbedtls_pk_init( &xSigner );
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ctr_drbg_seed( &xDrbg, prvFixedEntropy, NULL,
+                                        ( const unsigned char * ) OTA_HOST_SIGNER_LABEL, strlen( OTA_HOST_SIGNER_LABEL ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_setup( &xSigner, mbedtls_pk_info_from_type( MBEDTLS_PK_ECKEY ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_ecp_gen_key( MBEDTLS_ECP_DP_SECP256R1, mbedtls_pk_ec( xSigner ), mbedtls_ctr_drbg_random, &xDrbg );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_write_pubkey_pem( &xSigner, ( unsigned char * ) cSignerPem, sizeof( cSignerPem ) );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_sha256( pucSigned, uxSignedLength, ucHash, 0 );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_pk_sign( &xSigner, MBEDTLS_MD_SHA256, ucHash, sizeof( ucHash ),
+                                  ucSignature, sizeof( ucSignature ), &uxSignatureLength,
+                                  mbedtls_ctr_drbg_random, &xDrbg );
+    }
+
+    if( lError == 0 )
+    {
+        lError = mbedtls_base64_encode( ( unsigned char * ) cSignature, sizeof( cSignature ), &uxEncodedLength,
+                                        ucSignature, uxSignatureLength );
+    }
+
+    if( lError != 0 )
+    {
+        LogError( "Failed to sign %s: -0x%x.", xConfig.pcSignedPath, ( unsigned int ) -lError );
+    }
+
+    mbedtls_pk_free( &xSigner );
+    mbedtls_ctr_drbg_free( &xDrbg );
+    free( pucSigned );
+
+    return ( lError == 0 ) ? pdTRUE : pdFALSE;
+}
+
+/* Catch a driver booting the binary of one version on the image of another */
+static BaseType_t prvCheckRunningImage( void )
+{
+    const uint8_t * pucImage = ( const uint8_t * ) FLASH_BASE;
+    uint32_t ulBuild = 0;
+    BaseType_t xResult = pdTRUE;
+
+    ( void ) memcpy( &ulBuild, &( pucImage[ OTA_HOST_IMAGE_MAGIC_LEN ] ), sizeof( ulBuild ) );
+
+    if( memcmp( pucImage, OTA_HOST_IMAGE_MAGIC, OTA_HOST_IMAGE_MAGIC_LEN ) != 0 )
+    {
+        LogError( "No image in the active bank." );
+        xResult = pdFALSE;
+    }
+    else if( ulBuild != OTA_HOST_APP_VERSION_BUILD )
+    {
+        LogError( "Booted build %u on the image of build %u.", OTA_HOST_APP_VERSION_BUILD, ulBuild );
+        xResult = pdFALSE;
+    }
+
+    return xResult;
+}
+
+static void prvTimeout( TimerHandle_t xTimer )
+{
+    ( void ) xTimer;
+
+    LogError( "Timed out after %u s.", xConfig.ulTimeoutS );
+    prvFinish( OTA_HOST_EXIT_FAIL, "timeout" );
+}
+
+static void prvBootTask( void * pvParameters )
+{
+    ( void ) pvParameters;
+
+    xBootTick = xTaskGetTickCount();
+
+    if( prvFsInit() != pdTRUE )
+    {
+        prvFinish( OTA_HOST_EXIT_FAIL, "fs" );
+    }
+
+    ( void ) xEventGroupSetBits( xSystemEvents, EVT_MASK_FS_READY | EVT_MASK_MQTT_CONNECTED );
+
+    configASSERT( xTaskCreate( prvAgentTask, "MQTTAgent", OTA_HOST_TASK_STACK_SIZE, NULL, OTA_HOST_AGENT_PRIORITY, NULL ) == pdPASS );
+    configASSERT( xTaskCreate( prvServiceTask, "Service", OTA_HOST_TASK_STACK_SIZE, NULL, OTA_HOST_SERVICE_PRIORITY, NULL ) == pdPASS );
+    configASSERT( xTaskCreate( vOTAUpdateTask, "OTAUpdate", 4096, NULL, tskIDLE_PRIORITY + 1, NULL ) == pdPASS );
+    configASSERT( xTimerStart( xTimerCreate( "Timeout", pdMS_TO_TICKS( xConfig.ulTimeoutS * 1000UL ), pdFALSE, NULL, prvTimeout ), 0 ) == pdPASS );
+
+    vTaskDelete( NULL );
+}
+
+/*-----------------------------------------------------------*/
+
+static BaseType_t prvParseArgs( int argc,
+                                char * argv[] )
+{
+    BaseType_t xArgsValid = pdTRUE;
+
+    for( int lArg = 1; ( lArg < argc ) && ( xArgsValid == pdTRUE ); lArg++ )
+    {
+        const char * pcArg = argv[ lArg ];
+        const char * pcValue = ( ( lArg + 1 ) < argc ) ? argv[ lArg + 1 ] : NULL;
+
+        if( strcmp( pcArg, "--reorder" ) == 0 )
+        {
+            xConfig.xReorder = pdTRUE;
+            continue;
+        }
+
+        if( pcValue == NULL )
+        {
+            xArgsValid = pdFALSE;
+        }
+        else if( strcmp( pcArg, "--flash" ) == 0 )
+        {
+            xConfig.pcFlashPath = pcValue;
+        }
+        else if( strcmp( pcArg, "--nor" ) == 0 )
+        {
+            xConfig.pcNorPath = pcValue;
+        }
+        else if( strcmp( pcArg, "--job" ) == 0 )
+        {
+            xConfig.pcJobPath = pcValue;
+        }
+        else if( strcmp( pcArg, "--file" ) == 0 )
+        {
+            xConfig.pcFilePath = pcValue;
+        }
+        else if( strcmp( pcArg, "--name" ) == 0 )
+        {
+            xConfig.pcFileName = pcValue;
+        }
+        else if( strcmp( pcArg, "--signed" ) == 0 )
+        {
+            xConfig.pcSignedPath = pcValue;
+        }
+        else if( strcmp( pcArg, "--rtt" ) == 0 )
+        {
+            xConfig.ulRttMs = ( uint32_t ) strtoul( pcValue, NULL, 0 );
+        }
+        else if( strcmp( pcArg, "--link" ) == 0 )
+        {
+            xConfig.ulLinkKBps = ( uint32_t ) strtoul( pcValue, NULL, 0 );
+        }
+        else if( strcmp( pcArg, "--drop" ) == 0 )
+        {
+            xConfig.ulDropPercent = ( uint32_t ) strtoul( pcValue, NULL, 0 );
+        }
+        else if( strcmp( pcArg, "--seed" ) == 0 )
+        {
+            xConfig.uSeed = ( unsigned int ) strtoul( pcValue, NULL, 0 );
+        }
+        else if( strcmp( pcArg, "--cut-after" ) == 0 )
+        {
+            xConfig.ulCutAfterBlocks = ( uint32_t ) strtoul( pcValue, NULL, 0 );
+        }
+        else if( strcmp( pcArg, "--timeout" ) == 0 )
+        {
+            xConfig.ulTimeoutS = ( uint32_t ) strtoul( pcValue, NULL, 0 );
+        }
+        else
+        {
+            xArgsValid = pdFALSE;
+        }
+
+        lArg++;
+    }
+
+    if( xConfig.pcSignedPath == NULL )
+    {
+        xConfig.pcSignedPath = xConfig.pcFilePath;
+    }
+
+    if( ( xConfig.pcFlashPath == NULL ) || ( xConfig.pcNorPath == NULL ) || ( xConfig.pcJobPath == NULL ) ||
+        ( xConfig.pcFilePath == NULL ) || ( xConfig.pcFileName == NULL ) || ( xConfig.ulLinkKBps == 0 ) )
+    {
+        xArgsValid = pdFALSE;
+    }
+
+    if( xArgsValid == pdFALSE )
+    {
+        fprintf( stderr, "Usage: %s --flash <file> --nor <file> --job <file> --file <path> --name <file name> "
+                         "[--signed <path>] [--rtt <ms>] [--link <KB/s>] [--drop <percent>] [--reorder] "
+                         "[--seed <n>] [--cut-after <blocks>] [--timeout <s>]\n", argv[ 0 ] );
+    }
+
+    return xArgsValid;
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int lResult = OTA_HOST_EXIT_USAGE;
+
+    if( prvParseArgs( argc, argv ) == pdTRUE )
+    {
+        lResult = OTA_HOST_EXIT_FAIL;
+
+        vFlashSimBoot( xConfig.pcFlashPath );
+        vMx25lmSimBoot( xConfig.pcNorPath );
+        ( void ) mbedtls_platform_set_calloc_free( prvCalloc, vPortFree );
+
+        prvLoadJob();
+        pucFile = prvReadFile( xConfig.pcFilePath, &uxFileLength );
+
+        if( ( pucFile != NULL ) &&
+            ( prvCheckRunningImage() == pdTRUE ) &&
+            ( prvSignFile() == pdTRUE ) )
+        {
+            xSystemEvents = xEventGroupCreate();
+            xUplink = xQueueCreate( OTA_HOST_QUEUE_LEN, sizeof( OtaHostMessage_t ) );
+            xDownlink = xQueueCreate( OTA_HOST_QUEUE_LEN, sizeof( OtaHostMessage_t ) );
+            xSubscriptionMutex = xSemaphoreCreateMutex();
+            configASSERT( ( xSystemEvents != NULL ) && ( xUplink != NULL ) && ( xDownlink != NULL ) && ( xSubscriptionMutex != NULL ) );
+
+            configASSERT( xTaskCreate( prvBootTask, "Boot", OTA_HOST_TASK_STACK_SIZE, NULL, OTA_HOST_SERVICE_PRIORITY, NULL ) == pdPASS );
+            vTaskStartScheduler();
+        }
+    }
+
+    return lResult;
+}
@@ -0,0 +1,334 @@
+#!/usr/bin/env python3
+#
+#  FreeRTOS STM32 Reference Integration
+#
+#  Copyright (C) 2021 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a copy of
+#  this software and associated documentation files (the "Software"), to deal in
+#  the Software without restriction, including without limitation the rights to
+#  use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+#  the Software, and to permit persons to whom the Software is furnished to do so,
+#  subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+#  FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+#  COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+#  IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+#  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#
+#  https://www.FreeRTOS.org
+#  https://github.com/FreeRTOS
+"""Simulate an OTA download over the MQTT streams data path.
+
+A discrete event model of the request window of the OTA agent, the event buffer pool of
+Common/app/ota/ota_update_task.c and a fake AWS IoT streams service:
+    service     answers a stream request half a round trip after it is sent with the first
+                n blocks missing from the request bitmap. Blocks leave one after the other
+                at the link rate, arrive another half round trip later and are dropped with
+                the given probability.
+    device      takes an event buffer for every block received. Blocks arriving while all
+                otaconfigMAX_NUM_OTA_DATA_BUFFERS are in use are dropped, as in
+                prvProcessIncomingData. The agent writes one block at a time to flash.
+    agent       requests otaconfigMAX_NUM_BLOCKS_REQUEST blocks, counts the new blocks it
+                writes and sends the next request once the whole window has arrived. The
+                request timer, restarted by every block, re-requests the missing blocks
+                after otaconfigFILE_REQUEST_WAIT_MS.
+The window, buffer count, block size and timeout are read from Common/config/ota_config.h.
+
+The device side also keeps the request window statistics logged by the OTA update task, the
+round trip to the first block of a request and the spacing of the blocks that follow, and
+reports the window size the task suggests from them.
+
+sweep prints the throughput of each window size against the round trip time. selftest checks
+the model against the throughput bound documented in ota_config.h, the stall of a dropped
+block and the suggested window.
+
+Usage:
+    ota_stream_sim.py sweep [--rtt MS]... [--window N]... [--link KBPS] [--write MS]
+                            [--drop P] [--size KB] [--seed N]
+    ota_stream_sim.py selftest
+"""
+import argparse
+import heapq
+import os
+import random
+import re
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+OTA_CONFIG = os.path.join(ROOT, "Common", "config", "ota_config.h")
+
+
+def read_ota_config(path=OTA_CONFIG):
+    """Evaluate the otaconfig macros the model depends on."""
+    macros = {}
+    with open(path) as config:
+        for line in config:
+            match = re.match(r"\s*#define\s+(otaconfig\w+)\s+(.+?)\s*$", line)
+            if match:
+                macros[match.group(1)] = match.group(2)
+
+    def evaluate(name):
+        expression = macros[name]
+        expression = re.sub(r"\b(\d+)U?L?\b", r"\1", expression)
+        expression = re.sub(r"\b(otaconfig\w+)\b", lambda ref: str(evaluate(ref.group(1))), expression)
+        return int(eval(expression, {"__builtins__": {}}))
+
+    return {
+        "window": evaluate("otaconfigMAX_NUM_BLOCKS_REQUEST"),
+        "buffers": evaluate("otaconfigMAX_NUM_OTA_DATA_BUFFERS"),
+        "block_size": evaluate("otaconfigFILE_BLOCK_SIZE"),
+        "request_wait_ms": evaluate("otaconfigFILE_REQUEST_WAIT_MS"),
+    }
+
+
+class Result:
+    def __init__(self):
+        self.elapsed_ms = 0.0
+        self.requests = 0
+        self.timeouts = 0
+        self.link_drops = 0
+        self.buffer_drops = 0
+        self.duplicates = 0
+        self.windows = 0
+        self.rtt_ms_total = 0.0
+        self.spacing_ms_total = 0.0
+        self.spacings = 0
+
+    def throughput(self, size):
+        return size * 1000.0 / self.elapsed_ms
+
+    def suggested_window(self):
+        """The window the OTA update task logs: round trip / block spacing + 1."""
+        rtt_ms = int(self.rtt_ms_total / self.windows)
+        spacing_ms = int(self.spacing_ms_total / self.spacings) if self.spacings else 0
+        return rtt_ms // max(spacing_ms, 1) + 1
+
+
+def simulate(size, block_size, window, buffers, request_wait_ms, rtt_ms,
+             link_kbps=400.0, write_ms=0.0, drop=0.0, drop_blocks=(), seed=1):
+    """Download size bytes; returns a Result with the elapsed time and counters."""
+    blocks = (size + block_size - 1) // block_size
+    block_ms = block_size / link_kbps
+    rng = random.Random(seed)
+    result = Result()
+
+    received = [False] * blocks
+    remaining = blocks
+    events = []
+    sequence = 0
+    link_free = 0.0
+    free_buffers = buffers
+    write_queue = []
+    writing = False
+    to_receive = 0
+    timer_deadline = None
+    timer_generation = 0
+    dropped_once = set()
+    stats = {"request": 0.0, "first": None, "last": None, "count": 0}
+
+    def post(time, kind, value=None):
+        nonlocal sequence
+        heapq.heappush(events, (time, sequence, kind, value))
+        sequence += 1
+
+    def restart_timer(now):
+        nonlocal timer_deadline, timer_generation
+        timer_generation += 1
+        timer_deadline = now + request_wait_ms
+        post(timer_deadline, "timer", timer_generation)
+
+    def close_window_stats():
+        if stats["count"] > 0:
+            result.windows += 1
+            result.rtt_ms_total += stats["first"] - stats["request"]
+            result.spacing_ms_total += stats["last"] - stats["first"]
+            result.spacings += stats["count"] - 1
+
+    def request(now):
+        nonlocal to_receive
+        close_window_stats()
+        stats.update(request=now, first=None, last=None, count=0)
+        missing = [index for index in range(blocks) if not received[index]][:window]
+        to_receive = window
+        result.requests += 1
+        restart_timer(now)
+        post(now + rtt_ms / 2.0, "service", missing)
+
+    def start_write(now):
+        nonlocal writing
+        if not writing and write_queue:
+            writing = True
+            post(now + write_ms, "written", write_queue.pop(0))
+
+    request(0.0)
+
+    while remaining > 0:
+        now, _, kind, value = heapq.heappop(events)
+
+        if kind == "service":
+            for index in value:
+                link_free = max(link_free, now) + block_ms
+                lost = rng.random() < drop
+                if index in drop_blocks and index not in dropped_once:
+                    dropped_once.add(index)
+                    lost = True
+                if lost:
+                    result.link_drops += 1
+                else:
+                    post(link_free + rtt_ms / 2.0, "arrive", index)
+
+        elif kind == "arrive":
+            if stats["first"] is None:
+                stats["first"] = now
+            stats["last"] = now
+            stats["count"] += 1
+
+            if free_buffers == 0:
+                result.buffer_drops += 1
+            else:
+                free_buffers -= 1
+                write_queue.append(value)
+                start_write(now)
+
+        elif kind == "written":
+            writing = False
+            free_buffers += 1
+
+            if received[value]:
+                result.duplicates += 1
+            else:
+                received[value] = True
+                remaining -= 1
+                restart_timer(now)
+
+                if to_receive > 1:
+                    to_receive -= 1
+                elif remaining > 0:
+                    request(now)
+
+            start_write(now)
+
+        elif kind == "timer":
+            if value == timer_generation:
+                result.timeouts += 1
+                request(now)
+
+    close_window_stats()
+    result.elapsed_ms = now
+    return result
+
+
+def cmd_sweep(args):
+    config = read_ota_config()
+    windows = args.window or sorted({1, 2, 4, config["window"], 16, 32})
+    rtts = args.rtt or [20, 50, 100, 200, 400, 800]
+    size = args.size * 1024
+
+    print("Block %u bytes, %u buffers at the configured window, link %.0f KB/s, write %.1f ms/block, drop %.3f"
+          % (config["block_size"], config["buffers"], args.link, args.write, args.drop))
+    print("Throughput in KB/s against the round trip time; * marks otaconfigMAX_NUM_BLOCKS_REQUEST")
+    print("%8s" % "RTT ms" + "".join("%9s" % ("%u%s" % (window, "*" if window == config["window"] else ""))
+                                     for window in windows) + "%11s" % "suggested")
+
+    for rtt_ms in rtts:
+        row = "%8u" % rtt_ms
+        suggested = 0
+        for window in windows:
+            result = simulate(size, config["block_size"], window, window + 1, config["request_wait_ms"],
+                              rtt_ms, link_kbps=args.link, write_ms=args.write, drop=args.drop,
+                              seed=args.seed)
+            row += "%9.1f" % (result.throughput(size) / 1024.0)
+            if window == config["window"]:
+                suggested = result.suggested_window()
+        print(row + "%11u" % suggested)
+
+
+def cmd_selftest(args):
+    config = read_ota_config()
+    block_size = config["block_size"]
+    window = config["window"]
+    size = 256 * 1024
+    link_kbps = 400.0
+    block_ms = block_size / link_kbps
+
+    def run(rtt_ms, window=window, buffers=None, **kwargs):
+        return simulate(size, block_size, window, buffers or window + 1, config["request_wait_ms"],
+                        rtt_ms, link_kbps=link_kbps, **kwargs)
+
+    # Without losses, one window of blocks takes a round trip plus the link time of the window.
+    for rtt_ms in (20, 200, 800):
+        for test_window in (1, 2, window):
+            result = run(rtt_ms, window=test_window)
+            expected = min(link_kbps * 1024, test_window * block_size * 1000.0 /
+                           (rtt_ms + test_window * block_ms))
+            assert abs(result.throughput(size) - expected) < 0.05 * expected, \
+                (rtt_ms, test_window, result.throughput(size), expected)
+            assert result.timeouts == 0 and result.buffer_drops == 0 and result.duplicates == 0
+
+    # ota_config.h: the configured window reaches about 65 KB/s over a 200 ms round trip.
+    throughput = run(200).throughput(size) / 1024.0
+    assert 60.0 < throughput < 70.0, throughput
+
+    # A dropped block holds the window until the request timer fires, then only it is requested.
+    baseline = run(200)
+    stalled = run(200, drop_blocks=(3,))
+    stall_ms = stalled.elapsed_ms - baseline.elapsed_ms
+    assert stalled.timeouts == 1 and stalled.duplicates == 0, vars(stalled)
+    assert config["request_wait_ms"] < stall_ms < config["request_wait_ms"] + 2 * 200, stall_ms
+
+    # The agent writing slower than the link fills the buffers, which hold one window.
+    slow = run(20, write_ms=4 * block_ms)
+    assert slow.buffer_drops == 0 and slow.timeouts == 0, vars(slow)
+    short = run(20, buffers=window // 2, write_ms=4 * block_ms)
+    assert short.buffer_drops > 0 and short.timeouts > 0, vars(short)
+
+    # The window suggested from the measured statistics covers the bandwidth delay product.
+    # The first block of a request arrives a round trip plus its own link time after the
+    # request. Requests do not overlap, so the link still idles for a round trip per window
+    # and about half the link rate is reached.
+    for rtt_ms in (50, 200, 800):
+        suggested = run(rtt_ms, window=2).suggested_window()
+        expected = int(rtt_ms + block_ms) // int(block_ms) + 1
+        assert suggested == expected, (rtt_ms, suggested, expected)
+        throughput = run(rtt_ms, window=suggested).throughput(size)
+        assert throughput > 0.4 * link_kbps * 1024, (rtt_ms, suggested, throughput)
+        assert throughput > 1.8 * run(rtt_ms, window=max(1, suggested // 4)).throughput(size)
+
+    # Random losses do not lose or duplicate blocks.
+    lossy = run(200, drop=0.02, seed=7)
+    assert lossy.link_drops > 0 and lossy.duplicates == 0 and lossy.timeouts >= 1, vars(lossy)
+
+    print("selftest passed")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    sweep = sub.add_parser("sweep", help="print the throughput of each window against the round trip time")
+    sweep.add_argument("--rtt", type=int, action="append", metavar="MS", help="round trip time")
+    sweep.add_argument("--window", type=int, action="append", metavar="N", help="blocks per request")
+    sweep.add_argument("--link", type=float, default=400.0, metavar="KBPS",
+                       help="rate at which the service sends blocks, in KB/s")
+    sweep.add_argument("--write", type=float, default=0.0, metavar="MS",
+                       help="time the agent takes to write a block to flash")
+    sweep.add_argument("--drop", type=float, default=0.0, metavar="P", help="probability a block is lost")
+    sweep.add_argument("--size", type=int, default=512, metavar="KB", help="size of the file")
+    sweep.add_argument("--seed", type=int, default=1)
+    sweep.set_defaults(func=cmd_sweep)
+
+    selftest = sub.add_parser("selftest", help="check the model against the documented behaviour")
+    selftest.set_defaults(func=cmd_selftest)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()